@@ -0,0 +1,206 @@
+//
+//  ImageRegionTests.m
+//  MuPDF-iOSTests
+//
+//  Checks that scaling and painting part of an image gives the same
+//  pixels as doing so with the whole of it. The draw device decodes only
+//  the part of a large image that can show through the clip (a band, say)
+//  and draws it as if the rest was there, so any difference shows up as
+//  seams between bands. The part is picked here the way the draw device
+//  picks it, and the transforms are random sizes, flips and offsets.
+//
+
+#import <XCTest/XCTest.h>
+
+#include "mupdf/fitz.h"
+#include "../source/fitz/draw-imp.h"
+
+#define CHECKS 300
+
+static unsigned int seed = 1;
+
+static int
+rnd(int range)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffff) % range;
+}
+
+/* The pixels of the source that can show through clip, with room for
+ * grid fitting and the filters, as in fz_draw_image_region. */
+static void
+source_area(fz_irect *area, const fz_matrix *ctm, int w, int h, const fz_irect *clip)
+{
+	fz_irect bounds = { 0, 0, w, h };
+	fz_matrix inverse, m;
+	fz_rect rect;
+	float exp;
+
+	fz_invert_matrix(&inverse, ctm);
+	fz_concat(&inverse, &inverse, fz_scale(&m, w, h));
+	exp = fz_matrix_max_expansion(&inverse);
+	fz_rect_from_irect(&rect, clip);
+	fz_transform_rect(&rect, &inverse);
+	fz_expand_rect(&rect, fz_max(exp, 1) * 8);
+	fz_irect_from_rect(area, &rect);
+	fz_intersect_irect(area, &bounds);
+}
+
+/* Copy area of src into a pixmap of its own, and set whole to the bounds
+ * of src in its pixels. */
+static fz_pixmap *
+copy_part(fz_context *ctx, fz_pixmap *src, const fz_irect *area, fz_irect *whole)
+{
+	fz_pixmap *part = fz_new_pixmap(ctx, src->colorspace, area->x1 - area->x0, area->y1 - area->y0);
+	int y;
+
+	for (y = 0; y < part->h; y++)
+		memcpy(part->samples + y * part->w * part->n,
+			src->samples + ((area->y0 + y) * src->w + area->x0) * src->n,
+			part->w * part->n);
+	whole->x0 = -area->x0;
+	whole->y0 = -area->y0;
+	whole->x1 = whole->x0 + src->w;
+	whole->y1 = whole->y0 + src->h;
+	return part;
+}
+
+/* A random image transform, and a band or column of the page to clip it
+ * to. Only the painter takes quarter turns; the scaler is handed them
+ * with the axes swapped. */
+static void
+random_case(fz_pixmap *src, int turn, fz_matrix *ctm, fz_irect *band, const fz_irect *page)
+{
+	float w = src->w * (rnd(4000) + 50) / 1000.0f;
+	float h = src->h * (rnd(4000) + 50) / 1000.0f;
+
+	if (rnd(2))
+		w = -w;
+	if (rnd(2))
+		h = -h;
+	if (turn && rnd(2))
+	{
+		ctm->a = 0; ctm->b = h;
+		ctm->c = w; ctm->d = 0;
+	}
+	else
+	{
+		ctm->a = w; ctm->b = 0;
+		ctm->c = 0; ctm->d = h;
+	}
+	ctm->e = rnd(page->x1 * 100) / 100.0f;
+	ctm->f = rnd(page->y1 * 100) / 100.0f;
+
+	*band = *page;
+	if (rnd(2))
+	{
+		band->y0 = rnd(page->y1);
+		band->y1 = fz_mini(band->y0 + 1 + rnd(64), page->y1);
+	}
+	else
+	{
+		band->x0 = rnd(page->x1);
+		band->x1 = fz_mini(band->x0 + 1 + rnd(64), page->x1);
+	}
+}
+
+/* Returns the number of cases where the part scaled differently */
+static int
+check_scale(fz_context *ctx, fz_pixmap *src)
+{
+	fz_irect page = { 0, 0, 1200, 1200 };
+	fz_irect band, area, whole;
+	fz_matrix ctm;
+	fz_pixmap *part, *a, *b;
+	int i, bad = 0;
+
+	for (i = 0; i < CHECKS; i++)
+	{
+		random_case(src, 0, &ctm, &band, &page);
+		source_area(&area, &ctm, src->w, src->h, &band);
+		if (fz_is_empty_irect(&area))
+			continue;
+		part = copy_part(ctx, src, &area, &whole);
+		a = fz_scale_pixmap_cached(ctx, src, ctm.e, ctm.f, ctm.a, ctm.d, &band, NULL, NULL);
+		b = fz_scale_pixmap_part(ctx, part, &whole, ctm.e, ctm.f, ctm.a, ctm.d, &band, NULL, NULL);
+		if (!a != !b)
+			bad++;
+		else if (a && (a->x != b->x || a->y != b->y || a->w != b->w || a->h != b->h ||
+				memcmp(a->samples, b->samples, a->w * a->h * a->n)))
+			bad++;
+		fz_drop_pixmap(ctx, a);
+		fz_drop_pixmap(ctx, b);
+		fz_drop_pixmap(ctx, part);
+	}
+	return bad;
+}
+
+/* Returns the number of cases where the part painted differently */
+static int
+check_paint(fz_context *ctx, fz_pixmap *src, int lerp_allowed)
+{
+	fz_irect page = { 0, 0, 600, 600 };
+	fz_irect band, area, whole;
+	fz_matrix ctm;
+	fz_pixmap *part, *a, *b;
+	int i, bad = 0;
+
+	a = fz_new_pixmap_with_bbox(ctx, src->colorspace, &page);
+	b = fz_new_pixmap_with_bbox(ctx, src->colorspace, &page);
+	for (i = 0; i < CHECKS; i++)
+	{
+		random_case(src, 1, &ctm, &band, &page);
+		source_area(&area, &ctm, src->w, src->h, &band);
+		if (fz_is_empty_irect(&area))
+			continue;
+		part = copy_part(ctx, src, &area, &whole);
+		fz_clear_pixmap(ctx, a);
+		fz_clear_pixmap(ctx, b);
+		fz_paint_image(a, &band, NULL, src, NULL, &ctm, 255, lerp_allowed);
+		fz_paint_image(b, &band, NULL, part, &whole, &ctm, 255, lerp_allowed);
+		if (memcmp(a->samples, b->samples, a->w * a->h * a->n))
+			bad++;
+		fz_drop_pixmap(ctx, part);
+	}
+	fz_drop_pixmap(ctx, a);
+	fz_drop_pixmap(ctx, b);
+	return bad;
+}
+
+@interface ImageRegionTests : XCTestCase
+
+@end
+
+@implementation ImageRegionTests
+{
+    fz_context *ctx;
+    fz_pixmap *src;
+}
+
+- (void)setUp {
+    int i;
+
+    [super setUp];
+    ctx = fz_new_context(NULL, NULL, FZ_STORE_DEFAULT);
+    src = fz_new_pixmap(ctx, fz_device_rgb(ctx), 311, 207);
+    seed = 1;
+    for (i = 0; i < src->w * src->h * src->n; i++)
+        src->samples[i] = (i % src->n == src->n - 1) ? 255 : rnd(256);
+}
+
+- (void)tearDown {
+    fz_drop_pixmap(ctx, src);
+    fz_drop_context(ctx);
+    [super tearDown];
+}
+
+- (void)testScaledPartMatchesWhole {
+    XCTAssertEqual(check_scale(ctx, src), 0);
+}
+
+- (void)testPaintedPartMatchesWhole {
+    XCTAssertEqual(check_paint(ctx, src, 1), 0, @"interpolated");
+    XCTAssertEqual(check_paint(ctx, src, 0), 0, @"not interpolated");
+}
+
+@end
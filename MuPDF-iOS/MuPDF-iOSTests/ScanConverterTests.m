@@ -0,0 +1,175 @@
+//
+//  ScanConverterTests.m
+//  MuPDF-iOSTests
+//
+//  Times the gel and cell scan converters on synthetic paths: small
+//  glyph sized shapes, large polygons and long thin strokes. The time
+//  covers inserting the edges, sorting them and scan conversion, which
+//  is all the rasterizer does for a fill. The total coverage the two
+//  give is compared too, as a sanity check.
+//
+
+#import <XCTest/XCTest.h>
+
+#include "mupdf/fitz.h"
+#include "../source/fitz/draw-imp.h"
+
+#define SIZE 1024
+
+enum { GLYPHS, POLYGONS, STROKES, NUM_KINDS };
+
+static const char *kind_name[NUM_KINDS] = { "glyphs", "polygons", "strokes" };
+static const int kind_count[NUM_KINDS] = { 5000, 50, 1000 };
+
+static unsigned int seed = 1;
+
+static float
+rnd(float range)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffff) * range / 0x10000;
+}
+
+/* Insert a star, a random polygon, or a thin quad depending on kind */
+static void
+make_path(fz_context *ctx, fz_gel *gel, int kind)
+{
+	float pts[64][2];
+	int i, n = 0;
+
+	if (kind == GLYPHS)
+	{
+		float cx = rnd(SIZE), cy = rnd(SIZE), r = 3 + rnd(8);
+		n = 24;
+		for (i = 0; i < n; i++)
+		{
+			float a = i * 6.2831853f / n;
+			float rr = (i & 1) ? r : r * 0.6f;
+			pts[i][0] = cx + rr * cosf(a);
+			pts[i][1] = cy + rr * sinf(a);
+		}
+	}
+	else if (kind == POLYGONS)
+	{
+		n = 64;
+		for (i = 0; i < n; i++)
+		{
+			pts[i][0] = rnd(SIZE);
+			pts[i][1] = rnd(SIZE);
+		}
+	}
+	else
+	{
+		float x0 = rnd(SIZE), y0 = rnd(SIZE), x1 = rnd(SIZE), y1 = rnd(SIZE);
+		float dx = x1 - x0, dy = y1 - y0, len = sqrtf(dx * dx + dy * dy) + 1;
+		float nx = -dy / len * 0.4f, ny = dx / len * 0.4f;
+		n = 4;
+		pts[0][0] = x0 + nx; pts[0][1] = y0 + ny;
+		pts[1][0] = x1 + nx; pts[1][1] = y1 + ny;
+		pts[2][0] = x1 - nx; pts[2][1] = y1 - ny;
+		pts[3][0] = x0 - nx; pts[3][1] = y0 - ny;
+	}
+
+	for (i = 0; i < n; i++)
+		fz_insert_gel(ctx, gel, pts[i][0], pts[i][1], pts[(i+1)%n][0], pts[(i+1)%n][1]);
+}
+
+/* Scan convert the same paths of one kind into pix */
+static void
+run_paths(fz_context *ctx, fz_gel *gel, fz_pixmap *pix, int kind, int eofill)
+{
+	fz_irect clip = { 0, 0, SIZE, SIZE };
+	fz_irect bbox;
+	int i;
+
+	fz_clear_pixmap(ctx, pix);
+	seed = 1;
+	for (i = 0; i < kind_count[kind]; i++)
+	{
+		fz_reset_gel(ctx, gel, &clip);
+		make_path(ctx, gel, kind);
+		fz_sort_gel(ctx, gel);
+		fz_bound_gel(ctx, gel, &bbox);
+		fz_intersect_irect(&bbox, &clip);
+		if (!fz_is_empty_irect(&bbox))
+			fz_scan_convert(ctx, gel, eofill, &bbox, pix, NULL);
+	}
+}
+
+@interface ScanConverterTests : XCTestCase
+
+@end
+
+@implementation ScanConverterTests
+{
+    fz_context *ctx;
+    fz_gel *gel;
+    fz_pixmap *pix;
+}
+
+- (void)setUp {
+    fz_irect rect = { 0, 0, SIZE, SIZE };
+
+    [super setUp];
+    ctx = fz_new_context(NULL, NULL, FZ_STORE_DEFAULT);
+    gel = fz_new_gel(ctx);
+    pix = fz_new_pixmap_with_bbox(ctx, NULL, &rect);
+}
+
+- (void)tearDown {
+    fz_drop_pixmap(ctx, pix);
+    fz_drop_gel(ctx, gel);
+    fz_drop_context(ctx);
+    [super tearDown];
+}
+
+- (void)testConvertersAgree {
+    fz_irect rect = { 0, 0, SIZE, SIZE };
+    fz_pixmap *ref = fz_new_pixmap_with_bbox(ctx, NULL, &rect);
+    int kind, eofill, i;
+
+    for (kind = 0; kind < NUM_KINDS; kind++)
+    {
+        for (eofill = 0; eofill < 2; eofill++)
+        {
+            double a = 0, b = 0;
+
+            fz_set_scan_converter(ctx, FZ_SCAN_CONVERTER_GEL);
+            run_paths(ctx, gel, ref, kind, eofill);
+            fz_set_scan_converter(ctx, FZ_SCAN_CONVERTER_CELLS);
+            run_paths(ctx, gel, pix, kind, eofill);
+
+            for (i = 0; i < SIZE * SIZE; i++)
+            {
+                a += ref->samples[i];
+                b += pix->samples[i];
+            }
+
+            /* The gel samples coverage on a grid, so the pixels differ,
+             * but the area covered should not. */
+            XCTAssertEqualWithAccuracy(b, a, a / 100, @"%s/%s", kind_name[kind], eofill ? "eo" : "nz");
+        }
+    }
+
+    fz_drop_pixmap(ctx, ref);
+}
+
+- (void)measureConverter:(int)converter {
+    fz_set_scan_converter(ctx, converter);
+    [self measureBlock:^{
+        int kind, eofill;
+        for (kind = 0; kind < NUM_KINDS; kind++)
+            for (eofill = 0; eofill < 2; eofill++)
+                run_paths(ctx, gel, pix, kind, eofill);
+    }];
+}
+
+- (void)testPerformanceGel {
+    [self measureConverter:FZ_SCAN_CONVERTER_GEL];
+}
+
+- (void)testPerformanceCells {
+    [self measureConverter:FZ_SCAN_CONVERTER_CELLS];
+}
+
+@end
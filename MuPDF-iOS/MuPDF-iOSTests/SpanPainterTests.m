@@ -0,0 +1,169 @@
+//
+//  SpanPainterTests.m
+//  MuPDF-iOSTests
+//
+//  Checks that the SIMD span painters give the same bytes as the C ones.
+//  The painter tables are private to draw-paint.c, so it is built into
+//  the test bundle here. The SIMD versions only exist on x86, so on a
+//  device the checks have nothing to compare and pass trivially.
+//
+
+#import <XCTest/XCTest.h>
+
+#include "../source/fitz/draw-paint.c"
+
+#define SPAN 4096
+#define CHECKS 20000
+
+enum { SOLID, WITH_COLOR, WITH_MASK, OVER, WITH_ALPHA, NUM_KINDS };
+
+static const char *kind_name[NUM_KINDS] =
+{
+	"solid_color", "span_with_color", "span_with_mask", "span", "span_with_alpha"
+};
+
+static unsigned int seed = 1;
+
+static int
+rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+/* Random bytes, with the 0 and 255 values that trigger the fast paths
+ * over-represented. */
+static void
+fill(byte *p, int len, int alpha_n)
+{
+	int i, k;
+	for (i = 0; i < len; i++)
+	{
+		switch (rnd() % 4)
+		{
+		case 0: p[i] = 0; break;
+		case 1: p[i] = 255; break;
+		default: p[i] = rnd(); break;
+		}
+	}
+	/* Premultiplied sources; keep some pixels that break the rule too */
+	if (alpha_n && rnd() % 4)
+	{
+		for (i = alpha_n - 1; i < len; i += alpha_n)
+			for (k = 1; k < alpha_n; k++)
+				if (p[i-k] > p[i])
+					p[i-k] = p[i];
+	}
+}
+
+static void
+run(const fz_span_painters *p, int kind, int n, byte *dp, byte *sp, byte *mp, int w, byte *color, int alpha)
+{
+	switch (kind)
+	{
+	case SOLID:
+		(n == 2 ? p->solid_color_2 : p->solid_color_4)(dp, w, color);
+		break;
+	case WITH_COLOR:
+		(n == 2 ? p->span_with_color_2 : p->span_with_color_4)(dp, mp, w, color);
+		break;
+	case WITH_MASK:
+		(n == 2 ? p->span_with_mask_2 : p->span_with_mask_4)(dp, sp, mp, w);
+		break;
+	case OVER:
+		(n == 2 ? p->span_2 : p->span_4)(dp, sp, w);
+		break;
+	case WITH_ALPHA:
+		(n == 2 ? p->span_2_with_alpha : p->span_4_with_alpha)(dp, sp, w, alpha);
+		break;
+	}
+}
+
+static byte src[SPAN * 4 + 64], mask[SPAN + 64], dst0[SPAN * 4 + 64], ref[SPAN * 4 + 64], out[SPAN * 4 + 64];
+static byte bench_color[4] = { 200, 100, 50, 180 };
+
+/* Returns the width of the first span that differs from the C painter,
+ * or -1 if there is none. Odd widths and offsets exercise the tails. */
+static int
+check(const fz_span_painters *p, int kind, int n)
+{
+	byte color[4];
+	int i, w, off, alpha;
+
+	for (i = 0; i < CHECKS; i++)
+	{
+		w = rnd() % 300;
+		off = rnd() % 16;
+		alpha = rnd() % 256;
+		/* Only the bytes the span covers, and a few past it */
+		fill(src, (off + w + 4) * n, n);
+		fill(mask, off + w + 4, 0);
+		fill(dst0, (off + w + 4) * n, n);
+		fill(color, 4, 0);
+		if (rnd() % 2)
+			color[n-1] = rnd() % 2 ? 255 : 0;
+		memcpy(ref, dst0, sizeof ref);
+		memcpy(out, dst0, sizeof out);
+		run(&fz_span_painters_c, kind, n, ref + off, src + off, mask + off, w, color, alpha);
+		run(p, kind, n, out + off, src + off, mask + off, w, color, alpha);
+		if (memcmp(ref, out, sizeof ref))
+			return w;
+	}
+	return -1;
+}
+
+@interface SpanPainterTests : XCTestCase
+
+@end
+
+@implementation SpanPainterTests
+
+- (void)checkPainters:(const fz_span_painters *)painters named:(NSString *)name {
+    int kind, n, w;
+
+    for (kind = 0; kind < NUM_KINDS; kind++)
+    {
+        for (n = 2; n <= 4; n += 2)
+        {
+            w = check(painters, kind, n);
+            XCTAssertEqual(w, -1, @"%@ %s_%d differs from C at width %d", name, kind_name[kind], n, w);
+        }
+    }
+}
+
+- (void)testSSE2PaintersMatchC {
+#ifdef ARCH_X86_SIMD
+    if (fz_cpu_features() & FZ_CPU_SSE2)
+        [self checkPainters:&fz_span_painters_sse2 named:@"sse2"];
+#endif
+}
+
+- (void)testAVX2PaintersMatchC {
+#ifdef ARCH_X86_SIMD
+    if (fz_cpu_features() & FZ_CPU_AVX2)
+        [self checkPainters:&fz_span_painters_avx2 named:@"avx2"];
+#endif
+}
+
+- (void)testPerformanceSelectedPainters {
+    const fz_span_painters *painters = &fz_span_painters_c;
+#ifdef ARCH_X86_SIMD
+    int features = fz_cpu_features();
+    if (features & FZ_CPU_AVX2)
+        painters = &fz_span_painters_avx2;
+    else if (features & FZ_CPU_SSE2)
+        painters = &fz_span_painters_sse2;
+#endif
+
+    fill(src, sizeof src, 4);
+    fill(mask, sizeof mask, 0);
+    [self measureBlock:^{
+        int kind, n, i;
+        for (kind = 0; kind < NUM_KINDS; kind++)
+            for (n = 2; n <= 4; n += 2)
+                for (i = 0; i < 1000; i++)
+                    run(painters, kind, n, out, src, mask, SPAN, bench_color, 128);
+    }];
+}
+
+@end
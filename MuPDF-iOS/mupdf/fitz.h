@@ -37,6 +37,7 @@
 #include "mupdf/fitz/device.h"
 #include "mupdf/fitz/display-list.h"
 #include "mupdf/fitz/structured-text.h"
+#include "mupdf/fitz/search-index.h"
 
 #include "mupdf/fitz/transition.h"
 #include "mupdf/fitz/glyph-cache.h"
@@ -36,14 +36,18 @@ void fz_drop_buffer(fz_context *ctx, fz_buffer *buf);
 
 	Returns length of stream.
 */
-int fz_buffer_storage(fz_context *ctx, fz_buffer *buf, unsigned char **data);
+fz_off_t fz_buffer_storage(fz_context *ctx, fz_buffer *buf, unsigned char **data);
+
+typedef void (fz_buffer_drop_data_fn)(fz_context *ctx, unsigned char *data, fz_off_t len);
 
 struct fz_buffer_s
 {
 	int refs;
 	unsigned char *data;
-	int cap, len;
+	fz_off_t cap, len;
 	int unused_bits;
+	fz_buffer *shared;
+	fz_buffer_drop_data_fn *drop_data;
 };
 
 /*
@@ -54,7 +58,7 @@ struct fz_buffer_s
 	Returns pointer to new buffer. Throws exception on allocation
 	failure.
 */
-fz_buffer *fz_new_buffer(fz_context *ctx, int capacity);
+fz_buffer *fz_new_buffer(fz_context *ctx, fz_off_t capacity);
 
 /*
 	fz_new_buffer_from_data: Create a new buffer with existing data.
@@ -69,7 +73,22 @@ fz_buffer *fz_new_buffer(fz_context *ctx, int capacity);
 	Returns pointer to new buffer. Throws exception on allocation
 	failure.
 */
-fz_buffer *fz_new_buffer_from_data(fz_context *ctx, unsigned char *data, int size);
+fz_buffer *fz_new_buffer_from_data(fz_context *ctx, unsigned char *data, fz_off_t size);
+
+/*
+	fz_new_buffer_slice: Create a buffer holding part of another
+	buffer's data, without copying it.
+
+	The new buffer keeps a reference to parent, and its data points
+	into the parent's, so the parent must not be changed while the
+	slice exists. The slice itself may be written to or resized as
+	usual; it takes a private copy of its data the first time this
+	happens.
+
+	Returns pointer to new buffer. Throws exception on allocation
+	failure.
+*/
+fz_buffer *fz_new_buffer_slice(fz_context *ctx, fz_buffer *parent, fz_off_t offset, fz_off_t len);
 
 /*
 	fz_resize_buffer: Ensure that a buffer has a given capacity,
@@ -81,7 +100,7 @@ fz_buffer *fz_new_buffer_from_data(fz_context *ctx, unsigned char *data, int siz
 	of the buffer contents is smaller than capacity, it is truncated.
 
 */
-void fz_resize_buffer(fz_context *ctx, fz_buffer *buf, int capacity);
+void fz_resize_buffer(fz_context *ctx, fz_buffer *buf, fz_off_t capacity);
 
 /*
 	fz_grow_buffer: Make some space within a buffer (i.e. ensure that
@@ -9,6 +9,7 @@
 */
 
 typedef struct fz_alloc_context_s fz_alloc_context;
+typedef struct fz_alloc_arena_s fz_alloc_arena;
 typedef struct fz_error_context_s fz_error_context;
 typedef struct fz_id_context_s fz_id_context;
 typedef struct fz_warn_context_s fz_warn_context;
@@ -16,8 +17,12 @@ typedef struct fz_font_context_s fz_font_context;
 typedef struct fz_colorspace_context_s fz_colorspace_context;
 typedef struct fz_aa_context_s fz_aa_context;
 typedef struct fz_locks_context_s fz_locks_context;
+typedef struct fz_task_runner_s fz_task_runner;
+typedef struct fz_waiter_s fz_waiter;
 typedef struct fz_store_s fz_store;
 typedef struct fz_glyph_cache_s fz_glyph_cache;
+typedef struct fz_glyph_front_s fz_glyph_front;
+typedef struct fz_image_context_s fz_image_context;
 typedef struct fz_document_handler_context_s fz_document_handler_context;
 typedef struct fz_context_s fz_context;
 
@@ -100,7 +105,10 @@ void fz_flush_warnings(fz_context *ctx);
 struct fz_context_s
 {
 	fz_alloc_context *alloc;
+	fz_alloc_arena *arena;
 	fz_locks_context *locks;
+	fz_task_runner *tasks;
+	fz_waiter *waiter;
 	fz_id_context *id;
 	fz_error_context *error;
 	fz_warn_context *warn;
@@ -109,7 +117,10 @@ struct fz_context_s
 	fz_aa_context *aa;
 	fz_store *store;
 	fz_glyph_cache *glyph_cache;
+	fz_glyph_front *glyph_front;
+	fz_image_context *image;
 	fz_document_handler_context *handler;
+	int cpu_features; /* worked out once by fz_new_context, for picking SIMD code */
 };
 
 /*
@@ -138,7 +149,9 @@ enum {
 	function pointers. Set to NULL for the standard library
 	allocator. The context will keep the allocator pointer, so the
 	data it points to must not be modified or freed during the
-	lifetime of the context.
+	lifetime of the context. If the context is to be cloned for
+	use on other threads, the allocator functions must be thread
+	safe; MuPDF does not serialise calls to them.
 
 	locks: Supply a set of locks and functions to lock/unlock
 	them, intended for multi-threaded applications. Set to NULL
@@ -200,6 +213,34 @@ int fz_aa_level(fz_context *ctx);
 */
 void fz_set_aa_level(fz_context *ctx, int bits);
 
+enum
+{
+	FZ_SCAN_CONVERTER_GEL,
+	FZ_SCAN_CONVERTER_CELLS
+};
+
+/*
+	fz_scan_converter: Get the scan converter used to render
+	antialiased paths. One of FZ_SCAN_CONVERTER_GEL (the default) or
+	FZ_SCAN_CONVERTER_CELLS.
+*/
+int fz_scan_converter(fz_context *ctx);
+
+/*
+	fz_set_scan_converter: Choose the scan converter used to render
+	antialiased paths.
+
+	FZ_SCAN_CONVERTER_GEL samples each pixel on a grid of sub
+	scanlines whose size depends on the antialiasing level (17x15 at
+	8 bits). FZ_SCAN_CONVERTER_CELLS computes the area covered in
+	each pixel, as FreeType does, and always gives 8 bits of
+	coverage. It is faster on curved, diagonal and thin paths but
+	slower on small rectangles, and where a path overlaps itself
+	within a pixel the overlapping parts are counted twice. Neither
+	is used when antialiasing is off.
+*/
+void fz_set_scan_converter(fz_context *ctx, int converter);
+
 /*
 	Locking functions
 
@@ -228,24 +269,115 @@ struct fz_locks_context_s
 	void (*unlock)(void *user, int lock);
 };
 
+/*
+	The resource store is split into FZ_STORE_SHARDS shards, each
+	protected by its own lock (FZ_LOCK_STORE + shard number).
+*/
+enum {
+	FZ_STORE_SHARDS = 8
+};
+
+/*
+	The shared glyph cache is split into FZ_GLYPH_CACHE_STRIPES
+	stripes, each protected by its own lock (FZ_LOCK_GLYPHCACHE +
+	stripe number).
+*/
+enum {
+	FZ_GLYPH_CACHE_STRIPES = 4
+};
+
 enum {
 	FZ_LOCK_ALLOC = 0,
-	FZ_LOCK_FILE, /* Unused now */
+	FZ_LOCK_STORE,
+	FZ_LOCK_FILE = FZ_LOCK_STORE + FZ_STORE_SHARDS, /* Unused now */
 	FZ_LOCK_FREETYPE,
 	FZ_LOCK_GLYPHCACHE,
+	FZ_LOCK_IMAGE = FZ_LOCK_GLYPHCACHE + FZ_GLYPH_CACHE_STRIPES,
 	FZ_LOCK_MAX
 };
 
+/*
+	Waiter
+
+	When a thread needs a result that another thread is already
+	working on (such as an image being decoded), it can sleep until
+	that is done instead of doing the same work again. A client with
+	threads may supply a waiter for this, giving a condition variable
+	to go with each lock.
+
+	wait: Called with the given lock held. Release it, sleep until
+	a wake call for the same lock (or spuriously), and take the lock
+	again before returning.
+
+	wake: Called with the given lock held. Wake every thread sleeping
+	in wait on that lock.
+
+	Without a waiter, threads needing the same result each work it
+	out for themselves.
+*/
+struct fz_waiter_s
+{
+	void *user;
+	void (*wait)(void *user, int lock);
+	void (*wake)(void *user, int lock);
+};
+
+/*
+	fz_set_waiter: Set (or with NULL, clear) the waiter used by this
+	context and by contexts later cloned from it. The context keeps
+	the pointer, so the waiter must stay valid for the lifetime of
+	the context.
+*/
+void fz_set_waiter(fz_context *ctx, fz_waiter *waiter);
+
+/*
+	Task runner
+
+	Some operations on large pixmaps, such as colorspace conversion,
+	split their work into independent pieces. A client with a pool
+	of threads may supply a task runner to have the pieces run in
+	parallel.
+
+	run: Call task(arg, i) once for each i from 0 to count-1, on any
+	threads and in any order, and return only once every call has
+	finished. Tasks do not throw, take no locks and do not use the
+	context, so they may run on threads that have no context at all.
+
+	If no task runner is set, the pieces run in turn on the calling
+	thread.
+*/
+struct fz_task_runner_s
+{
+	void *user;
+	void (*run)(void *user, int count, void (*task)(void *arg, int i), void *arg);
+};
+
+/*
+	fz_set_task_runner: Set (or with NULL, clear) the task runner
+	used by this context and by contexts later cloned from it. The
+	context keeps the pointer, so the runner must stay valid for
+	the lifetime of the context.
+*/
+void fz_set_task_runner(fz_context *ctx, fz_task_runner *runner);
+
+/*
+	fz_run_tasks: Run task(arg, i) for each i from 0 to count-1,
+	through the task runner if there is one.
+*/
+void fz_run_tasks(fz_context *ctx, int count, void (*task)(void *arg, int i), void *arg);
+
 /*
 	Memory Allocation and Scavenging:
 
 	All calls to MuPDFs allocator functions pass through to the
 	underlying allocators passed in when the initial context is
-	created, after locks are taken (using the supplied locking function)
-	to ensure that only one thread at a time calls through.
+	created. No locks are held while doing so, so an allocator shared
+	between several threads must do its own locking (as the standard
+	library allocator does).
 
 	If the underlying allocator fails, MuPDF attempts to make room for
 	the allocation by evicting elements from the store, then retrying.
+	Only then is FZ_LOCK_ALLOC taken.
 
 	Any call to allocate may then result in several calls to the underlying
 	allocator, and result in elements that are only referred to by the
@@ -334,6 +466,65 @@ char *fz_strdup(fz_context *ctx, const char *s);
 */
 void fz_free(fz_context *ctx, void *p);
 
+/*
+	fz_malloc_small: Allocate a small block of memory (with
+	scavenging) for a fixed size object that is created and
+	destroyed often, such as a pdf_obj or a store item.
+
+	Each context keeps a short free list of blocks of each small
+	size, filled by fz_free_small, and serves allocations from it
+	before calling the allocator. The lists are not shared, so no
+	locking is involved. Larger sizes go straight to fz_malloc.
+
+	size: The number of bytes to allocate.
+
+	Returns a pointer to the allocated (uncleared) block. Throws
+	exception on failure to allocate.
+*/
+void *fz_malloc_small(fz_context *ctx, unsigned int size);
+
+/*
+	fz_free_small: Free a block allocated with fz_malloc_small.
+
+	size must be the size the block was allocated with. The block
+	may be freed using any context, not only the one that allocated
+	it. Blocks from fz_malloc must not be passed in, nor blocks from
+	fz_malloc_small to fz_free.
+
+	Does not throw exceptions.
+*/
+void fz_free_small(fz_context *ctx, void *p, unsigned int size);
+
+/*
+	fz_set_alloc_arena: Enable or disable the small block free
+	lists of a context (see fz_malloc_small). They are enabled by
+	default, and cloned contexts inherit the setting. Disabling
+	returns any cached blocks to the allocator.
+*/
+void fz_set_alloc_arena(fz_context *ctx, int enable);
+
+typedef struct fz_alloc_arena_stats_s fz_alloc_arena_stats;
+
+struct fz_alloc_arena_stats_s
+{
+	int hits; /* fz_malloc_small calls served from the free lists */
+	int misses; /* fz_malloc_small calls passed to the allocator */
+	int kept; /* fz_free_small calls that kept the block */
+	int released; /* fz_free_small calls that freed the block */
+};
+
+/*
+	fz_get_alloc_arena_stats: Read the small block counters of
+	this context.
+*/
+void fz_get_alloc_arena_stats(fz_context *ctx, fz_alloc_arena_stats *stats);
+
+/*
+	fz_dump_alloc_arena_stats: Print the small block counters of
+	this context to stdout.
+*/
+void fz_dump_alloc_arena_stats(fz_context *ctx);
+
 /*
 	fz_malloc_no_throw: Allocate a block of memory (with scavenging)
 
@@ -409,6 +600,10 @@ struct fz_warn_context_s
 
 fz_context *fz_clone_context_internal(fz_context *ctx);
 
+void fz_new_alloc_arena(fz_context *ctx);
+void fz_drop_alloc_arena(fz_context *ctx);
+void fz_copy_alloc_arena(fz_context *dst, fz_context *src);
+
 void fz_new_aa_context(fz_context *ctx);
 void fz_drop_aa_context(fz_context *ctx);
 void fz_copy_aa_context(fz_context *dst, fz_context *src);
@@ -457,6 +652,18 @@ fz_unlock(fz_context *ctx, int lock)
 	ctx->locks->unlock(ctx->locks->user, lock);
 }
 
+static inline void
+fz_wait(fz_context *ctx, int lock)
+{
+	ctx->waiter->wait(ctx->waiter->user, lock);
+}
+
+static inline void
+fz_wake(fz_context *ctx, int lock)
+{
+	ctx->waiter->wake(ctx->waiter->user, lock);
+}
+
 static inline void *
 fz_keep_imp(fz_context *ctx, void *p, int *refs)
 {
@@ -62,7 +62,9 @@ fz_device *fz_new_list_device(fz_context *ctx, fz_display_list *list);
 	area: Only the part of the contents of the display list
 	visible within this area will be considered when the list is
 	run through the device. This does not imply for tile objects
-	contained in the display list.
+	contained in the display list. The list keeps an index of the
+	extents of runs of commands, so that runs lying entirely outside
+	this area are skipped without being decoded.
 
 	cookie: Communication mechanism between caller and library
 	running the page. Intended for multi-threaded applications,
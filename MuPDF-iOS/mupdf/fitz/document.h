@@ -177,6 +177,10 @@ void fz_layout_document(fz_context *ctx, fz_document *doc, float w, float h, flo
 	fz_count_pages: Return the number of pages in document
 
 	May return 0 for documents with no pages.
+
+	Reflowable documents that are laid out on demand (EPUB) return an
+	estimate until all their pages have been loaded; the estimate is
+	refined as pages are loaded.
 */
 int fz_count_pages(fz_context *ctx, fz_document *doc);
 
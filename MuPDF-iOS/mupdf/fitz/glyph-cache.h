@@ -18,6 +18,19 @@ fz_glyph_cache *fz_keep_glyph_cache(fz_context *ctx);
 void fz_drop_glyph_cache_context(fz_context *ctx);
 void fz_purge_glyph_cache(fz_context *ctx);
 
+/*
+	fz_set_glyph_cache_size: Set the maximum number of bytes of
+	rendered glyphs kept in the shared glyph cache. Glyphs beyond
+	the new limit are evicted immediately. The default is 1MB.
+*/
+void fz_set_glyph_cache_size(fz_context *ctx, unsigned int max);
+
+/*
+	fz_glyph_cache_size: Return the maximum size of the shared glyph
+	cache in bytes.
+*/
+unsigned int fz_glyph_cache_size(fz_context *ctx);
+
 fz_path *fz_outline_ft_glyph(fz_context *ctx, fz_font *font, int gid, const fz_matrix *trm);
 fz_path *fz_outline_glyph(fz_context *ctx, fz_font *font, int gid, const fz_matrix *ctm);
 fz_glyph *fz_render_ft_glyph(fz_context *ctx, fz_font *font, int cid, const fz_matrix *trm, int aa);
@@ -32,6 +45,12 @@ fz_glyph *fz_render_stroked_glyph(fz_context *ctx, fz_font*, int, fz_matrix *, c
 fz_pixmap *fz_render_stroked_glyph_pixmap(fz_context *ctx, fz_font*, int, fz_matrix *, const fz_matrix *, fz_stroke_state *stroke, const fz_irect *scissor);
 void fz_render_t3_glyph_direct(fz_context *ctx, fz_device *dev, fz_font *font, int gid, const fz_matrix *trm, void *gstate, int nestedDepth);
 void fz_prepare_t3_glyph(fz_context *ctx, fz_font *font, int gid, int nestedDepth);
+
+/*
+	fz_dump_glyph_cache_stats: Print the size of the glyph cache
+	together with its hit, miss and eviction counters to stdout.
+	Front cache hits are only counted for the calling context.
+*/
 void fz_dump_glyph_cache_stats(fz_context *ctx);
 float fz_subpixel_adjust(fz_context *ctx, fz_matrix *ctm, fz_matrix *subpix_ctm, unsigned char *qe, unsigned char *qf);
 
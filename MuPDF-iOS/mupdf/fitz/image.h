@@ -57,6 +57,31 @@ fz_image *fz_new_image_from_pixmap(fz_context *ctx, fz_pixmap *pixmap, fz_image
 fz_image *fz_new_image_from_data(fz_context *ctx, unsigned char *data, int len);
 fz_image *fz_new_image_from_buffer(fz_context *ctx, fz_buffer *buffer);
 fz_pixmap *fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h);
+
+/*
+	fz_image_get_pixmap_region: Get a pixmap holding part of an image,
+	decoding (and caching) no more of it than needed where the image
+	type allows that.
+
+	subarea: On entry, the area of the image wanted, in image pixels
+	(from 0,0 to image->w,image->h). On exit, the area the returned
+	pixmap covers. This may be larger than asked for; the area is
+	rounded out so that nearby requests can share decoded data, and
+	is the whole image if the image cannot be decoded in parts, or if
+	it is already held decoded.
+
+	w, h: The desired size of the whole image in pixels, used to pick
+	a subsample factor as for fz_new_pixmap_from_image.
+
+	l2factor: If less than the whole image is returned, set to the
+	power of two it is subsampled by. The pixmap then starts at pixel
+	(subarea->x0 >> *l2factor, subarea->y0 >> *l2factor) of the image
+	subsampled as a whole, which is ((image->w + (1 << *l2factor) - 1)
+	>> *l2factor) pixels wide, and so on.
+
+	Returns a non NULL pixmap pointer. May throw exceptions.
+*/
+fz_pixmap *fz_image_get_pixmap_region(fz_context *ctx, fz_image *image, fz_irect *subarea, int w, int h, int *l2factor);
 void fz_drop_image_imp(fz_context *ctx, fz_storable *image);
 fz_pixmap *fz_decomp_image_from_stream(fz_context *ctx, fz_stream *stm, fz_image *image, int indexed, int l2factor, int native_l2factor);
 fz_pixmap *fz_expand_indexed_pixmap(fz_context *ctx, fz_pixmap *src);
@@ -78,9 +103,11 @@ struct fz_image_s
 	int xres; /* As given in the image, not necessarily as rendered */
 	int yres; /* As given in the image, not necessarily as rendered */
 	int invert_cmyk_jpeg;
+	int part_rows; /* Rows read to decode parts; see fz_image_get_pixmap_region */
 };
 
 fz_pixmap *fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *cs, int indexed);
+fz_pixmap *fz_load_jpx_region(fz_context *ctx, unsigned char *data, int size, fz_colorspace *cs, int indexed, const fz_irect *area);
 fz_pixmap *fz_load_png(fz_context *ctx, unsigned char *data, int size);
 fz_pixmap *fz_load_tiff(fz_context *ctx, unsigned char *data, int size);
 fz_pixmap *fz_load_jxr(fz_context *ctx, unsigned char *data, int size);
@@ -88,11 +115,66 @@ fz_pixmap *fz_load_jxr(fz_context *ctx, unsigned char *data, int size);
 void fz_load_jpeg_info(fz_context *ctx, unsigned char *data, int size, int *w, int *h, int *xres, int *yres, fz_colorspace **cspace);
 void fz_load_png_info(fz_context *ctx, unsigned char *data, int size, int *w, int *h, int *xres, int *yres, fz_colorspace **cspace);
 void fz_load_tiff_info(fz_context *ctx, unsigned char *data, int size, int *w, int *h, int *xres, int *yres, fz_colorspace **cspace);
+void fz_load_jpx_info(fz_context *ctx, unsigned char *data, int size, int *w, int *h, int *xres, int *yres, fz_colorspace **cspace);
 void fz_load_jxr_info(fz_context *ctx, unsigned char *data, int size, int *w, int *h, int *xres, int *yres, fz_colorspace **cspace);
 
 int fz_load_tiff_subimage_count(fz_context *ctx, unsigned char *buf, int len);
 fz_pixmap *fz_load_tiff_subimage(fz_context *ctx, unsigned char *buf, int len, int subimage);
 
+/*
+	fz_load_tiff_ifd_offsets: Walk the chain of IFDs of a TIFF file
+	read through a seekable stream, without reading the image data.
+
+	countp: Set to the number of subimages.
+
+	Returns an array of the file offsets of their IFDs, to be freed by
+	the caller. May throw exceptions.
+*/
+unsigned *fz_load_tiff_ifd_offsets(fz_context *ctx, fz_stream *stm, int *countp);
+
+/*
+	fz_extract_tiff_subimage: Read the subimage with the IFD at the
+	given offset (see fz_load_tiff_ifd_offsets) out of a TIFF file,
+	into a buffer holding a TIFF file of its own. Only the tags that
+	decoding uses, and the strips, are read from the file.
+
+	The buffer can be made into an image with fz_new_image_from_buffer.
+	May throw exceptions.
+*/
+fz_buffer *fz_extract_tiff_subimage(fz_context *ctx, fz_stream *stm, unsigned ifd_offset);
+
 void fz_image_get_sanitised_res(fz_image *image, int *xres, int *yres);
 
+/*
+	Images being decoded are listed in the image context, shared
+	between cloned contexts, so that a thread wanting an image that
+	another thread is decoding (at the same subsample factor and for
+	the same area) waits for that decode and shares its result rather
+	than decoding it again. This needs a waiter (see fz_set_waiter).
+*/
+void fz_new_image_context(fz_context *ctx);
+fz_image_context *fz_keep_image_context(fz_context *ctx);
+void fz_drop_image_context(fz_context *ctx);
+
+typedef struct fz_image_decode_stats_s fz_image_decode_stats;
+
+struct fz_image_decode_stats_s
+{
+	int decodes; /* images (or parts of images) decoded */
+	int waits; /* times a thread waited for another's decode */
+	int saved; /* waits that ended with a decoded image to share */
+};
+
+/*
+	fz_get_image_decode_stats: Read the image decoding counters,
+	which are shared by all contexts cloned from the same one.
+*/
+void fz_get_image_decode_stats(fz_context *ctx, fz_image_decode_stats *stats);
+
+/*
+	fz_dump_image_decode_stats: Print the image decoding counters
+	to stdout.
+*/
+void fz_dump_image_decode_stats(fz_context *ctx);
+
 #endif
@@ -33,6 +33,9 @@ float fz_atof(const char *s);
 /* atoi that copes with NULL */
 int fz_atoi(const char *s);
 
+/* atoi for file offsets; copes with NULL */
+fz_off_t fz_atoo(const char *s);
+
 /*
 	Some standard math functions, done as static inlines for speed.
 	People with compilers that do not adequately implement inlines may
@@ -87,7 +87,8 @@ int fz_vfprintf(fz_context *ctx, FILE *file, const char *fmt, va_list ap);
 
 /*
 	fz_vsnprintf: Our customised vsnprintf routine. Takes %c, %d, %o, %s, %x, as usual.
-	Modifiers are not supported except for zero-padding ints (e.g. %02d, %03o, %04x, etc).
+	Modifiers are not supported except for zero-padding ints (e.g. %02d, %03o, %010x, etc)
+	and the l, ll and I64 integer lengths, so FZ_FMT_OFF can be used for fz_off_t.
 	%f and %g both output in "as short as possible hopefully lossless non-exponent" form,
 	see fz_ftoa for specifics.
 	%C outputs a utf8 encoded int.
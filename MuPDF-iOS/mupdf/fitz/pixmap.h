@@ -295,6 +295,22 @@ fz_scale_cache *fz_new_scale_cache(fz_context *ctx);
 void fz_drop_scale_cache(fz_context *ctx, fz_scale_cache *cache);
 fz_pixmap *fz_scale_pixmap_cached(fz_context *ctx, fz_pixmap *src, float x, float y, float w, float h, const fz_irect *clip, fz_scale_cache *cache_x, fz_scale_cache *cache_y);
 
+/*
+	fz_scale_pixmap_part: Scale part of a source image, giving the same
+	pixels as scaling the whole of it would.
+
+	src: The pixels held of the source.
+
+	whole: The bounds of the whole source, in the pixels of src. So
+	whole->x0 and whole->y0 are 0 or less, and whole->x1 and whole->y1
+	at least src->w and src->h. NULL if src is the whole source.
+
+	x, y, w, h, clip: As for fz_scale_pixmap, but for the whole source.
+	Only destination pixels whose filter support lies within src come
+	out the same as for the whole source; keep the clip to those.
+*/
+fz_pixmap *fz_scale_pixmap_part(fz_context *ctx, fz_pixmap *src, const fz_irect *whole, float x, float y, float w, float h, const fz_irect *clip, fz_scale_cache *cache_x, fz_scale_cache *cache_y);
+
 void fz_subsample_pixmap(fz_context *ctx, fz_pixmap *tile, int factor);
 
 fz_irect *fz_pixmap_bbox_no_ctx(fz_pixmap *src, fz_irect *bbox);
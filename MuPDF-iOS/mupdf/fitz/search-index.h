@@ -0,0 +1,111 @@
+#ifndef MUPDF_FITZ_SEARCH_INDEX_H
+#define MUPDF_FITZ_SEARCH_INDEX_H
+
+#include "mupdf/fitz/system.h"
+#include "mupdf/fitz/context.h"
+#include "mupdf/fitz/buffer.h"
+#include "mupdf/fitz/stream.h"
+#include "mupdf/fitz/output.h"
+#include "mupdf/fitz/structured-text.h"
+
+/*
+	Search indexes
+
+	A search index maps the words of a document to the places they
+	occur, so that a document can be searched without extracting the
+	text of every page again. It is built a page at a time from the
+	text pages made by the text device, and can be written out and
+	loaded again later.
+
+	Words are runs of letters, marks and digits. They are indexed
+	lower case (for ASCII), without accents, and cut to
+	FZ_SEARCH_INDEX_TERM_MAX - 1 bytes of UTF-8.
+
+	A saved index carries an identifier of the document file it was
+	made from (see fz_search_index_file_id), and is only loaded for a
+	file with the same identifier.
+*/
+
+typedef struct fz_search_index_s fz_search_index;
+typedef struct fz_search_hit_s fz_search_hit;
+
+enum { FZ_SEARCH_INDEX_TERM_MAX = 32 };
+
+/*
+	fz_search_hit: A place a phrase was found.
+
+	page: The page number.
+
+	offset, len: The characters of the page holding the phrase, as
+	counted by fz_text_char_at.
+*/
+struct fz_search_hit_s
+{
+	int page;
+	int offset;
+	int len;
+};
+
+/*
+	fz_search_index_file_id: Make an identifier for the file read
+	by a (seekable) stream, from its length and the data at its start
+	and end. This is cheap enough to do before every search, while
+	telling a changed file (including one with an update appended)
+	from the one an index was made from.
+*/
+void fz_search_index_file_id(fz_context *ctx, fz_stream *stm, unsigned char id[16]);
+
+/*
+	fz_new_search_index: Create an empty search index for the file
+	with the given identifier.
+*/
+fz_search_index *fz_new_search_index(fz_context *ctx, const unsigned char id[16]);
+
+/*
+	fz_drop_search_index: Free a search index.
+*/
+void fz_drop_search_index(fz_context *ctx, fz_search_index *index);
+
+/*
+	fz_search_index_add_page: Add the words of a text page to an
+	index being built. Pages may be added in any order, but each only
+	once.
+*/
+void fz_search_index_add_page(fz_context *ctx, fz_search_index *index, int number, fz_text_page *page);
+
+/*
+	fz_count_search_index_pages: Return the number of pages added to
+	an index.
+*/
+int fz_count_search_index_pages(fz_context *ctx, fz_search_index *index);
+
+/*
+	fz_write_search_index: Write an index out in a compact form that
+	fz_load_search_index can read.
+*/
+void fz_write_search_index(fz_context *ctx, fz_output *out, fz_search_index *index);
+
+/*
+	fz_load_search_index: Load an index written by
+	fz_write_search_index. The index keeps a reference to the buffer,
+	and decodes only the parts that searches need.
+
+	Returns NULL if the buffer does not hold an index for the file
+	with the given identifier (as when the file has changed). Throws
+	if it holds a damaged one. No more pages may be added to a loaded
+	index.
+*/
+fz_search_index *fz_load_search_index(fz_context *ctx, fz_buffer *buf, const unsigned char id[16]);
+
+/*
+	fz_search_index_lookup: Find the places a phrase of one or more
+	words occurs, in page order. The phrase may have any number of
+	words; each is matched, like the words of pages, by at most its
+	first FZ_SEARCH_INDEX_TERM_MAX - 1 bytes once folded.
+
+	Returns the number of hits found, of which the first hit_max are
+	stored in hits.
+*/
+int fz_search_index_lookup(fz_context *ctx, fz_search_index *index, const char *phrase, fz_search_hit *hits, int hit_max);
+
+#endif
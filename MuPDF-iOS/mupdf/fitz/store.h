@@ -57,6 +57,13 @@ void fz_drop_storable(fz_context *, fz_storable *);
 	to an fz_store_hash structure. If make_hash_key function returns 0,
 	then the key is determined not to be hashable, and the value is
 	not stored in the hash table.
+
+	Internally the store is split into FZ_STORE_SHARDS shards, chosen
+	by a hash of the key, each with its own lock, list and hash table,
+	so that threads looking up different items rarely contend. The
+	size limit applies to the store as a whole; when it is exceeded,
+	a clock sweep visits the shards in turn evicting unused items,
+	sparing those that have been looked up since it last passed.
 */
 typedef struct fz_store_hash_s fz_store_hash;
 
@@ -81,6 +88,17 @@ struct fz_store_hash_s
 			int id;
 			float m[4];
 		} im;
+		struct
+		{
+			void *ptr[2];
+			int i;
+		} ppi;
+		struct
+		{
+			void *ptr;
+			int i;
+			int r[4];
+		} pir;
 	} u;
 };
 
@@ -179,6 +197,11 @@ void fz_empty_store(fz_context *ctx);
 
 	phase: What phase of the scavenge we are in. Updated on exit.
 
+	Only called once an allocation has failed; allocations that
+	succeed never reach the store. Called with FZ_LOCK_ALLOC held,
+	which serialises concurrent scavenges. This is dropped while
+	items are being evicted, and retaken before returning.
+
 	Returns non zero if we managed to free any memory.
 */
 int fz_store_scavenge(fz_context *ctx, unsigned int size, int *phase);
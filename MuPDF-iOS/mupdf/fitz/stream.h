@@ -52,6 +52,31 @@ fz_stream *fz_open_file_w(fz_context *ctx, const wchar_t *filename);
 */
 fz_stream *fz_open_fd(fz_context *ctx, int file);
 
+/*
+	fz_open_file_mapped: Open the named file by mapping it into memory.
+
+	Reads are served directly from the mapping, and seeking costs
+	nothing. Unfiltered data read through fz_open_null (and so
+	uncompressed PDF stream bodies) is not copied, and fz_read_all
+	returns buffers that share the mapping rather than copies of it.
+
+	The file must not be truncated or rewritten in place while the
+	stream (or any buffer read from it) is alive; writing a new file
+	and renaming it over the old one is safe.
+
+	Falls back to fz_open_file if the file cannot be mapped (for
+	instance on platforms without mmap, or if there is not enough
+	address space).
+*/
+fz_stream *fz_open_file_mapped(fz_context *ctx, const char *filename);
+
+/*
+	fz_open_fd_mapped: Map an open file descriptor into memory and
+	wrap it in a stream. As fz_open_file_mapped; takes ownership of
+	the file descriptor as fz_open_fd does.
+*/
+fz_stream *fz_open_fd_mapped(fz_context *ctx, int file);
+
 /*
 	fz_open_memory: Open a block of memory as a stream.
 
@@ -104,7 +129,7 @@ void fz_drop_stream(fz_context *ctx, fz_stream *stm);
 /*
 	fz_tell: return the current reading position within a stream
 */
-int fz_tell(fz_context *ctx, fz_stream *stm);
+fz_off_t fz_tell(fz_context *ctx, fz_stream *stm);
 
 /*
 	fz_seek: Seek within a stream.
@@ -115,7 +140,7 @@ int fz_tell(fz_context *ctx, fz_stream *stm);
 
 	whence: From where the offset is measured (see fseek).
 */
-void fz_seek(fz_context *ctx, fz_stream *stm, int offset, int whence);
+void fz_seek(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence);
 
 /*
 	fz_read: Read from a stream into a given data block.
@@ -150,14 +175,33 @@ fz_buffer *fz_read_file(fz_context *ctx, const char *filename);
 enum
 {
 	FZ_STREAM_META_PROGRESSIVE = 1,
-	FZ_STREAM_META_LENGTH = 2
+	FZ_STREAM_META_LENGTH = 2,
+	FZ_STREAM_META_MEMORY = 3
+};
+
+/*
+	fz_stream_memory: Returned by FZ_STREAM_META_MEMORY (ptr points to
+	one of these, and 1 is returned) for streams that read from a block
+	of memory that stays valid and unchanged for as long as the stream
+	is held. Position p in the stream is data[p], for p < len.
+
+	buffer, if not NULL, is a buffer that owns the data and may be
+	passed to fz_new_buffer_slice; no new reference is taken.
+*/
+typedef struct fz_stream_memory_s fz_stream_memory;
+
+struct fz_stream_memory_s
+{
+	unsigned char *data;
+	fz_off_t len;
+	fz_buffer *buffer;
 };
 
 int fz_stream_meta(fz_context *ctx, fz_stream *stm, int key, int size, void *ptr);
 
 typedef int (fz_stream_next_fn)(fz_context *ctx, fz_stream *stm, int max);
 typedef void (fz_stream_close_fn)(fz_context *ctx, void *state);
-typedef void (fz_stream_seek_fn)(fz_context *ctx, fz_stream *stm, int offset, int whence);
+typedef void (fz_stream_seek_fn)(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence);
 typedef int (fz_stream_meta_fn)(fz_context *ctx, fz_stream *stm, int key, int size, void *ptr);
 
 struct fz_stream_s
@@ -165,7 +209,7 @@ struct fz_stream_s
 	int refs;
 	int error;
 	int eof;
-	int pos;
+	fz_off_t pos;
 	int avail;
 	int bits;
 	unsigned char *rp, *wp;
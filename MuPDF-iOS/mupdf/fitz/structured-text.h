@@ -26,6 +26,7 @@ typedef struct fz_page_block_s fz_page_block;
 
 typedef struct fz_text_sheet_s fz_text_sheet;
 typedef struct fz_text_page_s fz_text_page;
+typedef struct fz_text_index_s fz_text_index;
 
 /*
 	fz_text_sheet: A text sheet contains a list of distinct text styles
@@ -64,6 +65,7 @@ struct fz_text_page_s
 	int len, cap;
 	fz_page_block *blocks;
 	fz_text_page *next;
+	fz_text_index *index; /* Private: built by search and selection */
 };
 
 /*
@@ -176,8 +178,23 @@ struct fz_char_and_box_s
 	fz_rect bbox;
 };
 
+/*
+	fz_text_char_at: Return the character and bbox at a given index
+	into the text of a page, counting the characters of each line and
+	a pseudo-newline (a space with an empty bbox) after each line.
+
+	The first call builds an index of the text of the page, which is
+	kept with the page and shared with search and selection.
+*/
 fz_char_and_box *fz_text_char_at(fz_context *ctx, fz_char_and_box *cab, fz_text_page *page, int idx);
 
+/*
+	fz_drop_text_page_index: Discard the index of the text of a
+	page. This must be called if the page is changed after it has
+	been searched; the text device and fz_analyze_text do so.
+*/
+void fz_drop_text_page_index(fz_context *ctx, fz_text_page *page);
+
 /*
 	fz_text_char_bbox: Return the bbox of a text char. Calculated from
 	the supplied enclosing span.
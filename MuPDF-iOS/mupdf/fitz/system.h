@@ -1,6 +1,20 @@
 #ifndef MUPDF_FITZ_SYSTEM_H
 #define MUPDF_FITZ_SYSTEM_H
 
+/*
+	Ask for 64-bit off_t, fseeko and ftello on platforms where they are
+	not the default. This must come before any libc header.
+*/
+
+#ifndef _WIN32
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+#ifndef _LARGEFILE_SOURCE
+#define _LARGEFILE_SOURCE
+#endif
+#endif
+
 /*
 	Include the standard libc headers.
 */
@@ -114,6 +128,7 @@ void fz_free_argv(int argc, char **argv);
 #else /* Unix or close enough */
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <unistd.h>
 
 #ifndef O_BINARY
@@ -124,6 +139,34 @@ void fz_free_argv(int argc, char **argv);
 
 #endif
 
+/*
+	64-bit file offsets
+
+	fz_off_t holds positions within files and streams, and lengths of
+	data read from them, so that files larger than 2GB can be handled.
+	fz_fseek, fz_ftell and fz_lseek are the 64-bit versions of the libc
+	functions. FZ_FMT_OFF is the printf conversion for an fz_off_t,
+	without the leading '%' so that flags and widths can be given:
+
+		fprintf(out, "%010" FZ_FMT_OFF, ofs);
+*/
+
+#ifdef _MSC_VER
+typedef __int64 fz_off_t;
+#define FZ_OFF_T_MAX _I64_MAX
+#define FZ_FMT_OFF "I64d"
+#define fz_fseek _fseeki64
+#define fz_ftell _ftelli64
+#define fz_lseek _lseeki64
+#else
+typedef int64_t fz_off_t;
+#define FZ_OFF_T_MAX INT64_MAX
+#define FZ_FMT_OFF PRId64
+#define fz_fseek fseeko
+#define fz_ftell ftello
+#define fz_lseek lseek
+#endif
+
 #ifdef __ANDROID__
 #include <android/log.h>
 #define LOG_TAG "libmupdf"
@@ -221,6 +264,16 @@ extern void __gnu_mcount_nc(void);
 #endif
 #endif
 
+/* x86 SIMD specific defines */
+
+/* SSE2 is always available on x86-64; wider instruction sets are
+ * compiled with per-function target attributes and picked at runtime.
+ * Define FZ_NO_SIMD to build the portable C code only. */
+#if !defined(FZ_NO_SIMD) && defined(__GNUC__) && \
+	(defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define ARCH_X86_SIMD
+#endif
+
 #ifdef CLUSTER
 #define LOCAL_TRIG_FNS
 #endif
@@ -12,6 +12,7 @@ typedef struct pdf_annot_s pdf_annot;
 typedef struct pdf_widget_s pdf_widget;
 typedef struct pdf_hotspot_s pdf_hotspot;
 typedef struct pdf_js_s pdf_js;
+typedef struct pdf_rev_page_map_s pdf_rev_page_map;
 
 enum
 {
@@ -24,7 +25,7 @@ struct pdf_lexbuf_s
 	int size;
 	int base_size;
 	int len;
-	int i;
+	fz_off_t i;
 	float f;
 	char *scratch;
 	char buffer[PDF_LEXBUF_SMALL];
@@ -36,6 +37,12 @@ struct pdf_lexbuf_large_s
 	char buffer[PDF_LEXBUF_LARGE - PDF_LEXBUF_SMALL];
 };
 
+struct pdf_rev_page_map_s
+{
+	int object; /* Page object number */
+	int page; /* Page number, or -1 if the object is used for several pages */
+};
+
 struct pdf_hotspot_s
 {
 	int num;
@@ -70,6 +77,10 @@ typedef void (pdf_doc_event_cb)(fz_context *ctx, pdf_document *doc, pdf_doc_even
 	functions implicitly get access to the global state in
 	context.
 
+	The file is memory mapped where possible (see
+	fz_open_file_mapped), so it must not be overwritten in place
+	while the document is open.
+
 	filename: a path to a file as it would be given to open(2).
 */
 pdf_document *pdf_open_document(fz_context *ctx, const char *filename);
@@ -191,8 +202,8 @@ struct pdf_document_s
 	fz_stream *file;
 
 	int version;
-	int startxref;
-	int file_size;
+	fz_off_t startxref;
+	fz_off_t file_size;
 	pdf_crypt *crypt;
 	pdf_ocg_descriptor *ocg;
 	pdf_hotspot hotspot;
@@ -207,21 +218,28 @@ struct pdf_document_s
 
 	int page_count;
 
+	/* Flattened page tree, built on first lookup; see pdf_drop_page_map */
+	int page_map_state;
+	int page_map_len;
+	pdf_obj **page_map;
+	int rev_page_map_len;
+	pdf_rev_page_map *rev_page_map; /* Sorted by object number */
+
 	int repair_attempted;
 
 	/* State indicating which file parsing method we are using */
 	int file_reading_linearly;
-	int file_length;
+	fz_off_t file_length;
 
 	pdf_obj *linear_obj; /* Linearized object (if used) */
 	pdf_obj **linear_page_refs; /* Page objects for linear loading */
 	int linear_page1_obj_num;
 
 	/* The state for the pdf_progressive_advance parser */
-	int linear_pos;
+	fz_off_t linear_pos;
 	int linear_page_num;
 
-	int hint_object_offset;
+	fz_off_t hint_object_offset;
 	int hint_object_length;
 	int hints_loaded; /* Set to 1 after the hints loading has completed,
 			   * whether successful or not! */
@@ -242,17 +260,17 @@ struct pdf_document_s
 	struct
 	{
 		int number; /* Page object number */
-		int offset; /* Offset of page object */
+		fz_off_t offset; /* Offset of page object */
 		int index; /* Index into shared hint_shared_ref */
 	} *hint_page;
 	int *hint_shared_ref;
 	struct
 	{
 		int number; /* Object number of first object */
-		int offset; /* Offset of first object */
+		fz_off_t offset; /* Offset of first object */
 	} *hint_shared;
 	int hint_obj_offsets_max;
-	int *hint_obj_offsets;
+	fz_off_t *hint_obj_offsets;
 
 	int resources_localised;
 
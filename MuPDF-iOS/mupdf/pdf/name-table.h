@@ -0,0 +1,298 @@
+/*
+	Well known names, kept sorted (by strcmp) so that pdf_new_name can
+	find them by binary search. Each is available as a constant object
+	with PDF_NAME(NAME).
+*/
+PDF_MAKE_NAME("A", A)
+PDF_MAKE_NAME("A85", A85)
+PDF_MAKE_NAME("AA", AA)
+PDF_MAKE_NAME("AESV2", AESV2)
+PDF_MAKE_NAME("AESV3", AESV3)
+PDF_MAKE_NAME("AHx", AHx)
+PDF_MAKE_NAME("AP", AP)
+PDF_MAKE_NAME("AS", AS)
+PDF_MAKE_NAME("ASCII85Decode", ASCII85Decode)
+PDF_MAKE_NAME("ASCIIHexDecode", ASCIIHexDecode)
+PDF_MAKE_NAME("AcroForm", AcroForm)
+PDF_MAKE_NAME("Action", Action)
+PDF_MAKE_NAME("Alternate", Alternate)
+PDF_MAKE_NAME("Annot", Annot)
+PDF_MAKE_NAME("Annots", Annots)
+PDF_MAKE_NAME("ArtBox", ArtBox)
+PDF_MAKE_NAME("Ascent", Ascent)
+PDF_MAKE_NAME("Author", Author)
+PDF_MAKE_NAME("B", B)
+PDF_MAKE_NAME("BBox", BBox)
+PDF_MAKE_NAME("BC", BC)
+PDF_MAKE_NAME("BM", BM)
+PDF_MAKE_NAME("BPC", BPC)
+PDF_MAKE_NAME("BS", BS)
+PDF_MAKE_NAME("Background", Background)
+PDF_MAKE_NAME("BaseEncoding", BaseEncoding)
+PDF_MAKE_NAME("BaseFont", BaseFont)
+PDF_MAKE_NAME("BaseState", BaseState)
+PDF_MAKE_NAME("BitsPerComponent", BitsPerComponent)
+PDF_MAKE_NAME("BitsPerCoordinate", BitsPerCoordinate)
+PDF_MAKE_NAME("BitsPerFlag", BitsPerFlag)
+PDF_MAKE_NAME("BitsPerSample", BitsPerSample)
+PDF_MAKE_NAME("BlackIs1", BlackIs1)
+PDF_MAKE_NAME("BleedBox", BleedBox)
+PDF_MAKE_NAME("Border", Border)
+PDF_MAKE_NAME("Bounds", Bounds)
+PDF_MAKE_NAME("ByteRange", ByteRange)
+PDF_MAKE_NAME("C", C)
+PDF_MAKE_NAME("C0", C0)
+PDF_MAKE_NAME("C1", C1)
+PDF_MAKE_NAME("CA", CA)
+PDF_MAKE_NAME("CCF", CCF)
+PDF_MAKE_NAME("CCITTFaxDecode", CCITTFaxDecode)
+PDF_MAKE_NAME("CF", CF)
+PDF_MAKE_NAME("CFM", CFM)
+PDF_MAKE_NAME("CIDFontType0", CIDFontType0)
+PDF_MAKE_NAME("CIDFontType0C", CIDFontType0C)
+PDF_MAKE_NAME("CIDFontType2", CIDFontType2)
+PDF_MAKE_NAME("CIDSystemInfo", CIDSystemInfo)
+PDF_MAKE_NAME("CIDToGIDMap", CIDToGIDMap)
+PDF_MAKE_NAME("CS", CS)
+PDF_MAKE_NAME("CalGray", CalGray)
+PDF_MAKE_NAME("CalRGB", CalRGB)
+PDF_MAKE_NAME("CapHeight", CapHeight)
+PDF_MAKE_NAME("Catalog", Catalog)
+PDF_MAKE_NAME("CharProcs", CharProcs)
+PDF_MAKE_NAME("ColorSpace", ColorSpace)
+PDF_MAKE_NAME("ColorTransform", ColorTransform)
+PDF_MAKE_NAME("Colors", Colors)
+PDF_MAKE_NAME("Columns", Columns)
+PDF_MAKE_NAME("Configs", Configs)
+PDF_MAKE_NAME("Contents", Contents)
+PDF_MAKE_NAME("Coords", Coords)
+PDF_MAKE_NAME("Count", Count)
+PDF_MAKE_NAME("CreationDate", CreationDate)
+PDF_MAKE_NAME("Creator", Creator)
+PDF_MAKE_NAME("CropBox", CropBox)
+PDF_MAKE_NAME("Crypt", Crypt)
+PDF_MAKE_NAME("D", D)
+PDF_MAKE_NAME("DA", DA)
+PDF_MAKE_NAME("DCT", DCT)
+PDF_MAKE_NAME("DCTDecode", DCTDecode)
+PDF_MAKE_NAME("DOS", DOS)
+PDF_MAKE_NAME("DP", DP)
+PDF_MAKE_NAME("DV", DV)
+PDF_MAKE_NAME("DW", DW)
+PDF_MAKE_NAME("DW2", DW2)
+PDF_MAKE_NAME("DamagedRowsBeforeError", DamagedRowsBeforeError)
+PDF_MAKE_NAME("Decode", Decode)
+PDF_MAKE_NAME("DecodeParms", DecodeParms)
+PDF_MAKE_NAME("DescendantFonts", DescendantFonts)
+PDF_MAKE_NAME("Descent", Descent)
+PDF_MAKE_NAME("Dest", Dest)
+PDF_MAKE_NAME("Dests", Dests)
+PDF_MAKE_NAME("DeviceCMYK", DeviceCMYK)
+PDF_MAKE_NAME("DeviceGray", DeviceGray)
+PDF_MAKE_NAME("DeviceN", DeviceN)
+PDF_MAKE_NAME("DeviceRGB", DeviceRGB)
+PDF_MAKE_NAME("Di", Di)
+PDF_MAKE_NAME("Differences", Differences)
+PDF_MAKE_NAME("Dm", Dm)
+PDF_MAKE_NAME("Do", Do)
+PDF_MAKE_NAME("Domain", Domain)
+PDF_MAKE_NAME("Dur", Dur)
+PDF_MAKE_NAME("E", E)
+PDF_MAKE_NAME("EarlyChange", EarlyChange)
+PDF_MAKE_NAME("Encode", Encode)
+PDF_MAKE_NAME("EncodedByteAlign", EncodedByteAlign)
+PDF_MAKE_NAME("Encoding", Encoding)
+PDF_MAKE_NAME("Encrypt", Encrypt)
+PDF_MAKE_NAME("EncryptMetadata", EncryptMetadata)
+PDF_MAKE_NAME("EndOfBlock", EndOfBlock)
+PDF_MAKE_NAME("EndOfLine", EndOfLine)
+PDF_MAKE_NAME("Exclude", Exclude)
+PDF_MAKE_NAME("ExtGState", ExtGState)
+PDF_MAKE_NAME("Extend", Extend)
+PDF_MAKE_NAME("F", F)
+PDF_MAKE_NAME("FS", FS)
+PDF_MAKE_NAME("FT", FT)
+PDF_MAKE_NAME("Ff", Ff)
+PDF_MAKE_NAME("Fields", Fields)
+PDF_MAKE_NAME("Filter", Filter)
+PDF_MAKE_NAME("First", First)
+PDF_MAKE_NAME("FirstChar", FirstChar)
+PDF_MAKE_NAME("Fl", Fl)
+PDF_MAKE_NAME("Flags", Flags)
+PDF_MAKE_NAME("FlateDecode", FlateDecode)
+PDF_MAKE_NAME("Font", Font)
+PDF_MAKE_NAME("FontBBox", FontBBox)
+PDF_MAKE_NAME("FontDescriptor", FontDescriptor)
+PDF_MAKE_NAME("FontFile", FontFile)
+PDF_MAKE_NAME("FontFile2", FontFile2)
+PDF_MAKE_NAME("FontFile3", FontFile3)
+PDF_MAKE_NAME("FontMatrix", FontMatrix)
+PDF_MAKE_NAME("FontName", FontName)
+PDF_MAKE_NAME("Form", Form)
+PDF_MAKE_NAME("FormType", FormType)
+PDF_MAKE_NAME("Function", Function)
+PDF_MAKE_NAME("FunctionType", FunctionType)
+PDF_MAKE_NAME("Functions", Functions)
+PDF_MAKE_NAME("G", G)
+PDF_MAKE_NAME("GoTo", GoTo)
+PDF_MAKE_NAME("Group", Group)
+PDF_MAKE_NAME("H", H)
+PDF_MAKE_NAME("Height", Height)
+PDF_MAKE_NAME("I", I)
+PDF_MAKE_NAME("ICCBased", ICCBased)
+PDF_MAKE_NAME("ID", ID)
+PDF_MAKE_NAME("IM", IM)
+PDF_MAKE_NAME("Identity", Identity)
+PDF_MAKE_NAME("Image", Image)
+PDF_MAKE_NAME("ImageMask", ImageMask)
+PDF_MAKE_NAME("Index", Index)
+PDF_MAKE_NAME("Indexed", Indexed)
+PDF_MAKE_NAME("Info", Info)
+PDF_MAKE_NAME("InkList", InkList)
+PDF_MAKE_NAME("Intent", Intent)
+PDF_MAKE_NAME("Interpolate", Interpolate)
+PDF_MAKE_NAME("IsMap", IsMap)
+PDF_MAKE_NAME("ItalicAngle", ItalicAngle)
+PDF_MAKE_NAME("JBIG2Decode", JBIG2Decode)
+PDF_MAKE_NAME("JBIG2Globals", JBIG2Globals)
+PDF_MAKE_NAME("JPXDecode", JPXDecode)
+PDF_MAKE_NAME("JS", JS)
+PDF_MAKE_NAME("JavaScript", JavaScript)
+PDF_MAKE_NAME("K", K)
+PDF_MAKE_NAME("Keywords", Keywords)
+PDF_MAKE_NAME("Kids", Kids)
+PDF_MAKE_NAME("L", L)
+PDF_MAKE_NAME("LZW", LZW)
+PDF_MAKE_NAME("LZWDecode", LZWDecode)
+PDF_MAKE_NAME("Lab", Lab)
+PDF_MAKE_NAME("Lang", Lang)
+PDF_MAKE_NAME("LastChar", LastChar)
+PDF_MAKE_NAME("LastModified", LastModified)
+PDF_MAKE_NAME("Launch", Launch)
+PDF_MAKE_NAME("Length", Length)
+PDF_MAKE_NAME("Length1", Length1)
+PDF_MAKE_NAME("Length2", Length2)
+PDF_MAKE_NAME("Length3", Length3)
+PDF_MAKE_NAME("Limits", Limits)
+PDF_MAKE_NAME("Linearized", Linearized)
+PDF_MAKE_NAME("Link", Link)
+PDF_MAKE_NAME("Luminosity", Luminosity)
+PDF_MAKE_NAME("M", M)
+PDF_MAKE_NAME("MarkInfo", MarkInfo)
+PDF_MAKE_NAME("Mask", Mask)
+PDF_MAKE_NAME("Matrix", Matrix)
+PDF_MAKE_NAME("Matte", Matte)
+PDF_MAKE_NAME("MediaBox", MediaBox)
+PDF_MAKE_NAME("Metadata", Metadata)
+PDF_MAKE_NAME("MissingWidth", MissingWidth)
+PDF_MAKE_NAME("ModDate", ModDate)
+PDF_MAKE_NAME("Multiply", Multiply)
+PDF_MAKE_NAME("N", N)
+PDF_MAKE_NAME("Name", Name)
+PDF_MAKE_NAME("Names", Names)
+PDF_MAKE_NAME("NewWindow", NewWindow)
+PDF_MAKE_NAME("Next", Next)
+PDF_MAKE_NAME("Normal", Normal)
+PDF_MAKE_NAME("Nums", Nums)
+PDF_MAKE_NAME("O", O)
+PDF_MAKE_NAME("OC", OC)
+PDF_MAKE_NAME("OCGs", OCGs)
+PDF_MAKE_NAME("OE", OE)
+PDF_MAKE_NAME("OFF", OFF)
+PDF_MAKE_NAME("ON", ON)
+PDF_MAKE_NAME("ObjStm", ObjStm)
+PDF_MAKE_NAME("Off", Off)
+PDF_MAKE_NAME("OpenAction", OpenAction)
+PDF_MAKE_NAME("Opt", Opt)
+PDF_MAKE_NAME("Order", Order)
+PDF_MAKE_NAME("Ordering", Ordering)
+PDF_MAKE_NAME("Outlines", Outlines)
+PDF_MAKE_NAME("OutputIntents", OutputIntents)
+PDF_MAKE_NAME("P", P)
+PDF_MAKE_NAME("PDF", PDF)
+PDF_MAKE_NAME("Page", Page)
+PDF_MAKE_NAME("PageLabels", PageLabels)
+PDF_MAKE_NAME("PageMode", PageMode)
+PDF_MAKE_NAME("Pages", Pages)
+PDF_MAKE_NAME("PaintType", PaintType)
+PDF_MAKE_NAME("Parent", Parent)
+PDF_MAKE_NAME("Pattern", Pattern)
+PDF_MAKE_NAME("PatternType", PatternType)
+PDF_MAKE_NAME("PieceInfo", PieceInfo)
+PDF_MAKE_NAME("Predictor", Predictor)
+PDF_MAKE_NAME("Prev", Prev)
+PDF_MAKE_NAME("ProcSet", ProcSet)
+PDF_MAKE_NAME("Producer", Producer)
+PDF_MAKE_NAME("Properties", Properties)
+PDF_MAKE_NAME("QuadPoints", QuadPoints)
+PDF_MAKE_NAME("R", R)
+PDF_MAKE_NAME("RL", RL)
+PDF_MAKE_NAME("Range", Range)
+PDF_MAKE_NAME("Rect", Rect)
+PDF_MAKE_NAME("Registry", Registry)
+PDF_MAKE_NAME("Resources", Resources)
+PDF_MAKE_NAME("Root", Root)
+PDF_MAKE_NAME("Rotate", Rotate)
+PDF_MAKE_NAME("Rows", Rows)
+PDF_MAKE_NAME("RunLengthDecode", RunLengthDecode)
+PDF_MAKE_NAME("S", S)
+PDF_MAKE_NAME("SMask", SMask)
+PDF_MAKE_NAME("SMaskInData", SMaskInData)
+PDF_MAKE_NAME("Separation", Separation)
+PDF_MAKE_NAME("Sh", Sh)
+PDF_MAKE_NAME("Shading", Shading)
+PDF_MAKE_NAME("ShadingType", ShadingType)
+PDF_MAKE_NAME("Sig", Sig)
+PDF_MAKE_NAME("Size", Size)
+PDF_MAKE_NAME("Standard", Standard)
+PDF_MAKE_NAME("StmF", StmF)
+PDF_MAKE_NAME("StrF", StrF)
+PDF_MAKE_NAME("StructParents", StructParents)
+PDF_MAKE_NAME("SubFilter", SubFilter)
+PDF_MAKE_NAME("Subject", Subject)
+PDF_MAKE_NAME("Subtype", Subtype)
+PDF_MAKE_NAME("Subtype2", Subtype2)
+PDF_MAKE_NAME("T", T)
+PDF_MAKE_NAME("TR", TR)
+PDF_MAKE_NAME("TR2", TR2)
+PDF_MAKE_NAME("Tabs", Tabs)
+PDF_MAKE_NAME("Text", Text)
+PDF_MAKE_NAME("Threads", Threads)
+PDF_MAKE_NAME("Thumb", Thumb)
+PDF_MAKE_NAME("Title", Title)
+PDF_MAKE_NAME("ToUnicode", ToUnicode)
+PDF_MAKE_NAME("Trans", Trans)
+PDF_MAKE_NAME("Transparency", Transparency)
+PDF_MAKE_NAME("TrimBox", TrimBox)
+PDF_MAKE_NAME("TrueType", TrueType)
+PDF_MAKE_NAME("Type", Type)
+PDF_MAKE_NAME("Type0", Type0)
+PDF_MAKE_NAME("Type1", Type1)
+PDF_MAKE_NAME("Type3", Type3)
+PDF_MAKE_NAME("U", U)
+PDF_MAKE_NAME("UE", UE)
+PDF_MAKE_NAME("UF", UF)
+PDF_MAKE_NAME("URI", URI)
+PDF_MAKE_NAME("Unix", Unix)
+PDF_MAKE_NAME("Usage", Usage)
+PDF_MAKE_NAME("UseCMap", UseCMap)
+PDF_MAKE_NAME("UserUnit", UserUnit)
+PDF_MAKE_NAME("V", V)
+PDF_MAKE_NAME("V2", V2)
+PDF_MAKE_NAME("VE", VE)
+PDF_MAKE_NAME("VerticesPerRow", VerticesPerRow)
+PDF_MAKE_NAME("ViewerPreferences", ViewerPreferences)
+PDF_MAKE_NAME("W", W)
+PDF_MAKE_NAME("W2", W2)
+PDF_MAKE_NAME("WMode", WMode)
+PDF_MAKE_NAME("Widget", Widget)
+PDF_MAKE_NAME("Width", Width)
+PDF_MAKE_NAME("Widths", Widths)
+PDF_MAKE_NAME("WinAnsiEncoding", WinAnsiEncoding)
+PDF_MAKE_NAME("XHeight", XHeight)
+PDF_MAKE_NAME("XObject", XObject)
+PDF_MAKE_NAME("XRef", XRef)
+PDF_MAKE_NAME("XRefStm", XRefStm)
+PDF_MAKE_NAME("XStep", XStep)
+PDF_MAKE_NAME("YStep", YStep)
+PDF_MAKE_NAME("ca", ca)
@@ -5,6 +5,20 @@ int pdf_lookup_page_number(fz_context *ctx, pdf_document *doc, pdf_obj *pageobj)
 int pdf_count_pages(fz_context *ctx, pdf_document *doc);
 pdf_obj *pdf_lookup_page_obj(fz_context *ctx, pdf_document *doc, int needle);
 
+/*
+	pdf_drop_page_map: Forget the cached page number to page object
+	map.
+
+	The first page lookup flattens the page tree into a map, which
+	later lookups in either direction use instead of walking the
+	tree. pdf_insert_page and pdf_delete_page keep it up to date.
+	Code that edits /Kids or /Count itself must call this, or reset
+	doc->page_count to 0, before looking up pages again.
+
+	Does not throw exceptions.
+*/
+void pdf_drop_page_map(fz_context *ctx, pdf_document *doc);
+
 /*
 	pdf_load_page: Load a page and its resources.
 
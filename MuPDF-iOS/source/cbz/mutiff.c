@@ -2,6 +2,7 @@
 
 typedef struct tiff_document_s tiff_document;
 typedef struct tiff_page_s tiff_page;
+typedef struct tiff_image_key_s tiff_image_key;
 
 #define DPI 72.0f
 
@@ -14,10 +15,127 @@ struct tiff_page_s
 struct tiff_document_s
 {
 	fz_document super;
-	fz_buffer *buffer;
+	fz_stream *file;
+	unsigned *ifd_offsets;
 	int page_count;
 };
 
+/* The images of pages are kept in the store, so that a page loaded
+ * again can find its image, and the pixmaps decoded from it. */
+struct tiff_image_key_s
+{
+	int refs;
+	tiff_document *doc; /* not kept; items are removed when the document is closed */
+	int number;
+};
+
+static int
+tiff_make_hash_image_key(fz_context *ctx, fz_store_hash *hash, void *key_)
+{
+	tiff_image_key *key = (tiff_image_key *)key_;
+	hash->u.pi.ptr = key->doc;
+	hash->u.pi.i = key->number;
+	return 1;
+}
+
+static void *
+tiff_keep_image_key(fz_context *ctx, void *key_)
+{
+	tiff_image_key *key = (tiff_image_key *)key_;
+	return fz_keep_imp(ctx, key, &key->refs);
+}
+
+static void
+tiff_drop_image_key(fz_context *ctx, void *key_)
+{
+	tiff_image_key *key = (tiff_image_key *)key_;
+	if (fz_drop_imp(ctx, key, &key->refs))
+		fz_free(ctx, key);
+}
+
+static int
+tiff_cmp_image_key(fz_context *ctx, void *k0_, void *k1_)
+{
+	tiff_image_key *k0 = (tiff_image_key *)k0_;
+	tiff_image_key *k1 = (tiff_image_key *)k1_;
+	return k0->doc == k1->doc && k0->number == k1->number;
+}
+
+#ifndef NDEBUG
+static void
+tiff_debug_image_key(fz_context *ctx, FILE *out, void *key_)
+{
+	tiff_image_key *key = (tiff_image_key *)key_;
+	fprintf(out, "(tiff page %d) ", key->number);
+}
+#endif
+
+static fz_store_type tiff_image_store_type =
+{
+	tiff_make_hash_image_key,
+	tiff_keep_image_key,
+	tiff_drop_image_key,
+	tiff_cmp_image_key,
+#ifndef NDEBUG
+	tiff_debug_image_key
+#endif
+};
+
+/*
+	Return the image of a page, reading just its part of the file. The
+	image decodes (and stores) its pixmap when it is first drawn.
+*/
+static fz_image *
+tiff_load_image(fz_context *ctx, tiff_document *doc, int number)
+{
+	tiff_image_key key, *keyp = NULL;
+	fz_image *image;
+	fz_buffer *buffer;
+
+	key.refs = 1;
+	key.doc = doc;
+	key.number = number;
+
+	image = fz_find_item(ctx, fz_drop_image_imp, &key, &tiff_image_store_type);
+	if (image)
+		return image;
+
+	buffer = fz_extract_tiff_subimage(ctx, doc->file, doc->ifd_offsets[number]);
+	fz_try(ctx)
+		image = fz_new_image_from_buffer(ctx, buffer);
+	fz_always(ctx)
+		fz_drop_buffer(ctx, buffer);
+	fz_catch(ctx)
+		fz_rethrow(ctx);
+
+	fz_var(keyp);
+	fz_try(ctx)
+	{
+		fz_image *existing;
+
+		keyp = fz_malloc_struct(ctx, tiff_image_key);
+		*keyp = key;
+		existing = fz_store_item(ctx, keyp, image, sizeof *image + image->buffer->buffer->cap, &tiff_image_store_type);
+		if (existing)
+		{
+			/* The page is already stored; use that image */
+			fz_drop_image(ctx, image);
+			image = existing;
+		}
+	}
+	fz_always(ctx)
+	{
+		if (keyp)
+			tiff_drop_image_key(ctx, keyp);
+	}
+	fz_catch(ctx)
+	{
+		/* Do without storing it */
+	}
+
+	return image;
+}
+
 static fz_rect *
 tiff_bound_page(fz_context *ctx, tiff_page *page, fz_rect *bbox)
 {
@@ -57,36 +175,27 @@ tiff_drop_page_imp(fz_context *ctx, tiff_page *page)
 static tiff_page *
 tiff_load_page(fz_context *ctx, tiff_document *doc, int number)
 {
-	fz_pixmap *pixmap = NULL;
-	fz_image *image = NULL;
+	fz_image *image;
 	tiff_page *page = NULL;
 
 	if (number < 0 || number >= doc->page_count)
 		return NULL;
 
-	fz_var(pixmap);
-	fz_var(image);
 	fz_var(page);
 
+	image = tiff_load_image(ctx, doc, number);
+
 	fz_try(ctx)
 	{
-		pixmap = fz_load_tiff_subimage(ctx, doc->buffer->data, doc->buffer->len, number);
-		image = fz_new_image_from_pixmap(ctx, pixmap, NULL);
-
 		page = fz_new_page(ctx, sizeof *page);
 		page->super.bound_page = (fz_page_bound_page_fn *)tiff_bound_page;
 		page->super.run_page_contents = (fz_page_run_page_contents_fn *)tiff_run_page;
 		page->super.drop_page_imp = (fz_page_drop_page_imp_fn *)tiff_drop_page_imp;
-		page->image = fz_keep_image(ctx, image);
-	}
-	fz_always(ctx)
-	{
-		fz_drop_image(ctx, image);
-		fz_drop_pixmap(ctx, pixmap);
+		page->image = image;
 	}
 	fz_catch(ctx)
 	{
-		fz_free(ctx, page);
+		fz_drop_image(ctx, image);
 		fz_rethrow(ctx);
 	}
 
@@ -115,7 +224,14 @@ tiff_meta(fz_context *ctx, tiff_document *doc, int key, void *ptr, int size)
 static void
 tiff_close_document(fz_context *ctx, tiff_document *doc)
 {
-	fz_drop_buffer(ctx, doc->buffer);
+	tiff_image_key key;
+
+	key.refs = 1;
+	key.doc = doc;
+	for (key.number = 0; key.number < doc->page_count; key.number++)
+		fz_remove_item(ctx, fz_drop_image_imp, &key, &tiff_image_store_type);
+	fz_free(ctx, doc->ifd_offsets);
+	fz_drop_stream(ctx, doc->file);
 	fz_free(ctx, doc);
 }
 
@@ -133,8 +249,8 @@ tiff_open_document_with_stream(fz_context *ctx, fz_stream *file)
 
 	fz_try(ctx)
 	{
-		doc->buffer = fz_read_all(ctx, file, 1024);
-		doc->page_count = fz_load_tiff_subimage_count(ctx, doc->buffer->data, doc->buffer->len);
+		doc->file = fz_keep_stream(ctx, file);
+		doc->ifd_offsets = fz_load_tiff_ifd_offsets(ctx, file, &doc->page_count);
 	}
 	fz_catch(ctx)
 	{
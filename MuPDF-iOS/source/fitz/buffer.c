@@ -1,11 +1,13 @@
 #include "mupdf/fitz.h"
 
 fz_buffer *
-fz_new_buffer(fz_context *ctx, int size)
+fz_new_buffer(fz_context *ctx, fz_off_t size)
 {
 	fz_buffer *b;
 
 	size = size > 1 ? size : 16;
+	if (size > UINT_MAX)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "buffer too large");
 
 	b = fz_malloc_struct(ctx, fz_buffer);
 	b->refs = 1;
@@ -26,7 +28,7 @@ fz_new_buffer(fz_context *ctx, int size)
 }
 
 fz_buffer *
-fz_new_buffer_from_data(fz_context *ctx, unsigned char *data, int size)
+fz_new_buffer_from_data(fz_context *ctx, unsigned char *data, fz_off_t size)
 {
 	fz_buffer *b;
 
@@ -40,30 +42,72 @@ fz_new_buffer_from_data(fz_context *ctx, unsigned char *data, int size)
 	return b;
 }
 
+fz_buffer *
+fz_new_buffer_slice(fz_context *ctx, fz_buffer *parent, fz_off_t offset, fz_off_t len)
+{
+	fz_buffer *b;
+
+	if (offset < 0 || len < 0 || offset > parent->len || len > parent->len - offset)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "buffer slice out of range");
+
+	b = fz_malloc_struct(ctx, fz_buffer);
+	b->refs = 1;
+	b->data = parent->data + offset;
+	b->cap = len;
+	b->len = len;
+	b->unused_bits = 0;
+	b->shared = fz_keep_buffer(ctx, parent);
+
+	return b;
+}
+
+/* Slices and buffers with a custom drop_data may be shared across
+ * threads, so reference counts are taken under the alloc lock. */
 fz_buffer *
 fz_keep_buffer(fz_context *ctx, fz_buffer *buf)
 {
-	if (buf)
-		buf->refs ++;
-	return buf;
+	return fz_keep_imp(ctx, buf, &buf->refs);
+}
+
+static void
+fz_drop_buffer_data(fz_context *ctx, fz_buffer *buf)
+{
+	if (buf->shared)
+		fz_drop_buffer(ctx, buf->shared);
+	else if (buf->drop_data)
+		buf->drop_data(ctx, buf->data, buf->cap);
+	else
+		fz_free(ctx, buf->data);
 }
 
 void
 fz_drop_buffer(fz_context *ctx, fz_buffer *buf)
 {
-	if (!buf)
-		return;
-	if (--buf->refs == 0)
+	if (fz_drop_imp(ctx, buf, &buf->refs))
 	{
-		fz_free(ctx, buf->data);
+		fz_drop_buffer_data(ctx, buf);
 		fz_free(ctx, buf);
 	}
 }
 
 void
-fz_resize_buffer(fz_context *ctx, fz_buffer *buf, int size)
+fz_resize_buffer(fz_context *ctx, fz_buffer *buf, fz_off_t size)
 {
-	buf->data = fz_resize_array(ctx, buf->data, size, 1);
+	/* The allocator takes 32-bit sizes */
+	if (size > UINT_MAX)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "buffer too large");
+	if (buf->shared || buf->drop_data)
+	{
+		/* Take a private copy before the first change */
+		unsigned char *data = fz_malloc(ctx, size);
+		memcpy(data, buf->data, buf->len < size ? buf->len : size);
+		fz_drop_buffer_data(ctx, buf);
+		buf->shared = NULL;
+		buf->drop_data = NULL;
+		buf->data = data;
+	}
+	else
+		buf->data = fz_resize_array(ctx, buf->data, size, 1);
 	buf->cap = size;
 	if (buf->len > buf->cap)
 		buf->len = buf->cap;
@@ -72,16 +116,16 @@ fz_resize_buffer(fz_context *ctx, fz_buffer *buf, int size)
 void
 fz_grow_buffer(fz_context *ctx, fz_buffer *buf)
 {
-	int newsize = (buf->cap * 3) / 2;
+	fz_off_t newsize = (buf->cap * 3) / 2;
 	if (newsize == 0)
 		newsize = 256;
 	fz_resize_buffer(ctx, buf, newsize);
 }
 
 static void
-fz_ensure_buffer(fz_context *ctx, fz_buffer *buf, int min)
+fz_ensure_buffer(fz_context *ctx, fz_buffer *buf, fz_off_t min)
 {
-	int newsize = buf->cap;
+	fz_off_t newsize = buf->cap;
 	if (newsize < 16)
 		newsize = 16;
 	while (newsize < min)
@@ -98,7 +142,7 @@ fz_trim_buffer(fz_context *ctx, fz_buffer *buf)
 		fz_resize_buffer(ctx, buf, buf->len);
 }
 
-int
+fz_off_t
 fz_buffer_storage(fz_context *ctx, fz_buffer *buf, unsigned char **datap)
 {
 	if (datap)
@@ -110,10 +154,7 @@ void
 fz_buffer_cat(fz_context *ctx, fz_buffer *buf, fz_buffer *extra)
 {
 	if (buf->cap - buf->len < extra->len)
-	{
-		buf->data = fz_resize_array(ctx, buf->data, buf->len + extra->len, 1);
-		buf->cap = buf->len + extra->len;
-	}
+		fz_resize_buffer(ctx, buf, buf->len + extra->len);
 
 	memcpy(buf->data + buf->len, extra->data, extra->len);
 	buf->len += extra->len;
@@ -1,4 +1,5 @@
 #include "mupdf/fitz.h"
+#include "draw-imp.h"
 
 #define SLOWCMYK
 
@@ -284,13 +285,17 @@ fz_colorspace_is_indexed(fz_context *ctx, fz_colorspace *cs)
 	return (cs && !strcmp(cs->name, "Indexed"));
 }
 
-/* Fast pixmap color conversions */
+/* Fast pixmap color conversions
+ *
+ * Each of these converts n pixels (with alpha) from s to d. Large
+ * pixmaps are converted in bands of rows, possibly on several threads at
+ * once, so they must touch nothing but their arguments.
+ */
 
-static void fast_gray_to_rgb(fz_pixmap *dst, fz_pixmap *src)
+typedef void (fz_conv_span)(unsigned char * restrict d, const unsigned char * restrict s, int n);
+
+static void fast_gray_to_rgb(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		d[0] = s[0];
@@ -302,11 +307,8 @@ static void fast_gray_to_rgb(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
-static void fast_gray_to_cmyk(fz_pixmap *dst, fz_pixmap *src)
+static void fast_gray_to_cmyk(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		d[0] = 0;
@@ -319,11 +321,8 @@ static void fast_gray_to_cmyk(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
-static void fast_rgb_to_gray(fz_pixmap *dst, fz_pixmap *src)
+static void fast_rgb_to_gray(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		d[0] = ((s[0]+1) * 77 + (s[1]+1) * 150 + (s[2]+1) * 28) >> 8;
@@ -333,11 +332,8 @@ static void fast_rgb_to_gray(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
-static void fast_bgr_to_gray(fz_pixmap *dst, fz_pixmap *src)
+static void fast_bgr_to_gray(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		d[0] = ((s[0]+1) * 28 + (s[1]+1) * 150 + (s[2]+1) * 77) >> 8;
@@ -347,11 +343,8 @@ static void fast_bgr_to_gray(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
-static void fast_rgb_to_cmyk(fz_pixmap *dst, fz_pixmap *src)
+static void fast_rgb_to_cmyk(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		unsigned char c = 255 - s[0];
@@ -368,11 +361,8 @@ static void fast_rgb_to_cmyk(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
-static void fast_bgr_to_cmyk(fz_pixmap *dst, fz_pixmap *src)
+static void fast_bgr_to_cmyk(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		unsigned char c = 255 - s[2];
@@ -389,11 +379,8 @@ static void fast_bgr_to_cmyk(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
-static void fast_cmyk_to_gray(fz_pixmap *dst, fz_pixmap *src)
+static void fast_cmyk_to_gray(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
 	while (n--)
 	{
 		unsigned char c = fz_mul255(s[0], 77);
@@ -406,6 +393,19 @@ static void fast_cmyk_to_gray(fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
+static void fast_rgb_to_bgr(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	while (n--)
+	{
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+		d[3] = s[3];
+		s += 4;
+		d += 4;
+	}
+}
+
 #ifdef ARCH_ARM
 static void
 fast_cmyk_to_rgb_ARM(unsigned char *dst, unsigned char *src, int n)
@@ -599,211 +599,462 @@ fast_cmyk_to_rgb_ARM(unsigned char *dst, unsigned char *src, int n)
 }
 #endif
 
-static void fast_cmyk_to_rgb(fz_context *ctx, fz_pixmap *dst, fz_pixmap *src)
+/* Convert one CMYK pixel; the caller handles k == 255 (black). */
+static inline void
+cmyk_to_rgb_pixel(unsigned int c, unsigned int m, unsigned int y, unsigned int k, unsigned int *rp, unsigned int *gp, unsigned int *bp)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
-#ifdef ARCH_ARM
-	fast_cmyk_to_rgb_ARM(d, s, n);
+#ifdef SLOWCMYK
+	unsigned int r, g, b;
+	unsigned int cm, c1m, cm1, c1m1, c1m1y, c1m1y1, c1my, c1my1, cm1y, cm1y1, cmy, cmy1;
+	unsigned int x0, x1;
+
+	c += c>>7;
+	m += m>>7;
+	y += y>>7;
+	k += k>>7;
+	y >>= 1; /* Ditch 1 bit of Y to avoid overflow */
+	cm = c * m;
+	c1m = (m<<8) - cm;
+	cm1 = (c<<8) - cm;
+	c1m1 = ((256 - m)<<8) - cm1;
+	c1m1y = c1m1 * y;
+	c1m1y1 = (c1m1<<7) - c1m1y;
+	c1my = c1m * y;
+	c1my1 = (c1m<<7) - c1my;
+	cm1y = cm1 * y;
+	cm1y1 = (cm1<<7) - cm1y;
+	cmy = cm * y;
+	cmy1 = (cm<<7) - cmy;
+
+	/* this is a matrix multiplication, unrolled for performance */
+	x1 = c1m1y1 * k;	/* 0 0 0 1 */
+	x0 = (c1m1y1<<8) - x1;	/* 0 0 0 0 */
+	x1 = x1>>8;		/* From 23 fractional bits to 15 */
+	r = g = b = x0;
+	r += 35 * x1;	/* 0.1373 */
+	g += 31 * x1;	/* 0.1216 */
+	b += 32 * x1;	/* 0.1255 */
+
+	x1 = c1m1y * k;		/* 0 0 1 1 */
+	x0 = (c1m1y<<8) - x1;	/* 0 0 1 0 */
+	x1 >>= 8;		/* From 23 fractional bits to 15 */
+	r += 28 * x1;	/* 0.1098 */
+	g += 26 * x1;	/* 0.1020 */
+	r += x0;
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	g += 243 * x0;	/* 0.9490 */
+
+	x1 = c1my1 * k;		/* 0 1 0 1 */
+	x0 = (c1my1<<8) - x1;	/* 0 1 0 0 */
+	x1 >>= 8;		/* From 23 fractional bits to 15 */
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	r += 36 * x1;	/* 0.1412 */
+	r += 237 * x0;	/* 0.9255 */
+	b += 141 * x0;	/* 0.5490 */
+
+	x1 = c1my * k;		/* 0 1 1 1 */
+	x0 = (c1my<<8) - x1;	/* 0 1 1 0 */
+	x1 >>= 8;		/* From 23 fractional bits to 15 */
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	r += 34 * x1;	/* 0.1333 */
+	r += 238 * x0;	/* 0.9294 */
+	g += 28 * x0;	/* 0.1098 */
+	b += 36 * x0;	/* 0.1412 */
+
+	x1 = cm1y1 * k;		/* 1 0 0 1 */
+	x0 = (cm1y1<<8) - x1;	/* 1 0 0 0 */
+	x1 >>= 8;		/* From 23 fractional bits to 15 */
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	g += 15 * x1;	/* 0.0588 */
+	b += 36 * x1;	/* 0.1412 */
+	g += 174 * x0;	/* 0.6784 */
+	b += 240 * x0;	/* 0.9373 */
+
+	x1 = cm1y * k;		/* 1 0 1 1 */
+	x0 = (cm1y<<8) - x1;	/* 1 0 1 0 */
+	x1 >>= 8;		/* From 23 fractional bits to 15 */
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	g += 19 * x1;	/* 0.0745 */
+	g += 167 * x0;	/* 0.6510 */
+	b += 80 * x0;	/* 0.3137 */
+
+	x1 = cmy1 * k;		/* 1 1 0 1 */
+	x0 = (cmy1<<8) - x1;	/* 1 1 0 0 */
+	x1 >>= 8;		/* From 23 fractional bits to 15 */
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	b += 2 * x1;	/* 0.0078 */
+	r += 46 * x0;	/* 0.1804 */
+	g += 49 * x0;	/* 0.1922 */
+	b += 147 * x0;	/* 0.5725 */
+
+	x0 = cmy * (256-k);	/* 1 1 1 0 */
+	x0 >>= 8;		/* From 23 fractional bits to 15 */
+	r += 54 * x0;	/* 0.2118 */
+	g += 54 * x0;	/* 0.2119 */
+	b += 57 * x0;	/* 0.2235 */
+
+	r -= (r>>8);
+	g -= (g>>8);
+	b -= (b>>8);
+	*rp = r>>23;
+	*gp = g>>23;
+	*bp = b>>23;
 #else
-	unsigned int C,M,Y,K,r,g,b;
+	*rp = 255 - fz_mini(c + k, 255);
+	*gp = 255 - fz_mini(m + k, 255);
+	*bp = 255 - fz_mini(y + k, 255);
+#endif
+}
 
-	C = 0;
-	M = 0;
-	Y = 0;
-	K = 0;
-	r = 255;
-	g = 255;
-	b = 255;
+/* ri and bi give the offsets of red and blue in the output, to share
+ * the code between RGB and BGR. Runs of identical pixels are common, so
+ * the last color is remembered. */
+static inline void
+fast_cmyk_to_rgb_imp(unsigned char * restrict d, const unsigned char * restrict s, int n, int ri, int bi)
+{
+	unsigned int C = 0, M = 0, Y = 0, K = 0;
+	unsigned int r = 255, g = 255, b = 255;
 
 	while (n--)
 	{
-#ifdef SLOWCMYK
 		unsigned int c = s[0];
 		unsigned int m = s[1];
 		unsigned int y = s[2];
 		unsigned int k = s[3];
-		unsigned int cm, c1m, cm1, c1m1, c1m1y, c1m1y1, c1my, c1my1, cm1y, cm1y1, cmy, cmy1;
-		unsigned int x0, x1;
 
 		if (c == C && m == M && y == Y && k == K)
 		{
 			/* Nothing to do */
 		}
-		else if (k == 0 && c == 0 && m == 0 && y == 0)
-		{
-			r = g = b = 255;
-			C = 0;
-			M = 0;
-			Y = 0;
-			K = 0;
-		}
 		else if (k == 255)
 		{
 			r = g = b = 0;
-			C = 0;
-			M = 0;
-			Y = 0;
-			K = 255;
+			C = c;
+			M = m;
+			Y = y;
+			K = k;
 		}
 		else
 		{
-			c += c>>7;
-			m += m>>7;
-			y += y>>7;
-			k += k>>7;
-			y >>= 1; /* Ditch 1 bit of Y to avoid overflow */
-			cm = c * m;
-			c1m = (m<<8) - cm;
-			cm1 = (c<<8) - cm;
-			c1m1 = ((256 - m)<<8) - cm1;
-			c1m1y = c1m1 * y;
-			c1m1y1 = (c1m1<<7) - c1m1y;
-			c1my = c1m * y;
-			c1my1 = (c1m<<7) - c1my;
-			cm1y = cm1 * y;
-			cm1y1 = (cm1<<7) - cm1y;
-			cmy = cm * y;
-			cmy1 = (cm<<7) - cmy;
-
-			/* this is a matrix multiplication, unrolled for performance */
-			x1 = c1m1y1 * k;	/* 0 0 0 1 */
-			x0 = (c1m1y1<<8) - x1;	/* 0 0 0 0 */
-			x1 = x1>>8;		/* From 23 fractional bits to 15 */
-			r = g = b = x0;
-			r += 35 * x1;	/* 0.1373 */
-			g += 31 * x1;	/* 0.1216 */
-			b += 32 * x1;	/* 0.1255 */
-
-			x1 = c1m1y * k;		/* 0 0 1 1 */
-			x0 = (c1m1y<<8) - x1;	/* 0 0 1 0 */
-			x1 >>= 8;		/* From 23 fractional bits to 15 */
-			r += 28 * x1;	/* 0.1098 */
-			g += 26 * x1;	/* 0.1020 */
-			r += x0;
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			g += 243 * x0;	/* 0.9490 */
-
-			x1 = c1my1 * k;		/* 0 1 0 1 */
-			x0 = (c1my1<<8) - x1;	/* 0 1 0 0 */
-			x1 >>= 8;		/* From 23 fractional bits to 15 */
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			r += 36 * x1;	/* 0.1412 */
-			r += 237 * x0;	/* 0.9255 */
-			b += 141 * x0;	/* 0.5490 */
-
-			x1 = c1my * k;		/* 0 1 1 1 */
-			x0 = (c1my<<8) - x1;	/* 0 1 1 0 */
-			x1 >>= 8;		/* From 23 fractional bits to 15 */
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			r += 34 * x1;	/* 0.1333 */
-			r += 238 * x0;	/* 0.9294 */
-			g += 28 * x0;	/* 0.1098 */
-			b += 36 * x0;	/* 0.1412 */
-
-			x1 = cm1y1 * k;		/* 1 0 0 1 */
-			x0 = (cm1y1<<8) - x1;	/* 1 0 0 0 */
-			x1 >>= 8;		/* From 23 fractional bits to 15 */
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			g += 15 * x1;	/* 0.0588 */
-			b += 36 * x1;	/* 0.1412 */
-			g += 174 * x0;	/* 0.6784 */
-			b += 240 * x0;	/* 0.9373 */
-
-			x1 = cm1y * k;		/* 1 0 1 1 */
-			x0 = (cm1y<<8) - x1;	/* 1 0 1 0 */
-			x1 >>= 8;		/* From 23 fractional bits to 15 */
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			g += 19 * x1;	/* 0.0745 */
-			g += 167 * x0;	/* 0.6510 */
-			b += 80 * x0;	/* 0.3137 */
-
-			x1 = cmy1 * k;		/* 1 1 0 1 */
-			x0 = (cmy1<<8) - x1;	/* 1 1 0 0 */
-			x1 >>= 8;		/* From 23 fractional bits to 15 */
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			b += 2 * x1;	/* 0.0078 */
-			r += 46 * x0;	/* 0.1804 */
-			g += 49 * x0;	/* 0.1922 */
-			b += 147 * x0;	/* 0.5725 */
-
-			x0 = cmy * (256-k);	/* 1 1 1 0 */
-			x0 >>= 8;		/* From 23 fractional bits to 15 */
-			r += 54 * x0;	/* 0.2118 */
-			g += 54 * x0;	/* 0.2119 */
-			b += 57 * x0;	/* 0.2235 */
-
-			r -= (r>>8);
-			g -= (g>>8);
-			b -= (b>>8);
-			r = r>>23;
-			g = g>>23;
-			b = b>>23;
+			cmyk_to_rgb_pixel(c, m, y, k, &r, &g, &b);
 			C = c;
 			M = m;
 			Y = y;
 			K = k;
 		}
-		d[0] = r;
+		d[ri] = r;
 		d[1] = g;
-		d[2] = b;
-#else
-		d[0] = 255 - (unsigned char)fz_mini(s[0] + s[3], 255);
-		d[1] = 255 - (unsigned char)fz_mini(s[1] + s[3], 255);
-		d[2] = 255 - (unsigned char)fz_mini(s[2] + s[3], 255);
-#endif
+		d[bi] = b;
 		d[3] = s[4];
 		s += 5;
 		d += 4;
 	}
-#endif
 }
 
-static void fast_cmyk_to_bgr(fz_context *ctx, fz_pixmap *dst, fz_pixmap *src)
+static void fast_cmyk_to_rgb(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
-	while (n--)
-	{
-#ifdef SLOWCMYK
-		float cmyk[4], rgb[3];
-		cmyk[0] = s[0] / 255.0f;
-		cmyk[1] = s[1] / 255.0f;
-		cmyk[2] = s[2] / 255.0f;
-		cmyk[3] = s[3] / 255.0f;
-		cmyk_to_rgb(ctx, NULL, cmyk, rgb);
-		d[0] = rgb[2] * 255;
-		d[1] = rgb[1] * 255;
-		d[2] = rgb[0] * 255;
+#ifdef ARCH_ARM
+	fast_cmyk_to_rgb_ARM(d, (unsigned char *)s, n);
 #else
-		d[0] = 255 - (unsigned char)fz_mini(s[2] + s[3], 255);
-		d[1] = 255 - (unsigned char)fz_mini(s[1] + s[3], 255);
-		d[2] = 255 - (unsigned char)fz_mini(s[0] + s[3], 255);
+	fast_cmyk_to_rgb_imp(d, s, n, 0, 2);
 #endif
-		d[3] = s[4];
-		s += 5;
-		d += 4;
+}
+
+static void fast_cmyk_to_bgr(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	fast_cmyk_to_rgb_imp(d, s, n, 2, 0);
+}
+
+#ifdef ARCH_X86_SIMD
+
+/*
+ * SIMD versions of the above, bit exact with the C ones. The SSE2 ones
+ * are for the formats that pack into whole vectors (two and four bytes
+ * per pixel); CMYK needs 32 bit multiplies, so is done with AVX2.
+ */
+
+#include <immintrin.h>
+
+static void fast_gray_to_rgb_sse2(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	const __m128i lo = _mm_set1_epi16(0x00ff);
+
+	/* Each gray+alpha word ga becomes the pixel gg:ga */
+	for (; n >= 8; n -= 8)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)s);
+		__m128i g = _mm_and_si128(x, lo);
+		g = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(g, x));
+		_mm_storeu_si128((__m128i *)(d + 16), _mm_unpackhi_epi16(g, x));
+		s += 16;
+		d += 32;
 	}
+	fast_gray_to_rgb(d, s, n);
 }
 
-static void fast_rgb_to_bgr(fz_pixmap *dst, fz_pixmap *src)
+static void fast_rgb_to_bgr_sse2(unsigned char * restrict d, const unsigned char * restrict s, int n)
 {
-	unsigned char *s = src->samples;
-	unsigned char *d = dst->samples;
-	int n = src->w * src->h;
-	while (n--)
+	const __m128i ga = _mm_set1_epi32(0xff00ff00);
+	const __m128i lo = _mm_set1_epi32(0x000000ff);
+
+	for (; n >= 4; n -= 4)
 	{
-		d[0] = s[2];
-		d[1] = s[1];
-		d[2] = s[0];
-		d[3] = s[3];
-		s += 4;
-		d += 4;
+		__m128i x = _mm_loadu_si128((const __m128i *)s);
+		__m128i y = _mm_and_si128(x, ga);
+		y = _mm_or_si128(y, _mm_and_si128(_mm_srli_epi32(x, 16), lo));
+		y = _mm_or_si128(y, _mm_slli_epi32(_mm_and_si128(x, lo), 16));
+		_mm_storeu_si128((__m128i *)d, y);
+		s += 16;
+		d += 16;
+	}
+	fast_rgb_to_bgr(d, s, n);
+}
+
+/* w holds the weights of the first three bytes of each pixel */
+static inline void
+fast_rgb_to_gray_sse2_imp(unsigned char * restrict d, const unsigned char * restrict s, int n, __m128i w)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set_epi16(0, 1, 1, 1, 0, 1, 1, 1);
+	const __m128i lo = _mm_set_epi32(0, -1, 0, -1);
+
+	for (; n >= 8; n -= 8)
+	{
+		__m128i x0 = _mm_loadu_si128((const __m128i *)s);
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(s + 16));
+		__m128i p0, p1, p2, p3, v0, v1, a;
+
+		/* (r+1)*wr + (g+1)*wg and (b+1)*wb for each pixel, then summed */
+		p0 = _mm_madd_epi16(_mm_add_epi16(_mm_unpacklo_epi8(x0, zero), one), w);
+		p1 = _mm_madd_epi16(_mm_add_epi16(_mm_unpackhi_epi8(x0, zero), one), w);
+		p2 = _mm_madd_epi16(_mm_add_epi16(_mm_unpacklo_epi8(x1, zero), one), w);
+		p3 = _mm_madd_epi16(_mm_add_epi16(_mm_unpackhi_epi8(x1, zero), one), w);
+		p0 = _mm_srli_epi32(_mm_add_epi32(p0, _mm_srli_epi64(p0, 32)), 8);
+		p1 = _mm_srli_epi32(_mm_add_epi32(p1, _mm_srli_epi64(p1, 32)), 8);
+		p2 = _mm_srli_epi32(_mm_add_epi32(p2, _mm_srli_epi64(p2, 32)), 8);
+		p3 = _mm_srli_epi32(_mm_add_epi32(p3, _mm_srli_epi64(p3, 32)), 8);
+
+		/* Gather the grays (the low dword of each quad) into 8 words */
+		v0 = _mm_packs_epi32(_mm_and_si128(p0, lo), _mm_and_si128(p1, lo));
+		v1 = _mm_packs_epi32(_mm_and_si128(p2, lo), _mm_and_si128(p3, lo));
+		v0 = _mm_packs_epi32(v0, v1);
+
+		/* and the alphas into the high byte of each word */
+		a = _mm_packs_epi32(_mm_srli_epi32(x0, 24), _mm_srli_epi32(x1, 24));
+		_mm_storeu_si128((__m128i *)d, _mm_or_si128(v0, _mm_slli_epi16(a, 8)));
+		s += 32;
+		d += 16;
+	}
+}
+
+static void fast_rgb_to_gray_sse2(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	int m = n & ~7;
+	fast_rgb_to_gray_sse2_imp(d, s, m, _mm_set_epi16(0, 28, 150, 77, 0, 28, 150, 77));
+	fast_rgb_to_gray(d + m * 2, s + m * 4, n - m);
+}
+
+static void fast_bgr_to_gray_sse2(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	int m = n & ~7;
+	fast_rgb_to_gray_sse2_imp(d, s, m, _mm_set_epi16(0, 77, 150, 28, 0, 77, 150, 28));
+	fast_bgr_to_gray(d + m * 2, s + m * 4, n - m);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+#define MUL(a, b) _mm256_mullo_epi32(a, b)
+#define MULC(a, k) _mm256_mullo_epi32(a, _mm256_set1_epi32(k))
+#define ADD(a, b) _mm256_add_epi32(a, b)
+#define SUB(a, b) _mm256_sub_epi32(a, b)
+#define SHL(a, k) _mm256_slli_epi32(a, k)
+#define SHR(a, k) _mm256_srli_epi32(a, k)
+
+/* The same sums as cmyk_to_rgb_pixel, eight pixels at a time */
+static inline AVX2 void
+fast_cmyk_to_rgb_avx2_imp(unsigned char * restrict d, const unsigned char * restrict s, int n, int bgr)
+{
+	const __m256i c256 = _mm256_set1_epi32(256);
+	const __m256i c255 = _mm256_set1_epi32(255);
+
+	for (; n >= 8; n -= 8)
+	{
+		__m256i c, m, y, k, a, black;
+		__m256i cm, c1m, cm1, c1m1, c1m1y, c1m1y1, c1my, c1my1, cm1y, cm1y1, cmy, cmy1;
+		__m256i r, g, b, x0, x1;
+
+		c = _mm256_setr_epi32(s[0], s[5], s[10], s[15], s[20], s[25], s[30], s[35]);
+		m = _mm256_setr_epi32(s[1], s[6], s[11], s[16], s[21], s[26], s[31], s[36]);
+		y = _mm256_setr_epi32(s[2], s[7], s[12], s[17], s[22], s[27], s[32], s[37]);
+		k = _mm256_setr_epi32(s[3], s[8], s[13], s[18], s[23], s[28], s[33], s[38]);
+		a = _mm256_setr_epi32(s[4], s[9], s[14], s[19], s[24], s[29], s[34], s[39]);
+		black = _mm256_cmpeq_epi32(k, c255);
+
+		c = ADD(c, SHR(c, 7));
+		m = ADD(m, SHR(m, 7));
+		y = SHR(ADD(y, SHR(y, 7)), 1);
+		k = ADD(k, SHR(k, 7));
+		cm = MUL(c, m);
+		c1m = SUB(SHL(m, 8), cm);
+		cm1 = SUB(SHL(c, 8), cm);
+		c1m1 = SUB(SHL(SUB(c256, m), 8), cm1);
+		c1m1y = MUL(c1m1, y);
+		c1m1y1 = SUB(SHL(c1m1, 7), c1m1y);
+		c1my = MUL(c1m, y);
+		c1my1 = SUB(SHL(c1m, 7), c1my);
+		cm1y = MUL(cm1, y);
+		cm1y1 = SUB(SHL(cm1, 7), cm1y);
+		cmy = MUL(cm, y);
+		cmy1 = SUB(SHL(cm, 7), cmy);
+
+		x1 = MUL(c1m1y1, k);
+		x0 = SUB(SHL(c1m1y1, 8), x1);
+		x1 = SHR(x1, 8);
+		r = ADD(x0, MULC(x1, 35));
+		g = ADD(x0, MULC(x1, 31));
+		b = ADD(x0, MULC(x1, 32));
+
+		x1 = MUL(c1m1y, k);
+		x0 = SUB(SHL(c1m1y, 8), x1);
+		x1 = SHR(x1, 8);
+		r = ADD(r, MULC(x1, 28));
+		g = ADD(g, MULC(x1, 26));
+		r = ADD(r, x0);
+		x0 = SHR(x0, 8);
+		g = ADD(g, MULC(x0, 243));
+
+		x1 = MUL(c1my1, k);
+		x0 = SUB(SHL(c1my1, 8), x1);
+		x1 = SHR(x1, 8);
+		x0 = SHR(x0, 8);
+		r = ADD(r, ADD(MULC(x1, 36), MULC(x0, 237)));
+		b = ADD(b, MULC(x0, 141));
+
+		x1 = MUL(c1my, k);
+		x0 = SUB(SHL(c1my, 8), x1);
+		x1 = SHR(x1, 8);
+		x0 = SHR(x0, 8);
+		r = ADD(r, ADD(MULC(x1, 34), MULC(x0, 238)));
+		g = ADD(g, MULC(x0, 28));
+		b = ADD(b, MULC(x0, 36));
+
+		x1 = MUL(cm1y1, k);
+		x0 = SUB(SHL(cm1y1, 8), x1);
+		x1 = SHR(x1, 8);
+		x0 = SHR(x0, 8);
+		g = ADD(g, ADD(MULC(x1, 15), MULC(x0, 174)));
+		b = ADD(b, ADD(MULC(x1, 36), MULC(x0, 240)));
+
+		x1 = MUL(cm1y, k);
+		x0 = SUB(SHL(cm1y, 8), x1);
+		x1 = SHR(x1, 8);
+		x0 = SHR(x0, 8);
+		g = ADD(g, ADD(MULC(x1, 19), MULC(x0, 167)));
+		b = ADD(b, MULC(x0, 80));
+
+		x1 = MUL(cmy1, k);
+		x0 = SUB(SHL(cmy1, 8), x1);
+		x1 = SHR(x1, 8);
+		x0 = SHR(x0, 8);
+		b = ADD(b, ADD(MULC(x1, 2), MULC(x0, 147)));
+		r = ADD(r, MULC(x0, 46));
+		g = ADD(g, MULC(x0, 49));
+
+		x0 = SHR(MUL(cmy, SUB(c256, k)), 8);
+		r = ADD(r, MULC(x0, 54));
+		g = ADD(g, MULC(x0, 54));
+		b = ADD(b, MULC(x0, 57));
+
+		r = SHR(SUB(r, SHR(r, 8)), 23);
+		g = SHR(SUB(g, SHR(g, 8)), 23);
+		b = SHR(SUB(b, SHR(b, 8)), 23);
+		r = _mm256_andnot_si256(black, r);
+		g = _mm256_andnot_si256(black, g);
+		b = _mm256_andnot_si256(black, b);
+
+		if (bgr)
+			x0 = _mm256_or_si256(_mm256_or_si256(b, SHL(g, 8)), _mm256_or_si256(SHL(r, 16), SHL(a, 24)));
+		else
+			x0 = _mm256_or_si256(_mm256_or_si256(r, SHL(g, 8)), _mm256_or_si256(SHL(b, 16), SHL(a, 24)));
+		_mm256_storeu_si256((__m256i *)d, x0);
+		s += 40;
+		d += 32;
 	}
 }
 
+#undef MUL
+#undef MULC
+#undef ADD
+#undef SUB
+#undef SHL
+#undef SHR
+
+static AVX2 void fast_cmyk_to_rgb_avx2(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	int m = n & ~7;
+	fast_cmyk_to_rgb_avx2_imp(d, s, m, 0);
+	fast_cmyk_to_rgb_imp(d + m * 4, s + m * 5, n - m, 0, 2);
+}
+
+static AVX2 void fast_cmyk_to_bgr_avx2(unsigned char * restrict d, const unsigned char * restrict s, int n)
+{
+	int m = n & ~7;
+	fast_cmyk_to_rgb_avx2_imp(d, s, m, 1);
+	fast_cmyk_to_rgb_imp(d + m * 4, s + m * 5, n - m, 2, 0);
+}
+
+#endif /* ARCH_X86_SIMD */
+
+/* Pick the converter for a pair of device colorspaces, or NULL */
+static fz_conv_span *
+fz_lookup_fast_converter(fz_context *ctx, fz_colorspace *ds, fz_colorspace *ss)
+{
+#ifdef ARCH_X86_SIMD
+	int features = ctx->cpu_features;
+	int simd = features & FZ_CPU_SSE2;
+#define FAST(c, v) (simd ? v : c)
+#define FAST_AVX2(c, v) ((features & FZ_CPU_AVX2) ? v : c)
+#else
+#define FAST(c, v) (c)
+#define FAST_AVX2(c, v) (c)
+#endif
+
+	if (ss == fz_default_gray)
+	{
+		if (ds == fz_default_rgb) return FAST(fast_gray_to_rgb, fast_gray_to_rgb_sse2);
+		if (ds == fz_default_bgr) return FAST(fast_gray_to_rgb, fast_gray_to_rgb_sse2); /* bgr == rgb here */
+		if (ds == fz_default_cmyk) return fast_gray_to_cmyk;
+	}
+	else if (ss == fz_default_rgb)
+	{
+		if (ds == fz_default_gray) return FAST(fast_rgb_to_gray, fast_rgb_to_gray_sse2);
+		if (ds == fz_default_bgr) return FAST(fast_rgb_to_bgr, fast_rgb_to_bgr_sse2);
+		if (ds == fz_default_cmyk) return fast_rgb_to_cmyk;
+	}
+	else if (ss == fz_default_bgr)
+	{
+		if (ds == fz_default_gray) return FAST(fast_bgr_to_gray, fast_bgr_to_gray_sse2);
+		if (ds == fz_default_rgb) return FAST(fast_rgb_to_bgr, fast_rgb_to_bgr_sse2); /* bgr = rgb here */
+		if (ds == fz_default_cmyk) return fast_bgr_to_cmyk;
+	}
+	else if (ss == fz_default_cmyk)
+	{
+		if (ds == fz_default_gray) return fast_cmyk_to_gray;
+#if defined(SLOWCMYK) && !defined(ARCH_ARM)
+		if (ds == fz_default_rgb) return FAST_AVX2(fast_cmyk_to_rgb, fast_cmyk_to_rgb_avx2);
+		if (ds == fz_default_bgr) return FAST_AVX2(fast_cmyk_to_bgr, fast_cmyk_to_bgr_avx2);
+#else
+		if (ds == fz_default_rgb) return fast_cmyk_to_rgb;
+		if (ds == fz_default_bgr) return fast_cmyk_to_bgr;
+#endif
+	}
+	return NULL;
+
+#undef FAST
+#undef FAST_AVX2
+}
+
 static void
 fz_std_conv_pixmap(fz_context *ctx, fz_pixmap *dst, fz_pixmap *src)
 {
@@ -945,49 +1196,63 @@ fz_std_conv_pixmap(fz_context *ctx, fz_pixmap *dst, fz_pixmap *src)
 	}
 }
 
+/* Pixmaps of at least this many pixels are split into bands of rows */
+#define CONV_BAND_PIXELS (64 * 1024)
+
+typedef struct
+{
+	fz_conv_span *conv;
+	unsigned char *d;
+	const unsigned char *s;
+	int dn, sn, w, h, band_h;
+} fz_conv_bands;
+
+static void
+fz_convert_band(void *arg, int i)
+{
+	fz_conv_bands *b = arg;
+	int y = i * b->band_h;
+	int h = fz_mini(b->band_h, b->h - y);
+	b->conv(b->d + (size_t)y * b->w * b->dn, b->s + (size_t)y * b->w * b->sn, h * b->w);
+}
+
 void
 fz_convert_pixmap(fz_context *ctx, fz_pixmap *dp, fz_pixmap *sp)
 {
 	fz_colorspace *ss = sp->colorspace;
 	fz_colorspace *ds = dp->colorspace;
+	fz_conv_span *conv;
+	fz_conv_bands bands;
+	int count;
 
 	assert(ss && ds);
 
 	dp->interpolate = sp->interpolate;
 
-	if (ss == fz_default_gray)
+	conv = fz_lookup_fast_converter(ctx, ds, ss);
+	if (!conv)
 	{
-		if (ds == fz_default_rgb) fast_gray_to_rgb(dp, sp);
-		else if (ds == fz_default_bgr) fast_gray_to_rgb(dp, sp); /* bgr == rgb here */
-		else if (ds == fz_default_cmyk) fast_gray_to_cmyk(dp, sp);
-		else fz_std_conv_pixmap(ctx, dp, sp);
-	}
-
-	else if (ss == fz_default_rgb)
-	{
-		if (ds == fz_default_gray) fast_rgb_to_gray(dp, sp);
-		else if (ds == fz_default_bgr) fast_rgb_to_bgr(dp, sp);
-		else if (ds == fz_default_cmyk) fast_rgb_to_cmyk(dp, sp);
-		else fz_std_conv_pixmap(ctx, dp, sp);
-	}
-
-	else if (ss == fz_default_bgr)
-	{
-		if (ds == fz_default_gray) fast_bgr_to_gray(dp, sp);
-		else if (ds == fz_default_rgb) fast_rgb_to_bgr(dp, sp); /* bgr = rgb here */
-		else if (ds == fz_default_cmyk) fast_bgr_to_cmyk(sp, dp);
-		else fz_std_conv_pixmap(ctx, dp, sp);
+		fz_std_conv_pixmap(ctx, dp, sp);
+		return;
 	}
 
-	else if (ss == fz_default_cmyk)
+	assert(sp->w == dp->w && sp->h == dp->h);
+
+	bands.conv = conv;
+	bands.d = dp->samples;
+	bands.s = sp->samples;
+	bands.dn = dp->n;
+	bands.sn = sp->n;
+	bands.w = sp->w;
+	bands.h = sp->h;
+	bands.band_h = sp->h;
+	count = 1;
+	if (ctx->tasks && sp->w > 0 && (size_t)sp->w * sp->h >= 2 * CONV_BAND_PIXELS)
 	{
-		if (ds == fz_default_gray) fast_cmyk_to_gray(dp, sp);
-		else if (ds == fz_default_bgr) fast_cmyk_to_bgr(ctx, dp, sp);
-		else if (ds == fz_default_rgb) fast_cmyk_to_rgb(ctx, dp, sp);
-		else fz_std_conv_pixmap(ctx, dp, sp);
+		bands.band_h = fz_maxi(1, CONV_BAND_PIXELS / sp->w);
+		count = (sp->h + bands.band_h - 1) / bands.band_h;
 	}
-
-	else fz_std_conv_pixmap(ctx, dp, sp);
+	fz_run_tasks(ctx, count, fz_convert_band, &bands);
 }
 
 /* Convert a single color */
@@ -1276,21 +1541,113 @@ fz_expand_indexed_pixmap(fz_context *ctx, fz_pixmap *src)
 	return dst;
 }
 
+/*
+ * Cached color converter.
+ *
+ * The device colorspace conversions are cheaper than a hash lookup, so
+ * are called directly. Anything else is memoized in a hash table, and
+ * if a 3 or 4 component source keeps missing the cache (as shadings in
+ * calibrated or DeviceN colorspaces do), the conversion is sampled once
+ * on a regular grid and interpolated from then on.
+ */
+
 typedef struct fz_cached_color_converter
 {
 	fz_color_converter base;
 	fz_hash_table *hash;
-
+	int misses;
+	int lut_after; /* build the lut after this many misses, or 0 for never */
+	int grid; /* nodes per axis */
+	float *lut;
 }
 fz_cached_color_converter;
 
+static void
+fz_build_color_lut(fz_context *ctx, fz_cached_color_converter *cc, int grid)
+{
+	fz_color_converter *base_cc = &cc->base;
+	int sn = base_cc->ss->n;
+	int dn = base_cc->ds->n;
+	int i, k, nodes = 1;
+	float sv[4];
+
+	for (k = 0; k < sn; k++)
+		nodes *= grid;
+
+	cc->lut = fz_malloc_array(ctx, nodes, dn * sizeof(float));
+	for (i = 0; i < nodes; i++)
+	{
+		int j = i;
+		for (k = sn - 1; k >= 0; k--)
+		{
+			sv[k] = (float)(j % grid) / (grid - 1);
+			j /= grid;
+		}
+		base_cc->convert(ctx, base_cc, cc->lut + i * dn, sv);
+	}
+	cc->grid = grid;
+}
+
+/* Multilinear interpolation between the 2^sn surrounding nodes */
+static void
+fz_lookup_color_lut(fz_cached_color_converter *cc, float *ds, const float *ss)
+{
+	int sn = cc->base.ss->n;
+	int dn = cc->base.ds->n;
+	int grid = cc->grid;
+	int stride[4];
+	float frac[4];
+	int base = 0, step = dn;
+	int i, k, corner;
+
+	for (k = sn - 1; k >= 0; k--)
+	{
+		float x = fz_clamp(ss[k], 0, 1) * (grid - 1);
+		int j = fz_mini((int)x, grid - 2);
+		frac[k] = x - j;
+		base += j * step;
+		stride[k] = step;
+		step *= grid;
+	}
+
+	for (i = 0; i < dn; i++)
+		ds[i] = 0;
+
+	for (corner = 0; corner < (1 << sn); corner++)
+	{
+		const float *node;
+		float w = 1;
+		int o = base;
+		for (k = 0; k < sn; k++)
+		{
+			if (corner & (1 << k))
+			{
+				w *= frac[k];
+				o += stride[k];
+			}
+			else
+				w *= 1 - frac[k];
+		}
+		node = cc->lut + o;
+		for (i = 0; i < dn; i++)
+			ds[i] += w * node[i];
+	}
+}
+
 static void fz_cached_color_convert(fz_context *ctx, fz_color_converter *cc_, float *ds, const float *ss)
 {
 	fz_cached_color_converter *cc = cc_->opaque;
-	void *val = fz_hash_find(ctx, cc->hash, ss);
+	void *val;
 	int n = cc->base.ds->n * sizeof(float);
 	fz_color_converter *base_cc = &cc->base;
 
+	if (cc->lut)
+	{
+		fz_lookup_color_lut(cc, ds, ss);
+		return;
+	}
+
+	val = fz_hash_find(ctx, cc->hash, ss);
 	if (val)
 	{
 		memcpy(ds, val, n);
@@ -1298,6 +1655,21 @@ static void fz_cached_color_convert(fz_context *ctx, fz_color_converter *cc_, fl
 	}
 
 	base_cc->convert(ctx, base_cc, ds, ss);
+
+	if (++cc->misses == cc->lut_after)
+	{
+		fz_try(ctx)
+			fz_build_color_lut(ctx, cc, cc->base.ss->n == 3 ? 17 : 9);
+		fz_catch(ctx)
+		{
+			/* Carry on with the hash table */
+			fz_free(ctx, cc->lut);
+			cc->lut = NULL;
+		}
+		if (cc->lut)
+			return;
+	}
+
 	val = fz_malloc(ctx, n);
 	memcpy(val, ds, n);
 	fz_try(ctx)
@@ -1313,12 +1685,21 @@ static void fz_cached_color_convert(fz_context *ctx, fz_color_converter *cc_, fl
 void fz_init_cached_color_converter(fz_context *ctx, fz_color_converter *cc, fz_colorspace *ds, fz_colorspace *ss)
 {
 	int n = ss->n;
-	fz_cached_color_converter *cached = fz_malloc_struct(ctx, fz_cached_color_converter);
+	fz_cached_color_converter *cached;
+
+	fz_lookup_color_converter(ctx, cc, ds, ss);
+	cc->opaque = NULL;
+	if (cc->convert != std_conv_color || ss == ds)
+		return;
 
+	cached = fz_malloc_struct(ctx, fz_cached_color_converter);
 	fz_try(ctx)
 	{
 		fz_lookup_color_converter(ctx, &cached->base, ds, ss);
 		cached->hash = fz_new_hash_table(ctx, 256, n * sizeof(float), -1);
+		/* Lab and indexed components are not on a [0,1] scale */
+		if ((n == 3 || n == 4) && strcmp(ss->name, "Lab") && !fz_colorspace_is_indexed(ctx, ss))
+			cached->lut_after = n == 3 ? 17 * 17 * 17 : 9 * 9 * 9 * 9;
 		cc->convert = fz_cached_color_convert;
 		cc->ds = ds;
 		cc->ss = ss;
@@ -1327,6 +1708,7 @@ void fz_init_cached_color_converter(fz_context *ctx, fz_color_converter *cc, fz_
 	fz_catch(ctx)
 	{
 		fz_drop_hash(ctx, cached->hash);
+		fz_free(ctx, cached);
 		fz_rethrow(ctx);
 	}
 }
@@ -1351,5 +1733,6 @@ void fz_fin_cached_color_converter(fz_context *ctx, fz_color_converter *cc_)
 			fz_free(ctx, v);
 	}
 	fz_drop_hash(ctx, cc->hash);
+	fz_free(ctx, cc->lut);
 	fz_free(ctx, cc);
 }
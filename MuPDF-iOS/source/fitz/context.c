@@ -1,4 +1,5 @@
 #include "mupdf/fitz.h"
+#include "draw-imp.h"
 
 struct fz_id_context_s
 {
@@ -39,12 +40,14 @@ fz_drop_context(fz_context *ctx)
 
 	/* Other finalisation calls go here (in reverse order) */
 	fz_drop_document_handler_context(ctx);
+	fz_drop_image_context(ctx);
 	fz_drop_glyph_cache_context(ctx);
 	fz_drop_store_context(ctx);
 	fz_drop_aa_context(ctx);
 	fz_drop_colorspace_context(ctx);
 	fz_drop_font_context(ctx);
 	fz_drop_id_context(ctx);
+	fz_drop_alloc_arena(ctx);
 
 	if (ctx->warn)
 	{
@@ -92,6 +95,9 @@ new_context_phase1(fz_alloc_context *alloc, fz_locks_context *locks)
 	ctx->warn->message[0] = 0;
 	ctx->warn->count = 0;
 
+	/* Not having the small block lists only costs speed */
+	fz_new_alloc_arena(ctx);
+
 	/* New initialisation calls for context entries go here */
 	fz_try(ctx)
 	{
@@ -131,11 +137,17 @@ fz_new_context_imp(fz_alloc_context *alloc, fz_locks_context *locks, unsigned in
 	if (!ctx)
 		return NULL;
 
+	/* Render threads use clones of this context, so the processor
+	 * features are found here, before any of them can be running. */
+	ctx->cpu_features = fz_cpu_features();
+	fz_select_span_painters(ctx);
+
 	/* Now initialise sections that are shared */
 	fz_try(ctx)
 	{
 		fz_new_store_context(ctx, max_store);
 		fz_new_glyph_cache_context(ctx);
+		fz_new_image_context(ctx);
 		fz_new_colorspace_context(ctx);
 		fz_new_font_context(ctx);
 		fz_new_id_context(ctx);
@@ -172,14 +184,20 @@ fz_clone_context_internal(fz_context *ctx)
 	if (!new_ctx)
 		return NULL;
 
-	/* Inherit AA defaults from old context. */
+	/* Inherit AA defaults, the task runner and the waiter from old context. */
 	fz_copy_aa_context(new_ctx, ctx);
+	new_ctx->tasks = ctx->tasks;
+	new_ctx->waiter = ctx->waiter;
+	new_ctx->cpu_features = ctx->cpu_features;
+	fz_copy_alloc_arena(new_ctx, ctx);
 
 	/* Keep thread lock checking happy by copying pointers first and locking under new context */
 	new_ctx->store = ctx->store;
 	new_ctx->store = fz_keep_store_context(new_ctx);
 	new_ctx->glyph_cache = ctx->glyph_cache;
 	new_ctx->glyph_cache = fz_keep_glyph_cache(new_ctx);
+	new_ctx->image = ctx->image;
+	new_ctx->image = fz_keep_image_context(new_ctx);
 	new_ctx->colorspace = ctx->colorspace;
 	new_ctx->colorspace = fz_keep_colorspace_context(new_ctx);
 	new_ctx->font = ctx->font;
@@ -204,3 +222,27 @@ fz_gen_id(fz_context *ctx)
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
 	return id;
 }
+
+void
+fz_set_task_runner(fz_context *ctx, fz_task_runner *runner)
+{
+	ctx->tasks = runner;
+}
+
+void
+fz_run_tasks(fz_context *ctx, int count, void (*task)(void *arg, int i), void *arg)
+{
+	int i;
+
+	if (ctx->tasks && count > 1)
+		ctx->tasks->run(ctx->tasks->user, count, task, arg);
+	else
+		for (i = 0; i < count; i++)
+			task(arg, i);
+}
+
+void
+fz_set_waiter(fz_context *ctx, fz_waiter *waiter)
+{
+	ctx->waiter = waiter;
+}
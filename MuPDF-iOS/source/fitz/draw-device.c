@@ -14,6 +14,8 @@
 #undef DUMP_STACK_CHANGES
 
 typedef struct fz_draw_device_s fz_draw_device;
+typedef struct fz_draw_pool_s fz_draw_pool;
+typedef struct fz_draw_pool_buf_s fz_draw_pool_buf;
 
 enum {
 	FZ_DRAWDEV_FLAGS_TYPE3 = 1,
@@ -45,9 +47,38 @@ struct fz_draw_device_s
 	fz_scale_cache *cache_y;
 	fz_draw_state *stack;
 	int stack_cap;
+	fz_draw_pool *pool;
 	fz_draw_state init_stack[STACK_SIZE];
 };
 
+/* Scratch pixmaps (group, mask, knockout and clip buffers) are carved
+ * from a per-device pool of sample buffers. Each buffer is preceded by
+ * a header; 'dirty' bounds the bytes that may be non-zero, so that
+ * reusing a buffer for a smaller pixmap only needs to clear what an
+ * earlier user could have touched. The pool is only ever used from the
+ * thread driving the device, and lives until the device and every
+ * pixmap carved from it have been dropped. */
+struct fz_draw_pool_buf_s
+{
+	fz_draw_pool *pool;
+	fz_draw_pool_buf *next;
+	size_t cap;
+	size_t dirty;
+};
+
+struct fz_draw_pool_s
+{
+	int refs;
+	int closed;
+	size_t cached;
+	size_t max_cached;
+	fz_draw_pool_buf *head;
+};
+
+#define POOL_HEADER ((sizeof(fz_draw_pool_buf) + 15) & ~(size_t)15)
+#define POOL_MIN_BUCKET 4096
+#define POOL_MIN_CACHED (1<<20)
+
 #ifdef DUMP_GROUP_BLENDS
 static int group_dump_count = 0;
 
@@ -99,6 +130,164 @@ static void stack_change(fz_context *ctx, fz_draw_device *dev, char *s)
 #define STACK_CONVERT(A) do {} while (0)
 #endif
 
+static fz_draw_pool *
+fz_new_draw_pool(fz_context *ctx, fz_pixmap *dest)
+{
+	fz_draw_pool *pool = fz_malloc_struct(ctx, fz_draw_pool);
+	pool->refs = 1;
+	pool->max_cached = (size_t)dest->w * dest->h * dest->n * 2;
+	if (pool->max_cached < POOL_MIN_CACHED)
+		pool->max_cached = POOL_MIN_CACHED;
+	return pool;
+}
+
+static void
+fz_drop_draw_pool(fz_context *ctx, fz_draw_pool *pool)
+{
+	if (pool && --pool->refs == 0)
+		fz_free(ctx, pool);
+}
+
+/* Called when the device goes away; outstanding pixmaps keep the pool
+ * alive, but free their buffers rather than returning them. */
+static void
+fz_close_draw_pool(fz_context *ctx, fz_draw_pool *pool)
+{
+	fz_draw_pool_buf *buf;
+
+	if (!pool)
+		return;
+	pool->closed = 1;
+	while ((buf = pool->head) != NULL)
+	{
+		pool->head = buf->next;
+		fz_free(ctx, buf);
+	}
+	pool->cached = 0;
+	fz_drop_draw_pool(ctx, pool);
+}
+
+/* Round up to the next quarter step between powers of two, so that
+ * similar sizes share buffers. */
+static size_t
+fz_draw_pool_bucket(size_t size)
+{
+	size_t b = POOL_MIN_BUCKET;
+	size_t step;
+
+	if (size <= b)
+		return b;
+	while (b < size)
+		b <<= 1;
+	step = b >> 3;
+	return (size + step - 1) / step * step;
+}
+
+static fz_draw_pool_buf *
+fz_draw_pool_get(fz_context *ctx, fz_draw_pool *pool, size_t size, int clear)
+{
+	fz_draw_pool_buf *buf, **prev, **best = NULL;
+	size_t bucket = fz_draw_pool_bucket(size);
+
+	for (prev = &pool->head; *prev; prev = &(*prev)->next)
+	{
+		size_t cap = (*prev)->cap;
+		if (cap >= size && cap <= 2 * bucket && (!best || cap < (*best)->cap))
+			best = prev;
+	}
+
+	if (best)
+	{
+		buf = *best;
+		*best = buf->next;
+		pool->cached -= buf->cap;
+		if (clear)
+			memset((unsigned char *)buf + POOL_HEADER, 0, size < buf->dirty ? size : buf->dirty);
+	}
+	else
+	{
+		buf = fz_malloc(ctx, POOL_HEADER + bucket);
+		buf->cap = bucket;
+		buf->dirty = bucket;
+		if (clear)
+		{
+			memset((unsigned char *)buf + POOL_HEADER, 0, bucket);
+			buf->dirty = 0;
+		}
+	}
+
+	buf->pool = pool;
+	buf->next = NULL;
+	pool->refs++;
+	return buf;
+}
+
+static void
+fz_draw_pool_put(fz_context *ctx, fz_draw_pool_buf *buf, size_t used)
+{
+	fz_draw_pool *pool = buf->pool;
+
+	if (buf->dirty < used)
+		buf->dirty = used;
+	if (pool->closed || pool->cached + buf->cap > pool->max_cached)
+	{
+		fz_free(ctx, buf);
+	}
+	else
+	{
+		buf->next = pool->head;
+		pool->head = buf;
+		pool->cached += buf->cap;
+	}
+	fz_drop_draw_pool(ctx, pool);
+}
+
+static void
+fz_drop_draw_pixmap_imp(fz_context *ctx, fz_storable *pix_)
+{
+	fz_pixmap *pix = (fz_pixmap *)pix_;
+	fz_draw_pool_buf *buf = (fz_draw_pool_buf *)(pix->samples - POOL_HEADER);
+	size_t used = (size_t)pix->w * pix->h * pix->n;
+
+	fz_drop_pixmap_imp(ctx, pix_);
+	fz_draw_pool_put(ctx, buf, used);
+}
+
+/* Create a scratch pixmap covering bbox, optionally cleared to zero. */
+static fz_pixmap *
+fz_new_draw_pixmap(fz_context *ctx, fz_draw_device *dev, fz_colorspace *colorspace, const fz_irect *bbox, int clear)
+{
+	fz_draw_pool_buf *buf;
+	fz_pixmap *pix;
+	int w = bbox->x1 - bbox->x0;
+	int h = bbox->y1 - bbox->y0;
+	int n = colorspace ? colorspace->n + 1 : 1;
+	size_t size = 0;
+
+	/* Leave odd and oversized requests to the ordinary allocator */
+	if (dev->pool && w > 0 && h > 0 && w <= INT_MAX / n)
+		size = (size_t)w * h * n;
+	if (size == 0 || size > dev->pool->max_cached / 2)
+	{
+		pix = fz_new_pixmap_with_bbox(ctx, colorspace, bbox);
+		if (clear)
+			fz_clear_pixmap(ctx, pix);
+		return pix;
+	}
+
+	fz_var(buf);
+
+	buf = fz_draw_pool_get(ctx, dev->pool, size, clear);
+	fz_try(ctx)
+		pix = fz_new_pixmap_with_bbox_and_data(ctx, colorspace, bbox, (unsigned char *)buf + POOL_HEADER);
+	fz_catch(ctx)
+	{
+		fz_draw_pool_put(ctx, buf, 0);
+		fz_rethrow(ctx);
+	}
+	pix->storable.drop = fz_drop_draw_pixmap_imp;
+	return pix;
+}
 
 static void fz_grow_stack(fz_context *ctx, fz_draw_device *dev)
 {
@@ -151,7 +340,7 @@ static fz_draw_state *
 fz_knockout_begin(fz_context *ctx, fz_draw_device *dev)
 {
 	fz_irect bbox;
-	fz_pixmap *dest, *shape;
+	fz_pixmap *dest, *shape, *prev;
 	fz_draw_state *state = &dev->stack[dev->top];
 	int isolated = state->blendmode & FZ_BLEND_ISOLATED;
 
@@ -163,29 +352,24 @@ fz_knockout_begin(fz_context *ctx, fz_draw_device *dev)
 
 	fz_pixmap_bbox(ctx, state->dest, &bbox);
 	fz_intersect_irect(&bbox, &state->scissor);
-	dest = fz_new_pixmap_with_bbox(ctx, state->dest->colorspace, &bbox);
-
-	if (isolated)
-	{
-		fz_clear_pixmap(ctx, dest);
-	}
-	else
+	prev = NULL;
+	if (!isolated)
 	{
 		/* Find the last but one destination to copy */
 		int i = dev->top-1; /* i = the one on entry (i.e. the last one) */
-		fz_pixmap *prev = state->dest;
+		prev = state->dest;
 		while (i > 0)
 		{
 			prev = dev->stack[--i].dest;
 			if (prev != state->dest)
 				break;
 		}
-		if (prev)
-			fz_copy_pixmap_rect(ctx, dest, prev, &bbox);
-		else
-			fz_clear_pixmap(ctx, dest);
 	}
 
+	dest = fz_new_draw_pixmap(ctx, dev, state->dest->colorspace, &bbox, prev == NULL);
+	if (prev)
+		fz_copy_pixmap_rect(ctx, dest, prev, &bbox);
+
 	if ((state->blendmode & FZ_BLEND_MODEMASK) == 0 && isolated)
 	{
 		/* We can render direct to any existing shape plane. If there
@@ -194,8 +378,7 @@ fz_knockout_begin(fz_context *ctx, fz_draw_device *dev)
 	}
 	else
 	{
-		shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-		fz_clear_pixmap(ctx, shape);
+		shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 	}
 #ifdef DUMP_GROUP_BLENDS
 	dump_spaces(dev->top-1, "Knockout begin\n");
@@ -424,14 +607,11 @@ fz_draw_clip_path(fz_context *ctx, fz_device *devp, fz_path *path, const fz_rect
 
 	fz_try(ctx)
 	{
-		state[1].mask = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-		fz_clear_pixmap(ctx, state[1].mask);
-		state[1].dest = fz_new_pixmap_with_bbox(ctx, model, &bbox);
-		fz_clear_pixmap(ctx, state[1].dest);
+		state[1].mask = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
+		state[1].dest = fz_new_draw_pixmap(ctx, dev, model, &bbox, 1);
 		if (state[1].shape)
 		{
-			state[1].shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, state[1].shape);
+			state[1].shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 
 		fz_scan_convert(ctx, gel, even_odd, &bbox, state[1].mask, NULL);
@@ -486,14 +666,11 @@ fz_draw_clip_stroke_path(fz_context *ctx, fz_device *devp, fz_path *path, const
 
 	fz_try(ctx)
 	{
-		state[1].mask = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-		fz_clear_pixmap(ctx, state[1].mask);
-		state[1].dest = fz_new_pixmap_with_bbox(ctx, model, &bbox);
-		fz_clear_pixmap(ctx, state[1].dest);
+		state[1].mask = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
+		state[1].dest = fz_new_draw_pixmap(ctx, dev, model, &bbox, 1);
 		if (state->shape)
 		{
-			state[1].shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, state[1].shape);
+			state[1].shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 
 		if (!fz_is_empty_irect(&bbox))
@@ -612,7 +789,7 @@ fz_draw_fill_text(fz_context *ctx, fz_device *devp, fz_text *text, const fz_matr
 				fz_matrix mat;
 				mat.a = pixmap->w; mat.b = mat.c = 0; mat.d = pixmap->h;
 				mat.e = x + pixmap->x; mat.f = y + pixmap->y;
-				fz_paint_image(state->dest, &state->scissor, state->shape, pixmap, &mat, alpha * 255, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
+				fz_paint_image(state->dest, &state->scissor, state->shape, pixmap, NULL, &mat, alpha * 255, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
 			}
 			fz_drop_glyph(ctx, glyph);
 		}
@@ -737,14 +914,11 @@ fz_draw_clip_text(fz_context *ctx, fz_device *devp, fz_text *text, const fz_matr
 	{
 		if (accumulate == 0 || accumulate == 1)
 		{
-			mask = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, mask);
-			dest = fz_new_pixmap_with_bbox(ctx, model, &bbox);
-			fz_clear_pixmap(ctx, dest);
+			mask = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
+			dest = fz_new_draw_pixmap(ctx, dev, model, &bbox, 1);
 			if (state->shape)
 			{
-				shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-				fz_clear_pixmap(ctx, shape);
+				shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 			}
 			else
 				shape = NULL;
@@ -851,14 +1025,11 @@ fz_draw_clip_stroke_text(fz_context *ctx, fz_device *devp, fz_text *text, fz_str
 
 	fz_try(ctx)
 	{
-		state[1].mask = mask = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-		fz_clear_pixmap(ctx, mask);
-		state[1].dest = dest = fz_new_pixmap_with_bbox(ctx, model, &bbox);
-		fz_clear_pixmap(ctx, dest);
+		state[1].mask = mask = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
+		state[1].dest = dest = fz_new_draw_pixmap(ctx, dev, model, &bbox, 1);
 		if (state->shape)
 		{
-			state[1].shape = shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, shape);
+			state[1].shape = shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 		else
 			shape = state->shape;
@@ -972,12 +1143,10 @@ fz_draw_fill_shade(fz_context *ctx, fz_device *devp, fz_shade *shade, const fz_m
 
 	if (alpha < 1)
 	{
-		dest = fz_new_pixmap_with_bbox(ctx, state->dest->colorspace, &bbox);
-		fz_clear_pixmap(ctx, dest);
+		dest = fz_new_draw_pixmap(ctx, dev, state->dest->colorspace, &bbox, 1);
 		if (shape)
 		{
-			shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, shape);
+			shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 	}
 
@@ -1032,8 +1201,10 @@ fz_draw_fill_shade(fz_context *ctx, fz_device *devp, fz_shade *shade, const fz_m
 		fz_knockout_end(ctx, dev);
 }
 
+/* If image is only part of the image being drawn, whole gives the bounds
+ * of that in the pixels of image. Parts are only drawn rectilinearly. */
 static fz_pixmap *
-fz_transform_pixmap(fz_context *ctx, fz_draw_device *dev, fz_pixmap *image, fz_matrix *ctm, int x, int y, int dx, int dy, int gridfit, const fz_irect *clip)
+fz_transform_pixmap(fz_context *ctx, fz_draw_device *dev, fz_pixmap *image, const fz_irect *whole, fz_matrix *ctm, int x, int y, int dx, int dy, int gridfit, const fz_irect *clip)
 {
 	fz_pixmap *scaled;
 
@@ -1043,7 +1214,7 @@ fz_transform_pixmap(fz_context *ctx, fz_draw_device *dev, fz_pixmap *image, fz_m
 		fz_matrix m = *ctm;
 		if (gridfit)
 			fz_gridfit_matrix(&m);
-		scaled = fz_scale_pixmap_cached(ctx, image, m.e, m.f, m.a, m.d, clip, dev->cache_x, dev->cache_y);
+		scaled = fz_scale_pixmap_part(ctx, image, whole, m.e, m.f, m.a, m.d, clip, dev->cache_x, dev->cache_y);
 		if (!scaled)
 			return NULL;
 		ctm->a = scaled->w;
@@ -1067,7 +1238,7 @@ fz_transform_pixmap(fz_context *ctx, fz_draw_device *dev, fz_pixmap *image, fz_m
 			rclip.x1 = clip->y1;
 			rclip.y1 = clip->x1;
 		}
-		scaled = fz_scale_pixmap_cached(ctx, image, m.f, m.e, m.b, m.c, (clip ? &rclip : NULL), dev->cache_x, dev->cache_y);
+		scaled = fz_scale_pixmap_part(ctx, image, whole, m.f, m.e, m.b, m.c, (clip ? &rclip : NULL), dev->cache_x, dev->cache_y);
 		if (!scaled)
 			return NULL;
 		ctm->b = scaled->w;
@@ -1087,6 +1258,60 @@ fz_transform_pixmap(fz_context *ctx, fz_draw_device *dev, fz_pixmap *image, fz_m
 	return NULL;
 }
 
+/* Get the part of an image that can show through the clip. If that is
+ * less than the whole, *part is set, and whole to the bounds of the whole
+ * image in the pixels of the part, to draw it with as if it was all there
+ * (see fz_transform_pixmap). Only images drawn rectilinearly come in
+ * parts. Returns NULL if none of the image can show. */
+static fz_pixmap *
+fz_draw_image_region(fz_context *ctx, fz_image *image, const fz_matrix *ctm, const fz_irect *clip, int dx, int dy, fz_irect *whole, int *part)
+{
+	fz_irect area, bounds;
+	fz_matrix inverse, m;
+	fz_pixmap *pixmap;
+	fz_rect rect;
+	float exp;
+	int l2factor, f;
+
+	*part = 0;
+	if (fz_is_empty_irect(clip))
+		return NULL;
+
+	bounds.x0 = 0;
+	bounds.y0 = 0;
+	bounds.x1 = image->w;
+	bounds.y1 = image->h;
+	area = bounds;
+	if (((ctm->b == 0 && ctm->c == 0) || (ctm->a == 0 && ctm->d == 0)) && !fz_try_invert_matrix(&inverse, ctm))
+	{
+		/* Map the clip back to image pixels, leaving room around it for
+		 * grid fitting, for the support of the scaling filters, and for
+		 * interpolation. */
+		fz_concat(&inverse, &inverse, fz_scale(&m, image->w, image->h));
+		exp = fz_matrix_max_expansion(&inverse);
+		fz_rect_from_irect(&rect, clip);
+		fz_transform_rect(&rect, &inverse);
+		fz_expand_rect(&rect, fz_max(exp, 1) * 8);
+		fz_irect_from_rect(&area, &rect);
+		fz_intersect_irect(&area, &bounds);
+		if (fz_is_empty_irect(&area))
+			return NULL;
+	}
+
+	pixmap = fz_image_get_pixmap_region(ctx, image, &area, dx, dy, &l2factor);
+	if (area.x0 == 0 && area.y0 == 0 && area.x1 == image->w && area.y1 == image->h)
+		return pixmap;
+
+	f = 1 << l2factor;
+	whole->x0 = -(area.x0 >> l2factor);
+	whole->y0 = -(area.y0 >> l2factor);
+	whole->x1 = whole->x0 + ((image->w + f - 1) >> l2factor);
+	whole->y1 = whole->y0 + ((image->h + f - 1) >> l2factor);
+	*part = 1;
+
+	return pixmap;
+}
+
 static void
 fz_draw_fill_image(fz_context *ctx, fz_device *devp, fz_image *image, const fz_matrix *ctm, float alpha)
 {
@@ -1101,6 +1326,8 @@ fz_draw_fill_image(fz_context *ctx, fz_device *devp, fz_image *image, const fz_m
 	fz_colorspace *model = state->dest->colorspace;
 	fz_irect clip;
 	fz_matrix local_ctm = *ctm;
+	fz_irect whole;
+	int part, iw, ih;
 
 	fz_intersect_irect(fz_pixmap_bbox(ctx, state->dest, &clip), &state->scissor);
 
@@ -1118,8 +1345,12 @@ fz_draw_fill_image(fz_context *ctx, fz_device *devp, fz_image *image, const fz_m
 	dx = sqrtf(local_ctm.a * local_ctm.a + local_ctm.b * local_ctm.b);
 	dy = sqrtf(local_ctm.c * local_ctm.c + local_ctm.d * local_ctm.d);
 
-	pixmap = fz_new_pixmap_from_image(ctx, image, dx, dy);
+	pixmap = fz_draw_image_region(ctx, image, &local_ctm, &clip, dx, dy, &whole, &part);
+	if (!pixmap)
+		return;
 	orig_pixmap = pixmap;
+	iw = part ? whole.x1 - whole.x0 : pixmap->w;
+	ih = part ? whole.y1 - whole.y0 : pixmap->h;
 
 	/* convert images with more components (cmyk->rgb) before scaling */
 	/* convert images with fewer components (gray->rgb after scaling */
@@ -1138,16 +1369,16 @@ fz_draw_fill_image(fz_context *ctx, fz_device *devp, fz_image *image, const fz_m
 		{
 			fz_irect bbox;
 			fz_pixmap_bbox(ctx, pixmap, &bbox);
-			converted = fz_new_pixmap_with_bbox(ctx, model, &bbox);
+			converted = fz_new_draw_pixmap(ctx, dev, model, &bbox, 0);
 			fz_convert_pixmap(ctx, converted, pixmap);
 			pixmap = converted;
 		}
 
-		if (dx < pixmap->w && dy < pixmap->h && !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES))
+		if (dx < iw && dy < ih && !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES))
 		{
 			int gridfit = alpha == 1.0f && !(dev->flags & FZ_DRAWDEV_FLAGS_TYPE3);
-			scaled = fz_transform_pixmap(ctx, dev, pixmap, &local_ctm, state->dest->x, state->dest->y, dx, dy, gridfit, &clip);
-			if (!scaled)
+			scaled = fz_transform_pixmap(ctx, dev, pixmap, (part ? &whole : NULL), &local_ctm, state->dest->x, state->dest->y, dx, dy, gridfit, &clip);
+			if (!scaled && !part)
 			{
 				if (dx < 1)
 					dx = 1;
@@ -1156,7 +1387,10 @@ fz_draw_fill_image(fz_context *ctx, fz_device *devp, fz_image *image, const fz_m
 				scaled = fz_scale_pixmap_cached(ctx, pixmap, pixmap->x, pixmap->y, dx, dy, NULL, dev->cache_x, dev->cache_y);
 			}
 			if (scaled)
+			{
 				pixmap = scaled;
+				part = 0;
+			}
 		}
 
 		if (pixmap->colorspace != model)
@@ -1170,13 +1404,13 @@ fz_draw_fill_image(fz_context *ctx, fz_device *devp, fz_image *image, const fz_m
 			{
 				fz_irect bbox;
 				fz_pixmap_bbox(ctx, pixmap, &bbox);
-				converted = fz_new_pixmap_with_bbox(ctx, model, &bbox);
+				converted = fz_new_draw_pixmap(ctx, dev, model, &bbox, 0);
 				fz_convert_pixmap(ctx, converted, pixmap);
 				pixmap = converted;
 			}
 		}
 
-		fz_paint_image(state->dest, &state->scissor, state->shape, pixmap, &local_ctm, alpha * 255, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
+		fz_paint_image(state->dest, &state->scissor, state->shape, pixmap, (part ? &whole : NULL), &local_ctm, alpha * 255, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
 
 		if (state->blendmode & FZ_BLEND_KNOCKOUT)
 			fz_knockout_end(ctx, dev);
@@ -1209,6 +1443,8 @@ fz_draw_fill_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 	fz_colorspace *model = state->dest->colorspace;
 	fz_irect clip;
 	fz_matrix local_ctm = *ctm;
+	fz_irect whole;
+	int part, iw, ih;
 
 	fz_pixmap_bbox(ctx, state->dest, &clip);
 	fz_intersect_irect(&clip, &state->scissor);
@@ -1218,19 +1454,23 @@ fz_draw_fill_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 
 	dx = sqrtf(local_ctm.a * local_ctm.a + local_ctm.b * local_ctm.b);
 	dy = sqrtf(local_ctm.c * local_ctm.c + local_ctm.d * local_ctm.d);
-	pixmap = fz_new_pixmap_from_image(ctx, image, dx, dy);
+	pixmap = fz_draw_image_region(ctx, image, &local_ctm, &clip, dx, dy, &whole, &part);
+	if (!pixmap)
+		return;
 	orig_pixmap = pixmap;
+	iw = part ? whole.x1 - whole.x0 : pixmap->w;
+	ih = part ? whole.y1 - whole.y0 : pixmap->h;
 
 	fz_try(ctx)
 	{
 		if (state->blendmode & FZ_BLEND_KNOCKOUT)
 			state = fz_knockout_begin(ctx, dev);
 
-		if (dx < pixmap->w && dy < pixmap->h)
+		if (dx < iw && dy < ih)
 		{
 			int gridfit = alpha == 1.0f && !(dev->flags & FZ_DRAWDEV_FLAGS_TYPE3);
-			scaled = fz_transform_pixmap(ctx, dev, pixmap, &local_ctm, state->dest->x, state->dest->y, dx, dy, gridfit, &clip);
-			if (!scaled)
+			scaled = fz_transform_pixmap(ctx, dev, pixmap, (part ? &whole : NULL), &local_ctm, state->dest->x, state->dest->y, dx, dy, gridfit, &clip);
+			if (!scaled && !part)
 			{
 				if (dx < 1)
 					dx = 1;
@@ -1239,7 +1479,10 @@ fz_draw_fill_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 				scaled = fz_scale_pixmap_cached(ctx, pixmap, pixmap->x, pixmap->y, dx, dy, NULL, dev->cache_x, dev->cache_y);
 			}
 			if (scaled)
+			{
 				pixmap = scaled;
+				part = 0;
+			}
 		}
 
 		fz_convert_color(ctx, model, colorfv, colorspace, color);
@@ -1247,7 +1490,7 @@ fz_draw_fill_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 			colorbv[i] = colorfv[i] * 255;
 		colorbv[i] = alpha * 255;
 
-		fz_paint_image_with_color(state->dest, &state->scissor, state->shape, pixmap, &local_ctm, colorbv, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
+		fz_paint_image_with_color(state->dest, &state->scissor, state->shape, pixmap, (part ? &whole : NULL), &local_ctm, colorbv, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
 
 		if (scaled)
 			fz_drop_pixmap(ctx, scaled);
@@ -1282,6 +1525,8 @@ fz_draw_clip_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 	fz_irect clip;
 	fz_matrix local_ctm = *ctm;
 	fz_rect urect;
+	fz_irect whole;
+	int part, iw, ih;
 
 	STACK_PUSHED("clip image mask");
 	fz_pixmap_bbox(ctx, state->dest, &clip);
@@ -1292,6 +1537,7 @@ fz_draw_clip_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 	fz_var(shape);
 	fz_var(pixmap);
 	fz_var(orig_pixmap);
+	fz_var(scaled);
 
 	if (image->w == 0 || image->h == 0)
 	{
@@ -1321,28 +1567,27 @@ fz_draw_clip_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 
 	fz_try(ctx)
 	{
-		pixmap = fz_new_pixmap_from_image(ctx, image, dx, dy);
+		pixmap = fz_draw_image_region(ctx, image, &local_ctm, &bbox, dx, dy, &whole, &part);
 		orig_pixmap = pixmap;
+		iw = part ? whole.x1 - whole.x0 : pixmap ? pixmap->w : 0;
+		ih = part ? whole.y1 - whole.y0 : pixmap ? pixmap->h : 0;
 
-		state[1].mask = mask = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-		fz_clear_pixmap(ctx, mask);
+		state[1].mask = mask = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 
-		state[1].dest = dest = fz_new_pixmap_with_bbox(ctx, model, &bbox);
-		fz_clear_pixmap(ctx, dest);
+		state[1].dest = dest = fz_new_draw_pixmap(ctx, dev, model, &bbox, 1);
 		if (state->shape)
 		{
-			state[1].shape = shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, shape);
+			state[1].shape = shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 
 		state[1].blendmode |= FZ_BLEND_ISOLATED;
 		state[1].scissor = bbox;
 
-		if (dx < pixmap->w && dy < pixmap->h)
+		if (pixmap && dx < iw && dy < ih)
 		{
 			int gridfit = !(dev->flags & FZ_DRAWDEV_FLAGS_TYPE3);
-			scaled = fz_transform_pixmap(ctx, dev, pixmap, &local_ctm, state->dest->x, state->dest->y, dx, dy, gridfit, &clip);
-			if (!scaled)
+			scaled = fz_transform_pixmap(ctx, dev, pixmap, (part ? &whole : NULL), &local_ctm, state->dest->x, state->dest->y, dx, dy, gridfit, &clip);
+			if (!scaled && !part)
 			{
 				if (dx < 1)
 					dx = 1;
@@ -1351,9 +1596,13 @@ fz_draw_clip_image_mask(fz_context *ctx, fz_device *devp, fz_image *image, const
 				scaled = fz_scale_pixmap_cached(ctx, pixmap, pixmap->x, pixmap->y, dx, dy, NULL, dev->cache_x, dev->cache_y);
 			}
 			if (scaled)
+			{
 				pixmap = scaled;
+				part = 0;
+			}
 		}
-		fz_paint_image(mask, &bbox, state->shape, pixmap, &local_ctm, 255, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
+		if (pixmap)
+			fz_paint_image(mask, &bbox, state->shape, pixmap, (part ? &whole : NULL), &local_ctm, 255, !(devp->hints & FZ_DONT_INTERPOLATE_IMAGES));
 	}
 	fz_always(ctx)
 	{
@@ -1437,7 +1686,7 @@ fz_draw_begin_mask(fz_context *ctx, fz_device *devp, const fz_rect *rect, int lu
 
 	fz_try(ctx)
 	{
-		state[1].dest = dest = fz_new_pixmap_with_bbox(ctx, fz_device_gray(ctx), &bbox);
+		state[1].dest = dest = fz_new_draw_pixmap(ctx, dev, fz_device_gray(ctx), &bbox, !luminosity);
 		if (state->shape)
 		{
 			/* FIXME: If we ever want to support AIS true, then
@@ -1459,11 +1708,9 @@ fz_draw_begin_mask(fz_context *ctx, fz_device *devp, const fz_rect *rect, int lu
 			if (shape)
 				fz_clear_pixmap_with_value(ctx, shape, 255);
 		}
-		else
+		else if (shape)
 		{
-			fz_clear_pixmap(ctx, dest);
-			if (shape)
-				fz_clear_pixmap(ctx, shape);
+			fz_clear_pixmap(ctx, shape);
 		}
 
 #ifdef DUMP_GROUP_BLENDS
@@ -1516,8 +1763,7 @@ fz_draw_end_mask(fz_context *ctx, fz_device *devp)
 
 		/* create new dest scratch buffer */
 		fz_pixmap_bbox(ctx, temp, &bbox);
-		dest = fz_new_pixmap_with_bbox(ctx, state->dest->colorspace, &bbox);
-		fz_clear_pixmap(ctx, dest);
+		dest = fz_new_draw_pixmap(ctx, dev, state->dest->colorspace, &bbox, 1);
 
 		/* push soft mask as clip mask */
 		state[1].dest = dest;
@@ -1526,8 +1772,7 @@ fz_draw_end_mask(fz_context *ctx, fz_device *devp)
 		 * clip mask when we pop. So create a new shape now. */
 		if (state[0].shape)
 		{
-			state[1].shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, state[1].shape);
+			state[1].shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 		state[1].scissor = bbox;
 	}
@@ -1555,21 +1800,14 @@ fz_draw_begin_group(fz_context *ctx, fz_device *devp, const fz_rect *rect, int i
 
 	fz_try(ctx)
 	{
-		state[1].dest = dest = fz_new_pixmap_with_bbox(ctx, model, &bbox);
-
 #ifndef ATTEMPT_KNOCKOUT_AND_ISOLATED
 		knockout = 0;
 		isolated = 1;
 #endif
 
-		if (isolated)
-		{
-			fz_clear_pixmap(ctx, dest);
-		}
-		else
-		{
+		state[1].dest = dest = fz_new_draw_pixmap(ctx, dev, model, &bbox, isolated);
+		if (!isolated)
 			fz_copy_pixmap_rect(ctx, dest, state[0].dest, &bbox);
-		}
 
 		if (blendmode == 0 && alpha == 1.0 && isolated)
 		{
@@ -1579,8 +1817,7 @@ fz_draw_begin_group(fz_context *ctx, fz_device *devp, const fz_rect *rect, int i
 		}
 		else
 		{
-			state[1].shape = fz_new_pixmap_with_bbox(ctx, NULL, &bbox);
-			fz_clear_pixmap(ctx, state[1].shape);
+			state[1].shape = fz_new_draw_pixmap(ctx, dev, NULL, &bbox, 1);
 		}
 
 		state[1].alpha = alpha;
@@ -2040,6 +2277,7 @@ fz_draw_drop_imp(fz_context *ctx, fz_device *devp)
 	fz_drop_scale_cache(ctx, dev->cache_x);
 	fz_drop_scale_cache(ctx, dev->cache_y);
 	fz_drop_gel(ctx, gel);
+	fz_close_draw_pool(ctx, dev->pool);
 }
 
 fz_device *
@@ -2093,6 +2331,7 @@ fz_new_draw_device(fz_context *ctx, fz_pixmap *dest)
 		dev->gel = fz_new_gel(ctx);
 		dev->cache_x = fz_new_scale_cache(ctx);
 		dev->cache_y = fz_new_scale_cache(ctx);
+		dev->pool = fz_new_draw_pool(ctx, dest);
 	}
 	fz_catch(ctx)
 	{
@@ -22,8 +22,13 @@ struct fz_aa_context_s
 	int vscale;
 	int scale;
 	int bits;
+	int scan_converter;
 };
 
+/* Cells are addressed in 1/CELL_ONE pixel units (24.8 fixed point) */
+#define CELL_BITS 8
+#define CELL_ONE (1<<CELL_BITS)
+
 void fz_new_aa_context(fz_context *ctx)
 {
 #ifndef AA_BITS
@@ -32,6 +37,7 @@ void fz_new_aa_context(fz_context *ctx)
 	ctx->aa->vscale = 15;
 	ctx->aa->scale = 256;
 	ctx->aa->bits = 8;
+	ctx->aa->scan_converter = FZ_SCAN_CONVERTER_GEL;
 
 #define fz_aa_hscale ((ctxaa)->hscale)
 #define fz_aa_vscale ((ctxaa)->vscale)
@@ -136,6 +142,47 @@ fz_set_aa_level(fz_context *ctx, int level)
 		fz_aa_bits = 0;
 	}
 	fz_aa_scale = 0xFF00 / (fz_aa_hscale * fz_aa_vscale);
+
+	/* The cell converter works at a fixed subpixel precision, and
+	 * only takes over from the gel when antialiasing is on. */
+	if (ctxaa->scan_converter == FZ_SCAN_CONVERTER_CELLS && fz_aa_bits > 0)
+	{
+		fz_aa_hscale = CELL_ONE;
+		fz_aa_vscale = CELL_ONE;
+	}
+#endif
+}
+
+int
+fz_scan_converter(fz_context *ctx)
+{
+#ifdef AA_BITS
+	return FZ_SCAN_CONVERTER_GEL;
+#else
+	return ctx->aa->scan_converter;
+#endif
+}
+
+void
+fz_set_scan_converter(fz_context *ctx, int converter)
+{
+#ifdef AA_BITS
+	if (converter != FZ_SCAN_CONVERTER_GEL)
+		fz_warn(ctx, "anti-aliasing was compiled with a fixed precision of %d bits", fz_aa_bits);
+#else
+	fz_aa_context *ctxaa = ctx->aa;
+	ctxaa->scan_converter = converter == FZ_SCAN_CONVERTER_CELLS ? FZ_SCAN_CONVERTER_CELLS : FZ_SCAN_CONVERTER_GEL;
+	fz_set_aa_level(ctx, fz_aa_bits);
+#endif
+}
+
+static inline int
+use_cells(fz_aa_context *ctxaa)
+{
+#ifdef AA_BITS
+	return 0;
+#else
+	return ctxaa->scan_converter == FZ_SCAN_CONVERTER_CELLS && fz_aa_bits > 0;
 #endif
 }
 
@@ -157,6 +204,15 @@ struct fz_edge_s
 	int xdir, ydir; /* -1 or +1 */
 };
 
+/* Area coverage accumulated by the cell converter for one pixel */
+typedef struct fz_cell_s fz_cell;
+
+struct fz_cell_s
+{
+	int x, y;
+	int cover, area;
+};
+
 struct fz_gel_s
 {
 	fz_rect clip;
@@ -165,6 +221,8 @@ struct fz_gel_s
 	fz_edge *edges;
 	int acap, alen;
 	fz_edge **active;
+	int ccap, clen;
+	fz_cell *cells;
 };
 
 fz_gel *
@@ -230,6 +288,7 @@ fz_drop_gel(fz_context *ctx, fz_gel *gel)
 {
 	if (gel == NULL)
 		return;
+	fz_free(ctx, gel->cells);
 	fz_free(ctx, gel->active);
 	fz_free(ctx, gel->edges);
 	fz_free(ctx, gel);
@@ -441,6 +500,9 @@ fz_sort_gel(fz_context *ctx, fz_gel *gel)
 	int h, i, k;
 	fz_edge t;
 
+	/* the cell converter does not need the edges in order */
+	if (use_cells(ctx->aa))
+		return;
 
 	/* quick sort for long lists */
 	if (n > 10000)
@@ -880,6 +942,396 @@ clip_ended:
 	fz_free(ctx, alphas);
 }
 
+/*
+ * Cell based anti-aliased scan conversion.
+ *
+ * Rather than sampling each pixel on a grid of sub scanlines, every edge
+ * is walked once through the pixels it crosses, recording for each one
+ * the signed height of the edge within it (cover) and twice the area to
+ * the left of the edge (area). Summing the covers of the cells to the
+ * left of a pixel gives its winding, and subtracting the area gives its
+ * exact coverage. This is the approach taken by FreeType and libart.
+ */
+
+static inline int
+floordiv64(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+	if ((a % b != 0) && ((a < 0) != (b < 0)))
+		q--;
+	return (int)q;
+}
+
+static inline void
+add_cell(fz_context *ctx, fz_gel *gel, const fz_irect *clip, int x, int y, int cover, int area)
+{
+	fz_cell *cell;
+
+	if (cover == 0 && area == 0)
+		return;
+
+	/* Cells right of the clip never affect a visible pixel, and only the
+	 * cover of the cells left of it matters. */
+	if (x >= clip->x1)
+		return;
+	if (x < clip->x0)
+	{
+		x = clip->x0 - 1;
+		area = 0;
+	}
+
+	/* An edge visits each cell once, so only the last one can match */
+	if (gel->clen > 0)
+	{
+		cell = &gel->cells[gel->clen - 1];
+		if (cell->x == x && cell->y == y)
+		{
+			cell->cover += cover;
+			cell->area += area;
+			return;
+		}
+	}
+
+	/* The second half of the array is kept free for sorting */
+	if (gel->clen == gel->ccap)
+	{
+		int new_cap = gel->ccap ? gel->ccap * 2 : 1024;
+		gel->cells = fz_resize_array(ctx, gel->cells, new_cap * 2, sizeof(fz_cell));
+		gel->ccap = new_cap;
+	}
+
+	cell = &gel->cells[gel->clen++];
+	cell->x = x;
+	cell->y = y;
+	cell->cover = cover;
+	cell->area = area;
+}
+
+/* Render the part of an edge within pixel row ey, from (x0, fy0) to
+ * (x1, fy1), where fy0 <= fy1 are offsets within the row. */
+static void
+cell_row(fz_context *ctx, fz_gel *gel, const fz_irect *clip, int ey, int x0, int fy0, int x1, int fy1, int dir)
+{
+	int ex0 = x0 >> CELL_BITS;
+	int ex1 = x1 >> CELL_BITS;
+	int fx0 = x0 & (CELL_ONE-1);
+	int fx1 = x1 & (CELL_ONE-1);
+	int dx, dy, first, incr, p, delta, mod, lift, rem;
+
+	dy = fy1 - fy0;
+	if (ex0 == ex1)
+	{
+		add_cell(ctx, gel, clip, ex0, ey, dir * dy, dir * (fx0 + fx1) * dy);
+		return;
+	}
+
+	/* Step through the cells crossed, splitting at each cell boundary.
+	 * The height of each piece is kept exact with a running remainder,
+	 * as in Bresenham's algorithm. */
+	dx = x1 - x0;
+	if (dx > 0)
+	{
+		first = CELL_ONE;
+		incr = 1;
+		p = (CELL_ONE - fx0) * dy;
+	}
+	else
+	{
+		first = 0;
+		incr = -1;
+		p = fx0 * dy;
+		dx = -dx;
+	}
+
+	delta = p / dx;
+	mod = p % dx;
+	add_cell(ctx, gel, clip, ex0, ey, dir * delta, dir * (fx0 + first) * delta);
+	ex0 += incr;
+	fy0 += delta;
+
+	if (ex0 != ex1)
+	{
+		p = CELL_ONE * dy;
+		lift = p / dx;
+		rem = p % dx;
+		do
+		{
+			delta = lift;
+			mod += rem;
+			if (mod >= dx)
+			{
+				mod -= dx;
+				delta++;
+			}
+			add_cell(ctx, gel, clip, ex0, ey, dir * delta, dir * CELL_ONE * delta);
+			ex0 += incr;
+			fy0 += delta;
+		}
+		while (ex0 != ex1);
+	}
+
+	delta = fy1 - fy0;
+	add_cell(ctx, gel, clip, ex1, ey, dir * delta, dir * (CELL_ONE - first + fx1) * delta);
+}
+
+/* Render an edge from (x0, y0) to (x1, y1), y0 < y1, in subpixel units */
+static void
+cell_edge(fz_context *ctx, fz_gel *gel, const fz_irect *clip, int x0, int y0, int x1, int y1, int dir)
+{
+	int ymin = clip->y0 << CELL_BITS;
+	int ymax = clip->y1 << CELL_BITS;
+	int ey0, ey1, fy0, fy1, xa, xb;
+	int64_t dx, dy, p, delta, mod, lift, rem;
+
+	if (y1 <= ymin || y0 >= ymax)
+		return;
+
+	/* Rows above and below the clip cannot affect it */
+	if (y0 < ymin)
+	{
+		x0 += floordiv64((int64_t)(x1 - x0) * (ymin - y0), y1 - y0);
+		y0 = ymin;
+	}
+	if (y1 > ymax)
+	{
+		x1 = x0 + floordiv64((int64_t)(x1 - x0) * (ymax - y0), y1 - y0);
+		y1 = ymax;
+	}
+
+	ey0 = y0 >> CELL_BITS;
+	ey1 = (y1 - 1) >> CELL_BITS;
+	fy0 = y0 & (CELL_ONE-1);
+	fy1 = y1 - (ey1 << CELL_BITS);
+
+	if (ey0 == ey1)
+	{
+		cell_row(ctx, gel, clip, ey0, x0, fy0, x1, fy1, dir);
+		return;
+	}
+
+	/* Vertical edges cover whole rows with no area to split */
+	if (x0 == x1)
+	{
+		int ex = x0 >> CELL_BITS;
+		int two_fx = (x0 & (CELL_ONE-1)) * 2;
+		add_cell(ctx, gel, clip, ex, ey0, dir * (CELL_ONE - fy0), dir * two_fx * (CELL_ONE - fy0));
+		for (ey0++; ey0 < ey1; ey0++)
+			add_cell(ctx, gel, clip, ex, ey0, dir * CELL_ONE, dir * two_fx * CELL_ONE);
+		add_cell(ctx, gel, clip, ex, ey1, dir * fy1, dir * two_fx * fy1);
+		return;
+	}
+
+	/* Step from row to row keeping x exact with a running remainder */
+	dx = (int64_t)x1 - x0;
+	dy = (int64_t)y1 - y0;
+	p = (CELL_ONE - fy0) * dx;
+	delta = p / dy;
+	mod = p % dy;
+	if (mod < 0)
+	{
+		delta--;
+		mod += dy;
+	}
+	xb = x0 + (int)delta;
+	cell_row(ctx, gel, clip, ey0, x0, fy0, xb, CELL_ONE, dir);
+
+	p = CELL_ONE * dx;
+	lift = p / dy;
+	rem = p % dy;
+	if (rem < 0)
+	{
+		lift--;
+		rem += dy;
+	}
+	for (ey0++; ey0 < ey1; ey0++)
+	{
+		xa = xb;
+		delta = lift;
+		mod += rem;
+		if (mod >= dy)
+		{
+			mod -= dy;
+			delta++;
+		}
+		xb = xa + (int)delta;
+		cell_row(ctx, gel, clip, ey0, xa, 0, xb, CELL_ONE, dir);
+	}
+
+	cell_row(ctx, gel, clip, ey1, xb, 0, x1, fy1, dir);
+}
+
+static void
+sort_cells(fz_cell *a, int n)
+{
+	int h, i, k;
+	fz_cell t;
+
+	h = 1;
+	if (n < 14) {
+		h = 1;
+	}
+	else {
+		while (h < n)
+			h = 3 * h + 1;
+		h /= 3;
+		h /= 3;
+	}
+
+	while (h > 0)
+	{
+		for (i = 0; i < n; i++) {
+			t = a[i];
+			k = i - h;
+			while (k >= 0 && a[k].x > t.x) {
+				a[k + h] = a[k];
+				k -= h;
+			}
+			a[k + h] = t;
+		}
+
+		h /= 3;
+	}
+}
+
+static inline int
+cell_alpha(int64_t area, int eofill)
+{
+	int coverage;
+
+	/* area is in 1/(2*CELL_ONE*CELL_ONE) pixels; reduce to 1/256 */
+	if (area < 0)
+		area = -area;
+	area >>= CELL_BITS * 2 + 1 - 8;
+
+	if (eofill)
+	{
+		coverage = (int)(area & 511);
+		if (coverage > 256)
+			coverage = 512 - coverage;
+	}
+	else
+		coverage = area > 255 ? 255 : (int)area;
+	return coverage > 255 ? 255 : coverage;
+}
+
+/* Does the row of cells a hold the same coverage as the row b? */
+static inline int
+same_cells(const fz_cell *a, const fz_cell *b, int n)
+{
+	while (n--)
+	{
+		if (a->x != b->x || a->cover != b->cover || a->area != b->area)
+			return 0;
+		a++;
+		b++;
+	}
+	return 1;
+}
+
+static void
+fz_scan_convert_cells(fz_context *ctx, fz_gel *gel, int eofill, const fz_irect *clip, fz_pixmap *dst, unsigned char *color)
+{
+	int height = clip->y1 - clip->y0;
+	int clipn = clip->x1 - clip->x0;
+	unsigned char *alphas;
+	fz_cell *sorted, *prev;
+	int *rows;
+	int i, y, prev_n, x0, x1;
+
+	gel->clen = 0;
+	for (i = 0; i < gel->len; i++)
+	{
+		fz_edge *edge = &gel->edges[i];
+		int width = fz_absi(edge->xmove) * edge->h + edge->adj_up;
+		cell_edge(ctx, gel, clip, edge->x, edge->y, edge->x + edge->xdir * width, edge->y + edge->h, edge->ydir);
+	}
+	if (gel->clen == 0)
+		return;
+
+	rows = fz_malloc_no_throw(ctx, (height + 1) * sizeof(int) + clipn);
+	if (rows == NULL)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "scan conversion failed (malloc failure)");
+	alphas = (unsigned char *)(rows + height + 1);
+
+	/* Bucket the cells by row, then sort each row by x */
+	sorted = gel->cells + gel->ccap;
+	memset(rows, 0, (height + 1) * sizeof(int));
+	for (i = 0; i < gel->clen; i++)
+		rows[gel->cells[i].y - clip->y0 + 1]++;
+	for (y = 0; y < height; y++)
+		rows[y + 1] += rows[y];
+	for (i = 0; i < gel->clen; i++)
+		sorted[rows[gel->cells[i].y - clip->y0]++] = gel->cells[i];
+	/* rows[y] now holds the end of row y, and so the start of row y+1 */
+
+	prev = NULL;
+	prev_n = 0;
+	x0 = x1 = 0;
+	for (y = 0; y < height; y++)
+	{
+		fz_cell *cell = sorted + (y > 0 ? rows[y - 1] : 0);
+		fz_cell *end = sorted + rows[y];
+		int n = end - cell;
+		int cover;
+
+		if (n == 0)
+		{
+			prev = NULL;
+			continue;
+		}
+
+		sort_cells(cell, n);
+
+		/* Runs of rows crossed only by vertical edges come out the same,
+		 * and so can reuse the coverage of the row above. */
+		if (prev && prev_n == n && same_cells(prev, cell, n))
+		{
+			if (x0 < x1)
+				blit_aa(dst, x0, clip->y0 + y, alphas + x0 - clip->x0, x1 - x0, color);
+			continue;
+		}
+		prev = cell;
+		prev_n = n;
+
+		/* Sweep the row, carrying the winding from cell to cell */
+		x0 = fz_maxi(cell->x, clip->x0);
+		x1 = x0;
+		cover = 0;
+		while (cell < end)
+		{
+			int x = cell->x;
+			int next, alpha;
+			int64_t area = 0;
+
+			do
+			{
+				cover += cell->cover;
+				area += cell->area;
+				cell++;
+			}
+			while (cell < end && cell->x == x);
+
+			if (x >= clip->x0)
+				alphas[x - clip->x0] = cell_alpha(((int64_t)cover << (CELL_BITS + 1)) - area, eofill);
+
+			/* The pixels up to the next cell are wholly inside or outside */
+			next = cell < end ? cell->x : (cover ? clip->x1 : x + 1);
+			x = fz_maxi(x + 1, clip->x0);
+			if (x < next)
+			{
+				alpha = cover ? cell_alpha((int64_t)cover << (CELL_BITS + 1), eofill) : 0;
+				memset(alphas + x - clip->x0, alpha, next - x);
+			}
+			x1 = fz_maxi(x1, next);
+		}
+
+		if (x0 < x1)
+			blit_aa(dst, x0, clip->y0 + y, alphas + x0 - clip->x0, x1 - x0, color);
+	}
+
+	fz_free(ctx, rows);
+}
+
 /*
  * Sharp (not anti-aliased) scan conversion
  */
@@ -997,7 +1449,9 @@ fz_scan_convert(fz_context *ctx, fz_gel *gel, int eofill, const fz_irect *clip,
 	if (fz_is_empty_irect(fz_intersect_irect(fz_pixmap_bbox_no_ctx(dst, &local_clip), clip)))
 		return;
 
-	if (fz_aa_bits > 0)
+	if (use_cells(ctxaa))
+		fz_scan_convert_cells(ctx, gel, eofill, &local_clip, dst, color);
+	else if (fz_aa_bits > 0)
 		fz_scan_convert_aa(ctx, gel, eofill, &local_clip, dst, color);
 	else
 		fz_scan_convert_sharp(ctx, gel, eofill, &local_clip, dst, color);
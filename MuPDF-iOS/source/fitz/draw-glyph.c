@@ -4,9 +4,12 @@
 #define MAX_GLYPH_SIZE 256
 #define MAX_CACHE_SIZE (1024*1024)
 
-#define GLYPH_HASH_LEN 509
+#define GLYPH_HASH_LEN 128
+#define GLYPH_FRONT_LEN 256
 
 typedef struct fz_glyph_cache_entry_s fz_glyph_cache_entry;
+typedef struct fz_glyph_cache_stripe_s fz_glyph_cache_stripe;
+typedef struct fz_glyph_front_slot_s fz_glyph_front_slot;
 typedef struct fz_glyph_key_s fz_glyph_key;
 
 struct fz_glyph_key_s
@@ -30,95 +33,217 @@ struct fz_glyph_cache_entry_s
 	fz_glyph *val;
 };
 
-struct fz_glyph_cache_s
+/*
+	Each stripe of the shared cache is a resizable chained hash table
+	with its own LRU list, protected by FZ_LOCK_GLYPHCACHE + stripe
+	number. Stripes never take one another's locks, except when
+	purging, where they are taken in descending order.
+*/
+struct fz_glyph_cache_stripe_s
 {
-	int refs;
-	int total;
-#ifndef NDEBUG
-	int num_evictions;
-	int evicted;
-#endif
-	fz_glyph_cache_entry *entry[GLYPH_HASH_LEN];
+	unsigned int total;
+	int count;
+	int len;
+	fz_glyph_cache_entry **entry;
 	fz_glyph_cache_entry *lru_head;
 	fz_glyph_cache_entry *lru_tail;
+	int hits;
+	int misses;
+	int num_evictions;
+	int evicted;
+};
+
+struct fz_glyph_cache_s
+{
+	int refs;
+	unsigned int max;
+	int generation;
+	fz_glyph_cache_stripe stripe[FZ_GLYPH_CACHE_STRIPES];
+};
+
+/*
+	The front cache is private to each context, so a hit in it does not
+	search or relink the shared entries; only the shared generation
+	number is read, under the stripe lock of the glyph. It is a direct
+	mapped table holding its own references to the glyphs and fonts it
+	contains. It is flushed whenever the shared cache is purged (as seen
+	by a change in the shared generation number).
+*/
+struct fz_glyph_front_slot_s
+{
+	fz_glyph_key key;
+	fz_glyph *val;
+};
+
+struct fz_glyph_front_s
+{
+	int generation;
+	int hits;
+	fz_glyph_front_slot slot[GLYPH_FRONT_LEN];
 };
 
 void
 fz_new_glyph_cache_context(fz_context *ctx)
 {
 	fz_glyph_cache *cache;
+	int i;
 
 	cache = fz_malloc_struct(ctx, fz_glyph_cache);
-	cache->total = 0;
+	fz_try(ctx)
+	{
+		for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+		{
+			cache->stripe[i].len = GLYPH_HASH_LEN;
+			cache->stripe[i].entry = fz_malloc_array(ctx, GLYPH_HASH_LEN, sizeof(fz_glyph_cache_entry *));
+			memset(cache->stripe[i].entry, 0, GLYPH_HASH_LEN * sizeof(fz_glyph_cache_entry *));
+		}
+	}
+	fz_catch(ctx)
+	{
+		for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+			fz_free(ctx, cache->stripe[i].entry);
+		fz_free(ctx, cache);
+		fz_rethrow(ctx);
+	}
+	cache->max = MAX_CACHE_SIZE;
 	cache->refs = 1;
 
 	ctx->glyph_cache = cache;
 }
 
 static void
-drop_glyph_cache_entry(fz_context *ctx, fz_glyph_cache_entry *entry)
+drop_glyph_cache_entries(fz_context *ctx, fz_glyph_cache_entry *entry)
 {
-	fz_glyph_cache *cache = ctx->glyph_cache;
+	fz_glyph_cache_entry *next;
+
+	while (entry)
+	{
+		next = entry->lru_next;
+		fz_drop_font(ctx, entry->key.font);
+		fz_drop_glyph(ctx, entry->val);
+		fz_free(ctx, entry);
+		entry = next;
+	}
+}
 
+/* The stripe lock is held when this function is called. The entry is
+ * unlinked from the stripe and pushed onto the 'dead' list (chained
+ * through lru_next), to be dropped once the lock has been released. */
+static void
+unlink_glyph_cache_entry(fz_context *ctx, fz_glyph_cache_stripe *stripe, fz_glyph_cache_entry *entry, fz_glyph_cache_entry **dead)
+{
 	if (entry->lru_next)
 		entry->lru_next->lru_prev = entry->lru_prev;
 	else
-		cache->lru_tail = entry->lru_prev;
+		stripe->lru_tail = entry->lru_prev;
 	if (entry->lru_prev)
 		entry->lru_prev->lru_next = entry->lru_next;
 	else
-		cache->lru_head = entry->lru_next;
-	cache->total -= fz_glyph_size(ctx, entry->val);
+		stripe->lru_head = entry->lru_next;
+	stripe->total -= fz_glyph_size(ctx, entry->val);
+	stripe->count--;
 	if (entry->bucket_next)
 		entry->bucket_next->bucket_prev = entry->bucket_prev;
 	if (entry->bucket_prev)
 		entry->bucket_prev->bucket_next = entry->bucket_next;
 	else
-		cache->entry[entry->hash] = entry->bucket_next;
-	fz_drop_font(ctx, entry->key.font);
-	fz_drop_glyph(ctx, entry->val);
-	fz_free(ctx, entry);
+		stripe->entry[(entry->hash / FZ_GLYPH_CACHE_STRIPES) & (stripe->len - 1)] = entry->bucket_next;
+	entry->lru_next = *dead;
+	*dead = entry;
 }
 
-/* The glyph cache lock is always held when this function is called. */
+/* The stripe lock is held when this function is called. */
 static void
-do_purge(fz_context *ctx)
+empty_stripe(fz_context *ctx, fz_glyph_cache_stripe *stripe, fz_glyph_cache_entry **dead)
 {
-	fz_glyph_cache *cache = ctx->glyph_cache;
-	int i;
+	while (stripe->lru_tail)
+		unlink_glyph_cache_entry(ctx, stripe, stripe->lru_tail, dead);
+}
 
-	for (i = 0; i < GLYPH_HASH_LEN; i++)
+/* The stripe lock is held when this function is called. */
+static void
+evict_stripe(fz_context *ctx, fz_glyph_cache_stripe *stripe, unsigned int max, fz_glyph_cache_entry **dead)
+{
+	while (stripe->lru_tail && stripe->total > max)
 	{
-		while (cache->entry[i])
-			drop_glyph_cache_entry(ctx, cache->entry[i]);
+		stripe->num_evictions++;
+		stripe->evicted += fz_glyph_size(ctx, stripe->lru_tail->val);
+		unlink_glyph_cache_entry(ctx, stripe, stripe->lru_tail, dead);
 	}
+}
+
+static void
+flush_glyph_front(fz_context *ctx, fz_glyph_front *front)
+{
+	int i;
 
-	cache->total = 0;
+	for (i = 0; i < GLYPH_FRONT_LEN; i++)
+	{
+		if (front->slot[i].val)
+		{
+			fz_drop_font(ctx, front->slot[i].key.font);
+			fz_drop_glyph(ctx, front->slot[i].val);
+			front->slot[i].val = NULL;
+		}
+	}
 }
 
 void
 fz_purge_glyph_cache(fz_context *ctx)
 {
-	fz_lock(ctx, FZ_LOCK_GLYPHCACHE);
-	do_purge(ctx);
-	fz_unlock(ctx, FZ_LOCK_GLYPHCACHE);
+	fz_glyph_cache *cache = ctx->glyph_cache;
+	fz_glyph_cache_entry *dead = NULL;
+	int i, generation;
+
+	if (ctx->glyph_front)
+		flush_glyph_front(ctx, ctx->glyph_front);
+
+	for (i = FZ_GLYPH_CACHE_STRIPES - 1; i >= 0; i--)
+		fz_lock(ctx, FZ_LOCK_GLYPHCACHE + i);
+	generation = ++cache->generation;
+	for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+		empty_stripe(ctx, &cache->stripe[i], &dead);
+	for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+		fz_unlock(ctx, FZ_LOCK_GLYPHCACHE + i);
+
+	drop_glyph_cache_entries(ctx, dead);
+
+	if (ctx->glyph_front)
+		ctx->glyph_front->generation = generation;
 }
 
 void
 fz_drop_glyph_cache_context(fz_context *ctx)
 {
-	if (!ctx->glyph_cache)
+	fz_glyph_cache *cache = ctx->glyph_cache;
+	fz_glyph_cache_entry *dead = NULL;
+	int i, refs;
+
+	if (ctx->glyph_front)
+	{
+		flush_glyph_front(ctx, ctx->glyph_front);
+		fz_free(ctx, ctx->glyph_front);
+		ctx->glyph_front = NULL;
+	}
+
+	if (!cache)
 		return;
 
 	fz_lock(ctx, FZ_LOCK_GLYPHCACHE);
-	ctx->glyph_cache->refs--;
-	if (ctx->glyph_cache->refs == 0)
+	refs = --cache->refs;
+	fz_unlock(ctx, FZ_LOCK_GLYPHCACHE);
+
+	ctx->glyph_cache = NULL;
+	if (refs == 0)
 	{
-		do_purge(ctx);
-		fz_free(ctx, ctx->glyph_cache);
-		ctx->glyph_cache = NULL;
+		for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+		{
+			empty_stripe(ctx, &cache->stripe[i], &dead);
+			fz_free(ctx, cache->stripe[i].entry);
+		}
+		drop_glyph_cache_entries(ctx, dead);
+		fz_free(ctx, cache);
 	}
-	fz_unlock(ctx, FZ_LOCK_GLYPHCACHE);
 }
 
 fz_glyph_cache *
@@ -130,6 +255,30 @@ fz_keep_glyph_cache(fz_context *ctx)
 	return ctx->glyph_cache;
 }
 
+void
+fz_set_glyph_cache_size(fz_context *ctx, unsigned int max)
+{
+	fz_glyph_cache *cache = ctx->glyph_cache;
+	fz_glyph_cache_entry *dead;
+	int i;
+
+	cache->max = max;
+	for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+	{
+		dead = NULL;
+		fz_lock(ctx, FZ_LOCK_GLYPHCACHE + i);
+		evict_stripe(ctx, &cache->stripe[i], max / FZ_GLYPH_CACHE_STRIPES, &dead);
+		fz_unlock(ctx, FZ_LOCK_GLYPHCACHE + i);
+		drop_glyph_cache_entries(ctx, dead);
+	}
+}
+
+unsigned int
+fz_glyph_cache_size(fz_context *ctx)
+{
+	return ctx->glyph_cache->max;
+}
+
 float
 fz_subpixel_adjust(fz_context *ctx, fz_matrix *ctm, fz_matrix *subpix_ctm, unsigned char *qe, unsigned char *qf)
 {
@@ -221,7 +370,7 @@ static unsigned do_hash(unsigned char *s, int len)
 }
 
 static inline void
-move_to_front(fz_glyph_cache *cache, fz_glyph_cache_entry *entry)
+move_to_front(fz_glyph_cache_stripe *stripe, fz_glyph_cache_entry *entry)
 {
 	if (entry->lru_prev == NULL)
 		return; /* At front already */
@@ -231,49 +380,159 @@ move_to_front(fz_glyph_cache *cache, fz_glyph_cache_entry *entry)
 	if (entry->lru_next)
 		entry->lru_next->lru_prev = entry->lru_prev;
 	else
-		cache->lru_tail = entry->lru_prev;
+		stripe->lru_tail = entry->lru_prev;
 	/* Relink */
-	entry->lru_next = cache->lru_head;
+	entry->lru_next = stripe->lru_head;
 	if (entry->lru_next)
 		entry->lru_next->lru_prev = entry;
-	cache->lru_head = entry;
+	stripe->lru_head = entry;
 	entry->lru_prev = NULL;
 }
 
+/* The stripe lock is held when this function is called. */
+static fz_glyph_cache_entry *
+find_glyph_cache_entry(fz_glyph_cache_stripe *stripe, fz_glyph_key *key, unsigned hash)
+{
+	fz_glyph_cache_entry *entry;
+
+	entry = stripe->entry[(hash / FZ_GLYPH_CACHE_STRIPES) & (stripe->len - 1)];
+	while (entry)
+	{
+		if (entry->hash == hash && memcmp(&entry->key, key, sizeof(*key)) == 0)
+			return entry;
+		entry = entry->bucket_next;
+	}
+	return NULL;
+}
+
+/* Double the number of buckets in a stripe once the chains get long.
+ * The stripe lock is dropped around the allocation, so the stripe may
+ * have been resized by someone else by the time we get it back. */
+static void
+grow_glyph_cache_stripe(fz_context *ctx, int lock, fz_glyph_cache_stripe *stripe)
+{
+	fz_glyph_cache_entry **newentry, **oldentry;
+	fz_glyph_cache_entry *entry, *next;
+	int oldlen = stripe->len;
+	int newlen = oldlen * 2;
+	int i, idx;
+
+	fz_unlock(ctx, lock);
+	newentry = fz_malloc_no_throw(ctx, newlen * sizeof(fz_glyph_cache_entry *));
+	if (newentry)
+		memset(newentry, 0, newlen * sizeof(fz_glyph_cache_entry *));
+	fz_lock(ctx, lock);
+	if (!newentry)
+		return;
+	if (stripe->len != oldlen)
+	{
+		fz_unlock(ctx, lock);
+		fz_free(ctx, newentry);
+		fz_lock(ctx, lock);
+		return;
+	}
+
+	oldentry = stripe->entry;
+	for (i = 0; i < oldlen; i++)
+	{
+		for (entry = oldentry[i]; entry; entry = next)
+		{
+			next = entry->bucket_next;
+			idx = (entry->hash / FZ_GLYPH_CACHE_STRIPES) & (newlen - 1);
+			entry->bucket_prev = NULL;
+			entry->bucket_next = newentry[idx];
+			if (entry->bucket_next)
+				entry->bucket_next->bucket_prev = entry;
+			newentry[idx] = entry;
+		}
+	}
+	stripe->entry = newentry;
+	stripe->len = newlen;
+
+	fz_unlock(ctx, lock);
+	fz_free(ctx, oldentry);
+	fz_lock(ctx, lock);
+}
+
+/* The generation is written with every stripe locked, so holding any
+ * one of them is enough to read it. The front is flushed after the lock
+ * is dropped, as dropping fonts can take other locks. */
+static fz_glyph_front *
+get_glyph_front(fz_context *ctx, int lock)
+{
+	fz_glyph_front *front = ctx->glyph_front;
+	int generation;
+
+	fz_lock(ctx, lock);
+	generation = ctx->glyph_cache->generation;
+	fz_unlock(ctx, lock);
+
+	if (!front)
+	{
+		front = fz_malloc_no_throw(ctx, sizeof(fz_glyph_front));
+		if (!front)
+			return NULL;
+		memset(front, 0, sizeof(*front));
+		front->generation = generation;
+		ctx->glyph_front = front;
+	}
+	else if (front->generation != generation)
+	{
+		flush_glyph_front(ctx, front);
+		front->generation = generation;
+	}
+	return front;
+}
+
+static void
+fill_glyph_front(fz_context *ctx, fz_glyph_front *front, fz_glyph_key *key, unsigned hash, fz_glyph *val)
+{
+	fz_glyph_front_slot *slot;
+
+	if (!front)
+		return;
+	slot = &front->slot[hash % GLYPH_FRONT_LEN];
+	if (slot->val)
+	{
+		fz_drop_font(ctx, slot->key.font);
+		fz_drop_glyph(ctx, slot->val);
+	}
+	slot->key = *key;
+	slot->val = fz_keep_glyph(ctx, val);
+	fz_keep_font(ctx, key->font);
+}
+
 fz_glyph *
 fz_render_glyph(fz_context *ctx, fz_font *font, int gid, fz_matrix *ctm, fz_colorspace *model, const fz_irect *scissor)
 {
 	fz_glyph_cache *cache;
+	fz_glyph_cache_stripe *stripe;
+	fz_glyph_front *front;
+	fz_glyph_front_slot *slot;
 	fz_glyph_key key;
 	fz_matrix subpix_ctm;
 	fz_irect subpix_scissor;
 	float size;
 	fz_glyph *val;
-	int do_cache, locked, caching;
-	fz_glyph_cache_entry *entry;
+	fz_glyph_cache_entry *entry, *existing, *dead;
 	unsigned hash;
-
-	fz_var(locked);
-	fz_var(caching);
-	fz_var(val);
+	int lock;
 
 	memset(&key, 0, sizeof key);
 	size = fz_subpixel_adjust(ctx, ctm, &subpix_ctm, &key.e, &key.f);
-	if (size <= MAX_GLYPH_SIZE)
-	{
-		scissor = &fz_infinite_irect;
-		do_cache = 1;
-	}
-	else
+	if (size > MAX_GLYPH_SIZE)
 	{
+		/* Too big to cache; render directly. */
 		if (font->ft_face)
 			return NULL;
 		subpix_scissor.x0 = scissor->x0 - floorf(ctm->e);
 		subpix_scissor.y0 = scissor->y0 - floorf(ctm->f);
 		subpix_scissor.x1 = scissor->x1 - floorf(ctm->e);
 		subpix_scissor.y1 = scissor->y1 - floorf(ctm->f);
-		scissor = &subpix_scissor;
-		do_cache = 0;
+		if (font->t3procs)
+			return fz_render_t3_glyph(ctx, font, gid, &subpix_ctm, model, &subpix_scissor);
+		fz_warn(ctx, "assert: uninitialized font structure");
+		return NULL;
 	}
 
 	cache = ctx->glyph_cache;
@@ -286,122 +545,106 @@ fz_render_glyph(fz_context *ctx, fz_font *font, int gid, fz_matrix *ctm, fz_colo
 	key.d = subpix_ctm.d * 65536;
 	key.aa = fz_aa_level(ctx);
 
-	fz_lock(ctx, FZ_LOCK_GLYPHCACHE);
-	hash = do_hash((unsigned char *)&key, sizeof(key)) % GLYPH_HASH_LEN;
-	entry = cache->entry[hash];
-	while (entry)
+	hash = do_hash((unsigned char *)&key, sizeof(key));
+
+	lock = FZ_LOCK_GLYPHCACHE + hash % FZ_GLYPH_CACHE_STRIPES;
+	stripe = &cache->stripe[hash % FZ_GLYPH_CACHE_STRIPES];
+
+	/* Probe the per-context front cache first. */
+	front = get_glyph_front(ctx, lock);
+	if (front)
 	{
-		if (memcmp(&entry->key, &key, sizeof(key)) == 0)
+		slot = &front->slot[hash % GLYPH_FRONT_LEN];
+		if (slot->val && memcmp(&slot->key, &key, sizeof(key)) == 0)
 		{
-			move_to_front(cache, entry);
-			val = fz_keep_glyph(ctx, entry->val);
-			fz_unlock(ctx, FZ_LOCK_GLYPHCACHE);
-			return val;
+			front->hits++;
+			return fz_keep_glyph(ctx, slot->val);
 		}
-		entry = entry->bucket_next;
 	}
 
-	locked = 1;
-	caching = 0;
-	val = NULL;
+	/* Then the shared cache. */
+	fz_lock(ctx, lock);
+	entry = find_glyph_cache_entry(stripe, &key, hash);
+	if (entry)
+	{
+		stripe->hits++;
+		move_to_front(stripe, entry);
+		val = fz_keep_glyph(ctx, entry->val);
+		fz_unlock(ctx, lock);
+		fill_glyph_front(ctx, front, &key, hash, val);
+		return val;
+	}
+	stripe->misses++;
+	fz_unlock(ctx, lock);
+
+	/* Render the glyph without holding any glyph cache lock. Another
+	 * thread may come along and render the same glyph meanwhile; we
+	 * cope with that below by ensuring that only one gets inserted
+	 * into the cache. If we find one already there, we abandon ours
+	 * and use the one there already. */
+	if (font->ft_face)
+		val = fz_render_ft_glyph(ctx, font, gid, &subpix_ctm, key.aa);
+	else if (font->t3procs)
+		val = fz_render_t3_glyph(ctx, font, gid, &subpix_ctm, model, &fz_infinite_irect);
+	else
+	{
+		fz_warn(ctx, "assert: uninitialized font structure");
+		val = NULL;
+	}
 
-	fz_try(ctx)
+	if (!val || val->w >= MAX_GLYPH_SIZE || val->h >= MAX_GLYPH_SIZE)
+		return val;
+
+	/* If we fail whilst caching, just carry on without it. */
+	entry = fz_malloc_no_throw(ctx, sizeof(fz_glyph_cache_entry));
+	if (!entry)
 	{
-		if (font->ft_face)
-		{
-			val = fz_render_ft_glyph(ctx, font, gid, &subpix_ctm, key.aa);
-		}
-		else if (font->t3procs)
-		{
-			/* We drop the glyphcache here, and execute the t3
-			 * glyph code. The danger here is that some other
-			 * thread will come along, and want the same glyph
-			 * too. If it does, we may both end up rendering
-			 * pixmaps. We cope with this later on, by ensuring
-			 * that only one gets inserted into the cache. If
-			 * we insert ours to find one already there, we
-			 * abandon ours, and use the one there already.
-			 */
-			fz_unlock(ctx, FZ_LOCK_GLYPHCACHE);
-			locked = 0;
-			val = fz_render_t3_glyph(ctx, font, gid, &subpix_ctm, model, scissor);
-			fz_lock(ctx, FZ_LOCK_GLYPHCACHE);
-			locked = 1;
-		}
-		else
-		{
-			fz_warn(ctx, "assert: uninitialized font structure");
-		}
-		if (val && do_cache)
-		{
-			if (val->w < MAX_GLYPH_SIZE && val->h < MAX_GLYPH_SIZE)
-			{
-				/* If we throw an exception whilst caching,
-				 * just ignore the exception and carry on. */
-				caching = 1;
-				if (!font->ft_face)
-				{
-					/* We had to unlock. Someone else might
-					 * have rendered in the meantime */
-					entry = cache->entry[hash];
-					while (entry)
-					{
-						if (memcmp(&entry->key, &key, sizeof(key)) == 0)
-						{
-							fz_drop_glyph(ctx, val);
-							move_to_front(cache, entry);
-							val = fz_keep_glyph(ctx, entry->val);
-							goto unlock_and_return_val;
-						}
-						entry = entry->bucket_next;
-					}
-				}
-
-				entry = fz_malloc_struct(ctx, fz_glyph_cache_entry);
-				entry->key = key;
-				entry->hash = hash;
-				entry->bucket_next = cache->entry[hash];
-				if (entry->bucket_next)
-					entry->bucket_next->bucket_prev = entry;
-				cache->entry[hash] = entry;
-				entry->val = fz_keep_glyph(ctx, val);
-				fz_keep_font(ctx, key.font);
-
-				entry->lru_next = cache->lru_head;
-				if (entry->lru_next)
-					entry->lru_next->lru_prev = entry;
-				else
-					cache->lru_tail = entry;
-				cache->lru_head = entry;
-
-				cache->total += fz_glyph_size(ctx, val);
-				while (cache->total > MAX_CACHE_SIZE)
-				{
-#ifndef NDEBUG
-					cache->num_evictions++;
-					cache->evicted += fz_glyph_size(ctx, cache->lru_tail->val);
-#endif
-					drop_glyph_cache_entry(ctx, cache->lru_tail);
-				}
-
-			}
-		}
-unlock_and_return_val:
-		{
-		}
+		fz_warn(ctx, "cannot encache glyph; continuing");
+		return val;
 	}
-	fz_always(ctx)
+	memset(entry, 0, sizeof(*entry));
+	entry->key = key;
+	entry->hash = hash;
+	entry->val = fz_keep_glyph(ctx, val);
+	fz_keep_font(ctx, key.font);
+
+	dead = NULL;
+	fz_lock(ctx, lock);
+	if (stripe->count >= stripe->len * 2)
+		grow_glyph_cache_stripe(ctx, lock, stripe);
+	existing = find_glyph_cache_entry(stripe, &key, hash);
+	if (existing)
 	{
-		if (locked)
-			fz_unlock(ctx, FZ_LOCK_GLYPHCACHE);
+		/* Someone else got there first. */
+		entry->lru_next = dead;
+		dead = entry;
+		move_to_front(stripe, existing);
+		fz_drop_glyph(ctx, val);
+		val = fz_keep_glyph(ctx, existing->val);
 	}
-	fz_catch(ctx)
+	else
 	{
-		if (caching)
-			fz_warn(ctx, "cannot encache glyph; continuing");
+		int idx = (hash / FZ_GLYPH_CACHE_STRIPES) & (stripe->len - 1);
+		entry->bucket_next = stripe->entry[idx];
+		if (entry->bucket_next)
+			entry->bucket_next->bucket_prev = entry;
+		stripe->entry[idx] = entry;
+
+		entry->lru_next = stripe->lru_head;
+		if (entry->lru_next)
+			entry->lru_next->lru_prev = entry;
 		else
-			fz_rethrow(ctx);
+			stripe->lru_tail = entry;
+		stripe->lru_head = entry;
+
+		stripe->count++;
+		stripe->total += fz_glyph_size(ctx, val);
+		evict_stripe(ctx, stripe, cache->max / FZ_GLYPH_CACHE_STRIPES, &dead);
 	}
+	fz_unlock(ctx, lock);
+
+	drop_glyph_cache_entries(ctx, dead);
+	fill_glyph_front(ctx, front, &key, hash, val);
 
 	return val;
 }
@@ -452,9 +695,26 @@ void
 fz_dump_glyph_cache_stats(fz_context *ctx)
 {
 	fz_glyph_cache *cache = ctx->glyph_cache;
+	fz_glyph_cache_stripe *stripe;
+	unsigned int total = 0;
+	int count = 0, hits = 0, misses = 0, num_evictions = 0, evicted = 0;
+	int i;
+
+	for (i = 0; i < FZ_GLYPH_CACHE_STRIPES; i++)
+	{
+		stripe = &cache->stripe[i];
+		fz_lock(ctx, FZ_LOCK_GLYPHCACHE + i);
+		total += stripe->total;
+		count += stripe->count;
+		hits += stripe->hits;
+		misses += stripe->misses;
+		num_evictions += stripe->num_evictions;
+		evicted += stripe->evicted;
+		fz_unlock(ctx, FZ_LOCK_GLYPHCACHE + i);
+	}
 
-	printf("Glyph Cache Size: %d\n", cache->total);
-#ifndef NDEBUG
-	printf("Glyph Cache Evictions: %d (%d bytes)\n", cache->num_evictions, cache->evicted);
-#endif
+	printf("Glyph Cache Size: %u (%d glyphs, max %u)\n", total, count, cache->max);
+	printf("Glyph Cache Hits: %d (%d in this thread's front cache)\n", hits + (ctx->glyph_front ? ctx->glyph_front->hits : 0), ctx->glyph_front ? ctx->glyph_front->hits : 0);
+	printf("Glyph Cache Misses: %d\n", misses);
+	printf("Glyph Cache Evictions: %d (%d bytes)\n", num_evictions, evicted);
 }
@@ -34,8 +34,8 @@ void fz_paint_solid_color(unsigned char * restrict dp, int n, int w, unsigned ch
 void fz_paint_span(unsigned char * restrict dp, unsigned char * restrict sp, int n, int w, int alpha);
 void fz_paint_span_with_color(unsigned char * restrict dp, unsigned char * restrict mp, int n, int w, unsigned char *color);
 
-void fz_paint_image(fz_pixmap *dst, const fz_irect *scissor, fz_pixmap *shape, fz_pixmap *img, const fz_matrix *ctm, int alpha, int lerp_allowed);
-void fz_paint_image_with_color(fz_pixmap *dst, const fz_irect *scissor, fz_pixmap *shape, fz_pixmap *img, const fz_matrix *ctm, unsigned char *colorbv, int lerp_allowed);
+void fz_paint_image(fz_pixmap *dst, const fz_irect *scissor, fz_pixmap *shape, fz_pixmap *img, const fz_irect *whole, const fz_matrix *ctm, int alpha, int lerp_allowed);
+void fz_paint_image_with_color(fz_pixmap *dst, const fz_irect *scissor, fz_pixmap *shape, fz_pixmap *img, const fz_irect *whole, const fz_matrix *ctm, unsigned char *colorbv, int lerp_allowed);
 
 void fz_paint_pixmap(fz_pixmap *dst, fz_pixmap *src, int alpha);
 void fz_paint_pixmap_with_mask(fz_pixmap *dst, fz_pixmap *src, fz_pixmap *msk);
@@ -46,4 +46,17 @@ void fz_blend_pixel(unsigned char dp[3], unsigned char bp[3], unsigned char sp[3
 
 void fz_paint_glyph(unsigned char *colorbv, fz_pixmap *dst, unsigned char *dp, fz_glyph *glyph, int w, int h, int skip_x, int skip_y);
 
+/*
+ * Processor features, for picking SIMD code paths at runtime.
+ */
+
+enum
+{
+	FZ_CPU_SSE2 = 1,
+	FZ_CPU_AVX2 = 2
+};
+
+int fz_cpu_features(void);
+void fz_select_span_painters(fz_context *ctx);
+
 #endif
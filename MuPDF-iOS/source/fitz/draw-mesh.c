@@ -92,8 +92,12 @@ static inline void step_edge(edge_data *edge, int n)
 	}
 }
 
+/* Paint the rows of a triangle that lie in the band y0 <= y < y1 of the
+ * clip rectangle. The edges are always walked from the top of the triangle
+ * (or of the clip rectangle), so that painting a triangle band by band
+ * gives exactly the same pixels as painting it in one go. */
 static void
-fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox)
+fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox, int band_y0, int band_y1)
 {
 	edge_data e0, e1;
 	int top, mid, bot;
@@ -110,6 +114,10 @@ fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox)
 	if (v[bot][1] < bbox->y0) return;
 	if (v[top][1] > bbox->y1) return;
 
+	/* Or outside the band */
+	if (v[bot][1] < band_y0) return;
+	if (v[top][1] > band_y1) return;
+
 	/* Magic! Ensure that mid/top/bot are all different */
 	mid = 3^top^bot;
 
@@ -119,7 +127,7 @@ fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox)
 	maxx = fz_mini(bbox->x1, pix->x + pix->w);
 
 	y = ceilf(fz_max(bbox->y0, v[top][1]));
-	y1 = ceilf(fz_min(bbox->y1, v[mid][1]));
+	y1 = ceilf(fz_min(fz_mini(bbox->y1, band_y1), v[mid][1]));
 
 	n -= 2;
 	prepare_edge(v[top], v[bot], &e0, y, n);
@@ -129,7 +137,8 @@ fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox)
 
 		do
 		{
-			paint_scan(pix, y, (int)e0.x, (int)e1.x, minx, maxx, &e0.v[0], &e1.v[0], n);
+			if (y >= band_y0)
+				paint_scan(pix, y, (int)e0.x, (int)e1.x, minx, maxx, &e0.v[0], &e1.v[0], n);
 			step_edge(&e0, n);
 			step_edge(&e1, n);
 			y ++;
@@ -137,14 +146,15 @@ fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox)
 		while (y < y1);
 	}
 
-	y1 = ceilf(fz_min(bbox->y1, v[bot][1]));
+	y1 = ceilf(fz_min(fz_mini(bbox->y1, band_y1), v[bot][1]));
 	if (y < y1)
 	{
 		prepare_edge(v[mid], v[bot], &e1, y, n);
 
 		do
 		{
-			paint_scan(pix, y, (int)e0.x, (int)e1.x, minx, maxx, &e0.v[0], &e1.v[0], n);
+			if (y >= band_y0)
+				paint_scan(pix, y, (int)e0.x, (int)e1.x, minx, maxx, &e0.v[0], &e1.v[0], n);
 			y ++;
 			if (y >= y1)
 				break;
@@ -155,12 +165,352 @@ fz_paint_triangle(fz_pixmap *pix, float *v[3], int n, const fz_irect *bbox)
 	}
 }
 
+/*
+ * The triangles of a shading, with their colors already converted for
+ * the destination, are kept in the store. Drawing the shading again, say
+ * at another place or scale while panning and zooming around a page,
+ * then skips decoding and subdividing the mesh.
+ *
+ * Only the tessellation of linear and radial shadings depends on the
+ * scale, so theirs are kept per quarter octave of the scale. The other
+ * types are kept once, and moved to the current matrix before painting.
+ */
+
+typedef struct fz_shade_mesh_s fz_shade_mesh;
+
+struct fz_shade_mesh_s
+{
+	fz_storable storable;
+	fz_matrix ctm;	/* matrix the vertices were made with */
+	int n;		/* floats per vertex: x, y and the colors */
+	int len;	/* triangles */
+	int cap;
+	float *v;
+};
+
+/* Meshes larger than this are painted as they are made and not kept. */
+#define MAX_SHADE_MESH_SIZE (16 << 20)
+
+/* With a task runner, the rows are split into bands of about this many
+ * pixels, and each band paints the triangles that touch it. */
+#define MESH_BAND_PIXELS (64 * 1024)
+
+typedef struct fz_shade_mesh_key_s fz_shade_mesh_key;
+
+struct fz_shade_mesh_key_s
+{
+	int refs;
+	fz_shade *shade;
+	fz_colorspace *colorspace;
+	int scale;
+};
+
+static int
+fz_make_hash_shade_mesh_key(fz_context *ctx, fz_store_hash *hash, void *key_)
+{
+	fz_shade_mesh_key *key = (fz_shade_mesh_key *)key_;
+	hash->u.ppi.ptr[0] = key->shade;
+	hash->u.ppi.ptr[1] = key->colorspace;
+	hash->u.ppi.i = key->scale;
+	return 1;
+}
+
+static void *
+fz_keep_shade_mesh_key(fz_context *ctx, void *key_)
+{
+	fz_shade_mesh_key *key = (fz_shade_mesh_key *)key_;
+	return fz_keep_imp(ctx, key, &key->refs);
+}
+
+static void
+fz_drop_shade_mesh_key(fz_context *ctx, void *key_)
+{
+	fz_shade_mesh_key *key = (fz_shade_mesh_key *)key_;
+	if (fz_drop_imp(ctx, key, &key->refs))
+	{
+		fz_drop_shade(ctx, key->shade);
+		fz_drop_colorspace(ctx, key->colorspace);
+		fz_free(ctx, key);
+	}
+}
+
+static int
+fz_cmp_shade_mesh_key(fz_context *ctx, void *k0_, void *k1_)
+{
+	fz_shade_mesh_key *k0 = (fz_shade_mesh_key *)k0_;
+	fz_shade_mesh_key *k1 = (fz_shade_mesh_key *)k1_;
+	return k0->shade == k1->shade && k0->colorspace == k1->colorspace && k0->scale == k1->scale;
+}
+
+#ifndef NDEBUG
+static void
+fz_debug_shade_mesh(fz_context *ctx, FILE *out, void *key_)
+{
+	fz_shade_mesh_key *key = (fz_shade_mesh_key *)key_;
+	fprintf(out, "(shade mesh type=%d scale=%d) ", key->shade->type, key->scale);
+}
+#endif
+
+static fz_store_type fz_shade_mesh_store_type =
+{
+	fz_make_hash_shade_mesh_key,
+	fz_keep_shade_mesh_key,
+	fz_drop_shade_mesh_key,
+	fz_cmp_shade_mesh_key,
+#ifndef NDEBUG
+	fz_debug_shade_mesh
+#endif
+};
+
+static void
+fz_drop_shade_mesh_imp(fz_context *ctx, fz_storable *storable)
+{
+	fz_shade_mesh *mesh = (fz_shade_mesh *)storable;
+	fz_free(ctx, mesh->v);
+	fz_free(ctx, mesh);
+}
+
+static void
+fz_drop_shade_mesh(fz_context *ctx, fz_shade_mesh *mesh)
+{
+	if (mesh)
+		fz_drop_storable(ctx, &mesh->storable);
+}
+
+static int
+fz_shade_mesh_scale(fz_shade *shade, const fz_matrix *ctm)
+{
+	/* 4 / ln 2, to count in quarter octaves */
+	if (shade->type == FZ_LINEAR || shade->type == FZ_RADIAL)
+		return (int)floorf(logf(fz_matrix_expansion(ctm)) * 5.7707801f);
+	return 0;
+}
+
+static void
+paint_triangles(fz_pixmap *dest, float *v, int n, int len, const fz_irect *bbox, int y0, int y1)
+{
+	float *vertices[3];
+
+	while (len--)
+	{
+		vertices[0] = v;
+		vertices[1] = v + n;
+		vertices[2] = v + 2 * n;
+		fz_paint_triangle(dest, vertices, n, bbox, y0, y1);
+		v += 3 * n;
+	}
+}
+
+typedef struct
+{
+	fz_pixmap *dest;
+	const fz_irect *bbox;
+	float *v;
+	int n, len, band_h;
+	int *first;	/* band i paints index[first[i]] to index[first[i+1]-1] */
+	int *index;
+} fz_mesh_bands;
+
+static void
+fz_paint_mesh_band(void *arg, int i)
+{
+	fz_mesh_bands *b = arg;
+	int y0 = b->bbox->y0 + i * b->band_h;
+	int y1 = fz_mini(y0 + b->band_h, b->bbox->y1);
+	int stride = 3 * b->n;
+	float *vertices[3];
+	int k;
+
+	if (!b->first)
+	{
+		paint_triangles(b->dest, b->v, b->n, b->len, b->bbox, y0, y1);
+		return;
+	}
+
+	for (k = b->first[i]; k < b->first[i + 1]; k++)
+	{
+		float *v = b->v + (size_t)b->index[k] * stride;
+		vertices[0] = v;
+		vertices[1] = v + b->n;
+		vertices[2] = v + 2 * b->n;
+		fz_paint_triangle(b->dest, vertices, b->n, b->bbox, y0, y1);
+	}
+}
+
+static inline int
+mesh_band(float y, const fz_mesh_bands *b, int count)
+{
+	float i = floorf((y - b->bbox->y0) / b->band_h);
+	if (!(i > 0))
+		return 0;
+	if (i >= count)
+		return count - 1;
+	return (int)i;
+}
+
+/* List the triangles touching each band, in painting order, so that
+ * bands do not each have to look at every triangle. Failing to get the
+ * lists only costs speed. */
+static void
+fz_sort_mesh_bands(fz_context *ctx, fz_mesh_bands *b, int count)
+{
+	size_t total = 0;
+	int stride = 3 * b->n;
+	int i, k, *fill;
+	float *v;
+
+	b->first = fz_calloc_no_throw(ctx, 2 * (count + 1), sizeof(int));
+	if (!b->first)
+		return;
+	fill = b->first + count + 1;
+
+	for (i = 0, v = b->v; i < b->len; i++, v += stride)
+	{
+		float y0 = fz_min(fz_min(v[1], v[b->n + 1]), v[2 * b->n + 1]);
+		float y1 = fz_max(fz_max(v[1], v[b->n + 1]), v[2 * b->n + 1]);
+		int b0 = mesh_band(y0, b, count);
+		int b1 = mesh_band(y1, b, count);
+		if (y1 < b->bbox->y0 || y0 > b->bbox->y1)
+			continue;
+		for (k = b0; k <= b1; k++)
+			b->first[k + 1]++;
+		total += b1 - b0 + 1;
+	}
+
+	if (total < INT_MAX / sizeof(int))
+		b->index = fz_malloc_no_throw(ctx, total * sizeof(int));
+	if (!b->index)
+	{
+		fz_free(ctx, b->first);
+		b->first = NULL;
+		return;
+	}
+
+	for (k = 0; k < count; k++)
+	{
+		b->first[k + 1] += b->first[k];
+		fill[k] = b->first[k];
+	}
+
+	for (i = 0, v = b->v; i < b->len; i++, v += stride)
+	{
+		float y0 = fz_min(fz_min(v[1], v[b->n + 1]), v[2 * b->n + 1]);
+		float y1 = fz_max(fz_max(v[1], v[b->n + 1]), v[2 * b->n + 1]);
+		int b0 = mesh_band(y0, b, count);
+		int b1 = mesh_band(y1, b, count);
+		if (y1 < b->bbox->y0 || y0 > b->bbox->y1)
+			continue;
+		for (k = b0; k <= b1; k++)
+			b->index[fill[k]++] = i;
+	}
+}
+
+/* Paint a mesh made with the matrix mesh->ctm using the matrix ctm */
+static void
+fz_paint_shade_mesh(fz_context *ctx, fz_shade_mesh *mesh, const fz_matrix *ctm, fz_pixmap *dest, const fz_irect *bbox)
+{
+	fz_mesh_bands bands;
+	float *copy = NULL;
+	int w = bbox->x1 - bbox->x0;
+	int h = bbox->y1 - bbox->y0;
+	int count = 1;
+
+	if (w <= 0 || h <= 0 || mesh->len == 0)
+		return;
+
+	bands.v = mesh->v;
+	if (ctm->a != mesh->ctm.a || ctm->b != mesh->ctm.b || ctm->c != mesh->ctm.c || ctm->d != mesh->ctm.d ||
+		ctm->e != mesh->ctm.e || ctm->f != mesh->ctm.f)
+	{
+		fz_matrix remap;
+		int i, len = mesh->len * 3;
+
+		if (ctm->a == mesh->ctm.a && ctm->b == mesh->ctm.b && ctm->c == mesh->ctm.c && ctm->d == mesh->ctm.d)
+			fz_translate(&remap, ctm->e - mesh->ctm.e, ctm->f - mesh->ctm.f);
+		else
+			fz_concat(&remap, fz_invert_matrix(&remap, &mesh->ctm), ctm);
+
+		copy = fz_malloc_array(ctx, len, mesh->n * sizeof(float));
+		memcpy(copy, mesh->v, (size_t)len * mesh->n * sizeof(float));
+		for (i = 0; i < len; i++)
+			fz_transform_point((fz_point *)(copy + i * mesh->n), &remap);
+		bands.v = copy;
+	}
+
+	bands.dest = dest;
+	bands.bbox = bbox;
+	bands.n = mesh->n;
+	bands.len = mesh->len;
+	bands.band_h = h;
+	bands.first = NULL;
+	bands.index = NULL;
+	if (ctx->tasks && (size_t)w * h >= 2 * MESH_BAND_PIXELS)
+	{
+		bands.band_h = fz_maxi(16, MESH_BAND_PIXELS / w);
+		count = (h + bands.band_h - 1) / bands.band_h;
+		fz_sort_mesh_bands(ctx, &bands, count);
+	}
+	fz_run_tasks(ctx, count, fz_paint_mesh_band, &bands);
+
+	fz_free(ctx, bands.first);
+	fz_free(ctx, bands.index);
+	fz_free(ctx, copy);
+}
+
+static fz_shade_mesh *
+fz_new_shade_mesh(fz_context *ctx, const fz_matrix *ctm, int n)
+{
+	fz_shade_mesh *mesh = fz_malloc_struct(ctx, fz_shade_mesh);
+	FZ_INIT_STORABLE(mesh, 1, fz_drop_shade_mesh_imp);
+	mesh->ctm = *ctm;
+	mesh->n = n;
+	return mesh;
+}
+
+static fz_shade_mesh *
+fz_store_shade_mesh(fz_context *ctx, fz_shade_mesh_key *k, fz_shade_mesh *mesh)
+{
+	fz_shade_mesh_key *key = NULL;
+
+	/* Any failure here will just result in us not caching. */
+	fz_var(key);
+	fz_var(mesh);
+	fz_try(ctx)
+	{
+		fz_shade_mesh *existing;
+
+		key = fz_malloc_struct(ctx, fz_shade_mesh_key);
+		key->refs = 1;
+		key->shade = fz_keep_shade(ctx, k->shade);
+		key->colorspace = fz_keep_colorspace(ctx, k->colorspace);
+		key->scale = k->scale;
+		existing = fz_store_item(ctx, key, mesh, sizeof(*mesh) + (size_t)mesh->cap * 3 * mesh->n * sizeof(float), &fz_shade_mesh_store_type);
+		if (existing)
+		{
+			/* A racing thread made the same mesh first */
+			fz_drop_shade_mesh(ctx, mesh);
+			mesh = existing;
+		}
+	}
+	fz_always(ctx)
+	{
+		if (key)
+			fz_drop_shade_mesh_key(ctx, key);
+	}
+	fz_catch(ctx)
+	{
+		/* Do nothing */
+	}
+	return mesh;
+}
+
 struct paint_tri_data
 {
 	fz_shade *shade;
 	fz_pixmap *dest;
 	const fz_irect *bbox;
 	fz_color_converter cc;
+	fz_shade_mesh *mesh;
 };
 
 static void
@@ -194,7 +544,50 @@ do_paint_tri(fz_context *ctx, void *arg, fz_vertex *av, fz_vertex *bv, fz_vertex
 	vertices[2] = (float *)cv;
 
 	dest = ptd->dest;
-	fz_paint_triangle(dest, vertices, 2 + dest->colorspace->n, ptd->bbox);
+	fz_paint_triangle(dest, vertices, 2 + dest->colorspace->n, ptd->bbox, ptd->bbox->y0, ptd->bbox->y1);
+}
+
+static void
+do_record_tri(fz_context *ctx, void *arg, fz_vertex *av, fz_vertex *bv, fz_vertex *cv)
+{
+	struct paint_tri_data *ptd = (struct paint_tri_data *)arg;
+	fz_shade_mesh *mesh = ptd->mesh;
+	float *v;
+	int n;
+
+	if (!mesh)
+	{
+		do_paint_tri(ctx, arg, av, bv, cv);
+		return;
+	}
+
+	n = mesh->n;
+	if (mesh->len == mesh->cap)
+	{
+		int cap = mesh->cap ? mesh->cap * 2 : 256;
+		float *nv = NULL;
+
+		if ((size_t)cap * 3 * n * sizeof(float) <= MAX_SHADE_MESH_SIZE)
+			nv = fz_resize_array_no_throw(ctx, mesh->v, cap, 3 * n * sizeof(float));
+		if (!nv)
+		{
+			/* Too big to keep; paint what we have and carry on
+			 * painting the rest as it comes. */
+			paint_triangles(ptd->dest, mesh->v, n, mesh->len, ptd->bbox, ptd->bbox->y0, ptd->bbox->y1);
+			fz_drop_shade_mesh(ctx, mesh);
+			ptd->mesh = NULL;
+			do_paint_tri(ctx, arg, av, bv, cv);
+			return;
+		}
+		mesh->v = nv;
+		mesh->cap = cap;
+	}
+
+	v = mesh->v + (size_t)mesh->len * 3 * n;
+	memcpy(v, av, n * sizeof(float));
+	memcpy(v + n, bv, n * sizeof(float));
+	memcpy(v + 2 * n, cv, n * sizeof(float));
+	mesh->len++;
 }
 
 void
@@ -205,11 +598,14 @@ fz_paint_shade(fz_context *ctx, fz_shade *shade, const fz_matrix *ctm, fz_pixmap
 	fz_pixmap *conv = NULL;
 	float color[FZ_MAX_COLORS];
 	struct paint_tri_data ptd = { 0 };
+	fz_shade_mesh_key key = { 0 };
+	fz_shade_mesh *mesh = NULL;
 	int i, k;
-	fz_matrix local_ctm;
+	fz_matrix local_ctm, inverse;
 
 	fz_var(temp);
 	fz_var(conv);
+	fz_var(mesh);
 
 	fz_try(ctx)
 	{
@@ -240,7 +636,41 @@ fz_paint_shade(fz_context *ctx, fz_shade *shade, const fz_matrix *ctm, fz_pixmap
 		ptd.bbox = bbox;
 
 		fz_init_cached_color_converter(ctx, &ptd.cc, temp->colorspace, shade->colorspace);
-		fz_process_mesh(ctx, shade, &local_ctm, &prepare_vertex, &do_paint_tri, &ptd);
+
+		/* A mesh made with a degenerate matrix can not be moved */
+		key.shade = shade;
+		key.colorspace = temp->colorspace;
+		if (!fz_try_invert_matrix(&inverse, &local_ctm))
+		{
+			key.scale = fz_shade_mesh_scale(shade, &local_ctm);
+			mesh = fz_find_item(ctx, fz_drop_shade_mesh_imp, &key, &fz_shade_mesh_store_type);
+			if (!mesh)
+				ptd.mesh = fz_new_shade_mesh(ctx, &local_ctm, 2 + temp->colorspace->n);
+		}
+
+		if (!mesh)
+		{
+			fz_try(ctx)
+			{
+				fz_process_mesh(ctx, shade, &local_ctm, &prepare_vertex, &do_record_tri, &ptd);
+			}
+			fz_catch(ctx)
+			{
+				/* Paint as much as we got, as if we had been
+				 * painting while making the mesh. */
+				if (ptd.mesh)
+					paint_triangles(temp, ptd.mesh->v, ptd.mesh->n, ptd.mesh->len, bbox, bbox->y0, bbox->y1);
+				fz_rethrow(ctx);
+			}
+			if (ptd.mesh)
+			{
+				mesh = fz_store_shade_mesh(ctx, &key, ptd.mesh);
+				ptd.mesh = NULL;
+			}
+		}
+
+		if (mesh)
+			fz_paint_shade_mesh(ctx, mesh, &local_ctm, temp, bbox);
 
 		if (shade->use_function)
 		{
@@ -262,6 +692,8 @@ fz_paint_shade(fz_context *ctx, fz_shade *shade, const fz_matrix *ctm, fz_pixmap
 	}
 	fz_always(ctx)
 	{
+		fz_drop_shade_mesh(ctx, ptd.mesh);
+		fz_drop_shade_mesh(ctx, mesh);
 		fz_fin_cached_color_converter(ctx, &ptd.cc);
 	}
 	fz_catch(ctx)
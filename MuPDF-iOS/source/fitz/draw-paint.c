@@ -73,6 +73,29 @@ and stick to using the premultiplied form.
 
 typedef unsigned char byte;
 
+/* The span painters for the common gray and rgb cases are picked at
+ * runtime from a table, so that SIMD versions can be used where the
+ * processor supports them. Every version must give bit-identical
+ * results to the C code. */
+
+typedef struct fz_span_painters_s fz_span_painters;
+
+struct fz_span_painters_s
+{
+	void (*solid_color_2)(byte * restrict dp, int w, byte *color);
+	void (*solid_color_4)(byte * restrict dp, int w, byte *color);
+	void (*span_with_color_2)(byte * restrict dp, byte * restrict mp, int w, byte *color);
+	void (*span_with_color_4)(byte * restrict dp, byte * restrict mp, int w, byte *color);
+	void (*span_with_mask_2)(byte * restrict dp, byte * restrict sp, byte * restrict mp, int w);
+	void (*span_with_mask_4)(byte * restrict dp, byte * restrict sp, byte * restrict mp, int w);
+	void (*span_2)(byte * restrict dp, byte * restrict sp, int w);
+	void (*span_4)(byte * restrict dp, byte * restrict sp, int w);
+	void (*span_2_with_alpha)(byte * restrict dp, byte * restrict sp, int w, int alpha);
+	void (*span_4_with_alpha)(byte * restrict dp, byte * restrict sp, int w, int alpha);
+};
+
+static inline const fz_span_painters *fz_get_span_painters(void);
+
 /* These are used by the non-aa scan converter */
 
 void
@@ -192,8 +215,8 @@ fz_paint_solid_color(byte * restrict dp, int n, int w, byte *color)
 {
 	switch (n)
 	{
-	case 2: fz_paint_solid_color_2(dp, w, color); break;
-	case 4: fz_paint_solid_color_4(dp, w, color); break;
+	case 2: fz_get_span_painters()->solid_color_2(dp, w, color); break;
+	case 4: fz_get_span_painters()->solid_color_4(dp, w, color); break;
 	default: fz_paint_solid_color_N(dp, n, w, color); break;
 	}
 }
@@ -362,8 +385,8 @@ fz_paint_span_with_color(byte * restrict dp, byte * restrict mp, int n, int w, b
 {
 	switch (n)
 	{
-	case 2: fz_paint_span_with_color_2(dp, mp, w, color); break;
-	case 4: fz_paint_span_with_color_4(dp, mp, w, color); break;
+	case 2: fz_get_span_painters()->span_with_color_2(dp, mp, w, color); break;
+	case 4: fz_get_span_painters()->span_with_color_4(dp, mp, w, color); break;
 	default: fz_paint_span_with_color_N(dp, mp, n, w, color); break;
 	}
 }
@@ -520,8 +543,8 @@ fz_paint_span_with_mask(byte * restrict dp, byte * restrict sp, byte * restrict
 {
 	switch (n)
 	{
-	case 2: fz_paint_span_with_mask_2(dp, sp, mp, w); break;
-	case 4: fz_paint_span_with_mask_4(dp, sp, mp, w); break;
+	case 2: fz_get_span_painters()->span_with_mask_2(dp, sp, mp, w); break;
+	case 4: fz_get_span_painters()->span_with_mask_4(dp, sp, mp, w); break;
 	default: fz_paint_span_with_mask_N(dp, sp, mp, n, w); break;
 	}
 }
@@ -693,8 +716,8 @@ fz_paint_span(byte * restrict dp, byte * restrict sp, int n, int w, int alpha)
 		switch (n)
 		{
 		case 1: fz_paint_span_1(dp, sp, w); break;
-		case 2: fz_paint_span_2(dp, sp, w); break;
-		case 4: fz_paint_span_4(dp, sp, w); break;
+		case 2: fz_get_span_painters()->span_2(dp, sp, w); break;
+		case 4: fz_get_span_painters()->span_4(dp, sp, w); break;
 		default: fz_paint_span_N(dp, sp, n, w); break;
 		}
 	}
@@ -702,8 +725,8 @@ fz_paint_span(byte * restrict dp, byte * restrict sp, int n, int w, int alpha)
 	{
 		switch (n)
 		{
-		case 2: fz_paint_span_2_with_alpha(dp, sp, w, alpha); break;
-		case 4: fz_paint_span_4_with_alpha(dp, sp, w, alpha); break;
+		case 2: fz_get_span_painters()->span_2_with_alpha(dp, sp, w, alpha); break;
+		case 4: fz_get_span_painters()->span_4_with_alpha(dp, sp, w, alpha); break;
 		default: fz_paint_span_N_with_alpha(dp, sp, n, w, alpha); break;
 		}
 	}
@@ -945,6 +968,10 @@ intermediate_run:
 	}
 }
 
+/* Runs in glyphs shorter than this are painted inline rather than being
+ * handed to the span painters. */
+#define GLYPH_SPAN_MIN 8
+
 static inline void
 fz_paint_glyph_alpha_N(unsigned char *colorbv, int n, int span, unsigned char *dp, fz_glyph *glyph, int w, int h, int skip_x, int skip_y)
 {
@@ -1035,6 +1062,15 @@ solid_run:
 					if (len > ww)
 						len = ww;
 					ww -= len;
+					if ((n == 2 || n == 4) && len >= GLYPH_SPAN_MIN)
+					{
+						if (n == 2)
+							fz_get_span_painters()->solid_color_2(ddp, len, colorbv);
+						else
+							fz_get_span_painters()->solid_color_4(ddp, len, colorbv);
+						ddp += len * n;
+						break;
+					}
 					do
 					{
 						int k = 0;
@@ -1057,6 +1093,16 @@ intermediate_run:
 					if (len > ww)
 						len = ww;
 					ww -= len;
+					if ((n == 2 || n == 4) && len >= GLYPH_SPAN_MIN)
+					{
+						if (n == 2)
+							fz_get_span_painters()->span_with_color_2(ddp, runp, len, colorbv);
+						else
+							fz_get_span_painters()->span_with_color_4(ddp, runp, len, colorbv);
+						runp += len;
+						ddp += len * n;
+						break;
+					}
 					do
 					{
 						int k = 0;
@@ -1171,6 +1217,15 @@ solid_run:
 					if (len > ww)
 						len = ww;
 					ww -= len;
+					if ((n == 2 || n == 4) && len >= GLYPH_SPAN_MIN)
+					{
+						if (n == 2)
+							fz_get_span_painters()->solid_color_2(ddp, len, colorbv);
+						else
+							fz_get_span_painters()->solid_color_4(ddp, len, colorbv);
+						ddp += len * n;
+						break;
+					}
 					do
 					{
 						int k = 0;
@@ -1190,6 +1245,16 @@ intermediate_run:
 					if (len > ww)
 						len = ww;
 					ww -= len;
+					if ((n == 2 || n == 4) && len >= GLYPH_SPAN_MIN)
+					{
+						if (n == 2)
+							fz_get_span_painters()->span_with_color_2(ddp, runp, len, colorbv);
+						else
+							fz_get_span_painters()->span_with_color_4(ddp, runp, len, colorbv);
+						runp += len;
+						ddp += len * n;
+						break;
+					}
 					do
 					{
 						int k = 0;
@@ -1262,3 +1327,715 @@ fz_paint_glyph(unsigned char *colorbv, fz_pixmap *dst, unsigned char *dp, fz_gly
 	else
 		fz_paint_glyph_mask(dst->w, dp, glyph, w, h, skip_x, skip_y);
 }
+
+/*
+ * SIMD span painters.
+ *
+ * These work on 16 bit lanes, one per component. The C code is
+ * followed exactly; in particular FZ_BLEND(S, D, A) is evaluated as
+ * (S*A + D*(256-A))>>8, which is equal and never leaves the range of
+ * an unsigned 16 bit lane, and results are truncated to bytes rather
+ * than saturated where the C code would wrap. Spans are processed 16
+ * bytes (32 for AVX2) at a time, with the C code painting the tail.
+ */
+
+#ifdef ARCH_X86_SIMD
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+static inline unsigned int
+load_u32(const byte *p)
+{
+	unsigned int v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline __m128i
+expand_epi16(__m128i a)
+{
+	return _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+}
+
+static inline __m128i
+combine_epi16(__m128i a, __m128i b)
+{
+	return _mm_srli_epi16(_mm_mullo_epi16(a, b), 8);
+}
+
+static inline __m128i
+blend_epi16(__m128i src, __m128i dst, __m128i amount)
+{
+	__m128i inv = _mm_sub_epi16(_mm_set1_epi16(256), amount);
+	return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(src, amount), _mm_mullo_epi16(dst, inv)), 8);
+}
+
+/* Broadcast the alpha of each pixel across its components */
+#define ALPHA_2_SSE2(v) _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xF5), 0xF5)
+#define ALPHA_4_SSE2(v) _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF)
+
+static void
+fz_paint_solid_color_2_sse2(byte * restrict dp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[1]);
+	__m128i zero = _mm_setzero_si128();
+	__m128i c = _mm_setr_epi16(color[0], 255, color[0], 255, color[0], 255, color[0], 255);
+	__m128i a = _mm_set1_epi16(sa);
+	__m128i cb = _mm_packus_epi16(c, c);
+	if (sa == 0)
+		return;
+	for (; w >= 8; w -= 8, dp += 16)
+	{
+		__m128i d;
+		if (sa == 256)
+		{
+			_mm_storeu_si128((__m128i *)dp, cb);
+			continue;
+		}
+		d = _mm_loadu_si128((__m128i *)dp);
+		d = _mm_packus_epi16(
+			blend_epi16(c, _mm_unpacklo_epi8(d, zero), a),
+			blend_epi16(c, _mm_unpackhi_epi8(d, zero), a));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_solid_color_2(dp, w, color);
+}
+
+static void
+fz_paint_solid_color_4_sse2(byte * restrict dp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[3]);
+	__m128i zero = _mm_setzero_si128();
+	__m128i c = _mm_setr_epi16(color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+	__m128i a = _mm_set1_epi16(sa);
+	__m128i cb = _mm_packus_epi16(c, c);
+	if (sa == 0)
+		return;
+	for (; w >= 4; w -= 4, dp += 16)
+	{
+		__m128i d;
+		if (sa == 256)
+		{
+			_mm_storeu_si128((__m128i *)dp, cb);
+			continue;
+		}
+		d = _mm_loadu_si128((__m128i *)dp);
+		d = _mm_packus_epi16(
+			blend_epi16(c, _mm_unpacklo_epi8(d, zero), a),
+			blend_epi16(c, _mm_unpackhi_epi8(d, zero), a));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_solid_color_4(dp, w, color);
+}
+
+static void
+fz_paint_span_with_color_2_sse2(byte * restrict dp, byte * restrict mp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[1]);
+	__m128i zero = _mm_setzero_si128();
+	__m128i c = _mm_setr_epi16(color[0], 255, color[0], 255, color[0], 255, color[0], 255);
+	__m128i a = _mm_set1_epi16(sa);
+	__m128i cb = _mm_packus_epi16(c, c);
+	for (; w >= 8; w -= 8, dp += 16, mp += 8)
+	{
+		__m128i m = _mm_loadl_epi64((__m128i *)mp);
+		__m128i d;
+		int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(m, zero)) & 0xFF;
+		if (bits == 0xFF)
+			continue;
+		if (sa == 256 && (_mm_movemask_epi8(_mm_cmpeq_epi8(m, _mm_set1_epi8(-1))) & 0xFF) == 0xFF)
+		{
+			_mm_storeu_si128((__m128i *)dp, cb);
+			continue;
+		}
+		m = expand_epi16(_mm_unpacklo_epi8(m, zero));
+		if (sa != 256)
+			m = combine_epi16(m, a);
+		d = _mm_loadu_si128((__m128i *)dp);
+		d = _mm_packus_epi16(
+			blend_epi16(c, _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi16(m, m)),
+			blend_epi16(c, _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi16(m, m)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_with_color_2(dp, mp, w, color);
+}
+
+static void
+fz_paint_span_with_color_4_sse2(byte * restrict dp, byte * restrict mp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[3]);
+	__m128i zero = _mm_setzero_si128();
+	__m128i c = _mm_setr_epi16(color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+	__m128i a = _mm_set1_epi16(sa);
+	__m128i cb = _mm_packus_epi16(c, c);
+	if (sa == 0)
+		return;
+	for (; w >= 4; w -= 4, dp += 16, mp += 4)
+	{
+		unsigned int m4 = load_u32(mp);
+		__m128i m, d;
+		if (m4 == 0)
+			continue;
+		if (sa == 256 && m4 == 0xFFFFFFFF)
+		{
+			_mm_storeu_si128((__m128i *)dp, cb);
+			continue;
+		}
+		m = expand_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), zero));
+		if (sa != 256)
+			m = combine_epi16(m, a);
+		m = _mm_unpacklo_epi16(m, m);
+		d = _mm_loadu_si128((__m128i *)dp);
+		d = _mm_packus_epi16(
+			blend_epi16(c, _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(m, m)),
+			blend_epi16(c, _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(m, m)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_with_color_4(dp, mp, w, color);
+}
+
+/* d = (s*ma)>>8 + (d*EXPAND(255 - ((sa*ma)>>8)))>>8, which is what the
+ * C code computes for every value of ma, including 0 and 256. */
+static inline __m128i
+mask_over_epi16(__m128i s, __m128i d, __m128i sa, __m128i ma)
+{
+	__m128i masa = expand_epi16(_mm_sub_epi16(_mm_set1_epi16(255), combine_epi16(sa, ma)));
+	__m128i r = _mm_add_epi16(combine_epi16(s, ma), combine_epi16(d, masa));
+	return _mm_and_si128(r, _mm_set1_epi16(255));
+}
+
+static void
+fz_paint_span_with_mask_2_sse2(byte * restrict dp, byte * restrict sp, byte * restrict mp, int w)
+{
+	__m128i zero = _mm_setzero_si128();
+	for (; w >= 8; w -= 8, dp += 16, sp += 16, mp += 8)
+	{
+		__m128i m = _mm_loadl_epi64((__m128i *)mp);
+		__m128i s, d, slo, shi;
+		if ((_mm_movemask_epi8(_mm_cmpeq_epi8(m, zero)) & 0xFF) == 0xFF)
+			continue;
+		m = expand_epi16(_mm_unpacklo_epi8(m, zero));
+		s = _mm_loadu_si128((__m128i *)sp);
+		d = _mm_loadu_si128((__m128i *)dp);
+		slo = _mm_unpacklo_epi8(s, zero);
+		shi = _mm_unpackhi_epi8(s, zero);
+		d = _mm_packus_epi16(
+			mask_over_epi16(slo, _mm_unpacklo_epi8(d, zero), ALPHA_2_SSE2(slo), _mm_unpacklo_epi16(m, m)),
+			mask_over_epi16(shi, _mm_unpackhi_epi8(d, zero), ALPHA_2_SSE2(shi), _mm_unpackhi_epi16(m, m)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_with_mask_2(dp, sp, mp, w);
+}
+
+static void
+fz_paint_span_with_mask_4_sse2(byte * restrict dp, byte * restrict sp, byte * restrict mp, int w)
+{
+	__m128i zero = _mm_setzero_si128();
+	for (; w >= 4; w -= 4, dp += 16, sp += 16, mp += 4)
+	{
+		unsigned int m4 = load_u32(mp);
+		__m128i m, s, d, slo, shi;
+		if (m4 == 0)
+			continue;
+		m = expand_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), zero));
+		m = _mm_unpacklo_epi16(m, m);
+		s = _mm_loadu_si128((__m128i *)sp);
+		d = _mm_loadu_si128((__m128i *)dp);
+		slo = _mm_unpacklo_epi8(s, zero);
+		shi = _mm_unpackhi_epi8(s, zero);
+		d = _mm_packus_epi16(
+			mask_over_epi16(slo, _mm_unpacklo_epi8(d, zero), ALPHA_4_SSE2(slo), _mm_unpacklo_epi32(m, m)),
+			mask_over_epi16(shi, _mm_unpackhi_epi8(d, zero), ALPHA_4_SSE2(shi), _mm_unpackhi_epi32(m, m)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_with_mask_4(dp, sp, mp, w);
+}
+
+/* d = s + (d*(256 - EXPAND(sa)))>>8, wrapping like the C code, and
+ * leaving d alone where sa is 0 */
+static inline __m128i
+over_epi16(__m128i s, __m128i d, __m128i sa)
+{
+	__m128i t = _mm_sub_epi16(_mm_set1_epi16(256), expand_epi16(sa));
+	__m128i r = _mm_and_si128(_mm_add_epi16(s, combine_epi16(d, t)), _mm_set1_epi16(255));
+	__m128i z = _mm_cmpeq_epi16(sa, _mm_setzero_si128());
+	return _mm_or_si128(_mm_andnot_si128(z, r), _mm_and_si128(z, d));
+}
+
+static void
+fz_paint_span_2_sse2(byte * restrict dp, byte * restrict sp, int w)
+{
+	__m128i zero = _mm_setzero_si128();
+	for (; w >= 8; w -= 8, dp += 16, sp += 16)
+	{
+		__m128i s = _mm_loadu_si128((__m128i *)sp);
+		__m128i d, slo, shi;
+		int alpha = _mm_movemask_epi8(_mm_cmpeq_epi8(s, zero));
+		if ((alpha & 0xAAAA) == 0xAAAA)
+			continue;
+		alpha = _mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_set1_epi8(-1)));
+		if ((alpha & 0xAAAA) == 0xAAAA)
+		{
+			_mm_storeu_si128((__m128i *)dp, s);
+			continue;
+		}
+		d = _mm_loadu_si128((__m128i *)dp);
+		slo = _mm_unpacklo_epi8(s, zero);
+		shi = _mm_unpackhi_epi8(s, zero);
+		d = _mm_packus_epi16(
+			over_epi16(slo, _mm_unpacklo_epi8(d, zero), ALPHA_2_SSE2(slo)),
+			over_epi16(shi, _mm_unpackhi_epi8(d, zero), ALPHA_2_SSE2(shi)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_2(dp, sp, w);
+}
+
+static void
+fz_paint_span_4_sse2(byte * restrict dp, byte * restrict sp, int w)
+{
+	__m128i zero = _mm_setzero_si128();
+	for (; w >= 4; w -= 4, dp += 16, sp += 16)
+	{
+		__m128i s = _mm_loadu_si128((__m128i *)sp);
+		__m128i d, slo, shi;
+		int alpha = _mm_movemask_epi8(_mm_cmpeq_epi8(s, zero));
+		if ((alpha & 0x8888) == 0x8888)
+			continue;
+		alpha = _mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_set1_epi8(-1)));
+		if ((alpha & 0x8888) == 0x8888)
+		{
+			_mm_storeu_si128((__m128i *)dp, s);
+			continue;
+		}
+		d = _mm_loadu_si128((__m128i *)dp);
+		slo = _mm_unpacklo_epi8(s, zero);
+		shi = _mm_unpackhi_epi8(s, zero);
+		d = _mm_packus_epi16(
+			over_epi16(slo, _mm_unpacklo_epi8(d, zero), ALPHA_4_SSE2(slo)),
+			over_epi16(shi, _mm_unpackhi_epi8(d, zero), ALPHA_4_SSE2(shi)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_4(dp, sp, w);
+}
+
+static void
+fz_paint_span_2_with_alpha_sse2(byte * restrict dp, byte * restrict sp, int w, int alpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_set1_epi16(FZ_EXPAND(alpha));
+	for (; w >= 8; w -= 8, dp += 16, sp += 16)
+	{
+		__m128i s = _mm_loadu_si128((__m128i *)sp);
+		__m128i d = _mm_loadu_si128((__m128i *)dp);
+		__m128i slo = _mm_unpacklo_epi8(s, zero);
+		__m128i shi = _mm_unpackhi_epi8(s, zero);
+		d = _mm_packus_epi16(
+			blend_epi16(slo, _mm_unpacklo_epi8(d, zero), combine_epi16(ALPHA_2_SSE2(slo), a)),
+			blend_epi16(shi, _mm_unpackhi_epi8(d, zero), combine_epi16(ALPHA_2_SSE2(shi), a)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_2_with_alpha(dp, sp, w, alpha);
+}
+
+static void
+fz_paint_span_4_with_alpha_sse2(byte * restrict dp, byte * restrict sp, int w, int alpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_set1_epi16(FZ_EXPAND(alpha));
+	for (; w >= 4; w -= 4, dp += 16, sp += 16)
+	{
+		__m128i s = _mm_loadu_si128((__m128i *)sp);
+		__m128i d = _mm_loadu_si128((__m128i *)dp);
+		__m128i slo = _mm_unpacklo_epi8(s, zero);
+		__m128i shi = _mm_unpackhi_epi8(s, zero);
+		d = _mm_packus_epi16(
+			blend_epi16(slo, _mm_unpacklo_epi8(d, zero), combine_epi16(ALPHA_4_SSE2(slo), a)),
+			blend_epi16(shi, _mm_unpackhi_epi8(d, zero), combine_epi16(ALPHA_4_SSE2(shi), a)));
+		_mm_storeu_si128((__m128i *)dp, d);
+	}
+	fz_paint_span_4_with_alpha(dp, sp, w, alpha);
+}
+
+static const fz_span_painters fz_span_painters_sse2 =
+{
+	fz_paint_solid_color_2_sse2,
+	fz_paint_solid_color_4_sse2,
+	fz_paint_span_with_color_2_sse2,
+	fz_paint_span_with_color_4_sse2,
+	fz_paint_span_with_mask_2_sse2,
+	fz_paint_span_with_mask_4_sse2,
+	fz_paint_span_2_sse2,
+	fz_paint_span_4_sse2,
+	fz_paint_span_2_with_alpha_sse2,
+	fz_paint_span_4_with_alpha_sse2,
+};
+
+/*
+ * The AVX2 versions do the same sums on 16 lanes at a time. Bytes are
+ * widened with vpmovzxbw and narrowed again per 128 bit half, so no
+ * lane crossing shuffles are needed on the data itself.
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i
+widen_avx2(__m128i v)
+{
+	return _mm256_cvtepu8_epi16(v);
+}
+
+static inline AVX2 __m128i
+narrow_avx2(__m256i v)
+{
+	return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+static inline AVX2 __m256i
+join_avx2(__m128i lo, __m128i hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static inline AVX2 __m256i
+expand_avx2(__m256i a)
+{
+	return _mm256_add_epi16(a, _mm256_srli_epi16(a, 7));
+}
+
+static inline AVX2 __m256i
+combine_avx2(__m256i a, __m256i b)
+{
+	return _mm256_srli_epi16(_mm256_mullo_epi16(a, b), 8);
+}
+
+static inline AVX2 __m256i
+blend_avx2(__m256i src, __m256i dst, __m256i amount)
+{
+	__m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(256), amount);
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(src, amount), _mm256_mullo_epi16(dst, inv)), 8);
+}
+
+static inline AVX2 __m256i
+mask_over_avx2(__m256i s, __m256i d, __m256i sa, __m256i ma)
+{
+	__m256i masa = expand_avx2(_mm256_sub_epi16(_mm256_set1_epi16(255), combine_avx2(sa, ma)));
+	__m256i r = _mm256_add_epi16(combine_avx2(s, ma), combine_avx2(d, masa));
+	return _mm256_and_si256(r, _mm256_set1_epi16(255));
+}
+
+static inline AVX2 __m256i
+over_avx2(__m256i s, __m256i d, __m256i sa)
+{
+	__m256i t = _mm256_sub_epi16(_mm256_set1_epi16(256), expand_avx2(sa));
+	__m256i r = _mm256_and_si256(_mm256_add_epi16(s, combine_avx2(d, t)), _mm256_set1_epi16(255));
+	return _mm256_blendv_epi8(r, d, _mm256_cmpeq_epi16(sa, _mm256_setzero_si256()));
+}
+
+#define ALPHA_2_AVX2(v) _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xF5), 0xF5)
+#define ALPHA_4_AVX2(v) _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xFF), 0xFF)
+
+/* Widen 8 (n=2) or 4 (n=4) coverage bytes to one 16 bit lane per
+ * component of 16 bytes of pixels. */
+static inline AVX2 __m256i
+coverage_2_avx2(__m128i m)
+{
+	m = _mm_unpacklo_epi8(m, _mm_setzero_si128());
+	return join_avx2(_mm_unpacklo_epi16(m, m), _mm_unpackhi_epi16(m, m));
+}
+
+static inline AVX2 __m256i
+coverage_4_avx2(unsigned int m4)
+{
+	__m128i m = _mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), _mm_setzero_si128());
+	m = _mm_unpacklo_epi16(m, m);
+	return join_avx2(_mm_unpacklo_epi32(m, m), _mm_unpackhi_epi32(m, m));
+}
+
+static AVX2 void
+fz_paint_solid_color_2_avx2(byte * restrict dp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[1]);
+	__m256i c = _mm256_set1_epi32(color[0] | (255 << 16));
+	__m256i a = _mm256_set1_epi16(sa);
+	if (sa == 0)
+		return;
+	for (; w >= 8; w -= 8, dp += 16)
+	{
+		__m256i d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		d = sa == 256 ? c : blend_avx2(c, d, a);
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(d));
+	}
+	fz_paint_solid_color_2(dp, w, color);
+}
+
+static AVX2 void
+fz_paint_solid_color_4_avx2(byte * restrict dp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[3]);
+	__m256i c = _mm256_setr_epi16(
+		color[0], color[1], color[2], 255, color[0], color[1], color[2], 255,
+		color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+	__m256i a = _mm256_set1_epi16(sa);
+	if (sa == 0)
+		return;
+	for (; w >= 4; w -= 4, dp += 16)
+	{
+		__m256i d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		d = sa == 256 ? c : blend_avx2(c, d, a);
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(d));
+	}
+	fz_paint_solid_color_4(dp, w, color);
+}
+
+static AVX2 void
+fz_paint_span_with_color_2_avx2(byte * restrict dp, byte * restrict mp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[1]);
+	__m256i c = _mm256_set1_epi32(color[0] | (255 << 16));
+	__m256i a = _mm256_set1_epi16(sa);
+	for (; w >= 8; w -= 8, dp += 16, mp += 8)
+	{
+		__m128i m8 = _mm_loadl_epi64((__m128i *)mp);
+		__m256i m, d;
+		if ((_mm_movemask_epi8(_mm_cmpeq_epi8(m8, _mm_setzero_si128())) & 0xFF) == 0xFF)
+			continue;
+		m = expand_avx2(coverage_2_avx2(m8));
+		if (sa != 256)
+			m = combine_avx2(m, a);
+		d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(blend_avx2(c, d, m)));
+	}
+	fz_paint_span_with_color_2(dp, mp, w, color);
+}
+
+static AVX2 void
+fz_paint_span_with_color_4_avx2(byte * restrict dp, byte * restrict mp, int w, byte *color)
+{
+	int sa = FZ_EXPAND(color[3]);
+	__m256i c = _mm256_setr_epi16(
+		color[0], color[1], color[2], 255, color[0], color[1], color[2], 255,
+		color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+	__m256i a = _mm256_set1_epi16(sa);
+	if (sa == 0)
+		return;
+	for (; w >= 4; w -= 4, dp += 16, mp += 4)
+	{
+		unsigned int m4 = load_u32(mp);
+		__m256i m, d;
+		if (m4 == 0)
+			continue;
+		if (sa == 256 && m4 == 0xFFFFFFFF)
+		{
+			_mm_storeu_si128((__m128i *)dp, narrow_avx2(c));
+			continue;
+		}
+		m = expand_avx2(coverage_4_avx2(m4));
+		if (sa != 256)
+			m = combine_avx2(m, a);
+		d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(blend_avx2(c, d, m)));
+	}
+	fz_paint_span_with_color_4(dp, mp, w, color);
+}
+
+static AVX2 void
+fz_paint_span_with_mask_2_avx2(byte * restrict dp, byte * restrict sp, byte * restrict mp, int w)
+{
+	for (; w >= 8; w -= 8, dp += 16, sp += 16, mp += 8)
+	{
+		__m128i m8 = _mm_loadl_epi64((__m128i *)mp);
+		__m256i s, d;
+		if ((_mm_movemask_epi8(_mm_cmpeq_epi8(m8, _mm_setzero_si128())) & 0xFF) == 0xFF)
+			continue;
+		s = widen_avx2(_mm_loadu_si128((__m128i *)sp));
+		d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		d = mask_over_avx2(s, d, ALPHA_2_AVX2(s), expand_avx2(coverage_2_avx2(m8)));
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(d));
+	}
+	fz_paint_span_with_mask_2(dp, sp, mp, w);
+}
+
+static AVX2 void
+fz_paint_span_with_mask_4_avx2(byte * restrict dp, byte * restrict sp, byte * restrict mp, int w)
+{
+	for (; w >= 4; w -= 4, dp += 16, sp += 16, mp += 4)
+	{
+		unsigned int m4 = load_u32(mp);
+		__m256i s, d;
+		if (m4 == 0)
+			continue;
+		s = widen_avx2(_mm_loadu_si128((__m128i *)sp));
+		d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		d = mask_over_avx2(s, d, ALPHA_4_AVX2(s), expand_avx2(coverage_4_avx2(m4)));
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(d));
+	}
+	fz_paint_span_with_mask_4(dp, sp, mp, w);
+}
+
+static AVX2 void
+fz_paint_span_2_avx2(byte * restrict dp, byte * restrict sp, int w)
+{
+	for (; w >= 16; w -= 16, dp += 32, sp += 32)
+	{
+		__m256i s = _mm256_loadu_si256((__m256i *)sp);
+		__m256i d, slo, shi;
+		unsigned int alpha = _mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_setzero_si256()));
+		if ((alpha & 0xAAAAAAAA) == 0xAAAAAAAA)
+			continue;
+		alpha = _mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_set1_epi8(-1)));
+		if ((alpha & 0xAAAAAAAA) == 0xAAAAAAAA)
+		{
+			_mm256_storeu_si256((__m256i *)dp, s);
+			continue;
+		}
+		d = _mm256_loadu_si256((__m256i *)dp);
+		slo = widen_avx2(_mm256_castsi256_si128(s));
+		shi = widen_avx2(_mm256_extracti128_si256(s, 1));
+		d = join_avx2(
+			narrow_avx2(over_avx2(slo, widen_avx2(_mm256_castsi256_si128(d)), ALPHA_2_AVX2(slo))),
+			narrow_avx2(over_avx2(shi, widen_avx2(_mm256_extracti128_si256(d, 1)), ALPHA_2_AVX2(shi))));
+		_mm256_storeu_si256((__m256i *)dp, d);
+	}
+	fz_paint_span_2(dp, sp, w);
+}
+
+static AVX2 void
+fz_paint_span_4_avx2(byte * restrict dp, byte * restrict sp, int w)
+{
+	for (; w >= 8; w -= 8, dp += 32, sp += 32)
+	{
+		__m256i s = _mm256_loadu_si256((__m256i *)sp);
+		__m256i d, slo, shi;
+		unsigned int alpha = _mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_setzero_si256()));
+		if ((alpha & 0x88888888) == 0x88888888)
+			continue;
+		alpha = _mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_set1_epi8(-1)));
+		if ((alpha & 0x88888888) == 0x88888888)
+		{
+			_mm256_storeu_si256((__m256i *)dp, s);
+			continue;
+		}
+		d = _mm256_loadu_si256((__m256i *)dp);
+		slo = widen_avx2(_mm256_castsi256_si128(s));
+		shi = widen_avx2(_mm256_extracti128_si256(s, 1));
+		d = join_avx2(
+			narrow_avx2(over_avx2(slo, widen_avx2(_mm256_castsi256_si128(d)), ALPHA_4_AVX2(slo))),
+			narrow_avx2(over_avx2(shi, widen_avx2(_mm256_extracti128_si256(d, 1)), ALPHA_4_AVX2(shi))));
+		_mm256_storeu_si256((__m256i *)dp, d);
+	}
+	fz_paint_span_4(dp, sp, w);
+}
+
+static AVX2 void
+fz_paint_span_2_with_alpha_avx2(byte * restrict dp, byte * restrict sp, int w, int alpha)
+{
+	__m256i a = _mm256_set1_epi16(FZ_EXPAND(alpha));
+	for (; w >= 8; w -= 8, dp += 16, sp += 16)
+	{
+		__m256i s = widen_avx2(_mm_loadu_si128((__m128i *)sp));
+		__m256i d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		d = blend_avx2(s, d, combine_avx2(ALPHA_2_AVX2(s), a));
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(d));
+	}
+	fz_paint_span_2_with_alpha(dp, sp, w, alpha);
+}
+
+static AVX2 void
+fz_paint_span_4_with_alpha_avx2(byte * restrict dp, byte * restrict sp, int w, int alpha)
+{
+	__m256i a = _mm256_set1_epi16(FZ_EXPAND(alpha));
+	for (; w >= 4; w -= 4, dp += 16, sp += 16)
+	{
+		__m256i s = widen_avx2(_mm_loadu_si128((__m128i *)sp));
+		__m256i d = widen_avx2(_mm_loadu_si128((__m128i *)dp));
+		d = blend_avx2(s, d, combine_avx2(ALPHA_4_AVX2(s), a));
+		_mm_storeu_si128((__m128i *)dp, narrow_avx2(d));
+	}
+	fz_paint_span_4_with_alpha(dp, sp, w, alpha);
+}
+
+static const fz_span_painters fz_span_painters_avx2 =
+{
+	fz_paint_solid_color_2_avx2,
+	fz_paint_solid_color_4_avx2,
+	fz_paint_span_with_color_2_avx2,
+	fz_paint_span_with_color_4_avx2,
+	fz_paint_span_with_mask_2_avx2,
+	fz_paint_span_with_mask_4_avx2,
+	fz_paint_span_2_avx2,
+	fz_paint_span_4_avx2,
+	fz_paint_span_2_with_alpha_avx2,
+	fz_paint_span_4_with_alpha_avx2,
+};
+
+#endif /* ARCH_X86_SIMD */
+
+static const fz_span_painters fz_span_painters_c =
+{
+	fz_paint_solid_color_2,
+	fz_paint_solid_color_4,
+	fz_paint_span_with_color_2,
+	fz_paint_span_with_color_4,
+	fz_paint_span_with_mask_2,
+	fz_paint_span_with_mask_4,
+	fz_paint_span_2,
+	fz_paint_span_4,
+	fz_paint_span_2_with_alpha,
+	fz_paint_span_4_with_alpha,
+};
+
+int
+fz_cpu_features(void)
+{
+	int features = 0;
+#ifdef ARCH_X86_SIMD
+	features |= FZ_CPU_SSE2;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		features |= FZ_CPU_AVX2;
+#endif
+	return features;
+}
+
+#ifdef ARCH_X86_SIMD
+
+/* The painters take no context, so the choice is made once, by the
+ * first fz_new_context, before any render thread is running. Later
+ * contexts, which may be made while others are drawing, leave it be;
+ * they run on the same processor, so would choose the same. */
+static const fz_span_painters *fz_span_painters_selected = NULL;
+
+void
+fz_select_span_painters(fz_context *ctx)
+{
+	if (fz_span_painters_selected)
+		return;
+	if (ctx->cpu_features & FZ_CPU_AVX2)
+		fz_span_painters_selected = &fz_span_painters_avx2;
+	else if (ctx->cpu_features & FZ_CPU_SSE2)
+		fz_span_painters_selected = &fz_span_painters_sse2;
+	else
+		fz_span_painters_selected = &fz_span_painters_c;
+}
+
+static inline const fz_span_painters *
+fz_get_span_painters(void)
+{
+	return fz_span_painters_selected;
+}
+
+#else
+
+void
+fz_select_span_painters(fz_context *ctx)
+{
+}
+
+static inline const fz_span_painters *
+fz_get_span_painters(void)
+{
+	return &fz_span_painters_c;
+}
+
+#endif
@@ -218,6 +218,8 @@ struct fz_weights_s
 struct fz_scale_cache_s
 {
 	int src_w;
+	int src_off;
+	int src_len;
 	float x;
 	float dst_w;
 	fz_scale_filter *filter;
@@ -231,7 +233,7 @@ struct fz_scale_cache_s
 };
 
 static fz_weights *
-new_weights(fz_context *ctx, fz_scale_filter *filter, int src_w, float dst_w, int patch_w, int n, int flip, int patch_l)
+new_weights(fz_context *ctx, fz_scale_filter *filter, int src_w, int src_len, float dst_w, int patch_w, int n, int flip, int patch_l)
 {
 	int max_len;
 	fz_weights *weights;
@@ -242,8 +244,8 @@ new_weights(fz_context *ctx, fz_scale_filter *filter, int src_w, float dst_w, in
 		 * 2*filterwidth*src_w/dst_w src pixels
 		 * contributing to each dst pixel. */
 		max_len = (int)ceilf((2 * filter->width * src_w)/dst_w);
-		if (max_len > src_w)
-			max_len = src_w;
+		if (max_len > src_len)
+			max_len = src_len;
 	}
 	else
 	{
@@ -251,6 +253,8 @@ new_weights(fz_context *ctx, fz_scale_filter *filter, int src_w, float dst_w, in
 		 * 2*filterwidth src pixels contributing to each dst pixel.
 		 */
 		max_len = 2 * filter->width;
+		if (max_len > src_len)
+			max_len = src_len;
 	}
 	/* We need the size of the struct,
 	 * plus patch_w*sizeof(int) for the index
@@ -291,9 +295,13 @@ init_weights(fz_weights *weights, int j)
 	weights->index[index+1] = 0; /* len */
 }
 
+/* Only the src_len source pixels from src_off are held. Weights for
+ * pixels outside those, but within the source, go to the nearest one
+ * held; the caller makes sure that this does not happen for any
+ * destination pixel it keeps. Pixels are numbered from src_off. */
 static void
 add_weight(fz_weights *weights, int j, int i, fz_scale_filter *filter,
-	float x, float F, float G, int src_w, float dst_w)
+	float x, float F, float G, int src_w, int src_off, int src_len, float dst_w)
 {
 	float dist = j - x + 0.5f - ((i + 0.5f)*dst_w/src_w);
 	float f;
@@ -308,6 +316,11 @@ add_weight(fz_weights *weights, int j, int i, fz_scale_filter *filter,
 	/* Ensure i is in range */
 	if (i < 0 || i >= src_w)
 		return;
+	i -= src_off;
+	if (i < 0)
+		i = 0;
+	else if (i >= src_len)
+		i = src_len - 1;
 	if (weight == 0)
 	{
 		/* We add a fudge factor here to allow for extreme downscales
@@ -450,7 +463,7 @@ check_weights(fz_weights *weights, int j, int w, float x, float wf)
 }
 
 static fz_weights *
-make_weights(fz_context *ctx, int src_w, float x, float dst_w, fz_scale_filter *filter, int vertical, int dst_w_int, int patch_l, int patch_r, int n, int flip, fz_scale_cache *cache)
+make_weights(fz_context *ctx, int src_w, int src_off, int src_len, float x, float dst_w, fz_scale_filter *filter, int vertical, int dst_w_int, int patch_l, int patch_r, int n, int flip, fz_scale_cache *cache)
 {
 	fz_weights *weights;
 	float F, G;
@@ -459,7 +472,8 @@ make_weights(fz_context *ctx, int src_w, float x, float dst_w, fz_scale_filter *
 
 	if (cache)
 	{
-		if (cache->src_w == src_w && cache->x == x && cache->dst_w == dst_w &&
+		if (cache->src_w == src_w && cache->src_off == src_off &&
+			cache->src_len == src_len && cache->x == x && cache->dst_w == dst_w &&
 			cache->filter == filter && cache->vertical == vertical &&
 			cache->dst_w_int == dst_w_int &&
 			cache->patch_l == patch_l && cache->patch_r == patch_r &&
@@ -468,6 +482,8 @@ make_weights(fz_context *ctx, int src_w, float x, float dst_w, fz_scale_filter *
 			return cache->weights;
 		}
 		cache->src_w = src_w;
+		cache->src_off = src_off;
+		cache->src_len = src_len;
 		cache->x = x;
 		cache->dst_w = dst_w;
 		cache->filter = filter;
@@ -495,7 +511,7 @@ make_weights(fz_context *ctx, int src_w, float x, float dst_w, fz_scale_filter *
 	}
 	window = filter->width / F;
 	DBUG(("make_weights src_w=%d x=%g dst_w=%g patch_l=%d patch_r=%d F=%g window=%g\n", src_w, x, dst_w, patch_l, patch_r, F, window));
-	weights	= new_weights(ctx, filter, src_w, dst_w, patch_r-patch_l, n, flip, patch_l);
+	weights	= new_weights(ctx, filter, src_w, src_len, dst_w, patch_r-patch_l, n, flip, patch_l);
 	if (!weights)
 		return NULL;
 	for (j = patch_l; j < patch_r; j++)
@@ -509,12 +525,12 @@ make_weights(fz_context *ctx, int src_w, float x, float dst_w, fz_scale_filter *
 		init_weights(weights, j);
 		for (; l <= r; l++)
 		{
-			add_weight(weights, j, l, filter, x, F, G, src_w, dst_w);
+			add_weight(weights, j, l, filter, x, F, G, src_w, src_off, src_len, dst_w);
 		}
 		check_weights(weights, j, dst_w_int, x, dst_w);
 		if (vertical)
 		{
-			reorder_weights(weights, j, src_w);
+			reorder_weights(weights, j, src_len);
 		}
 	}
 	weights->count++; /* weights->count = dst_w_int now */
@@ -1059,6 +1075,281 @@ scale_row_from_temp(unsigned char *dst, unsigned char *src, fz_weights *weights,
 }
 #endif
 
+#ifdef ARCH_X86_SIMD
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+/*
+The x86 versions below produce exactly the same bytes as the C versions.
+All the arithmetic is in integers, the weights always fit in 16 bits,
+and the final >>8 is truncated to a byte rather than saturated, so the
+order in which the products are summed makes no difference.
+
+The horizontal passes use pmaddwd on pairs of source pixels with their
+channels interleaved. The vertical pass pairs up rows of the temporary
+buffer and does 16 (or 32) output bytes at a time.
+*/
+
+static inline unsigned int
+load_u32(const unsigned char *p)
+{
+	unsigned int v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline int
+weight_pair(int w0, int w1)
+{
+	return (w0 & 0xffff) | (w1 << 16);
+}
+
+static void
+scale_row_to_temp1_sse2(unsigned char *dst, unsigned char *src, fz_weights *weights)
+{
+	int *contrib = &weights->index[weights->index[0]];
+	const __m128i zero = _mm_setzero_si128();
+	int step = 1;
+	int len, i;
+	unsigned char *min;
+
+	assert(weights->n == 1);
+	if (weights->flip)
+	{
+		dst += weights->count-1;
+		step = -1;
+	}
+	for (i=weights->count; i > 0; i--)
+	{
+		__m128i acc = zero;
+		int val;
+		min = &src[*contrib++];
+		len = *contrib++;
+		for (; len >= 8; len -= 8)
+		{
+			__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)min), zero);
+			__m128i w = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)contrib), _mm_loadu_si128((const __m128i *)(contrib + 4)));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(p, w));
+			min += 8;
+			contrib += 8;
+		}
+		acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+		acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+		val = 128 + _mm_cvtsi128_si32(acc);
+		while (len-- > 0)
+			val += *min++ * *contrib++;
+		*dst = (unsigned char)(val>>8);
+		dst += step;
+	}
+}
+
+static void
+scale_row_to_temp2_sse2(unsigned char *dst, unsigned char *src, fz_weights *weights)
+{
+	int *contrib = &weights->index[weights->index[0]];
+	const __m128i zero = _mm_setzero_si128();
+	int step = 2;
+	int len, i;
+	unsigned char *min;
+
+	assert(weights->n == 2);
+	if (weights->flip)
+	{
+		dst += 2*(weights->count-1);
+		step = -2;
+	}
+	for (i=weights->count; i > 0; i--)
+	{
+		__m128i acc = zero;
+		int c1, c2;
+		min = &src[2 * *contrib++];
+		len = *contrib++;
+		for (; len >= 4; len -= 4)
+		{
+			/* g0 a0 g1 a1 g2 a2 g3 a3 -> g0 g1 a0 a1 g2 g3 a2 a3 */
+			__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)min), zero);
+			__m128i w = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)contrib), zero);
+			p = _mm_shufflelo_epi16(p, _MM_SHUFFLE(3,1,2,0));
+			p = _mm_shufflehi_epi16(p, _MM_SHUFFLE(3,1,2,0));
+			w = _mm_shuffle_epi32(w, _MM_SHUFFLE(1,1,0,0));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(p, w));
+			min += 8;
+			contrib += 4;
+		}
+		acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+		c1 = 128 + _mm_cvtsi128_si32(acc);
+		c2 = 128 + _mm_cvtsi128_si32(_mm_srli_si128(acc, 4));
+		while (len-- > 0)
+		{
+			c1 += *min++ * *contrib;
+			c2 += *min++ * *contrib++;
+		}
+		dst[0] = (unsigned char)(c1>>8);
+		dst[1] = (unsigned char)(c2>>8);
+		dst += step;
+	}
+}
+
+static void
+scale_row_to_temp4_sse2(unsigned char *dst, unsigned char *src, fz_weights *weights)
+{
+	int *contrib = &weights->index[weights->index[0]];
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i mask = _mm_set1_epi32(0xff);
+	int step = 4;
+	int len, i;
+	unsigned char *min;
+
+	assert(weights->n == 4);
+	if (weights->flip)
+	{
+		dst += 4*(weights->count-1);
+		step = -4;
+	}
+	for (i=weights->count; i > 0; i--)
+	{
+		__m128i acc = round;
+		unsigned int v;
+		min = &src[4 * *contrib++];
+		len = *contrib++;
+		for (; len >= 4; len -= 4)
+		{
+			/* r0 g0 b0 a0 r1 g1 b1 a1 -> r0 r1 g0 g1 b0 b1 a0 a1 */
+			__m128i p = _mm_loadu_si128((const __m128i *)min);
+			__m128i w = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)contrib), zero);
+			__m128i lo = _mm_unpacklo_epi8(p, zero);
+			__m128i hi = _mm_unpackhi_epi8(p, zero);
+			lo = _mm_unpacklo_epi16(lo, _mm_srli_si128(lo, 8));
+			hi = _mm_unpacklo_epi16(hi, _mm_srli_si128(hi, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, _mm_shuffle_epi32(w, 0x00)));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, _mm_shuffle_epi32(w, 0x55)));
+			min += 16;
+			contrib += 4;
+		}
+		if (len >= 2)
+		{
+			__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)min), zero);
+			p = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(weight_pair(contrib[0], contrib[1]))));
+			min += 8;
+			contrib += 2;
+			len -= 2;
+		}
+		if (len > 0)
+		{
+			__m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load_u32(min)), zero);
+			p = _mm_unpacklo_epi16(p, zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(weight_pair(contrib[0], 0))));
+			contrib++;
+		}
+		acc = _mm_and_si128(_mm_srai_epi32(acc, 8), mask);
+		acc = _mm_packs_epi32(acc, acc);
+		v = _mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+		memcpy(dst, &v, 4);
+		dst += step;
+	}
+}
+
+/* Output bytes x to width of a row from the temporary buffer */
+static void
+scale_cols_from_temp_sse2(unsigned char *dst, unsigned char *src, const int *contrib, int len, int width, int x)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i mask = _mm_set1_epi32(0xff);
+	int k;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+		unsigned char *s = src + x;
+		for (k = 0; k < len; k += 2)
+		{
+			__m128i r0 = _mm_loadu_si128((const __m128i *)s);
+			__m128i r1 = k + 1 < len ? _mm_loadu_si128((const __m128i *)(s + width)) : zero;
+			__m128i w = _mm_set1_epi32(weight_pair(contrib[k], k + 1 < len ? contrib[k+1] : 0));
+			__m128i lo = _mm_unpacklo_epi8(r0, r1);
+			__m128i hi = _mm_unpackhi_epi8(r0, r1);
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+			s += 2 * width;
+		}
+		acc0 = _mm_and_si128(_mm_srai_epi32(acc0, 8), mask);
+		acc1 = _mm_and_si128(_mm_srai_epi32(acc1, 8), mask);
+		acc2 = _mm_and_si128(_mm_srai_epi32(acc2, 8), mask);
+		acc3 = _mm_and_si128(_mm_srai_epi32(acc3, 8), mask);
+		_mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3)));
+	}
+	for (; x < width; x++)
+	{
+		unsigned char *min = src + x;
+		int val = 128;
+		for (k = 0; k < len; k++)
+		{
+			val += *min * contrib[k];
+			min += width;
+		}
+		dst[x] = (unsigned char)(val>>8);
+	}
+}
+
+static void
+scale_row_from_temp_sse2(unsigned char *dst, unsigned char *src, fz_weights *weights, int width, int row)
+{
+	int *contrib = &weights->index[weights->index[row]];
+	int len;
+
+	contrib++; /* Skip min */
+	len = *contrib++;
+	scale_cols_from_temp_sse2(dst, src, contrib, len, width, 0);
+}
+
+__attribute__((target("avx2")))
+static void
+scale_row_from_temp_avx2(unsigned char *dst, unsigned char *src, fz_weights *weights, int width, int row)
+{
+	int *contrib = &weights->index[weights->index[row]];
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(128);
+	const __m256i mask = _mm256_set1_epi32(0xff);
+	int len, x, k;
+
+	contrib++; /* Skip min */
+	len = *contrib++;
+	/* The unpacks and packs both work within 128 bit lanes, so the
+	 * bytes come back out in the order they went in. */
+	for (x = 0; x + 32 <= width; x += 32)
+	{
+		__m256i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+		unsigned char *s = src + x;
+		for (k = 0; k < len; k += 2)
+		{
+			__m256i r0 = _mm256_loadu_si256((const __m256i *)s);
+			__m256i r1 = k + 1 < len ? _mm256_loadu_si256((const __m256i *)(s + width)) : zero;
+			__m256i w = _mm256_set1_epi32(weight_pair(contrib[k], k + 1 < len ? contrib[k+1] : 0));
+			__m256i lo = _mm256_unpacklo_epi8(r0, r1);
+			__m256i hi = _mm256_unpackhi_epi8(r0, r1);
+			acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+			s += 2 * width;
+		}
+		acc0 = _mm256_and_si256(_mm256_srai_epi32(acc0, 8), mask);
+		acc1 = _mm256_and_si256(_mm256_srai_epi32(acc1, 8), mask);
+		acc2 = _mm256_and_si256(_mm256_srai_epi32(acc2, 8), mask);
+		acc3 = _mm256_and_si256(_mm256_srai_epi32(acc3, 8), mask);
+		_mm256_storeu_si256((__m256i *)(dst + x), _mm256_packus_epi16(_mm256_packs_epi32(acc0, acc1), _mm256_packs_epi32(acc2, acc3)));
+	}
+	scale_cols_from_temp_sse2(dst, src, contrib, len, width, x);
+}
+
+#endif /* ARCH_X86_SIMD */
+
 #ifdef SINGLE_PIXEL_SPECIALS
 static void
 duplicate_single_pixel(unsigned char *dst, unsigned char *src, int n, int w, int h)
@@ -1206,6 +1497,98 @@ scale_single_col(unsigned char *dst, unsigned char *src, fz_weights *weights, in
 }
 #endif /* SINGLE_PIXEL_SPECIALS */
 
+typedef void (fz_scale_row_to_temp)(unsigned char *dst, unsigned char *src, fz_weights *weights);
+typedef void (fz_scale_row_from_temp)(unsigned char *dst, unsigned char *src, fz_weights *weights, int width, int row);
+
+static fz_scale_row_to_temp *
+lookup_row_to_temp(fz_context *ctx, int n)
+{
+#ifdef ARCH_X86_SIMD
+	if (ctx->cpu_features & FZ_CPU_SSE2)
+	{
+		switch (n)
+		{
+		case 1: return scale_row_to_temp1_sse2;
+		case 2: return scale_row_to_temp2_sse2;
+		case 4: return scale_row_to_temp4_sse2;
+		}
+	}
+#endif
+	switch (n)
+	{
+	default: return scale_row_to_temp;
+	case 1: return scale_row_to_temp1; /* Image mask case */
+	case 2: return scale_row_to_temp2; /* Greyscale with alpha case */
+	case 4: return scale_row_to_temp4; /* RGBA */
+	}
+}
+
+static fz_scale_row_from_temp *
+lookup_row_from_temp(fz_context *ctx)
+{
+#ifdef ARCH_X86_SIMD
+	if (ctx->cpu_features & FZ_CPU_AVX2)
+		return scale_row_from_temp_avx2;
+	if (ctx->cpu_features & FZ_CPU_SSE2)
+		return scale_row_from_temp_sse2;
+#endif
+	return scale_row_from_temp;
+}
+
+/* With a task runner, the output rows are split into bands of about this
+ * many pixels. Each band scales the source rows it needs into a temporary
+ * buffer of its own, so the few rows where two bands meet are scaled
+ * horizontally twice. */
+#define SCALE_BAND_PIXELS (64 * 1024)
+
+typedef struct
+{
+	fz_pixmap *src;
+	fz_pixmap *dst;
+	fz_weights *rows;
+	fz_weights *cols;
+	fz_scale_row_to_temp *to_temp;
+	fz_scale_row_from_temp *from_temp;
+	unsigned char *temp;
+	int temp_span, temp_rows, band_h, flip_y;
+} fz_scale_bands;
+
+static void
+fz_scale_band(void *arg, int i)
+{
+	fz_scale_bands *b = arg;
+	fz_weights *contrib_rows = b->rows;
+	fz_pixmap *src = b->src;
+	fz_pixmap *output = b->dst;
+	unsigned char *temp = b->temp + (size_t)i * b->temp_span * b->temp_rows;
+	int row = i * b->band_h;
+	int row_end = fz_mini(row + b->band_h, contrib_rows->count);
+	int max_row = contrib_rows->index[contrib_rows->index[row]];
+
+	for (; row < row_end; row++)
+	{
+		/*
+		Which source rows do we need to have scaled into the
+		temporary buffer in order to be able to do the final
+		scale?
+		*/
+		int row_index = contrib_rows->index[row];
+		int row_min = contrib_rows->index[row_index++];
+		int row_len = contrib_rows->index[row_index];
+		while (max_row < row_min+row_len)
+		{
+			/* Scale another row */
+			assert(max_row < src->h);
+			DBUG(("scaling row %d to temp\n", max_row));
+			b->to_temp(&temp[b->temp_span*(max_row % b->temp_rows)], &src->samples[(b->flip_y ? (src->h-1-max_row): max_row)*src->w*src->n], b->cols);
+			max_row++;
+		}
+
+		DBUG(("scaling row %d from temp\n", row));
+		b->from_temp(&output->samples[row*output->w*output->n], temp, contrib_rows, b->temp_span, row);
+	}
+}
+
 fz_pixmap *
 fz_scale_pixmap(fz_context *ctx, fz_pixmap *src, float x, float y, float w, float h, fz_irect *clip)
 {
@@ -1214,15 +1597,22 @@ fz_scale_pixmap(fz_context *ctx, fz_pixmap *src, float x, float y, float w, floa
 
 fz_pixmap *
 fz_scale_pixmap_cached(fz_context *ctx, fz_pixmap *src, float x, float y, float w, float h, const fz_irect *clip, fz_scale_cache *cache_x, fz_scale_cache *cache_y)
+{
+	return fz_scale_pixmap_part(ctx, src, NULL, x, y, w, h, clip, cache_x, cache_y);
+}
+
+fz_pixmap *
+fz_scale_pixmap_part(fz_context *ctx, fz_pixmap *src, const fz_irect *whole, float x, float y, float w, float h, const fz_irect *clip, fz_scale_cache *cache_x, fz_scale_cache *cache_y)
 {
 	fz_scale_filter *filter = &fz_scale_filter_simple;
 	fz_weights *contrib_rows = NULL;
 	fz_weights *contrib_cols = NULL;
 	fz_pixmap *output = NULL;
 	unsigned char *temp = NULL;
-	int max_row, temp_span, temp_rows, row;
+	int temp_span, temp_rows;
 	int dst_w_int, dst_h_int, dst_x_int, dst_y_int;
 	int flip_x, flip_y;
+	int whole_w, whole_h, off_x, off_y;
 	fz_rect patch;
 
 	fz_var(contrib_cols);
@@ -1376,21 +1766,35 @@ fz_scale_pixmap_cached(fz_context *ctx, fz_pixmap *src, float x, float y, float
 	if (patch.x0 >= patch.x1 || patch.y0 >= patch.y1)
 		return NULL;
 
+	/* Where src sits within the whole source. Rows are counted from the
+	 * bottom when flipping. */
+	whole_w = src->w;
+	whole_h = src->h;
+	off_x = 0;
+	off_y = 0;
+	if (whole)
+	{
+		whole_w = whole->x1 - whole->x0;
+		whole_h = whole->y1 - whole->y0;
+		off_x = -whole->x0;
+		off_y = flip_y ? whole->y1 - src->h : -whole->y0;
+	}
+
 	fz_try(ctx)
 	{
 		/* Step 1: Calculate the weights for columns and rows */
 #ifdef SINGLE_PIXEL_SPECIALS
-		if (src->w == 1)
+		if (whole_w == 1)
 			contrib_cols = NULL;
 		else
 #endif /* SINGLE_PIXEL_SPECIALS */
-			contrib_cols = make_weights(ctx, src->w, x, w, filter, 0, dst_w_int, patch.x0, patch.x1, src->n, flip_x, cache_x);
+			contrib_cols = make_weights(ctx, whole_w, off_x, src->w, x, w, filter, 0, dst_w_int, patch.x0, patch.x1, src->n, flip_x, cache_x);
 #ifdef SINGLE_PIXEL_SPECIALS
-		if (src->h == 1)
+		if (whole_h == 1)
 			contrib_rows = NULL;
 		else
 #endif /* SINGLE_PIXEL_SPECIALS */
-			contrib_rows = make_weights(ctx, src->h, y, h, filter, 1, dst_h_int, patch.y0, patch.y1, src->n, flip_y, cache_y);
+			contrib_rows = make_weights(ctx, whole_h, off_y, src->h, y, h, filter, 1, dst_h_int, patch.y0, patch.y1, src->n, flip_y, cache_y);
 
 		output = fz_new_pixmap(ctx, src->colorspace, patch.x1 - patch.x0, patch.y1 - patch.y0);
 	}
@@ -1429,15 +1833,34 @@ fz_scale_pixmap_cached(fz_context *ctx, fz_pixmap *src, float x, float y, float
 	else
 #endif /* SINGLE_PIXEL_SPECIALS */
 	{
-		void (*row_scale)(unsigned char *dst, unsigned char *src, fz_weights *weights);
+		fz_scale_bands bands;
+		int count = 1;
+
+		fz_var(count);
 
 		temp_span = contrib_cols->count * src->n;
 		temp_rows = contrib_rows->max_len;
 		if (temp_span <= 0 || temp_rows > INT_MAX / temp_span)
 			goto cleanup;
+
+		bands.band_h = contrib_rows->count;
+		if (ctx->tasks && (size_t)output->w * output->h >= 2 * SCALE_BAND_PIXELS)
+		{
+			bands.band_h = fz_maxi(16, SCALE_BAND_PIXELS / output->w);
+			count = (contrib_rows->count + bands.band_h - 1) / bands.band_h;
+			/* Not getting a buffer for every band only costs speed */
+			if (count > 1 && count <= INT_MAX / (temp_span * temp_rows))
+				temp = fz_calloc_no_throw(ctx, count, temp_span * temp_rows);
+			if (!temp)
+			{
+				bands.band_h = contrib_rows->count;
+				count = 1;
+			}
+		}
 		fz_try(ctx)
 		{
-			temp = fz_calloc(ctx, temp_span*temp_rows, sizeof(unsigned char));
+			if (!temp)
+				temp = fz_calloc(ctx, temp_span*temp_rows, sizeof(unsigned char));
 		}
 		fz_catch(ctx)
 		{
@@ -1448,44 +1871,17 @@ fz_scale_pixmap_cached(fz_context *ctx, fz_pixmap *src, float x, float y, float
 				fz_free(ctx, contrib_rows);
 			fz_rethrow(ctx);
 		}
-		switch (src->n)
-		{
-		default:
-			row_scale = scale_row_to_temp;
-			break;
-		case 1: /* Image mask case */
-			row_scale = scale_row_to_temp1;
-			break;
-		case 2: /* Greyscale with alpha case */
-			row_scale = scale_row_to_temp2;
-			break;
-		case 4: /* RGBA */
-			row_scale = scale_row_to_temp4;
-			break;
-		}
-		max_row = contrib_rows->index[contrib_rows->index[0]];
-		for (row = 0; row < contrib_rows->count; row++)
-		{
-			/*
-			Which source rows do we need to have scaled into the
-			temporary buffer in order to be able to do the final
-			scale?
-			*/
-			int row_index = contrib_rows->index[row];
-			int row_min = contrib_rows->index[row_index++];
-			int row_len = contrib_rows->index[row_index];
-			while (max_row < row_min+row_len)
-			{
-				/* Scale another row */
-				assert(max_row < src->h);
-				DBUG(("scaling row %d to temp\n", max_row));
-				(*row_scale)(&temp[temp_span*(max_row % temp_rows)], &src->samples[(flip_y ? (src->h-1-max_row): max_row)*src->w*src->n], contrib_cols);
-				max_row++;
-			}
-
-			DBUG(("scaling row %d from temp\n", row));
-			scale_row_from_temp(&output->samples[row*output->w*output->n], temp, contrib_rows, temp_span, row);
-		}
+		bands.src = src;
+		bands.dst = output;
+		bands.rows = contrib_rows;
+		bands.cols = contrib_cols;
+		bands.to_temp = lookup_row_to_temp(ctx, src->n);
+		bands.from_temp = lookup_row_from_temp(ctx);
+		bands.temp = temp;
+		bands.temp_span = temp_span;
+		bands.temp_rows = temp_rows;
+		bands.flip_y = flip_y;
+		fz_run_tasks(ctx, count, fz_scale_band, &bands);
 		fz_free(ctx, temp);
 	}
 
@@ -8,13 +8,17 @@ fz_open_copy(fz_context *ctx, fz_stream *chain)
 	return fz_keep_stream(ctx, chain);
 }
 
-/* Null filter copies a specified amount of data */
+/* Null filter copies a specified amount of data. When the chain reads
+ * from memory, it hands out pointers into that memory instead. */
 
 struct null_filter
 {
 	fz_stream *chain;
-	int remain;
-	int offset;
+	fz_off_t remain;
+	fz_off_t offset;
+	fz_off_t start;
+	fz_off_t len;
+	fz_stream_memory mem;
 	unsigned char buffer[4096];
 };
 
@@ -26,6 +30,22 @@ next_null(fz_context *ctx, fz_stream *stm, int max)
 
 	if (state->remain == 0)
 		return EOF;
+	if (state->mem.data)
+	{
+		fz_off_t avail = state->mem.len - state->offset;
+		if (avail > state->remain)
+			avail = state->remain;
+		if (avail > INT_MAX)
+			avail = INT_MAX;
+		if (avail <= 0)
+			return EOF;
+		stm->rp = state->mem.data + state->offset;
+		stm->wp = stm->rp + avail;
+		state->remain -= avail;
+		state->offset += avail;
+		stm->pos += avail;
+		return *stm->rp++;
+	}
 	fz_seek(ctx, state->chain, state->offset, 0);
 	n = fz_available(ctx, state->chain, max);
 	if (n > state->remain)
@@ -44,6 +64,41 @@ next_null(fz_context *ctx, fz_stream *stm, int max)
 	return *stm->rp++;
 }
 
+static void
+seek_null(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence)
+{
+	struct null_filter *state = stm->state;
+
+	if (whence == 2)
+		offset += state->len;
+	if (offset < 0)
+		offset = 0;
+	if (offset > state->len)
+		offset = state->len;
+	state->offset = state->start + offset;
+	state->remain = state->len - offset;
+	stm->pos = offset;
+	stm->rp = stm->wp = state->buffer;
+}
+
+static int
+meta_null(fz_context *ctx, fz_stream *stm, int key, int size, void *ptr)
+{
+	struct null_filter *state = stm->state;
+
+	if (key == FZ_STREAM_META_MEMORY && state->mem.data && ptr && size == sizeof(fz_stream_memory))
+	{
+		fz_stream_memory *mem = ptr;
+		if (state->start > state->mem.len || state->len > state->mem.len - state->start)
+			return -1;
+		mem->data = state->mem.data + state->start;
+		mem->len = state->len;
+		mem->buffer = state->mem.buffer;
+		return 1;
+	}
+	return -1;
+}
+
 static void
 close_null(fz_context *ctx, void *state_)
 {
@@ -54,9 +109,10 @@ close_null(fz_context *ctx, void *state_)
 }
 
 fz_stream *
-fz_open_null(fz_context *ctx, fz_stream *chain, int len, int offset)
+fz_open_null(fz_context *ctx, fz_stream *chain, fz_off_t len, fz_off_t offset)
 {
 	struct null_filter *state;
+	fz_stream *stm;
 
 	if (len < 0)
 		len = 0;
@@ -66,6 +122,10 @@ fz_open_null(fz_context *ctx, fz_stream *chain, int len, int offset)
 		state->chain = chain;
 		state->remain = len;
 		state->offset = offset;
+		state->start = offset;
+		state->len = len;
+		if (fz_stream_meta(ctx, chain, FZ_STREAM_META_MEMORY, sizeof(state->mem), &state->mem) <= 0)
+			state->mem.data = NULL;
 	}
 	fz_catch(ctx)
 	{
@@ -73,7 +133,10 @@ fz_open_null(fz_context *ctx, fz_stream *chain, int len, int offset)
 		fz_rethrow(ctx);
 	}
 
-	return fz_new_stream(ctx, state, next_null, close_null);
+	stm = fz_new_stream(ctx, state, next_null, close_null);
+	stm->seek = seek_null;
+	stm->meta = meta_null;
+	return stm;
 }
 
 /* Concat filter concatenates several streams into one */
@@ -1310,7 +1310,11 @@ fz_advance_ft_glyph(fz_context *ctx, fz_font *font, int gid)
 	if (font->ft_substitute && font->width_table && gid < font->width_count)
 		return font->width_table[gid];
 
+	/* FT_Get_Advance may load the glyph into the face's glyph slot,
+	 * which other threads use while rendering. */
+	fz_lock(ctx, FZ_LOCK_FREETYPE);
 	FT_Get_Advance(font->ft_face, gid, mask, &adv);
+	fz_unlock(ctx, FZ_LOCK_FREETYPE);
 	return (float) adv / ((FT_Face)font->ft_face)->units_per_EM;
 }
 
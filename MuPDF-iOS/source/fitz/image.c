@@ -2,6 +2,10 @@
 
 #define SANE_DPI 72.0f
 
+/* Parts of images are decoded in whole cells of this many (subsampled)
+ * pixels square, so that nearby requests share decoded data. */
+#define IMAGE_REGION_GRID 256
+
 fz_pixmap *
 fz_new_pixmap_from_image(fz_context *ctx, fz_image *image, int w, int h)
 {
@@ -28,14 +32,19 @@ struct fz_image_key_s {
 	int refs;
 	fz_image *image;
 	int l2factor;
+	fz_irect rect;
 };
 
 static int
 fz_make_hash_image_key(fz_context *ctx, fz_store_hash *hash, void *key_)
 {
 	fz_image_key *key = (fz_image_key *)key_;
-	hash->u.pi.ptr = key->image;
-	hash->u.pi.i = key->l2factor;
+	hash->u.pir.ptr = key->image;
+	hash->u.pir.i = key->l2factor;
+	hash->u.pir.r[0] = key->rect.x0;
+	hash->u.pir.r[1] = key->rect.y0;
+	hash->u.pir.r[2] = key->rect.x1;
+	hash->u.pir.r[3] = key->rect.y1;
 	return 1;
 }
 
@@ -62,7 +71,9 @@ fz_cmp_image_key(fz_context *ctx, void *k0_, void *k1_)
 {
 	fz_image_key *k0 = (fz_image_key *)k0_;
 	fz_image_key *k1 = (fz_image_key *)k1_;
-	return k0->image == k1->image && k0->l2factor == k1->l2factor;
+	return k0->image == k1->image && k0->l2factor == k1->l2factor &&
+		k0->rect.x0 == k1->rect.x0 && k0->rect.y0 == k1->rect.y0 &&
+		k0->rect.x1 == k1->rect.x1 && k0->rect.y1 == k1->rect.y1;
 }
 
 #ifndef NDEBUG
@@ -71,7 +82,8 @@ fz_debug_image(fz_context *ctx, FILE *out, void *key_)
 {
 	fz_image_key *key = (fz_image_key *)key_;
 
-	fprintf(out, "(image %d x %d sf=%d) ", key->image->w, key->image->h, key->l2factor);
+	fprintf(out, "(image %d x %d sf=%d area=%d,%d,%d,%d) ", key->image->w, key->image->h, key->l2factor,
+		key->rect.x0, key->rect.y0, key->rect.x1, key->rect.y1);
 }
 #endif
 
@@ -86,6 +98,29 @@ static fz_store_type fz_image_store_type =
 #endif
 };
 
+/* A tile being decoded, for other threads wanting the same one to wait
+ * on. Keyed as fz_image_key, but holding no references of its own; the
+ * decoding thread keeps the image alive. */
+typedef struct fz_image_decode_s fz_image_decode;
+
+struct fz_image_decode_s
+{
+	fz_image_decode *next;
+	fz_image *image;
+	int l2factor;
+	fz_irect rect;
+	int users; /* The decoding thread, and those waiting for it */
+	int done;
+	fz_pixmap *tile; /* Holding a reference for each waiting thread */
+};
+
+struct fz_image_context_s
+{
+	int refs;
+	fz_image_decode *decoding;
+	fz_image_decode_stats stats;
+};
+
 static void
 fz_mask_color_key(fz_pixmap *pix, int n, int *colorkey)
 {
@@ -133,18 +168,57 @@ fz_unblend_masked_tile(fz_context *ctx, fz_pixmap *tile, fz_image *image)
 	fz_drop_pixmap(ctx, mask);
 }
 
-fz_pixmap *
-fz_decomp_image_from_stream(fz_context *ctx, fz_stream *stm, fz_image *image, int indexed, int l2factor, int native_l2factor)
+/* Read the rows of the subarea from a stream of packed samples, keeping
+ * only the bytes of the columns within it. Rows below the subarea are
+ * never decoded. */
+static int
+read_image_region(fz_context *ctx, fz_stream *stm, unsigned char *samples, unsigned char *row, int stride, int y0, int h, int skip, int len)
+{
+	int y, n, truncated = 0;
+
+	for (y = 0; y < y0 + h; y++)
+	{
+		n = fz_read(ctx, stm, row, stride);
+		if (n < stride)
+		{
+			truncated = 1;
+			memset(row + n, 0, stride - n);
+		}
+		if (y >= y0)
+			memcpy(samples + (y - y0) * len, row + skip, len);
+	}
+
+	return truncated;
+}
+
+static fz_pixmap *
+decomp_image_region(fz_context *ctx, fz_stream *stm, fz_image *image, const fz_irect *subarea, int indexed, int l2factor, int native_l2factor)
 {
 	fz_pixmap *tile = NULL;
 	int stride, len, i;
 	unsigned char *samples = NULL;
+	unsigned char *row = NULL;
 	int f = 1<<native_l2factor;
 	int w = (image->w + f-1) >> native_l2factor;
 	int h = (image->h + f-1) >> native_l2factor;
+	int x0 = 0, y0 = 0;
+
+	/* The subarea is aligned to the subsampling and to whole bytes */
+	if (subarea)
+	{
+		x0 = subarea->x0 >> native_l2factor;
+		y0 = subarea->y0 >> native_l2factor;
+		w = fz_mini(w, (subarea->x1 + f-1) >> native_l2factor) - x0;
+		h = fz_mini(h, (subarea->y1 + f-1) >> native_l2factor) - y0;
+	}
 
 	fz_var(tile);
 	fz_var(samples);
+	fz_var(row);
+	fz_var(w);
+	fz_var(h);
+	fz_var(x0);
+	fz_var(y0);
 
 	fz_try(ctx)
 	{
@@ -155,13 +229,25 @@ fz_decomp_image_from_stream(fz_context *ctx, fz_stream *stm, fz_image *image, in
 
 		samples = fz_malloc_array(ctx, h, stride);
 
-		len = fz_read(ctx, stm, samples, h * stride);
-
-		/* Pad truncated images */
-		if (len < stride * h)
+		if (subarea)
+		{
+			int full = (((image->w + f-1) >> native_l2factor) * image->n * image->bpc + 7) / 8;
+			row = fz_malloc(ctx, full);
+			if (read_image_region(ctx, stm, samples, row, full, y0, h, x0 * image->n * image->bpc / 8, stride))
+				fz_warn(ctx, "padding truncated image");
+			fz_free(ctx, row);
+			row = NULL;
+		}
+		else
 		{
-			fz_warn(ctx, "padding truncated image");
-			memset(samples + len, 0, stride * h - len);
+			len = fz_read(ctx, stm, samples, h * stride);
+
+			/* Pad truncated images */
+			if (len < stride * h)
+			{
+				fz_warn(ctx, "padding truncated image");
+				memset(samples + len, 0, stride * h - len);
+			}
 		}
 
 		/* Invert 1-bit image masks */
@@ -209,6 +295,7 @@ fz_decomp_image_from_stream(fz_context *ctx, fz_stream *stm, fz_image *image, in
 		if (tile)
 			fz_drop_pixmap(ctx, tile);
 		fz_free(ctx, samples);
+		fz_free(ctx, row);
 
 		fz_rethrow(ctx);
 	}
@@ -224,6 +311,12 @@ fz_decomp_image_from_stream(fz_context *ctx, fz_stream *stm, fz_image *image, in
 	return tile;
 }
 
+fz_pixmap *
+fz_decomp_image_from_stream(fz_context *ctx, fz_stream *stm, fz_image *image, int indexed, int l2factor, int native_l2factor)
+{
+	return decomp_image_region(ctx, stm, image, NULL, indexed, l2factor, native_l2factor);
+}
+
 void
 fz_drop_image_imp(fz_context *ctx, fz_storable *image_)
 {
@@ -238,25 +331,18 @@ fz_drop_image_imp(fz_context *ctx, fz_storable *image_)
 	fz_free(ctx, image);
 }
 
-fz_pixmap *
-fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
+/* What is our ideal factor? We search for the largest factor where
+ * we can subdivide and stay larger than the required size. We add
+ * a fudge factor of +2 here to allow for the possibility of
+ * expansion due to grid fitting. JPEG 2000 images have always been
+ * drawn from full resolution, so are never subsampled. */
+static int
+image_l2factor(fz_image *image, int w, int h)
 {
-	fz_pixmap *tile;
-	fz_stream *stm;
 	int l2factor;
-	fz_image_key key;
-	int native_l2factor;
-	int indexed;
-	fz_image_key *keyp;
 
-	/* Check for 'simple' images which are just pixmaps */
-	if (image->buffer == NULL)
-	{
-		tile = image->tile;
-		if (!tile)
-			return NULL;
-		return fz_keep_pixmap(ctx, tile); /* That's all we can give you! */
-	}
+	if (image->buffer && image->buffer->params.type == FZ_IMAGE_JPX)
+		return 0;
 
 	/* Ensure our expectations for tile size are reasonable */
 	if (w < 0 || w > image->w)
@@ -264,19 +350,42 @@ fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
 	if (h < 0 || h > image->h)
 		h = image->h;
 
-	/* What is our ideal factor? We search for the largest factor where
-	 * we can subdivide and stay larger than the required size. We add
-	 * a fudge factor of +2 here to allow for the possibility of
-	 * expansion due to grid fitting. */
 	if (w == 0 || h == 0)
-		l2factor = 0;
-	else
-		for (l2factor=0; image->w>>(l2factor+1) >= w+2 && image->h>>(l2factor+1) >= h+2 && l2factor < 8; l2factor++);
+		return 0;
+	for (l2factor=0; image->w>>(l2factor+1) >= w+2 && image->h>>(l2factor+1) >= h+2 && l2factor < 8; l2factor++);
+	return l2factor;
+}
+
+/* Can we decode parts of this image on their own? */
+static int
+image_region_decodable(fz_context *ctx, fz_image *image)
+{
+	/* The matte color is unblended against the whole of the mask */
+	if (image->usecolorkey && image->mask)
+		return 0;
+	switch (image->buffer->params.type)
+	{
+	case FZ_IMAGE_PNG:
+	case FZ_IMAGE_TIFF:
+	case FZ_IMAGE_JXR:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+/* Look for a tile of the given area. If whole is set, tiles of the whole
+ * image at a lower subsample factor will do as well. */
+static fz_pixmap *
+find_image_tile(fz_context *ctx, fz_image *image, const fz_irect *rect, int l2factor, int whole)
+{
+	fz_image_key key;
+	fz_pixmap *tile;
 
-	/* Can we find any suitable tiles in the cache? */
 	key.refs = 1;
 	key.image = image;
 	key.l2factor = l2factor;
+	key.rect = *rect;
 	do
 	{
 		tile = fz_find_item(ctx, fz_drop_pixmap_imp, &key, &fz_image_store_type);
@@ -284,26 +393,94 @@ fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
 			return tile;
 		key.l2factor--;
 	}
-	while (key.l2factor >= 0);
+	while (whole && key.l2factor >= 0);
+
+	return NULL;
+}
+
+/* Now we try to cache the pixmap. Any failure here will just result
+ * in us not caching. */
+static fz_pixmap *
+store_image_tile(fz_context *ctx, fz_image *image, const fz_irect *rect, int l2factor, fz_pixmap *tile)
+{
+	fz_image_key *keyp = NULL;
+
+	fz_var(keyp);
+	fz_var(tile);
+	fz_try(ctx)
+	{
+		fz_pixmap *existing_tile;
+
+		keyp = fz_malloc_struct(ctx, fz_image_key);
+		keyp->refs = 1;
+		keyp->image = fz_keep_image(ctx, image);
+		keyp->l2factor = l2factor;
+		keyp->rect = *rect;
+		existing_tile = fz_store_item(ctx, keyp, tile, fz_pixmap_size(ctx, tile), &fz_image_store_type);
+		if (existing_tile)
+		{
+			/* We already have a tile. This must have been produced by a
+			 * racing thread. We'll throw away ours and use that one. */
+			fz_drop_pixmap(ctx, tile);
+			tile = existing_tile;
+		}
+	}
+	fz_always(ctx)
+	{
+		if (keyp)
+			fz_drop_image_key(ctx, keyp);
+	}
+	fz_catch(ctx)
+	{
+		/* Do nothing */
+	}
+
+	return tile;
+}
+
+/* Decode the whole image, or just the given subarea of it */
+static fz_pixmap *
+decode_image(fz_context *ctx, fz_image *image, const fz_irect *subarea, int l2factor)
+{
+	fz_compressed_buffer *buffer = image->buffer;
+	fz_pixmap *tile = NULL;
+	fz_stream *stm;
+	int native_l2factor;
+	int indexed;
+
+	fz_var(tile);
 
-	/* We need to make a new one. */
 	/* First check for ones that we can't decode using streams */
-	switch (image->buffer->params.type)
+	switch (buffer->params.type)
 	{
 	case FZ_IMAGE_PNG:
-		tile = fz_load_png(ctx, image->buffer->buffer->data, image->buffer->buffer->len);
+		tile = fz_load_png(ctx, buffer->buffer->data, buffer->buffer->len);
 		break;
 	case FZ_IMAGE_TIFF:
-		tile = fz_load_tiff(ctx, image->buffer->buffer->data, image->buffer->buffer->len);
+		tile = fz_load_tiff(ctx, buffer->buffer->data, buffer->buffer->len);
 		break;
 	case FZ_IMAGE_JXR:
-		tile = fz_load_jxr(ctx, image->buffer->buffer->data, image->buffer->buffer->len);
+		tile = fz_load_jxr(ctx, buffer->buffer->data, buffer->buffer->len);
+		break;
+	case FZ_IMAGE_JPX:
+		indexed = fz_colorspace_is_indexed(ctx, image->colorspace);
+		tile = fz_load_jpx_region(ctx, buffer->buffer->data, buffer->buffer->len, image->colorspace, indexed, subarea);
+		fz_try(ctx)
+		{
+			if (!indexed)
+				fz_decode_tile(ctx, tile, image->decode);
+		}
+		fz_catch(ctx)
+		{
+			fz_drop_pixmap(ctx, tile);
+			fz_rethrow(ctx);
+		}
 		break;
 	case FZ_IMAGE_JPEG:
 		/* Scan JPEG stream and patch missing height values in header */
 		{
-			unsigned char *s = image->buffer->buffer->data;
-			unsigned char *e = s + image->buffer->buffer->len;
+			unsigned char *s = buffer->buffer->data;
+			unsigned char *e = s + buffer->buffer->len;
 			unsigned char *d;
 			for (d = s + 2; s < d && d < e - 9 && d[0] == 0xFF; d += (d[2] << 8 | d[3]) + 2)
 			{
@@ -320,16 +497,16 @@ fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
 
 	default:
 		native_l2factor = l2factor;
-		stm = fz_open_image_decomp_stream_from_buffer(ctx, image->buffer, &native_l2factor);
+		stm = fz_open_image_decomp_stream_from_buffer(ctx, buffer, &native_l2factor);
 
 		indexed = fz_colorspace_is_indexed(ctx, image->colorspace);
-		tile = fz_decomp_image_from_stream(ctx, stm, image, indexed, l2factor, native_l2factor);
+		tile = decomp_image_region(ctx, stm, image, subarea, indexed, l2factor, native_l2factor);
 
 		/* CMYK JPEGs in XPS documents have to be inverted */
 		if (image->invert_cmyk_jpeg &&
-			image->buffer->params.type == FZ_IMAGE_JPEG &&
+			buffer->params.type == FZ_IMAGE_JPEG &&
 			image->colorspace == fz_device_cmyk(ctx) &&
-			image->buffer->params.u.jpeg.color_transform)
+			buffer->params.u.jpeg.color_transform)
 		{
 			fz_invert_pixmap(ctx, tile);
 		}
@@ -337,38 +514,245 @@ fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
 		break;
 	}
 
-	/* Now we try to cache the pixmap. Any failure here will just result
-	 * in us not caching. */
-	fz_var(keyp);
+	return tile;
+}
+
+static int
+is_image_decode(fz_image_decode *dec, fz_image *image, const fz_irect *rect, int l2factor)
+{
+	return dec->image == image && dec->l2factor == l2factor &&
+		dec->rect.x0 == rect->x0 && dec->rect.y0 == rect->y0 &&
+		dec->rect.x1 == rect->x1 && dec->rect.y1 == rect->y1;
+}
+
+/* Decode and store a tile while listed in the image context, then hand
+ * it (or NULL on failure) to any threads that waited for it. */
+static fz_pixmap *
+decode_listed_tile(fz_context *ctx, fz_image *image, const fz_irect *subarea, fz_image_decode *dec)
+{
+	fz_image_context *ictx = ctx->image;
+	fz_image_decode **link;
+	fz_pixmap *tile = NULL;
+	int decoded = 0;
+	int i, n, last;
+
+	fz_var(tile);
+	fz_var(decoded);
+
 	fz_try(ctx)
 	{
-		fz_pixmap *existing_tile;
-
-		keyp = fz_malloc_struct(ctx, fz_image_key);
-		keyp->refs = 1;
-		keyp->image = fz_keep_image(ctx, image);
-		keyp->l2factor = l2factor;
-		existing_tile = fz_store_item(ctx, keyp, tile, fz_pixmap_size(ctx, tile), &fz_image_store_type);
-		if (existing_tile)
+		/* Another thread may have stored the tile and finished since
+		 * our caller looked */
+		tile = find_image_tile(ctx, image, &dec->rect, dec->l2factor, 0);
+		if (!tile)
 		{
-			/* We already have a tile. This must have been produced by a
-			 * racing thread. We'll throw away ours and use that one. */
-			fz_drop_pixmap(ctx, tile);
-			tile = existing_tile;
+			decoded = 1;
+			tile = decode_image(ctx, image, subarea, dec->l2factor);
+			tile = store_image_tile(ctx, image, &dec->rect, dec->l2factor, tile);
 		}
 	}
 	fz_always(ctx)
 	{
-		fz_drop_image_key(ctx, keyp);
+		/* Once off the list no more threads can start waiting, so we
+		 * know how many references to take for those that are. */
+		fz_lock(ctx, FZ_LOCK_IMAGE);
+		for (link = &ictx->decoding; *link != dec; link = &(*link)->next)
+			;
+		*link = dec->next;
+		ictx->stats.decodes += decoded;
+		n = dec->users - 1;
+		fz_unlock(ctx, FZ_LOCK_IMAGE);
+
+		for (i = 0; i < n && tile; i++)
+			fz_keep_pixmap(ctx, tile);
+
+		fz_lock(ctx, FZ_LOCK_IMAGE);
+		dec->tile = tile;
+		dec->done = 1;
+		last = --dec->users == 0;
+		fz_wake(ctx, FZ_LOCK_IMAGE);
+		fz_unlock(ctx, FZ_LOCK_IMAGE);
+		if (last)
+			fz_free(ctx, dec);
 	}
 	fz_catch(ctx)
 	{
-		/* Do nothing */
+		fz_rethrow(ctx);
 	}
 
 	return tile;
 }
 
+/* Decode and store a tile. If another thread is decoding the same tile
+ * already, wait for it to finish and share its result instead. */
+static fz_pixmap *
+decode_image_tile(fz_context *ctx, fz_image *image, const fz_irect *subarea, const fz_irect *rect, int l2factor)
+{
+	fz_image_context *ictx = ctx->image;
+	fz_image_decode *dec, *mine;
+	fz_pixmap *tile;
+	int last;
+
+	if (ctx->waiter == NULL)
+	{
+		tile = decode_image(ctx, image, subarea, l2factor);
+		fz_lock(ctx, FZ_LOCK_IMAGE);
+		ictx->stats.decodes++;
+		fz_unlock(ctx, FZ_LOCK_IMAGE);
+		return store_image_tile(ctx, image, rect, l2factor, tile);
+	}
+
+	mine = fz_malloc_struct(ctx, fz_image_decode);
+	mine->image = image;
+	mine->l2factor = l2factor;
+	mine->rect = *rect;
+	mine->users = 1;
+
+	for (;;)
+	{
+		fz_lock(ctx, FZ_LOCK_IMAGE);
+		for (dec = ictx->decoding; dec; dec = dec->next)
+			if (is_image_decode(dec, image, rect, l2factor))
+				break;
+		if (dec == NULL)
+		{
+			mine->next = ictx->decoding;
+			ictx->decoding = mine;
+			fz_unlock(ctx, FZ_LOCK_IMAGE);
+			return decode_listed_tile(ctx, image, subarea, mine);
+		}
+
+		dec->users++;
+		ictx->stats.waits++;
+		while (!dec->done)
+			fz_wait(ctx, FZ_LOCK_IMAGE);
+		tile = dec->tile;
+		if (tile)
+			ictx->stats.saved++;
+		last = --dec->users == 0;
+		fz_unlock(ctx, FZ_LOCK_IMAGE);
+		if (last)
+			fz_free(ctx, dec);
+
+		if (tile)
+		{
+			fz_free(ctx, mine);
+			return tile;
+		}
+
+		/* The other thread failed. Try again ourselves (unless yet
+		 * another thread has got there first). */
+	}
+}
+
+fz_pixmap *
+fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
+{
+	fz_pixmap *tile;
+	fz_irect whole;
+	int l2factor;
+
+	/* Check for 'simple' images which are just pixmaps */
+	if (image->buffer == NULL)
+	{
+		tile = image->tile;
+		if (!tile)
+			return NULL;
+		return fz_keep_pixmap(ctx, tile); /* That's all we can give you! */
+	}
+
+	l2factor = image_l2factor(image, w, h);
+
+	/* Can we find any suitable tiles in the cache? */
+	whole.x0 = 0;
+	whole.y0 = 0;
+	whole.x1 = image->w;
+	whole.y1 = image->h;
+	tile = find_image_tile(ctx, image, &whole, l2factor, 1);
+	if (tile)
+		return tile;
+
+	/* We need to make a new one. */
+	return decode_image_tile(ctx, image, NULL, &whole, l2factor);
+}
+
+fz_pixmap *
+fz_image_get_pixmap_region(fz_context *ctx, fz_image *image, fz_irect *subarea, int w, int h, int *l2factorp)
+{
+	fz_pixmap *tile;
+	fz_irect whole, area;
+	int l2factor, grid;
+
+	whole.x0 = 0;
+	whole.y0 = 0;
+	whole.x1 = image->w;
+	whole.y1 = image->h;
+
+	/* Images that we don't decode ourselves come whole */
+	if (image->get_pixmap != fz_image_get_pixmap || image->buffer == NULL || !image_region_decodable(ctx, image))
+	{
+		*subarea = whole;
+		return image->get_pixmap(ctx, image, w, h);
+	}
+
+	l2factor = image_l2factor(image, w, h);
+
+	/* Round the area out to the grid, which is a whole number of
+	 * subsampled pixels and of bytes of packed samples. */
+	area = *subarea;
+	fz_intersect_irect(&area, &whole);
+	grid = IMAGE_REGION_GRID << l2factor;
+	area.x0 = area.x0 / grid * grid;
+	area.y0 = area.y0 / grid * grid;
+	area.x1 = fz_mini(image->w, (area.x1 + grid - 1) / grid * grid);
+	area.y1 = fz_mini(image->h, (area.y1 + grid - 1) / grid * grid);
+
+	/* Decoding most of an image in parts gains nothing over decoding it
+	 * once and keeping it whole. */
+	if (fz_is_empty_irect(&area) || (int64_t)(area.x1 - area.x0) * (area.y1 - area.y0) * 2 > (int64_t)image->w * image->h)
+	{
+		*subarea = whole;
+		return fz_image_get_pixmap(ctx, image, w, h);
+	}
+
+	/* A decoded whole image will do if we have one */
+	tile = find_image_tile(ctx, image, &whole, l2factor, 1);
+	if (tile)
+	{
+		*subarea = whole;
+		return tile;
+	}
+
+	tile = find_image_tile(ctx, image, &area, l2factor, 0);
+	if (tile)
+	{
+		*subarea = area;
+		*l2factorp = l2factor;
+		return tile;
+	}
+
+	/* Except for JPEG 2000, the rows above a part are decoded and thrown
+	 * away. Once that adds up to a whole image's worth, as it soon does
+	 * when a page is drawn in bands, decode the rest whole instead. */
+	if (image->buffer->params.type != FZ_IMAGE_JPX)
+	{
+		int spent;
+		fz_lock(ctx, FZ_LOCK_IMAGE);
+		image->part_rows += area.y1;
+		spent = image->part_rows > image->h;
+		fz_unlock(ctx, FZ_LOCK_IMAGE);
+		if (spent)
+		{
+			*subarea = whole;
+			return fz_image_get_pixmap(ctx, image, w, h);
+		}
+	}
+
+	*subarea = area;
+	*l2factorp = l2factor;
+	return decode_image_tile(ctx, image, &area, &area, l2factor);
+}
+
 fz_image *
 fz_new_image_from_pixmap(fz_context *ctx, fz_pixmap *pixmap, fz_image *mask)
 {
@@ -513,6 +897,11 @@ fz_new_image_from_buffer(fz_context *ctx, fz_buffer *buffer)
 			bc->params.type = FZ_IMAGE_JXR;
 			fz_load_jxr_info(ctx, buf, len, &w, &h, &xres, &yres, &cspace);
 		}
+		else if ((buf[0] == 0xff && buf[1] == 0x4f) || (len >= 12 && memcmp(buf, "\0\0\0\014jP  \r\n\207\n", 12) == 0))
+		{
+			bc->params.type = FZ_IMAGE_JPX;
+			fz_load_jpx_info(ctx, buf, len, &w, &h, &xres, &yres, &cspace);
+		}
 		else if (memcmp(buf, "MM", 2) == 0 || memcmp(buf, "II", 2) == 0)
 		{
 			bc->params.type = FZ_IMAGE_TIFF;
@@ -569,3 +958,44 @@ fz_image_get_sanitised_res(fz_image *image, int *xres, int *yres)
 		}
 	}
 }
+
+void
+fz_new_image_context(fz_context *ctx)
+{
+	ctx->image = fz_malloc_struct(ctx, fz_image_context);
+	ctx->image->refs = 1;
+}
+
+fz_image_context *
+fz_keep_image_context(fz_context *ctx)
+{
+	if (!ctx)
+		return NULL;
+	return fz_keep_imp(ctx, ctx->image, &ctx->image->refs);
+}
+
+void
+fz_drop_image_context(fz_context *ctx)
+{
+	if (!ctx)
+		return;
+	if (fz_drop_imp(ctx, ctx->image, &ctx->image->refs))
+		fz_free(ctx, ctx->image);
+}
+
+void
+fz_get_image_decode_stats(fz_context *ctx, fz_image_decode_stats *stats)
+{
+	fz_lock(ctx, FZ_LOCK_IMAGE);
+	*stats = ctx->image->stats;
+	fz_unlock(ctx, FZ_LOCK_IMAGE);
+}
+
+void
+fz_dump_image_decode_stats(fz_context *ctx)
+{
+	fz_image_decode_stats stats;
+
+	fz_get_image_decode_stats(ctx, &stats);
+	printf("Image Decodes: %d (%d waits for other threads, %d decodes saved)\n", stats.decodes, stats.waits, stats.saved);
+}
@@ -1,9 +1,11 @@
 #include "mupdf/fitz.h"
 
 typedef struct fz_display_node_s fz_display_node;
+typedef struct fz_display_run_s fz_display_run;
 typedef struct fz_list_device_s fz_list_device;
 
 #define STACK_SIZE 96
+#define RUN_NODES 32
 
 typedef enum fz_display_command_e
 {
@@ -108,12 +110,39 @@ enum {
 	CTM_CHANGE_EF = 4
 };
 
+/* To allow fast culling when a list is replayed through a small
+ * scissor (such as a tile or band), the writer splits the node stream
+ * into runs of about RUN_NODES nodes. At the start of each run the
+ * writer forgets its current state, so that every state entry used
+ * within the run is present in the run itself. A reader can therefore
+ * jump from the start of a run to its end without decoding the nodes
+ * in between.
+ *
+ * Runs that are balanced (every clip, mask or group they open is also
+ * closed within them, and they never close one opened before them),
+ * and that contain no page or tile nodes, are recorded in the list's
+ * run index together with the union of their node rectangles. On
+ * replay, any such run whose rectangle lies outside the scissor is
+ * skipped in one step; since all of its nodes would have been culled
+ * individually, the clip and group nesting is unaffected.
+ */
+struct fz_display_run_s
+{
+	int start;
+	int end;
+	int nodes;
+	fz_rect rect;
+};
+
 struct fz_display_list_s
 {
 	fz_storable storable;
 	fz_display_node *list;
 	int max;
 	int len;
+	fz_display_run *runs;
+	int runs_max;
+	int runs_len;
 };
 
 struct fz_list_device_s
@@ -136,13 +165,110 @@ struct fz_list_device_s
 		fz_rect rect;
 	} stack[STACK_SIZE];
 	int tiled;
+
+	int reset;
+	struct {
+		int start;
+		int nodes;
+		int depth;
+		int skippable;
+		fz_rect rect;
+	} run;
 };
 
 enum { ISOLATED = 1, KNOCKOUT = 2 };
 
+/* State entries that must be written out by the next node that uses
+ * them, regardless of their current value. */
+enum { RESET_RECT = 1, RESET_ALPHA = 2, RESET_CTM = 4 };
+
 #define SIZE_IN_NODES(t) \
 	((t + sizeof(fz_display_node) - 1) / sizeof(fz_display_node))
 
+static void
+fz_start_display_run(fz_context *ctx, fz_list_device *writer)
+{
+	writer->run.start = writer->list->len;
+	writer->run.nodes = 0;
+	writer->run.depth = 0;
+	writer->run.skippable = (writer->tiled == 0);
+	writer->run.rect = fz_empty_rect;
+
+	/* Forget our current state, so that all of it is written out
+	 * afresh within this run. */
+	fz_drop_path(ctx, writer->path);
+	writer->path = NULL;
+	fz_drop_stroke_state(ctx, writer->stroke);
+	writer->stroke = NULL;
+	fz_drop_colorspace(ctx, writer->colorspace);
+	writer->colorspace = NULL;
+	writer->reset = RESET_RECT | RESET_ALPHA | RESET_CTM;
+}
+
+static void
+fz_end_display_run(fz_context *ctx, fz_list_device *writer)
+{
+	fz_display_list *list = writer->list;
+	fz_display_run *run;
+
+	if (writer->run.nodes == 0 || !writer->run.skippable || writer->run.depth != 0)
+		return;
+
+	if (list->runs_len == list->runs_max)
+	{
+		int newsize = list->runs_max * 2;
+		if (newsize < 16)
+			newsize = 16;
+		list->runs = fz_resize_array(ctx, list->runs, newsize, sizeof(fz_display_run));
+		list->runs_max = newsize;
+	}
+	run = &list->runs[list->runs_len++];
+	run->start = writer->run.start;
+	run->end = list->len;
+	run->nodes = writer->run.nodes;
+	run->rect = writer->run.rect;
+}
+
+/* Track the clip/group nesting and extent of the nodes in the current
+ * run, mirroring the culling logic in fz_run_display_list. */
+static void
+fz_update_display_run(fz_list_device *writer, fz_display_command cmd, int flags, const fz_rect *rect)
+{
+	writer->run.nodes++;
+	switch (cmd)
+	{
+	case FZ_CMD_CLIP_TEXT:
+		if (flags == 2)
+			break;
+		/* fallthrough */
+	case FZ_CMD_CLIP_PATH:
+	case FZ_CMD_CLIP_STROKE_PATH:
+	case FZ_CMD_CLIP_STROKE_TEXT:
+	case FZ_CMD_CLIP_IMAGE_MASK:
+	case FZ_CMD_BEGIN_MASK:
+	case FZ_CMD_BEGIN_GROUP:
+		writer->run.depth++;
+		break;
+	case FZ_CMD_POP_CLIP:
+	case FZ_CMD_END_GROUP:
+		if (--writer->run.depth < 0)
+			writer->run.skippable = 0;
+		return;
+	case FZ_CMD_END_MASK:
+		return;
+	case FZ_CMD_BEGIN_PAGE:
+	case FZ_CMD_END_PAGE:
+	case FZ_CMD_BEGIN_TILE:
+	case FZ_CMD_END_TILE:
+		writer->run.skippable = 0;
+		return;
+	default:
+		break;
+	}
+	if (rect)
+		fz_union_rect(&writer->run.rect, rect);
+}
+
 static void
 fz_append_display_node(
 	fz_context *ctx,
@@ -176,6 +302,15 @@ fz_append_display_node(
 	fz_path *my_path = NULL;
 	fz_stroke_state *my_stroke = NULL;
 	fz_rect local_rect;
+	int barrier = (cmd == FZ_CMD_BEGIN_PAGE || cmd == FZ_CMD_END_PAGE || cmd == FZ_CMD_BEGIN_TILE || cmd == FZ_CMD_END_TILE);
+
+	/* Page and tile nodes are never culled, so keep them out of the
+	 * runs around them. */
+	if (barrier || writer->run.nodes >= RUN_NODES)
+	{
+		fz_end_display_run(ctx, writer);
+		fz_start_display_run(ctx, writer);
+	}
 
 	switch (cmd)
 	{
@@ -247,12 +382,14 @@ fz_append_display_node(
 		break;
 	}
 
+	fz_update_display_run(writer, cmd, flags, rect);
+
 	size = 1; /* 1 for the fz_display_node */
 	node.cmd = cmd;
 
 	/* Figure out what we need to write, and the offsets at which we will
 	 * write it. */
-	if (rect_for_updates || (rect != NULL && (writer->rect.x0 != rect->x0 || writer->rect.y0 != rect->y0 || writer->rect.x1 != rect->x1 || writer->rect.y1 != rect->y1)))
+	if (rect_for_updates || (rect != NULL && ((writer->reset & RESET_RECT) || writer->rect.x0 != rect->x0 || writer->rect.y0 != rect->y0 || writer->rect.x1 != rect->x1 || writer->rect.y1 != rect->y1)))
 	{
 		node.rect = 1;
 		rect_off = size;
@@ -423,7 +560,7 @@ fz_append_display_node(
 			size += n * SIZE_IN_NODES(sizeof(float));
 		}
 	}
-	if (alpha && (*alpha != writer->alpha))
+	if (alpha && ((writer->reset & RESET_ALPHA) || *alpha != writer->alpha))
 	{
 		if (*alpha >= 1.0)
 			node.alpha = ALPHA_1;
@@ -436,17 +573,17 @@ fz_append_display_node(
 			node.alpha = ALPHA_PRESENT;
 		}
 	}
-	if (ctm && (ctm->a != writer->ctm.a || ctm->b != writer->ctm.b || ctm->c != writer->ctm.c || ctm->d != writer->ctm.d || ctm->e != writer->ctm.e || ctm->f != writer->ctm.f))
+	if (ctm && ((writer->reset & RESET_CTM) || ctm->a != writer->ctm.a || ctm->b != writer->ctm.b || ctm->c != writer->ctm.c || ctm->d != writer->ctm.d || ctm->e != writer->ctm.e || ctm->f != writer->ctm.f))
 	{
 		int flags;
 
 		ctm_off = size;
 		flags = CTM_UNCHANGED;
-		if (ctm->a != writer->ctm.a || ctm->d != writer->ctm.d)
+		if ((writer->reset & RESET_CTM) || ctm->a != writer->ctm.a || ctm->d != writer->ctm.d)
 			flags = CTM_CHANGE_AD, size += SIZE_IN_NODES(2*sizeof(float));
-		if (ctm->b != writer->ctm.b || ctm->c != writer->ctm.c)
+		if ((writer->reset & RESET_CTM) || ctm->b != writer->ctm.b || ctm->c != writer->ctm.c)
 			flags |= CTM_CHANGE_BC, size += SIZE_IN_NODES(2*sizeof(float));
-		if (ctm->e != writer->ctm.e || ctm->f != writer->ctm.f)
+		if ((writer->reset & RESET_CTM) || ctm->e != writer->ctm.e || ctm->f != writer->ctm.f)
 			flags |= CTM_CHANGE_EF, size += SIZE_IN_NODES(2*sizeof(float));
 		node.ctm = flags;
 	}
@@ -487,6 +624,8 @@ fz_append_display_node(
 	if (path_off)
 		my_path = fz_keep_path(ctx, path);
 
+	fz_var(colorspace_off);
+
 	if (stroke_off)
 	{
 		fz_try(ctx)
@@ -510,6 +649,7 @@ fz_append_display_node(
 	{
 		fz_rect *out_rect = (fz_rect *)(void *)(&node_ptr[rect_off]);
 		writer->rect = *rect;
+		writer->reset &= ~RESET_RECT;
 		*out_rect = *rect;
 		if (rect_for_updates)
 			writer->stack[writer->top-1].update = out_rect;
@@ -582,6 +722,7 @@ fz_append_display_node(
 	if (node.alpha)
 	{
 		writer->alpha = *alpha;
+		writer->reset &= ~RESET_ALPHA;
 		if (alpha_off)
 		{
 			float *out_alpha = (float *)(void *)(&node_ptr[alpha_off]);
@@ -591,6 +732,7 @@ fz_append_display_node(
 	if (ctm_off)
 	{
 		float *out_ctm = (float *)(void *)(&node_ptr[ctm_off]);
+		writer->reset &= ~RESET_CTM;
 		if (node.ctm & CTM_CHANGE_AD)
 		{
 			writer->ctm.a = *out_ctm++ = ctm->a;
@@ -621,6 +763,9 @@ fz_append_display_node(
 		memcpy(out_private, private_data, private_data_len);
 	}
 	list->len += size;
+
+	if (barrier)
+		fz_start_display_run(ctx, writer);
 }
 
 static void
@@ -1206,6 +1351,16 @@ drop_writer(fz_context *ctx, fz_device *dev)
 {
 	fz_list_device *writer = (fz_list_device *)dev;
 
+	/* Close the final run. Failing to index it only costs speed. */
+	fz_try(ctx)
+	{
+		fz_end_display_run(ctx, writer);
+	}
+	fz_catch(ctx)
+	{
+		fz_warn(ctx, "cannot index display list run; continuing");
+	}
+
 	fz_drop_colorspace(ctx, writer->colorspace);
 	fz_drop_stroke_state(ctx, writer->stroke);
 	fz_drop_path(ctx, writer->path);
@@ -1258,6 +1413,7 @@ fz_new_list_device(fz_context *ctx, fz_display_list *list)
 	memset(dev->color, 0, sizeof(float)*FZ_MAX_COLORS);
 	dev->top = 0;
 	dev->tiled = 0;
+	fz_start_display_run(ctx, dev);
 
 	return &dev->super;
 }
@@ -1351,6 +1507,7 @@ fz_drop_display_list_imp(fz_context *ctx, fz_storable *list_)
 		node = next;
 	}
 	fz_free(ctx, list->list);
+	fz_free(ctx, list->runs);
 	fz_free(ctx, list);
 }
 
@@ -1362,6 +1519,9 @@ fz_new_display_list(fz_context *ctx)
 	list->list = NULL;
 	list->max = 0;
 	list->len = 0;
+	list->runs = NULL;
+	list->runs_max = 0;
+	list->runs_len = 0;
 	return list;
 }
 
@@ -1383,6 +1543,7 @@ fz_run_display_list(fz_context *ctx, fz_display_list *list, fz_device *dev, cons
 	fz_display_node *node;
 	fz_display_node *node_end;
 	fz_display_node *next_node;
+	fz_display_run *run, *run_end;
 	int clipped = 0;
 	int tiled = 0;
 	int progress = 0;
@@ -1402,6 +1563,7 @@ fz_run_display_list(fz_context *ctx, fz_display_list *list, fz_device *dev, cons
 	int tile_skip_depth = 0;
 
 	fz_var(colorspace);
+	fz_var(next_node);
 
 	if (!scissor)
 		scissor = &fz_infinite_rect;
@@ -1412,13 +1574,39 @@ fz_run_display_list(fz_context *ctx, fz_display_list *list, fz_device *dev, cons
 		cookie->progress = 0;
 	}
 
+	/* There is no point consulting the run index if nothing can be
+	 * culled. */
+	run = list->runs;
+	run_end = run + list->runs_len;
+	if (fz_is_infinite_rect(scissor))
+		run = run_end;
+
 	node = list->list;
 	node_end = &list->list[list->len];
 	for (; node != node_end ; node = next_node)
 	{
 		int empty;
-		fz_display_node n = *node;
+		fz_display_node n;
+
+		while (run != run_end && &list->list[run->start] < node)
+			run++;
+		if (run != run_end && &list->list[run->start] == node)
+		{
+			fz_rect run_rect = run->rect;
+			fz_transform_rect(&run_rect, top_ctm);
+			fz_intersect_rect(&run_rect, scissor);
+			if (fz_is_empty_rect(&run_rect))
+			{
+				/* The whole run is invisible; skip it. */
+				next_node = &list->list[run->end];
+				progress += run->nodes;
+				run++;
+				continue;
+			}
+			run++;
+		}
 
+		n = *node;
 		next_node = node + n.size;
 
 		/* Check the cookie for aborting */
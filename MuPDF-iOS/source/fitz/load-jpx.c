@@ -58,7 +58,8 @@ static OPJ_OFF_T fz_opj_stream_skip(OPJ_OFF_T skip, void * p_user_data)
 	if (skip > sb->size - sb->pos)
 		skip = sb->size - sb->pos;
 	sb->pos += skip;
-	return sb->pos;
+	/* The number of bytes skipped, not the new position */
+	return skip;
 }
 
 static OPJ_BOOL fz_opj_stream_seek(OPJ_OFF_T seek_pos, void * p_user_data)
@@ -71,20 +72,25 @@ static OPJ_BOOL fz_opj_stream_seek(OPJ_OFF_T seek_pos, void * p_user_data)
 	return OPJ_TRUE;
 }
 
-fz_pixmap *
-fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs, int indexed)
+/* opj_stream_destroy is deprecated, but opj_stream_destroy_v3 takes the
+ * user data to be a FILE and closes it. Ours is a stream_block on the
+ * stack, so take it off the stream first. */
+static void
+fz_opj_stream_destroy(opj_stream_t *stream)
+{
+	opj_stream_set_user_data(stream, NULL);
+	opj_stream_destroy_v3(stream);
+}
+
+/* Open a codec on the data and read the image header */
+static opj_image_t *
+jpx_read_header(fz_context *ctx, unsigned char *data, int size, int indexed, stream_block *sb, opj_codec_t **codecp, opj_stream_t **streamp)
 {
-	fz_pixmap *img;
 	opj_dparameters_t params;
 	opj_codec_t *codec;
 	opj_image_t *jpx;
 	opj_stream_t *stream;
-	fz_colorspace *colorspace;
-	unsigned char *p;
 	OPJ_CODEC_FORMAT format;
-	int a, n, w, h, depth, sgnd;
-	int x, y, k, v;
-	stream_block sb;
 
 	if (size < 2)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "not enough data to determine image format");
@@ -110,33 +116,115 @@ fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs
 	}
 
 	stream = opj_stream_default_create(OPJ_TRUE);
-	sb.data = data;
-	sb.pos = 0;
-	sb.size = size;
+	sb->data = data;
+	sb->pos = 0;
+	sb->size = size;
 
 	opj_stream_set_read_function(stream, fz_opj_stream_read);
 	opj_stream_set_skip_function(stream, fz_opj_stream_skip);
 	opj_stream_set_seek_function(stream, fz_opj_stream_seek);
-	opj_stream_set_user_data(stream, &sb);
+	opj_stream_set_user_data(stream, sb);
 	/* Set the length to avoid an assert */
 	opj_stream_set_user_data_length(stream, size);
 
 	if (!opj_read_header(stream, codec, &jpx))
 	{
-		opj_stream_destroy(stream);
+		fz_opj_stream_destroy(stream);
 		opj_destroy_codec(codec);
 		fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to read JPX header");
 	}
 
+	*codecp = codec;
+	*streamp = stream;
+	return jpx;
+}
+
+/* The number of color components and whether there is an alpha channel,
+ * as we will unpack them into a pixmap. */
+static int
+jpx_components(opj_image_t *jpx, int *a)
+{
+	int n = jpx->numcomps;
+	if (jpx->color_space == OPJ_CLRSPC_SRGB && n == 4) { n = 3; *a = 1; }
+	else if (jpx->color_space == OPJ_CLRSPC_SYCC && n == 4) { n = 3; *a = 1; }
+	else if (n == 2) { n = 1; *a = 1; }
+	else if (n > 4) { n = 4; *a = 1; }
+	else { *a = 0; }
+	return n;
+}
+
+static fz_colorspace *
+jpx_colorspace(fz_context *ctx, int n, int a)
+{
+	/* Images with 4 colors and alpha are converted to rgb */
+	if (a && n == 4)
+		n = 3;
+	switch (n)
+	{
+	case 1: return fz_device_gray(ctx);
+	case 3: return fz_device_rgb(ctx);
+	case 4: return fz_device_cmyk(ctx);
+	}
+	return NULL;
+}
+
+void
+fz_load_jpx_info(fz_context *ctx, unsigned char *data, int size, int *wp, int *hp, int *xresp, int *yresp, fz_colorspace **cspacep)
+{
+	opj_codec_t *codec;
+	opj_image_t *jpx;
+	opj_stream_t *stream;
+	stream_block sb;
+	int n, a;
+
+	jpx = jpx_read_header(ctx, data, size, 0, &sb, &codec, &stream);
+	fz_opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+
+	n = jpx_components(jpx, &a);
+	*wp = jpx->numcomps > 0 ? (int)jpx->comps[0].w : 0;
+	*hp = jpx->numcomps > 0 ? (int)jpx->comps[0].h : 0;
+	*xresp = 96;
+	*yresp = 96;
+	*cspacep = jpx_colorspace(ctx, n, a);
+	opj_image_destroy(jpx);
+}
+
+static fz_pixmap *
+jpx_read_image(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs, int indexed, const fz_irect *area)
+{
+	fz_pixmap *img;
+	opj_codec_t *codec;
+	opj_image_t *jpx;
+	opj_stream_t *stream;
+	fz_colorspace *colorspace;
+	unsigned char *p;
+	int a, n, w, h, depth, sgnd;
+	int x, y, k, v;
+	stream_block sb;
+
+	jpx = jpx_read_header(ctx, data, size, indexed, &sb, &codec, &stream);
+
+	/* Only the tiles and code blocks that cover the area are decoded */
+	if (area && !opj_set_decode_area(codec, jpx,
+		jpx->x0 + area->x0, jpx->y0 + area->y0,
+		jpx->x0 + area->x1, jpx->y0 + area->y1))
+	{
+		fz_opj_stream_destroy(stream);
+		opj_destroy_codec(codec);
+		opj_image_destroy(jpx);
+		fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to set JPX decode area");
+	}
+
 	if (!opj_decode(codec, stream, jpx))
 	{
-		opj_stream_destroy(stream);
+		fz_opj_stream_destroy(stream);
 		opj_destroy_codec(codec);
 		opj_image_destroy(jpx);
 		fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to decode JPX image");
 	}
 
-	opj_stream_destroy(stream);
+	fz_opj_stream_destroy(stream);
 	opj_destroy_codec(codec);
 
 	/* jpx should never be NULL here, but check anyway */
@@ -167,18 +255,12 @@ fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs
 		}
 	}
 
-	n = jpx->numcomps;
+	n = jpx_components(jpx, &a);
 	w = jpx->comps[0].w;
 	h = jpx->comps[0].h;
 	depth = jpx->comps[0].prec;
 	sgnd = jpx->comps[0].sgnd;
 
-	if (jpx->color_space == OPJ_CLRSPC_SRGB && n == 4) { n = 3; a = 1; }
-	else if (jpx->color_space == OPJ_CLRSPC_SYCC && n == 4) { n = 3; a = 1; }
-	else if (n == 2) { n = 1; a = 1; }
-	else if (n > 4) { n = 4; a = 1; }
-	else { a = 0; }
-
 	if (defcs)
 	{
 		if (defcs->n == n)
@@ -247,3 +329,15 @@ fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs
 
 	return img;
 }
+
+fz_pixmap *
+fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs, int indexed)
+{
+	return jpx_read_image(ctx, data, size, defcs, indexed, NULL);
+}
+
+fz_pixmap *
+fz_load_jpx_region(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs, int indexed, const fz_irect *area)
+{
+	return jpx_read_image(ctx, data, size, defcs, indexed, area);
+}
@@ -58,6 +58,10 @@ struct tiff
 	unsigned char *profile;
 	int profilesize;
 
+	/* strip data with the bits put in natural order */
+	unsigned char *reversed;
+	unsigned reversedlen;
+
 	/* decoded data */
 	fz_colorspace *colorspace;
 	unsigned char *samples;
@@ -335,6 +339,55 @@ fz_expand_tiff_colormap(fz_context *ctx, struct tiff *tiff)
 	tiff->samples = samples;
 }
 
+static fz_colorspace *
+fz_tiff_colorspace(fz_context *ctx, struct tiff *tiff)
+{
+	switch (tiff->photometric)
+	{
+	case 0: /* WhiteIsZero -- inverted */
+		return fz_device_gray(ctx);
+	case 1: /* BlackIsZero */
+		return fz_device_gray(ctx);
+	case 2: /* RGB */
+		return fz_device_rgb(ctx);
+	case 3: /* RGBPal */
+		return fz_device_rgb(ctx);
+	case 5: /* CMYK */
+		return fz_device_cmyk(ctx);
+	case 6: /* YCbCr */
+		/* it's probably a jpeg ... we let jpeg convert to rgb */
+		return fz_device_rgb(ctx);
+	default:
+		return NULL;
+	}
+}
+
+static void
+fz_tiff_resolution(struct tiff *tiff)
+{
+	switch (tiff->resolutionunit)
+	{
+	case 2:
+		/* no unit conversion needed */
+		break;
+	case 3:
+		tiff->xresolution = tiff->xresolution * 254 / 100;
+		tiff->yresolution = tiff->yresolution * 254 / 100;
+		break;
+	default:
+		tiff->xresolution = 96;
+		tiff->yresolution = 96;
+		break;
+	}
+
+	/* Note xres and yres could be 0 even if unit was set. If so default to 96dpi. */
+	if (tiff->xresolution == 0 || tiff->yresolution == 0)
+	{
+		tiff->xresolution = 96;
+		tiff->yresolution = 96;
+	}
+}
+
 static void
 fz_decode_tiff_strips(fz_context *ctx, struct tiff *tiff)
 {
@@ -369,52 +422,17 @@ fz_decode_tiff_strips(fz_context *ctx, struct tiff *tiff)
 
 	tiff->stride = (tiff->imagewidth * tiff->samplesperpixel * tiff->bitspersample + 7) / 8;
 
-	switch (tiff->photometric)
-	{
-	case 0: /* WhiteIsZero -- inverted */
-		tiff->colorspace = fz_device_gray(ctx);
-		break;
-	case 1: /* BlackIsZero */
-		tiff->colorspace = fz_device_gray(ctx);
-		break;
-	case 2: /* RGB */
-		tiff->colorspace = fz_device_rgb(ctx);
-		break;
-	case 3: /* RGBPal */
-		tiff->colorspace = fz_device_rgb(ctx);
-		break;
-	case 5: /* CMYK */
-		tiff->colorspace = fz_device_cmyk(ctx);
-		break;
-	case 6: /* YCbCr */
-		/* it's probably a jpeg ... we let jpeg convert to rgb */
-		tiff->colorspace = fz_device_rgb(ctx);
-		break;
-	default:
+	tiff->colorspace = fz_tiff_colorspace(ctx, tiff);
+	if (!tiff->colorspace)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "unknown photometric: %d", tiff->photometric);
-	}
 
-	switch (tiff->resolutionunit)
-	{
-	case 2:
-		/* no unit conversion needed */
-		break;
-	case 3:
-		tiff->xresolution = tiff->xresolution * 254 / 100;
-		tiff->yresolution = tiff->yresolution * 254 / 100;
-		break;
-	default:
-		tiff->xresolution = 96;
-		tiff->yresolution = 96;
-		break;
-	}
+	/* more samples than the colorspace and an alpha would overrun the pixmap */
+	if (tiff->samplesperpixel > (unsigned)tiff->colorspace->n + 1)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "too many samples per pixel: %d", tiff->samplesperpixel);
+	if (tiff->bitspersample != 1 && tiff->bitspersample != 2 && tiff->bitspersample != 4 && tiff->bitspersample != 8 && tiff->bitspersample != 16)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "unsupported bits per sample: %d", tiff->bitspersample);
 
-	/* Note xres and yres could be 0 even if unit was set. If so default to 96dpi. */
-	if (tiff->xresolution == 0 || tiff->yresolution == 0)
-	{
-		tiff->xresolution = 96;
-		tiff->yresolution = 96;
-	}
+	fz_tiff_resolution(tiff);
 
 	tiff->samples = fz_malloc_array(ctx, tiff->imagelength, tiff->stride);
 	memset(tiff->samples, 0x55, tiff->imagelength * tiff->stride);
@@ -434,10 +452,19 @@ fz_decode_tiff_strips(fz_context *ctx, struct tiff *tiff)
 		if (rp + rlen > tiff->ep)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "strip extends beyond the end of the file");
 
-		/* the bits are in un-natural order */
+		/* the bits are in un-natural order; reverse them in a copy, as
+		 * the file data may be shared with other threads */
 		if (tiff->fillorder == 2)
+		{
+			if (rlen > tiff->reversedlen)
+			{
+				tiff->reversed = fz_resize_array(ctx, tiff->reversed, rlen, 1);
+				tiff->reversedlen = rlen;
+			}
 			for (i = 0; i < rlen; i++)
-				rp[i] = bitrev[rp[i]];
+				tiff->reversed[i] = bitrev[rp[i]];
+			rp = tiff->reversed;
+		}
 
 		/* the strip decoders will close this */
 		stm = fz_open_memory(ctx, rp, rlen);
@@ -475,11 +502,6 @@ fz_decode_tiff_strips(fz_context *ctx, struct tiff *tiff)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "unknown TIFF compression: %d", tiff->compression);
 		}
 
-		/* scramble the bits back into original order */
-		if (tiff->fillorder == 2)
-			for (i = 0; i < rlen; i++)
-				rp[i] = bitrev[rp[i]];
-
 		wp += tiff->stride * tiff->rowsperstrip;
 		strip ++;
 	}
@@ -575,9 +597,11 @@ fz_read_tiff_tag_value(unsigned *p, struct tiff *tiff, unsigned type, unsigned o
 		switch (type)
 		{
 		case TRATIONAL:
-			*p = readlong(tiff);
-			*p = *p / readlong(tiff);
-			p ++;
+			{
+				unsigned num = readlong(tiff);
+				unsigned den = readlong(tiff);
+				*p++ = den ? num / den : 0;
+			}
 			break;
 		case TBYTE: *p++ = readbyte(tiff); break;
 		case TSHORT: *p++ = readshort(tiff); break;
@@ -587,6 +611,15 @@ fz_read_tiff_tag_value(unsigned *p, struct tiff *tiff, unsigned type, unsigned o
 	}
 }
 
+/* Whether the value of a tag is held in its IFD entry */
+static inline int
+fz_tiff_value_inline(unsigned type, unsigned count)
+{
+	return (type == TBYTE && count <= 4) ||
+		(type == TSHORT && count <= 2) ||
+		(type == TLONG && count <= 1);
+}
+
 static void
 fz_read_tiff_tag(fz_context *ctx, struct tiff *tiff, unsigned offset)
 {
@@ -601,9 +634,7 @@ fz_read_tiff_tag(fz_context *ctx, struct tiff *tiff, unsigned offset)
 	type = readshort(tiff);
 	count = readlong(tiff);
 
-	if ((type == TBYTE && count <= 4) ||
-			(type == TSHORT && count <= 2) ||
-			(type == TLONG && count <= 1))
+	if (fz_tiff_value_inline(type, count))
 		value = tiff->rp - tiff->bp;
 	else
 		value = readlong(tiff);
@@ -879,6 +910,7 @@ fz_load_tiff_subimage(fz_context *ctx, unsigned char *buf, int len, int subimage
 		if (tiff.stripbytecounts) fz_free(ctx, tiff.stripbytecounts);
 		if (tiff.samples) fz_free(ctx, tiff.samples);
 		if (tiff.profile) fz_free(ctx, tiff.profile);
+		if (tiff.reversed) fz_free(ctx, tiff.reversed);
 	}
 	fz_catch(ctx)
 	{
@@ -905,11 +937,13 @@ fz_load_tiff_info_subimage(fz_context *ctx, unsigned char *buf, int len, int *wp
 		fz_seek_ifd(ctx, &tiff, subimage);
 		fz_decode_tiff_ifd(ctx, &tiff);
 
+		fz_tiff_resolution(&tiff);
+
 		*wp = tiff.imagewidth;
 		*hp = tiff.imagelength;
-		*xresp = (tiff.xresolution ? tiff.xresolution : 96);
-		*yresp = (tiff.yresolution ? tiff.yresolution : 96);
-		*cspacep = tiff.colorspace;
+		*xresp = tiff.xresolution;
+		*yresp = tiff.yresolution;
+		*cspacep = fz_tiff_colorspace(ctx, &tiff);
 	}
 	fz_always(ctx)
 	{
@@ -957,3 +991,405 @@ fz_load_tiff_subimage_count(fz_context *ctx, unsigned char *buf, int len)
 
 	return subimage_count;
 }
+
+/*
+ * Multi-page files are read from a stream rather than from memory. The
+ * chain of IFDs is walked once, and each subimage is then extracted on
+ * its own: its IFD, the tag values it needs and its strips are copied
+ * into a small TIFF of its own, which decodes as any other.
+ */
+
+static inline unsigned
+fz_tiff_get_short(const unsigned char *p, unsigned order)
+{
+	if (order == TII)
+		return p[0] | p[1] << 8;
+	return p[0] << 8 | p[1];
+}
+
+static inline unsigned
+fz_tiff_get_long(const unsigned char *p, unsigned order)
+{
+	if (order == TII)
+		return p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24;
+	return (unsigned)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static inline void
+fz_tiff_put_short(unsigned char *p, unsigned order, unsigned v)
+{
+	if (order == TII)
+	{
+		p[0] = v;
+		p[1] = v >> 8;
+	}
+	else
+	{
+		p[0] = v >> 8;
+		p[1] = v;
+	}
+}
+
+static inline void
+fz_tiff_put_long(unsigned char *p, unsigned order, unsigned v)
+{
+	if (order == TII)
+	{
+		p[0] = v;
+		p[1] = v >> 8;
+		p[2] = v >> 16;
+		p[3] = v >> 24;
+	}
+	else
+	{
+		p[0] = v >> 24;
+		p[1] = v >> 16;
+		p[2] = v >> 8;
+		p[3] = v;
+	}
+}
+
+static void
+fz_read_tiff_stream(fz_context *ctx, fz_stream *stm, unsigned offset, unsigned char *p, int n)
+{
+	fz_seek(ctx, stm, offset, SEEK_SET);
+	if (fz_read(ctx, stm, p, n) != n)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "unexpected end of TIFF file");
+}
+
+/* Read the header of a TIFF file. Returns its byte order, and its
+ * length and the offset of its first IFD. */
+static unsigned
+fz_read_tiff_stream_header(fz_context *ctx, fz_stream *stm, unsigned *len, unsigned *ifd_offset)
+{
+	unsigned char head[8];
+	unsigned order;
+	fz_off_t end;
+
+	fz_seek(ctx, stm, 0, SEEK_END);
+	end = fz_tell(ctx, stm);
+	*len = end > UINT_MAX ? UINT_MAX : end;
+
+	fz_read_tiff_stream(ctx, stm, 0, head, 8);
+	order = head[0] << 8 | head[1];
+	if (order != TII && order != TMM)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "not a TIFF file, wrong magic marker");
+	if (fz_tiff_get_short(head + 2, order) != 42)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "not a TIFF file, wrong version marker");
+	*ifd_offset = fz_tiff_get_long(head + 4, order);
+	return order;
+}
+
+unsigned *
+fz_load_tiff_ifd_offsets(fz_context *ctx, fz_stream *stm, int *countp)
+{
+	unsigned char data[4];
+	unsigned *offsets = NULL;
+	fz_hash_table *seen = NULL;
+	unsigned order, len, offset, count;
+	int n = 0, cap = 0;
+
+	fz_var(offsets);
+	fz_var(seen);
+	fz_var(count);
+	fz_var(n);
+	fz_var(cap);
+
+	fz_try(ctx)
+	{
+		order = fz_read_tiff_stream_header(ctx, stm, &len, &offset);
+		seen = fz_new_hash_table(ctx, 256, sizeof offset, -1);
+		do
+		{
+			fz_try(ctx)
+			{
+				if (offset < 8 || len < 6 || offset > len - 6)
+					fz_throw(ctx, FZ_ERROR_GENERIC, "invalid IFD offset %u", offset);
+				if (fz_hash_find(ctx, seen, &offset))
+					fz_throw(ctx, FZ_ERROR_GENERIC, "IFD chain loops back to offset %u", offset);
+				fz_read_tiff_stream(ctx, stm, offset, data, 2);
+				count = fz_tiff_get_short(data, order);
+				if (count * 12 > len - offset - 6)
+					fz_throw(ctx, FZ_ERROR_GENERIC, "overlarge IFD entry count %u", count);
+			}
+			fz_catch(ctx)
+			{
+				/* Keep the subimages found so far */
+				if (n == 0)
+					fz_rethrow(ctx);
+				fz_warn(ctx, "%s; ignoring subimages from %d", fz_caught_message(ctx), n + 1);
+				break;
+			}
+
+			fz_hash_insert(ctx, seen, &offset, stm);
+			if (n == cap)
+			{
+				cap = cap ? cap * 2 : 64;
+				offsets = fz_resize_array(ctx, offsets, cap, sizeof *offsets);
+			}
+			offsets[n++] = offset;
+
+			fz_read_tiff_stream(ctx, stm, offset + 2 + count * 12, data, 4);
+			offset = fz_tiff_get_long(data, order);
+		}
+		while (offset != 0);
+	}
+	fz_always(ctx)
+	{
+		if (seen)
+			fz_drop_hash(ctx, seen);
+	}
+	fz_catch(ctx)
+	{
+		fz_free(ctx, offsets);
+		fz_rethrow_message(ctx, "error while counting subimages in tiff");
+	}
+
+	*countp = n;
+	return offsets;
+}
+
+/* Whether fz_read_tiff_tag uses the value of a tag */
+static int
+fz_tiff_tag_is_read(unsigned tag)
+{
+	switch (tag)
+	{
+	case NewSubfileType: case ImageWidth: case ImageLength:
+	case BitsPerSample: case Compression: case PhotometricInterpretation:
+	case FillOrder: case SamplesPerPixel: case RowsPerStrip:
+	case XResolution: case YResolution: case PlanarConfiguration:
+	case T4Options: case T6Options: case Predictor: case ResolutionUnit:
+	case YCbCrSubSampling: case ExtraSamples: case ICCProfile:
+	case JPEGTables: case StripOffsets: case StripByteCounts: case ColorMap:
+	case TileWidth: case TileLength: case TileOffsets: case TileByteCounts:
+		return 1;
+	}
+	return 0;
+}
+
+/* Read the values of an IFD entry as fz_read_tiff_tag_value does.
+ * Returns the number read, which is 0 if they are not in the file. */
+static unsigned
+fz_read_tiff_stream_values(fz_context *ctx, fz_stream *stm, unsigned order, unsigned len, const unsigned char *entry, unsigned **valuesp)
+{
+	static const unsigned char type_size[] = { 0, 1, 1, 2, 4, 8 };
+	unsigned type = fz_tiff_get_short(entry + 2, order);
+	unsigned count = fz_tiff_get_long(entry + 4, order);
+	unsigned offset = fz_tiff_get_long(entry + 8, order);
+	unsigned char *data = NULL;
+	const unsigned char *p;
+	unsigned *values;
+	unsigned i, size;
+
+	*valuesp = NULL;
+	if (type < TBYTE || type > TRATIONAL || type == TASCII || count == 0 || count > len / type_size[type])
+		return 0;
+	size = count * type_size[type];
+
+	if (fz_tiff_value_inline(type, count))
+		p = entry + 8;
+	else if (offset > len || size > len - offset)
+		return 0;
+	else
+	{
+		fz_var(type);
+		fz_var(count);
+		fz_var(data);
+
+		data = fz_malloc(ctx, size);
+		fz_try(ctx)
+			fz_read_tiff_stream(ctx, stm, offset, data, size);
+		fz_catch(ctx)
+		{
+			fz_free(ctx, data);
+			fz_rethrow(ctx);
+		}
+		p = data;
+	}
+
+	values = fz_malloc_array(ctx, count, sizeof(unsigned));
+	for (i = 0; i < count; i++)
+	{
+		switch (type)
+		{
+		case TBYTE: values[i] = p[i]; break;
+		case TSHORT: values[i] = fz_tiff_get_short(p + i * 2, order); break;
+		case TLONG: values[i] = fz_tiff_get_long(p + i * 4, order); break;
+		case TRATIONAL:
+			values[i] = fz_tiff_get_long(p + i * 8 + 4, order);
+			if (values[i])
+				values[i] = fz_tiff_get_long(p + i * 8, order) / values[i];
+			break;
+		}
+	}
+	fz_free(ctx, data);
+
+	*valuesp = values;
+	return count;
+}
+
+/* Append n bytes at offset of the file to a buffer */
+static void
+fz_copy_tiff_stream(fz_context *ctx, fz_buffer *buf, fz_stream *stm, unsigned offset, unsigned n)
+{
+	int len;
+
+	if (buf->len & 1)
+		fz_write_buffer_byte(ctx, buf, 0);
+	if (buf->len + n > (unsigned)buf->cap)
+		fz_resize_buffer(ctx, buf, buf->len + n);
+	fz_seek(ctx, stm, offset, SEEK_SET);
+	len = fz_read(ctx, stm, buf->data + buf->len, n);
+	if ((unsigned)len != n)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "unexpected end of TIFF file");
+	buf->len += len;
+}
+
+fz_buffer *
+fz_extract_tiff_subimage(fz_context *ctx, fz_stream *stm, unsigned ifd_offset)
+{
+	unsigned char head[8], data[2];
+	unsigned char *ifd = NULL, *entries = NULL, *entry;
+	unsigned *offsets = NULL, *counts = NULL;
+	unsigned char *strip_entry = NULL;
+	unsigned order, len, first, count, n, m, i;
+	unsigned tag, type, size, offset, noffsets, ncounts, bad;
+	fz_buffer *buf = NULL;
+
+	fz_var(ifd);
+	fz_var(entries);
+	fz_var(offsets);
+	fz_var(counts);
+	fz_var(buf);
+	fz_var(strip_entry);
+
+	fz_try(ctx)
+	{
+		order = fz_read_tiff_stream_header(ctx, stm, &len, &first);
+
+		if (ifd_offset < 8 || len < 6 || ifd_offset > len - 6)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "invalid IFD offset %u", ifd_offset);
+		fz_read_tiff_stream(ctx, stm, ifd_offset, data, 2);
+		n = fz_tiff_get_short(data, order);
+		if (n * 12 > len - ifd_offset - 2)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "overlarge IFD entry count %u", n);
+		ifd = fz_malloc(ctx, n * 12 + 1);
+		fz_read_tiff_stream(ctx, stm, ifd_offset + 2, ifd, n * 12);
+
+		/* Keep the entries of the tags that are read */
+		entries = fz_malloc(ctx, n * 12 + 1);
+		for (i = m = 0; i < n; i++)
+			if (fz_tiff_tag_is_read(fz_tiff_get_short(ifd + i * 12, order)))
+				memcpy(entries + m++ * 12, ifd + i * 12, 12);
+
+		/* Read the strip offsets and byte counts before the values move */
+		noffsets = ncounts = 0;
+		for (i = 0; i < m; i++)
+		{
+			entry = entries + i * 12;
+			tag = fz_tiff_get_short(entry, order);
+			if (tag == StripOffsets && !strip_entry)
+			{
+				strip_entry = entry;
+				noffsets = fz_read_tiff_stream_values(ctx, stm, order, len, entry, &offsets);
+			}
+			else if (tag == StripByteCounts && !counts)
+				ncounts = fz_read_tiff_stream_values(ctx, stm, order, len, entry, &counts);
+		}
+
+		/* The header and IFD, filled in at the end */
+		buf = fz_new_buffer(ctx, 8 + 2 + m * 12 + 4 + 1024);
+		memset(buf->data, 0, 8 + 2 + m * 12 + 4);
+		buf->len = 8 + 2 + m * 12 + 4;
+
+		/* Copy the values that are not held in the entries */
+		for (i = 0; i < m; i++)
+		{
+			entry = entries + i * 12;
+			tag = fz_tiff_get_short(entry, order);
+			type = fz_tiff_get_short(entry + 2, order);
+			count = fz_tiff_get_long(entry + 4, order);
+			offset = fz_tiff_get_long(entry + 8, order);
+
+			if (entry == strip_entry || fz_tiff_value_inline(type, count))
+				continue;
+
+			switch (type)
+			{
+			case TSHORT: size = 2; break;
+			case TLONG: size = 4; break;
+			case TRATIONAL: size = 8; break;
+			default: size = 1; break;
+			}
+			if (count > len / size || offset > len || count * size > len - offset)
+			{
+				/* Not in the file; leave it unread */
+				fz_tiff_put_long(entry + 4, order, 0);
+				continue;
+			}
+			fz_copy_tiff_stream(ctx, buf, stm, offset, count * size);
+			fz_tiff_put_long(entry + 8, order, buf->len - count * size);
+		}
+
+		/* Copy the strips, and rewrite their offsets as longs */
+		if (strip_entry)
+		{
+			bad = 0;
+			for (i = 0; i < noffsets; i++)
+			{
+				count = i < ncounts ? counts[i] : 0;
+				if (offsets[i] > len || count > len - offsets[i])
+				{
+					/* Point past the end, for the decoder to complain about */
+					offsets[i] = 0;
+					bad = 1;
+					continue;
+				}
+				fz_copy_tiff_stream(ctx, buf, stm, offsets[i], count);
+				offsets[i] = buf->len - count;
+			}
+			if (bad)
+				for (i = 0; i < noffsets; i++)
+					if (offsets[i] == 0)
+						offsets[i] = buf->len + 1;
+
+			fz_tiff_put_short(strip_entry + 2, order, TLONG);
+			fz_tiff_put_long(strip_entry + 4, order, noffsets);
+			if (noffsets == 1)
+				fz_tiff_put_long(strip_entry + 8, order, offsets[0]);
+			else
+			{
+				if (buf->len & 1)
+					fz_write_buffer_byte(ctx, buf, 0);
+				fz_tiff_put_long(strip_entry + 8, order, buf->len);
+				for (i = 0; i < noffsets; i++)
+				{
+					fz_tiff_put_long(head, order, offsets[i]);
+					fz_write_buffer(ctx, buf, head, 4);
+				}
+			}
+		}
+
+		/* Header, then the IFD with no next one */
+		buf->data[0] = buf->data[1] = (order == TII ? 'I' : 'M');
+		fz_tiff_put_short(buf->data + 2, order, 42);
+		fz_tiff_put_long(buf->data + 4, order, 8);
+		fz_tiff_put_short(buf->data + 8, order, m);
+		memcpy(buf->data + 10, entries, m * 12);
+	}
+	fz_always(ctx)
+	{
+		fz_free(ctx, ifd);
+		fz_free(ctx, entries);
+		fz_free(ctx, offsets);
+		fz_free(ctx, counts);
+	}
+	fz_catch(ctx)
+	{
+		fz_drop_buffer(ctx, buf);
+		fz_rethrow_message(ctx, "cannot read subimage of tiff");
+	}
+
+	return buf;
+}
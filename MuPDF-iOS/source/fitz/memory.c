@@ -6,24 +6,38 @@
 #undef FITZ_DEBUG_LOCKING_TIMES
 #endif
 
+static void flush_arena(fz_context *ctx, fz_alloc_arena *arena);
+
+/* The allocator is called without any lock held; FZ_LOCK_ALLOC is only
+ * taken when it fails and we have to scavenge the store. */
 static void *
 do_scavenging_malloc(fz_context *ctx, unsigned int size)
 {
 	void *p;
 	int phase = 0;
 
-	fz_lock(ctx, FZ_LOCK_ALLOC);
-	do {
+	p = ctx->alloc->malloc(ctx->alloc->user, size);
+	if (p != NULL)
+		return p;
+
+	if (ctx->arena)
+	{
+		flush_arena(ctx, ctx->arena);
 		p = ctx->alloc->malloc(ctx->alloc->user, size);
 		if (p != NULL)
-		{
-			fz_unlock(ctx, FZ_LOCK_ALLOC);
 			return p;
-		}
-	} while (fz_store_scavenge(ctx, size, &phase));
+	}
+
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	while (fz_store_scavenge(ctx, size, &phase))
+	{
+		p = ctx->alloc->malloc(ctx->alloc->user, size);
+		if (p != NULL)
+			break;
+	}
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
 
-	return NULL;
+	return p;
 }
 
 static void *
@@ -32,18 +46,28 @@ do_scavenging_realloc(fz_context *ctx, void *p, unsigned int size)
 	void *q;
 	int phase = 0;
 
-	fz_lock(ctx, FZ_LOCK_ALLOC);
-	do {
+	q = ctx->alloc->realloc(ctx->alloc->user, p, size);
+	if (q != NULL)
+		return q;
+
+	if (ctx->arena)
+	{
+		flush_arena(ctx, ctx->arena);
 		q = ctx->alloc->realloc(ctx->alloc->user, p, size);
 		if (q != NULL)
-		{
-			fz_unlock(ctx, FZ_LOCK_ALLOC);
 			return q;
-		}
-	} while (fz_store_scavenge(ctx, size, &phase));
+	}
+
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	while (fz_store_scavenge(ctx, size, &phase))
+	{
+		q = ctx->alloc->realloc(ctx->alloc->user, p, size);
+		if (q != NULL)
+			break;
+	}
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
 
-	return NULL;
+	return q;
 }
 
 void *
@@ -183,9 +207,162 @@ fz_resize_array_no_throw(fz_context *ctx, void *p, unsigned int count, unsigned
 void
 fz_free(fz_context *ctx, void *p)
 {
-	fz_lock(ctx, FZ_LOCK_ALLOC);
 	ctx->alloc->free(ctx->alloc->user, p);
-	fz_unlock(ctx, FZ_LOCK_ALLOC);
+}
+
+/* Small blocks freed with fz_free_small are kept on per-context free
+ * lists, one for each multiple of ARENA_GRAIN bytes, so the next
+ * fz_malloc_small of the same size in that context can reuse them
+ * without calling the allocator. The blocks themselves are ordinary
+ * allocations: objects routinely outlive the context (and thread)
+ * that created them, so any context may free any block. */
+
+enum
+{
+	ARENA_GRAIN = 16,
+	ARENA_CLASSES = 16,
+	ARENA_MAX_SIZE = ARENA_GRAIN * ARENA_CLASSES,
+	ARENA_CLASS_MAX = 256
+};
+
+struct fz_alloc_arena_s
+{
+	int enabled;
+	void *head[ARENA_CLASSES];
+	int count[ARENA_CLASSES];
+	fz_alloc_arena_stats stats;
+};
+
+static void
+flush_arena(fz_context *ctx, fz_alloc_arena *arena)
+{
+	int i;
+
+	for (i = 0; i < ARENA_CLASSES; i++)
+	{
+		while (arena->head[i])
+		{
+			void *p = arena->head[i];
+			arena->head[i] = *(void **)p;
+			ctx->alloc->free(ctx->alloc->user, p);
+		}
+		arena->count[i] = 0;
+	}
+}
+
+void
+fz_new_alloc_arena(fz_context *ctx)
+{
+	ctx->arena = fz_malloc_no_throw(ctx, sizeof(fz_alloc_arena));
+	if (ctx->arena)
+	{
+		memset(ctx->arena, 0, sizeof(fz_alloc_arena));
+		ctx->arena->enabled = 1;
+	}
+}
+
+void
+fz_copy_alloc_arena(fz_context *dst, fz_context *src)
+{
+	if (dst->arena && src->arena)
+		dst->arena->enabled = src->arena->enabled;
+}
+
+void
+fz_drop_alloc_arena(fz_context *ctx)
+{
+	fz_alloc_arena *arena = ctx->arena;
+
+	if (!arena)
+		return;
+	flush_arena(ctx, arena);
+	ctx->arena = NULL;
+	ctx->alloc->free(ctx->alloc->user, arena);
+}
+
+void
+fz_set_alloc_arena(fz_context *ctx, int enable)
+{
+	if (!ctx->arena)
+		return;
+	ctx->arena->enabled = enable;
+	if (!enable)
+		flush_arena(ctx, ctx->arena);
+}
+
+void *
+fz_malloc_small(fz_context *ctx, unsigned int size)
+{
+#ifndef MEMENTO
+	fz_alloc_arena *arena = ctx->arena;
+
+	if (size > 0 && size <= ARENA_MAX_SIZE)
+	{
+		/* Always round up, as the block may end up on any context's list */
+		int i = (size - 1) / ARENA_GRAIN;
+		if (arena && arena->enabled)
+		{
+			void *p = arena->head[i];
+			if (p)
+			{
+				arena->head[i] = *(void **)p;
+				arena->count[i]--;
+				arena->stats.hits++;
+				return p;
+			}
+			arena->stats.misses++;
+		}
+		return fz_malloc(ctx, (i + 1) * ARENA_GRAIN);
+	}
+#endif
+	return fz_malloc(ctx, size);
+}
+
+void
+fz_free_small(fz_context *ctx, void *p, unsigned int size)
+{
+#ifndef MEMENTO
+	fz_alloc_arena *arena = ctx->arena;
+
+	if (p && size > 0 && size <= ARENA_MAX_SIZE)
+	{
+		int i = (size - 1) / ARENA_GRAIN;
+		if (arena && arena->enabled && arena->count[i] < ARENA_CLASS_MAX)
+		{
+			*(void **)p = arena->head[i];
+			arena->head[i] = p;
+			arena->count[i]++;
+			arena->stats.kept++;
+			return;
+		}
+		if (arena)
+			arena->stats.released++;
+	}
+#endif
+	fz_free(ctx, p);
+}
+
+void
+fz_get_alloc_arena_stats(fz_context *ctx, fz_alloc_arena_stats *stats)
+{
+	if (ctx->arena)
+		*stats = ctx->arena->stats;
+	else
+		memset(stats, 0, sizeof *stats);
+}
+
+void
+fz_dump_alloc_arena_stats(fz_context *ctx)
+{
+	fz_alloc_arena_stats stats;
+	int i, cached = 0;
+
+	fz_get_alloc_arena_stats(ctx, &stats);
+	if (ctx->arena)
+		for (i = 0; i < ARENA_CLASSES; i++)
+			cached += ctx->arena->count[i];
+	printf("Alloc Arena Hits: %d (%d misses)\n", stats.hits, stats.misses);
+	printf("Alloc Arena Frees: %d kept (%d released, %d blocks cached)\n", stats.kept, stats.released, cached);
 }
 
 char *
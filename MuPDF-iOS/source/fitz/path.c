@@ -20,9 +20,19 @@ fz_new_path(fz_context *ctx)
 fz_path *
 fz_keep_path(fz_context *ctx, fz_path *path)
 {
-	if (path->refs == 1)
+	int trim;
+
+	/* Paths in a display list are kept by every thread that runs it, so
+	 * look at refs under the lock. A path is only trimmed while it has
+	 * one owner, so the paths of a list are trimmed as it is built. */
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	trim = (path->refs == 1);
+	if (path->refs > 0)
+		++path->refs;
+	fz_unlock(ctx, FZ_LOCK_ALLOC);
+	if (trim)
 		fz_trim_path(ctx, path);
-	return fz_keep_imp(ctx, path, &path->refs);
+	return path;
 }
 
 void
@@ -54,17 +54,17 @@ static void fmtfloat(struct fmtbuf *out, float f)
 	}
 }
 
-static void fmtint(struct fmtbuf *out, int value, int z, int base)
+static void fmtint(struct fmtbuf *out, int64_t value, int z, int base)
 {
 	static const char *digits = "0123456789abcdef";
-	char buf[40];
-	unsigned int a;
+	char buf[80];
+	uint64_t a;
 	int i;
 
 	if (value < 0)
 	{
 		fmtputc(out, '-');
-		a = -value;
+		a = -(uint64_t)value;
 	}
 	else
 		a = value;
@@ -116,7 +116,8 @@ fz_vsnprintf(char *buffer, int space, const char *fmt, va_list args)
 	fz_matrix *m;
 	fz_rect *r;
 	fz_point *p;
-	int c, i, n, z;
+	int c, i, n, z, length;
+	int64_t v;
 	double f;
 	char *s;
 
@@ -132,9 +133,27 @@ fz_vsnprintf(char *buffer, int space, const char *fmt, va_list args)
 				break;
 			z = 1;
 			if (c == '0' && fmt[0] && fmt[1]) {
-				z = *fmt++ - '0';
+				z = 0;
+				while (*fmt >= '0' && *fmt <= '9' && fmt[1])
+					z = z * 10 + *fmt++ - '0';
 				c = *fmt++;
 			}
+			/* Integer length modifiers: l, ll and I64 */
+			length = 0;
+			if (c == 'l') {
+				length = 1;
+				c = *fmt++;
+				if (c == 'l') {
+					length = 2;
+					c = *fmt++;
+				}
+			} else if (c == 'I' && fmt[0] == '6' && fmt[1] == '4') {
+				length = 2;
+				fmt += 2;
+				c = *fmt++;
+			}
+			if (c == 0)
+				break;
 			switch (c) {
 			default:
 				fmtputc(&out, '%');
@@ -185,16 +204,15 @@ fz_vsnprintf(char *buffer, int space, const char *fmt, va_list args)
 				fmtfloat(&out, f);
 				break;
 			case 'x':
-				i = va_arg(args, int);
-				fmtint(&out, i, z, 16);
-				break;
 			case 'd':
-				i = va_arg(args, int);
-				fmtint(&out, i, z, 10);
-				break;
 			case 'o':
-				i = va_arg(args, int);
-				fmtint(&out, i, z, 8);
+				if (length == 2)
+					v = va_arg(args, int64_t);
+				else if (length == 1)
+					v = va_arg(args, long);
+				else
+					v = va_arg(args, int);
+				fmtint(&out, v, z, c == 'x' ? 16 : c == 'o' ? 8 : 10);
 				break;
 			case 's':
 				s = va_arg(args, char*);
@@ -0,0 +1,688 @@
+#include "mupdf/fitz.h"
+#include "ucdn.h"
+
+/*
+	A search index being built holds a hash table from each term (NUL
+	padded to FZ_SEARCH_INDEX_TERM_MAX bytes) to its postings: the page,
+	word number, character offset and character length of each place
+	it occurs.
+
+	Written out, an index is:
+
+		"MUSI", a version byte, the 16 byte file identifier,
+		the number of pages and the number of terms,
+		then for each term, in byte order:
+			the number of bytes shared with the previous term,
+			the number of bytes that follow, and those bytes,
+			the number of postings, and their size in bytes,
+			then for each posting, in page and word order:
+				the page number less that of the last posting,
+				the word number and offset (less those of the
+				last posting if on the same page),
+				the length.
+
+	All numbers are unsigned LEB128 varints. A loaded index keeps this
+	as it is, and a lookup scans the terms for the ones it wants,
+	skipping the postings of the others.
+*/
+
+#define SEARCH_INDEX_VERSION 1
+#define FOLD_MAX 64
+
+typedef struct search_term_s search_term;
+
+struct search_term_s
+{
+	int len, cap;
+	int *postings; /* page, word, offset, length */
+};
+
+struct fz_search_index_s
+{
+	unsigned char id[16];
+	int pages;
+	fz_hash_table *terms;
+
+	/* A loaded index */
+	fz_buffer *buf;
+	unsigned char *dict, *end;
+	int term_count;
+};
+
+/* Part of a word: 1 for letters and digits, 0 for marks, which are
+ * dropped, -1 for anything else */
+static int
+word_class(int c)
+{
+	if (c < 0 || c > 0x10FFFF)
+		return -1;
+	switch (ucdn_get_general_category(c))
+	{
+	case UCDN_GENERAL_CATEGORY_LL:
+	case UCDN_GENERAL_CATEGORY_LM:
+	case UCDN_GENERAL_CATEGORY_LO:
+	case UCDN_GENERAL_CATEGORY_LT:
+	case UCDN_GENERAL_CATEGORY_LU:
+	case UCDN_GENERAL_CATEGORY_ND:
+	case UCDN_GENERAL_CATEGORY_NL:
+	case UCDN_GENERAL_CATEGORY_NO:
+		return 1;
+	case UCDN_GENERAL_CATEGORY_MC:
+	case UCDN_GENERAL_CATEGORY_ME:
+	case UCDN_GENERAL_CATEGORY_MN:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/* Fold a character of a word into out: accents are dropped, ligatures
+ * and other compatibility forms spelled out, and ASCII made lower case.
+ * Returns the new count of characters in out. */
+static int
+fold_rune(int c, int *out, int n)
+{
+	unsigned int d[18];
+	int i, k;
+
+	if (word_class(c) != 1)
+		return n;
+	k = ucdn_compat_decompose(c, d);
+	if (k == 0)
+	{
+		if (n < FOLD_MAX)
+			out[n++] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+		return n;
+	}
+	for (i = 0; i < k; i++)
+		n = fold_rune(d[i], out, n);
+	return n;
+}
+
+/* Append the folded form of c to a NUL padded term of len bytes, as far
+ * as whole characters fit. Returns the new length. */
+static int
+append_term(char *term, int len, int c)
+{
+	int fold[FOLD_MAX];
+	int i, n;
+
+	n = fold_rune(c, fold, 0);
+	for (i = 0; i < n; i++)
+	{
+		if (len + fz_runelen(fold[i]) >= FZ_SEARCH_INDEX_TERM_MAX)
+			break;
+		len += fz_runetochar(term + len, fold[i]);
+	}
+	return len;
+}
+
+static void
+add_posting(fz_context *ctx, fz_search_index *index, const char *key, int page, int word, int offset, int len)
+{
+	search_term *term = fz_hash_find(ctx, index->terms, key);
+
+	if (!term)
+	{
+		term = fz_malloc_struct(ctx, search_term);
+		fz_try(ctx)
+			fz_hash_insert(ctx, index->terms, key, term);
+		fz_catch(ctx)
+		{
+			fz_free(ctx, term);
+			fz_rethrow(ctx);
+		}
+	}
+	if (term->len + 4 > term->cap)
+	{
+		int newcap = term->cap ? term->cap * 2 : 16;
+		term->postings = fz_resize_array(ctx, term->postings, newcap, sizeof(int));
+		term->cap = newcap;
+	}
+	term->postings[term->len++] = page;
+	term->postings[term->len++] = word;
+	term->postings[term->len++] = offset;
+	term->postings[term->len++] = len;
+}
+
+static void
+md5_part(fz_context *ctx, fz_md5 *md5, fz_stream *stm, fz_off_t ofs, int len)
+{
+	unsigned char data[4096];
+	int n;
+
+	fz_seek(ctx, stm, ofs, SEEK_SET);
+	while (len > 0)
+	{
+		n = fz_read(ctx, stm, data, fz_mini(len, sizeof data));
+		if (n == 0)
+			break;
+		fz_md5_update(md5, data, n);
+		len -= n;
+	}
+}
+
+void
+fz_search_index_file_id(fz_context *ctx, fz_stream *stm, unsigned char id[16])
+{
+	enum { PART = 65536 };
+	unsigned char lenbytes[8];
+	fz_md5 md5;
+	fz_off_t len;
+	int i;
+
+	fz_seek(ctx, stm, 0, SEEK_END);
+	len = fz_tell(ctx, stm);
+	for (i = 0; i < 8; i++)
+		lenbytes[i] = (unsigned char)(len >> (i * 8));
+
+	fz_md5_init(&md5);
+	fz_md5_update(&md5, lenbytes, 8);
+	md5_part(ctx, &md5, stm, 0, len < PART ? (int)len : PART);
+	if (len > PART)
+		md5_part(ctx, &md5, stm, len - PART < PART ? PART : len - PART, PART);
+	fz_md5_final(&md5, id);
+}
+
+fz_search_index *
+fz_new_search_index(fz_context *ctx, const unsigned char id[16])
+{
+	fz_search_index *index = fz_malloc_struct(ctx, fz_search_index);
+
+	fz_try(ctx)
+		index->terms = fz_new_hash_table(ctx, 4096, FZ_SEARCH_INDEX_TERM_MAX, -1);
+	fz_catch(ctx)
+	{
+		fz_free(ctx, index);
+		fz_rethrow(ctx);
+	}
+	memcpy(index->id, id, 16);
+	return index;
+}
+
+void
+fz_drop_search_index(fz_context *ctx, fz_search_index *index)
+{
+	int i, n;
+
+	if (index == NULL)
+		return;
+	if (index->terms)
+	{
+		n = fz_hash_len(ctx, index->terms);
+		for (i = 0; i < n; i++)
+		{
+			search_term *term = fz_hash_get_val(ctx, index->terms, i);
+			if (term)
+			{
+				fz_free(ctx, term->postings);
+				fz_free(ctx, term);
+			}
+		}
+		fz_drop_hash(ctx, index->terms);
+	}
+	fz_drop_buffer(ctx, index->buf);
+	fz_free(ctx, index);
+}
+
+void
+fz_search_index_add_page(fz_context *ctx, fz_search_index *index, int number, fz_text_page *page)
+{
+	char key[FZ_SEARCH_INDEX_TERM_MAX];
+	int block_num, i, wc;
+	int ofs = 0, word = 0, start = -1, len = 0;
+
+	if (!index->terms)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot add pages to a loaded search index");
+
+	/* Count characters as fz_text_char_at does */
+	for (block_num = 0; block_num < page->len; block_num++)
+	{
+		fz_text_block *block;
+		fz_text_line *line;
+		fz_text_span *span;
+
+		if (page->blocks[block_num].type != FZ_PAGE_BLOCK_TEXT)
+			continue;
+		block = page->blocks[block_num].u.text;
+		for (line = block->lines; line < block->lines + block->len; line++)
+		{
+			for (span = line->first_span; span; span = span->next)
+			{
+				for (i = 0; i < span->len; i++, ofs++)
+				{
+					wc = word_class(span->text[i].c);
+					if (wc >= 0)
+					{
+						if (start < 0)
+						{
+							memset(key, 0, sizeof key);
+							start = ofs;
+							len = 0;
+						}
+						len = append_term(key, len, span->text[i].c);
+					}
+					else if (start >= 0)
+					{
+						if (len > 0)
+							add_posting(ctx, index, key, number, word++, start, ofs - start);
+						start = -1;
+					}
+				}
+			}
+
+			/* pseudo-newline */
+			if (start >= 0 && len > 0)
+				add_posting(ctx, index, key, number, word++, start, ofs - start);
+			start = -1;
+			ofs++;
+		}
+	}
+
+	index->pages++;
+}
+
+int
+fz_count_search_index_pages(fz_context *ctx, fz_search_index *index)
+{
+	return index->pages;
+}
+
+static void
+write_varint(fz_context *ctx, fz_buffer *buf, unsigned int v)
+{
+	while (v >= 0x80)
+	{
+		fz_write_buffer_byte(ctx, buf, (v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	fz_write_buffer_byte(ctx, buf, v);
+}
+
+static int
+read_varint(fz_context *ctx, unsigned char **pp, unsigned char *end)
+{
+	unsigned char *p = *pp;
+	unsigned int v = 0;
+	int shift = 0;
+
+	do
+	{
+		if (p >= end || shift > 28)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+		v |= (unsigned int)(*p & 0x7f) << shift;
+		shift += 7;
+	}
+	while (*p++ & 0x80);
+
+	if (v > INT_MAX)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+	*pp = p;
+	return v;
+}
+
+static int
+cmp_term_key(const void *a_, const void *b_)
+{
+	const char *a = *(const char **)a_;
+	const char *b = *(const char **)b_;
+	return memcmp(a, b, FZ_SEARCH_INDEX_TERM_MAX);
+}
+
+static int
+cmp_posting(const void *a_, const void *b_)
+{
+	const int *a = a_;
+	const int *b = b_;
+	if (a[0] != b[0])
+		return a[0] < b[0] ? -1 : 1;
+	return a[1] < b[1] ? -1 : a[1] > b[1];
+}
+
+static void
+encode_postings(fz_context *ctx, fz_buffer *buf, search_term *term)
+{
+	int *p, *end = term->postings + term->len;
+	int page = 0, word = 0, offset = 0;
+
+	qsort(term->postings, term->len / 4, 4 * sizeof(int), cmp_posting);
+	for (p = term->postings; p < end; p += 4)
+	{
+		write_varint(ctx, buf, p[0] - page);
+		if (p[0] == page)
+		{
+			write_varint(ctx, buf, p[1] - word);
+			write_varint(ctx, buf, p[2] - offset);
+		}
+		else
+		{
+			write_varint(ctx, buf, p[1]);
+			write_varint(ctx, buf, p[2]);
+		}
+		write_varint(ctx, buf, p[3]);
+		page = p[0];
+		word = p[1];
+		offset = p[2];
+	}
+}
+
+static int *
+decode_postings(fz_context *ctx, unsigned char *p, unsigned char *end, int count)
+{
+	int *postings = fz_malloc_array(ctx, count, 4 * sizeof(int));
+	int page = 0, word = 0, offset = 0;
+	int i, delta;
+
+	fz_try(ctx)
+	{
+		for (i = 0; i < count; i++)
+		{
+			delta = read_varint(ctx, &p, end);
+			page += delta;
+			if (delta == 0)
+			{
+				word += read_varint(ctx, &p, end);
+				offset += read_varint(ctx, &p, end);
+			}
+			else
+			{
+				word = read_varint(ctx, &p, end);
+				offset = read_varint(ctx, &p, end);
+			}
+			postings[i * 4 + 0] = page;
+			postings[i * 4 + 1] = word;
+			postings[i * 4 + 2] = offset;
+			postings[i * 4 + 3] = read_varint(ctx, &p, end);
+		}
+	}
+	fz_catch(ctx)
+	{
+		fz_free(ctx, postings);
+		fz_rethrow(ctx);
+	}
+	return postings;
+}
+
+void
+fz_write_search_index(fz_context *ctx, fz_output *out, fz_search_index *index)
+{
+	fz_buffer *buf = NULL;
+	fz_buffer *postings = NULL;
+	char **keys = NULL;
+	const char *last = "";
+	int i, n, shared;
+
+	if (!index->terms)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot write a loaded search index");
+
+	fz_var(buf);
+	fz_var(postings);
+	fz_var(keys);
+	fz_var(last);
+
+	fz_try(ctx)
+	{
+		n = fz_hash_len(ctx, index->terms);
+		keys = fz_malloc_array(ctx, n, sizeof(char *));
+		index->term_count = 0;
+		for (i = 0; i < n; i++)
+			if (fz_hash_get_val(ctx, index->terms, i))
+				keys[index->term_count++] = fz_hash_get_key(ctx, index->terms, i);
+		qsort(keys, index->term_count, sizeof(char *), cmp_term_key);
+
+		buf = fz_new_buffer(ctx, 65536);
+		postings = fz_new_buffer(ctx, 1024);
+		fz_write_buffer(ctx, buf, "MUSI", 4);
+		fz_write_buffer_byte(ctx, buf, SEARCH_INDEX_VERSION);
+		fz_write_buffer(ctx, buf, index->id, 16);
+		write_varint(ctx, buf, index->pages);
+		write_varint(ctx, buf, index->term_count);
+
+		for (i = 0; i < index->term_count; i++)
+		{
+			search_term *term = fz_hash_find(ctx, index->terms, keys[i]);
+			int len = strlen(keys[i]);
+
+			for (shared = 0; keys[i][shared] && keys[i][shared] == last[shared]; shared++)
+				;
+			write_varint(ctx, buf, shared);
+			write_varint(ctx, buf, len - shared);
+			fz_write_buffer(ctx, buf, keys[i] + shared, len - shared);
+
+			postings->len = 0;
+			encode_postings(ctx, postings, term);
+			write_varint(ctx, buf, term->len / 4);
+			write_varint(ctx, buf, postings->len);
+			fz_write_buffer(ctx, buf, postings->data, postings->len);
+			last = keys[i];
+		}
+
+		fz_write(ctx, out, buf->data, buf->len);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_buffer(ctx, postings);
+		fz_drop_buffer(ctx, buf);
+		fz_free(ctx, keys);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
+}
+
+/* Walk the dictionary once, so that a damaged (say, truncated) index
+ * is found when it is loaded rather than by some later search. */
+static void
+check_terms(fz_context *ctx, unsigned char *p, unsigned char *end, int term_count)
+{
+	int i, shared, len, size;
+
+	for (i = 0; i < term_count; i++)
+	{
+		shared = read_varint(ctx, &p, end);
+		len = read_varint(ctx, &p, end);
+		if (shared + len >= FZ_SEARCH_INDEX_TERM_MAX || len > end - p)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+		p += len;
+		read_varint(ctx, &p, end);
+		size = read_varint(ctx, &p, end);
+		if (size > end - p)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+		p += size;
+	}
+	if (p != end)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+}
+
+fz_search_index *
+fz_load_search_index(fz_context *ctx, fz_buffer *buf, const unsigned char id[16])
+{
+	fz_search_index *index;
+	unsigned char *p = buf->data;
+	unsigned char *end = buf->data + buf->len;
+
+	if (buf->len < 21 || memcmp(p, "MUSI", 4) || p[4] != SEARCH_INDEX_VERSION || memcmp(p + 5, id, 16))
+		return NULL;
+	p += 21;
+
+	index = fz_malloc_struct(ctx, fz_search_index);
+	fz_try(ctx)
+	{
+		index->pages = read_varint(ctx, &p, end);
+		index->term_count = read_varint(ctx, &p, end);
+		check_terms(ctx, p, end, index->term_count);
+	}
+	fz_catch(ctx)
+	{
+		fz_free(ctx, index);
+		fz_rethrow(ctx);
+	}
+	memcpy(index->id, id, 16);
+	index->buf = fz_keep_buffer(ctx, buf);
+	index->dict = p;
+	index->end = end;
+	return index;
+}
+
+/* Find the postings of a term, sorted by page and word. Returns a new
+ * array, or NULL if the term is not in the index. */
+static int *
+find_postings(fz_context *ctx, fz_search_index *index, const char *key, int *count)
+{
+	char term[FZ_SEARCH_INDEX_TERM_MAX];
+	unsigned char *p, *end = index->end;
+	int i, shared, len, size, cmp;
+
+	*count = 0;
+
+	if (index->terms)
+	{
+		search_term *st = fz_hash_find(ctx, index->terms, key);
+		int *postings;
+		if (!st)
+			return NULL;
+		qsort(st->postings, st->len / 4, 4 * sizeof(int), cmp_posting);
+		postings = fz_malloc_array(ctx, st->len, sizeof(int));
+		memcpy(postings, st->postings, st->len * sizeof(int));
+		*count = st->len / 4;
+		return postings;
+	}
+
+	memset(term, 0, sizeof term);
+	p = index->dict;
+	for (i = 0; i < index->term_count; i++)
+	{
+		shared = read_varint(ctx, &p, end);
+		len = read_varint(ctx, &p, end);
+		if (shared + len >= FZ_SEARCH_INDEX_TERM_MAX || len > end - p)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+		memcpy(term + shared, p, len);
+		memset(term + shared + len, 0, FZ_SEARCH_INDEX_TERM_MAX - shared - len);
+		p += len;
+		*count = read_varint(ctx, &p, end);
+		size = read_varint(ctx, &p, end);
+		if (size > end - p)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "damaged search index");
+
+		cmp = memcmp(term, key, FZ_SEARCH_INDEX_TERM_MAX);
+		if (cmp == 0)
+			return decode_postings(ctx, p, p + size, *count);
+		if (cmp > 0)
+			break;
+		p += size;
+	}
+
+	*count = 0;
+	return NULL;
+}
+
+/* Split a phrase into terms as pages are, storing them one after another
+ * in keys (if not NULL). Returns the number of terms. */
+static int
+split_phrase(const char *phrase, char *keys)
+{
+	char scratch[FZ_SEARCH_INDEX_TERM_MAX];
+	char *key = scratch;
+	int n = 0;
+	int len = -1;
+	int c;
+
+	while (*phrase)
+	{
+		phrase += fz_chartorune(&c, phrase);
+		if (word_class(c) >= 0)
+		{
+			if (len < 0)
+			{
+				key = keys ? keys + n * FZ_SEARCH_INDEX_TERM_MAX : scratch;
+				memset(key, 0, FZ_SEARCH_INDEX_TERM_MAX);
+				len = 0;
+			}
+			len = append_term(key, len, c);
+		}
+		else if (len >= 0)
+		{
+			n += len > 0;
+			len = -1;
+		}
+	}
+	if (len > 0)
+		n++;
+	return n;
+}
+
+int
+fz_search_index_lookup(fz_context *ctx, fz_search_index *index, const char *phrase, fz_search_hit *hits, int hit_max)
+{
+	char *keys = NULL;
+	int *found = NULL;
+	int *next = NULL;
+	int i, j, k, n, count, next_count, hit_count, c;
+
+	n = split_phrase(phrase, NULL);
+	if (n == 0)
+		return 0;
+
+	fz_var(keys);
+	fz_var(found);
+	fz_var(next);
+
+	hit_count = 0;
+	fz_try(ctx)
+	{
+		keys = fz_malloc_array(ctx, n, FZ_SEARCH_INDEX_TERM_MAX);
+		split_phrase(phrase, keys);
+
+		/* Start with every place the first word occurs, and keep those
+		 * followed by each of the other words in turn. Postings are
+		 * turned into page, word, offset, end. */
+		found = find_postings(ctx, index, keys, &count);
+		for (i = 0; i < count; i++)
+			found[i * 4 + 3] += found[i * 4 + 2];
+
+		for (k = 1; k < n && count > 0; k++)
+		{
+			next = find_postings(ctx, index, keys + k * FZ_SEARCH_INDEX_TERM_MAX, &next_count);
+			for (i = j = 0, c = 0; i < count; i++)
+			{
+				int *f = found + i * 4;
+				int want[2];
+				want[0] = f[0];
+				want[1] = f[1] + k;
+				while (j < next_count && cmp_posting(next + j * 4, want) < 0)
+					j++;
+				if (j < next_count && cmp_posting(next + j * 4, want) == 0)
+				{
+					memmove(found + c * 4, f, 4 * sizeof(int));
+					found[c * 4 + 3] = next[j * 4 + 2] + next[j * 4 + 3];
+					c++;
+				}
+			}
+			count = c;
+			fz_free(ctx, next);
+			next = NULL;
+		}
+
+		for (i = 0; i < count && hit_count < hit_max; i++)
+		{
+			hits[hit_count].page = found[i * 4];
+			hits[hit_count].offset = found[i * 4 + 2];
+			hits[hit_count].len = found[i * 4 + 3] - found[i * 4 + 2];
+			hit_count++;
+		}
+		hit_count = count;
+	}
+	fz_always(ctx)
+	{
+		fz_free(ctx, keys);
+		fz_free(ctx, found);
+		fz_free(ctx, next);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
+
+	return hit_count;
+}
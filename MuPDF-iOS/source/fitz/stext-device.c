@@ -445,6 +445,7 @@ fz_new_text_page(fz_context *ctx)
 	page->cap = 0;
 	page->blocks = NULL;
 	page->next = NULL;
+	page->index = NULL;
 	return page;
 }
 
@@ -500,6 +501,7 @@ fz_drop_text_page(fz_context *ctx, fz_text_page *page)
 			break;
 		}
 	}
+	fz_drop_text_page_index(ctx, page);
 	fz_free(ctx, page->blocks);
 	fz_free(ctx, page);
 }
@@ -996,6 +998,9 @@ fz_text_end_page(fz_context *ctx, fz_device *dev)
 	/* TODO: unicode NFC normalization */
 
 	fz_bidi_reorder_text_page(ctx, tdev->page);
+
+	/* Any index of the text is now out of date */
+	fz_drop_text_page_index(ctx, tdev->page);
 }
 
 static void
@@ -14,10 +14,39 @@ static inline int iswhite(int c)
 	return c == ' ' || c == '\r' || c == '\n' || c == '\t' || c == 0xA0 || c == 0x2028 || c == 0x2029;
 }
 
-fz_char_and_box *fz_text_char_at(fz_context *ctx, fz_char_and_box *cab, fz_text_page *page, int idx)
+/*
+	The text of a page flattened into arrays, in the order in which
+	fz_text_char_at counts characters: the characters of each span of
+	each line, then a pseudo-newline (a space with an empty bbox).
+
+	For searching, the text is also held case folded, with each run of
+	whitespace folded into a single space, so that matching is a plain
+	comparison of two arrays. fold_start gives the index of the first
+	character of each folded character, with a final entry of len.
+*/
+struct fz_text_index_s
+{
+	int len;
+	int *text;
+	fz_rect *bbox;
+	unsigned char *flags;
+	int fold_len;
+	int *fold;
+	int *fold_start;
+};
+
+enum
+{
+	INDEX_SPAN_START = 1, /* First character of a span */
+	INDEX_SPAN_END = 2, /* Last character of a span */
+	INDEX_LAST_SPAN = 4, /* In the last span of its line */
+	INDEX_NEWLINE = 8 /* Pseudo-newline at the end of a line */
+};
+
+static void
+fill_text_index(fz_context *ctx, fz_text_index *index, fz_text_page *page)
 {
-	int block_num;
-	int ofs = 0;
+	int block_num, i, n = 0;
 
 	for (block_num = 0; block_num < page->len; block_num++)
 	{
@@ -32,130 +61,199 @@ fz_char_and_box *fz_text_char_at(fz_context *ctx, fz_char_and_box *cab, fz_text_
 		{
 			for (span = line->first_span; span; span = span->next)
 			{
-				if (idx < ofs + span->len)
+				for (i = 0; i < span->len; i++)
 				{
-					cab->c = span->text[idx - ofs].c;
-					fz_text_char_bbox(ctx, &cab->bbox, span, idx - ofs);
-					return cab;
+					if (index->text)
+					{
+						index->text[n] = span->text[i].c;
+						fz_text_char_bbox(ctx, &index->bbox[n], span, i);
+						index->flags[n] = 0;
+						if (i == 0)
+							index->flags[n] |= INDEX_SPAN_START;
+						if (i == span->len - 1)
+							index->flags[n] |= INDEX_SPAN_END;
+						if (span == line->last_span)
+							index->flags[n] |= INDEX_LAST_SPAN;
+					}
+					n++;
 				}
-				ofs += span->len;
 			}
-			/* pseudo-newline */
-			if (idx == ofs)
+			if (index->text)
 			{
-				cab->bbox = fz_empty_rect;
-				cab->c = ' ';
-				return cab;
+				index->text[n] = ' ';
+				index->bbox[n] = fz_empty_rect;
+				index->flags[n] = INDEX_NEWLINE;
 			}
-			ofs++;
+			n++;
 		}
 	}
-	cab->bbox = fz_empty_rect;
-	cab->c = 0;
-	return cab;
-}
 
-static int charat(fz_context *ctx, fz_text_page *page, int idx)
-{
-	fz_char_and_box cab;
-	return fz_text_char_at(ctx, &cab, page, idx)->c;
+	index->len = n;
 }
 
-static fz_rect *bboxat(fz_context *ctx, fz_text_page *page, int idx, fz_rect *bbox)
+static void
+fz_drop_text_index(fz_context *ctx, fz_text_index *index)
 {
-	fz_char_and_box cab;
-	/* FIXME: Nasty extra copy */
-	*bbox = fz_text_char_at(ctx, &cab, page, idx)->bbox;
-	return bbox;
+	if (index == NULL)
+		return;
+	fz_free(ctx, index->text);
+	fz_free(ctx, index->bbox);
+	fz_free(ctx, index->flags);
+	fz_free(ctx, index->fold);
+	fz_free(ctx, index->fold_start);
+	fz_free(ctx, index);
 }
 
-static int textlen(fz_context *ctx, fz_text_page *page)
+static fz_text_index *
+fz_new_text_index(fz_context *ctx, fz_text_page *page)
 {
-	int len = 0;
-	int block_num;
+	fz_text_index *index = fz_malloc_struct(ctx, fz_text_index);
+	int i, n;
 
-	for (block_num = 0; block_num < page->len; block_num++)
+	fz_try(ctx)
 	{
-		fz_text_block *block;
-		fz_text_line *line;
-		fz_text_span *span;
-
-		if (page->blocks[block_num].type != FZ_PAGE_BLOCK_TEXT)
-			continue;
-		block = page->blocks[block_num].u.text;
-		for (line = block->lines; line < block->lines + block->len; line++)
+		/* Count, then fill */
+		fill_text_index(ctx, index, page);
+		index->text = fz_malloc_array(ctx, index->len + 1, sizeof(int));
+		index->bbox = fz_malloc_array(ctx, index->len + 1, sizeof(fz_rect));
+		index->flags = fz_malloc_array(ctx, index->len + 1, 1);
+		fill_text_index(ctx, index, page);
+
+		index->fold = fz_malloc_array(ctx, index->len + 1, sizeof(int));
+		index->fold_start = fz_malloc_array(ctx, index->len + 1, sizeof(int));
+		n = 0;
+		for (i = 0; i < index->len; i++)
 		{
-			for (span = line->first_span; span; span = span->next)
+			if (iswhite(index->text[i]))
 			{
-				len += span->len;
+				if (n > 0 && index->fold[n-1] == ' ')
+					continue;
+				index->fold[n] = ' ';
 			}
-			len++; /* pseudo-newline */
+			else
+				index->fold[n] = fz_tolower(index->text[i]);
+			index->fold_start[n++] = i;
 		}
+		index->fold_start[n] = index->len;
+		index->fold_len = n;
 	}
-	return len;
+	fz_catch(ctx)
+	{
+		fz_drop_text_index(ctx, index);
+		fz_rethrow(ctx);
+	}
+
+	return index;
 }
 
-static int match(fz_context *ctx, fz_text_page *page, const char *s, int n)
+void
+fz_drop_text_page_index(fz_context *ctx, fz_text_page *page)
 {
-	int orig = n;
-	int c;
-	while (*s)
+	if (page == NULL)
+		return;
+	fz_drop_text_index(ctx, page->index);
+	page->index = NULL;
+}
+
+static fz_text_index *
+text_page_index(fz_context *ctx, fz_text_page *page)
+{
+	if (!page->index)
+		page->index = fz_new_text_index(ctx, page);
+	return page->index;
+}
+
+fz_char_and_box *fz_text_char_at(fz_context *ctx, fz_char_and_box *cab, fz_text_page *page, int idx)
+{
+	fz_text_index *index = text_page_index(ctx, page);
+
+	if (idx < 0 || idx >= index->len)
 	{
-		s += fz_chartorune(&c, (char *)s);
-		if (iswhite(c) && iswhite(charat(ctx, page, n)))
-		{
-			const char *s_next;
+		cab->bbox = fz_empty_rect;
+		cab->c = 0;
+		return cab;
+	}
+	cab->c = index->text[idx];
+	cab->bbox = index->bbox[idx];
+	return cab;
+}
 
-			/* Skip over whitespace in the document */
-			do
-				n++;
-			while (iswhite(charat(ctx, page, n)));
+/* Fold the needle as the text is folded in the index */
+static int *
+fold_needle(fz_context *ctx, const char *needle, int *lenp)
+{
+	int *fold = fz_malloc_array(ctx, strlen(needle), sizeof(int));
+	int c, n = 0;
 
-			/* Skip over multiple whitespace in the search string */
-			while (s_next = s + fz_chartorune(&c, (char *)s), iswhite(c))
-				s = s_next;
-		}
-		else
+	while (*needle)
+	{
+		needle += fz_chartorune(&c, (char *)needle);
+		if (iswhite(c))
 		{
-			if (fz_tolower(c) != fz_tolower(charat(ctx, page, n)))
-				return 0;
-			n++;
+			if (n > 0 && fold[n-1] == ' ')
+				continue;
+			fold[n++] = ' ';
 		}
+		else
+			fold[n++] = fz_tolower(c);
 	}
-	return n - orig;
+
+	*lenp = n;
+	return fold;
 }
 
 int
 fz_search_text_page(fz_context *ctx, fz_text_page *text, const char *needle, fz_rect *hit_bbox, int hit_max)
 {
-	int pos, len, i, n, hit_count;
+	fz_text_index *index;
+	int skip[256];
+	int *pat;
+	int m, q, i, first, last, pos, end, hit_count;
 
 	if (strlen(needle) == 0)
 		return 0;
 
+	index = text_page_index(ctx, text);
+	pat = fold_needle(ctx, needle, &m);
+
+	/* Boyer-Moore-Horspool over the folded text, with the skip table
+	 * indexed by the low byte of each character. */
+	for (i = 0; i < 256; i++)
+		skip[i] = m;
+	for (i = 0; i < m - 1; i++)
+		skip[pat[i] & 255] = m - 1 - i;
+
 	hit_count = 0;
-	len = textlen(ctx, text);
-	for (pos = 0; pos < len; pos++)
+	for (q = 0; q + m <= index->fold_len; q += skip[index->fold[q + m - 1] & 255])
 	{
-		n = match(ctx, text, needle, pos);
-		if (n)
+		for (i = m - 1; i >= 0 && index->fold[q + i] == pat[i]; i--)
+			;
+		if (i >= 0)
+			continue;
+
+		/* A needle starting with whitespace matches at every
+		 * character of the first whitespace run. The match ends
+		 * after the end of the last folded character. */
+		first = index->fold_start[q];
+		last = pat[0] == ' ' ? index->fold_start[q + 1] : first + 1;
+		end = index->fold_start[q + m];
+		for (pos = first; pos < last; pos++)
 		{
 			fz_rect linebox = fz_empty_rect;
-			for (i = 0; i < n; i++)
+			for (i = pos; i < end; i++)
 			{
-				fz_rect charbox;
-				bboxat(ctx, text, pos + i, &charbox);
-				if (!fz_is_empty_rect(&charbox))
+				fz_rect *charbox = &index->bbox[i];
+				if (!fz_is_empty_rect(charbox))
 				{
-					if (charbox.y0 != linebox.y0 || fz_abs(charbox.x0 - linebox.x1) > 5)
+					if (charbox->y0 != linebox.y0 || fz_abs(charbox->x0 - linebox.x1) > 5)
 					{
 						if (!fz_is_empty_rect(&linebox) && hit_count < hit_max)
 							hit_bbox[hit_count++] = linebox;
-						linebox = charbox;
+						linebox = *charbox;
 					}
 					else
 					{
-						fz_union_rect(&linebox, &charbox);
+						fz_union_rect(&linebox, charbox);
 					}
 				}
 			}
@@ -164,17 +262,17 @@ fz_search_text_page(fz_context *ctx, fz_text_page *text, const char *needle, fz_
 		}
 	}
 
+	fz_free(ctx, pat);
+
 	return hit_count;
 }
 
 int
 fz_highlight_selection(fz_context *ctx, fz_text_page *page, fz_rect rect, fz_rect *hit_bbox, int hit_max)
 {
-	fz_rect linebox, charbox;
-	fz_text_block *block;
-	fz_text_line *line;
-	fz_text_span *span;
-	int i, block_num, hit_count;
+	fz_text_index *index = text_page_index(ctx, page);
+	fz_rect linebox, *charbox;
+	int i, hit_count;
 
 	float x0 = rect.x0;
 	float x1 = rect.x1;
@@ -183,36 +281,29 @@ fz_highlight_selection(fz_context *ctx, fz_text_page *page, fz_rect rect, fz_rec
 
 	hit_count = 0;
 
-	for (block_num = 0; block_num < page->len; block_num++)
+	linebox = fz_empty_rect;
+	for (i = 0; i < index->len; i++)
 	{
-		if (page->blocks[block_num].type != FZ_PAGE_BLOCK_TEXT)
-			continue;
-		block = page->blocks[block_num].u.text;
-		for (line = block->lines; line < block->lines + block->len; line++)
+		if (index->flags[i] & INDEX_NEWLINE)
 		{
+			if (!fz_is_empty_rect(&linebox) && hit_count < hit_max)
+				hit_bbox[hit_count++] = linebox;
 			linebox = fz_empty_rect;
-			for (span = line->first_span; span; span = span->next)
+			continue;
+		}
+		charbox = &index->bbox[i];
+		if (charbox->x1 >= x0 && charbox->x0 <= x1 && charbox->y1 >= y0 && charbox->y0 <= y1)
+		{
+			if (charbox->y0 != linebox.y0 || fz_abs(charbox->x0 - linebox.x1) > 5)
 			{
-				for (i = 0; i < span->len; i++)
-				{
-					fz_text_char_bbox(ctx, &charbox, span, i);
-					if (charbox.x1 >= x0 && charbox.x0 <= x1 && charbox.y1 >= y0 && charbox.y0 <= y1)
-					{
-						if (charbox.y0 != linebox.y0 || fz_abs(charbox.x0 - linebox.x1) > 5)
-						{
-							if (!fz_is_empty_rect(&linebox) && hit_count < hit_max)
-								hit_bbox[hit_count++] = linebox;
-							linebox = charbox;
-						}
-						else
-						{
-							fz_union_rect(&linebox, &charbox);
-						}
-					}
-				}
+				if (!fz_is_empty_rect(&linebox) && hit_count < hit_max)
+					hit_bbox[hit_count++] = linebox;
+				linebox = *charbox;
+			}
+			else
+			{
+				fz_union_rect(&linebox, charbox);
 			}
-			if (!fz_is_empty_rect(&linebox) && hit_count < hit_max)
-				hit_bbox[hit_count++] = linebox;
 		}
 	}
 
@@ -222,9 +313,10 @@ fz_highlight_selection(fz_context *ctx, fz_text_page *page, fz_rect rect, fz_rec
 char *
 fz_copy_selection(fz_context *ctx, fz_text_page *page, fz_rect rect)
 {
+	fz_text_index *index = text_page_index(ctx, page);
 	fz_buffer *buffer;
-	fz_rect hitbox;
-	int c, i, block_num, seen = 0;
+	fz_rect *hitbox;
+	int c, i, seen = 0;
 	char *s;
 
 	float x0 = rect.x0;
@@ -234,42 +326,35 @@ fz_copy_selection(fz_context *ctx, fz_text_page *page, fz_rect rect)
 
 	buffer = fz_new_buffer(ctx, 1024);
 
-	for (block_num = 0; block_num < page->len; block_num++)
+	for (i = 0; i < index->len; i++)
 	{
-		fz_text_block *block;
-		fz_text_line *line;
-		fz_text_span *span;
+		int flags = index->flags[i];
 
-		if (page->blocks[block_num].type != FZ_PAGE_BLOCK_TEXT)
+		if (flags & INDEX_NEWLINE)
 			continue;
-		block = page->blocks[block_num].u.text;
-		for (line = block->lines; line < block->lines + block->len; line++)
+
+		if (flags & INDEX_SPAN_START)
 		{
-			for (span = line->first_span; span; span = span->next)
+			if (seen)
 			{
-				if (seen)
-				{
-					fz_write_buffer_byte(ctx, buffer, '\n');
-				}
-
-				seen = 0;
+				fz_write_buffer_byte(ctx, buffer, '\n');
+			}
 
-				for (i = 0; i < span->len; i++)
-				{
-					fz_text_char_bbox(ctx, &hitbox, span, i);
-					c = span->text[i].c;
-					if (c < 32)
-						c = '?';
-					if (hitbox.x1 >= x0 && hitbox.x0 <= x1 && hitbox.y1 >= y0 && hitbox.y0 <= y1)
-					{
-						fz_write_buffer_rune(ctx, buffer, c);
-						seen = 1;
-					}
-				}
+			seen = 0;
+		}
 
-				seen = (seen && span == line->last_span);
-			}
+		hitbox = &index->bbox[i];
+		c = index->text[i];
+		if (c < 32)
+			c = '?';
+		if (hitbox->x1 >= x0 && hitbox->x0 <= x1 && hitbox->y1 >= y0 && hitbox->y0 <= y1)
+		{
+			fz_write_buffer_rune(ctx, buffer, c);
+			seen = 1;
 		}
+
+		if (flags & INDEX_SPAN_END)
+			seen = (seen && (flags & INDEX_LAST_SPAN));
 	}
 
 	fz_write_buffer_byte(ctx, buffer, 0);
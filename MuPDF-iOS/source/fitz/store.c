@@ -1,6 +1,7 @@
 #include "mupdf/fitz.h"
 
 typedef struct fz_item_s fz_item;
+typedef struct fz_store_shard_s fz_store_shard;
 
 struct fz_item_s
 {
@@ -11,20 +12,35 @@ struct fz_item_s
 	fz_item *prev;
 	fz_store *store;
 	fz_store_type *type;
+	int accessed;
 };
 
-struct fz_store_s
+/* Items are spread across a number of shards according to a hash of their
+ * key, so that lookups from different threads rarely contend. Each shard
+ * has its own lock (FZ_LOCK_STORE + shard number) which protects its list
+ * and hash table. The reference counts of the values, and the overall
+ * size of the store, remain protected by FZ_LOCK_ALLOC. */
+struct fz_store_shard_s
 {
-	int refs;
-
-	/* Every item in the store is kept in a doubly linked list, ordered
-	 * by usage (so LRU entries are at the end). */
+	/* Every item in the shard is kept in a doubly linked list. New items
+	 * go at the head; the eviction sweep works from the tail. */
 	fz_item *head;
 	fz_item *tail;
+	int count;
 
 	/* We have a hash table that allows to quickly find a subset of the
 	 * entries (those whose keys are indirect objects). */
 	fz_hash_table *hash;
+};
+
+struct fz_store_s
+{
+	int refs;
+
+	fz_store_shard shard[FZ_STORE_SHARDS];
+
+	/* The clock hand; the next shard the eviction sweep will visit. */
+	int hand;
 
 	/* We keep track of the size of the store, and keep it below max. */
 	unsigned int max;
@@ -35,19 +51,24 @@ void
 fz_new_store_context(fz_context *ctx, unsigned int max)
 {
 	fz_store *store;
+	int i;
+
 	store = fz_malloc_struct(ctx, fz_store);
 	fz_try(ctx)
 	{
-		store->hash = fz_new_hash_table(ctx, 4096, sizeof(fz_store_hash), FZ_LOCK_ALLOC);
+		for (i = 0; i < FZ_STORE_SHARDS; i++)
+			store->shard[i].hash = fz_new_hash_table(ctx, 4096 / FZ_STORE_SHARDS, sizeof(fz_store_hash), FZ_LOCK_STORE + i);
 	}
 	fz_catch(ctx)
 	{
+		for (i = 0; i < FZ_STORE_SHARDS; i++)
+			if (store->shard[i].hash)
+				fz_drop_hash(ctx, store->shard[i].hash);
 		fz_free(ctx, store);
 		fz_rethrow(ctx);
 	}
 	store->refs = 1;
-	store->head = NULL;
-	store->tail = NULL;
+	store->hand = 0;
 	store->size = 0;
 	store->max = max;
 	ctx->store = store;
@@ -73,143 +94,202 @@ fz_drop_storable(fz_context *ctx, fz_storable *s)
 		s->drop(ctx, s);
 }
 
-static void
-evict(fz_context *ctx, fz_item *item)
+/* Pick the shard for a key. Hashable keys are spread by their hash; the
+ * others (which can only be found by a linear search) are grouped by the
+ * type of value, so that a lookup only has to search one shard. */
+static int
+shard_index(fz_store_hash *hash, int use_hash, fz_store_drop_fn *drop)
 {
-	fz_store *store = ctx->store;
-	int drop;
+	const unsigned char *s;
+	unsigned int len;
+	unsigned int h = 2166136261U;
 
-	store->size -= item->size;
-	/* Unlink from the linked list */
+	if (use_hash)
+	{
+		s = (const unsigned char *)hash;
+		len = sizeof(*hash);
+	}
+	else
+	{
+		s = (const unsigned char *)&drop;
+		len = sizeof(drop);
+	}
+	while (len--)
+	{
+		h ^= *s++;
+		h *= 16777619U;
+	}
+	return (h ^ (h >> 16)) % FZ_STORE_SHARDS;
+}
+
+static void
+unlink_item(fz_store_shard *shard, fz_item *item)
+{
 	if (item->next)
 		item->next->prev = item->prev;
 	else
-		store->tail = item->prev;
+		shard->tail = item->prev;
 	if (item->prev)
 		item->prev->next = item->next;
 	else
-		store->head = item->next;
-	/* Drop a reference to the value (freeing if required) */
-	drop = (item->val->refs > 0 && --item->val->refs == 0);
+		shard->head = item->next;
+	shard->count--;
+}
+
+static void
+link_item(fz_store_shard *shard, fz_item *item)
+{
+	item->next = shard->head;
+	if (item->next)
+		item->next->prev = item;
+	else
+		shard->tail = item;
+	shard->head = item;
+	item->prev = NULL;
+	shard->count++;
+}
+
+/* Called with the shard lock held; drops then retakes it. */
+static void
+evict(fz_context *ctx, int idx, fz_item *item)
+{
+	fz_store *store = ctx->store;
+	fz_store_shard *shard = &store->shard[idx];
+	int drop;
+
+	fz_assert_lock_held(ctx, FZ_LOCK_STORE + idx);
+
+	/* Unlink from the linked list */
+	unlink_item(shard, item);
 	/* Remove from the hash table */
 	if (item->type->make_hash_key)
 	{
 		fz_store_hash hash = { NULL };
 		hash.drop = item->val->drop;
 		if (item->type->make_hash_key(ctx, &hash, item->key))
-			fz_hash_remove(ctx, store->hash, &hash);
+			fz_hash_remove(ctx, shard->hash, &hash);
 	}
+	/* Drop a reference to the value (freeing if required) */
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	store->size -= item->size;
+	drop = (item->val->refs > 0 && --item->val->refs == 0);
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
+	fz_unlock(ctx, FZ_LOCK_STORE + idx);
 	if (drop)
 		item->val->drop(ctx, item->val);
 	/* Always drops the key and drop the item */
 	item->type->drop_key(ctx, item->key);
-	fz_free(ctx, item);
-	fz_lock(ctx, FZ_LOCK_ALLOC);
+	fz_free_small(ctx, item, sizeof(fz_item));
+	fz_lock(ctx, FZ_LOCK_STORE + idx);
 }
 
-static int
-ensure_space(fz_context *ctx, unsigned int tofree)
+/* Evict unused items until at least tofree bytes have been released.
+ *
+ * This is a clock sweep across the shards: each visit to a shard looks
+ * at its items from the tail, giving those that have been looked up since
+ * the last visit a second chance, and evicts the first one that only the
+ * store holds a reference to. The hand then moves on to the next shard,
+ * so that the pressure is spread evenly across the store. We give up once
+ * two whole turns of the clock have found nothing to evict.
+ *
+ * Called with no store locks (and not FZ_LOCK_ALLOC) held. Returns the
+ * number of bytes freed. */
+static unsigned int
+sweep(fz_context *ctx, unsigned int tofree)
 {
-	fz_item *item, *prev;
-	unsigned int count;
 	fz_store *store = ctx->store;
+	unsigned int count = 0;
+	int idle = 0;
 
-	fz_assert_lock_held(ctx, FZ_LOCK_ALLOC);
-
-	/* First check that we *can* free tofree; if not, we'd rather not
-	 * cache this. */
-	count = 0;
-	for (item = store->tail; item; item = item->prev)
+	while (count < tofree && idle < 2 * FZ_STORE_SHARDS)
 	{
-		if (item->val->refs == 1)
-		{
-			count += item->size;
-			if (count >= tofree)
-				break;
-		}
-	}
+		fz_store_shard *shard;
+		fz_item *item;
+		int idx, n, unused;
+		int found = 0;
 
-	/* If we ran out of items to search, then we can never free enough */
-	if (item == NULL)
-	{
-		return 0;
-	}
+		fz_lock(ctx, FZ_LOCK_ALLOC);
+		idx = store->hand;
+		store->hand = (idx + 1) % FZ_STORE_SHARDS;
+		fz_unlock(ctx, FZ_LOCK_ALLOC);
 
-	/* Actually free the items */
-	count = 0;
-	for (item = store->tail; item; item = prev)
-	{
-		prev = item->prev;
-		if (item->val->refs == 1)
+		shard = &store->shard[idx];
+		fz_lock(ctx, FZ_LOCK_STORE + idx);
+		for (n = shard->count; n > 0; n--)
 		{
-			/* Free this item. Evict has to drop the lock to
-			 * manage that, which could cause prev to be removed
-			 * in the meantime. To avoid that we bump its reference
-			 * count here. This may cause another simultaneous
-			 * evict process to fail to make enough space as prev is
-			 * pinned - but that will only happen if we're near to
-			 * the limit anyway, and it will only cause something to
-			 * not be cached. */
-			count += item->size;
-			if (prev)
-				prev->val->refs++;
-			evict(ctx, item); /* Drops then retakes lock */
-			/* So the store has 1 reference to prev, as do we, so
-			 * no other evict process can have thrown prev away in
-			 * the meantime. So we are safe to just decrement its
-			 * reference count here. */
-			if (prev)
-				--prev->val->refs;
-
-			if (count >= tofree)
-				return count;
+			item = shard->tail;
+			if (item->accessed)
+				unused = 0;
+			else
+			{
+				fz_lock(ctx, FZ_LOCK_ALLOC);
+				unused = (item->val->refs == 1);
+				fz_unlock(ctx, FZ_LOCK_ALLOC);
+			}
+			if (unused)
+			{
+				count += item->size;
+				evict(ctx, idx, item); /* Drops then retakes lock */
+				found = 1;
+				break;
+			}
+			/* Give it another go round */
+			item->accessed = 0;
+			unlink_item(shard, item);
+			link_item(shard, item);
 		}
+		fz_unlock(ctx, FZ_LOCK_STORE + idx);
+
+		if (found)
+			idle = 0;
+		else
+			idle++;
 	}
 
 	return count;
 }
 
+/* Take a value we have just stored back out again. Called with no locks
+ * held. */
 static void
-touch(fz_store *store, fz_item *item)
+unstore(fz_context *ctx, int idx, fz_storable *val, fz_store_type *type, fz_store_hash *hash, int use_hash)
 {
-	if (item->next != item)
+	fz_store_shard *shard = &ctx->store->shard[idx];
+	fz_item *item;
+
+	fz_lock(ctx, FZ_LOCK_STORE + idx);
+	if (use_hash)
+		item = fz_hash_find(ctx, shard->hash, hash);
+	else
 	{
-		/* Already in the list - unlink it */
-		if (item->next)
-			item->next->prev = item->prev;
-		else
-			store->tail = item->prev;
-		if (item->prev)
-			item->prev->next = item->next;
-		else
-			store->head = item->next;
+		for (item = shard->head; item; item = item->next)
+			if (item->val == val && item->type == type)
+				break;
 	}
-	/* Now relink it at the start of the LRU chain */
-	item->next = store->head;
-	if (item->next)
-		item->next->prev = item;
-	else
-		store->tail = item;
-	store->head = item;
-	item->prev = NULL;
+	if (item && item->val == val)
+		evict(ctx, idx, item); /* Drops then retakes lock */
+	fz_unlock(ctx, FZ_LOCK_STORE + idx);
 }
 
 void *
 fz_store_item(fz_context *ctx, void *key, void *val_, unsigned int itemsize, fz_store_type *type)
 {
 	fz_item *item = NULL;
-	unsigned int size;
 	fz_storable *val = (fz_storable *)val_;
 	fz_store *store = ctx->store;
 	fz_store_hash hash = { NULL };
+	fz_store_shard *shard;
+	unsigned int tofree = 0;
 	int use_hash = 0;
-	unsigned pos;
+	int idx;
 
 	if (!store)
 		return NULL;
 
 	fz_var(item);
+	fz_var(val_);
+	fz_var(val);
+	fz_var(tofree);
 
 	if (store->max != FZ_STORE_UNLIMITED && store->max < itemsize)
 	{
@@ -223,7 +303,8 @@ fz_store_item(fz_context *ctx, void *key, void *val_, unsigned int itemsize, fz_
 	 * the item. */
 	fz_try(ctx)
 	{
-		item = fz_malloc_struct(ctx, fz_item);
+		item = fz_malloc_small(ctx, sizeof(fz_item));
+		memset(item, 0, sizeof(fz_item));
 	}
 	fz_catch(ctx)
 	{
@@ -236,19 +317,18 @@ fz_store_item(fz_context *ctx, void *key, void *val_, unsigned int itemsize, fz_
 		use_hash = type->make_hash_key(ctx, &hash, key);
 	}
 
+	idx = shard_index(&hash, use_hash, val->drop);
+	shard = &store->shard[idx];
+
 	type->keep_key(ctx, key);
-	fz_lock(ctx, FZ_LOCK_ALLOC);
+	fz_lock(ctx, FZ_LOCK_STORE + idx);
 
-	/* Fill out the item. To start with, we always set item->next == item
-	 * and item->prev == item. This is so that we can spot items that have
-	 * been put into the hash table without having made it into the linked
-	 * list yet. */
+	/* Fill out the item. */
 	item->key = key;
 	item->val = val;
 	item->size = itemsize;
-	item->next = item;
-	item->prev = item;
 	item->type = type;
+	item->accessed = 0;
 
 	/* If we can index it fast, put it into the hash table. This serves
 	 * to check whether we have one there already. */
@@ -259,14 +339,14 @@ fz_store_item(fz_context *ctx, void *key, void *val_, unsigned int itemsize, fz_
 		fz_try(ctx)
 		{
 			/* May drop and retake the lock */
-			existing = fz_hash_insert_with_pos(ctx, store->hash, &hash, item, &pos);
+			existing = fz_hash_insert(ctx, shard->hash, &hash, item);
 		}
 		fz_catch(ctx)
 		{
 			/* Any error here means that item never made it into the
 			 * hash - so no one else can have a reference. */
-			fz_unlock(ctx, FZ_LOCK_ALLOC);
-			fz_free(ctx, item);
+			fz_unlock(ctx, FZ_LOCK_STORE + idx);
+			fz_free_small(ctx, item, sizeof(fz_item));
 			type->drop_key(ctx, key);
 			return NULL;
 		}
@@ -274,56 +354,36 @@ fz_store_item(fz_context *ctx, void *key, void *val_, unsigned int itemsize, fz_
 		{
 			/* There was one there already! Take a new reference
 			 * to the existing one, and drop our current one. */
-			touch(store, existing);
+			existing->accessed = 1;
+			fz_lock(ctx, FZ_LOCK_ALLOC);
 			if (existing->val->refs > 0)
 				existing->val->refs++;
 			fz_unlock(ctx, FZ_LOCK_ALLOC);
-			fz_free(ctx, item);
+			val = existing->val;
+			fz_unlock(ctx, FZ_LOCK_STORE + idx);
+			fz_free_small(ctx, item, sizeof(fz_item));
 			type->drop_key(ctx, key);
-			return existing->val;
+			return val;
 		}
 	}
-	/* Now bump the ref */
+
+	/* Regardless of whether it's indexed, it goes into the linked list */
+	link_item(shard, item);
+
+	/* Now bump the ref, and see whether we are over budget */
+	fz_lock(ctx, FZ_LOCK_ALLOC);
 	if (val->refs > 0)
 		val->refs++;
-	/* If we haven't got an infinite store, check for space within it */
-	if (store->max != FZ_STORE_UNLIMITED)
-	{
-		size = store->size + itemsize;
-		while (size > store->max)
-		{
-			/* ensure_space may drop, then retake the lock */
-			int saved = ensure_space(ctx, size - store->max);
-			if (saved == 0)
-			{
-				/* Failed to free any space. */
-				/* If we are using the hash table, then we've already
-				 * inserted item - remove it. */
-				if (use_hash)
-				{
-					/* If someone else has already picked up a reference
-					 * to item, then we cannot remove it. Leave it in the
-					 * store, and we'll live with being over budget. We
-					 * know this is the case, if it's in the linked list. */
-					if (item->next != item)
-						break;
-					fz_hash_remove_fast(ctx, store->hash, &hash, pos);
-				}
-				fz_unlock(ctx, FZ_LOCK_ALLOC);
-				fz_free(ctx, item);
-				type->drop_key(ctx, key);
-				if (val->refs > 0)
-					val->refs--;
-				return NULL;
-			}
-			size -= saved;
-		}
-	}
 	store->size += itemsize;
-
-	/* Regardless of whether it's indexed, it goes into the linked list */
-	touch(store, item);
+	if (store->max != FZ_STORE_UNLIMITED && store->size > store->max)
+		tofree = store->size - store->max;
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
+	fz_unlock(ctx, FZ_LOCK_STORE + idx);
+
+	/* If we can't make enough room, we'd rather not cache this. Anyone
+	 * that has found it in the meantime keeps their own reference. */
+	if (tofree > 0 && sweep(ctx, tofree) < tofree)
+		unstore(ctx, idx, val, type, &hash, use_hash);
 
 	return NULL;
 }
@@ -333,8 +393,11 @@ fz_find_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, fz_store_type *
 {
 	fz_item *item;
 	fz_store *store = ctx->store;
+	fz_store_shard *shard;
 	fz_store_hash hash = { NULL };
+	fz_storable *val;
 	int use_hash = 0;
+	int idx;
 
 	if (!store)
 		return NULL;
@@ -348,16 +411,19 @@ fz_find_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, fz_store_type *
 		use_hash = type->make_hash_key(ctx, &hash, key);
 	}
 
-	fz_lock(ctx, FZ_LOCK_ALLOC);
+	idx = shard_index(&hash, use_hash, drop);
+	shard = &store->shard[idx];
+
+	fz_lock(ctx, FZ_LOCK_STORE + idx);
 	if (use_hash)
 	{
 		/* We can find objects keyed on indirected objects quickly */
-		item = fz_hash_find(ctx, store->hash, &hash);
+		item = fz_hash_find(ctx, shard->hash, &hash);
 	}
 	else
 	{
 		/* Others we have to hunt for slowly */
-		for (item = store->head; item; item = item->next)
+		for (item = shard->head; item; item = item->next)
 		{
 			if (item->val->drop == drop && !type->cmp_key(ctx, item->key, key))
 				break;
@@ -365,18 +431,19 @@ fz_find_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, fz_store_type *
 	}
 	if (item)
 	{
-		/* LRU the block. This also serves to ensure that any item
-		 * picked up from the hash before it has made it into the
-		 * linked list does not get whipped out again due to the
-		 * store being full. */
-		touch(store, item);
+		/* Mark the block as recently used, so that it survives the
+		 * next eviction sweep. */
+		item->accessed = 1;
 		/* And bump the refcount before returning */
-		if (item->val->refs > 0)
-			item->val->refs++;
+		val = item->val;
+		fz_lock(ctx, FZ_LOCK_ALLOC);
+		if (val->refs > 0)
+			val->refs++;
 		fz_unlock(ctx, FZ_LOCK_ALLOC);
-		return (void *)item->val;
+		fz_unlock(ctx, FZ_LOCK_STORE + idx);
+		return (void *)val;
 	}
-	fz_unlock(ctx, FZ_LOCK_ALLOC);
+	fz_unlock(ctx, FZ_LOCK_STORE + idx);
 
 	return NULL;
 }
@@ -386,9 +453,10 @@ fz_remove_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, fz_store_type
 {
 	fz_item *item;
 	fz_store *store = ctx->store;
-	int dodrop;
+	fz_store_shard *shard;
 	fz_store_hash hash = { NULL };
 	int use_hash = 0;
+	int idx;
 
 	if (type->make_hash_key)
 	{
@@ -396,63 +464,46 @@ fz_remove_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, fz_store_type
 		use_hash = type->make_hash_key(ctx, &hash, key);
 	}
 
-	fz_lock(ctx, FZ_LOCK_ALLOC);
+	idx = shard_index(&hash, use_hash, drop);
+	shard = &store->shard[idx];
+
+	fz_lock(ctx, FZ_LOCK_STORE + idx);
 	if (use_hash)
 	{
 		/* We can find objects keyed on indirect objects quickly */
-		item = fz_hash_find(ctx, store->hash, &hash);
-		if (item)
-			fz_hash_remove(ctx, store->hash, &hash);
+		item = fz_hash_find(ctx, shard->hash, &hash);
 	}
 	else
 	{
 		/* Others we have to hunt for slowly */
-		for (item = store->head; item; item = item->next)
+		for (item = shard->head; item; item = item->next)
 			if (item->val->drop == drop && !type->cmp_key(ctx, item->key, key))
 				break;
 	}
 	if (item)
-	{
-		/* Momentarily things can be in the hash table without being
-		 * in the list. Don't attempt to unlink these. We indicate
-		 * such items by setting item->next == item. */
-		if (item->next != item)
-		{
-			if (item->next)
-				item->next->prev = item->prev;
-			else
-				store->tail = item->prev;
-			if (item->prev)
-				item->prev->next = item->next;
-			else
-				store->head = item->next;
-		}
-		dodrop = (item->val->refs > 0 && --item->val->refs == 0);
-		fz_unlock(ctx, FZ_LOCK_ALLOC);
-		if (dodrop)
-			item->val->drop(ctx, item->val);
-		type->drop_key(ctx, item->key);
-		fz_free(ctx, item);
-	}
-	else
-		fz_unlock(ctx, FZ_LOCK_ALLOC);
+		evict(ctx, idx, item); /* Drops then retakes lock */
+	fz_unlock(ctx, FZ_LOCK_STORE + idx);
 }
 
 void
 fz_empty_store(fz_context *ctx)
 {
 	fz_store *store = ctx->store;
+	int i;
 
 	if (store == NULL)
 		return;
 
-	fz_lock(ctx, FZ_LOCK_ALLOC);
 	/* Run through all the items in the store */
-	while (store->head)
+	for (i = 0; i < FZ_STORE_SHARDS; i++)
 	{
-		evict(ctx, store->head); /* Drops then retakes lock */
+		fz_lock(ctx, FZ_LOCK_STORE + i);
+		while (store->shard[i].head)
+		{
+			evict(ctx, i, store->shard[i].head); /* Drops then retakes lock */
+		}
+		fz_unlock(ctx, FZ_LOCK_STORE + i);
 	}
-	fz_unlock(ctx, FZ_LOCK_ALLOC);
 }
 
 fz_store *
@@ -469,7 +520,7 @@ fz_keep_store_context(fz_context *ctx)
 void
 fz_drop_store_context(fz_context *ctx)
 {
-	int refs;
+	int refs, i;
 	if (ctx == NULL || ctx->store == NULL)
 		return;
 	fz_lock(ctx, FZ_LOCK_ALLOC);
@@ -479,7 +530,8 @@ fz_drop_store_context(fz_context *ctx)
 		return;
 
 	fz_empty_store(ctx);
-	fz_drop_hash(ctx, ctx->store->hash);
+	for (i = 0; i < FZ_STORE_SHARDS; i++)
+		fz_drop_hash(ctx, ctx->store->shard[i].hash);
 	fz_free(ctx, ctx->store);
 	ctx->store = NULL;
 }
@@ -493,31 +545,35 @@ print_item(FILE *out, void *item_)
 	fflush(out);
 }
 
-void
-fz_print_store_locked(fz_context *ctx, FILE *out)
+static void
+print_shard(fz_context *ctx, FILE *out, int idx)
 {
-	fz_item *item, *next;
-	fz_store *store = ctx->store;
-
-	fprintf(out, "-- resource store contents --\n");
-	fflush(out);
+	fz_store_shard *shard = &ctx->store->shard[idx];
+	fz_item *item;
 
-	for (item = store->head; item; item = next)
+	for (item = shard->head; item; item = item->next)
 	{
-		next = item->next;
-		if (next)
-			next->val->refs++;
-		fprintf(out, "store[*][refs=%d][size=%d] ", item->val->refs, item->size);
-		fz_unlock(ctx, FZ_LOCK_ALLOC);
+		fprintf(out, "store[%d][refs=%d][size=%d] ", idx, item->val->refs, item->size);
 		item->type->debug(ctx, out, item->key);
 		fprintf(out, " = %p\n", item->val);
 		fflush(out);
-		fz_lock(ctx, FZ_LOCK_ALLOC);
-		if (next)
-			next->val->refs--;
 	}
-	fprintf(out, "-- resource store hash contents --\n");
-	fz_print_hash_details(ctx, out, store->hash, print_item);
+	fprintf(out, "-- resource store hash %d contents --\n", idx);
+	fz_print_hash_details(ctx, out, shard->hash, print_item);
+}
+
+/* Called with FZ_LOCK_ALLOC held, so we cannot take the shard locks;
+ * the caller must ensure nothing else is using the store. */
+void
+fz_print_store_locked(fz_context *ctx, FILE *out)
+{
+	int i;
+
+	fprintf(out, "-- resource store contents --\n");
+	fflush(out);
+
+	for (i = 0; i < FZ_STORE_SHARDS; i++)
+		print_shard(ctx, out, i);
 	fprintf(out, "-- end --\n");
 	fflush(out);
 }
@@ -525,43 +581,25 @@ fz_print_store_locked(fz_context *ctx, FILE *out)
 void
 fz_print_store(fz_context *ctx, FILE *out)
 {
-	fz_lock(ctx, FZ_LOCK_ALLOC);
-	fz_print_store_locked(ctx, out);
-	fz_unlock(ctx, FZ_LOCK_ALLOC);
-}
-#endif
+	int i;
 
-/* This is now an n^2 algorithm - not ideal, but it'll only be bad if we are
- * actually managing to scavenge lots of blocks back. */
-static int
-scavenge(fz_context *ctx, unsigned int tofree)
-{
-	fz_store *store = ctx->store;
-	unsigned int count = 0;
-	fz_item *item, *prev;
+	fprintf(out, "-- resource store contents --\n");
+	fflush(out);
 
-	/* Free the items */
-	for (item = store->tail; item; item = prev)
+	for (i = 0; i < FZ_STORE_SHARDS; i++)
 	{
-		prev = item->prev;
-		if (item->val->refs == 1)
-		{
-			/* Free this item */
-			count += item->size;
-			evict(ctx, item); /* Drops then retakes lock */
-
-			if (count >= tofree)
-				break;
-
-			/* Have to restart search again, as prev may no longer
-			 * be valid due to release of lock in evict. */
-			prev = store->tail;
-		}
+		fz_lock(ctx, FZ_LOCK_STORE + i);
+		print_shard(ctx, out, i);
+		fz_unlock(ctx, FZ_LOCK_STORE + i);
 	}
-	/* Success is managing to evict any blocks */
-	return count != 0;
+	fprintf(out, "-- end --\n");
+	fflush(out);
 }
+#endif
 
+/* Called with FZ_LOCK_ALLOC held (by the scavenging allocator, once an
+ * allocation has failed). As the sweep needs to take the shard locks, we
+ * drop it while we sweep. */
 int fz_store_scavenge(fz_context *ctx, unsigned int size, int *phase)
 {
 	fz_store *store;
@@ -580,7 +618,7 @@ int fz_store_scavenge(fz_context *ctx, unsigned int size, int *phase)
 #endif
 	do
 	{
-		unsigned int tofree;
+		unsigned int tofree, freed;
 
 		/* Calculate 'max' as the maximum size of the store for this phase */
 		if (*phase >= 16)
@@ -599,11 +637,16 @@ int fz_store_scavenge(fz_context *ctx, unsigned int size, int *phase)
 		else
 			tofree = size + store->size - max;
 
-		if (scavenge(ctx, tofree))
+		fz_unlock(ctx, FZ_LOCK_ALLOC);
+		freed = sweep(ctx, tofree);
+		fz_lock(ctx, FZ_LOCK_ALLOC);
+
+		/* Success is managing to evict any blocks */
+		if (freed)
 		{
 #ifdef DEBUG_SCAVENGING
 			printf("scavenged: store=%d\n", store->size);
-			fz_print_store(ctx, stderr);
+			fz_print_store_locked(ctx, stderr);
 			Memento_stats();
 #endif
 			return 1;
@@ -613,7 +656,7 @@ int fz_store_scavenge(fz_context *ctx, unsigned int size, int *phase)
 
 #ifdef DEBUG_SCAVENGING
 	printf("scavenging failed\n");
-	fz_print_store(ctx, stderr);
+	fz_print_store_locked(ctx, stderr);
 	Memento_listBlocks();
 #endif
 	return 0;
@@ -624,7 +667,7 @@ fz_shrink_store(fz_context *ctx, unsigned int percent)
 {
 	int success;
 	fz_store *store;
-	unsigned int new_size;
+	unsigned int new_size, size;
 
 	if (ctx == NULL)
 		return 0;
@@ -640,11 +683,14 @@ fz_shrink_store(fz_context *ctx, unsigned int percent)
 	fprintf(stderr, "fz_shrink_store: %d\n", store->size/(1024*1024));
 #endif
 	fz_lock(ctx, FZ_LOCK_ALLOC);
+	size = store->size;
+	fz_unlock(ctx, FZ_LOCK_ALLOC);
 
-	new_size = (unsigned int)(((uint64_t)store->size * percent) / 100);
-	if (store->size > new_size)
-		scavenge(ctx, store->size - new_size);
+	new_size = (unsigned int)(((uint64_t)size * percent) / 100);
+	if (size > new_size)
+		sweep(ctx, size - new_size);
 
+	fz_lock(ctx, FZ_LOCK_ALLOC);
 	success = (store->size <= new_size) ? 1 : 0;
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
 #ifdef DEBUG_SCAVENGING
@@ -653,4 +699,3 @@ fz_shrink_store(fz_context *ctx, unsigned int percent)
 
 	return success;
 }
-
@@ -1,5 +1,11 @@
 #include "mupdf/fitz.h"
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP
+#endif
+
 fz_stream *
 fz_new_stream(fz_context *ctx, void *state, fz_stream_next_fn *next, fz_stream_close_fn *close)
 {
@@ -81,10 +87,10 @@ static int next_file(fz_context *ctx, fz_stream *stm, int n)
 	return *stm->rp++;
 }
 
-static void seek_file(fz_context *ctx, fz_stream *stm, int offset, int whence)
+static void seek_file(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence)
 {
 	fz_file_stream *state = stm->state;
-	int n = lseek(state->file, offset, whence);
+	fz_off_t n = fz_lseek(state->file, offset, whence);
 	if (n < 0)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot lseek: %s", strerror(errno));
 	stm->pos = n;
@@ -122,8 +128,8 @@ fz_open_fd(fz_context *ctx, int fd)
 	return stm;
 }
 
-fz_stream *
-fz_open_file(fz_context *ctx, const char *name)
+static int
+open_file_fd(fz_context *ctx, const char *name)
 {
 #if defined(_WIN32) || defined(_WIN64)
 	char *s = (char*)name;
@@ -142,7 +148,13 @@ fz_open_file(fz_context *ctx, const char *name)
 #endif
 	if (fd == -1)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot open %s", name);
-	return fz_open_fd(ctx, fd);
+	return fd;
+}
+
+fz_stream *
+fz_open_file(fz_context *ctx, const char *name)
+{
+	return fz_open_fd(ctx, open_file_fd(ctx, name));
 }
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -156,6 +168,130 @@ fz_open_file_w(fz_context *ctx, const wchar_t *name)
 }
 #endif
 
+/* Memory mapped file stream */
+
+/* Hand out the mapping a window at a time, as callers of
+ * fz_available expect the answer to fit in an int. */
+#define MAPPED_WINDOW (1 << 30)
+
+static void set_mapped_window(fz_stream *stm, fz_buffer *map, fz_off_t pos)
+{
+	fz_off_t n = map->len - pos;
+	if (n > MAPPED_WINDOW)
+		n = MAPPED_WINDOW;
+	stm->rp = map->data + pos;
+	stm->wp = stm->rp + n;
+	stm->pos = pos + n;
+}
+
+static int next_mapped(fz_context *ctx, fz_stream *stm, int max)
+{
+	fz_buffer *map = stm->state;
+
+	if (stm->pos >= map->len)
+		return EOF;
+	set_mapped_window(stm, map, stm->pos);
+	return *stm->rp++;
+}
+
+static void seek_mapped(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence)
+{
+	fz_buffer *map = stm->state;
+
+	if (whence == 1)
+		offset += fz_tell(ctx, stm);
+	else if (whence == 2)
+		offset += map->len;
+	if (offset < 0)
+		offset = 0;
+	if (offset > map->len)
+		offset = map->len;
+	set_mapped_window(stm, map, offset);
+}
+
+static int meta_mapped(fz_context *ctx, fz_stream *stm, int key, int size, void *ptr)
+{
+	fz_buffer *map = stm->state;
+
+	if (key == FZ_STREAM_META_MEMORY && ptr && size == sizeof(fz_stream_memory))
+	{
+		fz_stream_memory *mem = ptr;
+		mem->data = map->data;
+		mem->len = map->len;
+		mem->buffer = map;
+		return 1;
+	}
+	return -1;
+}
+
+static void close_mapped(fz_context *ctx, void *state)
+{
+	fz_drop_buffer(ctx, state);
+}
+
+#ifdef HAVE_MMAP
+static void unmap_file(fz_context *ctx, unsigned char *data, fz_off_t len)
+{
+	if (munmap(data, (size_t)len) < 0)
+		fz_warn(ctx, "munmap error: %s", strerror(errno));
+}
+#endif
+
+fz_stream *
+fz_open_fd_mapped(fz_context *ctx, int fd)
+{
+#ifdef HAVE_MMAP
+	struct stat st;
+	void *data;
+	fz_buffer *map;
+	fz_stream *stm;
+
+	/* Anything we cannot map is read as usual */
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return fz_open_fd(ctx, fd);
+	if ((uint64_t)st.st_size > (uint64_t)SIZE_MAX)
+		return fz_open_fd(ctx, fd);
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return fz_open_fd(ctx, fd);
+
+	/* The mapping outlives the descriptor */
+	close(fd);
+
+	fz_var(map);
+
+	fz_try(ctx)
+	{
+		map = fz_malloc_struct(ctx, fz_buffer);
+	}
+	fz_catch(ctx)
+	{
+		munmap(data, (size_t)st.st_size);
+		fz_rethrow(ctx);
+	}
+	map->refs = 1;
+	map->data = data;
+	map->cap = st.st_size;
+	map->len = st.st_size;
+	map->drop_data = unmap_file;
+
+	stm = fz_new_stream(ctx, map, next_mapped, close_mapped);
+	stm->seek = seek_mapped;
+	stm->meta = meta_mapped;
+	set_mapped_window(stm, map, 0);
+
+	return stm;
+#else
+	return fz_open_fd(ctx, fd);
+#endif
+}
+
+fz_stream *
+fz_open_file_mapped(fz_context *ctx, const char *name)
+{
+	return fz_open_fd_mapped(ctx, open_file_fd(ctx, name));
+}
+
 /* Memory stream */
 
 static int next_buffer(fz_context *ctx, fz_stream *stm, int max)
@@ -163,9 +299,22 @@ static int next_buffer(fz_context *ctx, fz_stream *stm, int max)
 	return EOF;
 }
 
-static void seek_buffer(fz_context *ctx, fz_stream *stm, int offset, int whence)
+static int meta_buffer(fz_context *ctx, fz_stream *stm, int key, int size, void *ptr)
+{
+	if (key == FZ_STREAM_META_MEMORY && ptr && size == sizeof(fz_stream_memory))
+	{
+		fz_stream_memory *mem = ptr;
+		mem->data = stm->wp - stm->pos;
+		mem->len = stm->pos;
+		mem->buffer = NULL;
+		return 1;
+	}
+	return -1;
+}
+
+static void seek_buffer(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence)
 {
-	int pos = stm->pos - (stm->wp - stm->rp);
+	fz_off_t pos = stm->pos - (stm->wp - stm->rp);
 	/* Convert to absolute pos */
 	if (whence == 1)
 	{
@@ -198,6 +347,7 @@ fz_open_buffer(fz_context *ctx, fz_buffer *buf)
 	fz_keep_buffer(ctx, buf);
 	stm = fz_new_stream(ctx, buf, next_buffer, close_buffer);
 	stm->seek = seek_buffer;
+	stm->meta = meta_buffer;
 
 	stm->rp = buf->data;
 	stm->wp = buf->data + buf->len;
@@ -214,6 +364,7 @@ fz_open_memory(fz_context *ctx, unsigned char *data, int len)
 
 	stm = fz_new_stream(ctx, NULL, next_buffer, close_buffer);
 	stm->seek = seek_buffer;
+	stm->meta = meta_buffer;
 
 	stm->rp = data;
 	stm->wp = data + len;
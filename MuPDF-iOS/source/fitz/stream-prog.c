@@ -5,10 +5,10 @@
 #include "windows.h"
 
 static void
-show_progress(int av, int pos)
+show_progress(fz_off_t av, fz_off_t pos)
 {
 	char text[80];
-	sprintf(text, "Have %d, Want %d\n", av, pos);
+	sprintf(text, "Have %" FZ_FMT_OFF ", Want %" FZ_FMT_OFF "\n", av, pos);
 	OutputDebugStringA(text);
 }
 #else
@@ -20,8 +20,8 @@ show_progress(int av, int pos)
 typedef struct prog_state
 {
 	int fd;
-	int length;
-	int available;
+	fz_off_t length;
+	fz_off_t available;
 	int bps;
 	clock_t start_time;
 	unsigned char buffer[4096];
@@ -39,7 +39,7 @@ static int next_prog(fz_context *ctx, fz_stream *stm, int len)
 	/* Simulate more data having arrived */
 	if (ps->available < ps->length)
 	{
-		int av = (int)((float)(clock() - ps->start_time) * ps->bps / (CLOCKS_PER_SEC*8));
+		fz_off_t av = (fz_off_t)((float)(clock() - ps->start_time) * ps->bps / (CLOCKS_PER_SEC*8));
 		if (av > ps->length)
 			av = ps->length;
 		ps->available = av;
@@ -66,15 +66,15 @@ static int next_prog(fz_context *ctx, fz_stream *stm, int len)
 	return *stm->rp++;
 }
 
-static void seek_prog(fz_context *ctx, fz_stream *stm, int offset, int whence)
+static void seek_prog(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence)
 {
 	prog_state *ps = (prog_state *)stm->state;
-	int n;
+	fz_off_t n;
 
 	/* Simulate more data having arrived */
 	if (ps->available < ps->length)
 	{
-		int av = (int)((float)(clock() - ps->start_time) * ps->bps / (CLOCKS_PER_SEC*8));
+		fz_off_t av = (fz_off_t)((float)(clock() - ps->start_time) * ps->bps / (CLOCKS_PER_SEC*8));
 		if (av > ps->length)
 			av = ps->length;
 		ps->available = av;
@@ -106,7 +106,7 @@ static void seek_prog(fz_context *ctx, fz_stream *stm, int offset, int whence)
 		}
 	}
 
-	n = lseek(ps->fd, offset, whence);
+	n = fz_lseek(ps->fd, offset, whence);
 	if (n < 0)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot lseek: %s", strerror(errno));
 	stm->pos = n;
@@ -148,8 +148,8 @@ fz_open_fd_progressive(fz_context *ctx, int fd, int bps)
 	state->start_time = clock();
 	state->available = 0;
 
-	state->length = lseek(state->fd, 0, SEEK_END);
-	lseek(state->fd, 0, SEEK_SET);
+	state->length = fz_lseek(state->fd, 0, SEEK_END);
+	fz_lseek(state->fd, 0, SEEK_SET);
 
 	fz_try(ctx)
 	{
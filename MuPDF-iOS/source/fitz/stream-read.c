@@ -33,10 +33,29 @@ fz_read_all(fz_context *ctx, fz_stream *stm, int initial)
 	return fz_read_best(ctx, stm, initial, NULL);
 }
 
+/* Data in memory owned by a buffer can be shared rather than copied */
+static fz_buffer *
+fz_read_shared(fz_context *ctx, fz_stream *stm)
+{
+	fz_stream_memory mem;
+	fz_buffer *buf;
+	fz_off_t pos;
+
+	if (fz_stream_meta(ctx, stm, FZ_STREAM_META_MEMORY, sizeof mem, &mem) <= 0 || !mem.buffer)
+		return NULL;
+	pos = fz_tell(ctx, stm);
+	if (pos < 0 || pos > mem.len)
+		return NULL;
+	buf = fz_new_buffer_slice(ctx, mem.buffer, (mem.data - mem.buffer->data) + pos, mem.len - pos);
+	fz_seek(ctx, stm, 0, 2);
+	return buf;
+}
+
 fz_buffer *
 fz_read_best(fz_context *ctx, fz_stream *stm, int initial, int *truncated)
 {
 	fz_buffer *buf = NULL;
+	fz_off_t space;
 	int n;
 
 	fz_var(buf);
@@ -44,6 +63,10 @@ fz_read_best(fz_context *ctx, fz_stream *stm, int initial, int *truncated)
 	if (truncated)
 		*truncated = 0;
 
+	buf = fz_read_shared(ctx, stm);
+	if (buf)
+		return buf;
+
 	fz_try(ctx)
 	{
 		if (initial < 1024)
@@ -61,7 +84,10 @@ fz_read_best(fz_context *ctx, fz_stream *stm, int initial, int *truncated)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "compression bomb detected");
 			}
 
-			n = fz_read(ctx, stm, buf->data + buf->len, buf->cap - buf->len);
+			space = buf->cap - buf->len;
+			if (space > INT_MAX)
+				space = INT_MAX;
+			n = fz_read(ctx, stm, buf->data + buf->len, (int)space);
 			if (n == 0)
 				break;
 
@@ -114,14 +140,14 @@ fz_read_line(fz_context *ctx, fz_stream *stm, char *mem, int n)
 		*s = '\0';
 }
 
-int
+fz_off_t
 fz_tell(fz_context *ctx, fz_stream *stm)
 {
 	return stm->pos - (stm->wp - stm->rp);
 }
 
 void
-fz_seek(fz_context *ctx, fz_stream *stm, int offset, int whence)
+fz_seek(fz_context *ctx, fz_stream *stm, fz_off_t offset, int whence)
 {
 	stm->avail = 0; /* Reset bit reading */
 	if (stm->seek)
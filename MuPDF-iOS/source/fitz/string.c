@@ -337,3 +337,25 @@ int fz_atoi(const char *s)
 		return 0;
 	return atoi(s);
 }
+
+fz_off_t fz_atoo(const char *s)
+{
+	fz_off_t v = 0;
+	int neg = 0;
+
+	if (s == NULL)
+		return 0;
+	while (*s == ' ' || (*s >= '\t' && *s <= '\r'))
+		s++;
+	if (*s == '-')
+		neg = 1, s++;
+	else if (*s == '+')
+		s++;
+	while (*s >= '0' && *s <= '9')
+	{
+		if (v > (FZ_OFF_T_MAX - 9) / 10)
+			return neg ? -FZ_OFF_T_MAX : FZ_OFF_T_MAX;
+		v = v * 10 + (*s++ - '0');
+	}
+	return neg ? -v : v;
+}
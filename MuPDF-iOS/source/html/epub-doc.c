@@ -7,6 +7,21 @@
 typedef struct epub_document_s epub_document;
 typedef struct epub_chapter_s epub_chapter;
 typedef struct epub_page_s epub_page;
+typedef struct epub_chapter_key_s epub_chapter_key;
+typedef struct epub_chapter_box_s epub_chapter_box;
+
+/*
+	Chapters are parsed and laid out on demand, when a page in them is
+	first loaded. The resulting box trees live in the store, keyed on
+	the document and chapter number, so they can be evicted under memory
+	pressure and rebuilt later. Only the page count of each chapter is
+	kept in the document. Chapters that have not been laid out yet have
+	their page count estimated from those that have.
+
+	A stored box tree is never laid out again, as other pages may be
+	drawing it. A chapter needed at another page size is parsed and laid
+	out afresh, and replaces the stored one.
+*/
 
 struct epub_document_s
 {
@@ -20,8 +35,9 @@ struct epub_document_s
 
 struct epub_chapter_s
 {
-	int start;
-	fz_html *box;
+	char *path;
+	int number;
+	int pages; /* -1 if not yet laid out at the current page size */
 	epub_chapter *next;
 };
 
@@ -29,9 +45,247 @@ struct epub_page_s
 {
 	fz_page super;
 	epub_document *doc;
+	epub_chapter *ch;
+	int number; /* page number within the chapter */
+	float w, h, em; /* page size the number was found at */
+};
+
+struct epub_chapter_key_s
+{
+	int refs;
+	epub_document *doc; /* not kept; items are removed when the document is closed */
 	int number;
 };
 
+struct epub_chapter_box_s
+{
+	fz_storable storable;
+	fz_html *box;
+	float w, h, em;
+};
+
+static int
+epub_make_hash_chapter_key(fz_context *ctx, fz_store_hash *hash, void *key_)
+{
+	epub_chapter_key *key = (epub_chapter_key *)key_;
+	hash->u.pi.ptr = key->doc;
+	hash->u.pi.i = key->number;
+	return 1;
+}
+
+static void *
+epub_keep_chapter_key(fz_context *ctx, void *key_)
+{
+	epub_chapter_key *key = (epub_chapter_key *)key_;
+	return fz_keep_imp(ctx, key, &key->refs);
+}
+
+static void
+epub_drop_chapter_key(fz_context *ctx, void *key_)
+{
+	epub_chapter_key *key = (epub_chapter_key *)key_;
+	if (fz_drop_imp(ctx, key, &key->refs))
+		fz_free(ctx, key);
+}
+
+static int
+epub_cmp_chapter_key(fz_context *ctx, void *k0_, void *k1_)
+{
+	epub_chapter_key *k0 = (epub_chapter_key *)k0_;
+	epub_chapter_key *k1 = (epub_chapter_key *)k1_;
+	return k0->doc == k1->doc && k0->number == k1->number;
+}
+
+#ifndef NDEBUG
+static void
+epub_debug_chapter(fz_context *ctx, FILE *out, void *key_)
+{
+	epub_chapter_key *key = (epub_chapter_key *)key_;
+	fprintf(out, "(epub chapter %d) ", key->number);
+}
+#endif
+
+static fz_store_type epub_chapter_store_type =
+{
+	epub_make_hash_chapter_key,
+	epub_keep_chapter_key,
+	epub_drop_chapter_key,
+	epub_cmp_chapter_key,
+#ifndef NDEBUG
+	epub_debug_chapter
+#endif
+};
+
+static void
+epub_drop_chapter_box_imp(fz_context *ctx, fz_storable *box_)
+{
+	epub_chapter_box *box = (epub_chapter_box *)box_;
+	fz_drop_html(ctx, box->box);
+	fz_free(ctx, box);
+}
+
+static void
+epub_drop_chapter_box(fz_context *ctx, epub_chapter_box *box)
+{
+	fz_drop_storable(ctx, &box->storable);
+}
+
+static unsigned int
+epub_html_size(fz_html *box)
+{
+	unsigned int size = 0;
+	fz_html_flow *flow;
+	while (box)
+	{
+		size += sizeof *box;
+		for (flow = box->flow_head; flow; flow = flow->next)
+		{
+			size += sizeof *flow;
+			if (flow->type == FLOW_WORD)
+				size += strlen(flow->text) + 1;
+		}
+		size += epub_html_size(box->down);
+		box = box->next;
+	}
+	return size;
+}
+
+static epub_chapter_box *
+epub_parse_chapter(fz_context *ctx, epub_document *doc, epub_chapter *ch)
+{
+	fz_archive *zip = doc->zip;
+	fz_buffer *buf = NULL;
+	epub_chapter_box *box;
+	char base_uri[2048];
+
+	fz_dirname(base_uri, ch->path, sizeof base_uri);
+
+	box = fz_malloc_struct(ctx, epub_chapter_box);
+	FZ_INIT_STORABLE(box, 1, epub_drop_chapter_box_imp);
+
+	fz_var(buf);
+
+	fz_try(ctx)
+	{
+		buf = fz_read_archive_entry(ctx, zip, ch->path);
+		fz_write_buffer_byte(ctx, buf, 0);
+		box->box = fz_parse_html(ctx, doc->set, zip, base_uri, buf, NULL);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_buffer(ctx, buf);
+	}
+	fz_catch(ctx)
+	{
+		fz_free(ctx, box);
+		fz_rethrow(ctx);
+	}
+
+	return box;
+}
+
+static int
+epub_box_has_size(epub_chapter_box *box, float w, float h, float em)
+{
+	return box->w == w && box->h == h && box->em == em;
+}
+
+/*
+	Return the box tree for a chapter, laid out at the given page size.
+	At the current page size, this updates the chapter's page count.
+*/
+static epub_chapter_box *
+epub_load_chapter(fz_context *ctx, epub_document *doc, epub_chapter *ch, float w, float h, float em)
+{
+	epub_chapter_key key, *keyp = NULL;
+	epub_chapter_box *box, *existing = NULL;
+	int stale = 0;
+
+	key.refs = 1;
+	key.doc = doc;
+	key.number = ch->number;
+
+	box = fz_find_item(ctx, epub_drop_chapter_box_imp, &key, &epub_chapter_store_type);
+	if (box && !epub_box_has_size(box, w, h, em))
+	{
+		epub_drop_chapter_box(ctx, box);
+		box = NULL;
+		stale = 1;
+	}
+
+	if (!box)
+	{
+		fz_var(keyp);
+		fz_var(existing);
+		fz_var(stale);
+
+		box = epub_parse_chapter(ctx, doc, ch);
+		fz_try(ctx)
+		{
+			fz_layout_html(ctx, box->box, w, h, em);
+			box->w = w;
+			box->h = h;
+			box->em = em;
+
+			if (stale)
+				fz_remove_item(ctx, epub_drop_chapter_box_imp, &key, &epub_chapter_store_type);
+			keyp = fz_malloc_struct(ctx, epub_chapter_key);
+			*keyp = key;
+			existing = fz_store_item(ctx, keyp, box, epub_html_size(box->box), &epub_chapter_store_type);
+		}
+		fz_always(ctx)
+		{
+			if (keyp)
+				epub_drop_chapter_key(ctx, keyp);
+		}
+		fz_catch(ctx)
+		{
+			epub_drop_chapter_box(ctx, box);
+			fz_rethrow(ctx);
+		}
+
+		/* Another thread may have stored this chapter first, at its
+		 * own page size. Ours is still right for this call. */
+		if (existing && epub_box_has_size(existing, w, h, em))
+		{
+			epub_drop_chapter_box(ctx, box);
+			box = existing;
+		}
+		else if (existing)
+			epub_drop_chapter_box(ctx, existing);
+	}
+
+	if (w == doc->page_w && h == doc->page_h && em == doc->em)
+		ch->pages = ceilf(box->box->h / h);
+
+	return box;
+}
+
+/*
+	Find the chapter containing page number n, laying out all the
+	chapters preceding it so that page numbers are exact. Returns NULL
+	if n is past the end of the document.
+*/
+static epub_chapter *
+epub_find_page(fz_context *ctx, epub_document *doc, int n, int *page_in_chapter)
+{
+	epub_chapter *ch;
+	int count = 0;
+
+	for (ch = doc->spine; ch; ch = ch->next)
+	{
+		if (ch->pages < 0)
+			epub_drop_chapter_box(ctx, epub_load_chapter(ctx, doc, ch, doc->page_w, doc->page_h, doc->em));
+		if (n < count + ch->pages)
+		{
+			*page_in_chapter = n - count;
+			return ch;
+		}
+		count += ch->pages;
+	}
+	return NULL;
+}
+
 static void
 epub_layout(fz_context *ctx, fz_document *doc_, float w, float h, float em)
 {
@@ -42,10 +296,9 @@ epub_layout(fz_context *ctx, fz_document *doc_, float w, float h, float em)
 	doc->page_h = h;
 	doc->em = em;
 
-	printf("epub: laying out chapters.\n");
+	/* Chapters are laid out again as they are loaded. */
 	for (ch = doc->spine; ch; ch = ch->next)
-		fz_layout_html(ctx, ch->box, w, h, em);
-	printf("epub: done.\n");
+		ch->pages = -1;
 }
 
 static int
@@ -53,9 +306,28 @@ epub_count_pages(fz_context *ctx, fz_document *doc_)
 {
 	epub_document *doc = (epub_document*)doc_;
 	epub_chapter *ch;
-	int count = 0;
+	int count = 0, known = 0, known_pages = 0, unknown = 0;
+
 	for (ch = doc->spine; ch; ch = ch->next)
-		count += ceilf(ch->box->h / doc->page_h);
+	{
+		if (ch->pages >= 0)
+		{
+			known++;
+			known_pages += ch->pages;
+		}
+		else
+			unknown++;
+	}
+
+	/* Estimate the chapters we have not seen yet from those we have. */
+	count = known_pages;
+	if (unknown > 0)
+	{
+		if (known > 0)
+			count += (known_pages * unknown + known / 2) / known;
+		else
+			count += unknown;
+	}
 	return count;
 }
 
@@ -68,11 +340,10 @@ static fz_rect *
 epub_bound_page(fz_context *ctx, fz_page *page_, fz_rect *bbox)
 {
 	epub_page *page = (epub_page*)page_;
-	epub_document *doc = page->doc;
 	bbox->x0 = 0;
 	bbox->y0 = 0;
-	bbox->x1 = doc->page_w;
-	bbox->y1 = doc->page_h;
+	bbox->x1 = page->w;
+	bbox->y1 = page->h;
 	return bbox;
 }
 
@@ -81,19 +352,28 @@ epub_run_page(fz_context *ctx, fz_page *page_, fz_device *dev, const fz_matrix *
 {
 	epub_page *page = (epub_page*)page_;
 	epub_document *doc = page->doc;
-	epub_chapter *ch;
+	epub_chapter_box *box;
 	int n = page->number;
 
-	int count = 0;
-	for (ch = doc->spine; ch; ch = ch->next)
+	/* Pages past the end of an estimated page count are blank. */
+	if (!page->ch)
+		return;
+
+	/* Draw at the page size the page was loaded at, where its number
+	 * within the chapter is good, even if the document has been laid
+	 * out again since. */
+	box = epub_load_chapter(ctx, doc, page->ch, page->w, page->h, page->em);
+	fz_try(ctx)
 	{
-		int cn = ceilf(ch->box->h / doc->page_h);
-		if (n < count + cn)
-		{
-			fz_draw_html(ctx, ch->box, (n-count) * doc->page_h, (n-count+1) * doc->page_h, dev, ctm);
-			break;
-		}
-		count += cn;
+		fz_draw_html(ctx, box->box, n * page->h, (n+1) * page->h, dev, ctm);
+	}
+	fz_always(ctx)
+	{
+		epub_drop_chapter_box(ctx, box);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
 	}
 }
 
@@ -101,12 +381,22 @@ static fz_page *
 epub_load_page(fz_context *ctx, fz_document *doc_, int number)
 {
 	epub_document *doc = (epub_document*)doc_;
-	epub_page *page = fz_new_page(ctx, sizeof *page);
+	epub_chapter *ch;
+	epub_page *page;
+	int n = 0;
+
+	ch = epub_find_page(ctx, doc, number, &n);
+
+	page = fz_new_page(ctx, sizeof *page);
 	page->super.bound_page = epub_bound_page;
 	page->super.run_page_contents = epub_run_page;
 	page->super.drop_page_imp = epub_drop_page_imp;
 	page->doc = doc;
-	page->number = number;
+	page->ch = ch;
+	page->number = n;
+	page->w = doc->page_w;
+	page->h = doc->page_h;
+	page->em = doc->em;
 	return (fz_page*)page;
 }
 
@@ -115,11 +405,17 @@ epub_close_document(fz_context *ctx, fz_document *doc_)
 {
 	epub_document *doc = (epub_document*)doc_;
 	epub_chapter *ch, *next;
+	epub_chapter_key key;
+
+	key.refs = 1;
+	key.doc = doc;
 	ch = doc->spine;
 	while (ch)
 	{
 		next = ch->next;
-		fz_drop_html(ctx, ch->box);
+		key.number = ch->number;
+		fz_remove_item(ctx, epub_drop_chapter_box_imp, &key, &epub_chapter_store_type);
+		fz_free(ctx, ch->path);
 		fz_free(ctx, ch);
 		ch = next;
 	}
@@ -160,28 +456,6 @@ path_from_idref(char *path, fz_xml *manifest, const char *base_uri, const char *
 	return fz_cleanname(path);
 }
 
-static epub_chapter *
-epub_parse_chapter(fz_context *ctx, epub_document *doc, const char *path)
-{
-	fz_archive *zip = doc->zip;
-	fz_buffer *buf;
-	epub_chapter *ch;
-	char base_uri[2048];
-
-	fz_dirname(base_uri, path, sizeof base_uri);
-
-	buf = fz_read_archive_entry(ctx, zip, path);
-	fz_write_buffer_byte(ctx, buf, 0);
-
-	ch = fz_malloc_struct(ctx, epub_chapter);
-	ch->box = fz_parse_html(ctx, doc->set, zip, base_uri, buf, NULL);
-	ch->next = NULL;
-
-	fz_drop_buffer(ctx, buf);
-
-	return ch;
-}
-
 static void
 epub_parse_header(fz_context *ctx, epub_document *doc)
 {
@@ -193,7 +467,7 @@ epub_parse_header(fz_context *ctx, epub_document *doc)
 	char base_uri[2048];
 	const char *full_path;
 	char ncx[2048], s[2048];
-	epub_chapter *head, *tail;
+	epub_chapter *head, *tail, *ch;
 
 	/* parse META-INF/container.xml to find OPF */
 
@@ -237,16 +511,18 @@ epub_parse_header(fz_context *ctx, epub_document *doc)
 		if (path_from_idref(s, manifest, base_uri, fz_xml_att(itemref, "idref"), sizeof s))
 		{
 			printf("epub: found spine %s\n", s);
+			ch = fz_malloc_struct(ctx, epub_chapter);
+			ch->number = doc->count++;
+			ch->pages = -1;
 			if (!head)
-				head = tail = epub_parse_chapter(ctx, doc, s);
+				doc->spine = head = tail = ch;
 			else
-				tail = tail->next = epub_parse_chapter(ctx, doc, s);
+				tail = tail->next = ch;
+			ch->path = fz_strdup(ctx, s);
 		}
 		itemref = fz_xml_find_next(itemref, "itemref");
 	}
 
-	doc->spine = head;
-
 	printf("epub: done.\n");
 
 	fz_drop_xml(ctx, container_xml);
@@ -24,7 +24,7 @@ resolve_dest_rec(fz_context *ctx, pdf_document *doc, pdf_obj *dest, fz_link_kind
 
 	else if (pdf_is_dict(ctx, dest))
 	{
-		dest = pdf_dict_gets(ctx, dest, "D");
+		dest = pdf_dict_get(ctx, dest, PDF_NAME(D));
 		return resolve_dest_rec(ctx, doc, dest, kind, depth+1);
 	}
 
@@ -228,12 +228,12 @@ pdf_parse_file_spec(fz_context *ctx, pdf_document *doc, pdf_obj *file_spec)
 
 	if (pdf_is_dict(ctx, file_spec)) {
 #if defined(_WIN32) || defined(_WIN64)
-		filename = pdf_dict_gets(ctx, file_spec, "DOS");
+		filename = pdf_dict_get(ctx, file_spec, PDF_NAME(DOS));
 #else
-		filename = pdf_dict_gets(ctx, file_spec, "Unix");
+		filename = pdf_dict_get(ctx, file_spec, PDF_NAME(Unix));
 #endif
 		if (!filename)
-			filename = pdf_dict_getsa(ctx, file_spec, "UF", "F");
+			filename = pdf_dict_geta(ctx, file_spec, PDF_NAME(UF), PDF_NAME(F));
 	}
 
 	if (!pdf_is_string(ctx, filename))
@@ -244,7 +244,7 @@ pdf_parse_file_spec(fz_context *ctx, pdf_document *doc, pdf_obj *file_spec)
 
 	path = pdf_to_utf8(ctx, doc, filename);
 #if defined(_WIN32) || defined(_WIN64)
-	if (strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, file_spec, "FS")), "URL") != 0)
+	if (strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, file_spec, PDF_NAME(FS))), "URL") != 0)
 	{
 		/* move the file name into the expected place and use the expected path separator */
 		char *c;
@@ -274,38 +274,38 @@ pdf_parse_action(fz_context *ctx, pdf_document *doc, pdf_obj *action)
 	if (!action)
 		return ld;
 
-	obj = pdf_dict_gets(ctx, action, "S");
+	obj = pdf_dict_get(ctx, action, PDF_NAME(S));
 	if (!strcmp(pdf_to_name(ctx, obj), "GoTo"))
 	{
-		dest = pdf_dict_gets(ctx, action, "D");
+		dest = pdf_dict_get(ctx, action, PDF_NAME(D));
 		ld = pdf_parse_link_dest(ctx, doc, FZ_LINK_GOTO, dest);
 	}
 	else if (!strcmp(pdf_to_name(ctx, obj), "URI"))
 	{
 		ld.kind = FZ_LINK_URI;
-		ld.ld.uri.is_map = pdf_to_bool(ctx, pdf_dict_gets(ctx, action, "IsMap"));
-		ld.ld.uri.uri = pdf_to_utf8(ctx, doc, pdf_dict_gets(ctx, action, "URI"));
+		ld.ld.uri.is_map = pdf_to_bool(ctx, pdf_dict_get(ctx, action, PDF_NAME(IsMap)));
+		ld.ld.uri.uri = pdf_to_utf8(ctx, doc, pdf_dict_get(ctx, action, PDF_NAME(URI)));
 	}
 	else if (!strcmp(pdf_to_name(ctx, obj), "Launch"))
 	{
 		ld.kind = FZ_LINK_LAUNCH;
-		file_spec = pdf_dict_gets(ctx, action, "F");
+		file_spec = pdf_dict_get(ctx, action, PDF_NAME(F));
 		ld.ld.launch.file_spec = pdf_parse_file_spec(ctx, doc, file_spec);
-		ld.ld.launch.new_window = pdf_to_int(ctx, pdf_dict_gets(ctx, action, "NewWindow"));
-		ld.ld.launch.is_uri = !strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, file_spec, "FS")), "URL");
+		ld.ld.launch.new_window = pdf_to_int(ctx, pdf_dict_get(ctx, action, PDF_NAME(NewWindow)));
+		ld.ld.launch.is_uri = !strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, file_spec, PDF_NAME(FS))), "URL");
 	}
 	else if (!strcmp(pdf_to_name(ctx, obj), "Named"))
 	{
 		ld.kind = FZ_LINK_NAMED;
-		ld.ld.named.named = fz_strdup(ctx, pdf_to_name(ctx, pdf_dict_gets(ctx, action, "N")));
+		ld.ld.named.named = fz_strdup(ctx, pdf_to_name(ctx, pdf_dict_get(ctx, action, PDF_NAME(N))));
 	}
 	else if (!strcmp(pdf_to_name(ctx, obj), "GoToR"))
 	{
-		dest = pdf_dict_gets(ctx, action, "D");
-		file_spec = pdf_dict_gets(ctx, action, "F");
+		dest = pdf_dict_get(ctx, action, PDF_NAME(D));
+		file_spec = pdf_dict_get(ctx, action, PDF_NAME(F));
 		ld = pdf_parse_link_dest(ctx, doc, FZ_LINK_GOTOR, dest);
 		ld.ld.gotor.file_spec = pdf_parse_file_spec(ctx, doc, file_spec);
-		ld.ld.gotor.new_window = pdf_to_int(ctx, pdf_dict_gets(ctx, action, "NewWindow"));
+		ld.ld.gotor.new_window = pdf_to_int(ctx, pdf_dict_get(ctx, action, PDF_NAME(NewWindow)));
 	}
 	return ld;
 }
@@ -318,7 +318,7 @@ pdf_load_link(fz_context *ctx, pdf_document *doc, pdf_obj *dict, const fz_matrix
 	fz_rect bbox;
 	fz_link_dest ld;
 
-	obj = pdf_dict_gets(ctx, dict, "Rect");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Rect));
 	if (obj)
 		pdf_to_rect(ctx, obj, &bbox);
 	else
@@ -326,15 +326,15 @@ pdf_load_link(fz_context *ctx, pdf_document *doc, pdf_obj *dict, const fz_matrix
 
 	fz_transform_rect(&bbox, page_ctm);
 
-	obj = pdf_dict_gets(ctx, dict, "Dest");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Dest));
 	if (obj)
 		ld = pdf_parse_link_dest(ctx, doc, FZ_LINK_GOTO, obj);
 	else
 	{
-		action = pdf_dict_gets(ctx, dict, "A");
+		action = pdf_dict_get(ctx, dict, PDF_NAME(A));
 		/* fall back to additional action button's down/up action */
 		if (!action)
-			action = pdf_dict_getsa(ctx, pdf_dict_gets(ctx, dict, "AA"), "U", "D");
+			action = pdf_dict_geta(ctx, pdf_dict_get(ctx, dict, PDF_NAME(AA)), PDF_NAME(U), PDF_NAME(D));
 
 		ld = pdf_parse_action(ctx, doc, action);
 	}
@@ -423,7 +423,7 @@ pdf_transform_annot(fz_context *ctx, pdf_annot *annot)
 
 fz_annot_type pdf_annot_obj_type(fz_context *ctx, pdf_obj *obj)
 {
-	char *subtype = pdf_to_name(ctx, pdf_dict_gets(ctx, obj, "Subtype"));
+	char *subtype = pdf_to_name(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Subtype)));
 	if (!strcmp(subtype, "Text"))
 		return FZ_ANNOT_TEXT;
 	else if (!strcmp(subtype, "Link"))
@@ -538,9 +538,9 @@ pdf_load_annots(fz_context *ctx, pdf_document *doc, pdf_page *page, pdf_obj *ann
 				doc->update_appearance(ctx, doc, annot);
 
 			obj = annot->obj;
-			rect = pdf_dict_gets(ctx, obj, "Rect");
-			ap = pdf_dict_gets(ctx, obj, "AP");
-			as = pdf_dict_gets(ctx, obj, "AS");
+			rect = pdf_dict_get(ctx, obj, PDF_NAME(Rect));
+			ap = pdf_dict_get(ctx, obj, PDF_NAME(AP));
+			as = pdf_dict_get(ctx, obj, PDF_NAME(AS));
 
 			/* We only collect annotations with an appearance
 			 * stream into this list, so remove any that don't
@@ -553,11 +553,11 @@ pdf_load_annots(fz_context *ctx, pdf_document *doc, pdf_page *page, pdf_obj *ann
 				&& hp->gen == pdf_to_gen(ctx, obj)
 				&& (hp->state & HOTSPOT_POINTER_DOWN))
 			{
-				n = pdf_dict_gets(ctx, ap, "D"); /* down state */
+				n = pdf_dict_get(ctx, ap, PDF_NAME(D)); /* down state */
 			}
 
 			if (n == NULL)
-				n = pdf_dict_gets(ctx, ap, "N"); /* normal state */
+				n = pdf_dict_get(ctx, ap, PDF_NAME(N)); /* normal state */
 
 			/* lookup current state in sub-dictionary */
 			if (!pdf_is_stream(ctx, doc, pdf_to_num(ctx, n), pdf_to_gen(ctx, n)))
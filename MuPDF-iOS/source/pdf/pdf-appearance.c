@@ -164,7 +164,7 @@ static void get_font_info(fz_context *ctx, pdf_document *doc, pdf_obj *dr, char
 	if (font_rec->da_rec.font_name == NULL)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "No font name in default appearance");
 
-	font_rec->font = font = pdf_load_font(ctx, doc, dr, pdf_dict_gets(ctx, pdf_dict_gets(ctx, dr, "Font"), font_rec->da_rec.font_name), 0);
+	font_rec->font = font = pdf_load_font(ctx, doc, dr, pdf_dict_gets(ctx, pdf_dict_get(ctx, dr, PDF_NAME(Font)), font_rec->da_rec.font_name), 0);
 	font_rec->lineheight = 1.0;
 	if (font && font->ascent != 0.0f && font->descent != 0.0f)
 		font_rec->lineheight = (font->ascent - font->descent) / 1000.0;
@@ -784,7 +784,7 @@ static int get_matrix(fz_context *ctx, pdf_document *doc, pdf_xobject *form, int
 		if (found)
 		{
 			fz_rect bbox;
-			pdf_to_rect(ctx, pdf_dict_gets(ctx, form->contents, "BBox"), &bbox);
+			pdf_to_rect(ctx, pdf_dict_get(ctx, form->contents, PDF_NAME(BBox)), &bbox);
 
 			switch (q)
 			{
@@ -938,17 +938,17 @@ static pdf_xobject *load_or_create_form(fz_context *ctx, pdf_document *doc, pdf_
 	fz_try(ctx)
 	{
 		rot = pdf_to_int(ctx, pdf_dict_getp(ctx, obj, "MK/R"));
-		pdf_to_rect(ctx, pdf_dict_gets(ctx, obj, "Rect"), rect);
+		pdf_to_rect(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Rect)), rect);
 		rect->x1 -= rect->x0;
 		rect->y1 -= rect->y0;
 		rect->x0 = rect->y0 = 0;
 		account_for_rot(rect, &mat, rot);
 
-		ap = pdf_dict_gets(ctx, obj, "AP");
+		ap = pdf_dict_get(ctx, obj, PDF_NAME(AP));
 		if (ap == NULL)
 		{
 			ap = pdf_new_dict(ctx, doc, 1);
-			pdf_dict_puts_drop(ctx, obj, "AP", ap);
+			pdf_dict_put_drop(ctx, obj, PDF_NAME(AP), ap);
 		}
 
 		formobj = pdf_dict_gets(ctx, ap, dn);
@@ -1330,7 +1330,7 @@ void pdf_update_text_markup_appearance(fz_context *ctx, pdf_document *doc, pdf_a
 
 static void update_rect(fz_context *ctx, pdf_annot *annot)
 {
-	pdf_to_rect(ctx, pdf_dict_gets(ctx, annot->obj, "Rect"), &annot->rect);
+	pdf_to_rect(ctx, pdf_dict_get(ctx, annot->obj, PDF_NAME(Rect)), &annot->rect);
 	annot->pagerect = annot->rect;
 	fz_transform_rect(&annot->pagerect, &annot->page->ctm);
 }
@@ -1354,7 +1354,7 @@ void pdf_set_annot_appearance(fz_context *ctx, pdf_document *doc, pdf_annot *ann
 
 		fz_transform_rect(&trect, &ctm);
 
-		pdf_dict_puts_drop(ctx, obj, "Rect", pdf_new_rect(ctx, doc, &trect));
+		pdf_dict_put_drop(ctx, obj, PDF_NAME(Rect), pdf_new_rect(ctx, doc, &trect));
 
 		/* See if there is a current normal appearance */
 		ap_obj = pdf_dict_getp(ctx, obj, "AP/N");
@@ -1370,11 +1370,11 @@ void pdf_set_annot_appearance(fz_context *ctx, pdf_document *doc, pdf_annot *ann
 		{
 			pdf_xref_ensure_incremental_object(ctx, doc, pdf_to_num(ctx, ap_obj));
 			/* Update bounding box and matrix in reused xobject obj */
-			pdf_dict_puts_drop(ctx, ap_obj, "BBox", pdf_new_rect(ctx, doc, &trect));
-			pdf_dict_puts_drop(ctx, ap_obj, "Matrix", pdf_new_matrix(ctx, doc, &mat));
+			pdf_dict_put_drop(ctx, ap_obj, PDF_NAME(BBox), pdf_new_rect(ctx, doc, &trect));
+			pdf_dict_put_drop(ctx, ap_obj, PDF_NAME(Matrix), pdf_new_matrix(ctx, doc, &mat));
 		}
 
-		dev = pdf_new_pdf_device(ctx, doc, ap_obj, pdf_dict_gets(ctx, ap_obj, "Resources"), &mat, NULL);
+		dev = pdf_new_pdf_device(ctx, doc, ap_obj, pdf_dict_get(ctx, ap_obj, PDF_NAME(Resources)), &mat, NULL);
 		fz_run_display_list(ctx, disp_list, dev, &ctm, &fz_infinite_rect, NULL);
 		fz_drop_device(ctx, dev);
 
@@ -1403,7 +1403,7 @@ void pdf_set_annot_appearance(fz_context *ctx, pdf_document *doc, pdf_annot *ann
 static fz_point *
 quadpoints(fz_context *ctx, pdf_document *doc, pdf_obj *annot, int *nout)
 {
-	pdf_obj *quad = pdf_dict_gets(ctx, annot, "QuadPoints");
+	pdf_obj *quad = pdf_dict_get(ctx, annot, PDF_NAME(QuadPoints));
 	fz_point *qp = NULL;
 	int i, n;
 
@@ -1568,7 +1568,7 @@ void pdf_update_ink_appearance(fz_context *ctx, pdf_document *doc, pdf_annot *an
 		int n, m, i, j;
 		int empty = 1;
 
-		cs = pdf_to_color(ctx, doc, pdf_dict_gets(ctx, annot->obj, "C"), color);
+		cs = pdf_to_color(ctx, doc, pdf_dict_get(ctx, annot->obj, PDF_NAME(C)), color);
 		if (!cs)
 		{
 			cs = fz_device_rgb(ctx);
@@ -1577,11 +1577,11 @@ void pdf_update_ink_appearance(fz_context *ctx, pdf_document *doc, pdf_annot *an
 			color[2] = 0.0f;
 		}
 
-		width = pdf_to_real(ctx, pdf_dict_gets(ctx, pdf_dict_gets(ctx, annot->obj, "BS"), "W"));
+		width = pdf_to_real(ctx, pdf_dict_get(ctx, pdf_dict_get(ctx, annot->obj, PDF_NAME(BS)), PDF_NAME(W)));
 		if (width == 0.0f)
 			width = 1.0f;
 
-		list = pdf_dict_gets(ctx, annot->obj, "InkList");
+		list = pdf_dict_get(ctx, annot->obj, PDF_NAME(InkList));
 
 		n = pdf_array_len(ctx, list);
 
@@ -1857,7 +1857,7 @@ void pdf_update_text_annot_appearance(fz_context *ctx, pdf_document *doc, pdf_an
 		fz_rect bounds;
 		fz_matrix tm;
 
-		pdf_to_rect(ctx, pdf_dict_gets(ctx, annot->obj, "Rect"), &rect);
+		pdf_to_rect(ctx, pdf_dict_get(ctx, annot->obj, PDF_NAME(Rect)), &rect);
 		dlist = fz_new_display_list(ctx);
 		dev = fz_new_list_device(ctx, dlist);
 		stroke = fz_new_stroke_state(ctx);
@@ -1926,8 +1926,8 @@ void pdf_update_free_text_annot_appearance(fz_context *ctx, pdf_document *doc, p
 	fz_var(cs);
 	fz_try(ctx)
 	{
-		char *contents = pdf_to_str_buf(ctx, pdf_dict_gets(ctx, obj, "Contents"));
-		char *da = pdf_to_str_buf(ctx, pdf_dict_gets(ctx, obj, "DA"));
+		char *contents = pdf_to_str_buf(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Contents)));
+		char *da = pdf_to_str_buf(ctx, pdf_dict_get(ctx, obj, PDF_NAME(DA)));
 		fz_rect rect = annot->rect;
 		fz_point pos;
 
@@ -2036,7 +2036,7 @@ static void insert_signature_appearance_layers(fz_context *ctx, pdf_document *do
 	fz_rect bbox;
 	fz_buffer *fzbuf = NULL;
 
-	pdf_to_rect(ctx, pdf_dict_gets(ctx, ap, "BBox"), &bbox);
+	pdf_to_rect(ctx, pdf_dict_get(ctx, ap, PDF_NAME(BBox)), &bbox);
 
 	fz_var(main_ap);
 	fz_var(frm);
@@ -2052,7 +2052,7 @@ static void insert_signature_appearance_layers(fz_context *ctx, pdf_document *do
 		fzbuf = fz_new_buffer(ctx, 8);
 		fz_buffer_printf(ctx, fzbuf, "/FRM Do");
 		pdf_update_stream(ctx, doc, pdf_to_num(ctx, main_ap), fzbuf);
-		pdf_dict_puts_drop(ctx, main_ap, "Length", pdf_new_int(ctx, doc, fzbuf->len));
+		pdf_dict_put_drop(ctx, main_ap, PDF_NAME(Length), pdf_new_int(ctx, doc, fzbuf->len));
 		fz_drop_buffer(ctx, fzbuf);
 		fzbuf = NULL;
 
@@ -2061,14 +2061,14 @@ static void insert_signature_appearance_layers(fz_context *ctx, pdf_document *do
 		fzbuf = fz_new_buffer(ctx, 8);
 		fz_buffer_printf(ctx, fzbuf, "q 1 0 0 1 0 0 cm /n0 Do Q q 1 0 0 1 0 0 cm /n2 Do Q");
 		pdf_update_stream(ctx, doc, pdf_to_num(ctx, frm), fzbuf);
-		pdf_dict_puts_drop(ctx, frm, "Length", pdf_new_int(ctx, doc, fzbuf->len));
+		pdf_dict_put_drop(ctx, frm, PDF_NAME(Length), pdf_new_int(ctx, doc, fzbuf->len));
 		fz_drop_buffer(ctx, fzbuf);
 		fzbuf = NULL;
 
 		fzbuf = fz_new_buffer(ctx, 8);
 		fz_buffer_printf(ctx, fzbuf, "%% DSBlank");
 		pdf_update_stream(ctx, doc, pdf_to_num(ctx, n0), fzbuf);
-		pdf_dict_puts_drop(ctx, n0, "Length", pdf_new_int(ctx, doc, fzbuf->len));
+		pdf_dict_put_drop(ctx, n0, PDF_NAME(Length), pdf_new_int(ctx, doc, fzbuf->len));
 		fz_drop_buffer(ctx, fzbuf);
 		fzbuf = NULL;
 
@@ -2116,7 +2116,7 @@ void pdf_set_signature_appearance(fz_context *ctx, pdf_document *doc, pdf_annot
 	fz_var(fzbuf);
 	fz_try(ctx)
 	{
-		char *da = pdf_to_str_buf(ctx, pdf_dict_gets(ctx, obj, "DA"));
+		char *da = pdf_to_str_buf(ctx, pdf_dict_get(ctx, obj, PDF_NAME(DA)));
 		fz_rect rect = annot->rect;
 		fz_rect logo_bounds;
 		fz_matrix logo_tm;
@@ -2193,7 +2193,7 @@ void pdf_set_signature_appearance(fz_context *ctx, pdf_document *doc, pdf_annot
 void pdf_update_appearance(fz_context *ctx, pdf_document *doc, pdf_annot *annot)
 {
 	pdf_obj *obj = annot->obj;
-	if (!pdf_dict_gets(ctx, obj, "AP") || pdf_obj_is_dirty(ctx, obj))
+	if (!pdf_dict_get(ctx, obj, PDF_NAME(AP)) || pdf_obj_is_dirty(ctx, obj))
 	{
 		fz_annot_type type = pdf_annot_obj_type(ctx, obj);
 		switch (type)
@@ -21,7 +21,7 @@ pdf_clean_stream_object(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf_ob
 	{
 		if (own_res)
 		{
-			pdf_obj *r = pdf_dict_gets(ctx, obj, "Resources");
+			pdf_obj *r = pdf_dict_get(ctx, obj, PDF_NAME(Resources));
 			if (r)
 				orig_res = r;
 		}
@@ -34,13 +34,13 @@ pdf_clean_stream_object(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf_ob
 		pdf_process_stream_object(ctx, doc, obj, &process, orig_res, cookie);
 
 		num = pdf_to_num(ctx, obj);
-		pdf_dict_dels(ctx, obj, "Filter");
+		pdf_dict_del(ctx, obj, PDF_NAME(Filter));
 		pdf_update_stream(ctx, doc, num, buffer);
 
 		if (own_res)
 		{
 			ref = pdf_new_ref(ctx, doc, res);
-			pdf_dict_puts(ctx, obj, "Resources", ref);
+			pdf_dict_put(ctx, obj, PDF_NAME(Resources), ref);
 		}
 	}
 	fz_always(ctx)
@@ -70,14 +70,14 @@ pdf_clean_type3(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf_obj *orig_
 
 	fz_try(ctx)
 	{
-		res = pdf_dict_gets(ctx, obj, "Resources");
+		res = pdf_dict_get(ctx, obj, PDF_NAME(Resources));
 		if (res)
 			orig_res = res;
 		res = NULL;
 
 		res = pdf_new_dict(ctx, doc, 1);
 
-		charprocs = pdf_dict_gets(ctx, obj, "CharProcs");
+		charprocs = pdf_dict_get(ctx, obj, PDF_NAME(CharProcs));
 		l = pdf_dict_len(ctx, charprocs);
 
 		for (i = 0; i < l; i++)
@@ -92,7 +92,7 @@ pdf_clean_type3(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf_obj *orig_
 			pdf_process_stream_object(ctx, doc, val, &process, orig_res, cookie);
 
 			num = pdf_to_num(ctx, val);
-			pdf_dict_dels(ctx, val, "Filter");
+			pdf_dict_del(ctx, val, PDF_NAME(Filter));
 			pdf_update_stream(ctx, doc, num, buffer);
 			pdf_dict_put(ctx, charprocs, key, val);
 			fz_drop_buffer(ctx, buffer);
@@ -100,10 +100,10 @@ pdf_clean_type3(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf_obj *orig_
 		}
 
 		/* ProcSet - no cleaning possible. Inherit this from the old dict. */
-		pdf_dict_puts(ctx, res, "ProcSet", pdf_dict_gets(ctx, orig_res, "ProcSet"));
+		pdf_dict_put(ctx, res, PDF_NAME(ProcSet), pdf_dict_get(ctx, orig_res, PDF_NAME(ProcSet)));
 
 		ref = pdf_new_ref(ctx, doc, res);
-		pdf_dict_puts(ctx, obj, "Resources", ref);
+		pdf_dict_put(ctx, obj, PDF_NAME(Resources), ref);
 	}
 	fz_always(ctx)
 	{
@@ -159,12 +159,12 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 			new_ref = pdf_new_ref(ctx, doc, new_obj);
 			num = pdf_to_num(ctx, new_ref);
 			pdf_array_put(ctx, contents, 0, new_ref);
-			pdf_dict_dels(ctx, new_obj, "Filter");
+			pdf_dict_del(ctx, new_obj, PDF_NAME(Filter));
 		}
 		else
 		{
 			num = pdf_to_num(ctx, contents);
-			pdf_dict_dels(ctx, contents, "Filter");
+			pdf_dict_del(ctx, contents, PDF_NAME(Filter));
 		}
 
 		/* Now deal with resources. The spec allows for Type3 fonts and form
@@ -173,7 +173,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 		 * conceivably cause changes in rendering, but we don't care. */
 
 		/* ExtGState */
-		obj = pdf_dict_gets(ctx, res, "ExtGState");
+		obj = pdf_dict_get(ctx, res, PDF_NAME(ExtGState));
 		if (obj)
 		{
 			int i, l;
@@ -181,11 +181,11 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 			l = pdf_dict_len(ctx, obj);
 			for (i = 0; i < l; i++)
 			{
-				pdf_obj *o = pdf_dict_gets(ctx, pdf_dict_get_val(ctx, obj, i), "SMask");
+				pdf_obj *o = pdf_dict_get(ctx, pdf_dict_get_val(ctx, obj, i), PDF_NAME(SMask));
 
 				if (!o)
 					continue;
-				o = pdf_dict_gets(ctx, o, "G");
+				o = pdf_dict_get(ctx, o, PDF_NAME(G));
 				if (!o)
 					continue;
 
@@ -197,7 +197,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 		/* ColorSpace - no cleaning possible */
 
 		/* Pattern */
-		obj = pdf_dict_gets(ctx, res, "Pattern");
+		obj = pdf_dict_get(ctx, res, PDF_NAME(Pattern));
 		if (obj)
 		{
 			int i, l;
@@ -209,7 +209,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 
 				if (!pat)
 					continue;
-				if (pdf_to_int(ctx, pdf_dict_gets(ctx, pat, "PatternType")) == 1)
+				if (pdf_to_int(ctx, pdf_dict_get(ctx, pat, PDF_NAME(PatternType))) == 1)
 					pdf_clean_stream_object(ctx, doc, pat, page->resources, cookie, 0);
 			}
 		}
@@ -217,7 +217,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 		/* Shading - no cleaning possible */
 
 		/* XObject */
-		obj = pdf_dict_gets(ctx, res, "XObject");
+		obj = pdf_dict_get(ctx, res, PDF_NAME(XObject));
 		if (obj)
 		{
 			int i, l;
@@ -227,7 +227,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 			{
 				pdf_obj *xobj = pdf_dict_get_val(ctx, obj, i);
 
-				if (strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, xobj, "Subtype")), "Form"))
+				if (strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, xobj, PDF_NAME(Subtype))), "Form"))
 					continue;
 
 				pdf_clean_stream_object(ctx, doc, xobj, page->resources, cookie, 1);
@@ -235,7 +235,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 		}
 
 		/* Font */
-		obj = pdf_dict_gets(ctx, res, "Font");
+		obj = pdf_dict_get(ctx, res, PDF_NAME(Font));
 		if (obj)
 		{
 			int i, l;
@@ -245,7 +245,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 			{
 				pdf_obj *o = pdf_dict_get_val(ctx, obj, i);
 
-				if (!strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, o, "Subtype")), "Type3"))
+				if (!strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, o, PDF_NAME(Subtype))), "Type3"))
 				{
 					pdf_clean_type3(ctx, doc, o, page->resources, cookie);
 				}
@@ -253,9 +253,9 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 		}
 
 		/* ProcSet - no cleaning possible. Inherit this from the old dict. */
-		obj = pdf_dict_gets(ctx, page->resources, "ProcSet");
+		obj = pdf_dict_get(ctx, page->resources, PDF_NAME(ProcSet));
 		if (obj)
-			pdf_dict_puts(ctx, res, "ProcSet", obj);
+			pdf_dict_put(ctx, res, PDF_NAME(ProcSet), obj);
 
 		/* Properties - no cleaning possible. */
 
@@ -266,7 +266,7 @@ void pdf_clean_page_contents(fz_context *ctx, pdf_document *doc, pdf_page *page,
 		pdf_drop_obj(ctx, page->resources);
 		ref = pdf_new_ref(ctx, doc, res);
 		page->resources = pdf_keep_obj(ctx, ref);
-		pdf_dict_puts(ctx, page->me, "Resources", ref);
+		pdf_dict_put(ctx, page->me, PDF_NAME(Resources), ref);
 	}
 	fz_always(ctx)
 	{
@@ -8,8 +8,8 @@ load_icc_based(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 	int n;
 	pdf_obj *obj;
 
-	n = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "N"));
-	obj = pdf_dict_gets(ctx, dict, "Alternate");
+	n = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(N)));
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Alternate));
 
 	if (obj)
 	{
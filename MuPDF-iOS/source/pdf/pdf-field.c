@@ -9,10 +9,10 @@ pdf_obj *pdf_get_inheritable(fz_context *ctx, pdf_document *doc, pdf_obj *obj, c
 		fobj = pdf_dict_gets(ctx, obj, key);
 
 		if (!fobj)
-			obj = pdf_dict_gets(ctx, obj, "Parent");
+			obj = pdf_dict_get(ctx, obj, PDF_NAME(Parent));
 	}
 
-	return fobj ? fobj : pdf_dict_gets(ctx, pdf_dict_gets(ctx, pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root"), "AcroForm"), key);
+	return fobj ? fobj : pdf_dict_gets(ctx, pdf_dict_get(ctx, pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root)), PDF_NAME(AcroForm)), key);
 }
 
 char *pdf_get_string_or_stream(fz_context *ctx, pdf_document *doc, pdf_obj *obj)
@@ -139,13 +139,13 @@ void pdf_set_field_type(fz_context *ctx, pdf_document *doc, pdf_obj *obj, int ty
 	}
 
 	if (typename)
-		pdf_dict_puts_drop(ctx, obj, "FT", pdf_new_name(ctx, doc, typename));
+		pdf_dict_put_drop(ctx, obj, PDF_NAME(FT), pdf_new_name(ctx, doc, typename));
 
 	if (setbits != 0 || clearbits != 0)
 	{
-		int bits = pdf_to_int(ctx, pdf_dict_gets(ctx, obj, "Ff"));
+		int bits = pdf_to_int(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Ff)));
 		bits &= ~clearbits;
 		bits |= setbits;
-		pdf_dict_puts_drop(ctx, obj, "Ff", pdf_new_int(ctx, doc, bits));
+		pdf_dict_put_drop(ctx, obj, PDF_NAME(Ff), pdf_new_int(ctx, doc, bits));
 	}
 }
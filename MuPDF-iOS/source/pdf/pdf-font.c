@@ -440,17 +440,17 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 	{
 		fontdesc = pdf_new_font_desc(ctx);
 
-		descriptor = pdf_dict_gets(ctx, dict, "FontDescriptor");
+		descriptor = pdf_dict_get(ctx, dict, PDF_NAME(FontDescriptor));
 		if (descriptor)
 			pdf_load_font_descriptor(ctx, doc, fontdesc, descriptor, NULL, basefont, 0);
 		else
 			pdf_load_builtin_font(ctx, fontdesc, basefont, 0);
 
 		/* Some chinese documents mistakenly consider WinAnsiEncoding to be codepage 936 */
-		if (descriptor && pdf_is_string(ctx, pdf_dict_gets(ctx, descriptor, "FontName")) &&
-			!pdf_dict_gets(ctx, dict, "ToUnicode") &&
-			!strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "Encoding")), "WinAnsiEncoding") &&
-			pdf_to_int(ctx, pdf_dict_gets(ctx, descriptor, "Flags")) == 4)
+		if (descriptor && pdf_is_string(ctx, pdf_dict_get(ctx, descriptor, PDF_NAME(FontName))) &&
+			!pdf_dict_get(ctx, dict, PDF_NAME(ToUnicode)) &&
+			!strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Encoding))), "WinAnsiEncoding") &&
+			pdf_to_int(ctx, pdf_dict_get(ctx, descriptor, PDF_NAME(Flags))) == 4)
 		{
 			char *cp936fonts[] = {
 				"\xCB\xCE\xCC\xE5", "SimSun,Regular",
@@ -530,7 +530,7 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 			etable[i] = 0;
 		}
 
-		encoding = pdf_dict_gets(ctx, dict, "Encoding");
+		encoding = pdf_dict_get(ctx, dict, PDF_NAME(Encoding));
 		if (encoding)
 		{
 			if (pdf_is_name(ctx, encoding))
@@ -540,13 +540,13 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 			{
 				pdf_obj *base, *diff, *item;
 
-				base = pdf_dict_gets(ctx, encoding, "BaseEncoding");
+				base = pdf_dict_get(ctx, encoding, PDF_NAME(BaseEncoding));
 				if (pdf_is_name(ctx, base))
 					pdf_load_encoding(estrings, pdf_to_name(ctx, base));
 				else if (!fontdesc->is_embedded && !symbolic)
 					pdf_load_encoding(estrings, "StandardEncoding");
 
-				diff = pdf_dict_gets(ctx, encoding, "Differences");
+				diff = pdf_dict_get(ctx, encoding, PDF_NAME(Differences));
 				if (pdf_is_array(ctx, diff))
 				{
 					n = pdf_array_len(ctx, diff);
@@ -573,7 +573,7 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 		has_lock = 1;
 
 		/* built-in and substitute fonts may be a different type than what the document expects */
-		subtype = pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "Subtype"));
+		subtype = pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Subtype)));
 		if (!strcmp(subtype, "Type1"))
 			kind = TYPE1;
 		else if (!strcmp(subtype, "MMType1"))
@@ -703,7 +703,7 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 
 		fz_try(ctx)
 		{
-			pdf_load_to_unicode(ctx, doc, fontdesc, estrings, NULL, pdf_dict_gets(ctx, dict, "ToUnicode"));
+			pdf_load_to_unicode(ctx, doc, fontdesc, estrings, NULL, pdf_dict_get(ctx, dict, PDF_NAME(ToUnicode)));
 		}
 		fz_catch(ctx)
 		{
@@ -717,13 +717,13 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 
 		pdf_set_default_hmtx(ctx, fontdesc, fontdesc->missing_width);
 
-		widths = pdf_dict_gets(ctx, dict, "Widths");
+		widths = pdf_dict_get(ctx, dict, PDF_NAME(Widths));
 		if (widths)
 		{
 			int first, last;
 
-			first = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "FirstChar"));
-			last = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "LastChar"));
+			first = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(FirstChar)));
+			last = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(LastChar)));
 
 			if (first < 0 || last > 255 || first > last)
 				first = last = 0;
@@ -766,7 +766,7 @@ pdf_load_simple_font_by_name(fz_context *ctx, pdf_document *doc, pdf_obj *dict,
 static pdf_font_desc *
 pdf_load_simple_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 {
-	char *basefont = pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "BaseFont"));
+	char *basefont = pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(BaseFont)));
 
 	return pdf_load_simple_font_by_name(ctx, doc, dict, basefont);
 }
@@ -861,18 +861,18 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 	{
 		/* Get font name and CID collection */
 
-		basefont = pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "BaseFont"));
+		basefont = pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(BaseFont)));
 
 		{
 			pdf_obj *cidinfo;
 			char tmpstr[64];
 			int tmplen;
 
-			cidinfo = pdf_dict_gets(ctx, dict, "CIDSystemInfo");
+			cidinfo = pdf_dict_get(ctx, dict, PDF_NAME(CIDSystemInfo));
 			if (!cidinfo)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "cid font is missing info");
 
-			obj = pdf_dict_gets(ctx, cidinfo, "Registry");
+			obj = pdf_dict_get(ctx, cidinfo, PDF_NAME(Registry));
 			tmplen = fz_mini(sizeof tmpstr - 1, pdf_to_str_len(ctx, obj));
 			memcpy(tmpstr, pdf_to_str_buf(ctx, obj), tmplen);
 			tmpstr[tmplen] = '\0';
@@ -880,7 +880,7 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 
 			fz_strlcat(collection, "-", sizeof collection);
 
-			obj = pdf_dict_gets(ctx, cidinfo, "Ordering");
+			obj = pdf_dict_get(ctx, cidinfo, PDF_NAME(Ordering));
 			tmplen = fz_mini(sizeof tmpstr - 1, pdf_to_str_len(ctx, obj));
 			memcpy(tmpstr, pdf_to_str_buf(ctx, obj), tmplen);
 			tmpstr[tmplen] = '\0';
@@ -916,7 +916,7 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 
 		pdf_set_font_wmode(ctx, fontdesc, pdf_cmap_wmode(ctx, fontdesc->encoding));
 
-		descriptor = pdf_dict_gets(ctx, dict, "FontDescriptor");
+		descriptor = pdf_dict_get(ctx, dict, PDF_NAME(FontDescriptor));
 		if (!descriptor)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "syntaxerror: missing font descriptor");
 		pdf_load_font_descriptor(ctx, doc, fontdesc, descriptor, collection, basefont, 1);
@@ -925,7 +925,7 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 
 		/* Apply encoding */
 
-		cidtogidmap = pdf_dict_gets(ctx, dict, "CIDToGIDMap");
+		cidtogidmap = pdf_dict_get(ctx, dict, PDF_NAME(CIDToGIDMap));
 		if (pdf_is_indirect(ctx, cidtogidmap))
 		{
 			fz_buffer *buf;
@@ -980,12 +980,12 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 		/* Horizontal */
 
 		dw = 1000;
-		obj = pdf_dict_gets(ctx, dict, "DW");
+		obj = pdf_dict_get(ctx, dict, PDF_NAME(DW));
 		if (obj)
 			dw = pdf_to_int(ctx, obj);
 		pdf_set_default_hmtx(ctx, fontdesc, dw);
 
-		widths = pdf_dict_gets(ctx, dict, "W");
+		widths = pdf_dict_get(ctx, dict, PDF_NAME(W));
 		if (widths)
 		{
 			int c0, c1, w, n, m;
@@ -1024,7 +1024,7 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 			int dw2y = 880;
 			int dw2w = -1000;
 
-			obj = pdf_dict_gets(ctx, dict, "DW2");
+			obj = pdf_dict_get(ctx, dict, PDF_NAME(DW2));
 			if (obj)
 			{
 				dw2y = pdf_to_int(ctx, pdf_array_get(ctx, obj, 0));
@@ -1033,7 +1033,7 @@ load_cid_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict, pdf_obj *encodi
 
 			pdf_set_default_vmtx(ctx, fontdesc, dw2y, dw2w);
 
-			widths = pdf_dict_gets(ctx, dict, "W2");
+			widths = pdf_dict_get(ctx, dict, PDF_NAME(W2));
 			if (widths)
 			{
 				int c0, c1, w, x, y, n;
@@ -1088,15 +1088,15 @@ pdf_load_type0_font(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 	pdf_obj *encoding;
 	pdf_obj *to_unicode;
 
-	dfonts = pdf_dict_gets(ctx, dict, "DescendantFonts");
+	dfonts = pdf_dict_get(ctx, dict, PDF_NAME(DescendantFonts));
 	if (!dfonts)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cid font is missing descendant fonts");
 
 	dfont = pdf_array_get(ctx, dfonts, 0);
 
-	subtype = pdf_dict_gets(ctx, dfont, "Subtype");
-	encoding = pdf_dict_gets(ctx, dict, "Encoding");
-	to_unicode = pdf_dict_gets(ctx, dict, "ToUnicode");
+	subtype = pdf_dict_get(ctx, dfont, PDF_NAME(Subtype));
+	encoding = pdf_dict_get(ctx, dict, PDF_NAME(Encoding));
+	to_unicode = pdf_dict_get(ctx, dict, PDF_NAME(ToUnicode));
 
 	if (pdf_is_name(ctx, subtype) && !strcmp(pdf_to_name(ctx, subtype), "CIDFontType0"))
 		return load_cid_font(ctx, doc, dfont, encoding, to_unicode);
@@ -1119,17 +1119,17 @@ pdf_load_font_descriptor(fz_context *ctx, pdf_document *doc, pdf_font_desc *font
 	/* Prefer BaseFont; don't bother with FontName */
 	fontname = basefont;
 
-	fontdesc->flags = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "Flags"));
-	fontdesc->italic_angle = pdf_to_real(ctx, pdf_dict_gets(ctx, dict, "ItalicAngle"));
-	fontdesc->ascent = pdf_to_real(ctx, pdf_dict_gets(ctx, dict, "Ascent"));
-	fontdesc->descent = pdf_to_real(ctx, pdf_dict_gets(ctx, dict, "Descent"));
-	fontdesc->cap_height = pdf_to_real(ctx, pdf_dict_gets(ctx, dict, "CapHeight"));
-	fontdesc->x_height = pdf_to_real(ctx, pdf_dict_gets(ctx, dict, "XHeight"));
-	fontdesc->missing_width = pdf_to_real(ctx, pdf_dict_gets(ctx, dict, "MissingWidth"));
-
-	obj1 = pdf_dict_gets(ctx, dict, "FontFile");
-	obj2 = pdf_dict_gets(ctx, dict, "FontFile2");
-	obj3 = pdf_dict_gets(ctx, dict, "FontFile3");
+	fontdesc->flags = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Flags)));
+	fontdesc->italic_angle = pdf_to_real(ctx, pdf_dict_get(ctx, dict, PDF_NAME(ItalicAngle)));
+	fontdesc->ascent = pdf_to_real(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Ascent)));
+	fontdesc->descent = pdf_to_real(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Descent)));
+	fontdesc->cap_height = pdf_to_real(ctx, pdf_dict_get(ctx, dict, PDF_NAME(CapHeight)));
+	fontdesc->x_height = pdf_to_real(ctx, pdf_dict_get(ctx, dict, PDF_NAME(XHeight)));
+	fontdesc->missing_width = pdf_to_real(ctx, pdf_dict_get(ctx, dict, PDF_NAME(MissingWidth)));
+
+	obj1 = pdf_dict_get(ctx, dict, PDF_NAME(FontFile));
+	obj2 = pdf_dict_get(ctx, dict, PDF_NAME(FontFile2));
+	obj3 = pdf_dict_get(ctx, dict, PDF_NAME(FontFile3));
 	obj = obj1 ? obj1 : obj2 ? obj2 : obj3;
 
 	if (pdf_is_indirect(ctx, obj))
@@ -1220,9 +1220,9 @@ pdf_load_font(fz_context *ctx, pdf_document *doc, pdf_obj *rdb, pdf_obj *dict, i
 		return fontdesc;
 	}
 
-	subtype = pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "Subtype"));
-	dfonts = pdf_dict_gets(ctx, dict, "DescendantFonts");
-	charprocs = pdf_dict_gets(ctx, dict, "CharProcs");
+	subtype = pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Subtype)));
+	dfonts = pdf_dict_get(ctx, dict, PDF_NAME(DescendantFonts));
+	charprocs = pdf_dict_get(ctx, dict, PDF_NAME(CharProcs));
 
 	if (subtype && !strcmp(subtype, "Type0"))
 		fontdesc = pdf_load_type0_font(ctx, doc, dict);
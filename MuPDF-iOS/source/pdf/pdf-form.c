@@ -27,15 +27,15 @@ static int pdf_field_dirties_document(fz_context *ctx, pdf_document *doc, pdf_ob
  * share the same name */
 static pdf_obj *find_head_of_field_group(fz_context *ctx, pdf_obj *obj)
 {
-	if (obj == NULL || pdf_dict_gets(ctx, obj, "T"))
+	if (obj == NULL || pdf_dict_get(ctx, obj, PDF_NAME(T)))
 		return obj;
 	else
-		return find_head_of_field_group(ctx, pdf_dict_gets(ctx, obj, "Parent"));
+		return find_head_of_field_group(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Parent)));
 }
 
 static void pdf_field_mark_dirty(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, field, "Kids");
+	pdf_obj *kids = pdf_dict_get(ctx, field, PDF_NAME(Kids));
 	if (kids)
 	{
 		int i, n = pdf_array_len(ctx, kids);
@@ -67,7 +67,7 @@ static void update_field_value(fz_context *ctx, pdf_document *doc, pdf_obj *obj,
 	fz_try(ctx)
 	{
 		sobj = pdf_new_string(ctx, doc, text, strlen(text));
-		pdf_dict_puts(ctx, obj, "V", sobj);
+		pdf_dict_put(ctx, obj, PDF_NAME(V), sobj);
 	}
 	fz_always(ctx)
 	{
@@ -92,7 +92,7 @@ static pdf_obj *find_field(fz_context *ctx, pdf_obj *dict, char *name, int len)
 		char *part;
 
 		field = pdf_array_get(ctx, dict, i);
-		part = pdf_to_str_buf(ctx, pdf_dict_gets(ctx, field, "T"));
+		part = pdf_to_str_buf(ctx, pdf_dict_get(ctx, field, PDF_NAME(T)));
 		if (strlen(part) == (size_t)len && !memcmp(part, name, len))
 			return field;
 	}
@@ -119,7 +119,7 @@ pdf_obj *pdf_lookup_field(fz_context *ctx, pdf_obj *form, char *name)
 		len = dot ? dot - namep : strlen(namep);
 		dict = find_field(ctx, form, namep, len);
 		if (dot)
-			form = pdf_dict_gets(ctx, dict, "Kids");
+			form = pdf_dict_get(ctx, dict, PDF_NAME(Kids));
 	}
 
 	return dict;
@@ -134,13 +134,13 @@ static void reset_field(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 	 * At the bottom of the hierarchy we may find widget annotations
 	 * that aren't also fields, but DV and V will not be present in their
 	 * dictionaries, and attempts to remove V will be harmless. */
-	pdf_obj *dv = pdf_dict_gets(ctx, field, "DV");
-	pdf_obj *kids = pdf_dict_gets(ctx, field, "Kids");
+	pdf_obj *dv = pdf_dict_get(ctx, field, PDF_NAME(DV));
+	pdf_obj *kids = pdf_dict_get(ctx, field, PDF_NAME(Kids));
 
 	if (dv)
-		pdf_dict_puts(ctx, field, "V", dv);
+		pdf_dict_put(ctx, field, PDF_NAME(V), dv);
 	else
-		pdf_dict_dels(ctx, field, "V");
+		pdf_dict_del(ctx, field, PDF_NAME(V));
 
 	if (kids == NULL)
 	{
@@ -162,7 +162,7 @@ static void reset_field(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 
 				fz_try(ctx)
 				{
-					pdf_dict_puts(ctx, field, "AS", leafv);
+					pdf_dict_put(ctx, field, PDF_NAME(AS), leafv);
 				}
 				fz_always(ctx)
 				{
@@ -190,7 +190,7 @@ static void reset_field(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 
 void pdf_field_reset(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, field, "Kids");
+	pdf_obj *kids = pdf_dict_get(ctx, field, PDF_NAME(Kids));
 
 	reset_field(ctx, doc, field);
 
@@ -205,8 +205,8 @@ void pdf_field_reset(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 
 static void add_field_hierarchy_to_array(fz_context *ctx, pdf_obj *array, pdf_obj *field)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, field, "Kids");
-	pdf_obj *exclude = pdf_dict_gets(ctx, field, "Exclude");
+	pdf_obj *kids = pdf_dict_get(ctx, field, PDF_NAME(Kids));
+	pdf_obj *exclude = pdf_dict_get(ctx, field, PDF_NAME(Exclude));
 
 	if (exclude)
 		return;
@@ -256,7 +256,7 @@ static pdf_obj *specified_fields(fz_context *ctx, pdf_document *doc, pdf_obj *fi
 					field = pdf_lookup_field(ctx, form, pdf_to_str_buf(ctx, field));
 
 				if (field)
-					pdf_dict_puts(ctx, field, "Exclude", nil);
+					pdf_dict_put(ctx, field, PDF_NAME(Exclude), nil);
 			}
 
 			/* Act upon all unmarked fields */
@@ -276,7 +276,7 @@ static pdf_obj *specified_fields(fz_context *ctx, pdf_document *doc, pdf_obj *fi
 					field = pdf_lookup_field(ctx, form, pdf_to_str_buf(ctx, field));
 
 				if (field)
-					pdf_dict_dels(ctx, field, "Exclude");
+					pdf_dict_del(ctx, field, PDF_NAME(Exclude));
 			}
 		}
 		else
@@ -333,11 +333,11 @@ static void execute_action(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf
 {
 	if (a)
 	{
-		char *type = pdf_to_name(ctx, pdf_dict_gets(ctx, a, "S"));
+		char *type = pdf_to_name(ctx, pdf_dict_get(ctx, a, PDF_NAME(S)));
 
 		if (!strcmp(type, "JavaScript"))
 		{
-			pdf_obj *js = pdf_dict_gets(ctx, a, "JS");
+			pdf_obj *js = pdf_dict_get(ctx, a, PDF_NAME(JS));
 			if (js)
 			{
 				char *code = pdf_to_utf8(ctx, doc, js);
@@ -357,11 +357,11 @@ static void execute_action(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf
 		}
 		else if (!strcmp(type, "ResetForm"))
 		{
-			reset_form(ctx, doc, pdf_dict_gets(ctx, a, "Fields"), pdf_to_int(ctx, pdf_dict_gets(ctx, a, "Flags")) & 1);
+			reset_form(ctx, doc, pdf_dict_get(ctx, a, PDF_NAME(Fields)), pdf_to_int(ctx, pdf_dict_get(ctx, a, PDF_NAME(Flags))) & 1);
 		}
 		else if (!strcmp(type, "Named"))
 		{
-			char *name = pdf_to_name(ctx, pdf_dict_gets(ctx, a, "N"));
+			char *name = pdf_to_name(ctx, pdf_dict_get(ctx, a, PDF_NAME(N)));
 
 			if (!strcmp(name, "Print"))
 				pdf_event_issue_print(ctx, doc);
@@ -371,7 +371,7 @@ static void execute_action(fz_context *ctx, pdf_document *doc, pdf_obj *obj, pdf
 
 static void execute_action_chain(fz_context *ctx, pdf_document *doc, pdf_obj *obj)
 {
-	pdf_obj *a = pdf_dict_gets(ctx, obj, "A");
+	pdf_obj *a = pdf_dict_get(ctx, obj, PDF_NAME(A));
 	pdf_js_event e;
 
 	e.target = obj;
@@ -381,7 +381,7 @@ static void execute_action_chain(fz_context *ctx, pdf_document *doc, pdf_obj *ob
 	while (a)
 	{
 		execute_action(ctx, doc, obj, a);
-		a = pdf_dict_gets(ctx, a, "Next");
+		a = pdf_dict_get(ctx, a, PDF_NAME(Next));
 	}
 }
 
@@ -408,7 +408,7 @@ static void check_off(fz_context *ctx, pdf_document *doc, pdf_obj *obj)
 	fz_try(ctx);
 	{
 		off = pdf_new_name(ctx, doc, "Off");
-		pdf_dict_puts(ctx, obj, "AS", off);
+		pdf_dict_put(ctx, obj, PDF_NAME(AS), off);
 	}
 	fz_always(ctx)
 	{
@@ -435,7 +435,7 @@ static void set_check(fz_context *ctx, pdf_document *doc, pdf_obj *chk, char *na
 		else
 			val = pdf_new_name(ctx, doc, "Off");
 
-		pdf_dict_puts(ctx, chk, "AS", val);
+		pdf_dict_put(ctx, chk, PDF_NAME(AS), val);
 	}
 	fz_always(ctx)
 	{
@@ -451,7 +451,7 @@ static void set_check(fz_context *ctx, pdf_document *doc, pdf_obj *chk, char *na
  * in the hierarchy */
 static void set_check_grp(fz_context *ctx, pdf_document *doc, pdf_obj *grp, char *val)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, grp, "Kids");
+	pdf_obj *kids = pdf_dict_get(ctx, grp, PDF_NAME(Kids));
 
 	if (kids == NULL)
 	{
@@ -512,11 +512,11 @@ static void recalculate(fz_context *ctx, pdf_document *doc)
 
 static void toggle_check_box(fz_context *ctx, pdf_document *doc, pdf_obj *obj)
 {
-	pdf_obj *as = pdf_dict_gets(ctx, obj, "AS");
+	pdf_obj *as = pdf_dict_get(ctx, obj, PDF_NAME(AS));
 	int ff = pdf_get_field_flags(ctx, doc, obj);
 	int radio = ((ff & (Ff_Pushbutton|Ff_Radio)) == Ff_Radio);
 	char *val = NULL;
-	pdf_obj *grp = radio ? pdf_dict_gets(ctx, obj, "Parent") : find_head_of_field_group(ctx, obj);
+	pdf_obj *grp = radio ? pdf_dict_get(ctx, obj, PDF_NAME(Parent)) : find_head_of_field_group(ctx, obj);
 
 	if (!grp)
 		grp = obj;
@@ -557,13 +557,13 @@ static void toggle_check_box(fz_context *ctx, pdf_document *doc, pdf_obj *obj)
 		{
 			/* For radio buttons, first turn off all buttons in the group and
 			 * then set the one that was clicked */
-			pdf_obj *kids = pdf_dict_gets(ctx, grp, "Kids");
+			pdf_obj *kids = pdf_dict_get(ctx, grp, PDF_NAME(Kids));
 
 			len = pdf_array_len(ctx, kids);
 			for (i = 0; i < len; i++)
 				check_off(ctx, doc, pdf_array_get(ctx, kids, i));
 
-			pdf_dict_puts(ctx, obj, "AS", key);
+			pdf_dict_put(ctx, obj, PDF_NAME(AS), key);
 		}
 		else
 		{
@@ -586,7 +586,7 @@ static void toggle_check_box(fz_context *ctx, pdf_document *doc, pdf_obj *obj)
 		fz_try(ctx)
 		{
 			v = pdf_new_string(ctx, doc, val, strlen(val));
-			pdf_dict_puts(ctx, grp, "V", v);
+			pdf_dict_put(ctx, grp, PDF_NAME(V), v);
 		}
 		fz_always(ctx)
 		{
@@ -625,7 +625,7 @@ int pdf_pass_event(fz_context *ctx, pdf_document *doc, pdf_page *page, pdf_ui_ev
 
 	if (annot)
 	{
-		int f = pdf_to_int(ctx, pdf_dict_gets(ctx, annot->obj, "F"));
+		int f = pdf_to_int(ctx, pdf_dict_get(ctx, annot->obj, PDF_NAME(F)));
 
 		if (f & (F_Hidden|F_NoView))
 			annot = NULL;
@@ -805,7 +805,7 @@ pdf_widget *pdf_create_widget(fz_context *ctx, pdf_document *doc, pdf_page *page
 	fz_try(ctx)
 	{
 		pdf_set_field_type(ctx, doc, annot->obj, type);
-		pdf_dict_puts_drop(ctx, annot->obj, "T", pdf_new_string(ctx, doc, fieldname, strlen(fieldname)));
+		pdf_dict_put_drop(ctx, annot->obj, PDF_NAME(T), pdf_new_string(ctx, doc, fieldname, strlen(fieldname)));
 		annot->widget_type = type;
 
 		if (type == PDF_WIDGET_TYPE_SIGNATURE)
@@ -876,7 +876,7 @@ static int set_text_field_value(fz_context *ctx, pdf_document *doc, pdf_obj *fie
 
 static void update_checkbox_selector(fz_context *ctx, pdf_document *doc, pdf_obj *field, char *val)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, field, "Kids");
+	pdf_obj *kids = pdf_dict_get(ctx, field, PDF_NAME(Kids));
 
 	if (kids)
 	{
@@ -898,7 +898,7 @@ static void update_checkbox_selector(fz_context *ctx, pdf_document *doc, pdf_obj
 			else
 				oval = pdf_new_name(ctx, doc, "Off");
 
-			pdf_dict_puts(ctx, field, "AS", oval);
+			pdf_dict_put(ctx, field, PDF_NAME(AS), oval);
 		}
 		fz_always(ctx)
 		{
@@ -1023,10 +1023,10 @@ int pdf_field_display(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 	/* Base response on first of children. Not ideal,
 	 * but not clear how to handle children with
 	 * differing values */
-	while ((kids = pdf_dict_gets(ctx, field, "Kids")) != NULL)
+	while ((kids = pdf_dict_get(ctx, field, PDF_NAME(Kids))) != NULL)
 		field = pdf_array_get(ctx, kids, 0);
 
-	f = pdf_to_int(ctx, pdf_dict_gets(ctx, field, "F"));
+	f = pdf_to_int(ctx, pdf_dict_get(ctx, field, PDF_NAME(F)));
 
 	if (f & F_Hidden)
 	{
@@ -1055,8 +1055,8 @@ int pdf_field_display(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 static char *get_field_name(fz_context *ctx, pdf_document *doc, pdf_obj *field, int spare)
 {
 	char *res = NULL;
-	pdf_obj *parent = pdf_dict_gets(ctx, field, "Parent");
-	char *lname = pdf_to_str_buf(ctx, pdf_dict_gets(ctx, field, "T"));
+	pdf_obj *parent = pdf_dict_get(ctx, field, PDF_NAME(Parent));
+	char *lname = pdf_to_str_buf(ctx, pdf_dict_get(ctx, field, PDF_NAME(T)));
 	int llen = strlen(lname);
 
 	/*
@@ -1094,12 +1094,12 @@ char *pdf_field_name(fz_context *ctx, pdf_document *doc, pdf_obj *field)
 
 void pdf_field_set_display(fz_context *ctx, pdf_document *doc, pdf_obj *field, int d)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, field, "Kids");
+	pdf_obj *kids = pdf_dict_get(ctx, field, PDF_NAME(Kids));
 
 	if (!kids)
 	{
 		int mask = (F_Hidden|F_Print|F_NoView);
-		int f = pdf_to_int(ctx, pdf_dict_gets(ctx, field, "F")) & ~mask;
+		int f = pdf_to_int(ctx, pdf_dict_get(ctx, field, PDF_NAME(F))) & ~mask;
 		pdf_obj *fo = NULL;
 
 		switch (d)
@@ -1121,7 +1121,7 @@ void pdf_field_set_display(fz_context *ctx, pdf_document *doc, pdf_obj *field, i
 		fz_try(ctx)
 		{
 			fo = pdf_new_int(ctx, doc, f);
-			pdf_dict_puts(ctx, field, "F", fo);
+			pdf_dict_put(ctx, field, PDF_NAME(F), fo);
 		}
 		fz_always(ctx)
 		{
@@ -1179,7 +1179,7 @@ void pdf_field_set_text_color(fz_context *ctx, pdf_document *doc, pdf_obj *field
 		pdf_fzbuf_print_da(ctx, fzbuf, &di);
 		len = fz_buffer_storage(ctx, fzbuf, &buf);
 		daobj = pdf_new_string(ctx, doc, (char *)buf, len);
-		pdf_dict_puts(ctx, field, "DA", daobj);
+		pdf_dict_put(ctx, field, PDF_NAME(DA), daobj);
 		pdf_field_mark_dirty(ctx, doc, field);
 	}
 	fz_always(ctx)
@@ -1314,7 +1314,7 @@ int pdf_choice_widget_options(fz_context *ctx, pdf_document *doc, pdf_widget *tw
 	if (!annot)
 		return 0;
 
-	optarr = pdf_dict_gets(ctx, annot->obj, "Opt");
+	optarr = pdf_dict_get(ctx, annot->obj, PDF_NAME(Opt));
 	n = pdf_array_len(ctx, optarr);
 
 	if (opts)
@@ -1353,7 +1353,7 @@ int pdf_choice_widget_value(fz_context *ctx, pdf_document *doc, pdf_widget *tw,
 	if (!annot)
 		return 0;
 
-	optarr = pdf_dict_gets(ctx, annot->obj, "V");
+	optarr = pdf_dict_get(ctx, annot->obj, PDF_NAME(V));
 
 	if (pdf_is_string(ctx, optarr))
 	{
@@ -1408,18 +1408,18 @@ void pdf_choice_widget_set_value(fz_context *ctx, pdf_document *doc, pdf_widget
 				opt = NULL;
 			}
 
-			pdf_dict_puts(ctx, annot->obj, "V", optarr);
+			pdf_dict_put(ctx, annot->obj, PDF_NAME(V), optarr);
 			pdf_drop_obj(ctx, optarr);
 		}
 		else
 		{
 			opt = pdf_new_string(ctx, doc, opts[0], strlen(opts[0]));
-			pdf_dict_puts(ctx, annot->obj, "V", opt);
+			pdf_dict_put(ctx, annot->obj, PDF_NAME(V), opt);
 			pdf_drop_obj(ctx, opt);
 		}
 
 		/* FIXME: when n > 1, we should be regenerating the indexes */
-		pdf_dict_dels(ctx, annot->obj, "I");
+		pdf_dict_del(ctx, annot->obj, PDF_NAME(I));
 
 		pdf_field_mark_dirty(ctx, doc, annot->obj);
 		if (pdf_field_dirties_document(ctx, doc, annot->obj))
@@ -1474,7 +1474,7 @@ void pdf_signature_set_value(fz_context *ctx, pdf_document *doc, pdf_obj *field,
 
 	vnum = pdf_create_object(ctx, doc);
 	indv = pdf_new_indirect(ctx, doc, vnum, 0);
-	pdf_dict_puts_drop(ctx, field, "V", indv);
+	pdf_dict_put_drop(ctx, field, PDF_NAME(V), indv);
 
 	fz_var(v);
 	fz_try(ctx)
@@ -1492,13 +1492,13 @@ void pdf_signature_set_value(fz_context *ctx, pdf_document *doc, pdf_obj *field,
 	}
 
 	byte_range = pdf_new_array(ctx, doc, 4);
-	pdf_dict_puts_drop(ctx, v, "ByteRange", byte_range);
+	pdf_dict_put_drop(ctx, v, PDF_NAME(ByteRange), byte_range);
 
 	contents = pdf_new_string(ctx, doc, buf, sizeof(buf));
-	pdf_dict_puts_drop(ctx, v, "Contents", contents);
+	pdf_dict_put_drop(ctx, v, PDF_NAME(Contents), contents);
 
-	pdf_dict_puts_drop(ctx, v, "Filter", pdf_new_name(ctx, doc, "Adobe.PPKLite"));
-	pdf_dict_puts_drop(ctx, v, "SubFilter", pdf_new_name(ctx, doc, "adbe.pkcs7.detached"));
+	pdf_dict_put_drop(ctx, v, PDF_NAME(Filter), pdf_new_name(ctx, doc, "Adobe.PPKLite"));
+	pdf_dict_put_drop(ctx, v, PDF_NAME(SubFilter), pdf_new_name(ctx, doc, "adbe.pkcs7.detached"));
 
 	/* Record details within the document structure so that contents
 	 * and byte_range can be updated with their correct values at
@@ -1,5 +1,7 @@
 #include "mupdf/pdf.h"
 typedef struct psobj_s psobj;
+typedef struct ps_insn_s ps_insn;
+typedef union ps_val_s ps_val;
 
 enum
 {
@@ -45,6 +47,11 @@ struct pdf_function_s
 		struct {
 			psobj *code;
 			int cap;
+			ps_insn *insns;		/* compiled code, or NULL to interpret */
+			ps_val *consts;		/* initial values of the first registers */
+			int nconsts;
+			short out[FZ_FN_MAXN];	/* register holding each output */
+			float *lut;		/* samples of one input functions, or NULL */
 		} p;
 	} u;
 };
@@ -190,19 +197,26 @@ ps_push_int(ps_stack *st, int n)
 	}
 }
 
+/* Every real pushed on the stack is passed through this */
+static inline float
+ps_real(float n)
+{
+	if (isnan(n))
+	{
+		/* Push 1.0, as it's a small known value that won't
+		 * cause a divide by 0. Same reason as in fz_atof. */
+		n = 1.0;
+	}
+	return fz_clamp(n, -FLT_MAX, FLT_MAX);
+}
+
 static void
 ps_push_real(ps_stack *st, float n)
 {
 	if (!ps_overflow(st, 1))
 	{
 		st->stack[st->sp].type = PS_REAL;
-		if (isnan(n))
-		{
-			/* Push 1.0, as it's a small known value that won't
-			 * cause a divide by 0. Same reason as in fz_atof. */
-			n = 1.0;
-		}
-		st->stack[st->sp].u.f = fz_clamp(n, -FLT_MAX, FLT_MAX);
+		st->stack[st->sp].u.f = ps_real(n);
 		st->sp++;
 	}
 }
@@ -285,7 +299,7 @@ ps_roll(ps_stack *st, int n, int j)
 static void
 ps_index(ps_stack *st, int n)
 {
-	if (!ps_overflow(st, 1) && !ps_underflow(st, n))
+	if (!ps_overflow(st, 1) && !ps_underflow(st, n) && st->sp - n - 1 >= 0)
 	{
 		st->stack[st->sp] = st->stack[st->sp - n - 1];
 		st->sp++;
@@ -832,6 +846,809 @@ parse_code(fz_context *ctx, pdf_function *func, fz_stream *stream, int *codeptr,
 	}
 }
 
+/*
+ * Compiled calculator functions
+ *
+ * The inputs of a calculator function are always reals, and every
+ * operator produces a result of a type that depends only on the types of
+ * its operands. So, for most programs, the type and position of every
+ * stack entry is the same for all inputs, and we can run the program once
+ * at load time on a stack of descriptors instead of values. Each
+ * descriptor is either a constant or a register, and each operator either
+ * folds its constant operands or emits one instruction writing a new
+ * register. Stack shuffling (exch, roll, dup, copy, index, pop) costs
+ * nothing at run time, and programs without if or ifelse become straight
+ * line code.
+ *
+ * The two branches of a conditional must leave stacks of the same depth
+ * and types. Entries on which they disagree are moved into a new register
+ * at the end of each branch.
+ *
+ * Anything whose effect would depend on the input values (a stack depth
+ * that differs between branches, copy, index or roll with a computed
+ * operand, an operator applied to operands of the wrong type, or stack
+ * underflow and overflow) makes us give up and interpret the program as
+ * before. The compiled code computes exactly what the interpreter would.
+ */
+
+enum
+{
+	PSC_END, PSC_JMP, PSC_JZ, PSC_MOV, PSC_CVI, PSC_CVR,
+	PSC_ADDI, PSC_SUBI, PSC_MULI, PSC_IDIV, PSC_MOD, PSC_ABSI, PSC_NEGI,
+	PSC_ANDI, PSC_ORI, PSC_XORI, PSC_NOTI, PSC_BITSHIFT,
+	PSC_ANDB, PSC_ORB, PSC_XORB, PSC_NOTB,
+	PSC_EQI, PSC_NEI, PSC_GEI, PSC_GTI, PSC_LEI, PSC_LTI,
+	PSC_EQF, PSC_NEF, PSC_GEF, PSC_GTF, PSC_LEF, PSC_LTF,
+	PSC_ADDF, PSC_SUBF, PSC_MULF, PSC_DIVF, PSC_ABSF, PSC_NEGF,
+	PSC_ATAN, PSC_EXP, PSC_CEILING, PSC_FLOOR, PSC_ROUND, PSC_TRUNCATE,
+	PSC_COS, PSC_SIN, PSC_SQRT, PSC_LN, PSC_LOG
+};
+
+/* Booleans are held in registers as the integers 0 and 1 */
+union ps_val_s
+{
+	int i;
+	float f;
+};
+
+/* d = a op b, or jump to b */
+struct ps_insn_s
+{
+	short op, d, a, b;
+};
+
+enum { PS_MAX_REGS = 256, PS_MAX_INSNS = 8192, PS_MAX_NESTING = 16, PS_LUT_SIZE = 256 };
+
+static void
+ps_exec(const ps_insn *code, ps_val *r)
+{
+	const ps_insn *p = code;
+	float f;
+
+	while (1)
+	{
+		switch (p->op)
+		{
+		case PSC_END: return;
+		case PSC_JMP: p = code + p->b; continue;
+		case PSC_JZ: if (!r[p->a].i) { p = code + p->b; continue; } break;
+		case PSC_MOV: r[p->d] = r[p->a]; break;
+		case PSC_CVI: r[p->d].i = r[p->a].f; break;
+		case PSC_CVR: r[p->d].f = r[p->a].i; break;
+
+		case PSC_ADDI: r[p->d].i = r[p->a].i + r[p->b].i; break;
+		case PSC_SUBI: r[p->d].i = r[p->a].i - r[p->b].i; break;
+		case PSC_MULI: r[p->d].i = r[p->a].i * r[p->b].i; break;
+		case PSC_IDIV:
+			if (r[p->b].i != 0)
+				r[p->d].i = r[p->a].i / r[p->b].i;
+			else
+				r[p->d].i = DIV_BY_ZERO(r[p->a].i, r[p->b].i, INT_MIN, INT_MAX);
+			break;
+		case PSC_MOD:
+			if (r[p->b].i != 0)
+				r[p->d].i = r[p->a].i % r[p->b].i;
+			else
+				r[p->d].i = DIV_BY_ZERO(r[p->a].i, r[p->b].i, INT_MIN, INT_MAX);
+			break;
+		case PSC_ABSI: r[p->d].i = abs(r[p->a].i); break;
+		case PSC_NEGI: r[p->d].i = -r[p->a].i; break;
+		case PSC_ANDI: r[p->d].i = r[p->a].i & r[p->b].i; break;
+		case PSC_ORI: r[p->d].i = r[p->a].i | r[p->b].i; break;
+		case PSC_XORI: r[p->d].i = r[p->a].i ^ r[p->b].i; break;
+		case PSC_NOTI: r[p->d].i = ~r[p->a].i; break;
+		case PSC_BITSHIFT:
+			if (r[p->b].i > 0 && r[p->b].i < 8 * sizeof (int))
+				r[p->d].i = r[p->a].i << r[p->b].i;
+			else if (r[p->b].i < 0 && r[p->b].i > -8 * (int)sizeof (int))
+				r[p->d].i = (int)((unsigned int)r[p->a].i >> -r[p->b].i);
+			else
+				r[p->d].i = r[p->a].i;
+			break;
+
+		case PSC_ANDB: r[p->d].i = r[p->a].i && r[p->b].i; break;
+		case PSC_ORB: r[p->d].i = r[p->a].i || r[p->b].i; break;
+		case PSC_XORB: r[p->d].i = r[p->a].i ^ r[p->b].i; break;
+		case PSC_NOTB: r[p->d].i = !r[p->a].i; break;
+
+		case PSC_EQI: r[p->d].i = r[p->a].i == r[p->b].i; break;
+		case PSC_NEI: r[p->d].i = r[p->a].i != r[p->b].i; break;
+		case PSC_GEI: r[p->d].i = r[p->a].i >= r[p->b].i; break;
+		case PSC_GTI: r[p->d].i = r[p->a].i > r[p->b].i; break;
+		case PSC_LEI: r[p->d].i = r[p->a].i <= r[p->b].i; break;
+		case PSC_LTI: r[p->d].i = r[p->a].i < r[p->b].i; break;
+		case PSC_EQF: r[p->d].i = r[p->a].f == r[p->b].f; break;
+		case PSC_NEF: r[p->d].i = r[p->a].f != r[p->b].f; break;
+		case PSC_GEF: r[p->d].i = r[p->a].f >= r[p->b].f; break;
+		case PSC_GTF: r[p->d].i = r[p->a].f > r[p->b].f; break;
+		case PSC_LEF: r[p->d].i = r[p->a].f <= r[p->b].f; break;
+		case PSC_LTF: r[p->d].i = r[p->a].f < r[p->b].f; break;
+
+		case PSC_ADDF: r[p->d].f = ps_real(r[p->a].f + r[p->b].f); break;
+		case PSC_SUBF: r[p->d].f = ps_real(r[p->a].f - r[p->b].f); break;
+		case PSC_MULF: r[p->d].f = ps_real(r[p->a].f * r[p->b].f); break;
+		case PSC_DIVF:
+			if (fabsf(r[p->b].f) >= FLT_EPSILON)
+				r[p->d].f = ps_real(r[p->a].f / r[p->b].f);
+			else
+				r[p->d].f = ps_real(DIV_BY_ZERO(r[p->a].f, r[p->b].f, -FLT_MAX, FLT_MAX));
+			break;
+		case PSC_ABSF: r[p->d].f = ps_real(fabsf(r[p->a].f)); break;
+		case PSC_NEGF: r[p->d].f = ps_real(-r[p->a].f); break;
+		case PSC_ATAN:
+			f = atan2f(r[p->a].f, r[p->b].f) * RADIAN;
+			if (f < 0)
+				f += 360;
+			r[p->d].f = ps_real(f);
+			break;
+		case PSC_EXP: r[p->d].f = ps_real(powf(r[p->a].f, r[p->b].f)); break;
+		case PSC_CEILING: r[p->d].f = ps_real(ceilf(r[p->a].f)); break;
+		case PSC_FLOOR: r[p->d].f = ps_real(floorf(r[p->a].f)); break;
+		case PSC_ROUND:
+			f = r[p->a].f;
+			r[p->d].f = ps_real((f >= 0) ? floorf(f + 0.5f) : ceilf(f - 0.5f));
+			break;
+		case PSC_TRUNCATE:
+			f = r[p->a].f;
+			r[p->d].f = ps_real((f >= 0) ? floorf(f) : ceilf(f));
+			break;
+		case PSC_COS: r[p->d].f = ps_real(cosf(r[p->a].f/RADIAN)); break;
+		case PSC_SIN: r[p->d].f = ps_real(sinf(r[p->a].f/RADIAN)); break;
+		case PSC_SQRT: r[p->d].f = ps_real(sqrtf(r[p->a].f)); break;
+		case PSC_LN:
+			/* Bug 692941 - logf as separate statement */
+			f = logf(r[p->a].f);
+			r[p->d].f = ps_real(f);
+			break;
+		case PSC_LOG: r[p->d].f = ps_real(log10f(r[p->a].f)); break;
+		}
+		p++;
+	}
+}
+
+/* A stack entry at compile time: a constant (reg < 0) or a register */
+typedef struct
+{
+	int type;
+	int reg;
+	ps_val k;
+} ps_slot;
+
+typedef struct
+{
+	psobj *code;
+	ps_insn *insns;
+	int len, cap;
+	ps_val consts[PS_MAX_REGS];
+	int nconsts;
+	int nregs;
+	int nesting;
+	ps_slot stack[nelem(((ps_stack *)0)->stack)];
+	int sp;
+} ps_compiler;
+
+/* Register numbers below are relative to the first non constant register.
+ * The constants get negative numbers until we know how many there are. */
+static int
+psc_const_reg(ps_compiler *c, ps_val k)
+{
+	int i;
+	for (i = 0; i < c->nconsts; i++)
+		if (c->consts[i].i == k.i)
+			return -1 - i;
+	if (c->nconsts + c->nregs >= PS_MAX_REGS)
+		return INT_MIN;
+	c->consts[c->nconsts] = k;
+	return -1 - c->nconsts++;
+}
+
+static int
+psc_reg(ps_compiler *c, const ps_slot *s)
+{
+	return s->reg >= 0 ? s->reg : psc_const_reg(c, s->k);
+}
+
+static int
+psc_new_reg(ps_compiler *c)
+{
+	if (c->nconsts + c->nregs >= PS_MAX_REGS)
+		return INT_MIN;
+	return c->nregs++;
+}
+
+static int
+psc_emit(fz_context *ctx, ps_compiler *c, int op, int d, int a, int b)
+{
+	if (d == INT_MIN || a == INT_MIN || b == INT_MIN || c->len >= PS_MAX_INSNS)
+		return 0;
+	if (c->len == c->cap)
+	{
+		int new_cap = c->cap + 64;
+		c->insns = fz_resize_array(ctx, c->insns, new_cap, sizeof(ps_insn));
+		c->cap = new_cap;
+	}
+	c->insns[c->len].op = op;
+	c->insns[c->len].d = d;
+	c->insns[c->len].a = a;
+	c->insns[c->len].b = b;
+	c->len++;
+	return 1;
+}
+
+static int
+psc_push(ps_compiler *c, const ps_slot *s)
+{
+	if (c->sp + 1 >= nelem(c->stack))
+		return 0;
+	c->stack[c->sp++] = *s;
+	return 1;
+}
+
+static int
+psc_push_const(ps_compiler *c, int type, ps_val k)
+{
+	ps_slot s;
+	s.type = type;
+	s.reg = -1;
+	s.k = k;
+	return psc_push(c, &s);
+}
+
+static int
+psc_top_is(ps_compiler *c, int type)
+{
+	return c->sp >= 1 && c->stack[c->sp - 1].type == type;
+}
+
+static int
+psc_top2_are(ps_compiler *c, int type)
+{
+	return c->sp >= 2 && c->stack[c->sp - 1].type == type && c->stack[c->sp - 2].type == type;
+}
+
+/* Pop a number, converted as ps_pop_real or ps_pop_int would */
+static int
+psc_pop_number(fz_context *ctx, ps_compiler *c, int type, ps_slot *s)
+{
+	if (c->sp < 1)
+		return 0;
+	*s = c->stack[--c->sp];
+	if (s->type == type)
+		return 1;
+	if (s->type == PS_BOOL)
+		return 0;
+	if (s->reg < 0)
+	{
+		if (type == PS_REAL)
+			s->k.f = s->k.i;
+		else
+			s->k.i = s->k.f;
+	}
+	else
+	{
+		int reg = psc_new_reg(c);
+		if (!psc_emit(ctx, c, type == PS_REAL ? PSC_CVR : PSC_CVI, reg, s->reg, 0))
+			return 0;
+		s->reg = reg;
+	}
+	s->type = type;
+	return 1;
+}
+
+static int
+psc_pop_bool(ps_compiler *c, ps_slot *s)
+{
+	if (!psc_top_is(c, PS_BOOL))
+		return 0;
+	*s = c->stack[--c->sp];
+	return 1;
+}
+
+/* Push the result of an operator, folding it if all operands are constant */
+static int
+psc_op(fz_context *ctx, ps_compiler *c, int op, int type, const ps_slot *a, const ps_slot *b)
+{
+	ps_slot s;
+
+	s.type = type;
+	if (a->reg < 0 && (!b || b->reg < 0))
+	{
+		ps_insn code[2] = { { 0, 2, 0, 1 }, { PSC_END, 0, 0, 0 } };
+		ps_val r[3];
+		code[0].op = op;
+		r[0] = a->k;
+		r[1] = b ? b->k : a->k;
+		ps_exec(code, r);
+		s.reg = -1;
+		s.k = r[2];
+	}
+	else
+	{
+		s.reg = psc_new_reg(c);
+		if (!psc_emit(ctx, c, op, s.reg, psc_reg(c, a), b ? psc_reg(c, b) : 0))
+			return 0;
+	}
+	return psc_push(c, &s);
+}
+
+static int
+psc_unary(fz_context *ctx, ps_compiler *c, int op, int type, int result)
+{
+	ps_slot a;
+	if (!psc_pop_number(ctx, c, type, &a))
+		return 0;
+	return psc_op(ctx, c, op, result, &a, NULL);
+}
+
+static int
+psc_binary(fz_context *ctx, ps_compiler *c, int op, int type, int result)
+{
+	ps_slot a, b;
+	if (!psc_pop_number(ctx, c, type, &b) || !psc_pop_number(ctx, c, type, &a))
+		return 0;
+	return psc_op(ctx, c, op, result, &a, &b);
+}
+
+static int
+psc_logical(fz_context *ctx, ps_compiler *c, int op)
+{
+	ps_slot a, b;
+	if (!psc_pop_bool(c, &b) || !psc_pop_bool(c, &a))
+		return 0;
+	return psc_op(ctx, c, op, PS_BOOL, &a, &b);
+}
+
+/* Integer ops on two ints, real ops otherwise. Comparisons give a boolean,
+ * the rest a number of the type they work on. */
+static int
+psc_arith(fz_context *ctx, ps_compiler *c, int iop, int fop, int compare)
+{
+	if (psc_top2_are(c, PS_INT))
+		return psc_binary(ctx, c, iop, PS_INT, compare ? PS_BOOL : PS_INT);
+	return psc_binary(ctx, c, fop, PS_REAL, compare ? PS_BOOL : PS_REAL);
+}
+
+/* The operand of copy, index and roll must be known at compile time */
+static int
+psc_pop_const_int(fz_context *ctx, ps_compiler *c, int *v)
+{
+	ps_slot s;
+	if (!psc_pop_number(ctx, c, PS_INT, &s) || s.reg >= 0)
+		return 0;
+	*v = s.k.i;
+	return 1;
+}
+
+static int psc_block(fz_context *ctx, ps_compiler *c, int pc);
+
+static int
+psc_same(const ps_slot *a, const ps_slot *b)
+{
+	return a->reg == b->reg && (a->reg >= 0 || a->k.i == b->k.i);
+}
+
+static int
+psc_conditional(fz_context *ctx, ps_compiler *c, int then_pc, int else_pc)
+{
+	ps_slot cond;
+	ps_slot saved[nelem(c->stack)], then_stack[nelem(c->stack)];
+	int merged[nelem(c->stack)];
+	int saved_sp, then_sp, jz, jmp, skip, n, i;
+
+	/* Like ps_pop_bool, anything but a boolean on top counts as false
+	 * and stays on the stack. */
+	if (!psc_pop_bool(c, &cond))
+		return else_pc < 0 || psc_block(ctx, c, else_pc);
+	if (cond.reg < 0)
+	{
+		if (cond.k.i)
+			return psc_block(ctx, c, then_pc);
+		return else_pc < 0 || psc_block(ctx, c, else_pc);
+	}
+
+	memcpy(saved, c->stack, c->sp * sizeof(ps_slot));
+	saved_sp = c->sp;
+
+	jz = c->len;
+	if (!psc_emit(ctx, c, PSC_JZ, 0, cond.reg, 0) || !psc_block(ctx, c, then_pc))
+		return 0;
+	memcpy(then_stack, c->stack, c->sp * sizeof(ps_slot));
+	then_sp = c->sp;
+	jmp = c->len;
+	if (!psc_emit(ctx, c, PSC_JMP, 0, 0, 0))
+		return 0;
+
+	c->insns[jz].b = c->len;
+	memcpy(c->stack, saved, saved_sp * sizeof(ps_slot));
+	c->sp = saved_sp;
+	if (else_pc >= 0 && !psc_block(ctx, c, else_pc))
+		return 0;
+
+	if (c->sp != then_sp)
+		return 0;
+	n = 0;
+	for (i = 0; i < c->sp; i++)
+	{
+		merged[i] = -1;
+		if (c->stack[i].type != then_stack[i].type)
+			return 0;
+		if (psc_same(&c->stack[i], &then_stack[i]))
+			continue;
+		merged[i] = psc_new_reg(c);
+		if (!psc_emit(ctx, c, PSC_MOV, merged[i], psc_reg(c, &c->stack[i]), 0))
+			return 0;
+		n++;
+	}
+	if (n == 0)
+	{
+		c->insns[jmp].b = c->len;
+		return 1;
+	}
+
+	/* The else branch falls through its moves and jumps over those of
+	 * the then branch. */
+	skip = c->len;
+	if (!psc_emit(ctx, c, PSC_JMP, 0, 0, 0))
+		return 0;
+	c->insns[jmp].b = c->len;
+	for (i = 0; i < c->sp; i++)
+	{
+		if (merged[i] < 0)
+			continue;
+		if (!psc_emit(ctx, c, PSC_MOV, merged[i], psc_reg(c, &then_stack[i]), 0))
+			return 0;
+		c->stack[i].reg = merged[i];
+	}
+	c->insns[skip].b = c->len;
+	return 1;
+}
+
+static int
+psc_block(fz_context *ctx, ps_compiler *c, int pc)
+{
+	psobj *code = c->code;
+	ps_slot a, b;
+	ps_val k;
+	int i, n, j;
+
+	if (++c->nesting > PS_MAX_NESTING)
+		return 0;
+
+	while (1)
+	{
+		switch (code[pc].type)
+		{
+		case PS_INT:
+			k.i = code[pc++].u.i;
+			if (!psc_push_const(c, PS_INT, k))
+				return 0;
+			break;
+
+		case PS_REAL:
+			k.f = ps_real(code[pc++].u.f);
+			if (!psc_push_const(c, PS_REAL, k))
+				return 0;
+			break;
+
+		case PS_OPERATOR:
+			switch (code[pc++].u.op)
+			{
+			case PS_OP_ABS:
+				if (psc_top_is(c, PS_INT) ? !psc_unary(ctx, c, PSC_ABSI, PS_INT, PS_INT) : !psc_unary(ctx, c, PSC_ABSF, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_NEG:
+				if (psc_top_is(c, PS_INT) ? !psc_unary(ctx, c, PSC_NEGI, PS_INT, PS_INT) : !psc_unary(ctx, c, PSC_NEGF, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_ADD:
+				if (!psc_arith(ctx, c, PSC_ADDI, PSC_ADDF, 0))
+					return 0;
+				break;
+			case PS_OP_SUB:
+				if (!psc_arith(ctx, c, PSC_SUBI, PSC_SUBF, 0))
+					return 0;
+				break;
+			case PS_OP_MUL:
+				if (!psc_arith(ctx, c, PSC_MULI, PSC_MULF, 0))
+					return 0;
+				break;
+			case PS_OP_GE:
+				if (!psc_arith(ctx, c, PSC_GEI, PSC_GEF, 1))
+					return 0;
+				break;
+			case PS_OP_GT:
+				if (!psc_arith(ctx, c, PSC_GTI, PSC_GTF, 1))
+					return 0;
+				break;
+			case PS_OP_LE:
+				if (!psc_arith(ctx, c, PSC_LEI, PSC_LEF, 1))
+					return 0;
+				break;
+			case PS_OP_LT:
+				if (!psc_arith(ctx, c, PSC_LTI, PSC_LTF, 1))
+					return 0;
+				break;
+			case PS_OP_EQ:
+				if (psc_top2_are(c, PS_BOOL) ? !psc_logical(ctx, c, PSC_EQI) : !psc_arith(ctx, c, PSC_EQI, PSC_EQF, 1))
+					return 0;
+				break;
+			case PS_OP_NE:
+				if (psc_top2_are(c, PS_BOOL) ? !psc_logical(ctx, c, PSC_NEI) : !psc_arith(ctx, c, PSC_NEI, PSC_NEF, 1))
+					return 0;
+				break;
+			case PS_OP_AND:
+				if (psc_top2_are(c, PS_INT) ? !psc_binary(ctx, c, PSC_ANDI, PS_INT, PS_INT) : !psc_logical(ctx, c, PSC_ANDB))
+					return 0;
+				break;
+			case PS_OP_OR:
+				if (psc_top2_are(c, PS_BOOL) ? !psc_logical(ctx, c, PSC_ORB) : !psc_binary(ctx, c, PSC_ORI, PS_INT, PS_INT))
+					return 0;
+				break;
+			case PS_OP_XOR:
+				if (psc_top2_are(c, PS_BOOL) ? !psc_logical(ctx, c, PSC_XORB) : !psc_binary(ctx, c, PSC_XORI, PS_INT, PS_INT))
+					return 0;
+				break;
+			case PS_OP_NOT:
+				if (psc_top_is(c, PS_BOOL))
+				{
+					psc_pop_bool(c, &a);
+					if (!psc_op(ctx, c, PSC_NOTB, PS_BOOL, &a, NULL))
+						return 0;
+				}
+				else if (!psc_unary(ctx, c, PSC_NOTI, PS_INT, PS_INT))
+					return 0;
+				break;
+			case PS_OP_BITSHIFT:
+				if (!psc_binary(ctx, c, PSC_BITSHIFT, PS_INT, PS_INT))
+					return 0;
+				break;
+			case PS_OP_IDIV:
+				if (!psc_binary(ctx, c, PSC_IDIV, PS_INT, PS_INT))
+					return 0;
+				break;
+			case PS_OP_MOD:
+				if (!psc_binary(ctx, c, PSC_MOD, PS_INT, PS_INT))
+					return 0;
+				break;
+			case PS_OP_DIV:
+				if (!psc_binary(ctx, c, PSC_DIVF, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_ATAN:
+				if (!psc_binary(ctx, c, PSC_ATAN, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_EXP:
+				if (!psc_binary(ctx, c, PSC_EXP, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_CEILING:
+				if (!psc_unary(ctx, c, PSC_CEILING, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_FLOOR:
+				if (!psc_unary(ctx, c, PSC_FLOOR, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_COS:
+				if (!psc_unary(ctx, c, PSC_COS, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_SIN:
+				if (!psc_unary(ctx, c, PSC_SIN, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_SQRT:
+				if (!psc_unary(ctx, c, PSC_SQRT, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_LN:
+				if (!psc_unary(ctx, c, PSC_LN, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_LOG:
+				if (!psc_unary(ctx, c, PSC_LOG, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_ROUND:
+				if (!psc_top_is(c, PS_INT) && !psc_unary(ctx, c, PSC_ROUND, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_TRUNCATE:
+				if (!psc_top_is(c, PS_INT) && !psc_unary(ctx, c, PSC_TRUNCATE, PS_REAL, PS_REAL))
+					return 0;
+				break;
+			case PS_OP_CVI:
+				if (!psc_pop_number(ctx, c, PS_INT, &a) || !psc_push(c, &a))
+					return 0;
+				break;
+			case PS_OP_CVR:
+				if (!psc_pop_number(ctx, c, PS_REAL, &a) || !psc_push(c, &a))
+					return 0;
+				break;
+
+			case PS_OP_TRUE:
+			case PS_OP_FALSE:
+				k.i = code[pc-1].u.op == PS_OP_TRUE;
+				if (!psc_push_const(c, PS_BOOL, k))
+					return 0;
+				break;
+
+			/* The stack operators only move descriptors around. Their
+			 * checks are those of ps_copy, ps_index and ps_roll. */
+			case PS_OP_POP:
+				if (c->sp > 0)
+					c->sp--;
+				break;
+			case PS_OP_DUP:
+				n = 1;
+				goto copy;
+			case PS_OP_COPY:
+				if (!psc_pop_const_int(ctx, c, &n))
+					return 0;
+copy:
+				if (n >= 0 && c->sp - n >= 0 && c->sp + n < nelem(c->stack))
+				{
+					memcpy(c->stack + c->sp, c->stack + c->sp - n, n * sizeof(ps_slot));
+					c->sp += n;
+				}
+				break;
+			case PS_OP_INDEX:
+				if (!psc_pop_const_int(ctx, c, &n))
+					return 0;
+				if (c->sp + 1 < nelem(c->stack) && n >= 0 && c->sp - n - 1 >= 0)
+				{
+					c->stack[c->sp] = c->stack[c->sp - n - 1];
+					c->sp++;
+				}
+				break;
+			case PS_OP_EXCH:
+				n = 2;
+				j = 1;
+				goto roll;
+			case PS_OP_ROLL:
+				if (!psc_pop_const_int(ctx, c, &j) || !psc_pop_const_int(ctx, c, &n))
+					return 0;
+roll:
+				if (n < 0 || c->sp - n < 0 || j == 0 || n == 0)
+					break;
+				if (j >= 0)
+					j %= n;
+				else
+				{
+					j = -j % n;
+					if (j != 0)
+						j = n - j;
+				}
+				for (i = 0; i < j; i++)
+				{
+					b = c->stack[c->sp - 1];
+					memmove(c->stack + c->sp - n + 1, c->stack + c->sp - n, (n - 1) * sizeof(ps_slot));
+					c->stack[c->sp - n] = b;
+				}
+				break;
+
+			case PS_OP_IF:
+				if (!psc_conditional(ctx, c, code[pc + 1].u.block, -1))
+					return 0;
+				pc = code[pc + 2].u.block;
+				break;
+			case PS_OP_IFELSE:
+				if (!psc_conditional(ctx, c, code[pc + 1].u.block, code[pc + 0].u.block))
+					return 0;
+				pc = code[pc + 2].u.block;
+				break;
+
+			case PS_OP_RETURN:
+				c->nesting--;
+				return 1;
+
+			default:
+				return 0;
+			}
+			break;
+
+		default:
+			return 0;
+		}
+	}
+}
+
+/* Returns 0 if the program has to be interpreted */
+static int
+compile_postscript_func(fz_context *ctx, pdf_function *func)
+{
+	ps_compiler *c;
+	int out[FZ_FN_MAXN];
+	int i, ok;
+
+	c = fz_malloc_struct(ctx, ps_compiler);
+	c->code = func->u.p.code;
+
+	fz_try(ctx)
+	{
+		for (i = 0; i < func->base.m; i++)
+		{
+			ps_slot s;
+			s.type = PS_REAL;
+			s.reg = psc_new_reg(c);
+			psc_push(c, &s);
+		}
+
+		ok = psc_block(ctx, c, 0);
+
+		/* Pop the outputs as eval_postscript_func does */
+		for (i = func->base.n - 1; ok && i >= 0; i--)
+		{
+			ps_slot s;
+			if (c->sp > 0 && c->stack[c->sp - 1].type != PS_BOOL)
+				ok = psc_pop_number(ctx, c, PS_REAL, &s);
+			else
+			{
+				s.reg = -1;
+				s.k.f = 0;
+			}
+			out[i] = psc_reg(c, &s);
+			if (out[i] == INT_MIN)
+				ok = 0;
+		}
+		ok = ok && psc_emit(ctx, c, PSC_END, 0, 0, 0);
+
+		/* Put the constants first in the register file */
+		if (ok)
+		{
+			for (i = 0; i < c->len; i++)
+			{
+				ps_insn *p = &c->insns[i];
+				p->d = p->d < 0 ? -1 - p->d : p->d + c->nconsts;
+				p->a = p->a < 0 ? -1 - p->a : p->a + c->nconsts;
+				if (p->op != PSC_JMP && p->op != PSC_JZ)
+					p->b = p->b < 0 ? -1 - p->b : p->b + c->nconsts;
+			}
+			for (i = 0; i < func->base.n; i++)
+				func->u.p.out[i] = out[i] < 0 ? -1 - out[i] : out[i] + c->nconsts;
+			func->u.p.consts = fz_malloc_array(ctx, c->nconsts + 1, sizeof(ps_val));
+			memcpy(func->u.p.consts, c->consts, c->nconsts * sizeof(ps_val));
+			func->u.p.nconsts = c->nconsts;
+			func->u.p.insns = c->insns;
+			c->insns = NULL;
+			func->base.size += c->len * sizeof(ps_insn) + c->nconsts * sizeof(ps_val);
+		}
+	}
+	fz_always(ctx)
+	{
+		fz_free(ctx, c->insns);
+		fz_free(ctx, c);
+	}
+	fz_catch(ctx)
+	{
+		/* Not compiling only costs speed */
+		fz_free(ctx, func->u.p.insns);
+		func->u.p.insns = NULL;
+		ok = 0;
+	}
+
+	return ok;
+}
+
+static void
+eval_compiled_postscript_func(fz_context *ctx, pdf_function *func, const float *in, float *out)
+{
+	ps_val r[PS_MAX_REGS];
+	int nconsts = func->u.p.nconsts;
+	int i;
+
+	memcpy(r, func->u.p.consts, nconsts * sizeof(ps_val));
+	for (i = 0; i < func->base.m; i++)
+		r[nconsts + i].f = ps_real(fz_clamp(in[i], func->domain[i][0], func->domain[i][1]));
+
+	ps_exec(func->u.p.insns, r);
+
+	for (i = 0; i < func->base.n; i++)
+		out[i] = fz_clamp(r[func->u.p.out[i]].f, func->range[i][0], func->range[i][1]);
+}
+
 static void
 load_postscript_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_obj *dict, int num, int gen)
 {
@@ -873,6 +1690,30 @@ load_postscript_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf
 	}
 
 	func->base.size += func->u.p.cap * sizeof(psobj);
+
+	compile_postscript_func(ctx, func);
+}
+
+static void
+eval_sampled_postscript_func(fz_context *ctx, pdf_function *func, const float *in, float *out)
+{
+	float d0 = func->domain[0][0];
+	float d1 = func->domain[0][1];
+	float t = (fz_clamp(in[0], d0, d1) - d0) * (PS_LUT_SIZE - 1) / (d1 - d0);
+	int n = func->base.n;
+	int i = (int)t;
+	const float *a;
+	int k;
+
+	if (i >= PS_LUT_SIZE - 1)
+	{
+		memcpy(out, &func->u.p.lut[(PS_LUT_SIZE - 1) * n], n * sizeof(float));
+		return;
+	}
+	t -= i;
+	a = &func->u.p.lut[i * n];
+	for (k = 0; k < n; k++)
+		out[k] = a[k] + t * (a[k + n] - a[k]);
 }
 
 static void
@@ -882,6 +1723,17 @@ eval_postscript_func(fz_context *ctx, pdf_function *func, const float *in, float
 	float x;
 	int i;
 
+	if (func->u.p.lut)
+	{
+		eval_sampled_postscript_func(ctx, func, in, out);
+		return;
+	}
+	if (func->u.p.insns)
+	{
+		eval_compiled_postscript_func(ctx, func, in, out);
+		return;
+	}
+
 	ps_init_stack(&st);
 
 	for (i = 0; i < func->base.m; i++)
@@ -899,6 +1751,59 @@ eval_postscript_func(fz_context *ctx, pdf_function *func, const float *in, float
 	}
 }
 
+/* Functions of one input (tint transforms, and the functions of axial and
+ * radial shadings) are sampled at load time, and evaluated by linear
+ * interpolation between the samples. The samples fall on the inputs
+ * k/255 of the domain, so 8 bit image samples and the 256 steps in which
+ * shadings are sampled give back what the program computes, give or take
+ * float rounding. In between, the samples are only used if the program
+ * is found to agree with them there to within half an 8 bit level, so
+ * that steps and other sharp turns are still computed exactly. */
+static void
+sample_postscript_func(fz_context *ctx, pdf_function *func)
+{
+	float d0 = func->domain[0][0];
+	float d1 = func->domain[0][1];
+	int n = func->base.n;
+	float *lut;
+	float x, f, v[FZ_FN_MAXN];
+	int i, j, k;
+
+	if (!(d1 > d0) || !isfinite(d1 - d0))
+		return;
+
+	/* Not having the samples only costs speed */
+	lut = fz_malloc_no_throw(ctx, PS_LUT_SIZE * n * sizeof(float));
+	if (!lut)
+		return;
+	for (i = 0; i < PS_LUT_SIZE; i++)
+	{
+		x = d0 + (d1 - d0) * i / (PS_LUT_SIZE - 1);
+		eval_postscript_func(ctx, func, &x, &lut[i * n]);
+	}
+	for (i = 0; i < PS_LUT_SIZE - 1; i++)
+	{
+		for (j = 1; j < 4; j++)
+		{
+			f = j / 4.0f;
+			x = d0 + (d1 - d0) * (i + f) / (PS_LUT_SIZE - 1);
+			eval_postscript_func(ctx, func, &x, v);
+			for (k = 0; k < n; k++)
+			{
+				float a = lut[i * n + k];
+				float b = lut[(i + 1) * n + k];
+				if (fabsf(a + f * (b - a) - v[k]) > (func->range[k][1] - func->range[k][0]) / 510)
+				{
+					fz_free(ctx, lut);
+					return;
+				}
+			}
+		}
+	}
+	func->u.p.lut = lut;
+	func->base.size += PS_LUT_SIZE * n * sizeof(float);
+}
+
 /*
  * Sample function
  */
@@ -918,7 +1823,7 @@ load_sample_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_obj
 
 	func->u.sa.samples = NULL;
 
-	obj = pdf_dict_gets(ctx, dict, "Size");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Size));
 	if (pdf_array_len(ctx, obj) < func->base.m)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "too few sample function dimension sizes");
 	if (pdf_array_len(ctx, obj) > func->base.m)
@@ -933,7 +1838,7 @@ load_sample_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_obj
 		}
 	}
 
-	obj = pdf_dict_gets(ctx, dict, "BitsPerSample");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(BitsPerSample));
 	func->u.sa.bps = bps = pdf_to_int(ctx, obj);
 
 	for (i = 0; i < func->base.m; i++)
@@ -941,7 +1846,7 @@ load_sample_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_obj
 		func->u.sa.encode[i][0] = 0;
 		func->u.sa.encode[i][1] = func->u.sa.size[i] - 1;
 	}
-	obj = pdf_dict_gets(ctx, dict, "Encode");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Encode));
 	if (pdf_is_array(ctx, obj))
 	{
 		int ranges = fz_mini(func->base.m, pdf_array_len(ctx, obj) / 2);
@@ -961,7 +1866,7 @@ load_sample_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_obj
 		func->u.sa.decode[i][1] = func->range[i][1];
 	}
 
-	obj = pdf_dict_gets(ctx, dict, "Decode");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Decode));
 	if (pdf_is_array(ctx, obj))
 	{
 		int ranges = fz_mini(func->base.n, pdf_array_len(ctx, obj) / 2);
@@ -1140,7 +2045,7 @@ load_exponential_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pd
 		fz_warn(ctx, "exponential functions have at most one input");
 	func->base.m = 1;
 
-	obj = pdf_dict_gets(ctx, dict, "N");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(N));
 	func->u.e.n = pdf_to_real(ctx, obj);
 
 	/* See exponential functions (PDF 1.7 section 3.9.2) */
@@ -1166,7 +2071,7 @@ load_exponential_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pd
 		func->u.e.c1[i] = 1;
 	}
 
-	obj = pdf_dict_gets(ctx, dict, "C0");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(C0));
 	if (pdf_is_array(ctx, obj))
 	{
 		int ranges = fz_mini(func->base.n, pdf_array_len(ctx, obj));
@@ -1177,7 +2082,7 @@ load_exponential_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pd
 			func->u.e.c0[i] = pdf_to_real(ctx, pdf_array_get(ctx, obj, i));
 	}
 
-	obj = pdf_dict_gets(ctx, dict, "C1");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(C1));
 	if (pdf_is_array(ctx, obj))
 	{
 		int ranges = fz_mini(func->base.n, pdf_array_len(ctx, obj));
@@ -1231,7 +2136,7 @@ load_stitching_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_
 		fz_warn(ctx, "stitching functions have at most one input");
 	func->base.m = 1;
 
-	obj = pdf_dict_gets(ctx, dict, "Functions");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Functions));
 	if (!pdf_is_array(ctx, obj))
 		fz_throw(ctx, FZ_ERROR_GENERIC, "stitching function has no input functions");
 
@@ -1268,7 +2173,7 @@ load_stitching_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_
 		fz_rethrow(ctx);
 	}
 
-	obj = pdf_dict_gets(ctx, dict, "Bounds");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Bounds));
 	if (!pdf_is_array(ctx, obj))
 		fz_throw(ctx, FZ_ERROR_GENERIC, "stitching function has no bounds");
 	{
@@ -1296,7 +2201,7 @@ load_stitching_func(fz_context *ctx, pdf_document *doc, pdf_function *func, pdf_
 		func->u.st.encode[i * 2 + 1] = 0;
 	}
 
-	obj = pdf_dict_gets(ctx, dict, "Encode");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Encode));
 	if (pdf_is_array(ctx, obj))
 	{
 		int ranges = fz_mini(k, pdf_array_len(ctx, obj) / 2);
@@ -1379,6 +2284,9 @@ pdf_drop_function_imp(fz_context *ctx, fz_storable *func_)
 		break;
 	case POSTSCRIPT:
 		fz_free(ctx, func->u.p.code);
+		fz_free(ctx, func->u.p.insns);
+		fz_free(ctx, func->u.p.consts);
+		fz_free(ctx, func->u.p.lut);
 		break;
 	}
 	fz_free(ctx, func);
@@ -1644,11 +2552,11 @@ pdf_load_function(fz_context *ctx, pdf_document *doc, pdf_obj *dict, int in, int
 	func->base.debug = pdf_debug_function;
 #endif
 
-	obj = pdf_dict_gets(ctx, dict, "FunctionType");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(FunctionType));
 	func->type = pdf_to_int(ctx, obj);
 
 	/* required for all */
-	obj = pdf_dict_gets(ctx, dict, "Domain");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Domain));
 	func->base.m = fz_clampi(pdf_array_len(ctx, obj) / 2, 1, FZ_FN_MAXM);
 	for (i = 0; i < func->base.m; i++)
 	{
@@ -1657,7 +2565,7 @@ pdf_load_function(fz_context *ctx, pdf_document *doc, pdf_obj *dict, int in, int
 	}
 
 	/* required for type0 and type4, optional otherwise */
-	obj = pdf_dict_gets(ctx, dict, "Range");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Range));
 	if (pdf_is_array(ctx, obj))
 	{
 		func->has_range = 1;
@@ -1697,6 +2605,8 @@ pdf_load_function(fz_context *ctx, pdf_document *doc, pdf_obj *dict, int in, int
 
 		case POSTSCRIPT:
 			load_postscript_func(ctx, doc, func, dict, pdf_to_num(ctx, dict), pdf_to_gen(ctx, dict));
+			if (func->base.m == 1)
+				sample_postscript_func(ctx, func);
 			break;
 
 		default:
@@ -55,13 +55,13 @@ pdf_load_image_imp(fz_context *ctx, pdf_document *doc, pdf_obj *rdb, pdf_obj *di
 			break; /* Out of fz_try */
 		}
 
-		w = pdf_to_int(ctx, pdf_dict_getsa(ctx, dict, "Width", "W"));
-		h = pdf_to_int(ctx, pdf_dict_getsa(ctx, dict, "Height", "H"));
-		bpc = pdf_to_int(ctx, pdf_dict_getsa(ctx, dict, "BitsPerComponent", "BPC"));
+		w = pdf_to_int(ctx, pdf_dict_geta(ctx, dict, PDF_NAME(Width), PDF_NAME(W)));
+		h = pdf_to_int(ctx, pdf_dict_geta(ctx, dict, PDF_NAME(Height), PDF_NAME(H)));
+		bpc = pdf_to_int(ctx, pdf_dict_geta(ctx, dict, PDF_NAME(BitsPerComponent), PDF_NAME(BPC)));
 		if (bpc == 0)
 			bpc = 8;
-		imagemask = pdf_to_bool(ctx, pdf_dict_getsa(ctx, dict, "ImageMask", "IM"));
-		interpolate = pdf_to_bool(ctx, pdf_dict_getsa(ctx, dict, "Interpolate", "I"));
+		imagemask = pdf_to_bool(ctx, pdf_dict_geta(ctx, dict, PDF_NAME(ImageMask), PDF_NAME(IM)));
+		interpolate = pdf_to_bool(ctx, pdf_dict_geta(ctx, dict, PDF_NAME(Interpolate), PDF_NAME(I)));
 
 		indexed = 0;
 		usecolorkey = 0;
@@ -82,13 +82,13 @@ pdf_load_image_imp(fz_context *ctx, pdf_document *doc, pdf_obj *rdb, pdf_obj *di
 		if (h > (1 << 16))
 			fz_throw(ctx, FZ_ERROR_GENERIC, "image is too high");
 
-		obj = pdf_dict_getsa(ctx, dict, "ColorSpace", "CS");
+		obj = pdf_dict_geta(ctx, dict, PDF_NAME(ColorSpace), PDF_NAME(CS));
 		if (obj && !imagemask && !forcemask)
 		{
 			/* colorspace resource lookup is only done for inline images */
 			if (pdf_is_name(ctx, obj))
 			{
-				res = pdf_dict_get(ctx, pdf_dict_gets(ctx, rdb, "ColorSpace"), obj);
+				res = pdf_dict_get(ctx, pdf_dict_get(ctx, rdb, PDF_NAME(ColorSpace)), obj);
 				if (res)
 					obj = res;
 			}
@@ -103,7 +103,7 @@ pdf_load_image_imp(fz_context *ctx, pdf_document *doc, pdf_obj *rdb, pdf_obj *di
 			n = 1;
 		}
 
-		obj = pdf_dict_getsa(ctx, dict, "Decode", "D");
+		obj = pdf_dict_geta(ctx, dict, PDF_NAME(Decode), PDF_NAME(D));
 		if (obj)
 		{
 			for (i = 0; i < n * 2; i++)
@@ -116,7 +116,7 @@ pdf_load_image_imp(fz_context *ctx, pdf_document *doc, pdf_obj *rdb, pdf_obj *di
 				decode[i] = i & 1 ? maxval : 0;
 		}
 
-		obj = pdf_dict_getsa(ctx, dict, "SMask", "Mask");
+		obj = pdf_dict_geta(ctx, dict, PDF_NAME(SMask), PDF_NAME(Mask));
 		if (pdf_is_dict(ctx, obj))
 		{
 			/* Not allowed for inline images or soft masks */
@@ -127,7 +127,7 @@ pdf_load_image_imp(fz_context *ctx, pdf_document *doc, pdf_obj *rdb, pdf_obj *di
 			else
 			{
 				mask = pdf_load_image_imp(ctx, doc, rdb, obj, NULL, 1);
-				obj = pdf_dict_gets(ctx, obj, "Matte");
+				obj = pdf_dict_get(ctx, obj, PDF_NAME(Matte));
 				if (pdf_is_array(ctx, obj))
 				{
 					usecolorkey = 1;
@@ -191,7 +191,7 @@ pdf_is_jpx_image(fz_context *ctx, pdf_obj *dict)
 	pdf_obj *filter;
 	int i, n;
 
-	filter = pdf_dict_gets(ctx, dict, "Filter");
+	filter = pdf_dict_get(ctx, dict, PDF_NAME(Filter));
 	if (!strcmp(pdf_to_name(ctx, filter), "JPXDecode"))
 		return 1;
 	n = pdf_array_len(ctx, filter);
@@ -222,16 +222,59 @@ pdf_load_jpx(fz_context *ctx, pdf_document *doc, pdf_obj *dict, int forcemask)
 	/* FIXME: We can't handle decode arrays for indexed images currently */
 	fz_try(ctx)
 	{
-		obj = pdf_dict_gets(ctx, dict, "ColorSpace");
+		obj = pdf_dict_get(ctx, dict, PDF_NAME(ColorSpace));
 		if (obj)
 		{
 			colorspace = pdf_load_colorspace(ctx, doc, obj);
 			indexed = fz_colorspace_is_indexed(ctx, colorspace);
 		}
 
+		/* Unless we have to work on the pixels here, keep the data and
+		 * decode it on demand, which lets us decode just the parts that
+		 * are drawn. */
+		if (!forcemask && !indexed)
+		{
+			fz_compressed_buffer *bc;
+			fz_colorspace *jpxcs;
+			float decode[FZ_MAX_COLORS * 2];
+			float *decodep = NULL;
+			int w, h, xres, yres, i;
+
+			fz_load_jpx_info(ctx, buf->data, buf->len, &w, &h, &xres, &yres, &jpxcs);
+			if (jpxcs)
+			{
+				if (colorspace && colorspace->n != jpxcs->n)
+				{
+					fz_warn(ctx, "jpx file and dict colorspaces do not match");
+					fz_drop_colorspace(ctx, colorspace);
+					colorspace = NULL;
+				}
+				if (!colorspace)
+					colorspace = fz_keep_colorspace(ctx, jpxcs);
+
+				obj = pdf_dict_geta(ctx, dict, PDF_NAME(SMask), PDF_NAME(Mask));
+				if (pdf_is_dict(ctx, obj))
+					mask = pdf_load_image_imp(ctx, doc, NULL, obj, NULL, 1);
+
+				obj = pdf_dict_geta(ctx, dict, PDF_NAME(Decode), PDF_NAME(D));
+				if (obj)
+				{
+					for (i = 0; i < colorspace->n * 2; i++)
+						decode[i] = pdf_to_real(ctx, pdf_array_get(ctx, obj, i));
+					decodep = decode;
+				}
+
+				bc = fz_malloc_struct(ctx, fz_compressed_buffer);
+				bc->buffer = fz_keep_buffer(ctx, buf);
+				bc->params.type = FZ_IMAGE_JPX;
+				img = fz_new_image(ctx, w, h, 8, fz_keep_colorspace(ctx, colorspace), xres, yres, 0, 0, decodep, NULL, bc, mask);
+				break;
+			}
+		}
+
 		pix = fz_load_jpx(ctx, buf->data, buf->len, colorspace, indexed);
 
-		obj = pdf_dict_getsa(ctx, dict, "SMask", "Mask");
+		obj = pdf_dict_geta(ctx, dict, PDF_NAME(SMask), PDF_NAME(Mask));
 		if (pdf_is_dict(ctx, obj))
 		{
 			if (forcemask)
@@ -240,7 +283,7 @@ pdf_load_jpx(fz_context *ctx, pdf_document *doc, pdf_obj *dict, int forcemask)
 				mask = pdf_load_image_imp(ctx, doc, NULL, obj, NULL, 1);
 		}
 
-		obj = pdf_dict_getsa(ctx, dict, "Decode", "D");
+		obj = pdf_dict_geta(ctx, dict, PDF_NAME(Decode), PDF_NAME(D));
 		if (obj && !indexed)
 		{
 			float decode[FZ_MAX_COLORS * 2];
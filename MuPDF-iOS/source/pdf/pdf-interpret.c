@@ -334,7 +334,7 @@ pdf_process_stream(pdf_csi *csi, pdf_lexbuf *buf)
 						pdf_array_push_drop(ctx, csi->obj, pdf_new_real(ctx, doc, buf->f));
 						break;
 					case PDF_TOK_INT:
-						pdf_array_push_drop(ctx, csi->obj, pdf_new_int(ctx, doc, buf->i));
+						pdf_array_push_drop(ctx, csi->obj, pdf_new_int_offset(ctx, doc, buf->i));
 						break;
 					case PDF_TOK_STRING:
 						pdf_array_push_drop(ctx, csi->obj, pdf_new_string(ctx, doc, buf->scratch, buf->len));
@@ -554,7 +554,7 @@ pdf_process_annot(fz_context *ctx, pdf_document *doc, pdf_page *page, pdf_annot
 	csi = pdf_new_csi(ctx, doc, cookie, process);
 	fz_try(ctx)
 	{
-		flags = pdf_to_int(ctx, pdf_dict_gets(ctx, annot->obj, "F"));
+		flags = pdf_to_int(ctx, pdf_dict_get(ctx, annot->obj, PDF_NAME(F)));
 
 		/* Check not invisible (bit 0) and hidden (bit 1) */
 		/* TODO: NoZoom and NoRotate */
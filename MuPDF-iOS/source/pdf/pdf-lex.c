@@ -1,5 +1,9 @@
 #include "mupdf/pdf.h"
 
+#ifdef ARCH_X86_SIMD
+#include <emmintrin.h>
+#endif
+
 #define IS_NUMBER \
 	'+':case'-':case'.':case'0':case'1':case'2':case'3':\
 	case'4':case'5':case'6':case'7':case'8':case'9'
@@ -43,10 +47,124 @@ static inline int unhex(int ch)
 	return 0;
 }
 
+/*
+ * The helpers below first work straight on the bytes already in the
+ * stream buffer (rp to wp), which for a content stream usually holds many
+ * tokens, and only fall back to reading a byte at a time through
+ * fz_read_byte where a token runs into the end of the buffer.
+ */
+
+enum
+{
+	LEX_WHITE = 1,
+	LEX_DELIM = 2,
+	LEX_HEX = 4,
+	LEX_HASH = 8,
+	LEX_NAME_END = LEX_WHITE | LEX_DELIM | LEX_HASH
+};
+
+static const unsigned char lex_class[256] =
+{
+	1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 0, 0, 8, 0, 2, 0, 0, 2, 2, 0, 0, 0, 0, 0, 2,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 2, 0, 2, 0,
+	0, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 0,
+	0, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#ifdef ARCH_X86_SIMD
+
+/* Bit mask of the bytes in v that are equal to c */
+static inline int
+match16(__m128i v, int c)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+#endif
+
+/* Return the first byte in p..e that is not white space */
+static inline unsigned char *
+skip_white(unsigned char *p, unsigned char *e)
+{
+	/* Most runs are a single space */
+	if (p < e && !(lex_class[*p] & LEX_WHITE))
+		return p;
+#ifdef ARCH_X86_SIMD
+	while (e - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		int m = match16(v, ' ') | match16(v, '\n') | match16(v, '\r') |
+			match16(v, '\t') | match16(v, '\f') | match16(v, 0);
+		m = ~m & 0xffff;
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+#endif
+	while (p < e && (lex_class[*p] & LEX_WHITE))
+		p++;
+	return p;
+}
+
+/* Return the first end of line in p..e, or e */
+static inline unsigned char *
+find_eol(unsigned char *p, unsigned char *e)
+{
+#ifdef ARCH_X86_SIMD
+	while (e - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		int m = match16(v, '\n') | match16(v, '\r');
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+#endif
+	while (p < e && *p != '\n' && *p != '\r')
+		p++;
+	return p;
+}
+
+/* Return the first parenthesis or backslash in p..e, or e */
+static inline unsigned char *
+find_string_special(unsigned char *p, unsigned char *e)
+{
+#ifdef ARCH_X86_SIMD
+	while (e - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		int m = match16(v, '(') | match16(v, ')') | match16(v, '\\');
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+#endif
+	while (p < e && *p != '(' && *p != ')' && *p != '\\')
+		p++;
+	return p;
+}
+
 static void
 lex_white(fz_context *ctx, fz_stream *f)
 {
 	int c;
+
+	f->rp = skip_white(f->rp, f->wp);
+	if (f->rp < f->wp)
+		return;
+
 	do {
 		c = fz_read_byte(ctx, f);
 	} while ((c <= 32) && (iswhite(c)));
@@ -58,19 +176,103 @@ static void
 lex_comment(fz_context *ctx, fz_stream *f)
 {
 	int c;
+
+	f->rp = find_eol(f->rp, f->wp);
+	if (f->rp < f->wp)
+	{
+		f->rp++;
+		return;
+	}
+
 	do {
 		c = fz_read_byte(ctx, f);
 	} while ((c != '\012') && (c != '\015') && (c != EOF));
 }
 
+/* Parse a number that ends within the stream buffer, as lex_number does.
+ * Returns PDF_TOK_ERROR, having consumed nothing, if it runs into the end. */
+static int
+lex_number_buffered(fz_stream *f, pdf_lexbuf *buf, int c)
+{
+	unsigned char *p = f->rp;
+	unsigned char *e = f->wp;
+	int neg = 0;
+	fz_off_t i = 0;
+	int n = 0;
+	int d = 1;
+	float v;
+
+	switch (c)
+	{
+	case '.':
+		goto after_dot;
+	case '-':
+		neg = 1;
+		break;
+	case '+':
+		break;
+	default:
+		i = c - '0';
+		break;
+	}
+
+	while (1)
+	{
+		if (p == e)
+			return PDF_TOK_ERROR;
+		c = *p;
+		if (c == '.')
+		{
+			p++;
+			goto after_dot;
+		}
+		if (c < '0' || c > '9')
+		{
+			f->rp = p;
+			buf->i = neg ? -i : i;
+			return PDF_TOK_INT;
+		}
+		i = 10*i + c - '0';
+		p++;
+	}
+
+after_dot:
+	while (1)
+	{
+		if (p == e)
+			return PDF_TOK_ERROR;
+		c = *p;
+		if (c < '0' || c > '9')
+			break;
+		/* Ignore digits that are too small to matter */
+		if (d < INT_MAX/10)
+		{
+			n = n*10 + (c - '0');
+			d *= 10;
+		}
+		p++;
+	}
+	f->rp = p;
+	v = (float)i + ((float)n / (float)d);
+	if (neg)
+		v = -v;
+	buf->f = v;
+	return PDF_TOK_REAL;
+}
+
 static int
 lex_number(fz_context *ctx, fz_stream *f, pdf_lexbuf *buf, int c)
 {
 	int neg = 0;
-	int i = 0;
+	fz_off_t i = 0;
 	int n;
 	int d;
 	float v;
+	int tok;
+
+	tok = lex_number_buffered(f, buf, c);
+	if (tok != PDF_TOK_ERROR)
+		return tok;
 
 	/* Initially we might have +, -, . or a digit */
 	switch (c)
@@ -166,7 +368,26 @@ lex_name(fz_context *ctx, fz_stream *f, pdf_lexbuf *buf)
 
 	while (n > 1)
 	{
-		int c = fz_read_byte(ctx, f);
+		unsigned char *p = f->rp;
+		unsigned char *e = f->wp;
+		int c;
+
+		/* Copy the run of plain characters in the buffer in one go */
+		if (e - p > n - 1)
+			e = p + n - 1;
+		while (p < e && !(lex_class[*p] & LEX_NAME_END))
+			p++;
+		if (p > f->rp)
+		{
+			memcpy(s, f->rp, p - f->rp);
+			s += p - f->rp;
+			n -= p - f->rp;
+			f->rp = p;
+			if (n == 1)
+				break;
+		}
+
+		c = fz_read_byte(ctx, f);
 		switch (c)
 		{
 		case IS_WHITE:
@@ -242,11 +463,28 @@ lex_string(fz_context *ctx, fz_stream *f, pdf_lexbuf *lb)
 
 	while (1)
 	{
+		unsigned char *p, *pe;
+
 		if (s == e)
 		{
 			s += pdf_lexbuf_grow(ctx, lb);
 			e = lb->scratch + lb->size;
 		}
+
+		/* Copy the run of plain characters in the buffer in one go */
+		pe = f->wp;
+		if (pe - f->rp > e - s)
+			pe = f->rp + (e - s);
+		p = find_string_special(f->rp, pe);
+		if (p > f->rp)
+		{
+			memcpy(s, f->rp, p - f->rp);
+			s += p - f->rp;
+			f->rp = p;
+			if (s == e)
+				continue;
+		}
+
 		c = fz_read_byte(ctx, f);
 		switch (c)
 		{
@@ -339,11 +577,27 @@ lex_hex_string(fz_context *ctx, fz_stream *f, pdf_lexbuf *lb)
 
 	while (1)
 	{
+		unsigned char *p = f->rp;
+
 		if (s == e)
 		{
 			s += pdf_lexbuf_grow(ctx, lb);
 			e = lb->scratch + lb->size;
 		}
+
+		/* Decode the pairs of hex digits in the buffer in one go */
+		if (!x)
+		{
+			while (s < e && f->wp - p >= 2 && (lex_class[p[0]] & lex_class[p[1]] & LEX_HEX))
+			{
+				*s++ = unhex(p[0]) * 16 + unhex(p[1]);
+				p += 2;
+			}
+			f->rp = p;
+			if (s == e)
+				continue;
+		}
+
 		c = fz_read_byte(ctx, f);
 		switch (c)
 		{
@@ -603,7 +857,7 @@ void pdf_print_token(fz_context *ctx, fz_buffer *fzbuf, int tok, pdf_lexbuf *buf
 		fz_buffer_printf(ctx, fzbuf, "}");
 		break;
 	case PDF_TOK_INT:
-		fz_buffer_printf(ctx, fzbuf, "%d", buf->i);
+		fz_buffer_printf(ctx, fzbuf, "%" FZ_FMT_OFF, buf->i);
 		break;
 	case PDF_TOK_REAL:
 		{
@@ -38,7 +38,7 @@ struct pdf_obj_s
 	union
 	{
 		int b;
-		int i;
+		fz_off_t i;
 		float f;
 		struct {
 			unsigned short len;
@@ -62,11 +62,61 @@ struct pdf_obj_s
 	} u;
 };
 
+/* Interned names. These are never freed, so have a negative reference
+ * count, and are never altered once created. */
+
+static pdf_obj pdf_name_atoms[] =
+{
+#define PDF_MAKE_NAME(STRING,NAME) { -1, PDF_NAME, 0, NULL, 0, { 0 } },
+#include "mupdf/pdf/name-table.h"
+#undef PDF_MAKE_NAME
+};
+
+static const char *pdf_name_strings[] =
+{
+#define PDF_MAKE_NAME(STRING,NAME) STRING,
+#include "mupdf/pdf/name-table.h"
+#undef PDF_MAKE_NAME
+};
+
+pdf_obj *const pdf_name_table[] =
+{
+#define PDF_MAKE_NAME(STRING,NAME) &pdf_name_atoms[PDF_ENUM_NAME_##NAME],
+#include "mupdf/pdf/name-table.h"
+#undef PDF_MAKE_NAME
+};
+
+#define OBJ_IS_ATOM(obj) \
+	((obj) >= pdf_name_atoms && (obj) < pdf_name_atoms + PDF_ENUM_NAME__LIMIT)
+
+#define NAME(obj) \
+	(OBJ_IS_ATOM(obj) ? (char *)pdf_name_strings[(obj) - pdf_name_atoms] : (obj)->u.n)
+
+static pdf_obj *
+pdf_find_name_atom(const char *str)
+{
+	int l = 0;
+	int r = PDF_ENUM_NAME__LIMIT - 1;
+
+	while (l <= r)
+	{
+		int m = (l + r) >> 1;
+		int c = strcmp(str, pdf_name_strings[m]);
+		if (c < 0)
+			r = m - 1;
+		else if (c > 0)
+			l = m + 1;
+		else
+			return &pdf_name_atoms[m];
+	}
+	return NULL;
+}
+
 pdf_obj *
 pdf_new_null(fz_context *ctx, pdf_document *doc)
 {
 	pdf_obj *obj;
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(null)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(null)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_NULL;
@@ -79,7 +129,7 @@ pdf_obj *
 pdf_new_bool(fz_context *ctx, pdf_document *doc, int b)
 {
 	pdf_obj *obj;
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(bool)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(bool)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_BOOL;
@@ -91,9 +141,15 @@ pdf_new_bool(fz_context *ctx, pdf_document *doc, int b)
 
 pdf_obj *
 pdf_new_int(fz_context *ctx, pdf_document *doc, int i)
+{
+	return pdf_new_int_offset(ctx, doc, i);
+}
+
+pdf_obj *
+pdf_new_int_offset(fz_context *ctx, pdf_document *doc, fz_off_t i)
 {
 	pdf_obj *obj;
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(int)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(int)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_INT;
@@ -107,7 +163,7 @@ pdf_obj *
 pdf_new_real(fz_context *ctx, pdf_document *doc, float f)
 {
 	pdf_obj *obj;
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(real)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(real)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_REAL;
@@ -137,6 +193,11 @@ pdf_obj *
 pdf_new_name(fz_context *ctx, pdf_document *doc, const char *str)
 {
 	pdf_obj *obj;
+
+	obj = pdf_find_name_atom(str);
+	if (obj)
+		return obj;
+
 	obj = Memento_label(fz_malloc(ctx, offsetof(pdf_obj, u.n) + strlen(str) + 1), "pdf_obj(name)");
 	obj->doc = doc;
 	obj->refs = 1;
@@ -151,7 +212,7 @@ pdf_obj *
 pdf_new_indirect(fz_context *ctx, pdf_document *doc, int num, int gen)
 {
 	pdf_obj *obj;
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(indirect)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(indirect)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_INDIRECT;
@@ -165,7 +226,7 @@ pdf_new_indirect(fz_context *ctx, pdf_document *doc, int num, int gen)
 pdf_obj *
 pdf_keep_obj(fz_context *ctx, pdf_obj *obj)
 {
-	if (obj)
+	if (obj && obj->refs > 0)
 		obj->refs ++;
 	return obj;
 }
@@ -247,12 +308,24 @@ int pdf_to_int(fz_context *ctx, pdf_obj *obj)
 	if (!obj)
 		return 0;
 	if (obj->kind == PDF_INT)
-		return obj->u.i;
+		return (int)obj->u.i;
 	if (obj->kind == PDF_REAL)
 		return (int)(obj->u.f + 0.5f); /* No roundf in MSVC */
 	return 0;
 }
 
+fz_off_t pdf_to_offset(fz_context *ctx, pdf_obj *obj)
+{
+	RESOLVE(obj);
+	if (!obj)
+		return 0;
+	if (obj->kind == PDF_INT)
+		return obj->u.i;
+	if (obj->kind == PDF_REAL)
+		return (fz_off_t)(obj->u.f + 0.5f); /* No roundf in MSVC */
+	return 0;
+}
+
 float pdf_to_real(fz_context *ctx, pdf_obj *obj)
 {
 	RESOLVE(obj);
@@ -270,7 +343,7 @@ char *pdf_to_name(fz_context *ctx, pdf_obj *obj)
 	RESOLVE(obj);
 	if (!obj || obj->kind != PDF_NAME)
 		return "";
-	return obj->u.n;
+	return NAME(obj);
 }
 
 char *pdf_to_str_buf(fz_context *ctx, pdf_obj *obj)
@@ -290,6 +363,11 @@ int pdf_to_str_len(fz_context *ctx, pdf_obj *obj)
 }
 
 void pdf_set_int(fz_context *ctx, pdf_obj *obj, int i)
+{
+	pdf_set_int_offset(ctx, obj, i);
+}
+
+void pdf_set_int_offset(fz_context *ctx, pdf_obj *obj, fz_off_t i)
 {
 	if (!obj || obj->kind != PDF_INT)
 		return;
@@ -357,7 +435,11 @@ pdf_objcmp(fz_context *ctx, pdf_obj *a, pdf_obj *b)
 		return a->u.b - b->u.b;
 
 	case PDF_INT:
-		return a->u.i - b->u.i;
+		if (a->u.i < b->u.i)
+			return -1;
+		if (a->u.i > b->u.i)
+			return 1;
+		return 0;
 
 	case PDF_REAL:
 		if (a->u.f < b->u.f)
@@ -382,7 +464,7 @@ pdf_objcmp(fz_context *ctx, pdf_obj *a, pdf_obj *b)
 		return memcmp(a->u.s.buf, b->u.s.buf, a->u.s.len);
 
 	case PDF_NAME:
-		return strcmp(a->u.n, b->u.n);
+		return strcmp(NAME(a), NAME(b));
 
 	case PDF_INDIRECT:
 		if (a->u.r.num == b->u.r.num)
@@ -439,7 +521,7 @@ pdf_new_array(fz_context *ctx, pdf_document *doc, int initialcap)
 	pdf_obj *obj;
 	int i;
 
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(array)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(array)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_ARRAY;
@@ -455,7 +537,7 @@ pdf_new_array(fz_context *ctx, pdf_document *doc, int initialcap)
 	}
 	fz_catch(ctx)
 	{
-		fz_free(ctx, obj);
+		fz_free_small(ctx, obj, sizeof(pdf_obj));
 		fz_rethrow(ctx);
 	}
 	for (i = 0; i < obj->u.a.cap; i++)
@@ -778,7 +860,7 @@ static int keyvalcmp(const void *ap, const void *bp)
 	const struct keyval *a = ap;
 	const struct keyval *b = bp;
 	if (a->k->kind == PDF_NAME && b->k->kind == PDF_NAME)
-		return strcmp(a->k->u.n, b->k->u.n);
+		return strcmp(NAME(a->k), NAME(b->k));
 	return 0;
 }
 
@@ -788,7 +870,7 @@ pdf_new_dict(fz_context *ctx, pdf_document *doc, int initialcap)
 	pdf_obj *obj;
 	int i;
 
-	obj = Memento_label(fz_malloc(ctx, sizeof(pdf_obj)), "pdf_obj(dict)");
+	obj = Memento_label(fz_malloc_small(ctx, sizeof(pdf_obj)), "pdf_obj(dict)");
 	obj->doc = doc;
 	obj->refs = 1;
 	obj->kind = PDF_DICT;
@@ -804,7 +886,7 @@ pdf_new_dict(fz_context *ctx, pdf_document *doc, int initialcap)
 	}
 	fz_catch(ctx)
 	{
-		fz_free(ctx, obj);
+		fz_free_small(ctx, obj, sizeof(pdf_obj));
 		fz_rethrow(ctx);
 	}
 	for (i = 0; i < obj->u.d.cap; i++)
@@ -951,6 +1033,26 @@ pdf_dict_finds(fz_context *ctx, pdf_obj *obj, const char *key, int *location)
 	return -1;
 }
 
+/* Interned keys are found by pointer comparison alone, as every name
+ * object with the same string is the same atom. */
+static int
+pdf_dict_find(fz_context *ctx, pdf_obj *obj, pdf_obj *key, int *location)
+{
+	if (OBJ_IS_ATOM(key) && !(obj->flags & PDF_FLAGS_SORTED))
+	{
+		int i;
+		for (i = 0; i < obj->u.d.len; i++)
+			if (obj->u.d.items[i].k == key)
+				return i;
+
+		if (location)
+			*location = obj->u.d.len;
+		return -1;
+	}
+
+	return pdf_dict_finds(ctx, obj, NAME(key), location);
+}
+
 pdf_obj *
 pdf_dict_gets(fz_context *ctx, pdf_obj *obj, const char *key)
 {
@@ -1005,9 +1107,20 @@ pdf_dict_getp(fz_context *ctx, pdf_obj *obj, const char *keys)
 pdf_obj *
 pdf_dict_get(fz_context *ctx, pdf_obj *obj, pdf_obj *key)
 {
+	int i;
+
 	if (!key || key->kind != PDF_NAME)
 		return NULL;
-	return pdf_dict_gets(ctx, obj, pdf_to_name(ctx, key));
+
+	RESOLVE(obj);
+	if (!obj || obj->kind != PDF_DICT)
+		return NULL;
+
+	i = pdf_dict_find(ctx, obj, key, NULL);
+	if (i >= 0)
+		return obj->u.d.items[i].v;
+
+	return NULL;
 }
 
 pdf_obj *
@@ -1020,6 +1133,16 @@ pdf_dict_getsa(fz_context *ctx, pdf_obj *obj, const char *key, const char *abbre
 	return pdf_dict_gets(ctx, obj, abbrev);
 }
 
+pdf_obj *
+pdf_dict_geta(fz_context *ctx, pdf_obj *obj, pdf_obj *key, pdf_obj *abbrev)
+{
+	pdf_obj *v;
+	v = pdf_dict_get(ctx, obj, key);
+	if (v)
+		return v;
+	return pdf_dict_get(ctx, obj, abbrev);
+}
+
 void
 pdf_dict_put(fz_context *ctx, pdf_obj *obj, pdf_obj *key, pdf_obj *val)
 {
@@ -1054,7 +1177,7 @@ pdf_dict_put(fz_context *ctx, pdf_obj *obj, pdf_obj *key, pdf_obj *val)
 		if (obj->u.d.len > 100 && !(obj->flags & PDF_FLAGS_SORTED))
 			pdf_sort_dict(ctx, obj);
 
-		i = pdf_dict_finds(ctx, obj, s, &location);
+		i = pdf_dict_find(ctx, obj, key, &location);
 		if (i >= 0 && i < obj->u.d.len)
 		{
 			if (obj->u.d.items[i].v != val)
@@ -1085,6 +1208,17 @@ pdf_dict_put(fz_context *ctx, pdf_obj *obj, pdf_obj *key, pdf_obj *val)
 	return; /* Can't warn :( */
 }
 
+void
+pdf_dict_put_drop(fz_context *ctx, pdf_obj *obj, pdf_obj *key, pdf_obj *val)
+{
+	fz_try(ctx)
+		pdf_dict_put(ctx, obj, key, val);
+	fz_always(ctx)
+		pdf_drop_obj(ctx, val);
+	fz_catch(ctx)
+		fz_rethrow(ctx);
+}
+
 void
 pdf_dict_puts(fz_context *ctx, pdf_obj *obj, const char *key, pdf_obj *val)
 {
@@ -1194,6 +1328,21 @@ pdf_dict_putp_drop(fz_context *ctx, pdf_obj *obj, const char *keys, pdf_obj *val
 		fz_rethrow(ctx);
 }
 
+static void
+pdf_dict_del_index(fz_context *ctx, pdf_obj *obj, int i)
+{
+	if (i >= 0)
+	{
+		pdf_drop_obj(ctx, obj->u.d.items[i].k);
+		pdf_drop_obj(ctx, obj->u.d.items[i].v);
+		obj->flags &= ~PDF_FLAGS_SORTED;
+		obj->u.d.items[i] = obj->u.d.items[obj->u.d.len-1];
+		obj->u.d.len --;
+	}
+
+	object_altered(ctx, obj, NULL);
+}
+
 void
 pdf_dict_dels(fz_context *ctx, pdf_obj *obj, const char *key)
 {
@@ -1203,19 +1352,7 @@ pdf_dict_dels(fz_context *ctx, pdf_obj *obj, const char *key)
 		if (obj->kind != PDF_DICT)
 			fz_warn(ctx, "assert: not a dict (%s)", pdf_objkindstr(obj));
 		else
-		{
-			int i = pdf_dict_finds(ctx, obj, key, NULL);
-			if (i >= 0)
-			{
-				pdf_drop_obj(ctx, obj->u.d.items[i].k);
-				pdf_drop_obj(ctx, obj->u.d.items[i].v);
-				obj->flags &= ~PDF_FLAGS_SORTED;
-				obj->u.d.items[i] = obj->u.d.items[obj->u.d.len-1];
-				obj->u.d.len --;
-			}
-		}
-
-		object_altered(ctx, obj, NULL);
+			pdf_dict_del_index(ctx, obj, pdf_dict_finds(ctx, obj, key, NULL));
 	}
 	return; /* Can't warn :( */
 }
@@ -1224,9 +1361,17 @@ void
 pdf_dict_del(fz_context *ctx, pdf_obj *obj, pdf_obj *key)
 {
 	RESOLVE(key);
-	if (key && key->kind == PDF_NAME)
-		pdf_dict_dels(ctx, obj, key->u.n);
-	/* else Can't warn */
+	if (!key || key->kind != PDF_NAME)
+		return; /* Can't warn */
+
+	RESOLVE(obj);
+	if (obj)
+	{
+		if (obj->kind != PDF_DICT)
+			fz_warn(ctx, "assert: not a dict (%s)", pdf_objkindstr(obj));
+		else
+			pdf_dict_del_index(ctx, obj, pdf_dict_find(ctx, obj, key, NULL));
+	}
 }
 
 void
@@ -1256,7 +1401,7 @@ pdf_mark_obj(fz_context *ctx, pdf_obj *obj)
 {
 	int marked;
 	RESOLVE(obj);
-	if (!obj)
+	if (!obj || OBJ_IS_ATOM(obj))
 		return 0;
 	marked = !!(obj->flags & PDF_FLAGS_MARKED);
 	obj->flags |= PDF_FLAGS_MARKED;
@@ -1267,7 +1412,7 @@ void
 pdf_unmark_obj(fz_context *ctx, pdf_obj *obj)
 {
 	RESOLVE(obj);
-	if (!obj)
+	if (!obj || OBJ_IS_ATOM(obj))
 		return;
 	obj->flags &= ~PDF_FLAGS_MARKED;
 }
@@ -1275,6 +1420,8 @@ pdf_unmark_obj(fz_context *ctx, pdf_obj *obj)
 void
 pdf_set_obj_memo(fz_context *ctx, pdf_obj *obj, int memo)
 {
+	if (OBJ_IS_ATOM(obj))
+		return;
 	obj->flags |= PDF_FLAGS_MEMO;
 	if (memo)
 		obj->flags |= PDF_FLAGS_MEMO_BOOL;
@@ -1302,14 +1449,14 @@ int pdf_obj_is_dirty(fz_context *ctx, pdf_obj *obj)
 void pdf_dirty_obj(fz_context *ctx, pdf_obj *obj)
 {
 	RESOLVE(obj);
-	if (!obj)
+	if (!obj || OBJ_IS_ATOM(obj))
 		return;
 	obj->flags |= PDF_FLAGS_DIRTY;
 }
 
 void pdf_clean_obj(fz_context *ctx, pdf_obj *obj)
 {
-	if (!obj)
+	if (!obj || OBJ_IS_ATOM(obj))
 		return;
 	obj->flags &= ~PDF_FLAGS_DIRTY;
 }
@@ -1323,7 +1470,7 @@ pdf_drop_array(fz_context *ctx, pdf_obj *obj)
 		pdf_drop_obj(ctx, obj->u.a.items[i]);
 
 	fz_free(ctx, obj->u.a.items);
-	fz_free(ctx, obj);
+	fz_free_small(ctx, obj, sizeof(pdf_obj));
 }
 
 static void
@@ -1337,13 +1484,13 @@ pdf_drop_dict(fz_context *ctx, pdf_obj *obj)
 	}
 
 	fz_free(ctx, obj->u.d.items);
-	fz_free(ctx, obj);
+	fz_free_small(ctx, obj, sizeof(pdf_obj));
 }
 
 void
 pdf_drop_obj(fz_context *ctx, pdf_obj *obj)
 {
-	if (obj)
+	if (obj && obj->refs > 0)
 	{
 		if (--obj->refs)
 			return;
@@ -1351,8 +1498,10 @@ pdf_drop_obj(fz_context *ctx, pdf_obj *obj)
 			pdf_drop_array(ctx, obj);
 		else if (obj->kind == PDF_DICT)
 			pdf_drop_dict(ctx, obj);
-		else
+		else if (obj->kind == PDF_STRING || obj->kind == PDF_NAME)
 			fz_free(ctx, obj);
+		else
+			fz_free_small(ctx, obj, sizeof(pdf_obj));
 	}
 }
 
@@ -1361,7 +1510,7 @@ pdf_set_obj_parent(fz_context *ctx, pdf_obj *obj, int num)
 {
 	int n, i;
 
-	if (!obj)
+	if (!obj || OBJ_IS_ATOM(obj))
 		return;
 
 	obj->parent_num = num;
@@ -1652,7 +1801,7 @@ static void fmt_obj(fz_context *ctx, struct fmt *fmt, pdf_obj *obj)
 		fmt_puts(ctx, fmt, pdf_to_bool(ctx, obj) ? "true" : "false");
 	else if (pdf_is_int(ctx, obj))
 	{
-		fz_snprintf(buf, sizeof buf, "%d", pdf_to_int(ctx, obj));
+		fz_snprintf(buf, sizeof buf, "%" FZ_FMT_OFF, pdf_to_offset(ctx, obj));
 		fmt_puts(ctx, fmt, buf);
 	}
 	else if (pdf_is_real(ctx, obj))
@@ -163,19 +163,19 @@ pdf_buffer_BI(pdf_csi *csi, void *state_)
 		return;
 	}
 
-	filter = pdf_dict_gets(ctx, csi->obj, "Filter");
+	filter = pdf_dict_get(ctx, csi->obj, PDF_NAME(Filter));
 	if (filter == NULL)
-		filter = pdf_dict_gets(ctx, csi->obj, "F");
+		filter = pdf_dict_get(ctx, csi->obj, PDF_NAME(F));
 	if (match == NULL)
 	{
 		/* Remove any filter entry (e.g. Ascii85Decode) */
 		if (filter)
 		{
-			pdf_dict_dels(ctx, csi->obj, "Filter");
-			pdf_dict_dels(ctx, csi->obj, "F");
+			pdf_dict_del(ctx, csi->obj, PDF_NAME(Filter));
+			pdf_dict_del(ctx, csi->obj, PDF_NAME(F));
 		}
-		pdf_dict_dels(ctx, csi->obj, "DecodeParms");
-		pdf_dict_dels(ctx, csi->obj, "DP");
+		pdf_dict_del(ctx, csi->obj, PDF_NAME(DecodeParms));
+		pdf_dict_del(ctx, csi->obj, PDF_NAME(DP));
 	}
 	else if (pdf_is_array(ctx, filter))
 	{
@@ -188,19 +188,19 @@ pdf_buffer_BI(pdf_csi *csi, void *state_)
 			fz_warn(ctx, "Unexpected Filter configuration in inline image");
 			return;
 		}
-		pdf_dict_puts(ctx, csi->obj, "F", o);
+		pdf_dict_put(ctx, csi->obj, PDF_NAME(F), o);
 
-		o = pdf_dict_gets(ctx, csi->obj, "DecodeParms");
+		o = pdf_dict_get(ctx, csi->obj, PDF_NAME(DecodeParms));
 		if (o == NULL)
-			o = pdf_dict_gets(ctx, csi->obj, "DP");
+			o = pdf_dict_get(ctx, csi->obj, PDF_NAME(DP));
 		if (o)
 		{
 			o = pdf_array_get(ctx, o, l-1);
 			if (o)
-				pdf_dict_puts(ctx, csi->obj, "DP", o);
+				pdf_dict_put(ctx, csi->obj, PDF_NAME(DP), o);
 			else
-				pdf_dict_dels(ctx, csi->obj, "DP");
-			pdf_dict_dels(ctx, csi->obj, "DecodeParms");
+				pdf_dict_del(ctx, csi->obj, PDF_NAME(DP));
+			pdf_dict_del(ctx, csi->obj, PDF_NAME(DecodeParms));
 		}
 	}
 	else
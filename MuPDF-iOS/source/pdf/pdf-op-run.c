@@ -160,7 +160,7 @@ pdf_is_hidden_ocg(pdf_obj *ocg, pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb)
 	/* If we've been handed a name, look it up in the properties. */
 	if (pdf_is_name(ctx, ocg))
 	{
-		ocg = pdf_dict_gets(ctx, pdf_dict_gets(ctx, rdb, "Properties"), pdf_to_name(ctx, ocg));
+		ocg = pdf_dict_gets(ctx, pdf_dict_get(ctx, rdb, PDF_NAME(Properties)), pdf_to_name(ctx, ocg));
 	}
 	/* If we haven't been given an ocg at all, then we're visible */
 	if (!ocg)
@@ -169,7 +169,7 @@ pdf_is_hidden_ocg(pdf_obj *ocg, pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb)
 	fz_strlcpy(event_state, pr->event, sizeof event_state);
 	fz_strlcat(event_state, "State", sizeof event_state);
 
-	type = pdf_to_name(ctx, pdf_dict_gets(ctx, ocg, "Type"));
+	type = pdf_to_name(ctx, pdf_dict_get(ctx, ocg, PDF_NAME(Type)));
 
 	if (strcmp(type, "OCG") == 0)
 	{
@@ -192,7 +192,7 @@ pdf_is_hidden_ocg(pdf_obj *ocg, pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb)
 
 		/* Check Intents; if our intent is not part of the set given
 		 * by the current config, we should ignore it. */
-		obj = pdf_dict_gets(ctx, ocg, "Intent");
+		obj = pdf_dict_get(ctx, ocg, PDF_NAME(Intent));
 		if (pdf_is_name(ctx, obj))
 		{
 			/* If it doesn't match, it's hidden */
@@ -228,7 +228,7 @@ pdf_is_hidden_ocg(pdf_obj *ocg, pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb)
 		 * correspond to entries in the AS list in the OCG config.
 		 * Given that we don't handle Zoom or User, or Language
 		 * dicts, this is not really a problem. */
-		obj = pdf_dict_gets(ctx, ocg, "Usage");
+		obj = pdf_dict_get(ctx, ocg, PDF_NAME(Usage));
 		if (!pdf_is_dict(ctx, obj))
 			return default_value;
 		/* FIXME: Should look at Zoom (and return hidden if out of
@@ -252,12 +252,12 @@ pdf_is_hidden_ocg(pdf_obj *ocg, pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb)
 		char *name;
 		int combine, on;
 
-		obj = pdf_dict_gets(ctx, ocg, "VE");
+		obj = pdf_dict_get(ctx, ocg, PDF_NAME(VE));
 		if (pdf_is_array(ctx, obj)) {
 			/* FIXME: Calculate visibility from array */
 			return 0;
 		}
-		name = pdf_to_name(ctx, pdf_dict_gets(ctx, ocg, "P"));
+		name = pdf_to_name(ctx, pdf_dict_get(ctx, ocg, PDF_NAME(P)));
 		/* Set combine; Bit 0 set => AND, Bit 1 set => true means
 		 * Off, otherwise true means On */
 		if (strcmp(name, "AllOn") == 0)
@@ -281,7 +281,7 @@ pdf_is_hidden_ocg(pdf_obj *ocg, pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb)
 			return 0; /* Should never happen */
 		fz_try(ctx)
 		{
-			obj = pdf_dict_gets(ctx, ocg, "OCGs");
+			obj = pdf_dict_get(ctx, ocg, PDF_NAME(OCGs));
 			on = combine & 1;
 			if (pdf_is_array(ctx, obj)) {
 				int i, len;
@@ -1539,7 +1539,7 @@ pdf_run_extgstate(pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb, pdf_obj *extgst
 					gstate->softmask = NULL;
 				}
 
-				group = pdf_dict_gets(ctx, val, "G");
+				group = pdf_dict_get(ctx, val, PDF_NAME(G));
 				if (!group)
 					fz_throw(ctx, FZ_ERROR_GENERIC, "cannot load softmask xobject (%d %d R)", pdf_to_num(ctx, val), pdf_to_gen(ctx, val));
 				xobj = pdf_load_xobject(ctx, csi->doc, group);
@@ -1555,20 +1555,20 @@ pdf_run_extgstate(pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb, pdf_obj *extgst
 				for (k = 0; k < colorspace->n; k++)
 					gstate->softmask_bc[k] = 0;
 
-				bc = pdf_dict_gets(ctx, val, "BC");
+				bc = pdf_dict_get(ctx, val, PDF_NAME(BC));
 				if (pdf_is_array(ctx, bc))
 				{
 					for (k = 0; k < colorspace->n; k++)
 						gstate->softmask_bc[k] = pdf_to_real(ctx, pdf_array_get(ctx, bc, k));
 				}
 
-				luminosity = pdf_dict_gets(ctx, val, "S");
+				luminosity = pdf_dict_get(ctx, val, PDF_NAME(S));
 				if (pdf_is_name(ctx, luminosity) && !strcmp(pdf_to_name(ctx, luminosity), "Luminosity"))
 					gstate->luminosity = 1;
 				else
 					gstate->luminosity = 0;
 
-				tr = pdf_dict_gets(ctx, val, "TR");
+				tr = pdf_dict_get(ctx, val, PDF_NAME(TR));
 				if (tr && strcmp(pdf_to_name(ctx, tr), "Identity"))
 					fz_warn(ctx, "ignoring transfer function");
 			}
@@ -1591,7 +1591,7 @@ pdf_run_extgstate(pdf_csi *csi, pdf_run_state *pr, pdf_obj *rdb, pdf_obj *extgst
 		else if (!strcmp(s, "TR"))
 		{
 			/* TR is ignored in the presence of TR2 */
-			pdf_obj *tr2 = pdf_dict_gets(ctx, extgstate, "TR2");
+			pdf_obj *tr2 = pdf_dict_get(ctx, extgstate, PDF_NAME(TR2));
 			if (tr2 && strcmp(pdf_to_name(ctx, val), "Identity"))
 				fz_warn(ctx, "ignoring transfer function");
 		}
@@ -1760,7 +1760,7 @@ static void pdf_run_BDC(pdf_csi *csi, void *state)
 
 	if (pdf_is_name(ctx, csi->obj))
 	{
-		ocg = pdf_dict_gets(ctx, pdf_dict_gets(ctx, rdb, "Properties"), pdf_to_name(ctx, csi->obj));
+		ocg = pdf_dict_gets(ctx, pdf_dict_get(ctx, rdb, PDF_NAME(Properties)), pdf_to_name(ctx, csi->obj));
 	}
 	else
 		ocg = csi->obj;
@@ -1771,7 +1771,7 @@ static void pdf_run_BDC(pdf_csi *csi, void *state)
 		 * means visible. */
 		return;
 	}
-	if (strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, ocg, "Type")), "OCG") != 0)
+	if (strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, ocg, PDF_NAME(Type))), "OCG") != 0)
 	{
 		/* Wrong type of property */
 		return;
@@ -1847,7 +1847,7 @@ static void pdf_run_cs_imp(pdf_csi *csi, pdf_run_state *pr, int what)
 			colorspace = fz_device_cmyk(ctx); /* No fz_keep_colorspace as static */
 		else
 		{
-			dict = pdf_dict_gets(ctx, rdb, "ColorSpace");
+			dict = pdf_dict_get(ctx, rdb, PDF_NAME(ColorSpace));
 			if (!dict)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find ColorSpace dictionary");
 			obj = pdf_dict_gets(ctx, dict, csi->name);
@@ -1893,7 +1893,7 @@ static void pdf_run_Do(pdf_csi *csi, void *state)
 	pdf_obj *subtype;
 	pdf_obj *rdb = csi->rdb;
 
-	dict = pdf_dict_gets(ctx, rdb, "XObject");
+	dict = pdf_dict_get(ctx, rdb, PDF_NAME(XObject));
 	if (!dict)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find XObject dictionary when looking for: '%s'", csi->name);
 
@@ -1901,15 +1901,15 @@ static void pdf_run_Do(pdf_csi *csi, void *state)
 	if (!obj)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find xobject resource: '%s'", csi->name);
 
-	subtype = pdf_dict_gets(ctx, obj, "Subtype");
+	subtype = pdf_dict_get(ctx, obj, PDF_NAME(Subtype));
 	if (!pdf_is_name(ctx, subtype))
 		fz_throw(ctx, FZ_ERROR_GENERIC, "no XObject subtype specified");
 
-	if (pdf_is_hidden_ocg(pdf_dict_gets(ctx, obj, "OC"), csi, pr, rdb))
+	if (pdf_is_hidden_ocg(pdf_dict_get(ctx, obj, PDF_NAME(OC)), csi, pr, rdb))
 		return;
 
-	if (!strcmp(pdf_to_name(ctx, subtype), "Form") && pdf_dict_gets(ctx, obj, "Subtype2"))
-		subtype = pdf_dict_gets(ctx, obj, "Subtype2");
+	if (!strcmp(pdf_to_name(ctx, subtype), "Form") && pdf_dict_get(ctx, obj, PDF_NAME(Subtype2)))
+		subtype = pdf_dict_get(ctx, obj, PDF_NAME(Subtype2));
 
 	if (!strcmp(pdf_to_name(ctx, subtype), "Form"))
 	{
@@ -2084,7 +2084,7 @@ static void pdf_run_SC_imp(pdf_csi *csi, pdf_run_state *pr, int what, pdf_materi
 		break;
 
 	case PDF_MAT_PATTERN:
-		dict = pdf_dict_gets(ctx, rdb, "Pattern");
+		dict = pdf_dict_get(ctx, rdb, PDF_NAME(Pattern));
 		if (!dict)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find Pattern dictionary");
 
@@ -2092,7 +2092,7 @@ static void pdf_run_SC_imp(pdf_csi *csi, pdf_run_state *pr, int what, pdf_materi
 		if (!obj)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find pattern resource '%s'", csi->name);
 
-		patterntype = pdf_dict_gets(ctx, obj, "PatternType");
+		patterntype = pdf_dict_get(ctx, obj, PDF_NAME(PatternType));
 
 		if (pdf_to_int(ctx, patterntype) == 1)
 		{
@@ -2186,7 +2186,7 @@ static void pdf_run_Tf(pdf_csi *csi, void *state)
 		pdf_drop_font(ctx, gstate->font);
 	gstate->font = NULL;
 
-	dict = pdf_dict_gets(ctx, rdb, "Font");
+	dict = pdf_dict_get(ctx, rdb, PDF_NAME(Font));
 	if (!dict)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find Font dictionary");
 
@@ -2414,7 +2414,7 @@ static void pdf_run_gs(pdf_csi *csi, void *state)
 	fz_context *ctx = csi->ctx;
 	pdf_obj *rdb = csi->rdb;
 
-	dict = pdf_dict_gets(ctx, rdb, "ExtGState");
+	dict = pdf_dict_get(ctx, rdb, PDF_NAME(ExtGState));
 	if (!dict)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find ExtGState dictionary");
 
@@ -2536,7 +2536,7 @@ static void pdf_run_sh(pdf_csi *csi, void *state)
 	pdf_obj *obj;
 	fz_shade *shd;
 
-	dict = pdf_dict_gets(ctx, rdb, "Shading");
+	dict = pdf_dict_get(ctx, rdb, PDF_NAME(Shading));
 	if (!dict)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find shading dictionary");
 
@@ -2662,10 +2662,10 @@ process_annot(pdf_csi *csi, void *state, pdf_obj *resources, pdf_annot *annot)
 	fz_context *ctx = pr->ctx;
 	int flags;
 
-	if (pdf_is_hidden_ocg(pdf_dict_gets(ctx, annot->obj, "OC"), csi, pr, resources))
+	if (pdf_is_hidden_ocg(pdf_dict_get(ctx, annot->obj, PDF_NAME(OC)), csi, pr, resources))
 		return;
 
-	flags = pdf_to_int(ctx, pdf_dict_gets(ctx, annot->obj, "F"));
+	flags = pdf_to_int(ctx, pdf_dict_get(ctx, annot->obj, PDF_NAME(F)));
 	if (!strcmp(pr->event, "Print") && !(flags & (1 << 2))) /* Print */
 		return;
 	if (!strcmp(pr->event, "View") && (flags & (1 << 5))) /* NoView */
@@ -36,7 +36,7 @@ pdf_lookup_page_loc_imp(fz_context *ctx, pdf_document *doc, pdf_obj *node, int *
 	{
 		do
 		{
-			kids = pdf_dict_gets(ctx, node, "Kids");
+			kids = pdf_dict_get(ctx, node, PDF_NAME(Kids));
 			len = pdf_array_len(ctx, kids);
 
 			if (len == 0)
@@ -62,10 +62,10 @@ pdf_lookup_page_loc_imp(fz_context *ctx, pdf_document *doc, pdf_obj *node, int *
 			for (i = 0; i < len; i++)
 			{
 				pdf_obj *kid = pdf_array_get(ctx, kids, i);
-				char *type = pdf_to_name(ctx, pdf_dict_gets(ctx, kid, "Type"));
-				if (*type ? !strcmp(type, "Pages") : pdf_dict_gets(ctx, kid, "Kids") && !pdf_dict_gets(ctx, kid, "MediaBox"))
+				char *type = pdf_to_name(ctx, pdf_dict_get(ctx, kid, PDF_NAME(Type)));
+				if (*type ? !strcmp(type, "Pages") : pdf_dict_get(ctx, kid, PDF_NAME(Kids)) && !pdf_dict_get(ctx, kid, PDF_NAME(MediaBox)))
 				{
-					int count = pdf_to_int(ctx, pdf_dict_gets(ctx, kid, "Count"));
+					int count = pdf_to_int(ctx, pdf_dict_get(ctx, kid, PDF_NAME(Count)));
 					if (*skip < count)
 					{
 						node = kid;
@@ -78,7 +78,7 @@ pdf_lookup_page_loc_imp(fz_context *ctx, pdf_document *doc, pdf_obj *node, int *
 				}
 				else
 				{
-					if (*type ? strcmp(type, "Page") != 0 : !pdf_dict_gets(ctx, kid, "MediaBox"))
+					if (*type ? strcmp(type, "Page") != 0 : !pdf_dict_get(ctx, kid, PDF_NAME(MediaBox)))
 						fz_warn(ctx, "non-page object in page tree (%s)", type);
 					if (*skip == 0)
 					{
@@ -111,14 +111,322 @@ pdf_lookup_page_loc_imp(fz_context *ctx, pdf_document *doc, pdf_obj *node, int *
 	return hit;
 }
 
+/*
+	The flattened page tree. Built on the first lookup by walking the
+	whole tree once; used as long as the /Count entries agree with the
+	tree so that lookups give the same answer the walk above would.
+*/
+
+enum
+{
+	PDF_PAGE_MAP_NONE = 0,
+	PDF_PAGE_MAP_VALID = 1,
+	PDF_PAGE_MAP_BROKEN = -1
+};
+
+struct page_map_frame
+{
+	pdf_obj *node;
+	pdf_obj *kids;
+	int i, len;
+	int first;
+};
+
+static int
+pdf_page_tree_kid_is_node(fz_context *ctx, pdf_obj *kid)
+{
+	char *type = pdf_to_name(ctx, pdf_dict_get(ctx, kid, PDF_NAME(Type)));
+	if (*type)
+		return !strcmp(type, "Pages");
+	return pdf_dict_get(ctx, kid, PDF_NAME(Kids)) && !pdf_dict_get(ctx, kid, PDF_NAME(MediaBox));
+}
+
+static int
+pdf_flatten_page_tree(fz_context *ctx, pdf_document *doc, pdf_obj *root, pdf_obj ***mapp, int *lenp)
+{
+	struct page_map_frame *stack = NULL;
+	int stack_len = 0, stack_max = 0;
+	pdf_obj **map = NULL;
+	int len = 0, max = 0;
+	int ok = 1;
+
+	fz_var(stack);
+	fz_var(stack_len);
+	fz_var(stack_max);
+	fz_var(map);
+	fz_var(len);
+	fz_var(max);
+
+	fz_try(ctx)
+	{
+		pdf_obj *node = root;
+
+		while (ok)
+		{
+			struct page_map_frame *top;
+
+			if (node)
+			{
+				if (stack_len == stack_max)
+				{
+					stack_max = stack_max ? stack_max * 2 : LOCAL_STACK_SIZE;
+					stack = fz_resize_array(ctx, stack, stack_max, sizeof(*stack));
+				}
+				if (pdf_mark_obj(ctx, node))
+				{
+					ok = 0;
+					break;
+				}
+				top = &stack[stack_len++];
+				top->node = node;
+				top->kids = pdf_dict_get(ctx, node, PDF_NAME(Kids));
+				top->len = pdf_array_len(ctx, top->kids);
+				top->i = 0;
+				top->first = len;
+				node = NULL;
+			}
+
+			top = &stack[stack_len - 1];
+			if (top->i == top->len)
+			{
+				/* The walk trusts /Count, so we may only answer for it when they agree */
+				if (len - top->first != pdf_to_int(ctx, pdf_dict_get(ctx, top->node, PDF_NAME(Count))))
+					ok = 0;
+				pdf_unmark_obj(ctx, top->node);
+				if (--stack_len == 0)
+					break;
+				continue;
+			}
+
+			node = pdf_array_get(ctx, top->kids, top->i++);
+			if (!pdf_page_tree_kid_is_node(ctx, node))
+			{
+				if (len == max)
+				{
+					max = max ? max * 2 : 64;
+					map = fz_resize_array(ctx, map, max, sizeof(*map));
+				}
+				map[len++] = pdf_keep_obj(ctx, node);
+				node = NULL;
+			}
+		}
+	}
+	fz_always(ctx)
+	{
+		while (stack_len > 0)
+			pdf_unmark_obj(ctx, stack[--stack_len].node);
+		fz_free(ctx, stack);
+	}
+	fz_catch(ctx)
+	{
+		while (len > 0)
+			pdf_drop_obj(ctx, map[--len]);
+		fz_free(ctx, map);
+		fz_rethrow(ctx);
+	}
+
+	if (!ok)
+	{
+		while (len > 0)
+			pdf_drop_obj(ctx, map[--len]);
+		fz_free(ctx, map);
+		return 0;
+	}
+
+	*mapp = map;
+	*lenp = len;
+	return 1;
+}
+
+void
+pdf_drop_page_map(fz_context *ctx, pdf_document *doc)
+{
+	int i;
+
+	for (i = 0; i < doc->page_map_len; i++)
+		pdf_drop_obj(ctx, doc->page_map[i]);
+	fz_free(ctx, doc->page_map);
+	fz_free(ctx, doc->rev_page_map);
+	doc->page_map = NULL;
+	doc->page_map_len = 0;
+	doc->rev_page_map = NULL;
+	doc->rev_page_map_len = 0;
+	doc->page_map_state = PDF_PAGE_MAP_NONE;
+}
+
+/* Returns the page map, or NULL if lookups must walk the tree */
+static pdf_obj **
+pdf_load_page_map(fz_context *ctx, pdf_document *doc)
+{
+	pdf_obj *root;
+	pdf_obj **map;
+	int len, repaired;
+
+	fz_var(map);
+
+	/* Progressive loading hands out pages as they arrive */
+	if (doc->file_reading_linearly)
+		return NULL;
+
+	/* Whoever resets page_count has changed the page tree behind our back */
+	if (doc->page_count == 0 && doc->page_map_state != PDF_PAGE_MAP_NONE)
+		pdf_drop_page_map(ctx, doc);
+
+	if (doc->page_map_state == PDF_PAGE_MAP_VALID)
+		return doc->page_map;
+	if (doc->page_map_state == PDF_PAGE_MAP_BROKEN)
+		return NULL;
+
+	root = pdf_dict_getp(ctx, pdf_trailer(ctx, doc), "Root/Pages");
+	if (!root)
+		return NULL;
+
+	repaired = doc->repair_attempted;
+	fz_try(ctx)
+	{
+		if (!pdf_flatten_page_tree(ctx, doc, root, &map, &len))
+		{
+			doc->page_map_state = PDF_PAGE_MAP_BROKEN;
+			map = NULL;
+		}
+	}
+	fz_catch(ctx)
+	{
+		if (fz_caught(ctx) == FZ_ERROR_TRYLATER)
+			fz_rethrow(ctx);
+		/* Leave it to the walk to report the problem */
+		doc->page_map_state = PDF_PAGE_MAP_BROKEN;
+		map = NULL;
+	}
+	if (!map)
+		return NULL;
+
+	/* A repair while walking the tree may have replaced the objects we saw */
+	if (doc->repair_attempted != repaired)
+	{
+		while (len > 0)
+			pdf_drop_obj(ctx, map[--len]);
+		fz_free(ctx, map);
+		return NULL;
+	}
+
+	doc->page_map = map;
+	doc->page_map_len = len;
+	doc->page_map_state = PDF_PAGE_MAP_VALID;
+	pdf_count_pages(ctx, doc);
+	return map;
+}
+
+static int
+cmp_rev_page_map(const void *va, const void *vb)
+{
+	const pdf_rev_page_map *a = va;
+	const pdf_rev_page_map *b = vb;
+	if (a->object != b->object)
+		return a->object - b->object;
+	return a->page - b->page;
+}
+
+static pdf_rev_page_map *
+pdf_load_rev_page_map(fz_context *ctx, pdf_document *doc)
+{
+	pdf_rev_page_map *rev;
+	int i, n;
+
+	if (!pdf_load_page_map(ctx, doc))
+		return NULL;
+	if (doc->rev_page_map)
+		return doc->rev_page_map;
+
+	rev = fz_malloc_array(ctx, doc->page_map_len, sizeof(*rev));
+	for (i = n = 0; i < doc->page_map_len; i++)
+	{
+		int num = pdf_to_num(ctx, doc->page_map[i]);
+		if (num > 0)
+		{
+			rev[n].object = num;
+			rev[n].page = i;
+			n++;
+		}
+	}
+	qsort(rev, n, sizeof(*rev), cmp_rev_page_map);
+
+	/* A page object listed more than once has no single number */
+	for (i = 1; i < n; i++)
+		if (rev[i].object == rev[i-1].object)
+			rev[i].page = rev[i-1].page = -1;
+
+	doc->rev_page_map = rev;
+	doc->rev_page_map_len = n;
+	return rev;
+}
+
+/* Drop the page map, or patch it if the page tree still agrees with it */
+static void
+pdf_update_page_map(fz_context *ctx, pdf_document *doc, int at, pdf_obj *inserted)
+{
+	int count;
+
+	count = pdf_to_int(ctx, pdf_dict_getp(ctx, pdf_trailer(ctx, doc), "Root/Pages/Count"));
+	if (doc->page_map_state != PDF_PAGE_MAP_VALID || count != doc->page_map_len + (inserted ? 1 : -1) ||
+		at < 0 || at > doc->page_map_len - (inserted ? 0 : 1))
+	{
+		pdf_drop_page_map(ctx, doc);
+		doc->page_count = 0; /* invalidate cached value */
+		return;
+	}
+
+	fz_free(ctx, doc->rev_page_map);
+	doc->rev_page_map = NULL;
+	doc->rev_page_map_len = 0;
+
+	if (inserted)
+	{
+		fz_try(ctx)
+		{
+			doc->page_map = fz_resize_array(ctx, doc->page_map, doc->page_map_len + 1, sizeof(*doc->page_map));
+		}
+		fz_catch(ctx)
+		{
+			/* The page tree has been changed; lookups can walk it */
+			pdf_drop_page_map(ctx, doc);
+			doc->page_count = 0;
+			return;
+		}
+		memmove(&doc->page_map[at + 1], &doc->page_map[at], (doc->page_map_len - at) * sizeof(*doc->page_map));
+		doc->page_map[at] = pdf_keep_obj(ctx, inserted);
+		doc->page_map_len++;
+	}
+	else
+	{
+		pdf_drop_obj(ctx, doc->page_map[at]);
+		memmove(&doc->page_map[at], &doc->page_map[at + 1], (doc->page_map_len - at - 1) * sizeof(*doc->page_map));
+		doc->page_map_len--;
+	}
+
+	doc->page_count = doc->page_map_len;
+}
+
 pdf_obj *
 pdf_lookup_page_loc(fz_context *ctx, pdf_document *doc, int needle, pdf_obj **parentp, int *indexp)
 {
-	pdf_obj *root = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root");
-	pdf_obj *node = pdf_dict_gets(ctx, root, "Pages");
+	pdf_obj *root = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root));
+	pdf_obj *node = pdf_dict_get(ctx, root, PDF_NAME(Pages));
 	int skip = needle;
 	pdf_obj *hit;
 
+	/* Editing needs the parent node, which only the walk finds */
+	if (!parentp && !indexp)
+	{
+		pdf_obj **map = pdf_load_page_map(ctx, doc);
+		if (map)
+		{
+			if (needle < 0 || needle >= doc->page_map_len)
+				fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find page %d in page tree", needle);
+			return map[needle];
+		}
+	}
+
 	if (!node)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find page tree");
 
@@ -137,16 +445,16 @@ pdf_lookup_page_obj(fz_context *ctx, pdf_document *doc, int needle)
 static int
 pdf_count_pages_before_kid(fz_context *ctx, pdf_document *doc, pdf_obj *parent, int kid_num)
 {
-	pdf_obj *kids = pdf_dict_gets(ctx, parent, "Kids");
+	pdf_obj *kids = pdf_dict_get(ctx, parent, PDF_NAME(Kids));
 	int i, total = 0, len = pdf_array_len(ctx, kids);
 	for (i = 0; i < len; i++)
 	{
 		pdf_obj *kid = pdf_array_get(ctx, kids, i);
 		if (pdf_to_num(ctx, kid) == kid_num)
 			return total;
-		if (!strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, kid, "Type")), "Pages"))
+		if (!strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, kid, PDF_NAME(Type))), "Pages"))
 		{
-			pdf_obj *count = pdf_dict_gets(ctx, kid, "Count");
+			pdf_obj *count = pdf_dict_get(ctx, kid, PDF_NAME(Count));
 			int n = pdf_to_int(ctx, count);
 			if (!pdf_is_int(ctx, count) || n < 0)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "illegal or missing count in pages tree");
@@ -165,10 +473,31 @@ pdf_lookup_page_number(fz_context *ctx, pdf_document *doc, pdf_obj *node)
 	int total = 0;
 	pdf_obj *parent, *parent2;
 
-	if (strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, node, "Type")), "Page") != 0)
+	if (strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, node, PDF_NAME(Type))), "Page") != 0)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "invalid page object");
 
-	parent2 = parent = pdf_dict_gets(ctx, node, "Parent");
+	if (needle > 0)
+	{
+		pdf_rev_page_map *rev = pdf_load_rev_page_map(ctx, doc);
+		int l = 0, r = doc->rev_page_map_len - 1;
+		while (rev && l <= r)
+		{
+			int m = (l + r) >> 1;
+			int c = needle - rev[m].object;
+			if (c < 0)
+				r = m - 1;
+			else if (c > 0)
+				l = m + 1;
+			else
+			{
+				if (rev[m].page >= 0)
+					return rev[m].page;
+				break;
+			}
+		}
+	}
+
+	parent2 = parent = pdf_dict_get(ctx, node, PDF_NAME(Parent));
 	fz_var(parent);
 	fz_try(ctx)
 	{
@@ -178,7 +507,7 @@ pdf_lookup_page_number(fz_context *ctx, pdf_document *doc, pdf_obj *node)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "cycle in page tree (parents)");
 			total += pdf_count_pages_before_kid(ctx, doc, parent, needle);
 			needle = pdf_to_num(ctx, parent);
-			parent = pdf_dict_gets(ctx, parent, "Parent");
+			parent = pdf_dict_get(ctx, parent, PDF_NAME(Parent));
 		}
 	}
 	fz_always(ctx)
@@ -189,7 +518,7 @@ pdf_lookup_page_number(fz_context *ctx, pdf_document *doc, pdf_obj *node)
 			pdf_unmark_obj(ctx, parent2);
 			if (parent2 == parent)
 				break;
-			parent2 = pdf_dict_gets(ctx, parent2, "Parent");
+			parent2 = pdf_dict_get(ctx, parent2, PDF_NAME(Parent));
 		}
 	}
 	fz_catch(ctx)
@@ -217,7 +546,7 @@ pdf_lookup_inherited_page_item(fz_context *ctx, pdf_document *doc, pdf_obj *node
 				break;
 			if (pdf_mark_obj(ctx, node))
 				fz_throw(ctx, FZ_ERROR_GENERIC, "cycle in page tree (parents)");
-			node = pdf_dict_gets(ctx, node, "Parent");
+			node = pdf_dict_get(ctx, node, PDF_NAME(Parent));
 		}
 		while (node);
 	}
@@ -228,7 +557,7 @@ pdf_lookup_inherited_page_item(fz_context *ctx, pdf_document *doc, pdf_obj *node
 			pdf_unmark_obj(ctx, node2);
 			if (node2 == node)
 				break;
-			node2 = pdf_dict_gets(ctx, node2, "Parent");
+			node2 = pdf_dict_get(ctx, node2, PDF_NAME(Parent));
 		}
 		while (node2);
 	}
@@ -247,7 +576,7 @@ static int pdf_resources_use_blending(fz_context *ctx, pdf_document *doc, pdf_ob
 static int
 pdf_extgstate_uses_blending(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 {
-	pdf_obj *obj = pdf_dict_gets(ctx, dict, "BM");
+	pdf_obj *obj = pdf_dict_get(ctx, dict, PDF_NAME(BM));
 	if (pdf_is_name(ctx, obj) && strcmp(pdf_to_name(ctx, obj), "Normal"))
 		return 1;
 	return 0;
@@ -257,17 +586,17 @@ static int
 pdf_pattern_uses_blending(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 {
 	pdf_obj *obj;
-	obj = pdf_dict_gets(ctx, dict, "Resources");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Resources));
 	if (pdf_resources_use_blending(ctx, doc, obj))
 		return 1;
-	obj = pdf_dict_gets(ctx, dict, "ExtGState");
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(ExtGState));
 	return pdf_extgstate_uses_blending(ctx, doc, obj);
 }
 
 static int
 pdf_xobject_uses_blending(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 {
-	pdf_obj *obj = pdf_dict_gets(ctx, dict, "Resources");
+	pdf_obj *obj = pdf_dict_get(ctx, dict, PDF_NAME(Resources));
 	if (!strcmp(pdf_to_name(ctx, pdf_dict_getp(ctx, dict, "Group/S")), "Transparency"))
 		return 1;
 	return pdf_resources_use_blending(ctx, doc, obj);
@@ -292,19 +621,19 @@ pdf_resources_use_blending(fz_context *ctx, pdf_document *doc, pdf_obj *rdb)
 
 	fz_try(ctx)
 	{
-		obj = pdf_dict_gets(ctx, rdb, "ExtGState");
+		obj = pdf_dict_get(ctx, rdb, PDF_NAME(ExtGState));
 		n = pdf_dict_len(ctx, obj);
 		for (i = 0; i < n; i++)
 			if (pdf_extgstate_uses_blending(ctx, doc, pdf_dict_get_val(ctx, obj, i)))
 				goto found;
 
-		obj = pdf_dict_gets(ctx, rdb, "Pattern");
+		obj = pdf_dict_get(ctx, rdb, PDF_NAME(Pattern));
 		n = pdf_dict_len(ctx, obj);
 		for (i = 0; i < n; i++)
 			if (pdf_pattern_uses_blending(ctx, doc, pdf_dict_get_val(ctx, obj, i)))
 				goto found;
 
-		obj = pdf_dict_gets(ctx, rdb, "XObject");
+		obj = pdf_dict_get(ctx, rdb, PDF_NAME(XObject));
 		n = pdf_dict_len(ctx, obj);
 		for (i = 0; i < n; i++)
 			if (pdf_xobject_uses_blending(ctx, doc, pdf_dict_get_val(ctx, obj, i)))
@@ -335,18 +664,18 @@ pdf_load_transition(fz_context *ctx, pdf_document *doc, pdf_page *page, pdf_obj
 	pdf_obj *obj;
 	int type;
 
-	obj = pdf_dict_gets(ctx, transdict, "D");
+	obj = pdf_dict_get(ctx, transdict, PDF_NAME(D));
 	page->transition.duration = (obj ? pdf_to_real(ctx, obj) : 1);
 
-	page->transition.vertical = (pdf_to_name(ctx, pdf_dict_gets(ctx, transdict, "Dm"))[0] != 'H');
-	page->transition.outwards = (pdf_to_name(ctx, pdf_dict_gets(ctx, transdict, "M"))[0] != 'I');
+	page->transition.vertical = (pdf_to_name(ctx, pdf_dict_get(ctx, transdict, PDF_NAME(Dm)))[0] != 'H');
+	page->transition.outwards = (pdf_to_name(ctx, pdf_dict_get(ctx, transdict, PDF_NAME(M)))[0] != 'I');
 	/* FIXME: If 'Di' is None, it should be handled differently, but
 	 * this only affects Fly, and we don't implement that currently. */
-	page->transition.direction = (pdf_to_int(ctx, pdf_dict_gets(ctx, transdict, "Di")));
+	page->transition.direction = (pdf_to_int(ctx, pdf_dict_get(ctx, transdict, PDF_NAME(Di))));
 	/* FIXME: Read SS for Fly when we implement it */
 	/* FIXME: Read B for Fly when we implement it */
 
-	name = pdf_to_name(ctx, pdf_dict_gets(ctx, transdict, "S"));
+	name = pdf_to_name(ctx, pdf_dict_get(ctx, transdict, PDF_NAME(S)));
 	if (!strcmp(name, "Split"))
 		type = FZ_TRANSITION_SPLIT;
 	else if (!strcmp(name, "Blinds"))
@@ -464,7 +793,7 @@ pdf_load_page(fz_context *ctx, pdf_document *doc, int number)
 	page->me = pdf_keep_obj(ctx, pageobj);
 	page->incomplete = 0;
 
-	obj = pdf_dict_gets(ctx, pageobj, "UserUnit");
+	obj = pdf_dict_get(ctx, pageobj, PDF_NAME(UserUnit));
 	if (pdf_is_real(ctx, obj))
 		userunit = pdf_to_real(ctx, obj);
 	else
@@ -513,7 +842,7 @@ pdf_load_page(fz_context *ctx, pdf_document *doc, int number)
 
 	fz_try(ctx)
 	{
-		obj = pdf_dict_gets(ctx, pageobj, "Annots");
+		obj = pdf_dict_get(ctx, pageobj, PDF_NAME(Annots));
 		if (obj)
 		{
 			page->links = pdf_load_link_annots(ctx, doc, obj, &page->ctm);
@@ -529,9 +858,9 @@ pdf_load_page(fz_context *ctx, pdf_document *doc, int number)
 		page->links = NULL;
 	}
 
-	page->duration = pdf_to_real(ctx, pdf_dict_gets(ctx, pageobj, "Dur"));
+	page->duration = pdf_to_real(ctx, pdf_dict_get(ctx, pageobj, PDF_NAME(Dur)));
 
-	obj = pdf_dict_gets(ctx, pageobj, "Trans");
+	obj = pdf_dict_get(ctx, pageobj, PDF_NAME(Trans));
 	page->transition_present = (obj != NULL);
 	if (obj)
 	{
@@ -543,7 +872,7 @@ pdf_load_page(fz_context *ctx, pdf_document *doc, int number)
 	if (page->resources)
 		pdf_keep_obj(ctx, page->resources);
 
-	obj = pdf_dict_gets(ctx, pageobj, "Contents");
+	obj = pdf_dict_get(ctx, pageobj, PDF_NAME(Contents));
 	fz_try(ctx)
 	{
 		page->contents = pdf_keep_obj(ctx, obj);
@@ -577,17 +906,17 @@ pdf_delete_page(fz_context *ctx, pdf_document *doc, int at)
 	int i;
 
 	pdf_lookup_page_loc(ctx, doc, at, &parent, &i);
-	kids = pdf_dict_gets(ctx, parent, "Kids");
+	kids = pdf_dict_get(ctx, parent, PDF_NAME(Kids));
 	pdf_array_delete(ctx, kids, i);
 
 	while (parent)
 	{
-		int count = pdf_to_int(ctx, pdf_dict_gets(ctx, parent, "Count"));
-		pdf_dict_puts_drop(ctx, parent, "Count", pdf_new_int(ctx, doc, count - 1));
-		parent = pdf_dict_gets(ctx, parent, "Parent");
+		int count = pdf_to_int(ctx, pdf_dict_get(ctx, parent, PDF_NAME(Count)));
+		pdf_dict_put_drop(ctx, parent, PDF_NAME(Count), pdf_new_int(ctx, doc, count - 1));
+		parent = pdf_dict_get(ctx, parent, PDF_NAME(Parent));
 	}
 
-	doc->page_count = 0; /* invalidate cached value */
+	pdf_update_page_map(ctx, doc, at, NULL);
 }
 
 void
@@ -598,18 +927,20 @@ pdf_insert_page(fz_context *ctx, pdf_document *doc, pdf_page *page, int at)
 	pdf_obj *page_ref;
 	int i;
 
+	fz_var(at);
+
 	page_ref = pdf_new_ref(ctx, doc, page->me);
 
 	fz_try(ctx)
 	{
 		if (count == 0)
 		{
-			pdf_obj *root = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root");
-			parent = pdf_dict_gets(ctx, root, "Pages");
+			pdf_obj *root = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root));
+			parent = pdf_dict_get(ctx, root, PDF_NAME(Pages));
 			if (!parent)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "cannot find page tree");
 
-			kids = pdf_dict_gets(ctx, parent, "Kids");
+			kids = pdf_dict_get(ctx, parent, PDF_NAME(Kids));
 			if (!kids)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "malformed page tree");
 
@@ -625,27 +956,28 @@ pdf_insert_page(fz_context *ctx, pdf_document *doc, pdf_page *page, int at)
 
 			/* append after last page */
 			pdf_lookup_page_loc(ctx, doc, count - 1, &parent, &i);
-			kids = pdf_dict_gets(ctx, parent, "Kids");
+			kids = pdf_dict_get(ctx, parent, PDF_NAME(Kids));
 			pdf_array_insert(ctx, kids, page_ref, i + 1);
 		}
 		else
 		{
 			/* insert before found page */
 			pdf_lookup_page_loc(ctx, doc, at, &parent, &i);
-			kids = pdf_dict_gets(ctx, parent, "Kids");
+			kids = pdf_dict_get(ctx, parent, PDF_NAME(Kids));
 			pdf_array_insert(ctx, kids, page_ref, i);
 		}
 
-		pdf_dict_puts(ctx, page->me, "Parent", parent);
+		pdf_dict_put(ctx, page->me, PDF_NAME(Parent), parent);
 
 		/* Adjust page counts */
 		while (parent)
 		{
-			int count = pdf_to_int(ctx, pdf_dict_gets(ctx, parent, "Count"));
-			pdf_dict_puts_drop(ctx, parent, "Count", pdf_new_int(ctx, doc, count + 1));
-			parent = pdf_dict_gets(ctx, parent, "Parent");
+			int count = pdf_to_int(ctx, pdf_dict_get(ctx, parent, PDF_NAME(Count)));
+			pdf_dict_put_drop(ctx, parent, PDF_NAME(Count), pdf_new_int(ctx, doc, count + 1));
+			parent = pdf_dict_get(ctx, parent, PDF_NAME(Parent));
 		}
 
+		pdf_update_page_map(ctx, doc, count == 0 ? 0 : at, page_ref);
 	}
 	fz_always(ctx)
 	{
@@ -655,8 +987,6 @@ pdf_insert_page(fz_context *ctx, pdf_document *doc, pdf_page *page, int at)
 	{
 		fz_rethrow(ctx);
 	}
-
-	doc->page_count = 0; /* invalidate cached value */
 }
 
 void
@@ -686,13 +1016,13 @@ pdf_create_page(fz_context *ctx, pdf_document *doc, fz_rect mediabox, int res, i
 		page->annots = NULL;
 		page->me = pageobj = pdf_new_dict(ctx, doc, 4);
 
-		pdf_dict_puts_drop(ctx, pageobj, "Type", pdf_new_name(ctx, doc, "Page"));
+		pdf_dict_put_drop(ctx, pageobj, PDF_NAME(Type), pdf_new_name(ctx, doc, "Page"));
 
 		page->mediabox.x0 = fz_min(mediabox.x0, mediabox.x1) * userunit;
 		page->mediabox.y0 = fz_min(mediabox.y0, mediabox.y1) * userunit;
 		page->mediabox.x1 = fz_max(mediabox.x0, mediabox.x1) * userunit;
 		page->mediabox.y1 = fz_max(mediabox.y0, mediabox.y1) * userunit;
-		pdf_dict_puts_drop(ctx, pageobj, "MediaBox", pdf_new_rect(ctx, doc, &page->mediabox));
+		pdf_dict_put_drop(ctx, pageobj, PDF_NAME(MediaBox), pdf_new_rect(ctx, doc, &page->mediabox));
 
 		/* Snap page->rotate to 0, 90, 180 or 270 */
 		if (page->rotate < 0)
@@ -702,7 +1032,7 @@ pdf_create_page(fz_context *ctx, pdf_document *doc, fz_rect mediabox, int res, i
 		page->rotate = 90*((page->rotate + 45)/90);
 		if (page->rotate > 360)
 			page->rotate = 0;
-		pdf_dict_puts_drop(ctx, pageobj, "Rotate", pdf_new_int(ctx, doc, page->rotate));
+		pdf_dict_put_drop(ctx, pageobj, PDF_NAME(Rotate), pdf_new_int(ctx, doc, page->rotate));
 
 		fz_pre_rotate(fz_scale(&ctm, 1, -1), -page->rotate);
 		realbox = page->mediabox;
@@ -737,7 +737,7 @@ void pdf_sign_signature(fz_context *ctx, pdf_document *doc, pdf_widget *widget,
 
 		pdf_signature_set_value(ctx, doc, wobj, signer);
 
-		pdf_to_rect(ctx, pdf_dict_gets(ctx, wobj, "Rect"), &rect);
+		pdf_to_rect(ctx, pdf_dict_get(ctx, wobj, PDF_NAME(Rect)), &rect);
 		/* Create an appearance stream only if the signature is intended to be visible */
 		if (!fz_is_empty_rect(&rect))
 		{
@@ -9,13 +9,13 @@ struct muentry
 {
 	int num;
 	int gen;
-	int ofs;
-	int stm_ofs;
+	fz_off_t ofs;
+	fz_off_t stm_ofs;
 	int stm_len;
 };
 
 int
-pdf_repair_obj(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf, int *stmofsp, int *stmlenp, pdf_obj **encrypt, pdf_obj **id, pdf_obj **page, int *tmpofs)
+pdf_repair_obj(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf, fz_off_t *stmofsp, int *stmlenp, pdf_obj **encrypt, pdf_obj **id, pdf_obj **page, fz_off_t *tmpofs)
 {
 	fz_stream *file = doc->file;
 	pdf_token tok;
@@ -54,17 +54,17 @@ pdf_repair_obj(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf, int *stmofsp
 
 		if (encrypt && id)
 		{
-			obj = pdf_dict_gets(ctx, dict, "Type");
+			obj = pdf_dict_get(ctx, dict, PDF_NAME(Type));
 			if (pdf_is_name(ctx, obj) && !strcmp(pdf_to_name(ctx, obj), "XRef"))
 			{
-				obj = pdf_dict_gets(ctx, dict, "Encrypt");
+				obj = pdf_dict_get(ctx, dict, PDF_NAME(Encrypt));
 				if (obj)
 				{
 					pdf_drop_obj(ctx, *encrypt);
 					*encrypt = pdf_keep_obj(ctx, obj);
 				}
 
-				obj = pdf_dict_gets(ctx, dict, "ID");
+				obj = pdf_dict_get(ctx, dict, PDF_NAME(ID));
 				if (obj)
 				{
 					pdf_drop_obj(ctx, *id);
@@ -73,13 +73,13 @@ pdf_repair_obj(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf, int *stmofsp
 			}
 		}
 
-		obj = pdf_dict_gets(ctx, dict, "Length");
+		obj = pdf_dict_get(ctx, dict, PDF_NAME(Length));
 		if (!pdf_is_indirect(ctx, obj) && pdf_is_int(ctx, obj))
 			stm_len = pdf_to_int(ctx, obj);
 
 		if (doc->file_reading_linearly && page)
 		{
-			obj = pdf_dict_gets(ctx, dict, "Type");
+			obj = pdf_dict_get(ctx, dict, PDF_NAME(Type));
 			if (!strcmp(pdf_to_name(ctx, obj), "Page"))
 			{
 				pdf_drop_obj(ctx, *page);
@@ -144,7 +144,7 @@ pdf_repair_obj(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf, int *stmofsp
 		}
 
 		if (stmlenp)
-			*stmlenp = fz_tell(ctx, file) - *stmofsp - 9;
+			*stmlenp = (int)(fz_tell(ctx, file) - *stmofsp - 9);
 
 atobjend:
 		*tmpofs = fz_tell(ctx, file);
@@ -182,7 +182,7 @@ pdf_repair_obj_stm(fz_context *ctx, pdf_document *doc, int num, int gen)
 	{
 		obj = pdf_load_object(ctx, doc, num, gen);
 
-		count = pdf_to_int(ctx, pdf_dict_gets(ctx, obj, "N"));
+		count = pdf_to_int(ctx, pdf_dict_get(ctx, obj, PDF_NAME(N)));
 
 		pdf_drop_obj(ctx, obj);
 
@@ -250,8 +250,9 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 
 	int num = 0;
 	int gen = 0;
-	int tmpofs, numofs = 0, genofs = 0;
-	int stm_len, stm_ofs;
+	fz_off_t tmpofs, numofs = 0, genofs = 0;
+	int stm_len;
+	fz_off_t stm_ofs;
 	pdf_token tok;
 	int next;
 	int i, n, c;
@@ -268,6 +269,9 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "Repair failed already - not trying again");
 	doc->repair_attempted = 1;
 
+	/* The page tree may look different once repaired */
+	doc->page_count = 0;
+
 	doc->dirty = 1;
 	/* Can't support incremental update after repair */
 	doc->freeze_updates = 1;
@@ -403,28 +407,28 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 					continue;
 				}
 
-				obj = pdf_dict_gets(ctx, dict, "Encrypt");
+				obj = pdf_dict_get(ctx, dict, PDF_NAME(Encrypt));
 				if (obj)
 				{
 					pdf_drop_obj(ctx, encrypt);
 					encrypt = pdf_keep_obj(ctx, obj);
 				}
 
-				obj = pdf_dict_gets(ctx, dict, "ID");
-				if (obj && (!id || !encrypt || pdf_dict_gets(ctx, dict, "Encrypt")))
+				obj = pdf_dict_get(ctx, dict, PDF_NAME(ID));
+				if (obj && (!id || !encrypt || pdf_dict_get(ctx, dict, PDF_NAME(Encrypt))))
 				{
 					pdf_drop_obj(ctx, id);
 					id = pdf_keep_obj(ctx, obj);
 				}
 
-				obj = pdf_dict_gets(ctx, dict, "Root");
+				obj = pdf_dict_get(ctx, dict, PDF_NAME(Root));
 				if (obj)
 				{
 					pdf_drop_obj(ctx, root);
 					root = pdf_keep_obj(ctx, obj);
 				}
 
-				obj = pdf_dict_gets(ctx, dict, "Info");
+				obj = pdf_dict_get(ctx, dict, PDF_NAME(Info));
 				if (obj)
 				{
 					pdf_drop_obj(ctx, info);
@@ -472,7 +476,7 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 				dict = pdf_load_object(ctx, doc, list[i].num, list[i].gen);
 
 				length = pdf_new_int(ctx, doc, list[i].stm_len);
-				pdf_dict_puts(ctx, dict, "Length", length);
+				pdf_dict_put(ctx, dict, PDF_NAME(Length), length);
 				pdf_drop_obj(ctx, length);
 
 				pdf_drop_obj(ctx, dict);
@@ -507,19 +511,19 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 		obj = NULL;
 
 		obj = pdf_new_int(ctx, doc, maxnum + 1);
-		pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "Size", obj);
+		pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(Size), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
 		if (root)
 		{
-			pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "Root", root);
+			pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root), root);
 			pdf_drop_obj(ctx, root);
 			root = NULL;
 		}
 		if (info)
 		{
-			pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "Info", info);
+			pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(Info), info);
 			pdf_drop_obj(ctx, info);
 			info = NULL;
 		}
@@ -534,7 +538,7 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 				encrypt = obj;
 				obj = NULL;
 			}
-			pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "Encrypt", encrypt);
+			pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(Encrypt), encrypt);
 			pdf_drop_obj(ctx, encrypt);
 			encrypt = NULL;
 		}
@@ -549,7 +553,7 @@ pdf_repair_xref(fz_context *ctx, pdf_document *doc)
 				id = obj;
 				obj = NULL;
 			}
-			pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "ID", id);
+			pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(ID), id);
 			pdf_drop_obj(ctx, id);
 			id = NULL;
 		}
@@ -584,7 +588,7 @@ pdf_repair_obj_stms(fz_context *ctx, pdf_document *doc)
 			dict = pdf_load_object(ctx, doc, i, 0);
 			fz_try(ctx)
 			{
-				if (!strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "Type")), "ObjStm"))
+				if (!strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Type))), "ObjStm"))
 					pdf_repair_obj_stm(ctx, doc, i, 0);
 			}
 			fz_catch(ctx)
@@ -601,6 +605,6 @@ pdf_repair_obj_stms(fz_context *ctx, pdf_document *doc)
 		pdf_xref_entry *entry = pdf_get_populating_xref_entry(ctx, doc, i);
 
 		if (entry->type == 'o' && pdf_get_populating_xref_entry(ctx, doc, entry->ofs)->type != 'n')
-			fz_throw(ctx, FZ_ERROR_GENERIC, "invalid reference to non-object-stream: %d (%d 0 R)", entry->ofs, i);
+			fz_throw(ctx, FZ_ERROR_GENERIC, "invalid reference to non-object-stream: %" FZ_FMT_OFF " (%d 0 R)", entry->ofs, i);
 	}
 }
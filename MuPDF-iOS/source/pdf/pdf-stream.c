@@ -26,7 +26,7 @@ pdf_stream_has_crypt(fz_context *ctx, pdf_obj *stm)
 	pdf_obj *obj;
 	int i;
 
-	filters = pdf_dict_getsa(ctx, stm, "Filter", "F");
+	filters = pdf_dict_geta(ctx, stm, PDF_NAME(Filter), PDF_NAME(F));
 	if (filters)
 	{
 		if (!strcmp(pdf_to_name(ctx, filters), "Crypt"))
@@ -84,11 +84,11 @@ build_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *f, p
 {
 	char *s = pdf_to_name(ctx, f);
 
-	int predictor = pdf_to_int(ctx, pdf_dict_gets(ctx, p, "Predictor"));
-	pdf_obj *columns_obj = pdf_dict_gets(ctx, p, "Columns");
+	int predictor = pdf_to_int(ctx, pdf_dict_get(ctx, p, PDF_NAME(Predictor)));
+	pdf_obj *columns_obj = pdf_dict_get(ctx, p, PDF_NAME(Columns));
 	int columns = pdf_to_int(ctx, columns_obj);
-	int colors = pdf_to_int(ctx, pdf_dict_gets(ctx, p, "Colors"));
-	int bpc = pdf_to_int(ctx, pdf_dict_gets(ctx, p, "BitsPerComponent"));
+	int colors = pdf_to_int(ctx, pdf_dict_get(ctx, p, PDF_NAME(Colors)));
+	int bpc = pdf_to_int(ctx, pdf_dict_get(ctx, p, PDF_NAME(BitsPerComponent)));
 
 	if (params)
 		params->type = FZ_IMAGE_RAW;
@@ -101,12 +101,12 @@ build_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *f, p
 
 	else if (!strcmp(s, "CCITTFaxDecode") || !strcmp(s, "CCF"))
 	{
-		pdf_obj *k = pdf_dict_gets(ctx, p, "K");
-		pdf_obj *eol = pdf_dict_gets(ctx, p, "EndOfLine");
-		pdf_obj *eba = pdf_dict_gets(ctx, p, "EncodedByteAlign");
-		pdf_obj *rows = pdf_dict_gets(ctx, p, "Rows");
-		pdf_obj *eob = pdf_dict_gets(ctx, p, "EndOfBlock");
-		pdf_obj *bi1 = pdf_dict_gets(ctx, p, "BlackIs1");
+		pdf_obj *k = pdf_dict_get(ctx, p, PDF_NAME(K));
+		pdf_obj *eol = pdf_dict_get(ctx, p, PDF_NAME(EndOfLine));
+		pdf_obj *eba = pdf_dict_get(ctx, p, PDF_NAME(EncodedByteAlign));
+		pdf_obj *rows = pdf_dict_get(ctx, p, PDF_NAME(Rows));
+		pdf_obj *eob = pdf_dict_get(ctx, p, PDF_NAME(EndOfBlock));
+		pdf_obj *bi1 = pdf_dict_get(ctx, p, PDF_NAME(BlackIs1));
 		if (params)
 		{
 			/* We will shortstop here */
@@ -132,7 +132,7 @@ build_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *f, p
 
 	else if (!strcmp(s, "DCTDecode") || !strcmp(s, "DCT"))
 	{
-		pdf_obj *ct = pdf_dict_gets(ctx, p, "ColorTransform");
+		pdf_obj *ct = pdf_dict_get(ctx, p, PDF_NAME(ColorTransform));
 		if (params)
 		{
 			/* We will shortstop here */
@@ -173,7 +173,7 @@ build_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *f, p
 
 	else if (!strcmp(s, "LZWDecode") || !strcmp(s, "LZW"))
 	{
-		pdf_obj *ec = pdf_dict_gets(ctx, p, "EarlyChange");
+		pdf_obj *ec = pdf_dict_get(ctx, p, PDF_NAME(EarlyChange));
 		if (params)
 		{
 			/* We will shortstop here */
@@ -194,7 +194,7 @@ build_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *f, p
 	else if (!strcmp(s, "JBIG2Decode"))
 	{
 		fz_jbig2_globals *globals = NULL;
-		pdf_obj *obj = pdf_dict_gets(ctx, p, "JBIG2Globals");
+		pdf_obj *obj = pdf_dict_get(ctx, p, PDF_NAME(JBIG2Globals));
 		if (pdf_is_indirect(ctx, obj))
 			globals = pdf_load_jbig2_globals(ctx, doc, obj);
 		/* fz_open_jbig2d takes possession of globals */
@@ -214,7 +214,7 @@ build_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *f, p
 			return chain;
 		}
 
-		name = pdf_dict_gets(ctx, p, "Name");
+		name = pdf_dict_get(ctx, p, PDF_NAME(Name));
 		if (pdf_is_name(ctx, name))
 			return pdf_open_crypt_with_filter(ctx, chain, doc->crypt, pdf_to_name(ctx, name), num, gen);
 
@@ -269,10 +269,10 @@ build_filter_chain(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj
  * orig_num and orig_gen are used purely to seed the encryption.
  */
 static fz_stream *
-pdf_open_raw_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *stmobj, int num, int orig_num, int orig_gen, int offset)
+pdf_open_raw_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_obj *stmobj, int num, int orig_num, int orig_gen, fz_off_t offset)
 {
 	int hascrypt;
-	int len;
+	fz_off_t len;
 
 	if (num > 0 && num < pdf_xref_len(ctx, doc))
 	{
@@ -284,7 +284,7 @@ pdf_open_raw_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_ob
 	/* don't close chain when we close this filter */
 	fz_keep_stream(ctx, chain);
 
-	len = pdf_to_int(ctx, pdf_dict_gets(ctx, stmobj, "Length"));
+	len = pdf_to_offset(ctx, pdf_dict_get(ctx, stmobj, PDF_NAME(Length)));
 	chain = fz_open_null(ctx, chain, len, offset);
 
 	hascrypt = pdf_stream_has_crypt(ctx, stmobj);
@@ -299,13 +299,13 @@ pdf_open_raw_filter(fz_context *ctx, fz_stream *chain, pdf_document *doc, pdf_ob
  * to stream length and decrypting.
  */
 static fz_stream *
-pdf_open_filter(fz_context *ctx, pdf_document *doc, fz_stream *chain, pdf_obj *stmobj, int num, int gen, int offset, fz_compression_params *imparams)
+pdf_open_filter(fz_context *ctx, pdf_document *doc, fz_stream *chain, pdf_obj *stmobj, int num, int gen, fz_off_t offset, fz_compression_params *imparams)
 {
 	pdf_obj *filters;
 	pdf_obj *params;
 
-	filters = pdf_dict_getsa(ctx, stmobj, "Filter", "F");
-	params = pdf_dict_getsa(ctx, stmobj, "DecodeParms", "DP");
+	filters = pdf_dict_geta(ctx, stmobj, PDF_NAME(Filter), PDF_NAME(F));
+	params = pdf_dict_geta(ctx, stmobj, PDF_NAME(DecodeParms), PDF_NAME(DP));
 
 	chain = pdf_open_raw_filter(ctx, chain, doc, stmobj, num, num, gen, offset);
 
@@ -345,8 +345,8 @@ pdf_open_inline_stream(fz_context *ctx, pdf_document *doc, pdf_obj *stmobj, int
 	pdf_obj *filters;
 	pdf_obj *params;
 
-	filters = pdf_dict_getsa(ctx, stmobj, "Filter", "F");
-	params = pdf_dict_getsa(ctx, stmobj, "DecodeParms", "DP");
+	filters = pdf_dict_geta(ctx, stmobj, PDF_NAME(Filter), PDF_NAME(F));
+	params = pdf_dict_geta(ctx, stmobj, PDF_NAME(DecodeParms), PDF_NAME(DP));
 
 	/* don't close chain when we close this filter */
 	fz_keep_stream(ctx, chain);
@@ -436,7 +436,7 @@ pdf_open_stream(fz_context *ctx, pdf_document *doc, int num, int gen)
 }
 
 fz_stream *
-pdf_open_stream_with_offset(fz_context *ctx, pdf_document *doc, int num, int gen, pdf_obj *dict, int stm_ofs)
+pdf_open_stream_with_offset(fz_context *ctx, pdf_document *doc, int num, int gen, pdf_obj *dict, fz_off_t stm_ofs)
 {
 	if (stm_ofs == 0)
 		fz_throw(ctx, FZ_ERROR_GENERIC, "object is not a stream");
@@ -470,7 +470,7 @@ pdf_load_raw_renumbered_stream(fz_context *ctx, pdf_document *doc, int num, int
 
 	dict = pdf_load_object(ctx, doc, num, gen);
 
-	len = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "Length"));
+	len = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Length)));
 
 	pdf_drop_obj(ctx, dict);
 
@@ -517,8 +517,8 @@ pdf_load_image_stream(fz_context *ctx, pdf_document *doc, int num, int gen, int
 
 	dict = pdf_load_object(ctx, doc, num, gen);
 
-	len = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "Length"));
-	obj = pdf_dict_gets(ctx, dict, "Filter");
+	len = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(Length)));
+	obj = pdf_dict_get(ctx, dict, PDF_NAME(Filter));
 	len = pdf_guess_filter_length(len, pdf_to_name(ctx, obj));
 	n = pdf_array_len(ctx, obj);
 	for (i = 0; i < n; i++)
@@ -29,8 +29,8 @@ typedef struct {
 	int num_shared;
 	int page_object_number;
 	int num_objects;
-	int min_ofs;
-	int max_ofs;
+	fz_off_t min_ofs;
+	fz_off_t max_ofs;
 	/* Extensible list of objects used on this page */
 	int cap;
 	int len;
@@ -53,7 +53,7 @@ struct pdf_write_options_s
 	int do_linear;
 	int do_clean;
 	int *use_list;
-	int *ofs_list;
+	fz_off_t *ofs_list;
 	int *gen_list;
 	int *renumber_map;
 	int continue_on_error;
@@ -62,10 +62,10 @@ struct pdf_write_options_s
 	int *rev_renumber_map;
 	int *rev_gen_list;
 	int start;
-	int first_xref_offset;
-	int main_xref_offset;
-	int first_xref_entry_offset;
-	int file_len;
+	fz_off_t first_xref_offset;
+	fz_off_t main_xref_offset;
+	fz_off_t first_xref_entry_offset;
+	fz_off_t file_len;
 	int hints_shared_offset;
 	int hintstream_len;
 	pdf_obj *linear_l;
@@ -482,7 +482,7 @@ page_objects_dump(pdf_write_options *opts)
 			int o = p->object[j];
 			fprintf(stderr, "\tObject %d: use=%x\n", o, opts->use_list[o]);
 		}
-		fprintf(stderr, "Byte range=%d->%d\n", p->min_ofs, p->max_ofs);
+		fprintf(stderr, "Byte range=%" FZ_FMT_OFF "->%" FZ_FMT_OFF "\n", p->min_ofs, p->max_ofs);
 		fprintf(stderr, "Number of objects=%d, Number of shared objects=%d\n", p->num_objects, p->num_shared);
 		fprintf(stderr, "Page object number=%d\n", p->page_object_number);
 	}
@@ -495,7 +495,7 @@ objects_dump(fz_context *ctx, pdf_document *doc, pdf_write_options *opts)
 
 	for (i=0; i < pdf_xref_len(ctx, doc); i++)
 	{
-		fprintf(stderr, "Object %d use=%x offset=%d\n", i, opts->use_list[i], opts->ofs_list[i]);
+		fprintf(stderr, "Object %d use=%x offset=%" FZ_FMT_OFF "\n", i, opts->use_list[i], opts->ofs_list[i]);
 	}
 }
 #endif
@@ -530,12 +530,12 @@ static pdf_obj *markref(fz_context *ctx, pdf_document *doc, pdf_write_options *o
 	{
 		if (pdf_is_stream(ctx, doc, num, gen))
 		{
-			pdf_obj *len = pdf_dict_gets(ctx, obj, "Length");
+			pdf_obj *len = pdf_dict_get(ctx, obj, PDF_NAME(Length));
 			if (pdf_is_indirect(ctx, len))
 			{
 				opts->use_list[pdf_to_num(ctx, len)] = 0;
 				len = pdf_resolve_indirect(ctx, len);
-				pdf_dict_puts(ctx, obj, "Length", len);
+				pdf_dict_put(ctx, obj, PDF_NAME(Length), len);
 			}
 		}
 	}
@@ -589,101 +589,255 @@ static int markobj(fz_context *ctx, pdf_document *doc, pdf_write_options *opts,
 }
 
 /*
- * Scan for and remove duplicate objects (slow)
+ * Scan for and remove duplicate objects.
+ *
+ * Each live object gets a structural hash (and, at garbage level 4, a
+ * digest of its raw stream data). Objects are only compared against the
+ * earlier objects that landed in the same hash bucket.
  */
 
+typedef struct
+{
+	int num;
+	int next;
+	unsigned int hash;
+	int is_stream;
+	unsigned char digest[16];
+} dedup_entry;
+
+static unsigned int hash_mix(unsigned int h, unsigned int v)
+{
+	h ^= v;
+	h *= 16777619;
+	return h;
+}
+
+static unsigned int hash_bytes(unsigned int h, const unsigned char *s, int n)
+{
+	while (n-- > 0)
+		h = hash_mix(h, *s++);
+	return h;
+}
+
+/* Must agree with pdf_objcmp: objects it considers equal hash equal. */
+static unsigned int hashobj(fz_context *ctx, unsigned int h, pdf_obj *obj)
+{
+	int i, n;
+
+	if (!obj)
+		return hash_mix(h, 0);
+
+	/* Check for references first, as the pdf_is_* calls resolve them. */
+	if (pdf_is_indirect(ctx, obj))
+	{
+		h = hash_mix(h, 'R');
+		h = hash_mix(h, pdf_to_num(ctx, obj));
+		return hash_mix(h, pdf_to_gen(ctx, obj));
+	}
+	if (pdf_is_null(ctx, obj))
+		return hash_mix(h, 'N');
+	if (pdf_is_bool(ctx, obj))
+		return hash_mix(hash_mix(h, 'B'), pdf_to_bool(ctx, obj));
+	if (pdf_is_int(ctx, obj))
+		return hash_mix(hash_mix(h, 'I'), pdf_to_int(ctx, obj));
+	if (pdf_is_real(ctx, obj))
+	{
+		float f = pdf_to_real(ctx, obj);
+		union { float f; unsigned int u; } bits;
+		/* 0 and -0 compare equal */
+		bits.f = (f == 0) ? 0 : f;
+		return hash_mix(hash_mix(h, 'F'), bits.u);
+	}
+	if (pdf_is_name(ctx, obj))
+	{
+		char *s = pdf_to_name(ctx, obj);
+		return hash_bytes(hash_mix(h, '/'), (unsigned char *)s, strlen(s));
+	}
+	if (pdf_is_string(ctx, obj))
+	{
+		n = pdf_to_str_len(ctx, obj);
+		return hash_bytes(hash_mix(h, '('), (unsigned char *)pdf_to_str_buf(ctx, obj), n);
+	}
+	if (pdf_is_array(ctx, obj))
+	{
+		n = pdf_array_len(ctx, obj);
+		h = hash_mix(hash_mix(h, '['), n);
+		for (i = 0; i < n; i++)
+			h = hashobj(ctx, h, pdf_array_get(ctx, obj, i));
+		return h;
+	}
+	if (pdf_is_dict(ctx, obj))
+	{
+		n = pdf_dict_len(ctx, obj);
+		h = hash_mix(hash_mix(h, '<'), n);
+		for (i = 0; i < n; i++)
+		{
+			h = hashobj(ctx, h, pdf_dict_get_key(ctx, obj, i));
+			h = hashobj(ctx, h, pdf_dict_get_val(ctx, obj, i));
+		}
+		return h;
+	}
+	return hash_mix(h, '?');
+}
+
+static int hashentry(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, dedup_entry *entry)
+{
+	int num = entry->num;
+	pdf_obj *obj;
+	fz_buffer *buf = NULL;
+
+	fz_var(buf);
+
+	fz_try(ctx)
+	{
+		/* pdf_is_stream ensures that the object is loaded. */
+		entry->is_stream = pdf_is_stream(ctx, doc, num, 0);
+		if (entry->is_stream && opts->do_garbage < 4)
+			break;
+		obj = pdf_resolve_indirect(ctx, pdf_get_xref_entry(ctx, doc, num)->obj);
+		entry->hash = hashobj(ctx, 2166136261U, obj);
+		if (entry->is_stream)
+		{
+			unsigned char *data;
+			int len;
+			fz_md5 md5;
+			buf = pdf_load_raw_renumbered_stream(ctx, doc, num, 0, num, 0);
+			len = fz_buffer_storage(ctx, buf, &data);
+			fz_md5_init(&md5);
+			fz_md5_update(&md5, data, len);
+			fz_md5_final(&md5, entry->digest);
+			entry->hash = hash_bytes(entry->hash, entry->digest, 4);
+		}
+	}
+	fz_always(ctx)
+	{
+		fz_drop_buffer(ctx, buf);
+	}
+	fz_catch(ctx)
+	{
+		/* Assume different from everything */
+		return 0;
+	}
+
+	return !entry->is_stream || opts->do_garbage >= 4;
+}
+
+static int samestream(fz_context *ctx, pdf_document *doc, int num, int other)
+{
+	fz_buffer *sa = NULL;
+	fz_buffer *sb = NULL;
+	int same = 0;
+
+	fz_var(sa);
+	fz_var(sb);
+	fz_var(same);
+
+	fz_try(ctx)
+	{
+		unsigned char *dataa, *datab;
+		int lena, lenb;
+		sa = pdf_load_raw_renumbered_stream(ctx, doc, num, 0, num, 0);
+		sb = pdf_load_raw_renumbered_stream(ctx, doc, other, 0, other, 0);
+		lena = fz_buffer_storage(ctx, sa, &dataa);
+		lenb = fz_buffer_storage(ctx, sb, &datab);
+		if (lena == lenb && memcmp(dataa, datab, lena) == 0)
+			same = 1;
+	}
+	fz_always(ctx)
+	{
+		fz_drop_buffer(ctx, sa);
+		fz_drop_buffer(ctx, sb);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
+
+	return same;
+}
+
 static void removeduplicateobjs(fz_context *ctx, pdf_document *doc, pdf_write_options *opts)
 {
-	int num, other;
+	int num, i, k, newnum;
 	int xref_len = pdf_xref_len(ctx, doc);
+	dedup_entry *entries = NULL;
+	int *buckets = NULL;
+	unsigned int mask;
 
-	for (num = 1; num < xref_len; num++)
+	fz_var(entries);
+	fz_var(buckets);
+
+	for (mask = 1; mask < (unsigned int)xref_len; mask <<= 1)
+		;
+	mask--;
+
+	fz_try(ctx)
 	{
-		/* Only compare an object to objects preceding it */
-		for (other = 1; other < num; other++)
+		entries = fz_malloc_array(ctx, xref_len, sizeof(*entries));
+		buckets = fz_malloc_array(ctx, mask + 1, sizeof(*buckets));
+		for (i = 0; i <= (int)mask; i++)
+			buckets[i] = -1;
+
+		for (num = 1; num < xref_len; num++)
 		{
+			dedup_entry *entry = &entries[num];
 			pdf_obj *a, *b;
-			int differ, newnum, streama, streamb;
+			int *bucket;
 
-			if (num == other || !opts->use_list[num] || !opts->use_list[other])
+			if (!opts->use_list[num])
 				continue;
 
-			/*
-			 * Comparing stream objects data contents would take too long.
-			 *
-			 * pdf_is_stream calls pdf_cache_object and ensures
-			 * that the xref table has the objects loaded.
-			 */
-			fz_try(ctx)
-			{
-				streama = pdf_is_stream(ctx, doc, num, 0);
-				streamb = pdf_is_stream(ctx, doc, other, 0);
-				differ = streama || streamb;
-				if (streama && streamb && opts->do_garbage >= 4)
-					differ = 0;
-			}
-			fz_catch(ctx)
-			{
-				/* Assume different */
-				differ = 1;
-			}
-			if (differ)
+			entry->num = num;
+			if (!hashentry(ctx, doc, opts, entry))
 				continue;
 
-			a = pdf_get_xref_entry(ctx, doc, num)->obj;
-			b = pdf_get_xref_entry(ctx, doc, other)->obj;
+			/* Only compare an object to objects preceding it */
+			bucket = &buckets[entry->hash & mask];
+			for (k = *bucket; k >= 0; k = entries[k].next)
+			{
+				dedup_entry *cand = &entries[k];
 
-			a = pdf_resolve_indirect(ctx, a);
-			b = pdf_resolve_indirect(ctx, b);
+				if (cand->hash != entry->hash || cand->is_stream != entry->is_stream)
+					continue;
+				if (entry->is_stream && memcmp(cand->digest, entry->digest, 16))
+					continue;
 
-			if (pdf_objcmp(ctx, a, b))
-				continue;
+				a = pdf_resolve_indirect(ctx, pdf_get_xref_entry(ctx, doc, num)->obj);
+				b = pdf_resolve_indirect(ctx, pdf_get_xref_entry(ctx, doc, k)->obj);
+				if (pdf_objcmp(ctx, a, b))
+					continue;
 
-			if (streama && streamb)
-			{
-				/* Check to see if streams match too. */
-				fz_buffer *sa = NULL;
-				fz_buffer *sb = NULL;
+				if (entry->is_stream && !samestream(ctx, doc, num, k))
+					continue;
 
-				fz_var(sa);
-				fz_var(sb);
+				break;
+			}
 
-				differ = 1;
-				fz_try(ctx)
-				{
-					unsigned char *dataa, *datab;
-					int lena, lenb;
-					sa = pdf_load_raw_renumbered_stream(ctx, doc, num, 0, num, 0);
-					sb = pdf_load_raw_renumbered_stream(ctx, doc, other, 0, other, 0);
-					lena = fz_buffer_storage(ctx, sa, &dataa);
-					lenb = fz_buffer_storage(ctx, sb, &datab);
-					if (lena == lenb && memcmp(dataa, datab, lena) == 0)
-						differ = 0;
-				}
-				fz_always(ctx)
-				{
-					fz_drop_buffer(ctx, sa);
-					fz_drop_buffer(ctx, sb);
-				}
-				fz_catch(ctx)
-				{
-					fz_rethrow(ctx);
-				}
-				if (differ)
-					continue;
+			if (k < 0)
+			{
+				/* No duplicate found: a candidate for later objects */
+				entry->next = *bucket;
+				*bucket = num;
+				continue;
 			}
 
 			/* Keep the lowest numbered object */
-			newnum = fz_mini(num, other);
+			newnum = k;
 			opts->renumber_map[num] = newnum;
-			opts->renumber_map[other] = newnum;
+			opts->renumber_map[k] = newnum;
 			opts->rev_renumber_map[newnum] = num; /* Either will do */
-			opts->use_list[fz_maxi(num, other)] = 0;
-
-			/* One duplicate was found, do not look for another */
-			break;
+			opts->use_list[num] = 0;
 		}
 	}
+	fz_always(ctx)
+	{
+		fz_free(ctx, entries);
+		fz_free(ctx, buckets);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
 }
 
 /*
@@ -857,6 +1011,9 @@ static void renumberobjs(fz_context *ctx, pdf_document *doc, pdf_write_options *
 
 		pdf_replace_xref(ctx, doc, newxref, newlen + 1);
 		newxref = NULL;
+
+		/* The cached page map holds references by their old numbers */
+		pdf_drop_page_map(ctx, doc);
 	}
 	fz_catch(ctx)
 	{
@@ -949,7 +1106,7 @@ mark_pages(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, pdf_obj
 	{
 		if (pdf_is_dict(ctx, val))
 		{
-			if (!strcmp("Page", pdf_to_name(ctx, pdf_dict_gets(ctx, val, "Type"))))
+			if (!strcmp("Page", pdf_to_name(ctx, pdf_dict_get(ctx, val, PDF_NAME(Type)))))
 			{
 				int num = pdf_to_num(ctx, val);
 				pdf_unmark_obj(ctx, val);
@@ -1038,7 +1195,7 @@ mark_root(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, pdf_obj *
 				int section;
 				/* Look at PageMode to decide whether to
 				 * USE_OTHER_OBJECTS or USE_PAGE1 here. */
-				if (strcmp(pdf_to_name(ctx, pdf_dict_gets(ctx, dict, "PageMode")), "UseOutlines") == 0)
+				if (strcmp(pdf_to_name(ctx, pdf_dict_get(ctx, dict, PDF_NAME(PageMode))), "UseOutlines") == 0)
 					section = USE_PAGE1;
 				else
 					section = USE_OTHER_OBJECTS;
@@ -1117,24 +1274,24 @@ add_linearization_objs(fz_context *ctx, pdf_document *doc, pdf_write_options *op
 		opts->rev_renumber_map[params_num] = params_num;
 		opts->gen_list[params_num] = 0;
 		opts->rev_gen_list[params_num] = 0;
-		pdf_dict_puts_drop(ctx, params_obj, "Linearized", pdf_new_real(ctx, doc, 1.0));
+		pdf_dict_put_drop(ctx, params_obj, PDF_NAME(Linearized), pdf_new_real(ctx, doc, 1.0));
 		opts->linear_l = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, params_obj, "L", opts->linear_l);
+		pdf_dict_put(ctx, params_obj, PDF_NAME(L), opts->linear_l);
 		opts->linear_h0 = pdf_new_int(ctx, doc, INT_MIN);
 		o = pdf_new_array(ctx, doc, 2);
 		pdf_array_push(ctx, o, opts->linear_h0);
 		opts->linear_h1 = pdf_new_int(ctx, doc, INT_MIN);
 		pdf_array_push(ctx, o, opts->linear_h1);
-		pdf_dict_puts_drop(ctx, params_obj, "H", o);
+		pdf_dict_put_drop(ctx, params_obj, PDF_NAME(H), o);
 		o = NULL;
 		opts->linear_o = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, params_obj, "O", opts->linear_o);
+		pdf_dict_put(ctx, params_obj, PDF_NAME(O), opts->linear_o);
 		opts->linear_e = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, params_obj, "E", opts->linear_e);
+		pdf_dict_put(ctx, params_obj, PDF_NAME(E), opts->linear_e);
 		opts->linear_n = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, params_obj, "N", opts->linear_n);
+		pdf_dict_put(ctx, params_obj, PDF_NAME(N), opts->linear_n);
 		opts->linear_t = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, params_obj, "T", opts->linear_t);
+		pdf_dict_put(ctx, params_obj, PDF_NAME(T), opts->linear_t);
 
 		/* Primary hint stream */
 		hint_obj = pdf_new_dict(ctx, doc, 10);
@@ -1146,9 +1303,9 @@ add_linearization_objs(fz_context *ctx, pdf_document *doc, pdf_write_options *op
 		opts->rev_renumber_map[hint_num] = hint_num;
 		opts->gen_list[hint_num] = 0;
 		opts->rev_gen_list[hint_num] = 0;
-		pdf_dict_puts_drop(ctx, hint_obj, "P", pdf_new_int(ctx, doc, 0));
+		pdf_dict_put_drop(ctx, hint_obj, PDF_NAME(P), pdf_new_int(ctx, doc, 0));
 		opts->hints_s = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, hint_obj, "S", opts->hints_s);
+		pdf_dict_put(ctx, hint_obj, PDF_NAME(S), opts->hints_s);
 		/* FIXME: Do we have thumbnails? Do a T entry */
 		/* FIXME: Do we have outlines? Do an O entry */
 		/* FIXME: Do we have article threads? Do an A entry */
@@ -1157,9 +1314,9 @@ add_linearization_objs(fz_context *ctx, pdf_document *doc, pdf_write_options *op
 		/* FIXME: Do we have document information? Do an I entry */
 		/* FIXME: Do we have logical structure heirarchy? Do a C entry */
 		/* FIXME: Do L, Page Label hint table */
-		pdf_dict_puts_drop(ctx, hint_obj, "Filter", pdf_new_name(ctx, doc, "FlateDecode"));
+		pdf_dict_put_drop(ctx, hint_obj, PDF_NAME(Filter), pdf_new_name(ctx, doc, "FlateDecode"));
 		opts->hints_length = pdf_new_int(ctx, doc, INT_MIN);
-		pdf_dict_puts(ctx, hint_obj, "Length", opts->hints_length);
+		pdf_dict_put(ctx, hint_obj, PDF_NAME(Length), opts->hints_length);
 		pdf_get_xref_entry(ctx, doc, hint_num)->stm_ofs = -1;
 	}
 	fz_always(ctx)
@@ -1227,12 +1384,12 @@ lpr_inherit_res(fz_context *ctx, pdf_obj *node, int depth, pdf_obj *dict)
 	{
 		pdf_obj *o;
 
-		node = pdf_dict_gets(ctx, node, "Parent");
+		node = pdf_dict_get(ctx, node, PDF_NAME(Parent));
 		depth--;
 		if (!node || depth < 0)
 			break;
 
-		o = pdf_dict_gets(ctx, node, "Resources");
+		o = pdf_dict_get(ctx, node, PDF_NAME(Resources));
 		if (o)
 		{
 			lpr_inherit_res_contents(ctx, dict, o, "ExtGState");
@@ -1256,7 +1413,7 @@ lpr_inherit(fz_context *ctx, pdf_obj *node, char *text, int depth)
 
 		if (o)
 			return pdf_resolve_indirect(ctx, o);
-		node = pdf_dict_gets(ctx, node, "Parent");
+		node = pdf_dict_get(ctx, node, PDF_NAME(Parent));
 		depth--;
 	}
 	while (depth >= 0 && node);
@@ -1278,53 +1435,53 @@ lpr(fz_context *ctx, pdf_document *doc, pdf_obj *node, int depth, int page)
 
 	fz_try(ctx)
 	{
-		if (!strcmp("Page", pdf_to_name(ctx, pdf_dict_gets(ctx, node, "Type"))))
+		if (!strcmp("Page", pdf_to_name(ctx, pdf_dict_get(ctx, node, PDF_NAME(Type)))))
 		{
 			pdf_obj *r; /* r is deliberately not cleaned up */
 
 			/* Copy resources down to the child */
-			o = pdf_keep_obj(ctx, pdf_dict_gets(ctx, node, "Resources"));
+			o = pdf_keep_obj(ctx, pdf_dict_get(ctx, node, PDF_NAME(Resources)));
 			if (!o)
 			{
 				o = pdf_keep_obj(ctx, pdf_new_dict(ctx, doc, 2));
-				pdf_dict_puts(ctx, node, "Resources", o);
+				pdf_dict_put(ctx, node, PDF_NAME(Resources), o);
 			}
 			lpr_inherit_res(ctx, node, depth, o);
 			r = lpr_inherit(ctx, node, "MediaBox", depth);
 			if (r)
-				pdf_dict_puts(ctx, node, "MediaBox", r);
+				pdf_dict_put(ctx, node, PDF_NAME(MediaBox), r);
 			r = lpr_inherit(ctx, node, "CropBox", depth);
 			if (r)
-				pdf_dict_puts(ctx, node, "CropBox", r);
+				pdf_dict_put(ctx, node, PDF_NAME(CropBox), r);
 			r = lpr_inherit(ctx, node, "BleedBox", depth);
 			if (r)
-				pdf_dict_puts(ctx, node, "BleedBox", r);
+				pdf_dict_put(ctx, node, PDF_NAME(BleedBox), r);
 			r = lpr_inherit(ctx, node, "TrimBox", depth);
 			if (r)
-				pdf_dict_puts(ctx, node, "TrimBox", r);
+				pdf_dict_put(ctx, node, PDF_NAME(TrimBox), r);
 			r = lpr_inherit(ctx, node, "ArtBox", depth);
 			if (r)
-				pdf_dict_puts(ctx, node, "ArtBox", r);
+				pdf_dict_put(ctx, node, PDF_NAME(ArtBox), r);
 			r = lpr_inherit(ctx, node, "Rotate", depth);
 			if (r)
-				pdf_dict_puts(ctx, node, "Rotate", r);
+				pdf_dict_put(ctx, node, PDF_NAME(Rotate), r);
 			page++;
 		}
 		else
 		{
-			kids = pdf_dict_gets(ctx, node, "Kids");
+			kids = pdf_dict_get(ctx, node, PDF_NAME(Kids));
 			n = pdf_array_len(ctx, kids);
 			for(i = 0; i < n; i++)
 			{
 				page = lpr(ctx, doc, pdf_array_get(ctx, kids, i), depth+1, page);
 			}
-			pdf_dict_dels(ctx, node, "Resources");
-			pdf_dict_dels(ctx, node, "MediaBox");
-			pdf_dict_dels(ctx, node, "CropBox");
-			pdf_dict_dels(ctx, node, "BleedBox");
-			pdf_dict_dels(ctx, node, "TrimBox");
-			pdf_dict_dels(ctx, node, "ArtBox");
-			pdf_dict_dels(ctx, node, "Rotate");
+			pdf_dict_del(ctx, node, PDF_NAME(Resources));
+			pdf_dict_del(ctx, node, PDF_NAME(MediaBox));
+			pdf_dict_del(ctx, node, PDF_NAME(CropBox));
+			pdf_dict_del(ctx, node, PDF_NAME(BleedBox));
+			pdf_dict_del(ctx, node, PDF_NAME(TrimBox));
+			pdf_dict_del(ctx, node, PDF_NAME(ArtBox));
+			pdf_dict_del(ctx, node, PDF_NAME(Rotate));
 		}
 	}
 	fz_always(ctx)
@@ -1431,13 +1588,13 @@ linearize(fz_context *ctx, pdf_document *doc, pdf_write_options *opts)
 static void
 update_linearization_params(fz_context *ctx, pdf_document *doc, pdf_write_options *opts)
 {
-	int offset;
-	pdf_set_int(ctx, opts->linear_l, opts->file_len);
+	fz_off_t offset;
+	pdf_set_int_offset(ctx, opts->linear_l, opts->file_len);
 	/* Primary hint stream offset (of object, not stream!) */
-	pdf_set_int(ctx, opts->linear_h0, opts->ofs_list[pdf_xref_len(ctx, doc)-1]);
+	pdf_set_int_offset(ctx, opts->linear_h0, opts->ofs_list[pdf_xref_len(ctx, doc)-1]);
 	/* Primary hint stream length (of object, not stream!) */
 	offset = (opts->start == 1 ? opts->main_xref_offset : opts->ofs_list[1] + opts->hintstream_len);
-	pdf_set_int(ctx, opts->linear_h1, offset - opts->ofs_list[pdf_xref_len(ctx, doc)-1]);
+	pdf_set_int_offset(ctx, opts->linear_h1, offset - opts->ofs_list[pdf_xref_len(ctx, doc)-1]);
 	/* Object number of first pages page object (the first object of page 0) */
 	pdf_set_int(ctx, opts->linear_o, opts->page_object_lists->page[0]->object[0]);
 	/* Offset of end of first page (first page is followed by primary
@@ -1445,11 +1602,11 @@ update_linearization_params(fz_context *ctx, pdf_document *doc, pdf_write_option
 	 * primary hint stream counts as part of the first pages data, I think.
 	 */
 	offset = (opts->start == 1 ? opts->main_xref_offset : opts->ofs_list[1] + opts->hintstream_len);
-	pdf_set_int(ctx, opts->linear_e, offset);
+	pdf_set_int_offset(ctx, opts->linear_e, offset);
 	/* Number of pages in document */
 	pdf_set_int(ctx, opts->linear_n, opts->page_count);
 	/* Offset of first entry in main xref table */
-	pdf_set_int(ctx, opts->linear_t, opts->first_xref_entry_offset + opts->hintstream_len);
+	pdf_set_int_offset(ctx, opts->linear_t, opts->first_xref_entry_offset + opts->hintstream_len);
 	/* Offset of shared objects hint table in the primary hint stream */
 	pdf_set_int(ctx, opts->hints_s, opts->hints_shared_offset);
 	/* Primary hint stream length */
@@ -1531,8 +1688,8 @@ static void addhexfilter(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 	nullobj = pdf_new_null(ctx, doc);
 	newf = newdp = NULL;
 
-	f = pdf_dict_gets(ctx, dict, "Filter");
-	dp = pdf_dict_gets(ctx, dict, "DecodeParms");
+	f = pdf_dict_get(ctx, dict, PDF_NAME(Filter));
+	dp = pdf_dict_get(ctx, dict, PDF_NAME(DecodeParms));
 
 	if (pdf_is_name(ctx, f))
 	{
@@ -1557,9 +1714,9 @@ static void addhexfilter(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 	else
 		f = ahx;
 
-	pdf_dict_puts(ctx, dict, "Filter", f);
+	pdf_dict_put(ctx, dict, PDF_NAME(Filter), f);
 	if (dp)
-		pdf_dict_puts(ctx, dict, "DecodeParms", dp);
+		pdf_dict_put(ctx, dict, PDF_NAME(DecodeParms), dp);
 
 	pdf_drop_obj(ctx, ahx);
 	pdf_drop_obj(ctx, nullobj);
@@ -1587,7 +1744,7 @@ static void copystream(fz_context *ctx, pdf_document *doc, pdf_write_options *op
 		addhexfilter(ctx, doc, obj);
 
 		newlen = pdf_new_int(ctx, doc, buf->len);
-		pdf_dict_puts(ctx, obj, "Length", newlen);
+		pdf_dict_put(ctx, obj, PDF_NAME(Length), newlen);
 		pdf_drop_obj(ctx, newlen);
 	}
 
@@ -1615,8 +1772,8 @@ static void expandstream(fz_context *ctx, pdf_document *doc, pdf_write_options *
 		(*opts->errors)++;
 
 	obj = pdf_copy_dict(ctx, obj_orig);
-	pdf_dict_dels(ctx, obj, "Filter");
-	pdf_dict_dels(ctx, obj, "DecodeParms");
+	pdf_dict_del(ctx, obj, PDF_NAME(Filter));
+	pdf_dict_del(ctx, obj, PDF_NAME(DecodeParms));
 
 	if (opts->do_ascii && isbinarystream(buf))
 	{
@@ -1628,7 +1785,7 @@ static void expandstream(fz_context *ctx, pdf_document *doc, pdf_write_options *
 	}
 
 	newlen = pdf_new_int(ctx, doc, buf->len);
-	pdf_dict_puts(ctx, obj, "Length", newlen);
+	pdf_dict_put(ctx, obj, PDF_NAME(Length), newlen);
 	pdf_drop_obj(ctx, newlen);
 
 	fprintf(opts->out, "%d %d obj\n", num, gen);
@@ -1697,7 +1854,7 @@ static void writeobject(fz_context *ctx, pdf_document *doc, pdf_write_options *o
 	/* skip ObjStm and XRef objects */
 	if (pdf_is_dict(ctx, obj))
 	{
-		type = pdf_dict_gets(ctx, obj, "Type");
+		type = pdf_dict_get(ctx, obj, PDF_NAME(Type));
 		if (pdf_is_name(ctx, type) && !strcmp(pdf_to_name(ctx, type), "ObjStm"))
 		{
 			opts->use_list[num] = 0;
@@ -1732,26 +1889,26 @@ static void writeobject(fz_context *ctx, pdf_document *doc, pdf_write_options *o
 		{
 			pdf_obj *o;
 
-			if ((o = pdf_dict_gets(ctx, obj, "Type"), !strcmp(pdf_to_name(ctx, o), "XObject")) &&
-				(o = pdf_dict_gets(ctx, obj, "Subtype"), !strcmp(pdf_to_name(ctx, o), "Image")))
+			if ((o = pdf_dict_get(ctx, obj, PDF_NAME(Type)), !strcmp(pdf_to_name(ctx, o), "XObject")) &&
+				(o = pdf_dict_get(ctx, obj, PDF_NAME(Subtype)), !strcmp(pdf_to_name(ctx, o), "Image")))
 				dontexpand = !(opts->do_expand & fz_expand_images);
-			if (o = pdf_dict_gets(ctx, obj, "Type"), !strcmp(pdf_to_name(ctx, o), "Font"))
+			if (o = pdf_dict_get(ctx, obj, PDF_NAME(Type)), !strcmp(pdf_to_name(ctx, o), "Font"))
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (o = pdf_dict_gets(ctx, obj, "Type"), !strcmp(pdf_to_name(ctx, o), "FontDescriptor"))
+			if (o = pdf_dict_get(ctx, obj, PDF_NAME(Type)), !strcmp(pdf_to_name(ctx, o), "FontDescriptor"))
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (pdf_dict_gets(ctx, obj, "Length1") != NULL)
+			if (pdf_dict_get(ctx, obj, PDF_NAME(Length1)) != NULL)
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (pdf_dict_gets(ctx, obj, "Length2") != NULL)
+			if (pdf_dict_get(ctx, obj, PDF_NAME(Length2)) != NULL)
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (pdf_dict_gets(ctx, obj, "Length3") != NULL)
+			if (pdf_dict_get(ctx, obj, PDF_NAME(Length3)) != NULL)
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (o = pdf_dict_gets(ctx, obj, "Subtype"), !strcmp(pdf_to_name(ctx, o), "Type1C"))
+			if (o = pdf_dict_get(ctx, obj, PDF_NAME(Subtype)), !strcmp(pdf_to_name(ctx, o), "Type1C"))
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (o = pdf_dict_gets(ctx, obj, "Subtype"), !strcmp(pdf_to_name(ctx, o), "CIDFontType0C"))
+			if (o = pdf_dict_get(ctx, obj, PDF_NAME(Subtype)), !strcmp(pdf_to_name(ctx, o), "CIDFontType0C"))
 				dontexpand = !(opts->do_expand & fz_expand_fonts);
-			if (o = pdf_dict_gets(ctx, obj, "Filter"), filter_implies_image(ctx, doc, o))
+			if (o = pdf_dict_get(ctx, obj, PDF_NAME(Filter)), filter_implies_image(ctx, doc, o))
 				dontexpand = !(opts->do_expand & fz_expand_images);
-			if (pdf_dict_gets(ctx, obj, "Width") != NULL && pdf_dict_gets(ctx, obj, "Height") != NULL)
+			if (pdf_dict_get(ctx, obj, PDF_NAME(Width)) != NULL && pdf_dict_get(ctx, obj, PDF_NAME(Height)) != NULL)
 				dontexpand = !(opts->do_expand & fz_expand_images);
 		}
 		fz_try(ctx)
@@ -1782,28 +1939,33 @@ static void writeobject(fz_context *ctx, pdf_document *doc, pdf_write_options *o
 	pdf_drop_obj(ctx, obj);
 }
 
-static void writexrefsubsect(pdf_write_options *opts, int from, int to)
+/* Classic xref entries are fixed at 20 bytes, leaving 10 digits for the offset. */
+#define MAX_XREF_TABLE_OFFSET ((fz_off_t)9999999999)
+
+static void writexrefsubsect(fz_context *ctx, pdf_write_options *opts, int from, int to)
 {
 	int num;
 
 	fprintf(opts->out, "%d %d\n", from, to - from);
 	for (num = from; num < to; num++)
 	{
+		if (opts->ofs_list[num] > MAX_XREF_TABLE_OFFSET)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "object offset too large for an xref table (%d 0 R); use xref streams", num);
 		if (opts->use_list[num])
-			fprintf(opts->out, "%010d %05d n \n", opts->ofs_list[num], opts->gen_list[num]);
+			fprintf(opts->out, "%010" FZ_FMT_OFF " %05d n \n", opts->ofs_list[num], opts->gen_list[num]);
 		else
-			fprintf(opts->out, "%010d %05d f \n", opts->ofs_list[num], opts->gen_list[num]);
+			fprintf(opts->out, "%010" FZ_FMT_OFF " %05d f \n", opts->ofs_list[num], opts->gen_list[num]);
 	}
 }
 
-static void writexref(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int from, int to, int first, int main_xref_offset, int startxref)
+static void writexref(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int from, int to, int first, fz_off_t main_xref_offset, fz_off_t startxref)
 {
 	pdf_obj *trailer = NULL;
 	pdf_obj *obj;
 	pdf_obj *nobj = NULL;
 
 	fprintf(opts->out, "xref\n");
-	opts->first_xref_entry_offset = ftell(opts->out);
+	opts->first_xref_entry_offset = fz_ftell(opts->out);
 
 	if (opts->do_incremental)
 	{
@@ -1820,14 +1982,14 @@ static void writexref(fz_context *ctx, pdf_document *doc, pdf_write_options *opt
 				subto++;
 
 			if (subfrom < subto)
-				writexrefsubsect(opts, subfrom, subto);
+				writexrefsubsect(ctx, opts, subfrom, subto);
 
 			subfrom = subto;
 		}
 	}
 	else
 	{
-		writexrefsubsect(opts, from, to);
+		writexrefsubsect(ctx, opts, from, to);
 	}
 
 	fprintf(opts->out, "\n");
@@ -1840,8 +2002,8 @@ static void writexref(fz_context *ctx, pdf_document *doc, pdf_write_options *opt
 		if (opts->do_incremental)
 		{
 			trailer = pdf_keep_obj(ctx, pdf_trailer(ctx, doc));
-			pdf_dict_puts_drop(ctx, trailer, "Size", pdf_new_int(ctx, doc, pdf_xref_len(ctx, doc)));
-			pdf_dict_puts_drop(ctx, trailer, "Prev", pdf_new_int(ctx, doc, doc->startxref));
+			pdf_dict_put_drop(ctx, trailer, PDF_NAME(Size), pdf_new_int(ctx, doc, pdf_xref_len(ctx, doc)));
+			pdf_dict_put_drop(ctx, trailer, PDF_NAME(Prev), pdf_new_int_offset(ctx, doc, doc->startxref));
 			doc->startxref = startxref;
 		}
 		else
@@ -1849,28 +2011,28 @@ static void writexref(fz_context *ctx, pdf_document *doc, pdf_write_options *opt
 			trailer = pdf_new_dict(ctx, doc, 5);
 
 			nobj = pdf_new_int(ctx, doc, to);
-			pdf_dict_puts(ctx, trailer, "Size", nobj);
+			pdf_dict_put(ctx, trailer, PDF_NAME(Size), nobj);
 			pdf_drop_obj(ctx, nobj);
 			nobj = NULL;
 
 			if (first)
 			{
-				obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Info");
+				obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Info));
 				if (obj)
-					pdf_dict_puts(ctx, trailer, "Info", obj);
+					pdf_dict_put(ctx, trailer, PDF_NAME(Info), obj);
 
-				obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root");
+				obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root));
 				if (obj)
-					pdf_dict_puts(ctx, trailer, "Root", obj);
+					pdf_dict_put(ctx, trailer, PDF_NAME(Root), obj);
 
-				obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "ID");
+				obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(ID));
 				if (obj)
-					pdf_dict_puts(ctx, trailer, "ID", obj);
+					pdf_dict_put(ctx, trailer, PDF_NAME(ID), obj);
 			}
 			if (main_xref_offset != 0)
 			{
-				nobj = pdf_new_int(ctx, doc, main_xref_offset);
-				pdf_dict_puts(ctx, trailer, "Prev", nobj);
+				nobj = pdf_new_int_offset(ctx, doc, main_xref_offset);
+				pdf_dict_put(ctx, trailer, PDF_NAME(Prev), nobj);
 				pdf_drop_obj(ctx, nobj);
 				nobj = NULL;
 			}
@@ -1891,31 +2053,43 @@ static void writexref(fz_context *ctx, pdf_document *doc, pdf_write_options *opt
 
 	pdf_drop_obj(ctx, trailer);
 
-	fprintf(opts->out, "startxref\n%d\n%%%%EOF\n", startxref);
+	fprintf(opts->out, "startxref\n%" FZ_FMT_OFF "\n%%%%EOF\n", startxref);
 
 	doc->has_xref_streams = 0;
 }
 
-static void writexrefstreamsubsect(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, pdf_obj *index, fz_buffer *fzbuf, int from, int to)
+static void writexrefstreamsubsect(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, pdf_obj *index, fz_buffer *fzbuf, int from, int to, int ofs_width)
 {
-	int num;
+	int num, n;
 
 	pdf_array_push_drop(ctx, index, pdf_new_int(ctx, doc, from));
 	pdf_array_push_drop(ctx, index, pdf_new_int(ctx, doc, to - from));
 	for (num = from; num < to; num++)
 	{
 		fz_write_buffer_byte(ctx, fzbuf, opts->use_list[num] ? 1 : 0);
-		fz_write_buffer_byte(ctx, fzbuf, opts->ofs_list[num]>>24);
-		fz_write_buffer_byte(ctx, fzbuf, opts->ofs_list[num]>>16);
-		fz_write_buffer_byte(ctx, fzbuf, opts->ofs_list[num]>>8);
-		fz_write_buffer_byte(ctx, fzbuf, opts->ofs_list[num]);
+		for (n = ofs_width - 1; n >= 0; n--)
+			fz_write_buffer_byte(ctx, fzbuf, (int)(opts->ofs_list[num] >> (n * 8)));
 		fz_write_buffer_byte(ctx, fzbuf, opts->gen_list[num]);
 	}
 }
 
-static void writexrefstream(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int from, int to, int first, int main_xref_offset, int startxref)
+/* Number of bytes needed for the offset column of an xref stream; at least 4. */
+static int xrefstream_ofs_width(pdf_write_options *opts, int from, int to)
 {
-	int num;
+	fz_off_t max = 0;
+	int num, width = 4;
+
+	for (num = from; num < to; num++)
+		if (opts->ofs_list[num] > max)
+			max = opts->ofs_list[num];
+	while (width < (int)sizeof(fz_off_t) && (max >> (width * 8)) != 0)
+		width++;
+	return width;
+}
+
+static void writexrefstream(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int from, int to, int first, fz_off_t main_xref_offset, fz_off_t startxref)
+{
+	int num, ofs_width;
 	pdf_obj *dict = NULL;
 	pdf_obj *obj;
 	pdf_obj *w = NULL;
@@ -1931,59 +2105,60 @@ static void writexrefstream(fz_context *ctx, pdf_document *doc, pdf_write_option
 		dict = pdf_new_dict(ctx, doc, 6);
 		pdf_update_object(ctx, doc, num, dict);
 
-		opts->first_xref_entry_offset = ftell(opts->out);
+		opts->first_xref_entry_offset = fz_ftell(opts->out);
 
 		to++;
 
 		if (first)
 		{
-			obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Info");
+			obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Info));
 			if (obj)
-				pdf_dict_puts(ctx, dict, "Info", obj);
+				pdf_dict_put(ctx, dict, PDF_NAME(Info), obj);
 
-			obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root");
+			obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root));
 			if (obj)
-				pdf_dict_puts(ctx, dict, "Root", obj);
+				pdf_dict_put(ctx, dict, PDF_NAME(Root), obj);
 
-			obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "ID");
+			obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(ID));
 			if (obj)
-				pdf_dict_puts(ctx, dict, "ID", obj);
+				pdf_dict_put(ctx, dict, PDF_NAME(ID), obj);
 
 			if (opts->do_incremental)
 			{
-				obj = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Encrypt");
+				obj = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Encrypt));
 				if (obj)
-					pdf_dict_puts(ctx, dict, "Encrypt", obj);
+					pdf_dict_put(ctx, dict, PDF_NAME(Encrypt), obj);
 			}
 		}
 
-		pdf_dict_puts_drop(ctx, dict, "Size", pdf_new_int(ctx, doc, to));
+		pdf_dict_put_drop(ctx, dict, PDF_NAME(Size), pdf_new_int(ctx, doc, to));
 
 		if (opts->do_incremental)
 		{
-			pdf_dict_puts_drop(ctx, dict, "Prev", pdf_new_int(ctx, doc, doc->startxref));
+			pdf_dict_put_drop(ctx, dict, PDF_NAME(Prev), pdf_new_int_offset(ctx, doc, doc->startxref));
 			doc->startxref = startxref;
 		}
 		else
 		{
 			if (main_xref_offset != 0)
-				pdf_dict_puts_drop(ctx, dict, "Prev", pdf_new_int(ctx, doc, main_xref_offset));
+				pdf_dict_put_drop(ctx, dict, PDF_NAME(Prev), pdf_new_int_offset(ctx, doc, main_xref_offset));
 		}
 
-		pdf_dict_puts_drop(ctx, dict, "Type", pdf_new_name(ctx, doc, "XRef"));
+		pdf_dict_put_drop(ctx, dict, PDF_NAME(Type), pdf_new_name(ctx, doc, "XRef"));
+
+		opts->ofs_list[num] = opts->first_xref_entry_offset;
+		ofs_width = xrefstream_ofs_width(opts, from, to);
 
 		w = pdf_new_array(ctx, doc, 3);
-		pdf_dict_puts(ctx, dict, "W", w);
+		pdf_dict_put(ctx, dict, PDF_NAME(W), w);
 		pdf_array_push_drop(ctx, w, pdf_new_int(ctx, doc, 1));
-		pdf_array_push_drop(ctx, w, pdf_new_int(ctx, doc, 4));
+		pdf_array_push_drop(ctx, w, pdf_new_int(ctx, doc, ofs_width));
 		pdf_array_push_drop(ctx, w, pdf_new_int(ctx, doc, 1));
 
 		index = pdf_new_array(ctx, doc, 2);
-		pdf_dict_puts_drop(ctx, dict, "Index", index);
-
-		opts->ofs_list[num] = opts->first_xref_entry_offset;
+		pdf_dict_put_drop(ctx, dict, PDF_NAME(Index), index);
 
-		fzbuf = fz_new_buffer(ctx, 4*(to-from));
+		fzbuf = fz_new_buffer(ctx, (ofs_width+2)*(to-from));
 
 		if (opts->do_incremental)
 		{
@@ -2000,21 +2175,21 @@ static void writexrefstream(fz_context *ctx, pdf_document *doc, pdf_write_option
 					subto++;
 
 				if (subfrom < subto)
-					writexrefstreamsubsect(ctx, doc, opts, index, fzbuf, subfrom, subto);
+					writexrefstreamsubsect(ctx, doc, opts, index, fzbuf, subfrom, subto, ofs_width);
 
 				subfrom = subto;
 			}
 		}
 		else
 		{
-			writexrefstreamsubsect(ctx, doc, opts, index, fzbuf, from, to);
+			writexrefstreamsubsect(ctx, doc, opts, index, fzbuf, from, to, ofs_width);
 		}
 
 		pdf_update_stream(ctx, doc, num, fzbuf);
-		pdf_dict_puts_drop(ctx, dict, "Length", pdf_new_int(ctx, doc, fz_buffer_storage(ctx, fzbuf, NULL)));
+		pdf_dict_put_drop(ctx, dict, PDF_NAME(Length), pdf_new_int_offset(ctx, doc, fz_buffer_storage(ctx, fzbuf, NULL)));
 
 		writeobject(ctx, doc, opts, num, 0, 0);
-		fprintf(opts->out, "startxref\n%d\n%%%%EOF\n", startxref);
+		fprintf(opts->out, "startxref\n%" FZ_FMT_OFF "\n%%%%EOF\n", startxref);
 	}
 	fz_always(ctx)
 	{
@@ -2029,9 +2204,9 @@ static void writexrefstream(fz_context *ctx, pdf_document *doc, pdf_write_option
 }
 
 static void
-padto(FILE *file, int target)
+padto(FILE *file, fz_off_t target)
 {
-	int pos = ftell(file);
+	fz_off_t pos = fz_ftell(file);
 
 	assert(pos <= target);
 	while (pos < target)
@@ -2067,7 +2242,7 @@ dowriteobject(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int n
 	{
 		if (pass > 0)
 			padto(opts->out, opts->ofs_list[num]);
-		opts->ofs_list[num] = ftell(opts->out);
+		opts->ofs_list[num] = fz_ftell(opts->out);
 		if (!opts->do_incremental || pdf_xref_is_incremental(ctx, doc, num))
 			writeobject(ctx, doc, opts, num, opts->gen_list[num], 1);
 	}
@@ -2093,7 +2268,7 @@ writeobjects(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int pa
 	{
 		/* Write first xref */
 		if (pass == 0)
-			opts->first_xref_offset = ftell(opts->out);
+			opts->first_xref_offset = fz_ftell(opts->out);
 		else
 			padto(opts->out, opts->first_xref_offset);
 		writexref(ctx, doc, opts, opts->start, pdf_xref_len(ctx, doc), 1, opts->main_xref_offset, 0);
@@ -2103,7 +2278,7 @@ writeobjects(fz_context *ctx, pdf_document *doc, pdf_write_options *opts, int pa
 		dowriteobject(ctx, doc, opts, num, pass);
 	if (opts->do_linear && pass == 1)
 	{
-		int offset = (opts->start == 1 ? opts->main_xref_offset : opts->ofs_list[1] + opts->hintstream_len);
+		fz_off_t offset = (opts->start == 1 ? opts->main_xref_offset : opts->ofs_list[1] + opts->hintstream_len);
 		padto(opts->out, offset);
 	}
 	for (num = 1; num < opts->start; num++)
@@ -2427,7 +2602,7 @@ static void dump_object_details(fz_context *ctx, pdf_document *doc, pdf_write_op
 
 	for (i = 0; i < pdf_xref_len(ctx, doc); i++)
 	{
-		fprintf(stderr, "%d@%d: use=%d\n", i, opts->ofs_list[i], opts->use_list[i]);
+		fprintf(stderr, "%d@%" FZ_FMT_OFF ": use=%d\n", i, opts->ofs_list[i], opts->use_list[i]);
 	}
 }
 #endif
@@ -2468,7 +2643,7 @@ static void complete_signatures(fz_context *ctx, pdf_document *doc, pdf_write_op
 	FILE *f;
 	char buf[5120];
 	int i;
-	int flen;
+	fz_off_t flen;
 	int last_end;
 
 	if (doc->unsaved_sigs)
@@ -2479,15 +2654,15 @@ static void complete_signatures(fz_context *ctx, pdf_document *doc, pdf_write_op
 		if (!f)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to open %s to complete signatures", filename);
 
-		fseek(f, 0, SEEK_END);
-		flen = ftell(f);
+		fz_fseek(f, 0, SEEK_END);
+		flen = fz_ftell(f);
 
 		/* Locate the byte ranges and contents in the saved file */
 		for (usig = doc->unsaved_sigs; usig; usig = usig->next)
 		{
 			char *bstr, *cstr, *fstr;
 			int pnum = pdf_obj_parent_num(ctx, pdf_dict_getp(ctx, usig->field, "V/ByteRange"));
-			fseek(f, opts->ofs_list[pnum], SEEK_SET);
+			fz_fseek(f, opts->ofs_list[pnum], SEEK_SET);
 			(void)fread(buf, 1, sizeof(buf), f);
 			buf[sizeof(buf)-1] = 0;
 
@@ -2517,7 +2692,7 @@ static void complete_signatures(fz_context *ctx, pdf_document *doc, pdf_write_op
 			last_end = usig->contents_end;
 		}
 		pdf_array_push_drop(ctx, byte_range, pdf_new_int(ctx, doc, last_end));
-		pdf_array_push_drop(ctx, byte_range, pdf_new_int(ctx, doc, flen - last_end));
+		pdf_array_push_drop(ctx, byte_range, pdf_new_int_offset(ctx, doc, flen - last_end));
 
 		/* Copy the new ByteRange to the other unsaved signatures */
 		for (usig = doc->unsaved_sigs->next; usig; usig = usig->next)
@@ -2530,7 +2705,7 @@ static void complete_signatures(fz_context *ctx, pdf_document *doc, pdf_write_op
 		/* Write the byte range to the file */
 		for (usig = doc->unsaved_sigs; usig; usig = usig->next)
 		{
-			fseek(f, usig->byte_range_start, SEEK_SET);
+			fz_fseek(f, usig->byte_range_start, SEEK_SET);
 			fwrite(buf, 1, usig->byte_range_end - usig->byte_range_start, f);
 		}
 
@@ -2623,7 +2798,7 @@ void pdf_write_document(fz_context *ctx, pdf_document *doc, char *filename, fz_w
 		 * 1 to n access rather than 0..n-1, and add space for 2 new
 		 * extra entries that may be required for linearization. */
 		opts.use_list = fz_malloc_array(ctx, pdf_xref_len(ctx, doc) + 3, sizeof(int));
-		opts.ofs_list = fz_malloc_array(ctx, pdf_xref_len(ctx, doc) + 3, sizeof(int));
+		opts.ofs_list = fz_malloc_array(ctx, pdf_xref_len(ctx, doc) + 3, sizeof(*opts.ofs_list));
 		opts.gen_list = fz_calloc(ctx, pdf_xref_len(ctx, doc) + 3, sizeof(int));
 		opts.renumber_map = fz_malloc_array(ctx, pdf_xref_len(ctx, doc) + 3, sizeof(int));
 		opts.rev_renumber_map = fz_malloc_array(ctx, pdf_xref_len(ctx, doc) + 3, sizeof(int));
@@ -2714,9 +2889,9 @@ void pdf_write_document(fz_context *ctx, pdf_document *doc, char *filename, fz_w
 
 		if (opts.do_linear)
 		{
-			opts.main_xref_offset = ftell(opts.out);
+			opts.main_xref_offset = fz_ftell(opts.out);
 			writexref(ctx, doc, &opts, 0, opts.start, 0, 0, opts.first_xref_offset);
-			opts.file_len = ftell(opts.out);
+			opts.file_len = fz_ftell(opts.out);
 
 			make_hint_stream(ctx, doc, &opts);
 			if (opts.do_ascii)
@@ -2735,7 +2910,7 @@ void pdf_write_document(fz_context *ctx, pdf_document *doc, char *filename, fz_w
 		}
 		else
 		{
-			opts.first_xref_offset = ftell(opts.out);
+			opts.first_xref_offset = fz_ftell(opts.out);
 			if (opts.do_incremental && doc->has_xref_streams)
 				writexrefstream(ctx, doc, &opts, 0, xref_len, 1, 0, opts.first_xref_offset);
 			else
@@ -2807,10 +2982,10 @@ make_page_tree_node(fz_context *ctx, pdf_document *doc, int l, int r, pdf_obj *p
 	fz_try(ctx)
 	{
 		me = pdf_new_dict(ctx, doc, 2);
-		pdf_dict_puts_drop(ctx, me, "Type", pdf_new_name(ctx, doc, "Pages"));
-		pdf_dict_puts_drop(ctx, me, "Count", pdf_new_int(ctx, doc, r-l));
+		pdf_dict_put_drop(ctx, me, PDF_NAME(Type), pdf_new_name(ctx, doc, "Pages"));
+		pdf_dict_put_drop(ctx, me, PDF_NAME(Count), pdf_new_int(ctx, doc, r-l));
 		if (!root)
-			pdf_dict_puts(ctx, me, "Parent", parent_ref);
+			pdf_dict_put(ctx, me, PDF_NAME(Parent), parent_ref);
 		a = pdf_new_array(ctx, doc, KIDS_PER_LEVEL);
 		me_ref = pdf_new_ref(ctx, doc, me);
 
@@ -2819,7 +2994,7 @@ make_page_tree_node(fz_context *ctx, pdf_document *doc, int l, int r, pdf_obj *p
 			if (spaces >= r-l)
 			{
 				o = pdf_keep_obj(ctx, doc->page_refs[l++]);
-				pdf_dict_puts(ctx, o, "Parent", me_ref);
+				pdf_dict_put(ctx, o, PDF_NAME(Parent), me_ref);
 			}
 			else
 			{
@@ -2833,7 +3008,7 @@ make_page_tree_node(fz_context *ctx, pdf_document *doc, int l, int r, pdf_obj *p
 			pdf_drop_obj(ctx, o);
 			o = NULL;
 		}
-		pdf_dict_puts_drop(ctx, me, "Kids", a);
+		pdf_dict_put_drop(ctx, me, PDF_NAME(Kids), a);
 		a = NULL;
 	}
 	fz_always(ctx)
@@ -2859,9 +3034,9 @@ pdf_rebalance_page_tree(fz_context *ctx, pdf_document *doc)
 	if (!doc || !doc->needs_page_tree_rebuild)
 		return;
 
-	catalog = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root");
+	catalog = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root));
 	pages = make_page_tree_node(ctx, doc, 0, doc->page_len, catalog, 1);
-	pdf_dict_puts_drop(ctx, catalog, "Pages", pages);
+	pdf_dict_put_drop(ctx, catalog, PDF_NAME(Pages), pages);
 
 	doc->needs_page_tree_rebuild = 0;
 }
@@ -57,10 +57,10 @@ pdf_load_xobject(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 
 	fz_try(ctx)
 	{
-		obj = pdf_dict_gets(ctx, dict, "BBox");
+		obj = pdf_dict_get(ctx, dict, PDF_NAME(BBox));
 		pdf_to_rect(ctx, obj, &form->bbox);
 
-		obj = pdf_dict_gets(ctx, dict, "Matrix");
+		obj = pdf_dict_get(ctx, dict, PDF_NAME(Matrix));
 		if (obj)
 			pdf_to_matrix(ctx, obj, &form->matrix);
 		else
@@ -70,19 +70,19 @@ pdf_load_xobject(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 		form->knockout = 0;
 		form->transparency = 0;
 
-		obj = pdf_dict_gets(ctx, dict, "Group");
+		obj = pdf_dict_get(ctx, dict, PDF_NAME(Group));
 		if (obj)
 		{
 			pdf_obj *attrs = obj;
 
-			form->isolated = pdf_to_bool(ctx, pdf_dict_gets(ctx, attrs, "I"));
-			form->knockout = pdf_to_bool(ctx, pdf_dict_gets(ctx, attrs, "K"));
+			form->isolated = pdf_to_bool(ctx, pdf_dict_get(ctx, attrs, PDF_NAME(I)));
+			form->knockout = pdf_to_bool(ctx, pdf_dict_get(ctx, attrs, PDF_NAME(K)));
 
-			obj = pdf_dict_gets(ctx, attrs, "S");
+			obj = pdf_dict_get(ctx, attrs, PDF_NAME(S));
 			if (pdf_is_name(ctx, obj) && !strcmp(pdf_to_name(ctx, obj), "Transparency"))
 				form->transparency = 1;
 
-			obj = pdf_dict_gets(ctx, attrs, "CS");
+			obj = pdf_dict_get(ctx, attrs, PDF_NAME(CS));
 			if (obj)
 			{
 				fz_try(ctx)
@@ -96,7 +96,7 @@ pdf_load_xobject(fz_context *ctx, pdf_document *doc, pdf_obj *dict)
 			}
 		}
 
-		form->resources = pdf_dict_gets(ctx, dict, "Resources");
+		form->resources = pdf_dict_get(ctx, dict, PDF_NAME(Resources));
 		if (form->resources)
 			pdf_keep_obj(ctx, form->resources);
 
@@ -135,22 +135,22 @@ pdf_new_xobject(fz_context *ctx, pdf_document *doc, const fz_rect *bbox, const f
 		dict = pdf_new_dict(ctx, doc, 0);
 
 		obj = pdf_new_rect(ctx, doc, bbox);
-		pdf_dict_puts(ctx, dict, "BBox", obj);
+		pdf_dict_put(ctx, dict, PDF_NAME(BBox), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
 		obj = pdf_new_int(ctx, doc, 1);
-		pdf_dict_puts(ctx, dict, "FormType", obj);
+		pdf_dict_put(ctx, dict, PDF_NAME(FormType), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
 		obj = pdf_new_int(ctx, doc, 0);
-		pdf_dict_puts(ctx, dict, "Length", obj);
+		pdf_dict_put(ctx, dict, PDF_NAME(Length), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
 		obj = pdf_new_matrix(ctx, doc, mat);
-		pdf_dict_puts(ctx, dict, "Matrix", obj);
+		pdf_dict_put(ctx, dict, PDF_NAME(Matrix), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
@@ -164,18 +164,18 @@ pdf_new_xobject(fz_context *ctx, pdf_document *doc, const fz_rect *bbox, const f
 		pdf_array_push(ctx, procset, obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
-		pdf_dict_puts(ctx, res, "ProcSet", procset);
+		pdf_dict_put(ctx, res, PDF_NAME(ProcSet), procset);
 		pdf_drop_obj(ctx, procset);
 		procset = NULL;
-		pdf_dict_puts(ctx, dict, "Resources", res);
+		pdf_dict_put(ctx, dict, PDF_NAME(Resources), res);
 
 		obj = pdf_new_name(ctx, doc, "Form");
-		pdf_dict_puts(ctx, dict, "Subtype", obj);
+		pdf_dict_put(ctx, dict, PDF_NAME(Subtype), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
 		obj = pdf_new_name(ctx, doc, "XObject");
-		pdf_dict_puts(ctx, dict, "Type", obj);
+		pdf_dict_put(ctx, dict, PDF_NAME(Type), obj);
 		pdf_drop_obj(ctx, obj);
 		obj = NULL;
 
@@ -228,8 +228,8 @@ pdf_new_xobject(fz_context *ctx, pdf_document *doc, const fz_rect *bbox, const f
 
 void pdf_update_xobject_contents(fz_context *ctx, pdf_document *doc, pdf_xobject *form, fz_buffer *buffer)
 {
-	pdf_dict_dels(ctx, form->contents, "Filter");
-	pdf_dict_puts_drop(ctx, form->contents, "Length", pdf_new_int(ctx, doc, buffer->len));
+	pdf_dict_del(ctx, form->contents, PDF_NAME(Filter));
+	pdf_dict_put_drop(ctx, form->contents, PDF_NAME(Length), pdf_new_int(ctx, doc, buffer->len));
 	pdf_update_stream(ctx, doc, pdf_to_num(ctx, form->contents), buffer);
 	form->iteration ++;
 }
@@ -478,14 +478,17 @@ static void
 pdf_read_start_xref(fz_context *ctx, pdf_document *doc)
 { //反向查找startxref获得xref的位置
 	unsigned char buf[1024];
-	int t, n;
+	fz_off_t t;
+	int n;
 	int i;
 
 	fz_seek(ctx, doc->file, 0, SEEK_END);
 
 	doc->file_size = fz_tell(ctx, doc->file);
 
-	t = fz_maxi(0, doc->file_size - (int)sizeof buf);
+	t = doc->file_size - (fz_off_t)sizeof buf;
+	if (t < 0)
+		t = 0;
 	fz_seek(ctx, doc->file, t, SEEK_SET);
 
 	n = fz_read(ctx, doc->file, buf, sizeof buf);
@@ -499,7 +502,11 @@ pdf_read_start_xref(fz_context *ctx, pdf_document *doc)
 				i ++;
 			doc->startxref = 0;
 			while (i < n && buf[i] >= '0' && buf[i] <= '9')
+			{
+				if (doc->startxref >= FZ_OFF_T_MAX / 10)
+					fz_throw(ctx, FZ_ERROR_GENERIC, "startxref out of range");
 				doc->startxref = doc->startxref * 10 + (buf[i++] - '0');
+			}
 			if (doc->startxref != 0)
 				return;
 			break;
@@ -518,11 +525,11 @@ pdf_xref_size_from_old_trailer(fz_context *ctx, pdf_document *doc, pdf_lexbuf *b
 {
 	int len;
 	char *s;
-	int t;
+	fz_off_t t;
 	pdf_token tok;
 	int c;
 	int size;
-	int ofs;
+	fz_off_t ofs;
 	pdf_obj *trailer = NULL;
 
 	fz_var(trailer);
@@ -556,7 +563,7 @@ pdf_xref_size_from_old_trailer(fz_context *ctx, pdf_document *doc, pdf_lexbuf *b
 		t = fz_tell(ctx, doc->file);
 		if (t < 0)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "cannot tell in file");
-		if (len > (INT_MAX - t) / 20)
+		if (len > (FZ_OFF_T_MAX - t) / 20)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "xref has too many entries");
 
 		fz_seek(ctx, doc->file, t + 20 * len, SEEK_SET);
@@ -574,7 +581,7 @@ pdf_xref_size_from_old_trailer(fz_context *ctx, pdf_document *doc, pdf_lexbuf *b
 
 		trailer = pdf_parse_dict(ctx, doc, doc->file, buf);
 
-		size = pdf_to_int(ctx, pdf_dict_gets(ctx, trailer, "Size"));
+		size = pdf_to_int(ctx, pdf_dict_get(ctx, trailer, PDF_NAME(Size)));
 		if (!size)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "trailer missing Size entry");
 	}
@@ -720,7 +727,7 @@ pdf_read_old_xref(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf)
 				while (*s != '\0' && iswhite(*s))
 					s++;
 
-				entry->ofs = atoi(s);
+				entry->ofs = fz_atoo(s);
 				entry->gen = atoi(s + 11);
 				entry->type = s[17];
 				if (s[17] != 'f' && s[17] != 'n' && s[17] != 'o')
@@ -764,7 +771,7 @@ pdf_read_new_xref_section(fz_context *ctx, pdf_document *doc, fz_stream *stm, in
 	{
 		pdf_xref_entry *entry = &table[i-i0];
 		int a = 0;
-		int b = 0;
+		fz_off_t b = 0;
 		int c = 0;
 
 		if (fz_is_eof(ctx, stm))
@@ -797,7 +804,8 @@ pdf_read_new_xref(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf)
 	pdf_obj *trailer = NULL;
 	pdf_obj *index = NULL;
 	pdf_obj *obj = NULL;
-	int num, gen, ofs, stm_ofs;
+	int num, gen;
+	fz_off_t ofs, stm_ofs;
 	int size, w0, w1, w2;
 	int t;
 
@@ -819,13 +827,13 @@ pdf_read_new_xref(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf)
 	{
 		pdf_xref_entry *entry;
 
-		obj = pdf_dict_gets(ctx, trailer, "Size");
+		obj = pdf_dict_get(ctx, trailer, PDF_NAME(Size));
 		if (!obj)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "xref stream missing Size entry (%d %d R)", num, gen);
 
 		size = pdf_to_int(ctx, obj);
 
-		obj = pdf_dict_gets(ctx, trailer, "W");
+		obj = pdf_dict_get(ctx, trailer, PDF_NAME(W));
 		if (!obj)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "xref stream missing W entry (%d %d R)", num, gen);
 		w0 = pdf_to_int(ctx, pdf_array_get(ctx, obj, 0));
@@ -839,11 +847,14 @@ pdf_read_new_xref(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf)
 		if (w2 < 0)
 			fz_warn(ctx, "xref stream objects have corrupt generation");
 
+		if (w1 > (int)sizeof(fz_off_t))
+			fz_throw(ctx, FZ_ERROR_GENERIC, "xref stream offsets too wide (%d bytes)", w1);
+
 		w0 = w0 < 0 ? 0 : w0;
 		w1 = w1 < 0 ? 0 : w1;
 		w2 = w2 < 0 ? 0 : w2;
 
-		index = pdf_dict_gets(ctx, trailer, "Index");
+		index = pdf_dict_get(ctx, trailer, PDF_NAME(Index));
 
 		stm = pdf_open_stream_with_offset(ctx, doc, num, gen, trailer, stm_ofs);
 
@@ -883,7 +894,7 @@ pdf_read_new_xref(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf)
 }
 
 static pdf_obj *
-pdf_read_xref(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf)
+pdf_read_xref(fz_context *ctx, pdf_document *doc, fz_off_t ofs, pdf_lexbuf *buf)
 {
 	pdf_obj *trailer;
 	int c;
@@ -905,7 +916,7 @@ pdf_read_xref(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf)
 	}
 	fz_catch(ctx)
 	{
-		fz_rethrow_message(ctx, "cannot read xref (ofs=%d)", ofs);
+		fz_rethrow_message(ctx, "cannot read xref (ofs=%" FZ_FMT_OFF ")", ofs);
 	}
 	return trailer;
 }
@@ -916,15 +927,15 @@ struct ofs_list_s
 {
 	int max;
 	int len;
-	int *list;
+	fz_off_t *list;
 };
 
-static int
-read_xref_section(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf, ofs_list *offsets)
+static fz_off_t
+read_xref_section(fz_context *ctx, pdf_document *doc, fz_off_t ofs, pdf_lexbuf *buf, ofs_list *offsets)
 {
 	pdf_obj *trailer = NULL;
-	int xrefstmofs = 0;
-	int prevofs = 0;
+	fz_off_t xrefstmofs = 0;
+	fz_off_t prevofs = 0;
 
 	fz_var(trailer);
 
@@ -939,12 +950,12 @@ read_xref_section(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf,
 		}
 		if (i < offsets->len)
 		{
-			fz_warn(ctx, "ignoring xref recursion with offset %d", ofs);
+			fz_warn(ctx, "ignoring xref recursion with offset %" FZ_FMT_OFF, ofs);
 			break;
 		}
 		if (offsets->len == offsets->max)
 		{
-			offsets->list = fz_resize_array(ctx, offsets->list, offsets->max*2, sizeof(int));
+			offsets->list = fz_resize_array(ctx, offsets->list, offsets->max*2, sizeof(*offsets->list));
 			offsets->max *= 2;
 		}
 		offsets->list[offsets->len++] = ofs;
@@ -955,7 +966,7 @@ read_xref_section(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf,
 
 		/* FIXME: do we overwrite free entries properly? */
 		/* FIXME: Does this work properly with progression? */
-		xrefstmofs = pdf_to_int(ctx, pdf_dict_gets(ctx, trailer, "XRefStm"));
+		xrefstmofs = pdf_to_offset(ctx, pdf_dict_get(ctx, trailer, PDF_NAME(XRefStm)));
 		if (xrefstmofs)
 		{
 			if (xrefstmofs < 0)
@@ -969,7 +980,7 @@ read_xref_section(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf,
 			pdf_drop_obj(ctx, pdf_read_xref(ctx, doc, xrefstmofs, buf));
 		}
 
-		prevofs = pdf_to_int(ctx, pdf_dict_gets(ctx, trailer, "Prev"));
+		prevofs = pdf_to_offset(ctx, pdf_dict_get(ctx, trailer, PDF_NAME(Prev)));
 		if (prevofs < 0)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "negative xref stream offset for previous xref stream");
 	}
@@ -979,20 +990,20 @@ read_xref_section(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf,
 	}
 	fz_catch(ctx)
 	{
-		fz_rethrow_message(ctx, "cannot read xref at offset %d", ofs);
+		fz_rethrow_message(ctx, "cannot read xref at offset %" FZ_FMT_OFF, ofs);
 	}
 
 	return prevofs;
 }
 
 static void
-pdf_read_xref_sections(fz_context *ctx, pdf_document *doc, int ofs, pdf_lexbuf *buf, int read_previous)
+pdf_read_xref_sections(fz_context *ctx, pdf_document *doc, fz_off_t ofs, pdf_lexbuf *buf, int read_previous)
 {
 	ofs_list list;
 
 	list.len = 0;
 	list.max = 10;
-	list.list = fz_malloc_array(ctx, 10, sizeof(int));
+	list.list = fz_malloc_array(ctx, 10, sizeof(*list.list));
 	fz_try(ctx)
 	{
 		while(ofs)
@@ -1084,11 +1095,11 @@ pdf_load_xref(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf)
 			if (entry->ofs == 0)
 				entry->type = 'f';
 			else if (entry->ofs <= 0 || entry->ofs >= doc->file_size)
-				fz_throw(ctx, FZ_ERROR_GENERIC, "object offset out of range: %d (%d 0 R)", entry->ofs, i);
+				fz_throw(ctx, FZ_ERROR_GENERIC, "object offset out of range: %" FZ_FMT_OFF " (%d 0 R)", entry->ofs, i);
 		}
 		if (entry->type == 'o')
 			if (entry->ofs <= 0 || entry->ofs >= xref_len || pdf_get_xref_entry(ctx, doc, entry->ofs)->type != 'n')
-				fz_throw(ctx, FZ_ERROR_GENERIC, "invalid reference to an objstm that does not exist: %d (%d 0 R)", entry->ofs, i);
+				fz_throw(ctx, FZ_ERROR_GENERIC, "invalid reference to an objstm that does not exist: %" FZ_FMT_OFF " (%d 0 R)", entry->ofs, i);
 	}
 }
 
@@ -1098,7 +1109,8 @@ pdf_load_linear(fz_context *ctx, pdf_document *doc)
 	pdf_obj *dict = NULL;
 	pdf_obj *hint = NULL;
 	pdf_obj *o;
-	int num, gen, stmofs, lin, len;
+	int num, gen, lin;
+	fz_off_t stmofs, len;
 
 	fz_var(dict);
 	fz_var(hint);
@@ -1110,28 +1122,28 @@ pdf_load_linear(fz_context *ctx, pdf_document *doc)
 		dict = pdf_parse_ind_obj(ctx, doc, doc->file, &doc->lexbuf.base, &num, &gen, &stmofs, NULL);
 		if (!pdf_is_dict(ctx, dict))
 			fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to read linearized dictionary");
-		o = pdf_dict_gets(ctx, dict, "Linearized");
+		o = pdf_dict_get(ctx, dict, PDF_NAME(Linearized));
 		if (o == NULL)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to read linearized dictionary");
 		lin = pdf_to_int(ctx, o);
 		if (lin != 1)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "Unexpected version of Linearized tag (%d)", lin);
-		len = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "L"));
+		len = pdf_to_offset(ctx, pdf_dict_get(ctx, dict, PDF_NAME(L)));
 		if (len != doc->file_length)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "File has been updated since linearization");
 
 		pdf_read_xref_sections(ctx, doc, fz_tell(ctx, doc->file), &doc->lexbuf.base, 0);
 
-		doc->page_count = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "N"));
+		doc->page_count = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(N)));
 		doc->linear_page_refs = fz_resize_array(ctx, doc->linear_page_refs, doc->page_count, sizeof(pdf_obj *));
 		memset(doc->linear_page_refs, 0, doc->page_count * sizeof(pdf_obj*));
 		doc->linear_obj = dict;
 		doc->linear_pos = fz_tell(ctx, doc->file);
-		doc->linear_page1_obj_num = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "O"));
+		doc->linear_page1_obj_num = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(O)));
 		doc->linear_page_refs[0] = pdf_new_indirect(ctx, doc, doc->linear_page1_obj_num, 0);
 		doc->linear_page_num = 0;
-		hint = pdf_dict_gets(ctx, dict, "H");
-		doc->hint_object_offset = pdf_to_int(ctx, pdf_array_get(ctx, hint, 0));
+		hint = pdf_dict_get(ctx, dict, PDF_NAME(H));
+		doc->hint_object_offset = pdf_to_offset(ctx, pdf_array_get(ctx, hint, 0));
 		doc->hint_object_length = pdf_to_int(ctx, pdf_array_get(ctx, hint, 1));
 
 		entry = pdf_get_populating_xref_entry(ctx, doc, 0);
@@ -1154,7 +1166,7 @@ pdf_ocg_set_config(fz_context *ctx, pdf_document *doc, int config)
 	pdf_obj *obj, *cobj;
 	char *name;
 
-	obj = pdf_dict_gets(ctx, pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root"), "OCProperties");
+	obj = pdf_dict_gets(ctx, pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root)), "OCProperties");
 	if (!obj)
 	{
 		if (config == 0)
@@ -1164,24 +1176,24 @@ pdf_ocg_set_config(fz_context *ctx, pdf_document *doc, int config)
 	}
 	if (config == 0)
 	{
-		cobj = pdf_dict_gets(ctx, obj, "D");
+		cobj = pdf_dict_get(ctx, obj, PDF_NAME(D));
 		if (!cobj)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "No default OCG config");
 	}
 	else
 	{
-		cobj = pdf_array_get(ctx, pdf_dict_gets(ctx, obj, "Configs"), config);
+		cobj = pdf_array_get(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Configs)), config);
 		if (!cobj)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "Illegal OCG config");
 	}
 
 	pdf_drop_obj(ctx, desc->intent);
-	desc->intent = pdf_dict_gets(ctx, cobj, "Intent");
+	desc->intent = pdf_dict_get(ctx, cobj, PDF_NAME(Intent));
 	if (desc->intent)
 		pdf_keep_obj(ctx, desc->intent);
 
 	len = desc->len;
-	name = pdf_to_name(ctx, pdf_dict_gets(ctx, cobj, "BaseState"));
+	name = pdf_to_name(ctx, pdf_dict_get(ctx, cobj, PDF_NAME(BaseState)));
 	if (strcmp(name, "Unchanged") == 0)
 	{
 		/* Do nothing */
@@ -1201,7 +1213,7 @@ pdf_ocg_set_config(fz_context *ctx, pdf_document *doc, int config)
 		}
 	}
 
-	obj = pdf_dict_gets(ctx, cobj, "ON");
+	obj = pdf_dict_get(ctx, cobj, PDF_NAME(ON));
 	len2 = pdf_array_len(ctx, obj);
 	for (i = 0; i < len2; i++)
 	{
@@ -1218,7 +1230,7 @@ pdf_ocg_set_config(fz_context *ctx, pdf_document *doc, int config)
 		}
 	}
 
-	obj = pdf_dict_gets(ctx, cobj, "OFF");
+	obj = pdf_dict_get(ctx, cobj, PDF_NAME(OFF));
 	len2 = pdf_array_len(ctx, obj);
 	for (i = 0; i < len2; i++)
 	{
@@ -1259,10 +1271,10 @@ pdf_read_ocg(fz_context *ctx, pdf_document *doc)
 
 	fz_var(desc);
 
-	obj = pdf_dict_gets(ctx, pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root"), "OCProperties");
+	obj = pdf_dict_gets(ctx, pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root)), "OCProperties");
 	if (!obj)
 		return;
-	ocg = pdf_dict_gets(ctx, obj, "OCGs");
+	ocg = pdf_dict_get(ctx, obj, PDF_NAME(OCGs));
 	if (!ocg || !pdf_is_array(ctx, ocg))
 		/* Not ever supposed to happen, but live with it. */
 		return;
@@ -1364,8 +1376,8 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 			pdf_prime_xref_index(ctx, doc);
 		}
 
-		encrypt = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Encrypt");
-		id = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "ID");
+		encrypt = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Encrypt));
+		id = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(ID));
 		if (pdf_is_dict(ctx, encrypt))
 			doc->crypt = pdf_new_crypt(ctx, encrypt, id);
 
@@ -1377,8 +1389,8 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 			int xref_len = pdf_xref_len(ctx, doc);
 			pdf_repair_obj_stms(ctx, doc);
 
-			hasroot = (pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root") != NULL);
-			hasinfo = (pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Info") != NULL);
+			hasroot = (pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root)) != NULL);
+			hasinfo = (pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Info)) != NULL);
 
 			for (i = 1; i < xref_len; i++)
 			{
@@ -1399,11 +1411,11 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 
 				if (!hasroot)
 				{
-					obj = pdf_dict_gets(ctx, dict, "Type");
+					obj = pdf_dict_get(ctx, dict, PDF_NAME(Type));
 					if (pdf_is_name(ctx, obj) && !strcmp(pdf_to_name(ctx, obj), "Catalog"))
 					{
 						nobj = pdf_new_indirect(ctx, doc, i, 0);
-						pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "Root", nobj);
+						pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root), nobj);
 						pdf_drop_obj(ctx, nobj);
 						nobj = NULL;
 					}
@@ -1411,10 +1423,10 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 
 				if (!hasinfo)
 				{
-					if (pdf_dict_gets(ctx, dict, "Creator") || pdf_dict_gets(ctx, dict, "Producer"))
+					if (pdf_dict_get(ctx, dict, PDF_NAME(Creator)) || pdf_dict_get(ctx, dict, PDF_NAME(Producer)))
 					{
 						nobj = pdf_new_indirect(ctx, doc, i, 0);
-						pdf_dict_puts(ctx, pdf_trailer(ctx, doc), "Info", nobj);
+						pdf_dict_put(ctx, pdf_trailer(ctx, doc), PDF_NAME(Info), nobj);
 						pdf_drop_obj(ctx, nobj);
 						nobj = NULL;
 					}
@@ -1477,6 +1489,7 @@ pdf_close_document(fz_context *ctx, pdf_document *doc)
 	if (doc->js)
 		doc->drop_js(doc->js);
 
+	pdf_drop_page_map(ctx, doc);
 	pdf_drop_xref_sections(ctx, doc);
 	fz_free(ctx, doc->xref_index);
 
@@ -1534,7 +1547,7 @@ pdf_print_xref(fz_context *ctx, pdf_document *doc)
 	for (i = 0; i < xref_len; i++)
 	{
 		pdf_xref_entry *entry = pdf_get_xref_entry(ctx, doc, i);
-		printf("%05d: %010d %05d %c (stm_ofs=%d; stm_buf=%p)\n", i,
+		printf("%05d: %010" FZ_FMT_OFF " %05d %c (stm_ofs=%" FZ_FMT_OFF "; stm_buf=%p)\n", i,
 			entry->ofs,
 			entry->gen,
 			entry->type ? entry->type : '-',
@@ -1571,8 +1584,8 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, int gen, pdf_lexbu
 	{
 		objstm = pdf_load_object(ctx, doc, num, gen);
 
-		count = pdf_to_int(ctx, pdf_dict_gets(ctx, objstm, "N"));
-		first = pdf_to_int(ctx, pdf_dict_gets(ctx, objstm, "First"));
+		count = pdf_to_int(ctx, pdf_dict_get(ctx, objstm, PDF_NAME(N)));
+		first = pdf_to_int(ctx, pdf_dict_get(ctx, objstm, PDF_NAME(First)));
 
 		if (count < 0)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "negative number of objects in object stream");
@@ -1659,13 +1672,14 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, int gen, pdf_lexbu
  * object loading
  */
 static int
-pdf_obj_read(fz_context *ctx, pdf_document *doc, int *offset, int *nump, pdf_obj **page)
+pdf_obj_read(fz_context *ctx, pdf_document *doc, fz_off_t *offset, int *nump, pdf_obj **page)
 {
 	pdf_lexbuf *buf = &doc->lexbuf.base;
-	int num, numofs, gen, genofs, stmofs, tmpofs, tok;
+	int num, gen, tok;
+	fz_off_t numofs, genofs, stmofs, tmpofs;
 	int xref_len;
 	pdf_xref_entry *entry;
-	int newtmpofs;
+	fz_off_t newtmpofs;
 
 	numofs = *offset;
 	fz_seek(ctx, doc->file, numofs, SEEK_SET);
@@ -1676,7 +1690,7 @@ pdf_obj_read(fz_context *ctx, pdf_document *doc, int *offset, int *nump, pdf_obj
 	if (tok != PDF_TOK_INT)
 	{
 		/* Failed! */
-		DEBUGMESS((ctx, "skipping unexpected data (tok=%d) at %d", tok, *offset));
+		DEBUGMESS((ctx, "skipping unexpected data (tok=%d) at %" FZ_FMT_OFF, tok, *offset));
 		*offset = genofs;
 		return tok == PDF_TOK_EOF;
 	}
@@ -1688,7 +1702,7 @@ pdf_obj_read(fz_context *ctx, pdf_document *doc, int *offset, int *nump, pdf_obj
 	if (tok != PDF_TOK_INT)
 	{
 		/* Failed! */
-		DEBUGMESS((ctx, "skipping unexpected data after \"%d\" (tok=%d) at %d", num, tok, *offset));
+		DEBUGMESS((ctx, "skipping unexpected data after \"%d\" (tok=%d) at %" FZ_FMT_OFF, num, tok, *offset));
 		*offset = tmpofs;
 		return tok == PDF_TOK_EOF;
 	}
@@ -1703,11 +1717,11 @@ pdf_obj_read(fz_context *ctx, pdf_document *doc, int *offset, int *nump, pdf_obj
 			break;
 		if (tok != PDF_TOK_INT)
 		{
-			DEBUGMESS((ctx, "skipping unexpected data (tok=%d) at %d", tok, tmpofs));
+			DEBUGMESS((ctx, "skipping unexpected data (tok=%d) at %" FZ_FMT_OFF, tok, tmpofs));
 			*offset = fz_tell(ctx, doc->file);
 			return tok == PDF_TOK_EOF;
 		}
-		DEBUGMESS((ctx, "skipping unexpected int %d at %d", num, numofs));
+		DEBUGMESS((ctx, "skipping unexpected int %d at %" FZ_FMT_OFF, num, numofs));
 		*nump = num = gen;
 		numofs = genofs;
 		gen = buf->i;
@@ -1755,7 +1769,7 @@ pdf_obj_read(fz_context *ctx, pdf_document *doc, int *offset, int *nump, pdf_obj
 		}
 		if (page && *page)
 		{
-			DEBUGMESS((ctx, "Successfully read object %d @ %d - and found page %d!", num, numofs, doc->linear_page_num));
+			DEBUGMESS((ctx, "Successfully read object %d @ %" FZ_FMT_OFF " - and found page %d!", num, numofs, doc->linear_page_num));
 			if (!entry->obj)
 				entry->obj = pdf_keep_obj(ctx, *page);
 
@@ -1764,7 +1778,7 @@ pdf_obj_read(fz_context *ctx, pdf_document *doc, int *offset, int *nump, pdf_obj
 		}
 		else
 		{
-			DEBUGMESS((ctx, "Successfully read object %d @ %d", num, numofs));
+			DEBUGMESS((ctx, "Successfully read object %d @ %" FZ_FMT_OFF, num, numofs));
 		}
 		entry->type = 'n';
 		entry->gen = 0;
@@ -1800,7 +1814,7 @@ pdf_load_hinted_page(fz_context *ctx, pdf_document *doc, int pagenum)
 	{
 		int num = doc->hint_page[pagenum].number;
 		pdf_obj *page = pdf_load_object(ctx, doc, num, 0);
-		if (!strcmp("Page", pdf_to_name(ctx, pdf_dict_gets(ctx, page, "Type"))))
+		if (!strcmp("Page", pdf_to_name(ctx, pdf_dict_get(ctx, page, PDF_NAME(Type)))))
 		{
 			/* We have found the page object! */
 			DEBUGMESS((ctx, "LoadHintedPage pagenum=%d num=%d", pagenum, num));
@@ -1823,8 +1837,8 @@ read_hinted_object(fz_context *ctx, pdf_document *doc, int num)
 	 * object <= the one we want that has a hint and read forward from
 	 * there. */
 	int expected = num;
-	int curr_pos;
-	int start, offset;
+	fz_off_t curr_pos;
+	fz_off_t start, offset;
 
 	while (doc->hint_obj_offsets[expected] == 0 && expected > 0)
 		expected--;
@@ -1846,9 +1860,9 @@ read_hinted_object(fz_context *ctx, pdf_document *doc, int num)
 		do
 		{
 			start = offset;
-			DEBUGMESS((ctx, "Searching for object %d @ %d", expected, offset));
+			DEBUGMESS((ctx, "Searching for object %d @ %" FZ_FMT_OFF, expected, offset));
 			pdf_obj_read(ctx, doc, &offset, &found, 0);
-			DEBUGMESS((ctx, "Found object %d - next will be @ %d", found, offset));
+			DEBUGMESS((ctx, "Found object %d - next will be @ %" FZ_FMT_OFF, found, offset));
 			if (found <= expected)
 			{
 				/* We found the right one (or one earlier than
@@ -2189,7 +2203,7 @@ pdf_meta(fz_context *ctx, pdf_document *doc, int key, void *ptr, int size)
 	}
 	case FZ_META_INFO:
 	{
-		pdf_obj *info = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Info");
+		pdf_obj *info = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Info));
 		if (!info)
 		{
 			if (ptr)
@@ -2283,7 +2297,7 @@ pdf_open_document_no_run(fz_context *ctx, const char *filename)
 
 	fz_try(ctx)
 	{
-		file = fz_open_file(ctx, filename);
+		file = fz_open_file_mapped(ctx, filename);
 		doc = pdf_new_document(ctx, file);
 		pdf_init_document(ctx, doc);//交叉引用表、版本信息、PDF版本信息、root对象、ocg什么的
         
@@ -2312,13 +2326,15 @@ pdf_load_hints(fz_context *ctx, pdf_document *doc, int objnum, int gennum)
 	fz_try(ctx)
 	{
 		int i, j, least_num_page_objs, page_obj_num_bits;
+		fz_off_t pos;
 		int least_page_len, page_len_num_bits, shared_hint_offset;
 		/* int least_page_offset, page_offset_num_bits; */
 		/* int least_content_stream_len, content_stream_len_num_bits; */
 		int num_shared_obj_num_bits, shared_obj_num_bits;
 		/* int numerator_bits, denominator_bits; */
 		int shared;
-		int shared_obj_num, shared_obj_offset, shared_obj_count_page1;
+		int shared_obj_num, shared_obj_count_page1;
+		fz_off_t shared_obj_offset;
 		int shared_obj_count_total;
 		int least_shared_group_len, shared_group_len_num_bits;
 		int max_object_num = pdf_xref_len(ctx, doc);
@@ -2328,7 +2344,7 @@ pdf_load_hints(fz_context *ctx, pdf_document *doc, int objnum, int gennum)
 		if (dict == NULL || !pdf_is_dict(ctx, dict))
 			fz_throw(ctx, FZ_ERROR_GENERIC, "malformed hint object");
 
-		shared_hint_offset = pdf_to_int(ctx, pdf_dict_gets(ctx, dict, "S"));
+		shared_hint_offset = pdf_to_int(ctx, pdf_dict_get(ctx, dict, PDF_NAME(S)));
 
 		/* Malloc the structures (use realloc to cope with the fact we
 		 * may try this several times before enough data is loaded) */
@@ -2374,18 +2390,18 @@ pdf_load_hints(fz_context *ctx, pdf_document *doc, int objnum, int gennum)
 		doc->hint_page[i].number = j; /* Not a real page object */
 		fz_sync_bits(ctx, stream);
 		/* Item 2: Page lengths */
-		j = doc->hint_page[0].offset;
+		pos = doc->hint_page[0].offset;
 		for (i = 0; i < doc->page_count; i++)
 		{
 			int delta_page_len = fz_read_bits(ctx, stream, page_len_num_bits);
-			int old = j;
+			fz_off_t old = pos;
 
-			doc->hint_page[i].offset = j;
-			j += least_page_len + delta_page_len;
-			if (old <= doc->hint_object_offset && j > doc->hint_object_offset)
-				j += doc->hint_object_length;
+			doc->hint_page[i].offset = pos;
+			pos += least_page_len + delta_page_len;
+			if (old <= doc->hint_object_offset && pos > doc->hint_object_offset)
+				pos += doc->hint_object_length;
 		}
-		doc->hint_page[i].offset = j;
+		doc->hint_page[i].offset = pos;
 		fz_sync_bits(ctx, stream);
 		/* Item 3: Shared references */
 		shared = 0;
@@ -2434,30 +2450,30 @@ pdf_load_hints(fz_context *ctx, pdf_document *doc, int objnum, int gennum)
 		memset(doc->hint_shared, 0, sizeof(*doc->hint_shared) * (shared_obj_count_total+1));
 
 		/* Item 1: Shared references */
-		j = doc->hint_page[0].offset;
+		pos = doc->hint_page[0].offset;
 		for (i = 0; i < shared_obj_count_page1; i++)
 		{
 			int off = fz_read_bits(ctx, stream, shared_group_len_num_bits);
-			int old = j;
-			doc->hint_shared[i].offset = j;
-			j += off + least_shared_group_len;
-			if (old <= doc->hint_object_offset && j > doc->hint_object_offset)
-				j += doc->hint_object_length;
+			fz_off_t old = pos;
+			doc->hint_shared[i].offset = pos;
+			pos += off + least_shared_group_len;
+			if (old <= doc->hint_object_offset && pos > doc->hint_object_offset)
+				pos += doc->hint_object_length;
 		}
 		/* FIXME: We would have problems recreating the length of the
 		 * last page 1 shared reference group. But we'll never need
 		 * to, so ignore it. */
-		j = shared_obj_offset;
+		pos = shared_obj_offset;
 		for (; i < shared_obj_count_total; i++)
 		{
 			int off = fz_read_bits(ctx, stream, shared_group_len_num_bits);
-			int old = j;
-			doc->hint_shared[i].offset = j;
-			j += off + least_shared_group_len;
-			if (old <= doc->hint_object_offset && j > doc->hint_object_offset)
-				j += doc->hint_object_length;
+			fz_off_t old = pos;
+			doc->hint_shared[i].offset = pos;
+			pos += off + least_shared_group_len;
+			if (old <= doc->hint_object_offset && pos > doc->hint_object_offset)
+				pos += doc->hint_object_length;
 		}
-		doc->hint_shared[i].offset = j;
+		doc->hint_shared[i].offset = pos;
 		fz_sync_bits(ctx, stream);
 		/* Item 2: Signature flags: read these just so we can skip */
 		for (i = 0; i < shared_obj_count_total; i++)
@@ -2520,7 +2536,7 @@ static void
 pdf_load_hint_object(fz_context *ctx, pdf_document *doc)
 {
 	pdf_lexbuf *buf = &doc->lexbuf.base;
-	int curr_pos;
+	fz_off_t curr_pos;
 
 	curr_pos = fz_tell(ctx, doc->file);
 	fz_seek(ctx, doc->file, doc->hint_object_offset, SEEK_SET);
@@ -2529,7 +2545,8 @@ pdf_load_hint_object(fz_context *ctx, pdf_document *doc)
 		while (1)
 		{
 			pdf_obj *page = NULL;
-			int tmpofs, num, gen, tok;
+			fz_off_t tmpofs;
+			int num, gen, tok;
 
 			tok = pdf_lex(ctx, doc->file, buf);
 			if (tok != PDF_TOK_INT)
@@ -2559,7 +2576,7 @@ pdf_load_hint_object(fz_context *ctx, pdf_document *doc)
 pdf_obj *pdf_progressive_advance(fz_context *ctx, pdf_document *doc, int pagenum)
 {
 	pdf_lexbuf *buf = &doc->lexbuf.base;
-	int curr_pos;
+	fz_off_t curr_pos;
 	pdf_obj *page;
 
 	pdf_load_hinted_page(ctx, doc, pagenum);
@@ -2577,7 +2594,7 @@ pdf_obj *pdf_progressive_advance(fz_context *ctx, pdf_document *doc, int pagenum
 		pdf_load_hint_object(ctx, doc);
 	}
 
-	DEBUGMESS((ctx, "continuing to try to advance from %d", doc->linear_pos));
+	DEBUGMESS((ctx, "continuing to try to advance from %" FZ_FMT_OFF, doc->linear_pos));
 	curr_pos = fz_tell(ctx, doc->file);
 
 	fz_var(page);
@@ -2600,8 +2617,8 @@ pdf_obj *pdf_progressive_advance(fz_context *ctx, pdf_document *doc, int pagenum
 			pdf_obj *pages;
 			doc->linear_pos = doc->file_length;
 			pdf_load_xref(ctx, doc, buf);
-			catalog = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "Root");
-			pages = pdf_dict_gets(ctx, catalog, "Pages");
+			catalog = pdf_dict_get(ctx, pdf_trailer(ctx, doc), PDF_NAME(Root));
+			pages = pdf_dict_get(ctx, catalog, PDF_NAME(Pages));
 
 			if (!pdf_is_dict(ctx, pages))
 				fz_throw(ctx, FZ_ERROR_GENERIC, "missing page tree");
@@ -2656,19 +2673,19 @@ pdf_document *pdf_create_document(fz_context *ctx)
 		pdf_get_populating_xref_entry(ctx, doc, 0);
 		doc->xref_altered = 1;
 		trailer = pdf_new_dict(ctx, doc, 2);
-		pdf_dict_puts_drop(ctx, trailer, "Size", pdf_new_int(ctx, doc, 3));
+		pdf_dict_put_drop(ctx, trailer, PDF_NAME(Size), pdf_new_int(ctx, doc, 3));
 		o = root = pdf_new_dict(ctx, doc, 2);
-		pdf_dict_puts_drop(ctx, trailer, "Root", pdf_new_ref(ctx, doc, o));
+		pdf_dict_put_drop(ctx, trailer, PDF_NAME(Root), pdf_new_ref(ctx, doc, o));
 		pdf_drop_obj(ctx, o);
 		o = NULL;
-		pdf_dict_puts_drop(ctx, root, "Type", pdf_new_name(ctx, doc, "Catalog"));
+		pdf_dict_put_drop(ctx, root, PDF_NAME(Type), pdf_new_name(ctx, doc, "Catalog"));
 		o = pages = pdf_new_dict(ctx, doc, 3);
-		pdf_dict_puts_drop(ctx, root, "Pages", pdf_new_ref(ctx, doc, o));
+		pdf_dict_put_drop(ctx, root, PDF_NAME(Pages), pdf_new_ref(ctx, doc, o));
 		pdf_drop_obj(ctx, o);
 		o = NULL;
-		pdf_dict_puts_drop(ctx, pages, "Type", pdf_new_name(ctx, doc, "Pages"));
-		pdf_dict_puts_drop(ctx, pages, "Count", pdf_new_int(ctx, doc, 0));
-		pdf_dict_puts_drop(ctx, pages, "Kids", pdf_new_array(ctx, doc, 1));
+		pdf_dict_put_drop(ctx, pages, PDF_NAME(Type), pdf_new_name(ctx, doc, "Pages"));
+		pdf_dict_put_drop(ctx, pages, PDF_NAME(Count), pdf_new_int(ctx, doc, 0));
+		pdf_dict_put_drop(ctx, pages, PDF_NAME(Kids), pdf_new_array(ctx, doc, 1));
 		pdf_set_populating_xref_trailer(ctx, doc, trailer);
 		pdf_drop_obj(ctx, trailer);
 	}
@@ -12,6 +12,190 @@
 #include <sys/time.h>
 #endif
 
+#ifndef DISABLE_MUTHREADS
+#ifdef _WIN32
+#include <windows.h>
+
+typedef struct { HANDLE handle; } mu_semaphore;
+typedef struct { HANDLE handle; } mu_thread;
+typedef struct { CRITICAL_SECTION mutex; } mu_mutex;
+typedef struct { CONDITION_VARIABLE cond; } mu_cond;
+
+static int mu_create_semaphore(mu_semaphore *sem)
+{
+	sem->handle = CreateSemaphore(NULL, 0, 1, NULL);
+	return (sem->handle == NULL);
+}
+
+static void mu_destroy_semaphore(mu_semaphore *sem)
+{
+	CloseHandle(sem->handle);
+}
+
+static void mu_wait_semaphore(mu_semaphore *sem)
+{
+	WaitForSingleObject(sem->handle, INFINITE);
+}
+
+static void mu_trigger_semaphore(mu_semaphore *sem)
+{
+	ReleaseSemaphore(sem->handle, 1, NULL);
+}
+
+typedef DWORD (WINAPI mu_thread_fn)(LPVOID arg);
+
+static int mu_create_thread(mu_thread *th, mu_thread_fn *fn, void *arg)
+{
+	th->handle = CreateThread(NULL, 0, fn, arg, 0, NULL);
+	return (th->handle == NULL);
+}
+
+static void mu_destroy_thread(mu_thread *th)
+{
+	WaitForSingleObject(th->handle, INFINITE);
+	CloseHandle(th->handle);
+}
+
+static int mu_create_mutex(mu_mutex *mutex)
+{
+	InitializeCriticalSection(&mutex->mutex);
+	return 0;
+}
+
+static void mu_destroy_mutex(mu_mutex *mutex)
+{
+	DeleteCriticalSection(&mutex->mutex);
+}
+
+static void mu_lock_mutex(mu_mutex *mutex)
+{
+	EnterCriticalSection(&mutex->mutex);
+}
+
+static void mu_unlock_mutex(mu_mutex *mutex)
+{
+	LeaveCriticalSection(&mutex->mutex);
+}
+
+static int mu_create_cond(mu_cond *cond)
+{
+	InitializeConditionVariable(&cond->cond);
+	return 0;
+}
+
+static void mu_destroy_cond(mu_cond *cond)
+{
+}
+
+static void mu_wait_cond(mu_cond *cond, mu_mutex *mutex)
+{
+	SleepConditionVariableCS(&cond->cond, &mutex->mutex, INFINITE);
+}
+
+static void mu_wake_cond(mu_cond *cond)
+{
+	WakeAllConditionVariable(&cond->cond);
+}
+#else
+#include <pthread.h>
+
+/* Unnamed POSIX semaphores are not available on Darwin, so build
+ * our own from a mutex and a condition variable. */
+typedef struct { pthread_mutex_t mutex; pthread_cond_t cond; int count; } mu_semaphore;
+typedef struct { pthread_t thread; } mu_thread;
+typedef struct { pthread_mutex_t mutex; } mu_mutex;
+typedef struct { pthread_cond_t cond; } mu_cond;
+
+static int mu_create_semaphore(mu_semaphore *sem)
+{
+	sem->count = 0;
+	if (pthread_mutex_init(&sem->mutex, NULL))
+		return 1;
+	if (pthread_cond_init(&sem->cond, NULL))
+	{
+		pthread_mutex_destroy(&sem->mutex);
+		return 1;
+	}
+	return 0;
+}
+
+static void mu_destroy_semaphore(mu_semaphore *sem)
+{
+	pthread_cond_destroy(&sem->cond);
+	pthread_mutex_destroy(&sem->mutex);
+}
+
+static void mu_wait_semaphore(mu_semaphore *sem)
+{
+	pthread_mutex_lock(&sem->mutex);
+	while (sem->count == 0)
+		pthread_cond_wait(&sem->cond, &sem->mutex);
+	sem->count--;
+	pthread_mutex_unlock(&sem->mutex);
+}
+
+static void mu_trigger_semaphore(mu_semaphore *sem)
+{
+	pthread_mutex_lock(&sem->mutex);
+	sem->count++;
+	pthread_cond_signal(&sem->cond);
+	pthread_mutex_unlock(&sem->mutex);
+}
+
+typedef void *(mu_thread_fn)(void *arg);
+
+static int mu_create_thread(mu_thread *th, mu_thread_fn *fn, void *arg)
+{
+	return pthread_create(&th->thread, NULL, fn, arg);
+}
+
+static void mu_destroy_thread(mu_thread *th)
+{
+	pthread_join(th->thread, NULL);
+}
+
+static int mu_create_mutex(mu_mutex *mutex)
+{
+	return pthread_mutex_init(&mutex->mutex, NULL);
+}
+
+static void mu_destroy_mutex(mu_mutex *mutex)
+{
+	pthread_mutex_destroy(&mutex->mutex);
+}
+
+static void mu_lock_mutex(mu_mutex *mutex)
+{
+	pthread_mutex_lock(&mutex->mutex);
+}
+
+static void mu_unlock_mutex(mu_mutex *mutex)
+{
+	pthread_mutex_unlock(&mutex->mutex);
+}
+
+static int mu_create_cond(mu_cond *cond)
+{
+	return pthread_cond_init(&cond->cond, NULL);
+}
+
+static void mu_destroy_cond(mu_cond *cond)
+{
+	pthread_cond_destroy(&cond->cond);
+}
+
+static void mu_wait_cond(mu_cond *cond, mu_mutex *mutex)
+{
+	pthread_cond_wait(&cond->cond, &mutex->mutex);
+}
+
+static void mu_wake_cond(mu_cond *cond)
+{
+	pthread_cond_broadcast(&cond->cond);
+}
+#endif
+#endif /* DISABLE_MUTHREADS */
+
 enum { TEXT_PLAIN = 1, TEXT_HTML = 2, TEXT_XML = 3 };
 
 enum { OUT_PNG, OUT_PPM, OUT_PNM, OUT_PAM, OUT_PGM, OUT_PBM, OUT_SVG, OUT_PWG, OUT_PCL, OUT_PDF, OUT_TGA };
@@ -107,6 +291,7 @@ static pdf_document *pdfout = NULL;
 static int showoutline = 0;
 static int uselist = 1;
 static int alphabits = 8;
+static int scan_converter = FZ_SCAN_CONVERTER_GEL;
 static float gamma_value = 1;
 static int invert = 0;
 static int width = 0;
@@ -118,11 +303,23 @@ static int output_format;
 static int append = 0;
 static int out_cs = CS_UNSET;
 static int bandheight = 0;
+static int num_workers = 0;
 static int memtrace_current = 0;
 static int memtrace_peak = 0;
 static int memtrace_total = 0;
 static int showmemory = 0;
 static int showfeatures = 0;
+
+#ifndef DISABLE_MUTHREADS
+/* The allocator is called without any fitz lock held, so the counters
+ * above need a lock of their own once worker threads are running. */
+static mu_mutex memtrace_mutex;
+#define memtrace_lock() mu_lock_mutex(&memtrace_mutex)
+#define memtrace_unlock() mu_unlock_mutex(&memtrace_mutex)
+#else
+#define memtrace_lock() do { } while (0)
+#define memtrace_unlock() do { } while (0)
+#endif
 static fz_text_sheet *sheet = NULL;
 static fz_colorspace *colorspace;
 static char *filename;
@@ -151,7 +348,9 @@ static void usage(void)
 		"\t-f -\tfit width and/or height exactly (ignore aspect)\n"
 		"\t-c -\tcolorspace {mono,gray,grayalpha,rgb,rgba,cmyk,cmykalpha}\n"
 		"\t-b -\tnumber of bits of antialiasing (0 to 8)\n"
+		"\t-C -\tscan converter for antialiasing {gel,cells}\n"
 		"\t-B -\tmaximum bandheight (pgm, ppm, pam output only)\n"
+		"\t-T -\tnumber of threads to render bands and pages with\n"
 		"\t-g\trender in grayscale (equivalent to: -c gray)\n"
 		"\t-m\tshow timing information\n"
 		"\t-M\tshow memory use summary\n"
@@ -163,7 +362,7 @@ static void usage(void)
 		"\t-G -\tgamma correct output\n"
 		"\t-I\tinvert output\n"
 		"\t-l\tprint outline\n"
-		"\t-T\ttest for features (grayscale or color)\n"
+		"\t-e\ttest for features (grayscale or color)\n"
 		"\t-i\tignore errors and continue with the next file\n"
 		"\tpages\tcomma separated list of ranges\n");
 	exit(1);
@@ -194,6 +393,506 @@ static int isrange(char *s)
 	return 1;
 }
 
+static void render_band(fz_context *ctx, fz_page *page, fz_display_list *list, fz_pixmap *pix, const fz_matrix *ctm, const fz_rect *tbounds, fz_cookie *cookie, int savealpha)
+{
+	fz_device *dev = NULL;
+
+	fz_var(dev);
+
+	if (savealpha)
+		fz_clear_pixmap(ctx, pix);
+	else
+		fz_clear_pixmap_with_value(ctx, pix, 255);
+
+	fz_try(ctx)
+	{
+		dev = fz_new_draw_device(ctx, pix);
+		if (alphabits == 0)
+			fz_enable_device_hints(ctx, dev, FZ_DONT_INTERPOLATE_IMAGES);
+		if (list)
+			fz_run_display_list(ctx, list, dev, ctm, tbounds, cookie);
+		else
+			fz_run_page(ctx, page, dev, ctm, cookie);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_device(ctx, dev);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
+
+	if (invert)
+		fz_invert_pixmap(ctx, pix);
+	if (gamma_value != 1)
+		fz_gamma_pixmap(ctx, pix, gamma_value);
+
+	if (savealpha)
+		fz_unmultiply_pixmap(ctx, pix);
+}
+
+static void output_band(fz_context *ctx, fz_output *output_file, fz_png_output_context *poc, char *filename_buf, fz_pixmap *pix, int totalheight, int band, int drawheight, int savealpha)
+{
+	if (output_format == OUT_PGM || output_format == OUT_PPM || output_format == OUT_PNM)
+		fz_output_pnm_band(ctx, output_file, pix->w, totalheight, pix->n, band, drawheight, pix->samples);
+	else if (output_format == OUT_PAM)
+		fz_output_pam_band(ctx, output_file, pix->w, totalheight, pix->n, band, drawheight, pix->samples, savealpha);
+	else if (output_format == OUT_PNG)
+		fz_output_png_band(ctx, output_file, pix->w, totalheight, pix->n, band, drawheight, pix->samples, savealpha, poc);
+	else if (output_format == OUT_PWG)
+	{
+		if (strstr(output, "%d") != NULL)
+			append = 0;
+		if (out_cs == CS_MONO)
+		{
+			fz_bitmap *bit = fz_halftone_pixmap(ctx, pix, NULL);
+			fz_write_pwg_bitmap(ctx, bit, filename_buf, append, NULL);
+			fz_drop_bitmap(ctx, bit);
+		}
+		else
+			fz_write_pwg(ctx, pix, filename_buf, append, NULL);
+		append = 1;
+	}
+	else if (output_format == OUT_PCL)
+	{
+		fz_pcl_options options;
+
+		fz_pcl_preset(ctx, &options, "ljet4");
+
+		if (strstr(output, "%d") != NULL)
+			append = 0;
+		if (out_cs == CS_MONO)
+		{
+			fz_bitmap *bit = fz_halftone_pixmap(ctx, pix, NULL);
+			fz_write_pcl_bitmap(ctx, bit, filename_buf, append, &options);
+			fz_drop_bitmap(ctx, bit);
+		}
+		else
+			fz_write_pcl(ctx, pix, filename_buf, append, &options);
+		append = 1;
+	}
+	else if (output_format == OUT_PBM) {
+		fz_bitmap *bit = fz_halftone_pixmap(ctx, pix, NULL);
+		fz_write_pbm(ctx, bit, filename_buf);
+		fz_drop_bitmap(ctx, bit);
+	}
+	else if (output_format == OUT_TGA)
+	{
+		fz_write_tga(ctx, pix, filename_buf, savealpha);
+	}
+}
+
+static fz_output *open_output(fz_context *ctx, char *filename_buf, int pagenum, int w, int totalheight, int n, int savealpha, fz_png_output_context **poc)
+{
+	fz_output *output_file;
+
+	if (!strcmp(output, "-"))
+		output_file = fz_new_output_with_file(ctx, stdout, 0);
+	else
+	{
+		sprintf(filename_buf, output, pagenum);
+		output_file = fz_new_output_to_filename(ctx, filename_buf);
+	}
+
+	fz_try(ctx)
+	{
+		if (output_format == OUT_PGM || output_format == OUT_PPM || output_format == OUT_PNM)
+			fz_output_pnm_header(ctx, output_file, w, totalheight, n);
+		else if (output_format == OUT_PAM)
+			fz_output_pam_header(ctx, output_file, w, totalheight, n, savealpha);
+		else if (output_format == OUT_PNG)
+			*poc = fz_output_png_header(ctx, output_file, w, totalheight, n, savealpha);
+	}
+	fz_catch(ctx)
+	{
+		fz_drop_output(ctx, output_file);
+		fz_rethrow(ctx);
+	}
+
+	return output_file;
+}
+
+#ifndef DISABLE_MUTHREADS
+
+/*
+	Threaded rendering. The main thread loads each page and records
+	it into a display list as usual, then hands the bands of the page
+	(or the whole page, when not banding) to a ring of workers, each
+	with a cloned context. Jobs are retired in the order they were
+	issued, so bands and pages are written exactly as in the serial
+	case; the main thread only blocks when the oldest job in the ring
+	is still being drawn.
+
+	Besides the workers, as many helper threads run the pieces that
+	fitz splits large conversions and scalings into (see
+	fz_set_task_runner). The thread asking for the pieces runs them
+	too, so a batch finishes even while every helper is busy.
+*/
+
+typedef struct render_page_s render_page_t;
+typedef struct render_worker_s render_worker_t;
+typedef struct task_batch_s task_batch_t;
+
+struct render_page_s
+{
+	fz_display_list *list;
+	fz_output *output_file;
+	fz_png_output_context *poc;
+	char filename_buf[512];
+	int pagenum;
+	int width;
+	int totalheight;
+	int drawheight;
+	int savealpha;
+	int pending;
+	int complete;
+};
+
+struct render_worker_s
+{
+	fz_context *ctx;
+	render_page_t *page;
+	int band;
+	fz_matrix ctm;
+	fz_rect tbounds;
+	fz_pixmap *pix;
+	fz_cookie cookie;
+	int failed;
+	int quit;
+	mu_semaphore start;
+	mu_semaphore stop;
+	mu_thread thread;
+};
+
+struct task_batch_s
+{
+	void (*task)(void *arg, int i);
+	void *arg;
+	int count;
+	int next; /* first piece not yet claimed */
+	int done; /* pieces finished */
+	task_batch_t *link;
+};
+
+static mu_mutex mutexes[FZ_LOCK_MAX];
+static mu_cond conds[FZ_LOCK_MAX];
+static render_worker_t *workers = NULL;
+static int next_worker = 0;
+
+static mu_mutex task_mutex;
+static mu_cond task_ready;
+static mu_cond task_done;
+static task_batch_t *task_queue = NULL;
+static mu_thread *task_threads = NULL;
+static int task_quit = 0;
+
+static void mudraw_lock(void *user, int lock)
+{
+	mu_lock_mutex(&mutexes[lock]);
+}
+
+static void mudraw_unlock(void *user, int lock)
+{
+	mu_unlock_mutex(&mutexes[lock]);
+}
+
+static fz_locks_context mudraw_locks =
+{
+	NULL, mudraw_lock, mudraw_unlock
+};
+
+static void mudraw_wait(void *user, int lock)
+{
+	mu_wait_cond(&conds[lock], &mutexes[lock]);
+}
+
+static void mudraw_wake(void *user, int lock)
+{
+	mu_wake_cond(&conds[lock]);
+}
+
+static fz_waiter mudraw_waiter =
+{
+	NULL, mudraw_wait, mudraw_wake
+};
+
+/* Run the unclaimed pieces of a batch, with task_mutex held. The batch
+ * may be gone once its last piece is counted as done. */
+static void run_task_pieces(task_batch_t *b)
+{
+	task_batch_t **pp;
+	int i;
+
+	while (b->next < b->count)
+	{
+		i = b->next++;
+		if (b->next == b->count)
+		{
+			for (pp = &task_queue; *pp != b; pp = &(*pp)->link)
+				;
+			*pp = b->link;
+		}
+
+		mu_unlock_mutex(&task_mutex);
+		b->task(b->arg, i);
+		mu_lock_mutex(&task_mutex);
+
+		if (++b->done == b->count)
+		{
+			mu_wake_cond(&task_done);
+			return;
+		}
+	}
+}
+
+static void mudraw_run_tasks(void *user, int count, void (*task)(void *arg, int i), void *arg)
+{
+	task_batch_t b, **pp;
+
+	b.task = task;
+	b.arg = arg;
+	b.count = count;
+	b.next = 0;
+	b.done = 0;
+	b.link = NULL;
+
+	mu_lock_mutex(&task_mutex);
+	for (pp = &task_queue; *pp; pp = &(*pp)->link)
+		;
+	*pp = &b;
+	mu_wake_cond(&task_ready);
+	run_task_pieces(&b);
+	while (b.done < b.count)
+		mu_wait_cond(&task_done, &task_mutex);
+	mu_unlock_mutex(&task_mutex);
+}
+
+static fz_task_runner mudraw_tasks =
+{
+	NULL, mudraw_run_tasks
+};
+
+#ifdef _WIN32
+static DWORD WINAPI task_starter(LPVOID arg)
+#else
+static void *task_starter(void *arg)
+#endif
+{
+	mu_lock_mutex(&task_mutex);
+	for (;;)
+	{
+		while (task_queue == NULL && !task_quit)
+			mu_wait_cond(&task_ready, &task_mutex);
+		if (task_queue == NULL)
+			break;
+		run_task_pieces(task_queue);
+	}
+	mu_unlock_mutex(&task_mutex);
+
+	return 0;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_starter(LPVOID arg)
+#else
+static void *thread_starter(void *arg)
+#endif
+{
+	render_worker_t *w = (render_worker_t *)arg;
+
+	for (;;)
+	{
+		mu_wait_semaphore(&w->start);
+		if (w->quit)
+			break;
+
+		fz_try(w->ctx)
+		{
+			render_band(w->ctx, NULL, w->page->list, w->pix, &w->ctm, &w->tbounds, &w->cookie, w->page->savealpha);
+		}
+		fz_catch(w->ctx)
+		{
+			fz_warn(w->ctx, "cannot draw band %d: %s", w->band, fz_caught_message(w->ctx));
+			w->failed = 1;
+		}
+		fz_flush_warnings(w->ctx);
+
+		mu_trigger_semaphore(&w->stop);
+	}
+
+	return 0;
+}
+
+static void finish_render_page(fz_context *ctx, render_page_t *rp)
+{
+	fz_try(ctx)
+	{
+		if (rp->output_file && output_format == OUT_PNG)
+			fz_output_png_trailer(ctx, rp->output_file, rp->poc);
+	}
+	fz_always(ctx)
+	{
+		if (rp->output_file)
+			fz_drop_output(ctx, rp->output_file);
+		fz_drop_display_list(ctx, rp->list);
+		fz_free(ctx, rp);
+	}
+	fz_catch(ctx)
+	{
+		fz_warn(ctx, "cannot finish output: %s", fz_caught_message(ctx));
+		errored = 1;
+	}
+}
+
+/* Wait for the worker's job (if any), and write out its band. */
+static void retire_worker(fz_context *ctx, render_worker_t *w)
+{
+	render_page_t *rp = w->page;
+
+	if (rp == NULL)
+		return;
+
+	mu_wait_semaphore(&w->stop);
+	w->page = NULL;
+
+	if (w->failed || w->cookie.errors)
+		errored = 1;
+
+	fz_try(ctx)
+	{
+		/* Open the output only once the page's first band is
+		 * retired, so that files are created in page order. */
+		if (output && w->band == 0)
+			rp->output_file = open_output(ctx, rp->filename_buf, rp->pagenum, rp->width, rp->totalheight, w->pix->n, rp->savealpha, &rp->poc);
+		if (rp->output_file && !w->failed)
+			output_band(ctx, rp->output_file, rp->poc, rp->filename_buf, w->pix, rp->totalheight, w->band, rp->drawheight, rp->savealpha);
+	}
+	fz_catch(ctx)
+	{
+		fz_warn(ctx, "cannot write band %d: %s", w->band, fz_caught_message(ctx));
+		errored = 1;
+	}
+
+	if (--rp->pending == 0 && rp->complete)
+		finish_render_page(ctx, rp);
+}
+
+static void flush_workers(fz_context *ctx)
+{
+	int i;
+
+	for (i = 0; i < num_workers; i++)
+		retire_worker(ctx, &workers[(next_worker + i) % num_workers]);
+}
+
+static void dispatch_band(fz_context *ctx, render_page_t *rp, int band, const fz_matrix *ctm, const fz_rect *tbounds, const fz_irect *ibounds)
+{
+	render_worker_t *w = &workers[next_worker];
+
+	retire_worker(ctx, w);
+
+	if (w->pix == NULL || w->pix->colorspace != colorspace ||
+		w->pix->x != ibounds->x0 || w->pix->y != ibounds->y0 ||
+		w->pix->w != ibounds->x1 - ibounds->x0 || w->pix->h != ibounds->y1 - ibounds->y0)
+	{
+		fz_drop_pixmap(ctx, w->pix);
+		w->pix = NULL;
+		w->pix = fz_new_pixmap_with_bbox(ctx, colorspace, ibounds);
+		fz_pixmap_set_resolution(w->pix, resolution);
+	}
+
+	w->page = rp;
+	w->band = band;
+	w->ctm = *ctm;
+	w->tbounds = *tbounds;
+	memset(&w->cookie, 0, sizeof w->cookie);
+	w->failed = 0;
+	rp->pending++;
+
+	mu_trigger_semaphore(&w->start);
+	next_worker = (next_worker + 1) % num_workers;
+}
+
+static void start_workers(fz_context *ctx)
+{
+	int i;
+
+	if (mu_create_mutex(&task_mutex) || mu_create_cond(&task_ready) || mu_create_cond(&task_done))
+	{
+		fprintf(stderr, "cannot create mutex\n");
+		exit(1);
+	}
+	task_threads = fz_calloc(ctx, num_workers, sizeof(*task_threads));
+	for (i = 0; i < num_workers; i++)
+	{
+		if (mu_create_thread(&task_threads[i], task_starter, NULL))
+		{
+			fprintf(stderr, "cannot create helper thread %d\n", i);
+			exit(1);
+		}
+	}
+
+	/* Set before cloning, so that the workers' contexts have it too */
+	fz_set_task_runner(ctx, &mudraw_tasks);
+
+	workers = fz_calloc(ctx, num_workers, sizeof(*workers));
+	for (i = 0; i < num_workers; i++)
+	{
+		render_worker_t *w = &workers[i];
+		w->ctx = fz_clone_context(ctx);
+		if (w->ctx == NULL || mu_create_semaphore(&w->start) || mu_create_semaphore(&w->stop) || mu_create_thread(&w->thread, thread_starter, w))
+		{
+			fprintf(stderr, "cannot create worker thread %d\n", i);
+			exit(1);
+		}
+	}
+}
+
+static void stop_workers(fz_context *ctx)
+{
+	int i;
+
+	if (workers == NULL)
+		return;
+
+	flush_workers(ctx);
+	for (i = 0; i < num_workers; i++)
+	{
+		render_worker_t *w = &workers[i];
+		w->quit = 1;
+		mu_trigger_semaphore(&w->start);
+		mu_destroy_thread(&w->thread);
+		mu_destroy_semaphore(&w->start);
+		mu_destroy_semaphore(&w->stop);
+		fz_drop_pixmap(ctx, w->pix);
+		fz_drop_context(w->ctx);
+	}
+	fz_free(ctx, workers);
+	workers = NULL;
+
+	fz_set_task_runner(ctx, NULL);
+	mu_lock_mutex(&task_mutex);
+	task_quit = 1;
+	mu_wake_cond(&task_ready);
+	mu_unlock_mutex(&task_mutex);
+	for (i = 0; i < num_workers; i++)
+		mu_destroy_thread(&task_threads[i]);
+	fz_free(ctx, task_threads);
+	task_threads = NULL;
+	mu_destroy_cond(&task_done);
+	mu_destroy_cond(&task_ready);
+	mu_destroy_mutex(&task_mutex);
+}
+
+#else
+
+static void flush_workers(fz_context *ctx)
+{
+}
+
+#endif /* DISABLE_MUTHREADS */
+
 static void drawpage(fz_context *ctx, fz_document *doc, int pagenum)
 {
 	fz_page *page;
@@ -437,9 +1136,15 @@ static void drawpage(fz_context *ctx, fz_document *doc, int pagenum)
 		int w, h;
 		fz_output *output_file = NULL;
 		fz_png_output_context *poc = NULL;
+#ifndef DISABLE_MUTHREADS
+		render_page_t *rp = NULL;
+
+		fz_var(rp);
+#endif
 
 		fz_var(pix);
 		fz_var(poc);
+		fz_var(output_file);
 
 		fz_bound_page(ctx, page, &bounds);
 		zoom = resolution / 72;
@@ -521,103 +1226,39 @@ static void drawpage(fz_context *ctx, fz_document *doc, int pagenum)
 				tbounds.y1 = tbounds.y0 + bandheight + 2;
 			}
 
-			pix = fz_new_pixmap_with_bbox(ctx, colorspace, &band_ibounds);
-			fz_pixmap_set_resolution(pix, resolution);
-
-			if (output)
+#ifndef DISABLE_MUTHREADS
+			if (workers)
 			{
-				if (!strcmp(output, "-"))
-					output_file = fz_new_output_with_file(ctx, stdout, 0);
-				else
+				rp = fz_malloc_struct(ctx, render_page_t);
+				rp->list = fz_keep_display_list(ctx, list);
+				rp->pagenum = pagenum;
+				rp->width = band_ibounds.x1 - band_ibounds.x0;
+				rp->totalheight = totalheight;
+				rp->drawheight = drawheight;
+				rp->savealpha = savealpha;
+
+				for (band = 0; band < bands; band++)
 				{
-					sprintf(filename_buf, output, pagenum);
-					output_file = fz_new_output_to_filename(ctx, filename_buf);
+					dispatch_band(ctx, rp, band, &ctm, &tbounds, &band_ibounds);
+					ctm.f -= drawheight;
 				}
-
-				if (output_format == OUT_PGM || output_format == OUT_PPM || output_format == OUT_PNM)
-					fz_output_pnm_header(ctx, output_file, pix->w, totalheight, pix->n);
-				else if (output_format == OUT_PAM)
-					fz_output_pam_header(ctx, output_file, pix->w, totalheight, pix->n, savealpha);
-				else if (output_format == OUT_PNG)
-					poc = fz_output_png_header(ctx, output_file, pix->w, totalheight, pix->n, savealpha);
 			}
-
-			for (band = 0; band < bands; band++)
+			else
+#endif
 			{
-				if (savealpha)
-					fz_clear_pixmap(ctx, pix);
-				else
-					fz_clear_pixmap_with_value(ctx, pix, 255);
-
-				dev = fz_new_draw_device(ctx, pix);
-				if (alphabits == 0)
-					fz_enable_device_hints(ctx, dev, FZ_DONT_INTERPOLATE_IMAGES);
-				if (list)
-					fz_run_display_list(ctx, list, dev, &ctm, &tbounds, &cookie);
-				else
-					fz_run_page(ctx, page, dev, &ctm, &cookie);
-				fz_drop_device(ctx, dev);
-				dev = NULL;
-
-				if (invert)
-					fz_invert_pixmap(ctx, pix);
-				if (gamma_value != 1)
-					fz_gamma_pixmap(ctx, pix, gamma_value);
-
-				if (savealpha)
-					fz_unmultiply_pixmap(ctx, pix);
+				pix = fz_new_pixmap_with_bbox(ctx, colorspace, &band_ibounds);
+				fz_pixmap_set_resolution(pix, resolution);
 
 				if (output)
+					output_file = open_output(ctx, filename_buf, pagenum, pix->w, totalheight, pix->n, savealpha, &poc);
+
+				for (band = 0; band < bands; band++)
 				{
-					if (output_format == OUT_PGM || output_format == OUT_PPM || output_format == OUT_PNM)
-						fz_output_pnm_band(ctx, output_file, pix->w, totalheight, pix->n, band, drawheight, pix->samples);
-					else if (output_format == OUT_PAM)
-						fz_output_pam_band(ctx, output_file, pix->w, totalheight, pix->n, band, drawheight, pix->samples, savealpha);
-					else if (output_format == OUT_PNG)
-						fz_output_png_band(ctx, output_file, pix->w, totalheight, pix->n, band, drawheight, pix->samples, savealpha, poc);
-					else if (output_format == OUT_PWG)
-					{
-						if (strstr(output, "%d") != NULL)
-							append = 0;
-						if (out_cs == CS_MONO)
-						{
-							fz_bitmap *bit = fz_halftone_pixmap(ctx, pix, NULL);
-							fz_write_pwg_bitmap(ctx, bit, filename_buf, append, NULL);
-							fz_drop_bitmap(ctx, bit);
-						}
-						else
-							fz_write_pwg(ctx, pix, filename_buf, append, NULL);
-						append = 1;
-					}
-					else if (output_format == OUT_PCL)
-					{
-						fz_pcl_options options;
-
-						fz_pcl_preset(ctx, &options, "ljet4");
-
-						if (strstr(output, "%d") != NULL)
-							append = 0;
-						if (out_cs == CS_MONO)
-						{
-							fz_bitmap *bit = fz_halftone_pixmap(ctx, pix, NULL);
-							fz_write_pcl_bitmap(ctx, bit, filename_buf, append, &options);
-							fz_drop_bitmap(ctx, bit);
-						}
-						else
-							fz_write_pcl(ctx, pix, filename_buf, append, &options);
-						append = 1;
-					}
-					else if (output_format == OUT_PBM) {
-						fz_bitmap *bit = fz_halftone_pixmap(ctx, pix, NULL);
-						fz_write_pbm(ctx, bit, filename_buf);
-						fz_drop_bitmap(ctx, bit);
-					}
-					else if (output_format == OUT_TGA)
-					{
-						fz_write_tga(ctx, pix, filename_buf, savealpha);
-					}
+					render_band(ctx, page, list, pix, &ctm, &tbounds, &cookie, savealpha);
+					if (output)
+						output_band(ctx, output_file, poc, filename_buf, pix, totalheight, band, drawheight, savealpha);
+					ctm.f -= drawheight;
 				}
-				ctm.f -= drawheight;
 			}
 
 			if (showmd5)
@@ -633,14 +1274,22 @@ static void drawpage(fz_context *ctx, fz_document *doc, int pagenum)
 		}
 		fz_always(ctx)
 		{
-			if (output)
+			if (output_file)
 			{
 				if (output_format == OUT_PNG)
 					fz_output_png_trailer(ctx, output_file, poc);
 			}
 
-			fz_drop_device(ctx, dev);
-			dev = NULL;
+#ifndef DISABLE_MUTHREADS
+			/* The last band to be retired closes the output. */
+			if (rp)
+			{
+				rp->complete = 1;
+				if (rp->pending == 0)
+					finish_render_page(ctx, rp);
+			}
+#endif
+
 			fz_drop_pixmap(ctx, pix);
 			if (output_file)
 				fz_drop_output(ctx, output_file);
@@ -687,6 +1336,8 @@ static void drawpage(fz_context *ctx, fz_document *doc, int pagenum)
 	if (showmemory)
 	{
 		fz_dump_glyph_cache_stats(ctx);
+		fz_dump_image_decode_stats(ctx);
+		fz_dump_alloc_arena_stats(ctx);
 	}
 
 	fz_flush_warnings(ctx);
@@ -695,9 +1346,29 @@ static void drawpage(fz_context *ctx, fz_document *doc, int pagenum)
 		errored = 1;
 }
 
+/*
+	Reflowable documents may only estimate their page count until the
+	pages have been loaded. Load the last page we think there is until
+	the count covers the page wanted or stops growing.
+*/
+static int refine_page_count(fz_context *ctx, fz_document *doc, int pagecount, int wanted)
+{
+	int old;
+
+	while (wanted > pagecount && pagecount > 0)
+	{
+		old = pagecount;
+		fz_drop_page(ctx, fz_load_page(ctx, doc, pagecount - 1));
+		pagecount = fz_count_pages(ctx, doc);
+		if (pagecount <= old)
+			break;
+	}
+	return pagecount;
+}
+
 static void drawrange(fz_context *ctx, fz_document *doc, char *range)
 {
-	int page, spage, epage, pagecount;
+	int page, spage, epage, pagecount, to_end;
 	char *spec, *dash;
 
 	pagecount = fz_count_pages(ctx, doc);
@@ -705,6 +1376,7 @@ static void drawrange(fz_context *ctx, fz_document *doc, char *range)
 	while (spec)
 	{
 		dash = strchr(spec, '-');
+		to_end = 0;
 
 		if (dash == spec)
 			spage = epage = pagecount;
@@ -716,15 +1388,26 @@ static void drawrange(fz_context *ctx, fz_document *doc, char *range)
 			if (strlen(dash) > 1)
 				epage = atoi(dash + 1);
 			else
+			{
 				epage = pagecount;
+				to_end = 1;
+			}
 		}
 
+		pagecount = refine_page_count(ctx, doc, pagecount, fz_maxi(spage, epage));
 		spage = fz_clampi(spage, 1, pagecount);
 		epage = fz_clampi(epage, 1, pagecount);
 
-		if (spage < epage)
+		if (spage < epage || to_end)
+		{
 			for (page = spage; page <= epage; page++)
+			{
 				drawpage(ctx, doc, page);
+				/* Reflowable documents may refine their page count as pages are loaded. */
+				if (to_end)
+					epage = pagecount = fz_count_pages(ctx, doc);
+			}
+		}
 		else
 			for (page = spage; page >= epage; page--)
 				drawpage(ctx, doc, page);
@@ -772,6 +1455,17 @@ parse_colorspace(const char *name)
 	exit(1);
 }
 
+static int
+parse_scan_converter(const char *name)
+{
+	if (!strcmp(name, "gel"))
+		return FZ_SCAN_CONVERTER_GEL;
+	if (!strcmp(name, "cells"))
+		return FZ_SCAN_CONVERTER_CELLS;
+	fprintf(stderr, "Unknown scan converter \"%s\"\n", name);
+	exit(1);
+}
+
 static void *
 trace_malloc(void *arg, unsigned int size)
 {
@@ -782,10 +1476,12 @@ trace_malloc(void *arg, unsigned int size)
 	if (p == NULL)
 		return NULL;
 	p[0] = size;
+	memtrace_lock();
 	memtrace_current += size;
 	memtrace_total += size;
 	if (memtrace_current > memtrace_peak)
 		memtrace_peak = memtrace_current;
+	memtrace_unlock();
 	return (void *)&p[1];
 }
 
@@ -796,7 +1492,9 @@ trace_free(void *arg, void *p_)
 
 	if (p == NULL)
 		return;
+	memtrace_lock();
 	memtrace_current -= p[-1];
+	memtrace_unlock();
 	free(&p[-1]);
 }
 
@@ -817,11 +1515,13 @@ trace_realloc(void *arg, void *p_, unsigned int size)
 	p = realloc(&p[-1], size + sizeof(unsigned int));
 	if (p == NULL)
 		return NULL;
+	memtrace_lock();
 	memtrace_current += size - oldsize;
 	if (size > oldsize)
 		memtrace_total += size - oldsize;
 	if (memtrace_current > memtrace_peak)
 		memtrace_peak = memtrace_current;
+	memtrace_unlock();
 	p[0] = size;
 	return &p[1];
 }
@@ -832,11 +1532,13 @@ int mudraw_main(int argc, char **argv)
 	fz_document *doc = NULL;
 	int c;
 	fz_context *ctx;
+	fz_locks_context *locks = NULL;
 	fz_alloc_context alloc_ctx = { NULL, trace_malloc, trace_realloc, trace_free };
 
 	fz_var(doc);
+	fz_var(locks);
 
-	while ((c = fz_getopt(argc, argv, "lo:F:p:r:R:b:c:dgmTtx5G:Iw:h:fiMB:")) != -1)
+	while ((c = fz_getopt(argc, argv, "lo:F:p:r:R:b:C:c:dgmetx5G:Iw:h:fiMB:T:")) != -1)
 	{
 		switch (c)
 		{
@@ -846,14 +1548,16 @@ int mudraw_main(int argc, char **argv)
 		case 'r': resolution = atof(fz_optarg); res_specified = 1; break;
 		case 'R': rotation = atof(fz_optarg); break;
 		case 'b': alphabits = atoi(fz_optarg); break;
+		case 'C': scan_converter = parse_scan_converter(fz_optarg); break;
 		case 'B': bandheight = atoi(fz_optarg); break;
+		case 'T': num_workers = atoi(fz_optarg); break;
 		case 'l': showoutline++; break;
 		case 'm': showtime++; break;
 		case 'M': showmemory++; break;
 		case 't': showtext++; break;
 		case 'x': showxml++; break;
 		case '5': showmd5++; break;
-		case 'T': showfeatures++; break;
+		case 'e': showfeatures++; break;
 		case 'g': out_cs = CS_GRAY; break;
 		case 'd': uselist = 0; break;
 		case 'c': out_cs = parse_colorspace(fz_optarg); break;
@@ -876,7 +1580,53 @@ int mudraw_main(int argc, char **argv)
 		exit(0);
 	}
 
-	ctx = fz_new_context((showmemory == 0 ? NULL : &alloc_ctx), NULL, FZ_STORE_DEFAULT);
+	if (num_workers < 0)
+	{
+		fprintf(stderr, "Number of threads must be >= 0\n");
+		exit(1);
+	}
+
+#ifdef DISABLE_MUTHREADS
+	if (num_workers > 0)
+	{
+		fprintf(stderr, "Threaded rendering not available in this build\n");
+		exit(1);
+	}
+	locks = NULL;
+#else
+	if (num_workers > 0)
+	{
+		int i;
+
+		if (uselist == 0)
+		{
+			fprintf(stderr, "Threaded rendering requires the display list\n");
+			exit(1);
+		}
+		if (showmd5)
+		{
+			fprintf(stderr, "Threaded rendering not compatible with MD5\n");
+			exit(1);
+		}
+
+		for (i = 0; i < FZ_LOCK_MAX; i++)
+		{
+			if (mu_create_mutex(&mutexes[i]) || mu_create_cond(&conds[i]))
+			{
+				fprintf(stderr, "cannot create mutex\n");
+				exit(1);
+			}
+		}
+		locks = &mudraw_locks;
+	}
+	if (showmemory && mu_create_mutex(&memtrace_mutex))
+	{
+		fprintf(stderr, "cannot create mutex\n");
+		exit(1);
+	}
+#endif
+
+	ctx = fz_new_context((showmemory == 0 ? NULL : &alloc_ctx), locks, FZ_STORE_DEFAULT);
 	if (!ctx)
 	{
 		fprintf(stderr, "cannot initialise context\n");
@@ -884,6 +1634,11 @@ int mudraw_main(int argc, char **argv)
 	}
 
 	fz_set_aa_level(ctx, alphabits);
+	fz_set_scan_converter(ctx, scan_converter);
+#ifndef DISABLE_MUTHREADS
+	if (locks)
+		fz_set_waiter(ctx, &mudraw_waiter);
+#endif
 
 	/* Determine output type */
 	if (bandheight < 0)
@@ -992,6 +1747,11 @@ int mudraw_main(int argc, char **argv)
 		pdfout = pdf_create_document(ctx);
 	}
 
+#ifndef DISABLE_MUTHREADS
+	if (num_workers > 0)
+		start_workers(ctx);
+#endif
+
 	timing.count = 0;
 	timing.total = 0;
 	timing.min = 1 << 30;
@@ -1064,6 +1824,8 @@ int mudraw_main(int argc, char **argv)
 						drawrange(ctx, doc, argv[fz_optind++]);
 				}
 
+				flush_workers(ctx);
+
 				if (showxml || showtext == TEXT_XML)
 					fz_printf(ctx, out, "</document>\n");
 
@@ -1072,6 +1834,8 @@ int mudraw_main(int argc, char **argv)
 			}
 			fz_catch(ctx)
 			{
+				flush_workers(ctx);
+
 				if (!ignore_errors)
 					fz_rethrow(ctx);
 
@@ -1083,6 +1847,7 @@ int mudraw_main(int argc, char **argv)
 	}
 	fz_catch(ctx)
 	{
+		flush_workers(ctx);
 		fz_drop_document(ctx, doc);
 		fprintf(stderr, "error: cannot draw '%s'\n", filename);
 		errored = 1;
@@ -1131,8 +1896,27 @@ int mudraw_main(int argc, char **argv)
 		}
 	}
 
+#ifndef DISABLE_MUTHREADS
+	stop_workers(ctx);
+#endif
+
 	fz_drop_context(ctx);
 
+#ifndef DISABLE_MUTHREADS
+	if (locks)
+	{
+		int i;
+
+		for (i = 0; i < FZ_LOCK_MAX; i++)
+		{
+			mu_destroy_cond(&conds[i]);
+			mu_destroy_mutex(&mutexes[i]);
+		}
+	}
+	if (showmemory)
+		mu_destroy_mutex(&memtrace_mutex);
+#endif
+
 	if (showmemory)
 	{
 		printf("Total memory use = %d bytes\n", memtrace_total);
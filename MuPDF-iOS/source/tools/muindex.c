@@ -0,0 +1,305 @@
+/*
+ * muindex -- build and search full-text indexes of documents
+ */
+
+#include "mupdf/fitz.h"
+
+static char *password = "";
+static int hit_max = 100;
+static int showtext = 0;
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: mutool index [options] file [phrase ...]\n"
+		"\t-p -\tpassword\n"
+		"\t-o -\tindex file (default: file.muidx)\n"
+		"\t-b\tbuild the index again, even if it is up to date\n"
+		"\t-m -\tshow at most this many hits of each phrase (default 100)\n"
+		"\t-t\tshow the text of each hit\n"
+		"\n"
+		"The index is built when missing, or when the file has changed\n"
+		"since it was built, and then searched for each phrase.\n");
+	exit(1);
+}
+
+static fz_document *
+open_document(fz_context *ctx, const char *filename)
+{
+	fz_document *doc = fz_open_document(ctx, filename);
+	if (fz_needs_password(ctx, doc) && !fz_authenticate_password(ctx, doc, password))
+	{
+		fz_drop_document(ctx, doc);
+		fz_throw(ctx, FZ_ERROR_GENERIC, "cannot authenticate password: %s", filename);
+	}
+	return doc;
+}
+
+static fz_text_page *
+load_text_page(fz_context *ctx, fz_document *doc, fz_text_sheet *sheet, int number)
+{
+	fz_page *page;
+	fz_text_page *text = NULL;
+	fz_device *dev = NULL;
+
+	fz_var(text);
+	fz_var(dev);
+
+	page = fz_load_page(ctx, doc, number);
+	fz_try(ctx)
+	{
+		text = fz_new_text_page(ctx);
+		dev = fz_new_text_device(ctx, sheet, text);
+		fz_run_page(ctx, page, dev, &fz_identity, NULL);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_device(ctx, dev);
+		fz_drop_page(ctx, page);
+	}
+	fz_catch(ctx)
+	{
+		fz_drop_text_page(ctx, text);
+		fz_rethrow(ctx);
+	}
+	return text;
+}
+
+static fz_search_index *
+build_index(fz_context *ctx, const char *filename, const char *indexname, const unsigned char id[16])
+{
+	fz_document *doc = NULL;
+	fz_text_sheet *sheet = NULL;
+	fz_text_page *text = NULL;
+	fz_search_index *index = NULL;
+	fz_output *out = NULL;
+	int i, n;
+
+	fz_var(doc);
+	fz_var(sheet);
+	fz_var(text);
+	fz_var(index);
+	fz_var(out);
+	fz_var(i);
+
+	fz_try(ctx)
+	{
+		doc = open_document(ctx, filename);
+		sheet = fz_new_text_sheet(ctx);
+		index = fz_new_search_index(ctx, id);
+		n = fz_count_pages(ctx, doc);
+		for (i = 0; i < n; i++)
+		{
+			fz_try(ctx)
+			{
+				text = load_text_page(ctx, doc, sheet, i);
+				fz_search_index_add_page(ctx, index, i, text);
+			}
+			fz_always(ctx)
+			{
+				fz_drop_text_page(ctx, text);
+				text = NULL;
+			}
+			fz_catch(ctx)
+			{
+				fz_warn(ctx, "cannot index page %d", i + 1);
+			}
+		}
+
+		out = fz_new_output_to_filename(ctx, indexname);
+		fz_write_search_index(ctx, out, index);
+		fprintf(stderr, "indexed %d pages into %s\n", n, indexname);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_output(ctx, out);
+		fz_drop_text_sheet(ctx, sheet);
+		fz_drop_document(ctx, doc);
+	}
+	fz_catch(ctx)
+	{
+		fz_drop_search_index(ctx, index);
+		fz_rethrow(ctx);
+	}
+
+	return index;
+}
+
+static fz_search_index *
+load_index(fz_context *ctx, const char *indexname, const unsigned char id[16])
+{
+	fz_search_index *index = NULL;
+	fz_buffer *buf = NULL;
+	FILE *file;
+
+	/* Not there yet is not an error */
+	file = fopen(indexname, "rb");
+	if (!file)
+		return NULL;
+	fclose(file);
+
+	fz_var(index);
+	fz_var(buf);
+
+	fz_try(ctx)
+		buf = fz_read_file(ctx, indexname);
+	fz_catch(ctx)
+		return NULL;
+
+	fz_try(ctx)
+		index = fz_load_search_index(ctx, buf, id);
+	fz_always(ctx)
+		fz_drop_buffer(ctx, buf);
+	fz_catch(ctx)
+	{
+		fz_warn(ctx, "ignoring damaged index %s", indexname);
+		return NULL;
+	}
+	return index;
+}
+
+static void
+show_hits(fz_context *ctx, const char *filename, fz_search_hit *hits, int count)
+{
+	fz_document *doc = NULL;
+	fz_text_sheet *sheet = NULL;
+	fz_text_page *text = NULL;
+	fz_char_and_box cab;
+	int i, k, page = -1;
+
+	fz_var(doc);
+	fz_var(sheet);
+	fz_var(text);
+	fz_var(page);
+
+	fz_try(ctx)
+	{
+		if (showtext)
+		{
+			doc = open_document(ctx, filename);
+			sheet = fz_new_text_sheet(ctx);
+		}
+
+		for (i = 0; i < count; i++)
+		{
+			printf("page %d, chars %d-%d", hits[i].page + 1, hits[i].offset, hits[i].offset + hits[i].len);
+			if (showtext)
+			{
+				if (hits[i].page != page)
+				{
+					fz_drop_text_page(ctx, text);
+					text = NULL;
+					text = load_text_page(ctx, doc, sheet, hits[i].page);
+					page = hits[i].page;
+				}
+				printf(": ");
+				for (k = hits[i].offset; k < hits[i].offset + hits[i].len; k++)
+				{
+					char utf[8];
+					int c = fz_text_char_at(ctx, &cab, text, k)->c;
+					utf[fz_runetochar(utf, c < 32 ? ' ' : c)] = 0;
+					printf("%s", utf);
+				}
+			}
+			printf("\n");
+		}
+	}
+	fz_always(ctx)
+	{
+		fz_drop_text_page(ctx, text);
+		fz_drop_text_sheet(ctx, sheet);
+		fz_drop_document(ctx, doc);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
+}
+
+int muindex_main(int argc, char **argv)
+{
+	char indexbuf[1024];
+	char *filename, *indexname = NULL;
+	int rebuild = 0;
+	unsigned char id[16];
+	fz_search_index *index = NULL;
+	fz_search_hit *hits = NULL;
+	fz_stream *stm;
+	fz_context *ctx;
+	int c, count, errored = 0;
+
+	while ((c = fz_getopt(argc, argv, "p:o:bm:t")) != -1)
+	{
+		switch (c)
+		{
+		case 'p': password = fz_optarg; break;
+		case 'o': indexname = fz_optarg; break;
+		case 'b': rebuild = 1; break;
+		case 'm': hit_max = atoi(fz_optarg); break;
+		case 't': showtext = 1; break;
+		default: usage(); break;
+		}
+	}
+
+	if (fz_optind == argc || hit_max < 0)
+		usage();
+
+	filename = argv[fz_optind++];
+	if (!indexname)
+	{
+		fz_snprintf(indexbuf, sizeof indexbuf, "%s.muidx", filename);
+		indexname = indexbuf;
+	}
+
+	ctx = fz_new_context(NULL, NULL, FZ_STORE_DEFAULT);
+	if (!ctx)
+	{
+		fprintf(stderr, "cannot initialise context\n");
+		exit(1);
+	}
+
+	fz_var(index);
+	fz_var(hits);
+	fz_var(indexname);
+	fz_var(rebuild);
+	fz_var(errored);
+
+	fz_try(ctx)
+	{
+		fz_register_document_handlers(ctx);
+
+		stm = fz_open_file(ctx, filename);
+		fz_try(ctx)
+			fz_search_index_file_id(ctx, stm, id);
+		fz_always(ctx)
+			fz_drop_stream(ctx, stm);
+		fz_catch(ctx)
+			fz_rethrow(ctx);
+
+		if (!rebuild)
+			index = load_index(ctx, indexname, id);
+		if (!index)
+			index = build_index(ctx, filename, indexname, id);
+
+		hits = fz_malloc_array(ctx, hit_max + 1, sizeof *hits);
+		for (; fz_optind < argc; fz_optind++)
+		{
+			count = fz_search_index_lookup(ctx, index, argv[fz_optind], hits, hit_max);
+			printf("%s: %d hits\n", argv[fz_optind], count);
+			show_hits(ctx, filename, hits, fz_mini(count, hit_max));
+		}
+	}
+	fz_always(ctx)
+	{
+		fz_free(ctx, hits);
+		fz_drop_search_index(ctx, index);
+	}
+	fz_catch(ctx)
+	{
+		fprintf(stderr, "error: %s\n", fz_caught_message(ctx));
+		errored = 1;
+	}
+
+	fz_drop_context(ctx);
+	return errored;
+}
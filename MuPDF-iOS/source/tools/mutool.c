@@ -13,6 +13,7 @@ int pdfextract_main(int argc, char *argv[]);
 int pdfinfo_main(int argc, char *argv[]);
 int pdfposter_main(int argc, char *argv[]);
 int pdfshow_main(int argc, char *argv[]);
+int muindex_main(int argc, char *argv[]);
 
 static struct {
 	int (*func)(int argc, char *argv[]);
@@ -24,6 +25,7 @@ static struct {
 	{ pdfinfo_main, "info", "show information about pdf resources" },
 	{ pdfposter_main, "poster", "split large page into many tiles" },
 	{ pdfshow_main, "show", "show internal pdf objects" },
+	{ muindex_main, "index", "build and search a full-text index" },
 };
 
 static int